@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#version 460
+
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_scalar_block_layout : enable
+
+#include "device_host.h"
+#include "dh_bindings.h"
+
+// Adaptive sampling: one workgroup per tile, the tile is converged when the
+// relative error of all its pixels is below the threshold.
+// The path tracer skips the converged tiles of the next frame.
+
+layout(local_size_x = ADAPTIVE_TILE_SIZE, local_size_y = ADAPTIVE_TILE_SIZE) in;
+
+// clang-format off
+layout(set = 0, binding = eVariance, rgba32f) readonly uniform image2D varianceImage;
+layout(set = 0, binding = eAdaptiveTiles, scalar) buffer AdaptiveTiles_ { AdaptiveInfo adaptiveInfo; uint tileMask[]; };
+// clang-format on
+
+layout(push_constant) uniform PushConstant_
+{
+  PushConstantAdaptive pc;
+};
+
+#define LUMINANCE_FLOOR 0.01  // The dark pixels converge on an absolute error
+
+shared uint s_maxError;  // Bits of a positive float, they compare like the float
+
+// Standard error of the mean, relative to the mean
+float pixelError(vec4 stats)
+{
+  float n = stats.z;
+  if(n < max(float(pc.minSamples), 2.0))
+    return FLT_MAX;
+  float variance = stats.y / (n - 1.0);
+  return sqrt(variance / n) / max(stats.x, LUMINANCE_FLOOR);
+}
+
+void main()
+{
+  if(gl_LocalInvocationIndex == 0)
+    s_maxError = 0;
+  barrier();
+
+  ivec2 size  = imageSize(varianceImage);
+  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+  if(pixel.x < size.x && pixel.y < size.y)
+  {
+    float error = pixelError(imageLoad(varianceImage, pixel));
+    atomicMax(s_maxError, floatBitsToUint(error));
+  }
+  barrier();
+
+  if(gl_LocalInvocationIndex != 0)
+    return;
+
+  bool active = uintBitsToFloat(s_maxError) > pc.threshold;
+  tileMask[gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x] = active ? 1 : 0;
+  if(active)
+    atomicAdd(adaptiveInfo.activeTiles, 1);
+
+  if(gl_WorkGroupID.x == 0 && gl_WorkGroupID.y == 0)
+  {
+    adaptiveInfo.numTiles   = gl_NumWorkGroups.x * gl_NumWorkGroups.y;
+    adaptiveInfo.tilesX     = gl_NumWorkGroups.x;
+    adaptiveInfo.frameCount = pc.frameCount;
+  }
+}
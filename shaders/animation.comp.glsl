@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#version 460
+
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_buffer_reference2 : require
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+
+#include "animation.h"
+
+// Morph targets, then skinning, of the vertices of one render primitive
+
+layout(local_size_x = ANIMATION_WORKGROUP_SIZE) in;
+
+layout(push_constant) uniform PushConstant_
+{
+  PushConstantAnimation pc;
+};
+
+// clang-format off
+layout(buffer_reference, scalar) readonly buffer Vec3s { vec3 v[]; };
+layout(buffer_reference, scalar) readonly buffer Vec4s { vec4 v[]; };
+layout(buffer_reference, scalar) readonly buffer UVec4s { uvec4 v[]; };
+layout(buffer_reference, scalar) readonly buffer Mat4s { mat4 m[]; };
+layout(buffer_reference, scalar) readonly buffer Floats { float f[]; };
+layout(buffer_reference, scalar) writeonly buffer OutVec3s { vec3 v[]; };
+// clang-format on
+
+void main()
+{
+  uint vertexID = gl_GlobalInvocationID.x;
+  if(vertexID >= pc.vertexCount)
+    return;
+
+  bool hasNormals = pc.restNormals != 0 && pc.outNormals != 0;
+  vec3 position   = Vec3s(pc.restPositions).v[vertexID];
+  vec3 normal     = hasNormals ? Vec3s(pc.restNormals).v[vertexID] : vec3(0);
+
+  for(uint t = 0; t < pc.numTargets; t++)
+  {
+    float weight = Floats(pc.morphWeights).f[t];
+    if(weight == 0.0)
+      continue;
+    uint index = t * pc.vertexCount + vertexID;
+    position += weight * Vec3s(pc.morphPositions).v[index];
+    if(hasNormals && pc.morphNormals != 0)
+      normal += weight * Vec3s(pc.morphNormals).v[index];
+  }
+
+  if(pc.jointMatrices != 0)
+  {
+    uvec4 joints  = UVec4s(pc.joints).v[vertexID];
+    vec4  weights = Vec4s(pc.weights).v[vertexID];
+    Mat4s mats    = Mat4s(pc.jointMatrices);
+    mat4  skin = weights.x * mats.m[joints.x] + weights.y * mats.m[joints.y] + weights.z * mats.m[joints.z]
+                + weights.w * mats.m[joints.w];
+    position = vec3(skin * vec4(position, 1.0));
+    normal   = transpose(inverse(mat3(skin))) * normal;  // Non-uniform scales of the joints
+  }
+
+  OutVec3s(pc.outPositions).v[vertexID] = position;
+  if(hasNormals)
+    OutVec3s(pc.outNormals).v[vertexID] = dot(normal, normal) > 0.0 ? normalize(normal) : vec3(0, 0, 1);
+}
@@ -0,0 +1,31 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+//-----------------------------------------------------------------------
+// GPU skinning and morph targets (see GpuAnimation)
+// One dispatch per deformed render primitive, all the data is given by
+// buffer address. A zero address means the attribute is absent.
+
+#ifdef __cplusplus
+using uint = uint32_t;
+#endif
+
+#define ANIMATION_WORKGROUP_SIZE 256
+
+struct PushConstantAnimation
+{
+  uint64_t restPositions;   // vec3, the positions of the glTF
+  uint64_t restNormals;     // vec3
+  uint64_t joints;          // uvec4, JOINTS_0
+  uint64_t weights;         // vec4, WEIGHTS_0
+  uint64_t morphPositions;  // vec3, numTargets * vertexCount deltas
+  uint64_t morphNormals;    // vec3, numTargets * vertexCount deltas
+  uint64_t jointMatrices;   // mat4 per joint, updated every frame
+  uint64_t morphWeights;    // float per target, updated every frame
+  uint64_t outPositions;    // vec3, vertex buffer of the scene
+  uint64_t outNormals;      // vec3, vertex buffer of the scene
+  uint     vertexCount;
+  uint     numTargets;
+};
+
+#endif  // ANIMATION_H
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#version 460
+
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_buffer_reference2 : require
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+
+#include "compact_vertices.h"
+
+// Encoding of the vertices of one render primitive in the compact format
+
+layout(local_size_x = COMPACT_WORKGROUP_SIZE) in;
+
+layout(push_constant) uniform PushConstant_
+{
+  PushConstantCompact pc;
+};
+
+// clang-format off
+layout(buffer_reference, scalar) readonly buffer Vec2s { vec2 v[]; };
+layout(buffer_reference, scalar) readonly buffer Vec3s { vec3 v[]; };
+layout(buffer_reference, scalar) readonly buffer Vec4s { vec4 v[]; };
+layout(buffer_reference, scalar) writeonly buffer OutUVec2s { uvec2 v[]; };
+layout(buffer_reference, scalar) writeonly buffer OutUints { uint v[]; };
+// clang-format on
+
+void main()
+{
+  uint vertexID = gl_GlobalInvocationID.x;
+  if(vertexID >= pc.vertexCount)
+    return;
+
+  vec3 position = Vec3s(pc.srcPositions).v[vertexID];
+  vec3 q        = clamp((position - pc.boundsMin) / max(pc.boundsExtent, vec3(1e-30)), 0.0, 1.0);
+  OutUVec2s(pc.dstPositions).v[vertexID] = uvec2(packUnorm2x16(q.xy), packUnorm2x16(vec2(q.z, 0.0)));
+
+  if(pc.srcNormals != 0)
+  {
+    vec3 normal = Vec3s(pc.srcNormals).v[vertexID];
+    normal      = dot(normal, normal) > 0.0 ? normalize(normal) : vec3(0, 0, 1);
+    OutUints(pc.dstNormals).v[vertexID] = packSnorm2x16(octEncode(normal));
+  }
+  if(pc.srcTangents != 0)
+  {
+    vec4 tangent = Vec4s(pc.srcTangents).v[vertexID];
+    tangent.xyz  = dot(tangent.xyz, tangent.xyz) > 0.0 ? normalize(tangent.xyz) : vec3(1, 0, 0);
+    OutUints(pc.dstTangents).v[vertexID] = packTangent(tangent);
+  }
+  if(pc.srcTexCoords0 != 0)
+    OutUints(pc.dstTexCoords0).v[vertexID] = packHalf2x16(Vec2s(pc.srcTexCoords0).v[vertexID]);
+  if(pc.srcTexCoords1 != 0)
+    OutUints(pc.dstTexCoords1).v[vertexID] = packHalf2x16(Vec2s(pc.srcTexCoords1).v[vertexID]);
+}
@@ -0,0 +1,88 @@
+#ifndef COMPACT_VERTICES_H
+#define COMPACT_VERTICES_H
+
+//-----------------------------------------------------------------------
+// Compact vertex attributes (see CompactVertices)
+// - Positions: 16-bit unorm in the bounds of the render primitive, after a
+//   CompactHeader with the bounds. Two uints per vertex: xy, z.
+// - Normals: octahedral, 2x 16-bit snorm in a uint
+// - Tangents: octahedral, 16-bit and 15-bit snorm, the sign of w in the top bit
+// - Texture coordinates: 2x half float in a uint
+// The colors are kept as they are. The position address of a compact render
+// primitive is tagged with COMPACT_VERTEX_TAG, see vertex_fetch.h.
+
+#ifdef __cplusplus
+using vec3 = glm::vec3;
+using uint = uint32_t;
+#endif
+
+#define COMPACT_WORKGROUP_SIZE 256
+#define COMPACT_VERTEX_TAG 1
+#define COMPACT_HEADER_SIZE 32
+
+struct CompactHeader
+{
+  vec3  boundsMin;
+  float _pad0;
+  vec3  boundsExtent;
+  float _pad1;
+};
+
+// One dispatch per render primitive, from the vertex buffers of SceneVk
+// A zero address means the attribute is absent.
+struct PushConstantCompact
+{
+  uint64_t srcPositions;   // vec3
+  uint64_t srcNormals;     // vec3
+  uint64_t srcTangents;    // vec4
+  uint64_t srcTexCoords0;  // vec2
+  uint64_t srcTexCoords1;  // vec2
+  uint64_t dstPositions;   // uvec2, after the header
+  uint64_t dstNormals;     // uint
+  uint64_t dstTangents;    // uint
+  uint64_t dstTexCoords0;  // uint
+  uint64_t dstTexCoords1;  // uint
+  vec3     boundsMin;
+  uint     vertexCount;
+  vec3     boundsExtent;
+  float    _pad;
+};
+
+#ifndef __cplusplus
+vec2 octSignNotZero(vec2 v)
+{
+  return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Unit vector to [-1,1]^2
+vec2 octEncode(vec3 n)
+{
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * octSignNotZero(n.xy);
+}
+
+vec3 octDecode(vec2 e)
+{
+  vec3  n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+  return normalize(n);
+}
+
+uint packTangent(vec4 t)
+{
+  vec2 e = octEncode(t.xyz);
+  uint x = packSnorm2x16(vec2(e.x, 0.0)) & 0xFFFFu;
+  uint y = uint(int(round(clamp(e.y, -1.0, 1.0) * 16383.0))) & 0x7FFFu;
+  return x | (y << 16) | (t.w < 0.0 ? 0x80000000u : 0u);
+}
+
+vec4 unpackTangent(uint p)
+{
+  float x = unpackSnorm2x16(p).x;
+  float y = float(int(p << 1) >> 17) / 16383.0;  // Sign extension of the 15 bits
+  return vec4(octDecode(vec2(x, y)), (p & 0x80000000u) != 0u ? -1.0 : 1.0);
+}
+#endif
+
+#endif  // COMPACT_VERTICES_H
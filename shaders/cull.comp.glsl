@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#version 460
+
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_buffer_reference2 : require
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+
+#include "device_host.h"
+#include "dh_bindings.h"
+#include "gpu_driven.h"
+#include "cull_common.h"
+#include "nvvkhl/shaders/dh_scn_desc.h"
+
+// Frustum and Hi-Z occlusion culling of the draw candidates
+
+layout(local_size_x = CULL_WORKGROUP_SIZE) in;
+
+// clang-format off
+layout(buffer_reference, scalar) readonly buffer CullInfoBuf { CullInfo info; };
+layout(buffer_reference, scalar) readonly buffer Candidates { DrawCandidate c[]; };
+layout(buffer_reference, scalar) readonly buffer Primitives { PrimitiveCullInfo p[]; };
+layout(buffer_reference, scalar) readonly buffer Nodes { RenderNode n[]; };
+layout(buffer_reference, scalar) writeonly buffer Commands { DrawIndexedCommand c[]; };
+layout(buffer_reference, scalar) writeonly buffer Draws { DrawData d[]; };
+layout(buffer_reference, scalar) buffer Counts { uint c[]; };
+
+layout(set = 0, binding = eFrameInfo, scalar) uniform FrameInfo_ { SceneFrameInfo frameInfo; };
+layout(set = 0, binding = eSceneDesc) readonly buffer SceneDesc_ { SceneDescription sceneDesc; };
+// clang-format on
+
+layout(push_constant) uniform PushConstant_
+{
+  PushConstantCull pc;
+};
+
+void main()
+{
+  CullInfo info = CullInfoBuf(pc.cullInfo).info;
+  uint     id   = gl_GlobalInvocationID.x;
+  if(id >= info.numCandidates)
+    return;
+
+  DrawCandidate     candidate = Candidates(info.candidates).c[id];
+  PrimitiveCullInfo prim      = Primitives(info.primitives).p[candidate.renderPrimID];
+  mat4              toWorld   = Nodes(sceneDesc.renderNodeAddress).n[candidate.renderNodeID].objectToWorld;
+
+  if(all(lessThanEqual(prim.bboxMin, prim.bboxMax)))
+  {
+    vec4  rect;
+    float nearestDepth;
+    bool  outside;
+    projectBox(frameInfo.projMatrix * frameInfo.viewMatrix * toWorld, prim.bboxMin, prim.bboxMax, rect, nearestDepth, outside);
+    if(outside)
+      return;
+    if(info.hizLevels > 0 && isOccluded(info, toWorld, prim.bboxMin, prim.bboxMax))
+      return;
+  }
+
+  uint slot = atomicAdd(Counts(info.counts).c[candidate.bucket], 1);
+  uint dst  = info.bucketOffsets[candidate.bucket] + slot;
+  Commands(info.commands).c[dst] = DrawIndexedCommand(prim.indexCount, 1, prim.firstIndex, 0, 0);
+  Draws(info.drawData).d[dst]    = DrawData(candidate.renderNodeID, candidate.renderPrimID);
+}
@@ -0,0 +1,72 @@
+#ifndef CULL_COMMON_H
+#define CULL_COMMON_H
+
+//-----------------------------------------------------------------------
+// Frustum and Hi-Z tests, shared by the cull shader of the GPU-driven raster
+// and the task shader of the meshlet raster.
+// Include after gpu_driven.h
+
+// clang-format off
+layout(buffer_reference, scalar) readonly buffer Floats { float f[]; };
+// clang-format on
+
+// Screen rectangle (uv) and nearest depth of the box, false if it crosses the near plane
+bool projectBox(mat4 worldViewProj, vec3 bmin, vec3 bmax, out vec4 rect, out float nearestDepth, out bool outside)
+{
+  rect         = vec4(1, 1, 0, 0);
+  nearestDepth = 1.0;
+  // Outside when all corners are out of the same clip plane
+  uint outCodes = 0x3F;
+  bool crossing = false;
+  for(int i = 0; i < 8; i++)
+  {
+    vec3 corner = vec3((i & 1) != 0 ? bmax.x : bmin.x, (i & 2) != 0 ? bmax.y : bmin.y, (i & 4) != 0 ? bmax.z : bmin.z);
+    vec4 clip   = worldViewProj * vec4(corner, 1.0);
+    uint code   = 0;
+    code |= clip.x < -clip.w ? 0x01 : 0;
+    code |= clip.x > clip.w ? 0x02 : 0;
+    code |= clip.y < -clip.w ? 0x04 : 0;
+    code |= clip.y > clip.w ? 0x08 : 0;
+    code |= clip.z < 0.0 ? 0x10 : 0;
+    code |= clip.z > clip.w ? 0x20 : 0;
+    outCodes &= code;
+    if(clip.w <= 0.0)
+    {
+      crossing = true;
+      continue;
+    }
+    vec3 ndc     = clip.xyz / clip.w;
+    vec2 uv      = ndc.xy * 0.5 + 0.5;
+    rect.xy      = min(rect.xy, uv);
+    rect.zw      = max(rect.zw, uv);
+    nearestDepth = min(nearestDepth, ndc.z);
+  }
+  outside = outCodes != 0;
+  rect    = clamp(rect, vec4(0), vec4(1));
+  return !crossing;
+}
+
+bool isOccluded(CullInfo info, mat4 objectToWorld, vec3 bmin, vec3 bmax)
+{
+  vec4  rect;
+  float nearestDepth;
+  bool  outside;
+  // Not occluded when crossing the near plane or outside the previous view
+  if(!projectBox(info.hizViewProj * objectToWorld, bmin, bmax, rect, nearestDepth, outside) || outside)
+    return false;
+
+  // Level where the rectangle covers at most 2x2 texels
+  vec2  extent = (rect.zw - rect.xy) * vec2(info.hizSize);
+  uint  level  = min(uint(ceil(log2(max(max(extent.x, extent.y), 1.0)))), info.hizLevels - 1);
+  uvec2 size   = max(info.hizSize >> level, uvec2(1));
+  uvec2 lo     = min(uvec2(rect.xy * vec2(size)), size - 1);
+  uvec2 hi     = min(uvec2(rect.zw * vec2(size)), size - 1);
+
+  Floats hiz      = Floats(info.hiz);
+  uint   offset   = info.hizLevelOffsets[level];
+  float  farthest = max(max(hiz.f[offset + lo.y * size.x + lo.x], hiz.f[offset + lo.y * size.x + hi.x]),
+                        max(hiz.f[offset + hi.y * size.x + lo.x], hiz.f[offset + hi.y * size.x + hi.x]));
+  return nearestDepth > farthest;
+}
+
+#endif  // CULL_COMMON_H
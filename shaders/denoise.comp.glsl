@@ -28,6 +28,7 @@ layout(local_size_x = 16, local_size_y = 16) in;
 layout(set = 0, binding = 0, rgba32f) uniform readonly image2D inputImage;
 layout(set = 0, binding = 1, rgba32f) uniform readonly image2D inputNormalDepth;
 layout(set = 0, binding = 2, rgba32f) uniform writeonly image2D outputImage;
+layout(set = 0, binding = 3, rgba32f) uniform readonly image2D inputVariance;  // Luminance: mean, M2, number of samples
 
 layout(push_constant) uniform PushConstant_
 {
@@ -56,6 +57,16 @@ const float b3SplineKernel[25] = float[25](
 // clang-format on
 
 
+// Color phi of the pixel, relative to the standard deviation of its mean (SVGF)
+float pixelColorPhi(ivec2 pixelCoords)
+{
+  vec4 stats = imageLoad(inputVariance, pixelCoords);
+  if(pc.useVariance == 0 || stats.z < 2.0)
+    return pc.colorPhi;
+  float sigma = sqrt(max(stats.y, 0.0) / ((stats.z - 1.0) * stats.z));
+  return pc.colorPhi * (DENOISER_VARIANCE_SCALE * sigma + DENOISER_VARIANCE_EPSILON);
+}
+
 vec4 aTrousWaveletTransform(ivec2 pixelCoords)
 {
   vec4  color       = vec4(0.0);
@@ -65,6 +76,7 @@ vec4 aTrousWaveletTransform(ivec2 pixelCoords)
   vec4 centerND    = imageLoad(inputNormalDepth, pixelCoords);
   if(centerND.a == 0.0)  // Background
     return centerColor;
+  float colorPhi = pixelColorPhi(pixelCoords);
 
   for(int i = -2; i <= 2; i++)
   {
@@ -80,7 +92,7 @@ vec4 aTrousWaveletTransform(ivec2 pixelCoords)
 
         float kernelWeight  = kernel[(i + 2) * 5 + (j + 2)];
         float colorDistance = distance(sampleColor.rgb, centerColor.rgb);
-        float colorWeight   = exp(-colorDistance / pc.colorPhi);
+        float colorWeight   = exp(-colorDistance / colorPhi);
         if(isnan(colorWeight))
           return centerColor;
 
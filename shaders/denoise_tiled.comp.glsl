@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+#include "device_host.h"
+
+// A-Trous denoiser of denoise.comp.glsl, with the same weights, in fp16.
+// - pc.fusedLevels > 0: the first levels (steps 1 and 2) in one dispatch, the tile
+//   and its apron are loaded once in shared memory; the first level is computed
+//   on the tile and the apron of the second level.
+// - pc.fusedLevels == 0: one level of step pc.stepWidth, the taps are too far
+//   apart for the shared memory.
+// The normal and depth of the shared memory are packed in 32 bits: octahedral
+// normal in 2x8 bits, and fp16 depth.
+// The color phi of each filtered pixel follows its statistics, like denoise.comp.glsl.
+
+#define TILE WORKGROUP_SIZE
+#define MAX_APRON 6                     // 2 taps of step 1, then 2 taps of step 2
+#define LOAD_WIDTH (TILE + 2 * MAX_APRON)
+#define LEVEL0_WIDTH (TILE + 2 * 4)     // The first level covers the apron of the second one
+#define INVALID_ND 0xFFFFFFFF           // Outside of the image, the depth is a fp16 NaN
+
+layout(local_size_x = TILE, local_size_y = TILE) in;
+
+layout(set = 0, binding = 0) uniform readonly image2D inputImage;  // 32-bit path tracing, or 16-bit ping-pong
+layout(set = 0, binding = 1, rgba16f) uniform readonly image2D inputNormalDepth;
+layout(set = 0, binding = 2, rgba16f) uniform writeonly image2D outputImage;
+layout(set = 0, binding = 3, rgba32f) uniform readonly image2D inputVariance;  // Luminance: mean, M2, number of samples
+
+layout(push_constant) uniform PushConstant_
+{
+  PushConstantDenoiser pc;
+};
+
+// clang-format off
+const float16_t kernel[25] = float16_t[25](
+    float16_t(1.0 / 256.0),  float16_t(1.0 / 64.0),  float16_t(3.0 / 128.0), float16_t(1.0 / 64.0),  float16_t(1.0 / 256.0),
+    float16_t(1.0 / 64.0),   float16_t(1.0 / 16.0),  float16_t(3.0 / 32.0),  float16_t(1.0 / 16.0),  float16_t(1.0 / 64.0),
+    float16_t(3.0 / 128.0),  float16_t(3.0 / 32.0),  float16_t(9.0 / 64.0),  float16_t(3.0 / 32.0),  float16_t(3.0 / 128.0),
+    float16_t(1.0 / 64.0),   float16_t(1.0 / 16.0),  float16_t(3.0 / 32.0),  float16_t(1.0 / 16.0),  float16_t(1.0 / 64.0),
+    float16_t(1.0 / 256.0),  float16_t(1.0 / 64.0),  float16_t(3.0 / 128.0), float16_t(1.0 / 64.0),  float16_t(1.0 / 256.0)
+    );
+// clang-format on
+
+shared f16vec4 s_color[LOAD_WIDTH * LOAD_WIDTH + LEVEL0_WIDTH * LEVEL0_WIDTH];  // Input, then the first level
+shared uint    s_normalDepth[LOAD_WIDTH * LOAD_WIDTH];
+
+//-----------------------------------------------------------------------
+// Packing of the normal and depth
+//-----------------------------------------------------------------------
+vec2 octEncode(vec3 n)
+{
+  n.xy = n.xy / (abs(n.x) + abs(n.y) + abs(n.z));
+  return (n.z >= 0.0) ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+}
+
+f16vec3 octDecode(vec2 e)
+{
+  vec3  n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+  return f16vec3(normalize(n));
+}
+
+uint packNormalDepth(vec4 normalDepth)
+{
+  return (packSnorm4x8(vec4(octEncode(normalDepth.xyz), 0.0, 0.0)) & 0xFFFF) | (packHalf2x16(vec2(normalDepth.w, 0.0)) << 16);
+}
+
+void unpackNormalDepth(uint packed, out f16vec3 normal, out float16_t depth)
+{
+  normal = octDecode(unpackSnorm4x8(packed).xy);
+  depth  = float16_t(unpackHalf2x16(packed >> 16).x);
+}
+
+// The HDR values are clamped to the fp16 range
+// Color phi of the pixel, relative to the standard deviation of its mean (SVGF); the constant one outside of the image
+float16_t pixelColorPhi(ivec2 pixelCoords, float colorPhi)
+{
+  vec4 stats = imageLoad(inputVariance, pixelCoords);
+  if(pc.useVariance == 0 || stats.z < 2.0)
+    return float16_t(colorPhi);
+  float sigma = sqrt(max(stats.y, 0.0) / ((stats.z - 1.0) * stats.z));
+  return float16_t(colorPhi * (DENOISER_VARIANCE_SCALE * sigma + DENOISER_VARIANCE_EPSILON));
+}
+
+f16vec4 toHalf(vec4 color)
+{
+  return f16vec4(min(color, vec4(65504.0)));
+}
+
+//-----------------------------------------------------------------------
+// Weight of a tap, against the center
+//-----------------------------------------------------------------------
+float16_t edgeWeight(int tap, f16vec4 color, f16vec3 normal, float16_t depth, f16vec4 centerColor, f16vec3 centerNormal, float16_t centerDepth, float16_t colorPhi)
+{
+  float16_t colorWeight  = exp(-distance(color.rgb, centerColor.rgb) / colorPhi);
+  float16_t nDist        = float16_t(1.0) - clamp(dot(normal, centerNormal), float16_t(0.0), float16_t(1.0));
+  float16_t normalWeight = min(exp(-nDist) / float16_t(pc.normalPhi), float16_t(1.0));
+  float16_t depthWeight  = min(exp(-abs(depth - centerDepth)) / float16_t(pc.depthPhi), float16_t(1.0));
+  return kernel[tap] * colorWeight * normalWeight * depthWeight;
+}
+
+//-----------------------------------------------------------------------
+// One level from the shared memory: the colors start at colorBase, with
+// rows of colorWidth, the normal-depth are the ones of the loaded region
+//-----------------------------------------------------------------------
+f16vec4 filterShared(int colorBase, int colorWidth, ivec2 colorPos, ivec2 ndPos, int stepWidth, float16_t colorPhi)
+{
+  f16vec4 centerColor = s_color[colorBase + colorPos.y * colorWidth + colorPos.x];
+  uint    centerND    = s_normalDepth[ndPos.y * LOAD_WIDTH + ndPos.x];
+  if(centerND == INVALID_ND)
+    return centerColor;
+  f16vec3   centerNormal;
+  float16_t centerDepth;
+  unpackNormalDepth(centerND, centerNormal, centerDepth);
+  if(centerDepth == float16_t(0.0))  // Background
+    return centerColor;
+
+  f16vec4   color       = f16vec4(0.0);
+  float16_t totalWeight = float16_t(0.0);
+  for(int i = -2; i <= 2; i++)
+  {
+    for(int j = -2; j <= 2; j++)
+    {
+      ivec2 offset   = ivec2(i, j) * stepWidth;
+      uint  sampleND = s_normalDepth[(ndPos.y + offset.y) * LOAD_WIDTH + ndPos.x + offset.x];
+      if(sampleND == INVALID_ND)
+        continue;
+
+      f16vec4   sampleColor = s_color[colorBase + (colorPos.y + offset.y) * colorWidth + colorPos.x + offset.x];
+      f16vec3   sampleNormal;
+      float16_t sampleDepth;
+      unpackNormalDepth(sampleND, sampleNormal, sampleDepth);
+
+      float16_t weight = edgeWeight((i + 2) * 5 + (j + 2), sampleColor, sampleNormal, sampleDepth, centerColor,
+                                    centerNormal, centerDepth, colorPhi);
+      if(isnan(weight))
+        return centerColor;
+      color += sampleColor * weight;
+      totalWeight += weight;
+    }
+  }
+  return color / totalWeight;
+}
+
+//-----------------------------------------------------------------------
+// One level from the images, for the large steps
+//-----------------------------------------------------------------------
+f16vec4 filterDirect(ivec2 pixelCoords, ivec2 size)
+{
+  f16vec4 centerColor = toHalf(imageLoad(inputImage, pixelCoords));
+  vec4    centerND    = imageLoad(inputNormalDepth, pixelCoords);
+  if(centerND.a == 0.0)  // Background
+    return centerColor;
+  f16vec3   centerNormal = f16vec3(centerND.xyz);
+  float16_t centerDepth  = float16_t(centerND.w);
+  float16_t colorPhi     = pixelColorPhi(pixelCoords, pc.colorPhi);
+
+  f16vec4   color       = f16vec4(0.0);
+  float16_t totalWeight = float16_t(0.0);
+  for(int i = -2; i <= 2; i++)
+  {
+    for(int j = -2; j <= 2; j++)
+    {
+      ivec2 sampleCoords = pixelCoords + ivec2(i, j) * pc.stepWidth;
+      if(any(lessThan(sampleCoords, ivec2(0))) || any(greaterThanEqual(sampleCoords, size)))
+        continue;
+
+      f16vec4   sampleColor = toHalf(imageLoad(inputImage, sampleCoords));
+      f16vec4   sampleND    = f16vec4(imageLoad(inputNormalDepth, sampleCoords));
+      float16_t weight = edgeWeight((i + 2) * 5 + (j + 2), sampleColor, sampleND.xyz, sampleND.w, centerColor, centerNormal,
+                                    centerDepth, colorPhi);
+      if(isnan(weight))
+        return centerColor;
+      color += sampleColor * weight;
+      totalWeight += weight;
+    }
+  }
+  return color / totalWeight;
+}
+
+void main()
+{
+  ivec2 size        = imageSize(outputImage);
+  ivec2 pixelCoords = ivec2(gl_GlobalInvocationID.xy);
+  bool  inside      = all(lessThan(pixelCoords, size));
+
+  if(pc.colorPhi <= 0.0)
+  {
+    if(inside)
+      imageStore(outputImage, pixelCoords, imageLoad(inputImage, pixelCoords));
+    return;
+  }
+
+  if(pc.fusedLevels == 0)
+  {
+    if(inside)
+      imageStore(outputImage, pixelCoords, vec4(filterDirect(pixelCoords, size)));
+    return;
+  }
+
+  // Tile and its apron, once per workgroup
+  int   apron      = (pc.fusedLevels > 1) ? MAX_APRON : 2;
+  int   loadWidth  = TILE + 2 * apron;
+  ivec2 loadOrigin = ivec2(gl_WorkGroupID.xy) * TILE - apron;
+  for(int i = int(gl_LocalInvocationIndex); i < loadWidth * loadWidth; i += TILE * TILE)
+  {
+    ivec2 local  = ivec2(i % loadWidth, i / loadWidth);
+    ivec2 coords = loadOrigin + local;
+    int   index  = local.y * LOAD_WIDTH + local.x;
+    if(all(greaterThanEqual(coords, ivec2(0))) && all(lessThan(coords, size)))
+    {
+      s_color[index]       = toHalf(imageLoad(inputImage, coords));
+      s_normalDepth[index] = packNormalDepth(imageLoad(inputNormalDepth, coords));
+    }
+    else
+    {
+      s_color[index]       = f16vec4(0.0);
+      s_normalDepth[index] = INVALID_ND;
+    }
+  }
+  barrier();
+
+  ivec2   localPos = ivec2(gl_LocalInvocationID.xy);
+  f16vec4 result;
+  if(pc.fusedLevels > 1)
+  {
+    // First level on the tile and the apron of the second level: 2 pixels inside of the loaded region
+    const int level0Base = LOAD_WIDTH * LOAD_WIDTH;
+    for(int i = int(gl_LocalInvocationIndex); i < LEVEL0_WIDTH * LEVEL0_WIDTH; i += TILE * TILE)
+    {
+      ivec2     local    = ivec2(i % LEVEL0_WIDTH, i / LEVEL0_WIDTH);
+      float16_t colorPhi = pixelColorPhi(loadOrigin + local + 2, pc.colorPhi);
+      s_color[level0Base + local.y * LEVEL0_WIDTH + local.x] = filterShared(0, LOAD_WIDTH, local + 2, local + 2, 1, colorPhi);
+    }
+    barrier();
+
+    // Second level, the color weight is halved like the separate passes
+    result = filterShared(level0Base, LEVEL0_WIDTH, localPos + 4, localPos + MAX_APRON, 2, pixelColorPhi(pixelCoords, pc.colorPhi * 0.5));
+  }
+  else
+  {
+    result = filterShared(0, LOAD_WIDTH, localPos + apron, localPos + apron, 1, pixelColorPhi(pixelCoords, pc.colorPhi));
+  }
+
+  if(inside)
+    imageStore(outputImage, pixelCoords, vec4(result));
+}
@@ -8,6 +8,7 @@ using mat4  = glm::mat4;
 using vec4  = glm::vec4;
 using vec3  = glm::vec3;
 using vec2  = glm::vec2;
+using uint  = uint32_t;
 using Light = nvvkhl_shaders::Light;
 // clang-format off
 #define ENUM_START(name) enum name {
@@ -57,6 +58,11 @@ struct PushConstantPathtracer
   float aperture;            // Aperture for depth of field
   vec2  mouseCoord;          // Debugging (printf) mouse coordinates
   int   useRTDenoiser;       // Use the RTX denoiser?
+  float adaptiveThreshold;   // Relative error of a converged tile, 0: no adaptive sampling
+  int   adaptiveMinSamples;  // Samples of a pixel before its tile can be converged
+  int   useTemporal;         // Write the motion and the first hit, for the temporal reprojection
+  int   frameStride;         // Distributed rendering: the random sequence of this share is frame * frameStride + frameOffset
+  int   frameOffset;
 };
 
 struct PushConstantRaster
@@ -65,7 +71,6 @@ struct PushConstantRaster
   int renderNodeID;        // Node used by the rendering instance
   int renderPrimID;        // Primitive used by the rendering instance
   int dbgMethod;           // Debugging method
-  int selectedRenderNode;  // The node that is selected, used to create silhouette
 };
 
 struct PushConstantSilhouette
@@ -73,17 +78,72 @@ struct PushConstantSilhouette
   vec3 color;
 };
 
+struct PushConstantAdaptive
+{
+  float threshold;
+  int   minSamples;
+  int   frameCount;
+};
+
 struct PushConstantDenoiser
 {
   int   stepWidth;
   float colorPhi;
   float normalPhi;
   float depthPhi;
+  int   fusedLevels;  // Tiled denoiser: levels from step 1 in shared memory, 0: one level of stepWidth
+  int   useVariance;  // The color weight follows the standard deviation of the pixel (SVGF)
+};
+
+struct PushConstantReproject
+{
+  float depthTolerance;   // Relative difference with the distance to the previous camera
+  float normalTolerance;  // Minimum cosine between the normals
+  int   maxHistory;       // Samples kept from the previous accumulation
 };
 
 #define MAX_NB_LIGHTS 1
+#define MAX_FEEDBACK_MATERIALS 4096  // Materials with texture streaming feedback
 #define WORKGROUP_SIZE 16
 
+// Adaptive sampling: the convergence is evaluated per tile, one workgroup of the indirect pipeline
+#define ADAPTIVE_TILE_SIZE WORKGROUP_SIZE
+#define ADAPTIVE_MAX_BOOST 4.0  // Maximum multiplier of maxSamples for the tiles which are not converged
+
+// Header of the tile buffer, followed by the mask of the tiles (0: converged)
+struct AdaptiveInfo
+{
+  uint numTiles;
+  uint activeTiles;  // Tiles which are not converged
+  uint tilesX;
+  int  frameCount;  // Frame of the evaluation
+};
+
+// Variance guided denoiser: with the default color phi (0.5, squared), the luminance weight is at 4 standard deviations like SVGF
+#define DENOISER_VARIANCE_SCALE 16.0
+#define DENOISER_VARIANCE_EPSILON 1e-3
+
+// Light sampling: alias table of the punctual lights and emissive triangles, by power
+#define LIGHT_ENTRY_NONE 0xFFFFFFFF  // Render node without emissive triangles
+
+struct LightEntry
+{
+  float aliasProb;   // Probability of keeping this entry, instead of the alias
+  uint  alias;
+  float selectPdf;   // Probability of selecting this entry, power / total power
+  int   renderNode;  // -1: punctual light
+  uint  index;       // Punctual light, or triangle of the render node
+};
+
+// Header of the light table, followed by the entries
+struct LightSamplingInfo
+{
+  uint  numEntries;
+  uint  numPunctual;
+  float totalPower;
+  float _pad;
+};
+
 
 struct SceneFrameInfo
 {
@@ -91,6 +151,9 @@ struct SceneFrameInfo
   mat4  projMatrixI;           // inverse projection matrix
   mat4  viewMatrix;            // view matrix (world to camera)
   mat4  viewMatrixI;           // inverse view matrix (camera to world)
+  mat4  prevViewProjMatrix;    // projection * view of the previous frame, for the reprojection
+  vec3  prevCamPos;            // Camera position of the previous frame
+  float _pad0;
   Light light[MAX_NB_LIGHTS];  // Light information
   vec4  envIntensity;          // Environment intensity
   vec3  camPos;                // Camera position
@@ -101,6 +164,8 @@ struct SceneFrameInfo
   float envBlur;               // Level of blur for the environment map (0.0: no blur, 1.0: full blur)
   int   useSolidBackground;    // Use solid background color (0==false, 1==true)
   vec3  backgroundColor;       // Background color when using solid background
+  int   selectedRenderNode;    // The node that is selected, used by the raster to create silhouette
+  float lightsWeight;          // Probability of sampling the light table instead of the environment
 };
 
 struct Ray
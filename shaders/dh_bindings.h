@@ -16,14 +16,23 @@
 START_BINDING(SceneBindings)
 eFrameInfo = 0,
 eSceneDesc = 1,
-eTextures = 2
+eTextures = 2,
+eTextureFeedback = 3,
+eLightSampling = 4,
+eEmissiveNodes = 5
 END_BINDING();
 
 START_BINDING(RtxBindings)
 eTlas = 0,
 eOutImage = 1,
 eNormalDepth = 2,
-eSelect = 3
+eSelect = 3,
+eVariance = 4,
+eAdaptiveTiles = 5,
+eMotion = 6,
+eHistoryColor = 7,
+eHistoryVariance = 8,
+eHistoryNormalDepth = 9
 END_BINDING();
 
 START_BINDING(DeferredBindings)
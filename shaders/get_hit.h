@@ -7,7 +7,7 @@
 #extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
 
 #include "nvvkhl/shaders/ray_util.h"
-#include "nvvkhl/shaders/vertex_accessor.h"
+#include "vertex_fetch.h"
 #include "nvvkhl/shaders/func.h"
 #include "hit_state.h"
 
@@ -17,7 +17,7 @@ precision highp float;
 //-----------------------------------------------------------------------
 HitState getHitState(in RenderPrimitive renderPrim,      // Buffer containing all the mesh information
                      in vec3            barycentrics,    // Barycentics of the triangle
-                     in int             triangleID,      // Triangle ID
+                     in uvec3           triangleIndex,   // The 3 indices of the triangle (local)
                      in vec3            worldRayOrigin,  // Origin of the ray
                      in mat4x3          objectToWorld,   // Matrix
                      in mat4x3          worldToObject    // Matrix
@@ -25,14 +25,11 @@ HitState getHitState(in RenderPrimitive renderPrim,      // Buffer containing al
 {
   HitState hit;
 
-  // Getting the 3 indices of the triangle (local)
-  uvec3 triangleIndex = getTriangleIndices(renderPrim, triangleID);
-
   // Position
   vec3 pos[3];
-  pos[0]  = getVertexPosition(renderPrim, triangleIndex.x);
-  pos[1]  = getVertexPosition(renderPrim, triangleIndex.y);
-  pos[2]  = getVertexPosition(renderPrim, triangleIndex.z);
+  pos[0]  = fetchPosition(renderPrim, triangleIndex.x);
+  pos[1]  = fetchPosition(renderPrim, triangleIndex.y);
+  pos[2]  = fetchPosition(renderPrim, triangleIndex.z);
   vec3 P  = mixBary(pos[0], pos[1], pos[2], barycentrics);
   hit.pos = vec3(objectToWorld * vec4(P, 1.0));
   //hit.shadowpos = pointOffset(objpos, pos[0], pos[1], pos[2], nrm[0], nrm[1], nrm[2], barycentrics);  // Shadow offset position - hacking shadow terminator
@@ -47,13 +44,13 @@ HitState getHitState(in RenderPrimitive renderPrim,      // Buffer containing al
   vec3 N  = Ng;
   if(hasVertexNormal(renderPrim))
   {
-    N       = getInterpolatedVertexNormal(renderPrim, triangleIndex, barycentrics);
+    N       = fetchInterpolatedNormal(renderPrim, triangleIndex, barycentrics);
     hit.nrm = normalize(vec3(N * worldToObject));
   }
   
   // TexCoord
-  hit.uv[0] = getInterpolatedVertexTexCoord0(renderPrim, triangleIndex, barycentrics);
-  hit.uv[1] = getInterpolatedVertexTexCoord1(renderPrim, triangleIndex, barycentrics);
+  hit.uv[0] = fetchInterpolatedTexCoord0(renderPrim, triangleIndex, barycentrics);
+  hit.uv[1] = fetchInterpolatedTexCoord1(renderPrim, triangleIndex, barycentrics);
 
   // Color
   hit.color = getInterpolatedVertexColor(renderPrim, triangleIndex, barycentrics);
@@ -65,9 +62,9 @@ HitState getHitState(in RenderPrimitive renderPrim,      // Buffer containing al
   if(hasTangent)
   {
     // Retrieve the tangent for each vertex of the triangle if available.
-    tng[0] = getVertexTangent(renderPrim, triangleIndex.x);
-    tng[1] = getVertexTangent(renderPrim, triangleIndex.y);
-    tng[2] = getVertexTangent(renderPrim, triangleIndex.z);
+    tng[0] = fetchTangent(renderPrim, triangleIndex.x);
+    tng[1] = fetchTangent(renderPrim, triangleIndex.y);
+    tng[2] = fetchTangent(renderPrim, triangleIndex.z);
   }
   else
   {
@@ -107,5 +104,25 @@ HitState getHitState(in RenderPrimitive renderPrim,      // Buffer containing al
   return hit;
 }
 
+HitState getHitState(in RenderPrimitive renderPrim,      // Buffer containing all the mesh information
+                     in vec3            barycentrics,    // Barycentics of the triangle
+                     in int             triangleID,      // Triangle ID
+                     in vec3            worldRayOrigin,  // Origin of the ray
+                     in mat4x3          objectToWorld,   // Matrix
+                     in mat4x3          worldToObject    // Matrix
+)
+{
+  // Getting the 3 indices of the triangle (local)
+  return getHitState(renderPrim, barycentrics, getTriangleIndices(renderPrim, triangleID), worldRayOrigin, objectToWorld, worldToObject);
+}
+
+// The BLAS of the compact primitives are built from the fp32 positions, the 16-bit ones are slightly
+// off the traced surface: their hit position is taken on the ray, the next rays don't hit the same triangle
+void setTracedHitPosition(in RenderPrimitive renderPrim, inout HitState hit, in vec3 worldRayOrigin, in vec3 worldRayDirection, in float hitT)
+{
+  if(isCompact(renderPrim))
+    hit.pos = worldRayOrigin + hitT * worldRayDirection;
+}
+
 
 #endif
@@ -0,0 +1,100 @@
+#ifndef GPU_DRIVEN_H
+#define GPU_DRIVEN_H
+
+//-----------------------------------------------------------------------
+// GPU-driven raster (see GpuDrivenRaster)
+// One draw candidate per visible render node and pipeline. The cull shader
+// tests each candidate against the frustum and the Hi-Z of the previous frame,
+// and appends the visible ones to the indirect commands of their bucket.
+// Include after device_host.h
+
+#ifdef __cplusplus
+using uint  = uint32_t;
+using uvec2 = glm::uvec2;
+#endif
+
+#define CULL_WORKGROUP_SIZE 64
+#define HIZ_WORKGROUP_SIZE 16
+#define INDEX_POOL_WORKGROUP_SIZE 256
+#define HIZ_MAX_LEVELS 16
+#define DRAW_BUCKET_COUNT 4  // Solid, double sided, blend, wireframe
+
+struct DrawCandidate
+{
+  int  renderNodeID;
+  int  renderPrimID;
+  uint bucket;
+};
+
+// Object space bounds and location in the index pool, a box with min > max is never culled (deformed primitives)
+struct PrimitiveCullInfo
+{
+  vec3 bboxMin;
+  uint firstIndex;
+  vec3 bboxMax;
+  uint indexCount;
+};
+
+// Read by the vertex shader with gl_DrawID
+struct DrawData
+{
+  int renderNodeID;
+  int renderPrimID;
+};
+
+// VkDrawIndexedIndirectCommand
+struct DrawIndexedCommand
+{
+  uint indexCount;
+  uint instanceCount;
+  uint firstIndex;
+  int  vertexOffset;
+  uint firstInstance;
+};
+
+struct CullInfo
+{
+  mat4     hizViewProj;   // Matrices of the frame which produced the Hi-Z
+  uint64_t candidates;    // DrawCandidate[numCandidates]
+  uint64_t primitives;    // PrimitiveCullInfo per render primitive
+  uint64_t commands;      // DrawIndexedCommand, bucketOffsets[b] + slot
+  uint64_t drawData;      // DrawData, same layout as the commands
+  uint64_t counts;        // uint per bucket, reset before the dispatch
+  uint64_t hiz;           // float, all levels, farthest depth
+  uint     bucketOffsets[DRAW_BUCKET_COUNT];
+  uint     hizLevelOffsets[HIZ_MAX_LEVELS];
+  uvec2    hizSize;       // Level 0
+  uint     numCandidates;
+  uint     hizLevels;     // 0: no occlusion culling
+};
+
+struct PushConstantCull
+{
+  uint64_t cullInfo;
+};
+
+struct PushConstantHiz
+{
+  uint64_t src;
+  uint64_t dst;
+  uvec2    srcSize;
+  uvec2    dstSize;
+  uint     fromDepth;  // Level 0 reads the depth attachment
+};
+
+struct PushConstantIndexPool
+{
+  uint64_t dst;
+  int      renderPrimID;
+  uint     firstIndex;
+  uint     numTriangles;
+};
+
+struct PushConstantRasterIndirect
+{
+  PushConstantRaster raster;
+  uint               drawOffset;  // First DrawData of the bucket
+  uint64_t           drawData;
+};
+
+#endif  // GPU_DRIVEN_H
@@ -0,0 +1,465 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#version 460
+
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_buffer_reference2 : require
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+
+#include "nvvkhl/shaders/dh_hdr.h"
+#include "hdr_prepare.h"
+
+// Decoding and importance sampling of the HDR environment, see hdr_prepare.h
+// The block kernels loop over the blocks, the dispatch is limited to the
+// workgroup count of the device.
+
+layout(local_size_x = HDR_PREPARE_WORKGROUP_SIZE) in;
+layout(constant_id = 0) const int HDR_PREPARE_STAGE = HDR_STAGE_WEIGHTS;
+
+// clang-format off
+layout(buffer_reference, scalar) readonly buffer Texels  { uint t[]; };
+layout(buffer_reference, scalar) buffer Weights          { float w[]; };
+layout(buffer_reference, scalar) buffer Blocks           { HdrBlock b[]; };
+layout(buffer_reference, scalar) buffer Sums             { uint64_t s[]; };
+layout(buffer_reference, scalar) buffer Heavies          { uint h[]; };
+layout(buffer_reference, scalar) writeonly buffer Accels { EnvAccel a[]; };
+layout(buffer_reference, scalar) buffer Info             { HdrPrepareInfo i; };
+
+layout(set = 0, binding = HDR_PREPARE_BINDING_SRC, rgba32f) uniform readonly image2D srcImage;
+layout(set = 0, binding = HDR_PREPARE_BINDING_DST, rgba32f) uniform image2D dstImage;
+// clang-format on
+
+layout(push_constant) uniform PushConstant_
+{
+  PushConstantHdr pc;
+};
+
+const float    kPi       = 3.14159265358979323846;
+const uint64_t kFixedOne = uint64_t(1) << HDR_FIXED_POINT_BITS;
+
+shared float    s_weight[HDR_PREPARE_WORKGROUP_SIZE];
+shared uint     s_lights[HDR_PREPARE_WORKGROUP_SIZE];
+shared uint64_t s_deficit[HDR_PREPARE_WORKGROUP_SIZE];
+shared uint64_t s_excess[HDR_PREPARE_WORKGROUP_SIZE];
+
+// Light and heavy texels before a texel, or in a range of texels
+struct Prefix
+{
+  uint     lights;
+  uint64_t deficit;
+  uint64_t excess;
+};
+
+// The invocations of a block handle consecutive texels, the order of the prefix sums
+uint texelIndex(uint block, uint tid, uint k)
+{
+  return block * HDR_PREPARE_BLOCK_SIZE + tid * HDR_PREPARE_TEXELS_PER_INVOCATION + k;
+}
+
+uvec2 texelCoord(uint texel)
+{
+  return uvec2(texel % pc.size.x, texel / pc.size.x);
+}
+
+vec3 decodeRgbe(uint rgbe)
+{
+  uint e = rgbe >> 24;
+  if(e == 0)
+    return vec3(0.0);
+  return vec3(rgbe & 0xFF, (rgbe >> 8) & 0xFF, (rgbe >> 16) & 0xFF) * ldexp(1.0, int(e) - 136);
+}
+
+// Latitude-longitude: the rows closer to the poles cover a smaller solid angle
+float texelSolidAngle(uint y)
+{
+  float theta0 = float(y) * kPi / float(pc.size.y);
+  float theta1 = float(y + 1) * kPi / float(pc.size.y);
+  return (cos(theta0) - cos(theta1)) * 2.0 * kPi / float(pc.size.x);
+}
+
+float maxComponent(vec3 v)
+{
+  return max(v.r, max(v.g, v.b));
+}
+
+// Scale of the importance to the fixed point relative to the average, 0 for a black environment
+float fixedScale()
+{
+  float integral = Info(pc.info).i.integral;
+  return integral > 0.0 ? float(pc.numTexels) / integral * float(kFixedOne) : 0.0;
+}
+
+uint64_t fixedWeight(uint texel, float scale)
+{
+  if(scale <= 0.0)
+    return kFixedOne;  // Uniform
+  return uint64_t(Weights(pc.weights).w[texel] * scale + 0.5);
+}
+
+void reduceWeight(uint tid)
+{
+  barrier();
+  for(uint stride = HDR_PREPARE_WORKGROUP_SIZE / 2; stride > 0; stride >>= 1)
+  {
+    if(tid < stride)
+      s_weight[tid] += s_weight[tid + stride];
+    barrier();
+  }
+}
+
+void reducePrefix(uint tid)
+{
+  barrier();
+  for(uint stride = HDR_PREPARE_WORKGROUP_SIZE / 2; stride > 0; stride >>= 1)
+  {
+    if(tid < stride)
+    {
+      s_lights[tid] += s_lights[tid + stride];
+      s_deficit[tid] += s_deficit[tid + stride];
+      s_excess[tid] += s_excess[tid + stride];
+    }
+    barrier();
+  }
+}
+
+// Inclusive prefix sum of the shared values
+void scanPrefix(uint tid)
+{
+  barrier();
+  for(uint offset = 1; offset < HDR_PREPARE_WORKGROUP_SIZE; offset <<= 1)
+  {
+    uint     lights  = tid >= offset ? s_lights[tid - offset] : 0u;
+    uint64_t deficit = tid >= offset ? s_deficit[tid - offset] : uint64_t(0);
+    uint64_t excess  = tid >= offset ? s_excess[tid - offset] : uint64_t(0);
+    barrier();
+    s_lights[tid] += lights;
+    s_deficit[tid] += deficit;
+    s_excess[tid] += excess;
+    barrier();
+  }
+}
+
+//-----------------------------------------------------------------------
+// Decoding, and the importance of the texels of a block
+void computeWeights(uint block, uint tid)
+{
+  float sum = 0.0;
+  for(uint k = 0; k < HDR_PREPARE_TEXELS_PER_INVOCATION; k++)
+  {
+    uint texel = texelIndex(block, tid, k);
+    if(texel >= pc.numTexels)
+      break;
+    uvec2 coord  = texelCoord(texel);
+    vec3  color  = decodeRgbe(Texels(pc.texels).t[texel]);
+    float weight = maxComponent(color) * texelSolidAngle(coord.y);
+    imageStore(dstImage, ivec2(coord), vec4(color, 0.0));
+    Weights(pc.weights).w[texel] = weight;
+    sum += weight;
+  }
+  s_weight[tid] = sum;
+  reduceWeight(tid);
+  if(tid == 0)
+    Blocks(pc.blocks).b[block].weight = s_weight[0];
+}
+
+// One workgroup
+void computeTotal(uint tid)
+{
+  float sum = 0.0;
+  for(uint block = tid; block < pc.numBlocks; block += HDR_PREPARE_WORKGROUP_SIZE)
+    sum += Blocks(pc.blocks).b[block].weight;
+  s_weight[tid] = sum;
+  reduceWeight(tid);
+  if(tid == 0)
+    Info(pc.info).i.integral = s_weight[0];
+}
+
+//-----------------------------------------------------------------------
+// Deficit and excess, relative to the average, of the texels of a block
+void computeBlock(uint block, uint tid)
+{
+  float  scale = fixedScale();
+  Prefix sums  = Prefix(0u, uint64_t(0), uint64_t(0));
+  for(uint k = 0; k < HDR_PREPARE_TEXELS_PER_INVOCATION; k++)
+  {
+    uint texel = texelIndex(block, tid, k);
+    if(texel >= pc.numTexels)
+      break;
+    uint64_t weight = fixedWeight(texel, scale);
+    if(weight < kFixedOne)
+    {
+      sums.lights++;
+      sums.deficit += kFixedOne - weight;
+    }
+    else
+      sums.excess += weight - kFixedOne;
+  }
+  s_lights[tid]  = sums.lights;
+  s_deficit[tid] = sums.deficit;
+  s_excess[tid]  = sums.excess;
+  reducePrefix(tid);
+  if(tid == 0)
+  {
+    Blocks(pc.blocks).b[block].lights  = s_lights[0];
+    Blocks(pc.blocks).b[block].deficit = s_deficit[0];
+    Blocks(pc.blocks).b[block].excess  = s_excess[0];
+  }
+}
+
+// One workgroup: exclusive prefix sum of the blocks, the total after the last one
+void computeOffsets(uint tid)
+{
+  Prefix carry = Prefix(0u, uint64_t(0), uint64_t(0));
+  for(uint first = 0; first < pc.numBlocks; first += HDR_PREPARE_WORKGROUP_SIZE)
+  {
+    uint     block = first + tid;
+    HdrBlock value = HdrBlock(0.0, 0u, uint64_t(0), uint64_t(0));
+    if(block < pc.numBlocks)
+      value = Blocks(pc.blocks).b[block];
+    s_lights[tid]  = value.lights;
+    s_deficit[tid] = value.deficit;
+    s_excess[tid]  = value.excess;
+    scanPrefix(tid);
+    if(block < pc.numBlocks)
+    {
+      Blocks(pc.blocks).b[block].lights  = carry.lights + s_lights[tid] - value.lights;
+      Blocks(pc.blocks).b[block].deficit = carry.deficit + s_deficit[tid] - value.deficit;
+      Blocks(pc.blocks).b[block].excess  = carry.excess + s_excess[tid] - value.excess;
+    }
+    carry.lights += s_lights[HDR_PREPARE_WORKGROUP_SIZE - 1];
+    carry.deficit += s_deficit[HDR_PREPARE_WORKGROUP_SIZE - 1];
+    carry.excess += s_excess[HDR_PREPARE_WORKGROUP_SIZE - 1];
+    barrier();
+  }
+  if(tid == 0)
+  {
+    Blocks(pc.blocks).b[pc.numBlocks] = HdrBlock(0.0, carry.lights, carry.deficit, carry.excess);
+    Info(pc.info).i.numLights         = carry.lights;
+  }
+}
+
+// Prefix of the first texel of the invocation, from the offset of its block
+Prefix invocationPrefix(uint block, uint tid, uint64_t weights[HDR_PREPARE_TEXELS_PER_INVOCATION], uint count)
+{
+  Prefix sums = Prefix(0u, uint64_t(0), uint64_t(0));
+  for(uint k = 0; k < count; k++)
+  {
+    if(weights[k] < kFixedOne)
+    {
+      sums.lights++;
+      sums.deficit += kFixedOne - weights[k];
+    }
+    else
+      sums.excess += weights[k] - kFixedOne;
+  }
+  s_lights[tid]  = sums.lights;
+  s_deficit[tid] = sums.deficit;
+  s_excess[tid]  = sums.excess;
+  scanPrefix(tid);
+
+  HdrBlock offset = Blocks(pc.blocks).b[block];
+  Prefix   result;
+  result.lights  = offset.lights + s_lights[tid] - sums.lights;
+  result.deficit = offset.deficit + s_deficit[tid] - sums.deficit;
+  result.excess  = offset.excess + s_excess[tid] - sums.excess;
+  return result;
+}
+
+uint loadWeights(uint block, uint tid, out uint64_t weights[HDR_PREPARE_TEXELS_PER_INVOCATION])
+{
+  float scale = fixedScale();
+  uint  count = 0;
+  for(uint k = 0; k < HDR_PREPARE_TEXELS_PER_INVOCATION; k++)
+  {
+    weights[k] = kFixedOne;
+    uint texel = texelIndex(block, tid, k);
+    if(texel < pc.numTexels)
+    {
+      weights[k] = fixedWeight(texel, scale);
+      count++;
+    }
+  }
+  return count;
+}
+
+//-----------------------------------------------------------------------
+// The prefix sums of the light texels, then of the heavy texels, in the order of the texels
+void scatter(uint block, uint tid)
+{
+  uint64_t weights[HDR_PREPARE_TEXELS_PER_INVOCATION];
+  uint     count  = loadWeights(block, tid, weights);
+  Prefix   prefix = invocationPrefix(block, tid, weights, count);
+
+  uint numLights = Info(pc.info).i.numLights;
+  uint heavyBase = numLights + 1;
+  for(uint k = 0; k < count; k++)
+  {
+    uint texel = texelIndex(block, tid, k);
+    if(weights[k] < kFixedOne)
+    {
+      Sums(pc.sums).s[prefix.lights] = prefix.deficit;
+      prefix.lights++;
+      prefix.deficit += kFixedOne - weights[k];
+    }
+    else
+    {
+      uint heavy                         = texel - prefix.lights;
+      Sums(pc.sums).s[heavyBase + heavy] = prefix.excess;
+      Heavies(pc.heavies).h[heavy]       = texel;
+      prefix.excess += weights[k] - kFixedOne;
+    }
+  }
+
+  if(block == 0 && tid == 0)
+  {
+    HdrBlock total                                         = Blocks(pc.blocks).b[pc.numBlocks];
+    Sums(pc.sums).s[numLights]                             = total.deficit;
+    Sums(pc.sums).s[heavyBase + pc.numTexels - numLights] = total.excess;
+  }
+}
+
+//-----------------------------------------------------------------------
+// The alias table, as the sequential sweep would build it, and the pdf in the alpha of the image
+void buildAlias(uint block, uint tid)
+{
+  uint64_t weights[HDR_PREPARE_TEXELS_PER_INVOCATION];
+  uint     count  = loadWeights(block, tid, weights);
+  Prefix   prefix = invocationPrefix(block, tid, weights, count);
+
+  uint     numLights    = Info(pc.info).i.numLights;
+  uint     numHeavies   = pc.numTexels - numLights;
+  uint     heavyBase    = numLights + 1;
+  uint64_t totalDeficit = Sums(pc.sums).s[numLights];
+  float    integral     = Info(pc.info).i.integral;
+  for(uint k = 0; k < count; k++)
+  {
+    uint     texel = texelIndex(block, tid, k);
+    EnvAccel accel;
+    accel.alias = texel;
+    accel.q     = 1.0;
+    if(weights[k] < kFixedOne)
+    {
+      // The last heavy texel whose excess starts before the deficit of this one
+      if(numHeavies > 0)
+      {
+        uint lo = 0;
+        uint hi = numHeavies - 1;
+        while(lo < hi)
+        {
+          uint mid = (lo + hi + 1) / 2;
+          if(Sums(pc.sums).s[heavyBase + mid] <= prefix.deficit)
+            lo = mid;
+          else
+            hi = mid - 1;
+        }
+        accel.alias = Heavies(pc.heavies).h[lo];
+        accel.q     = float(weights[k]) / float(kFixedOne);
+      }
+      prefix.lights++;
+      prefix.deficit += kFixedOne - weights[k];
+    }
+    else
+    {
+      // Completed once the deficit of the light texels reaches the end of its excess,
+      // the rest of its bucket goes to the next heavy texel. The last one keeps its bucket.
+      uint heavy = texel - prefix.lights;
+      if(heavy + 1 < numHeavies)
+      {
+        uint64_t end = Sums(pc.sums).s[heavyBase + heavy + 1];
+        if(end <= totalDeficit)
+        {
+          uint lo = 0;
+          uint hi = numLights;
+          while(lo < hi)
+          {
+            uint mid = (lo + hi) / 2;
+            if(Sums(pc.sums).s[mid] < end)
+              lo = mid + 1;
+            else
+              hi = mid;
+          }
+          accel.alias = Heavies(pc.heavies).h[heavy + 1];
+          accel.q     = clamp(1.0 - float(Sums(pc.sums).s[lo] - end) / float(kFixedOne), 0.0, 1.0);
+        }
+      }
+    }
+    Accels(pc.accel).a[texel] = accel;
+
+    // Pdf over the solid angle, see environmentSample()
+    ivec2 coord = ivec2(texelCoord(texel));
+    vec4  color = imageLoad(dstImage, coord);
+    color.a     = integral > 0.0 ? maxComponent(color.rgb) / integral : 0.0;
+    imageStore(dstImage, coord, color);
+  }
+}
+
+//-----------------------------------------------------------------------
+// One level of the mip chain, the size is the one of the level
+void downsample(uint texel)
+{
+  uvec2 coord   = texelCoord(texel);
+  uvec2 srcSize = uvec2(imageSize(srcImage));
+  uvec2 lo      = (coord * srcSize) / pc.size;
+  uvec2 hi      = min(((coord + 1) * srcSize + pc.size - 1) / pc.size, srcSize);
+
+  vec4 sum = vec4(0.0);
+  for(uint y = lo.y; y < hi.y; y++)
+    for(uint x = lo.x; x < hi.x; x++)
+      sum += imageLoad(srcImage, ivec2(x, y));
+  imageStore(dstImage, ivec2(coord), sum / float((hi.x - lo.x) * (hi.y - lo.y)));
+}
+
+void main()
+{
+  uint tid = gl_LocalInvocationID.x;
+  switch(HDR_PREPARE_STAGE)
+  {
+    case HDR_STAGE_TOTAL:
+      computeTotal(tid);
+      return;
+    case HDR_STAGE_OFFSETS:
+      computeOffsets(tid);
+      return;
+    case HDR_STAGE_MIP:
+      for(uint texel = gl_GlobalInvocationID.x; texel < pc.numTexels; texel += gl_NumWorkGroups.x * HDR_PREPARE_WORKGROUP_SIZE)
+        downsample(texel);
+      return;
+  }
+
+  for(uint block = gl_WorkGroupID.x; block < pc.numBlocks; block += gl_NumWorkGroups.x)
+  {
+    switch(HDR_PREPARE_STAGE)
+    {
+      case HDR_STAGE_WEIGHTS:
+        computeWeights(block, tid);
+        break;
+      case HDR_STAGE_BLOCKS:
+        computeBlock(block, tid);
+        break;
+      case HDR_STAGE_SCATTER:
+        scatter(block, tid);
+        break;
+      case HDR_STAGE_ALIAS:
+        buildAlias(block, tid);
+        break;
+    }
+    barrier();  // The shared memory is reused by the next block
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef HDR_PREPARE_H
+#define HDR_PREPARE_H
+
+//-----------------------------------------------------------------------
+// Preparation of the HDR environment on the GPU (see HdrEnvironment)
+// The RGBE texels of the file are decoded into the image, and the
+// importance sampling of nvvkhl (EnvAccel alias table, pdf in the alpha)
+// is built in parallel:
+// - weights: decoding, importance of each texel (max channel x solid angle)
+// - total: integral of the importance (one workgroup)
+// - blocks: deficit and excess of the light and heavy texels of each block,
+//   relative to the average importance, in fixed point
+// - offsets: exclusive prefix sum of the blocks (one workgroup)
+// - scatter: deficit prefix of the light texels, excess prefix of the heavy
+//   texels, in the order of the texels
+// - alias: a light texel is completed by the heavy texel whose excess range
+//   contains its deficit prefix, a heavy texel by the next heavy texel. This
+//   is the table of the sequential sweep, each entry found by a binary search.
+// - mip: one level of the mip chain, average of the texels of the previous one
+
+#ifdef __cplusplus
+using uint  = uint32_t;
+using uvec2 = glm::uvec2;
+#endif
+
+#define HDR_PREPARE_WORKGROUP_SIZE 256
+#define HDR_PREPARE_TEXELS_PER_INVOCATION 4
+#define HDR_PREPARE_BLOCK_SIZE (HDR_PREPARE_WORKGROUP_SIZE * HDR_PREPARE_TEXELS_PER_INVOCATION)
+#define HDR_FIXED_POINT_BITS 24  // Of the importance relative to the average, exact prefix sums
+
+// Kernels of hdr_prepare.comp.glsl, selected by the specialization constant 0
+#define HDR_STAGE_WEIGHTS 0
+#define HDR_STAGE_TOTAL 1
+#define HDR_STAGE_BLOCKS 2
+#define HDR_STAGE_OFFSETS 3
+#define HDR_STAGE_SCATTER 4
+#define HDR_STAGE_ALIAS 5
+#define HDR_STAGE_MIP 6
+#define HDR_STAGE_COUNT 7
+
+// Descriptors, pushed: storage views of the image levels
+#define HDR_PREPARE_BINDING_SRC 0  // Previous level (mip), level 0 otherwise
+#define HDR_PREPARE_BINDING_DST 1
+
+// Per block of texels, the sums then their exclusive prefix (offsets), the total follows the last block
+struct HdrBlock
+{
+  float    weight;   // Sum of the importance
+  uint     lights;   // Texels with less than the average importance
+  uint64_t deficit;  // Of the light texels
+  uint64_t excess;   // Of the heavy texels
+};
+
+struct HdrPrepareInfo
+{
+  float integral;  // Of the importance over the sphere
+  uint  numLights;
+};
+
+struct PushConstantHdr
+{
+  uint64_t texels;   // RGBE, one uint per texel
+  uint64_t weights;  // float per texel
+  uint64_t blocks;   // HdrBlock, numBlocks + 1
+  uint64_t sums;     // uint64_t: deficit prefix of the lights [0, numLights], then excess prefix of the heavies
+  uint64_t heavies;  // uint: texel of each heavy texel
+  uint64_t accel;    // EnvAccel per texel
+  uint64_t info;     // HdrPrepareInfo
+  uvec2    size;     // Of the image, or of the level (mip)
+  uint     numTexels;
+  uint     numBlocks;
+};
+
+#endif  // HDR_PREPARE_H
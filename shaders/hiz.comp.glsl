@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#version 460
+
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_buffer_reference2 : require
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+
+#include "device_host.h"
+#include "gpu_driven.h"
+
+// One level of the Hi-Z pyramid: farthest depth of the source texels covered by each texel.
+// The source is the depth attachment for level 0, the previous level otherwise.
+
+layout(local_size_x = HIZ_WORKGROUP_SIZE, local_size_y = HIZ_WORKGROUP_SIZE) in;
+
+// clang-format off
+layout(buffer_reference, scalar) readonly buffer Floats { float f[]; };
+layout(buffer_reference, scalar) writeonly buffer OutFloats { float f[]; };
+
+layout(set = 0, binding = 0) uniform sampler2D depthTexture;
+// clang-format on
+
+layout(push_constant) uniform PushConstant_
+{
+  PushConstantHiz pc;
+};
+
+float readDepth(uvec2 coord)
+{
+  if(pc.fromDepth != 0)
+    return texelFetch(depthTexture, ivec2(coord), 0).r;
+  return Floats(pc.src).f[coord.y * pc.srcSize.x + coord.x];
+}
+
+void main()
+{
+  uvec2 coord = gl_GlobalInvocationID.xy;
+  if(any(greaterThanEqual(coord, pc.dstSize)))
+    return;
+
+  // Conservative footprint, odd sizes make a texel cover up to 3x3 source texels
+  uvec2 lo = (coord * pc.srcSize) / pc.dstSize;
+  uvec2 hi = min(((coord + 1) * pc.srcSize + pc.dstSize - 1) / pc.dstSize, pc.srcSize);
+
+  float farthest = 0.0;
+  for(uint y = lo.y; y < hi.y; y++)
+    for(uint x = lo.x; x < hi.x; x++)
+      farthest = max(farthest, readDepth(uvec2(x, y)));
+
+  OutFloats(pc.dst).f[coord.y * pc.dstSize.x + coord.x] = farthest;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#version 460
+
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_buffer_reference2 : require
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+
+#include "device_host.h"
+#include "dh_bindings.h"
+#include "gpu_driven.h"
+#include "nvvkhl/shaders/dh_scn_desc.h"
+#include "nvvkhl/shaders/vertex_accessor.h"
+
+// Copy the indices of one render primitive to the shared index pool
+
+layout(local_size_x = INDEX_POOL_WORKGROUP_SIZE) in;
+
+// clang-format off
+layout(buffer_reference, scalar) writeonly buffer OutIndices { uvec3 t[]; };
+
+layout(set = 0, binding = eSceneDesc) readonly buffer SceneDesc_ { SceneDescription sceneDesc; };
+// clang-format on
+
+layout(push_constant) uniform PushConstant_
+{
+  PushConstantIndexPool pc;
+};
+
+void main()
+{
+  uint triangleID = gl_GlobalInvocationID.x;
+  if(triangleID >= pc.numTriangles)
+    return;
+
+  RenderPrimitive renderPrim = RenderPrimitiveBuf(sceneDesc.renderPrimitiveAddress)._[pc.renderPrimID];
+  OutIndices(pc.dst + pc.firstIndex * 4).t[triangleID] = getTriangleIndices(renderPrim, triangleID);
+}
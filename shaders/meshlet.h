@@ -0,0 +1,97 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+//-----------------------------------------------------------------------
+// Meshlets of the render primitives (see MeshletScene, MeshletRaster)
+// Each primitive has LOD levels, level 0 is the original mesh. A level is a
+// range of meshlets, and the triangles of the level in meshlet order, with the
+// vertex indices of the primitive: gl_PrimitiveID of the mesh shader indexes
+// them, so the fragment shader fetches the same attributes as the other paths.
+// Include after device_host.h
+
+#ifdef __cplusplus
+using uint = uint32_t;
+#endif
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+#define MESHLET_MAX_LEVELS 8
+#define MESHLET_TASK_SIZE 32  // Meshlets tested by a task workgroup
+#define MESHLET_MESH_SIZE 32
+
+struct Meshlet
+{
+  vec3  center;  // Bounding sphere, object space
+  float radius;
+  vec3  coneAxis;    // Normal cone, culled when dot(center - eye, axis) >= cutoff * |center - eye| + radius
+  float coneCutoff;  // 1: never culled
+  uint  vertexOffset;         // In the meshlet vertices
+  uint  triangleOffset;       // In the packed meshlet triangles
+  uint  levelTriangleOffset;  // First triangle in the triangles of the level
+  uint  counts;               // Vertices | triangles << 8
+};
+
+struct MeshletLevel
+{
+  uint  meshletOffset;
+  uint  meshletCount;
+  uint  triangleOffset;  // In the level triangles (uvec3)
+  float error;           // Object space distance to the original surface
+};
+
+struct MeshletPrimitive
+{
+  vec3  center;  // Bounding sphere of the primitive
+  float radius;
+  uint  levelOffset;
+  uint  levelCount;  // 0: no meshlets, the primitive is not drawn by the mesh path
+  uint  deformed;    // Animated vertices: the bounds are unknown, level 0 and no culling
+  uint  pad;
+};
+
+struct MeshletSceneDesc
+{
+  uint64_t primitives;      // MeshletPrimitive per render primitive
+  uint64_t levels;          // MeshletLevel
+  uint64_t meshlets;        // Meshlet
+  uint64_t vertices;        // uint, vertex index of the primitive
+  uint64_t triangles;       // uint, three 8-bit local vertex indices
+  uint64_t levelTriangles;  // uvec3, vertex indices of the primitive
+};
+
+// One task workgroup tests MESHLET_TASK_SIZE meshlets of a render node
+struct MeshletTask
+{
+  int  renderNodeID;
+  int  renderPrimID;
+  uint chunk;  // First meshlet of the level: chunk * MESHLET_TASK_SIZE
+};
+
+#ifndef __cplusplus
+// From the task shader to the mesh shaders, one mesh workgroup per visible meshlet
+struct MeshletPayload
+{
+  uint  meshletIDs[MESHLET_TASK_SIZE];
+  int   renderNodeID;
+  int   renderPrimID;
+  uvec2 levelTriangles;  // Address of the triangles of the level, for the fragment shader
+};
+#endif
+
+#define MESHLET_FLAG_CONE_CULLING (1 << 0)
+#define MESHLET_FLAG_OCCLUSION (1 << 1)
+
+struct PushConstantMeshlet
+{
+  PushConstantRaster raster;
+  uint               taskOffset;  // First task of the bucket
+  uint               numTasks;
+  uint64_t           tasks;
+  uint64_t           meshletScene;  // MeshletSceneDesc
+  uint64_t           cullInfo;      // CullInfo, for the Hi-Z
+  float              lodPixelError;  // Coarsest level whose error projects to less than this
+  float              viewportHeight;
+  uint               flags;
+};
+
+#endif  // MESHLET_H
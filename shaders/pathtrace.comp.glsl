@@ -63,49 +63,66 @@ void main()
     useDebug = true;
   }
 
-  // Initialize the random number
-  uint seed = xxhash32(uvec3(samplePos.xy, frameInfo.frameCount));
+  // Converged tile, the pixel keeps its value
+  int numSamples = adaptiveSampleCount(samplePos);
+  if(numSamples == 0)
+  {
+    selectObject(samplePos, imageSize);
+    return;
+  }
+
+  // Initialize the random number, from the frame in the samples of all the shares
+  int  sampleFrame = frameInfo.frameCount * pc.frameStride + pc.frameOffset;
+  uint seed        = xxhash32(uvec3(samplePos.xy, sampleFrame));
 
   // Subpixel jitter: send the ray through a different position inside the
   // pixel each time, to provide antialiasing.
   vec2 subpixelJitter = vec2(0.5f, 0.5f);
-  if(frameInfo.frameCount > 0)
+  if(sampleFrame > 0)
     subpixelJitter += ANTIALIASING_STANDARD_DEVIATION * sampleGaussian(vec2(rand(seed), rand(seed)));
 
   float focalDistance = pc.focalDistance;
   float aperture      = pc.aperture;
 
   // Sampling n times the pixel
+  vec4 stats = frameInfo.frameCount == 0 ? vec4(0) : imageLoad(varianceImage, ivec2(samplePos.xy));
 
   SampleResult sampleResult = samplePixel(seed, samplePos, subpixelJitter, imageSize, frameInfo.projMatrixI,
                                           frameInfo.viewMatrixI, focalDistance, aperture);
   vec4         pixel_color  = sampleResult.radiance;
-  for(int s = 1; s < pc.maxSamples; s++)
+  addSampleStatistics(stats, sampleResult.radiance);
+  for(int s = 1; s < numSamples; s++)
   {
     subpixelJitter = vec2(rand(seed), rand(seed));
     sampleResult = samplePixel(seed, samplePos, subpixelJitter, imageSize, frameInfo.projMatrixI, frameInfo.viewMatrixI,
                                focalDistance, aperture);
     pixel_color += sampleResult.radiance;
+    addSampleStatistics(stats, sampleResult.radiance);
   }
-  pixel_color /= pc.maxSamples;
+  pixel_color /= numSamples;
+  if(frameInfo.frameCount == 0)
+    stats.w = float(sampleResult.rnodeID);  // Validation of the temporal reprojection
+  imageStore(varianceImage, ivec2(samplePos.xy), stats);
 
   if(frameInfo.frameCount == 0)  // first frame
   {
     imageStore(image, ivec2(samplePos.xy), pixel_color);
 
-    // Store the normal and depth for the denoiser
-    if(pc.useRTDenoiser == 1)
+    // Store the normal and depth for the denoiser and the reprojection
+    if(pc.useRTDenoiser == 1 || pc.useTemporal == 1)
       imageStore(normalDepth, ivec2(samplePos.xy), vec4(sampleResult.normal, sampleResult.depth));
+    if(pc.useTemporal == 1)
+      storeMotion(samplePos, imageSize, sampleResult.depth);
   }
   else
   {
-    // Do accumulation over time
-    float a         = 1.0F / float(frameInfo.frameCount + 1);
+    // Do accumulation over time, weighted by the samples: the tiles do not all get the same number
+    float a         = float(numSamples) / stats.z;
     vec4  old_color = imageLoad(image, ivec2(samplePos.xy));
     imageStore(image, ivec2(samplePos.xy), mix(old_color, pixel_color, a));
 
     // Store the normal and depth for the denoiser
-    if(pc.useRTDenoiser == 1)
+    if(pc.useRTDenoiser == 1 || pc.useTemporal == 1)
     {
       // Normal Depth buffer update
       vec4  oldNormalDepth = imageLoad(normalDepth, ivec2(samplePos.xy));
@@ -59,8 +59,10 @@ void main()
   const vec3 barycentrics = vec3(1.0 - barys.x - barys.y, barys.x, barys.y);
   bool       frontFacing  = (gl_HitKindEXT == gl_HitKindFrontFacingTriangleEXT);
 
-  payload.hitT    = gl_HitTEXT;
-  payload.rnodeID = gl_InstanceID;
-  payload.rprimID = gl_InstanceCustomIndexEXT;  // Should be equal to renderNode.rprimID
+  payload.hitT       = gl_HitTEXT;
+  payload.rnodeID    = gl_InstanceID;
+  payload.rprimID    = gl_InstanceCustomIndexEXT;  // Should be equal to renderNode.rprimID
+  payload.triangleID = gl_PrimitiveID;
   payload.hit = getHitState(renderPrim, barycentrics, gl_PrimitiveID, gl_WorldRayOriginEXT, gl_ObjectToWorldEXT, gl_WorldToObjectEXT);
+  setTracedHitPosition(renderPrim, payload.hit, gl_WorldRayOriginEXT, gl_WorldRayDirectionEXT, gl_HitTEXT);
 }
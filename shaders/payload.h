@@ -11,6 +11,7 @@ struct HitPayload
   float    hitT;
   int      rnodeID;
   int      rprimID;
+  int      triangleID;
   HitState hit;
 };
 
@@ -42,7 +42,10 @@
 // clang-format off
 // Incoming 
 layout(location = 0) in Interpolants {
-    vec3 pos;
+    vec3       pos;
+    flat int   renderNodeID;  // From the push constant, or the draw data of the GPU-driven path
+    flat int   renderPrimID;
+    flat uvec2 lodTriangles;  // Triangles of the LOD level of the mesh shader path, 0: the indices of the primitive
 } IN;
 
 // Outgoing
@@ -51,10 +54,12 @@ layout(location = 1) out vec4 outSelection;
 
 // Buffers
 layout(buffer_reference, scalar) readonly buffer GltfMaterialBuf    { GltfShadeMaterial m[]; };
+layout(buffer_reference, scalar) readonly buffer LodTrianglesBuf    { uvec3 t[]; };
 
 layout(set = 0, binding = eFrameInfo, scalar) uniform FrameInfo_ { SceneFrameInfo frameInfo; };
 layout(set = 0, binding = eSceneDesc) readonly buffer SceneDesc_ { SceneDescription sceneDesc; } ;
 layout(set = 0, binding = eTextures) uniform sampler2D[] texturesMap;
+layout(set = 0, binding = eTextureFeedback) buffer TextureFeedback_ { uint textureFeedback[]; };
 
 layout(set = 1, binding = 0) uniform sampler2D   u_GGXLUT; // lookup table
 layout(set = 1, binding = 1) uniform samplerCube u_LambertianEnvSampler; // 
@@ -66,6 +71,7 @@ layout(set = 2, binding = eSkyParam) uniform SkyInfo_ { PhysicalSkyParameters sk
 
 #include "nvvkhl/shaders/pbr_mat_eval.h"
 #include "get_hit.h"
+#include "texture_feedback.h"
 
 layout(push_constant) uniform RasterPushConstant_
 {
@@ -136,25 +142,30 @@ vec3 getIBLRadianceLambertian(vec3 n, vec3 v, float roughness, vec3 diffuseColor
 void main()
 {
   // Current Instance
-  RenderNode renderNode = RenderNodeBuf(sceneDesc.renderNodeAddress)._[pc.renderNodeID];
+  RenderNode renderNode = RenderNodeBuf(sceneDesc.renderNodeAddress)._[IN.renderNodeID];
 
   // Mesh used by instance
-  RenderPrimitive renderPrim = RenderPrimitiveBuf(sceneDesc.renderPrimitiveAddress)._[pc.renderPrimID];
+  RenderPrimitive renderPrim = RenderPrimitiveBuf(sceneDesc.renderPrimitiveAddress)._[IN.renderPrimID];
 
   // Using same hit code as for ray tracing
   const vec3 worldRayOrigin = vec3(frameInfo.viewMatrixI[3].x, frameInfo.viewMatrixI[3].y, frameInfo.viewMatrixI[3].z);
-  HitState   hit            = getHitState(renderPrim, gl_BaryCoordEXT, gl_PrimitiveID, worldRayOrigin,
-                                          mat4x3(renderNode.objectToWorld), mat4x3(renderNode.worldToObject));
+  // The meshlet levels only reference vertices of the primitive
+  uvec3 triangleIndex = any(notEqual(IN.lodTriangles, uvec2(0))) ?
+                            LodTrianglesBuf(packUint2x32(IN.lodTriangles)).t[gl_PrimitiveID] :
+                            getTriangleIndices(renderPrim, gl_PrimitiveID);
+  HitState hit = getHitState(renderPrim, gl_BaryCoordEXT, triangleIndex, worldRayOrigin, mat4x3(renderNode.objectToWorld),
+                             mat4x3(renderNode.worldToObject));
 
   // Material of the object
   GltfShadeMaterial gltfMat = GltfMaterialBuf(sceneDesc.materialAddress).m[renderNode.materialID];
+  writeTextureFeedback(renderNode.materialID, textureFootprint(dFdx(hit.uv[0]), dFdy(hit.uv[0])));
 
   gltfMat.pbrBaseColorFactor *= hit.color;  // Color at vertices
   MeshState   mesh   = MeshState(hit.nrm, hit.tangent, hit.bitangent, hit.geonrm, hit.uv, false);
   PbrMaterial pbrMat = evaluateMaterial(gltfMat, mesh);
 
   // Selection
-  if(pc.renderNodeID == pc.selectedRenderNode)
+  if(IN.renderNodeID == frameInfo.selectedRenderNode)
     outSelection = vec4(1);
   else
     outSelection = vec4(0);
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Mesh shader of the meshlet raster: one workgroup per visible meshlet. The
+// primitive ID is the triangle of the LOD level, the fragment shader fetches its
+// vertex indices with the address in the interpolants.
+
+#version 460
+#extension GL_EXT_mesh_shader : require
+#extension GL_EXT_scalar_block_layout : enable
+#extension GL_GOOGLE_include_directive : enable
+
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+#extension GL_EXT_buffer_reference2 : require
+
+#include "device_host.h"
+#include "dh_bindings.h"
+#include "meshlet.h"
+#include "nvvkhl/shaders/dh_scn_desc.h"
+#include "nvvkhl/shaders/vertex_accessor.h"
+#include "vertex_fetch.h"
+
+layout(local_size_x = MESHLET_MESH_SIZE) in;
+layout(triangles, max_vertices = MESHLET_MAX_VERTICES, max_primitives = MESHLET_MAX_TRIANGLES) out;
+
+// clang-format off
+layout(buffer_reference, scalar) readonly buffer MeshletSceneBuf { MeshletSceneDesc _; };
+layout(buffer_reference, scalar) readonly buffer MeshletsBuf { Meshlet _[]; };
+layout(buffer_reference, scalar) readonly buffer UintsBuf { uint _[]; };
+
+layout(set = 0, binding = eFrameInfo) uniform FrameInfo_ { SceneFrameInfo frameInfo; };
+layout(set = 0, binding = eSceneDesc) readonly buffer SceneDesc_ { SceneDescription sceneDesc; } ;
+// clang-format on
+
+layout(push_constant) uniform MeshletPushConstant_
+{
+  PushConstantMeshlet pc;
+};
+
+taskPayloadSharedEXT MeshletPayload payload;
+
+layout(location = 0) out Interpolants
+{
+  vec3       pos;
+  flat int   renderNodeID;
+  flat int   renderPrimID;
+  flat uvec2 lodTriangles;
+}
+OUT[];
+
+void main()
+{
+  MeshletSceneDesc scene        = MeshletSceneBuf(pc.meshletScene)._;
+  Meshlet          meshlet      = MeshletsBuf(scene.meshlets)._[payload.meshletIDs[gl_WorkGroupID.x]];
+  uint             numVertices  = meshlet.counts & 0xFF;
+  uint             numTriangles = meshlet.counts >> 8;
+  SetMeshOutputsEXT(numVertices, numTriangles);
+
+  RenderNode      renderNode = RenderNodeBuf(sceneDesc.renderNodeAddress)._[payload.renderNodeID];
+  RenderPrimitive renderPrim = RenderPrimitiveBuf(sceneDesc.renderPrimitiveAddress)._[payload.renderPrimID];
+  mat4            viewProj   = frameInfo.projMatrix * frameInfo.viewMatrix;
+
+  UintsBuf vertices = UintsBuf(scene.vertices);
+  for(uint v = gl_LocalInvocationIndex; v < numVertices; v += MESHLET_MESH_SIZE)
+  {
+    vec3 pos = vec3(renderNode.objectToWorld * vec4(fetchPosition(renderPrim, vertices._[meshlet.vertexOffset + v]), 1.0));
+    gl_MeshVerticesEXT[v].gl_Position = viewProj * vec4(pos, 1.0);
+    OUT[v].pos                        = pos;
+    OUT[v].renderNodeID               = payload.renderNodeID;
+    OUT[v].renderPrimID               = payload.renderPrimID;
+    OUT[v].lodTriangles               = payload.levelTriangles;
+  }
+
+  UintsBuf triangles = UintsBuf(scene.triangles);
+  for(uint t = gl_LocalInvocationIndex; t < numTriangles; t += MESHLET_MESH_SIZE)
+  {
+    uint packed                            = triangles._[meshlet.triangleOffset + t];
+    gl_PrimitiveTriangleIndicesEXT[t]      = uvec3(packed & 0xFF, (packed >> 8) & 0xFF, (packed >> 16) & 0xFF);
+    gl_MeshPrimitivesEXT[t].gl_PrimitiveID = int(meshlet.levelTriangleOffset + t);
+  }
+}
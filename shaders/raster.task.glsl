@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Task shader of the meshlet raster: selects the LOD level of the render node,
+// tests MESHLET_TASK_SIZE meshlets of the level against the frustum, the normal
+// cone and the Hi-Z, and launches one mesh workgroup per visible meshlet.
+
+#version 460
+#extension GL_EXT_mesh_shader : require
+#extension GL_EXT_scalar_block_layout : enable
+#extension GL_GOOGLE_include_directive : enable
+
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+#extension GL_EXT_buffer_reference2 : require
+
+#include "device_host.h"
+#include "dh_bindings.h"
+#include "gpu_driven.h"
+#include "meshlet.h"
+#include "cull_common.h"
+#include "nvvkhl/shaders/dh_scn_desc.h"
+
+layout(local_size_x = MESHLET_TASK_SIZE) in;
+
+// clang-format off
+layout(buffer_reference, scalar) readonly buffer RenderNodeBuf { RenderNode _[]; };
+layout(buffer_reference, scalar) readonly buffer TasksBuf { MeshletTask _[]; };
+layout(buffer_reference, scalar) readonly buffer MeshletSceneBuf { MeshletSceneDesc _; };
+layout(buffer_reference, scalar) readonly buffer MeshletPrimitivesBuf { MeshletPrimitive _[]; };
+layout(buffer_reference, scalar) readonly buffer MeshletLevelsBuf { MeshletLevel _[]; };
+layout(buffer_reference, scalar) readonly buffer MeshletsBuf { Meshlet _[]; };
+layout(buffer_reference, scalar) readonly buffer CullInfoBuf { CullInfo _; };
+
+layout(set = 0, binding = eFrameInfo) uniform FrameInfo_ { SceneFrameInfo frameInfo; };
+layout(set = 0, binding = eSceneDesc) readonly buffer SceneDesc_ { SceneDescription sceneDesc; } ;
+// clang-format on
+
+layout(push_constant) uniform MeshletPushConstant_
+{
+  PushConstantMeshlet pc;
+};
+
+taskPayloadSharedEXT MeshletPayload payload;
+
+shared uint s_numVisible;
+
+// Largest scale of the matrix, the normal cones are only valid without non-uniform scale or mirror
+float maxScale(mat4 m, out bool uniformScale)
+{
+  vec3  scale  = vec3(length(m[0].xyz), length(m[1].xyz), length(m[2].xyz));
+  float maxS   = max(max(scale.x, scale.y), scale.z);
+  float minS   = min(min(scale.x, scale.y), scale.z);
+  uniformScale = (maxS - minS) <= 1e-3 * maxS && determinant(mat3(m)) > 0.0;
+  return maxS;
+}
+
+// Coarsest level whose error, projected on the screen, stays below the threshold
+uint selectLevel(MeshletPrimitive prim, MeshletLevelsBuf levels, mat4 toWorld, float scale, vec3 eyePos)
+{
+  vec3  center   = vec3(toWorld * vec4(prim.center, 1.0));
+  float distance = length(center - eyePos) - prim.radius * scale;
+  if(distance <= 0.0)
+    return 0;  // Camera inside of the bounds
+  float pixelsPerUnit = abs(frameInfo.projMatrix[1][1]) * 0.5 * pc.viewportHeight / distance;
+
+  uint level = 0;
+  for(uint l = 1; l < prim.levelCount; l++)
+  {
+    if(levels._[prim.levelOffset + l].error * scale * pixelsPerUnit > pc.lodPixelError)
+      break;
+    level = l;
+  }
+  return level;
+}
+
+bool isVisible(Meshlet meshlet, mat4 toWorld, vec3 camObject, bool coneCulling, CullInfo cullInfo)
+{
+  vec3 bmin = meshlet.center - meshlet.radius;
+  vec3 bmax = meshlet.center + meshlet.radius;
+
+  vec4  rect;
+  float nearestDepth;
+  bool  outside;
+  projectBox(frameInfo.projMatrix * frameInfo.viewMatrix * toWorld, bmin, bmax, rect, nearestDepth, outside);
+  if(outside)
+    return false;
+
+  // Every triangle faces away from the camera
+  if(coneCulling)
+  {
+    vec3 toCenter = meshlet.center - camObject;
+    if(dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * length(toCenter) + meshlet.radius)
+      return false;
+  }
+
+  if(cullInfo.hizLevels > 0 && isOccluded(cullInfo, toWorld, bmin, bmax))
+    return false;
+  return true;
+}
+
+void main()
+{
+  uint taskID = gl_WorkGroupID.x + gl_WorkGroupID.y * gl_NumWorkGroups.x;
+  if(taskID >= pc.numTasks)
+  {
+    EmitMeshTasksEXT(0, 1, 1);
+    return;
+  }
+
+  MeshletTask      task    = TasksBuf(pc.tasks)._[pc.taskOffset + taskID];
+  MeshletSceneDesc scene   = MeshletSceneBuf(pc.meshletScene)._;
+  MeshletPrimitive prim    = MeshletPrimitivesBuf(scene.primitives)._[task.renderPrimID];
+  MeshletLevelsBuf levels  = MeshletLevelsBuf(scene.levels);
+  RenderNode       node    = RenderNodeBuf(sceneDesc.renderNodeAddress)._[task.renderNodeID];
+  mat4             toWorld = node.objectToWorld;
+
+  const vec3 eyePos = vec3(frameInfo.viewMatrixI[3].x, frameInfo.viewMatrixI[3].y, frameInfo.viewMatrixI[3].z);
+  bool       uniformScale;
+  float      scale   = maxScale(toWorld, uniformScale);
+  bool       culling = prim.deformed == 0;
+  uint       level   = culling ? selectLevel(prim, levels, toWorld, scale, eyePos) : 0;
+
+  MeshletLevel levelInfo = levels._[prim.levelOffset + level];
+  uint         first     = task.chunk * MESHLET_TASK_SIZE;
+  if(first >= levelInfo.meshletCount)
+  {
+    EmitMeshTasksEXT(0, 1, 1);  // The coarse levels have fewer meshlets
+    return;
+  }
+
+  if(gl_LocalInvocationIndex == 0)
+    s_numVisible = 0;
+  barrier();
+
+  uint local = first + gl_LocalInvocationIndex;
+  if(local < levelInfo.meshletCount)
+  {
+    uint     meshletID = levelInfo.meshletOffset + local;
+    Meshlet  meshlet   = MeshletsBuf(scene.meshlets)._[meshletID];
+    CullInfo cullInfo;
+    cullInfo.hizLevels = 0;
+    if((pc.flags & MESHLET_FLAG_OCCLUSION) != 0)
+      cullInfo = CullInfoBuf(pc.cullInfo)._;
+
+    bool coneCulling = (pc.flags & MESHLET_FLAG_CONE_CULLING) != 0 && uniformScale;
+    vec3 camObject   = vec3(node.worldToObject * vec4(eyePos, 1.0));
+    if(!culling || isVisible(meshlet, toWorld, camObject, coneCulling, cullInfo))
+    {
+      uint slot                = atomicAdd(s_numVisible, 1);
+      payload.meshletIDs[slot] = meshletID;
+    }
+  }
+  barrier();
+
+  if(gl_LocalInvocationIndex == 0)
+  {
+    payload.renderNodeID   = task.renderNodeID;
+    payload.renderPrimID   = task.renderPrimID;
+    payload.levelTriangles = unpackUint2x32(scene.levelTriangles + uint64_t(levelInfo.triangleOffset) * 12);
+  }
+  EmitMeshTasksEXT(s_numVisible, 1, 1);
+}
@@ -28,6 +28,7 @@
 #include "device_host.h"
 #include "dh_bindings.h"
 #include "nvvkhl/shaders/dh_scn_desc.h"
+#include "vertex_fetch.h"
 
 // clang-format off
 layout(buffer_reference, scalar) buffer  RenderNodeBuf { RenderNode _[]; };
@@ -41,11 +42,12 @@ layout(push_constant) uniform RasterPushConstant_
   PushConstantRaster pc;
 };
 
-layout(location = 0) in vec3 i_pos;
-
 layout(location = 0) out Interpolants
 {
-  vec3 pos;
+  vec3       pos;
+  flat int   renderNodeID;
+  flat int   renderPrimID;
+  flat uvec2 lodTriangles;
 }
 OUT;
 
@@ -57,7 +59,12 @@ out gl_PerVertex
 
 void main()
 {
-  RenderNode renderNode = RenderNodeBuf(sceneDesc.renderNodeAddress)._[pc.renderNodeID];
-  OUT.pos               = vec3(renderNode.objectToWorld * vec4(i_pos, 1.0));
+  // The vertices are pulled, to decode the compact ones (gl_VertexIndex is the index of the index buffer)
+  RenderNode      renderNode = RenderNodeBuf(sceneDesc.renderNodeAddress)._[pc.renderNodeID];
+  RenderPrimitive renderPrim = RenderPrimitiveBuf(sceneDesc.renderPrimitiveAddress)._[pc.renderPrimID];
+  OUT.pos                    = vec3(renderNode.objectToWorld * vec4(fetchPosition(renderPrim, gl_VertexIndex), 1.0));
+  OUT.renderNodeID      = pc.renderNodeID;
+  OUT.renderPrimID      = pc.renderPrimID;
+  OUT.lodTriangles      = uvec2(0);
   gl_Position           = frameInfo.projMatrix * frameInfo.viewMatrix * vec4(OUT.pos, 1.0);
 }
@@ -22,7 +22,10 @@
 // Incoming
 layout(location = 0) in Interpolants
 {
-  vec3 pos;
+  vec3       pos;
+  flat int   renderNodeID;
+  flat int   renderPrimID;
+  flat uvec2 lodTriangles;
 }
 IN;
 
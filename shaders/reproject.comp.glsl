@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#version 460
+
+#extension GL_GOOGLE_include_directive : enable
+
+#include "device_host.h"
+#include "dh_bindings.h"
+
+// Temporal reprojection, after the first frame of an accumulation which was
+// reset by a move of the camera. The path tracer wrote the new samples, the
+// history has the previous accumulation. Each pixel finds its position in the
+// previous frame with the motion image, and takes the bilinear taps of the
+// history which are the same surface: same render node, the expected distance
+// to the previous camera and a close normal. The valid history is merged with
+// the new samples, by number of samples, and so are the statistics of the
+// luminance (Chan et al.): the next frames continue the accumulation.
+
+layout(local_size_x = WORKGROUP_SIZE, local_size_y = WORKGROUP_SIZE) in;
+
+// clang-format off
+layout(set = 0, binding = eOutImage, rgba32f)              uniform image2D          image;
+layout(set = 0, binding = eNormalDepth, rgba16f)           readonly uniform image2D normalDepth;
+layout(set = 0, binding = eVariance, rgba32f)              uniform image2D          varianceImage;
+layout(set = 0, binding = eMotion, rgba16f)                readonly uniform image2D motionImage;
+layout(set = 0, binding = eHistoryColor, rgba32f)          readonly uniform image2D historyColor;
+layout(set = 0, binding = eHistoryVariance, rgba32f)       readonly uniform image2D historyVariance;
+layout(set = 0, binding = eHistoryNormalDepth, rgba16f)    readonly uniform image2D historyNormalDepth;
+// clang-format on
+
+layout(push_constant) uniform PushConstant_
+{
+  PushConstantReproject pc;
+};
+
+bool isSameSurface(ivec2 coords, ivec2 size, float renderNode, vec3 normal, float prevDepth)
+{
+  if(any(lessThan(coords, ivec2(0))) || any(greaterThanEqual(coords, size)))
+    return false;
+
+  // The render node is in the statistics
+  vec4 stats = imageLoad(historyVariance, coords);
+  if(stats.w != renderNode || stats.z < 1.0)
+    return false;
+
+  // Environment: no surface to compare
+  vec4 normalDepthHistory = imageLoad(historyNormalDepth, coords);
+  if(prevDepth == 0.0)
+    return normalDepthHistory.w == 0.0;
+
+  if(abs(normalDepthHistory.w - prevDepth) > pc.depthTolerance * prevDepth)
+    return false;
+  return dot(normalDepthHistory.xyz, normal) >= pc.normalTolerance;
+}
+
+void main()
+{
+  ivec2 size  = imageSize(image);
+  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+  if(any(greaterThanEqual(pixel, size)))
+    return;
+
+  vec4 stats  = imageLoad(varianceImage, pixel);
+  vec4 nd     = imageLoad(normalDepth, pixel);
+  vec4 motion = imageLoad(motionImage, pixel);
+
+  // Bilinear taps around the position in the previous frame, relative to the pixel centers
+  vec2  prevPos = vec2(pixel) + motion.xy;
+  ivec2 base    = ivec2(floor(prevPos));
+  vec2  f       = prevPos - vec2(base);
+
+  vec4  color       = vec4(0.0);
+  vec4  history     = vec4(0.0);  // Mean, M2 and number of samples of the luminance
+  float totalWeight = 0.0;
+  for(int i = 0; i < 4; i++)
+  {
+    ivec2 offset = ivec2(i & 1, i >> 1);
+    float weight = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+    if(weight <= 0.0 || !isSameSurface(base + offset, size, stats.w, nd.xyz, motion.z))
+      continue;
+    color += weight * imageLoad(historyColor, base + offset);
+    history.xyz += weight * imageLoad(historyVariance, base + offset).xyz;
+    totalWeight += weight;
+  }
+
+  // Disocclusion: only the new samples
+  if(totalWeight < 0.01)
+    return;
+  color /= totalWeight;
+  history /= totalWeight;
+
+  // The history is limited, for the lag of the shading which changes with the view
+  float historySamples = min(history.z, float(pc.maxHistory));
+  float m2History      = history.y * historySamples / history.z;
+
+  // Merge of the two sets of samples
+  float n     = stats.z + historySamples;
+  float delta = history.x - stats.x;
+  vec4  merged;
+  merged.x = stats.x + delta * historySamples / n;
+  merged.y = stats.y + m2History + delta * delta * stats.z * historySamples / n;
+  merged.z = n;
+  merged.w = stats.w;
+
+  vec4 currentColor = imageLoad(image, pixel);
+  imageStore(image, pixel, (currentColor * stats.z + color * historySamples) / n);
+  imageStore(varianceImage, pixel, merged);
+}
@@ -1,3 +1,7 @@
+#include "texture_feedback.h"
+#include "vertex_fetch.h"
+#include "scene_features.h"
+
 // --------------------------------------------------------------------
 // Forwarded declarations
 void        traceRay(Ray r, inout uint seed);
@@ -10,6 +14,7 @@ struct SampleResult
   vec4  radiance;
   vec3  normal;
   float depth;
+  int   rnodeID;  // First hit, -1 for the environment
 };
 
 vec3 debugValue(PbrMaterial pbrMat, HitState hit, int dbgMethod)
@@ -40,116 +45,188 @@ vec3 debugValue(PbrMaterial pbrMat, HitState hit, int dbgMethod)
 }
 
 // --------------------------------------------------------------------
-// Sampling the Sun or the HDR
+// Probabilities of sampling the light table or the environment,
+// frameInfo.lightsWeight is from the power of the lights and of the environment
+//
+void lightSelectionWeights(out float lightWeight, out float envWeight)
+{
+  bool hasEnvironment = TEST_FLAG(frameInfo.flags, USE_SKY_FLAG) || frameInfo.envIntensity.x > 0.0;
+  lightWeight         = (lightInfo.numEntries > 0) ? frameInfo.lightsWeight : 0.0;
+  envWeight           = hasEnvironment ? 1.0 - frameInfo.lightsWeight : 0.0;
+
+  float totalWeight = lightWeight + envWeight;
+  if(totalWeight > 0.0)
+  {
+    lightWeight /= totalWeight;
+    envWeight /= totalWeight;
+  }
+}
+
+// World positions of a triangle of a render node
+void getWorldTriangle(RenderNode renderNode, int triangleID, out vec3 p0, out vec3 p1, out vec3 p2)
+{
+  RenderPrimitive renderPrim = RenderPrimitiveBuf(sceneDesc.renderPrimitiveAddress)._[renderNode.renderPrimID];
+  uvec3           indices    = getTriangleIndices(renderPrim, triangleID);
+  p0                         = vec3(renderNode.objectToWorld * vec4(fetchPosition(renderPrim, indices.x), 1.0));
+  p1                         = vec3(renderNode.objectToWorld * vec4(fetchPosition(renderPrim, indices.y), 1.0));
+  p2                         = vec3(renderNode.objectToWorld * vec4(fetchPosition(renderPrim, indices.z), 1.0));
+}
+
+// Solid angle PDF of sampling the emissive triangle of the BSDF hit, zero if it isn't in the light table
+float emissiveHitPdf(int rnodeID, int triangleID, vec3 direction, float hitT, vec3 geonrm)
+{
+  uint firstEntry = emissiveNodes[rnodeID];
+  if(firstEntry == LIGHT_ENTRY_NONE || lightInfo.numEntries == 0)
+    return 0.0;
+
+  float lightWeight, envWeight;
+  lightSelectionWeights(lightWeight, envWeight);
+
+  RenderNode renderNode = RenderNodeBuf(sceneDesc.renderNodeAddress)._[rnodeID];
+  vec3       p0, p1, p2;
+  getWorldTriangle(renderNode, triangleID, p0, p1, p2);
+  float area     = 0.5 * length(cross(p1 - p0, p2 - p0));
+  float cosLight = abs(dot(geonrm, direction));
+  if(area <= 0.0 || cosLight <= 0.0)
+    return 0.0;
+  return lightWeight * lightEntries[firstEntry + triangleID].selectPdf * hitT * hitT / (cosLight * area);
+}
+
+// Uniform point on an emissive triangle, returns its radiance, and the solid angle PDF of the point
+vec3 sampleEmissiveTriangle(LightEntry entry, vec3 pos, vec2 u, out vec3 dirToLight, out float pdf, out float lightDist)
+{
+  pdf                   = 0.0;
+  RenderNode renderNode = RenderNodeBuf(sceneDesc.renderNodeAddress)._[entry.renderNode];
+  vec3       p0, p1, p2;
+  getWorldTriangle(renderNode, int(entry.index), p0, p1, p2);
+
+  float su          = sqrt(u.x);
+  vec3  barycentric = vec3(1.0 - su, su * (1.0 - u.y), su * u.y);
+  vec3  lightPos    = barycentric.x * p0 + barycentric.y * p1 + barycentric.z * p2;
+  vec3  normal      = cross(p1 - p0, p2 - p0);
+  float area        = 0.5 * length(normal);
+
+  vec3  toLight  = lightPos - pos;
+  float distSqr  = dot(toLight, toLight);
+  lightDist      = sqrt(distSqr);
+  dirToLight     = toLight / max(lightDist, 1e-20);
+  float cosLight = abs(dot(normal, dirToLight)) / max(2.0 * area, 1e-20);  // Emits on both sides, like the BSDF hits
+  if(area <= 0.0 || cosLight <= 0.0 || lightDist <= 0.0)
+    return vec3(0.0);
+  pdf       = entry.selectPdf * distSqr / (cosLight * area);
+  lightDist = lightDist * 0.999;  // The shadow ray does not hit the light itself
+
+  // Emission of the material, at the point
+  GltfShadeMaterial material = GltfMaterialBuf(sceneDesc.materialAddress).m[renderNode.materialID];
+  vec3              emissive = material.emissiveFactor;
+  if(isTexturePresent(material.emissiveTexture))
+  {
+    RenderPrimitive renderPrim = RenderPrimitiveBuf(sceneDesc.renderPrimitiveAddress)._[renderNode.renderPrimID];
+    uvec3           indices    = getTriangleIndices(renderPrim, int(entry.index));
+    vec2            tc[2];
+    tc[0] = fetchInterpolatedTexCoord0(renderPrim, indices, barycentric);
+    tc[1] = fetchInterpolatedTexCoord1(renderPrim, indices, barycentric);
+    emissive *= getTexture(material.emissiveTexture, tc).rgb;
+  }
+  return emissive;
+}
+
+// --------------------------------------------------------------------
+// Sampling the lights or the environment
+// - The light is picked in the alias table, by power: punctual lights and
+//   emissive triangles
+// - The environment (sun & sky, or HDR) is importance sampled
 // - Returns
 //      The contribution divided by PDF
 //      The direction to the light source
-//      The PDF
+//      The PDF, DIRAC for the punctual lights
 //
 vec3 sampleLights(in vec3 pos, vec3 normal, in vec3 worldRayDirection, inout uint seed, out vec3 dirToLight, out float lightPdf, out float lightDist)
 {
   vec3 radiance = vec3(0);
   lightPdf      = 0.0;
-  float envPdf  = 0.0;
   lightDist     = INFINITE;
-
-  // We use the one-sample model to perform multiple importance sampling
-  // between point lights and environment lights.
-  // See section 9.2.4 of https://graphics.stanford.edu/papers/veach_thesis/thesis.pdf .
-
-  // Probability we'll select each sampling scheme (TODO: adjust these based on
-  // scene characteristics: light intensity vs environment intensity)
-  float lightWeight = (sceneDesc.numLights > 0) ? 0.5 : 0.0;
-  float envWeight   = (TEST_FLAG(frameInfo.flags, USE_SKY_FLAG) || frameInfo.envIntensity.x > 0.0) ? 0.5 : 0.0;
-
-  // Normalize weights
-  float totalWeight = lightWeight + envWeight;
-  if(totalWeight == 0.0f)
+  dirToLight    = vec3(0);
+
+  // Probability we'll select each sampling scheme.
+  // The techniques do not overlap: the environment behind an emissive triangle is occluded
+  // by it, and the punctual lights are Dirac, their sample is not weighted against the other.
+  float lightWeight, envWeight;
+  lightSelectionWeights(lightWeight, envWeight);
+  if(lightWeight + envWeight == 0.0)
     return vec3(0.);
 
-  lightWeight /= totalWeight;
-  envWeight /= totalWeight;
-
-  // Decide whether to sample the light or the environment.
-  bool sampleLights = (rand(seed) <= lightWeight);
-
-  // We'll choose a direction from one technique, but for MIS we need the
-  // PDFs of each technique in the direction we chose. That's why we always get
-  // the light PDF (which is constant), but only sample a light if
-  // `sampleLights` is true.
-
   // Lights
-  if(lightWeight > 0)
-  {
-    lightPdf = 1.0 / sceneDesc.numLights;
-    if(sampleLights)  // Use this technique for MIS?
-    {
-      int          lightIndex = min(int(rand(seed) * sceneDesc.numLights), sceneDesc.numLights - 1);
-      Light        light      = RenderLightBuf(sceneDesc.lightAddress)._[lightIndex];
-      LightContrib contrib    = singleLightContribution(light, pos, normal, vec2(rand(seed), rand(seed)));
-      dirToLight              = -contrib.incidentVector;
-      radiance                = contrib.intensity / (lightPdf * lightWeight);
-      lightDist               = contrib.distance;
-    }
-  }
-
-  // Environment
-  if(envWeight > 0)
+  if(rand(seed) < lightWeight)
   {
-    if(TEST_FLAG(frameInfo.flags, USE_SKY_FLAG))
+    // Alias table: entry of the random slot, or its alias
+    uint       slot  = min(uint(rand(seed) * float(lightInfo.numEntries)), lightInfo.numEntries - 1);
+    LightEntry entry = lightEntries[slot];
+    if(rand(seed) >= entry.aliasProb)
+      entry = lightEntries[entry.alias];
+
+    // Without one of the kinds of lights in the scene, the other is the only branch
+    const bool punctual = !hasSceneFeature(SCENE_FEATURE_EMISSIVE_TRIANGLES)
+                          || (hasSceneFeature(SCENE_FEATURE_PUNCTUAL_LIGHTS) && entry.renderNode < 0);
+    if(punctual)
     {
-      if(!sampleLights)  // Use this technique for MIS?
-      {
-        vec2              random_sample = vec2(rand(seed), rand(seed));
-        SkySamplingResult skySample     = samplePhysicalSky(skyInfo, random_sample);
-        dirToLight                      = skySample.direction;
-        envPdf                          = skySample.pdf;
-        radiance                        = skySample.radiance / (envPdf * envWeight);
-      }
-      else
-      {
-        envPdf = samplePhysicalSkyPDF(skyInfo, dirToLight);
-      }
+      Light        light   = RenderLightBuf(sceneDesc.lightAddress)._[entry.index];
+      LightContrib contrib = singleLightContribution(light, pos, normal, vec2(rand(seed), rand(seed)));
+      dirToLight           = -contrib.incidentVector;
+      radiance             = contrib.intensity / (entry.selectPdf * lightWeight);
+      lightDist            = contrib.distance;
+      lightPdf             = DIRAC;
     }
     else
     {
-      if(!sampleLights)  // Use this technique for MIS?
-      {
-        vec3 rand_val     = vec3(rand(seed), rand(seed), rand(seed));
-        vec4 radiance_pdf = environmentSample(hdrTexture, rand_val, dirToLight);
-        envPdf            = radiance_pdf.w;
-        radiance          = radiance_pdf.xyz * frameInfo.envIntensity.xyz / (envPdf * envWeight);
-        dirToLight        = rotate(dirToLight, vec3(0, 1, 0), frameInfo.envRotation);
-      }
-      else
+      float pdf;
+      vec3  emissive = sampleEmissiveTriangle(entry, pos, vec2(rand(seed), rand(seed)), dirToLight, pdf, lightDist);
+      if(pdf > 0.0)
       {
-        vec3 dir          = rotate(dirToLight, vec3(0, 1, 0), -frameInfo.envRotation);
-        vec2 uv           = getSphericalUv(dir);
-        vec4 radiance_pdf = textureLod(hdrTexture, uv, 0);
-        envPdf            = radiance_pdf.w;
+        lightPdf = lightWeight * pdf;
+        radiance = emissive / lightPdf;
       }
     }
+    return radiance;
   }
 
-  // MIS weight calculation
-  float misWeight = (sampleLights ? lightPdf : envPdf) / (lightPdf + envPdf);
-  radiance *= misWeight;
-  // Update the total PDF
-  lightPdf = lightWeight * lightPdf + envWeight * envPdf;
-
-  return radiance;
+  // Environment
+  float envPdf = 0.0;
+  if(TEST_FLAG(frameInfo.flags, USE_SKY_FLAG))
+  {
+    vec2              random_sample = vec2(rand(seed), rand(seed));
+    SkySamplingResult skySample     = samplePhysicalSky(skyInfo, random_sample);
+    dirToLight                      = skySample.direction;
+    envPdf                          = skySample.pdf;
+    radiance                        = skySample.radiance;
+  }
+  else
+  {
+    vec3 rand_val     = vec3(rand(seed), rand(seed), rand(seed));
+    vec4 radiance_pdf = environmentSample(hdrTexture, rand_val, dirToLight);
+    envPdf            = radiance_pdf.w;
+    radiance          = radiance_pdf.xyz * frameInfo.envIntensity.xyz;
+    dirToLight        = rotate(dirToLight, vec3(0, 1, 0), frameInfo.envRotation);
+  }
+  if(envPdf <= 0.0)
+    return vec3(0.);
+  lightPdf = envWeight * envPdf;
+  return radiance / lightPdf;
 }
 
 
 //----------------------------------------------------------
 // Testing if the hit is opaque or alpha-transparent
 // Return true is opaque
+// With opacity micromaps, only the unknown micro-triangles of the baked
+// primitives get here, the traversal resolves the others.
 //----------------------------------------------------------
 float getOpacity(RenderNode renderNode, RenderPrimitive renderPrim, int triangleID, vec3 barycentrics)
 {
   // Scene materials
   uint              matIndex = max(0, renderNode.materialID);
   GltfShadeMaterial mat      = GltfMaterialBuf(sceneDesc.materialAddress).m[matIndex];
+  specializeMaterial(mat);
 
   if(mat.alphaMode == ALPHA_OPAQUE)
     return 1.0;
@@ -164,7 +241,7 @@ float getOpacity(RenderNode renderNode, RenderPrimitive renderPrim, int triangle
     if(isTexturePresent(mat.pbrBaseColorTexture))
     {
       // Retrieve the interpolated texture coordinate from the vertex
-      vec2 uv = getInterpolatedVertexTexCoord0(renderPrim, triangleIndex, barycentrics);
+      vec2 uv = fetchInterpolatedTexCoord0(renderPrim, triangleIndex, barycentrics);
 
       baseColorAlpha *= texture(texturesMap[nonuniformEXT(mat.pbrBaseColorTexture.index)], uv).a;
     }
@@ -174,7 +251,7 @@ float getOpacity(RenderNode renderNode, RenderPrimitive renderPrim, int triangle
     baseColorAlpha = mat.pbrDiffuseFactor.a;
     if(isTexturePresent(mat.pbrDiffuseTexture))
     {
-      vec2 uv = getInterpolatedVertexTexCoord0(renderPrim, triangleIndex, barycentrics);
+      vec2 uv = fetchInterpolatedTexCoord0(renderPrim, triangleIndex, barycentrics);
 
       baseColorAlpha *= texture(texturesMap[nonuniformEXT(mat.pbrDiffuseTexture.index)], uv).a;
     }
@@ -201,6 +278,7 @@ vec3 getShadowTransmission(RenderNode      renderNode,
 {
   uint              matIndex = max(0, renderNode.materialID);
   GltfShadeMaterial mat      = GltfMaterialBuf(sceneDesc.materialAddress).m[matIndex];
+  specializeMaterial(mat);
 
   // If hit a non-transmissive surface, terminate with full shadow
   if(mat.transmissionFactor <= MIN_TRANSMISSION)
@@ -216,9 +294,9 @@ vec3 getShadowTransmission(RenderNode      renderNode,
   vec3 normal;
   {
     // Compute geometric normal
-    vec3 v0 = getVertexPosition(renderPrim, indices.x);
-    vec3 v1 = getVertexPosition(renderPrim, indices.y);
-    vec3 v2 = getVertexPosition(renderPrim, indices.z);
+    vec3 v0 = fetchPosition(renderPrim, indices.x);
+    vec3 v1 = fetchPosition(renderPrim, indices.y);
+    vec3 v2 = fetchPosition(renderPrim, indices.z);
     vec3 e1 = v1 - v0;
     vec3 e2 = v2 - v0;
     normal  = normalize(cross(e1, e2));
@@ -261,8 +339,8 @@ vec3 getShadowTransmission(RenderNode      renderNode,
     if(isTexturePresent(mat.pbrMetallicRoughnessTexture))
     {
       vec2 tc[2];
-      tc[0]          = getInterpolatedVertexTexCoord0(renderPrim, indices, barycentrics);
-      tc[1]          = getInterpolatedVertexTexCoord1(renderPrim, indices, barycentrics);
+      tc[0]          = fetchInterpolatedTexCoord0(renderPrim, indices, barycentrics);
+      tc[1]          = fetchInterpolatedTexCoord1(renderPrim, indices, barycentrics);
       vec4 mr_sample = getTexture(mat.pbrMetallicRoughnessTexture, tc);
       roughness *= mr_sample.g;
       metallic *= mr_sample.b;
@@ -316,229 +394,332 @@ Ray getRay(vec2 samplePos, vec2 offset, vec2 imageSize, mat4 projMatrixI, mat4 v
 }
 
 //-----------------------------------------------------------------------
-//
+// State of a path between two bounces, shared by the megakernel
+// (pathTrace) and the wavefront kernels
 //-----------------------------------------------------------------------
-SampleResult pathTrace(Ray r, inout uint seed)
+struct PathState
 {
-  vec3 radiance     = vec3(0.0F);
-  vec3 throughput   = vec3(1.0F);
-  bool isInside     = false;
-  vec2 maxRoughness = vec2(0.0);
+  Ray   ray;            // Next ray of the path
+  vec3  throughput;
+  vec3  radiance;
+  vec2  maxRoughness;   // Subsequent bounces are at least as rough, to prevent fireflies
+  float lastSamplePdf;  // PDF of the BSDF sample which generated the ray, DIRAC for the camera ray
+  bool  isInside;
+};
 
-  SampleResult sampleResult;
-  sampleResult.depth    = 0;
-  sampleResult.normal   = vec3(0, 0, 0);
-  sampleResult.radiance = vec4(0, 0, 0, 1);
+// Next event estimation requested by shadeHit()
+struct ShadowRequest
+{
+  Ray   ray;
+  float maxDist;
+  vec3  contribution;  // Added to the radiance if the light is not occluded
+  bool  valid;
+};
 
-  GltfMaterialBuf materials = GltfMaterialBuf(sceneDesc.materialAddress);
+#define SHADE_CONTINUE 0    // The path continues with path.ray
+#define SHADE_ABSORBED 1    // The path ends, once the shadow ray is resolved
+#define SHADE_TERMINATED 2  // The path ends, path.radiance is final (debug, unlit)
 
-  float lastSamplePdf = DIRAC;
+PathState initPathState(Ray r)
+{
+  PathState path;
+  path.ray           = r;
+  path.throughput    = vec3(1.0F);
+  path.radiance      = vec3(0.0F);
+  path.maxRoughness  = vec2(0.0F);
+  path.lastSamplePdf = DIRAC;
+  path.isInside      = false;
+  return path;
+}
 
-  for(int depth = 0; depth < pc.maxDepth; depth++)
+//-----------------------------------------------------------------------
+// Solid color background and blurred HDR environment, aren't part of the
+// lighting equation (backplate): returns true if the camera rays which
+// do not hit anything see one of them.
+//-----------------------------------------------------------------------
+bool getBackplate(vec3 direction, out vec3 color)
+{
+  color = vec3(0);
+  if(TEST_FLAG(frameInfo.flags, USE_SOLID_BACKGROUND_FLAG))
   {
-    bool firstRay = (depth == 0);
-    traceRay(r, seed);
-
-    HitState hit = hitPayload.hit;
+    color = frameInfo.backgroundColor;
+    return true;
+  }
+  if(TEST_FLAG(frameInfo.flags, USE_HDR_FLAG) && frameInfo.envBlur > 0)
+  {
+    vec3 dir = rotate(direction, vec3(0, 1, 0), -frameInfo.envRotation);
+    vec2 uv  = getSphericalUv(dir);  // See sampling.glsl
+    color    = smoothHDRBlur(hdrTexture, uv, frameInfo.envBlur).xyz * frameInfo.envIntensity.xyz;
+    return true;
+  }
+  return false;
+}
 
-    // Hitting the environment, then exit
-    if(hitPayload.hitT == INFINITE)
-    {
-      if(firstRay)  // If we come in here, the first ray didn't hit anything
-      {
-        sampleResult.radiance.a = 0.0;  // Set it to transparent
+//-----------------------------------------------------------------------
+// The path leaves the scene: adding the sky or HDR texture
+//-----------------------------------------------------------------------
+void addEnvironment(inout PathState path)
+{
+  vec3  envColor;
+  float envPdf;
+  if(TEST_FLAG(frameInfo.flags, USE_SKY_FLAG))
+  {
+    envColor = evalPhysicalSky(skyInfo, path.ray.direction);
+    envPdf   = samplePhysicalSkyPDF(skyInfo, path.ray.direction);
+  }
+  else
+  {
+    // Adding HDR lookup
+    vec3 dir = rotate(path.ray.direction, vec3(0, 1, 0), -frameInfo.envRotation);
+    vec2 uv  = getSphericalUv(dir);  // See sampling.glsl
+    vec4 env = textureLod(hdrTexture, uv, 0);
+    envColor = env.rgb * frameInfo.envIntensity.xyz;
+    envPdf   = env.w;
+  }
 
-        // Solid color background and blurred HDR environment, aren't part of the
-        // lighting equation (backplate), so we can return them directly.
-        if(TEST_FLAG(frameInfo.flags, USE_SOLID_BACKGROUND_FLAG))
-        {
-          sampleResult.radiance.xyz = frameInfo.backgroundColor;
-          return sampleResult;
-        }
-        else if(TEST_FLAG(frameInfo.flags, USE_HDR_FLAG) && frameInfo.envBlur > 0)
-        {
-          vec3 dir                  = rotate(r.direction, vec3(0, 1, 0), -frameInfo.envRotation);
-          vec2 uv                   = getSphericalUv(dir);  // See sampling.glsl
-          sampleResult.radiance.xyz = smoothHDRBlur(hdrTexture, uv, frameInfo.envBlur).xyz * frameInfo.envIntensity.xyz;
-          return sampleResult;
-        }
-      }
+  // We may hit the environment twice: once via sampleLights() and once when hitting the sky while probing
+  // for more indirect hits. This is the counter part of the MIS weighting in shadeHit()
+  float lightWeight, envWeight;
+  lightSelectionWeights(lightWeight, envWeight);
+  envPdf *= envWeight;
+  float misWeight = (path.lastSamplePdf == DIRAC) ? 1.0 : (path.lastSamplePdf / (path.lastSamplePdf + envPdf));
+  path.radiance += path.throughput * misWeight * envColor;
+}
 
-      // Add sky or HDR texture
-      vec3  envColor;
-      float envPdf;
-      if(TEST_FLAG(frameInfo.flags, USE_SKY_FLAG))
-      {
-        envColor = evalPhysicalSky(skyInfo, r.direction);
-        envPdf   = samplePhysicalSkyPDF(skyInfo, r.direction);
-      }
-      else
-      {
-        // Adding HDR lookup
-        vec3 dir = rotate(r.direction, vec3(0, 1, 0), -frameInfo.envRotation);
-        vec2 uv  = getSphericalUv(dir);  // See sampling.glsl
-        vec4 env = textureLod(hdrTexture, uv, 0);
-        envColor = env.rgb * frameInfo.envIntensity.xyz;
-        envPdf   = env.w;
-      }
+//-----------------------------------------------------------------------
+// Shading of a hit: emission, light sampling and BSDF sampling of the
+// next ray. The shadow ray of the light sample is returned, the caller
+// traces it (megakernel) or queues it (wavefront).
+//-----------------------------------------------------------------------
+int shadeHit(inout PathState path, HitState hit, float hitT, int rnodeID, int triangleID, bool firstRay, inout uint seed, out ShadowRequest shadow)
+{
+  shadow.valid = false;
 
-      // We may hit the environment twice: once via sampleLights() and once when hitting the sky while probing
-      // for more indirect hits. This is the counter part of the MIS weighting in sampleLights()
-      float misWeight = (lastSamplePdf == DIRAC) ? 1.0 : (lastSamplePdf / (lastSamplePdf + envPdf));
-      radiance += throughput * misWeight * envColor;
+  // Retrieve the Instance buffer information
+  RenderNode renderNode = RenderNodeBuf(sceneDesc.renderNodeAddress)._[rnodeID];
 
-      sampleResult.radiance.xyz = radiance;
-      return sampleResult;
-    }
+  // Setting up the material
+  GltfShadeMaterial material = GltfMaterialBuf(sceneDesc.materialAddress).m[renderNode.materialID];  // Material of the hit object
+  specializeMaterial(material);
+  material.pbrBaseColorFactor *= hit.color;  // Color at vertices
+  writeTextureFeedback(renderNode.materialID, firstRay ? TEXTURE_FEEDBACK_FULL : TEXTURE_FEEDBACK_INDIRECT);
+  MeshState   mesh   = MeshState(hit.nrm, hit.tangent, hit.bitangent, hit.geonrm, hit.uv, path.isInside);
+  PbrMaterial pbrMat = evaluateMaterial(material, mesh);
+
+  // Keep track of the maximum roughness to prevent firefly artifacts
+  // by forcing subsequent bounces to be at least as rough
+  path.maxRoughness = max(pbrMat.roughness, path.maxRoughness);
+  pbrMat.roughness  = path.maxRoughness;
+
+  // Debugging, single frame
+  if(pc.dbgMethod != eDbgMethod_none && firstRay)
+  {
+    path.radiance = debugValue(pbrMat, hit, pc.dbgMethod);
+    return SHADE_TERMINATED;
+  }
 
-    if(depth == 0)
+  // Adding emissive, weighted against the light sampling of the triangle
+  if(any(greaterThan(pbrMat.emissive, vec3(0.0))))
+  {
+    float misWeight = 1.0;
+    if(path.lastSamplePdf != DIRAC)
     {
-      sampleResult.normal = hit.nrm;
-      sampleResult.depth  = hitPayload.hitT;
+      float lightPdf = emissiveHitPdf(rnodeID, triangleID, path.ray.direction, hitT, hit.geonrm);
+      misWeight      = path.lastSamplePdf / (path.lastSamplePdf + lightPdf);
     }
+    path.radiance += pbrMat.emissive * path.throughput * misWeight;
+  }
 
-    // Retrieve the Instance buffer information
-    RenderNode      renderNode = RenderNodeBuf(sceneDesc.renderNodeAddress)._[hitPayload.rnodeID];
-    RenderPrimitive renderPrim = RenderPrimitiveBuf(sceneDesc.renderPrimitiveAddress)._[hitPayload.rprimID];
+  // Unlit
+  if(material.unlit > 0)
+  {
+    path.radiance += pbrMat.baseColor;
+    return SHADE_TERMINATED;
+  }
 
-    // Setting up the material
-    GltfShadeMaterial material = materials.m[renderNode.materialID];  // Material of the hit object
-    material.pbrBaseColorFactor *= hit.color;                         // Color at vertices
-    MeshState   mesh   = MeshState(hit.nrm, hit.tangent, hit.bitangent, hit.geonrm, hit.uv, isInside);
-    PbrMaterial pbrMat = evaluateMaterial(material, mesh);
+  // Apply volume attenuation
+  if(path.isInside && !pbrMat.isThinWalled)
+  {
+    const vec3 abs_coeff = absorptionCoefficient(pbrMat);
+    path.throughput *= exp(-hitT * abs_coeff);
+  }
 
-    // Keep track of the maximum roughness to prevent firefly artifacts
-    // by forcing subsequent bounces to be at least as rough
-    maxRoughness     = max(pbrMat.roughness, maxRoughness);
-    pbrMat.roughness = maxRoughness;
+  // Light contribution; can be environment or punctual lights
+  vec3  contribution         = vec3(0);
+  vec3  dirToLight           = vec3(0);
+  float lightPdf             = 0.F;
+  float lightDist            = 0.F;
+  vec3  lightRadianceOverPdf = sampleLights(hit.pos, pbrMat.N, path.ray.direction, seed, dirToLight, lightPdf, lightDist);
 
-    // Debugging, single frame
-    if(pc.dbgMethod != eDbgMethod_none && firstRay)
-    {
-      sampleResult.radiance.xyz = debugValue(pbrMat, hit, pc.dbgMethod);
-      sampleResult.radiance.a   = 1.0;
-      return sampleResult;
-    }
+  // Do not next event estimation (but delay the adding of contribution)
+  bool nextEventValid = (dot(dirToLight, hit.geonrm) > 0.0f || pbrMat.diffuseTransmissionFactor > 0.0f) && lightPdf != 0.0f;
 
-    // Adding emissive
-    radiance += pbrMat.emissive * throughput;
+  // Evaluate BSDF for Light
+  if(nextEventValid)
+  {
+    BsdfEvaluateData evalData;
+    evalData.k1 = -path.ray.direction;
+    evalData.k2 = dirToLight;
+    evalData.xi = vec3(rand(seed), rand(seed), rand(seed));
 
-    // Unlit
-    if(material.unlit > 0)
-    {
-      radiance += pbrMat.baseColor;
-      sampleResult.radiance.xyz = radiance;
-      sampleResult.radiance.a   = 1.0;
-      return sampleResult;
-    }
+    bsdfEvaluate(evalData, pbrMat);
 
-    // Apply volume attenuation
-    if(isInside && !pbrMat.isThinWalled)
+    if(evalData.pdf > 0.0)
     {
-      const vec3 abs_coeff = absorptionCoefficient(pbrMat);
-      throughput *= exp(-hitPayload.hitT * abs_coeff);
+      const float mis_weight = (lightPdf == DIRAC) ? 1.0f : lightPdf / (lightPdf + evalData.pdf);
+
+      // sample weight
+      const vec3 w = path.throughput * lightRadianceOverPdf * mis_weight;
+      contribution += w * evalData.bsdf_diffuse;
+      contribution += w * evalData.bsdf_glossy;
     }
+  }
 
-    // Light contribution; can be environment or punctual lights
-    vec3  contribution         = vec3(0);
-    vec3  dirToLight           = vec3(0);
-    float lightPdf             = 0.F;
-    float lightDist            = 0.F;
-    vec3  lightRadianceOverPdf = sampleLights(hit.pos, pbrMat.N, r.direction, seed, dirToLight, lightPdf, lightDist);
+  // Sample BSDF
+  int result = SHADE_CONTINUE;
+  {
+    BsdfSampleData sampleData;
+    sampleData.k1            = -path.ray.direction;  // outgoing direction
+    sampleData.xi            = vec3(rand(seed), rand(seed), rand(seed));
+    sampleData.event_type    = 0;                    ///< output: the type of event for the generated sample
+    sampleData.pdf           = 0.0;                  // output: pdf (non-projected hemisphere)
+    sampleData.bsdf_over_pdf = vec3(0.0, 0.0, 0.0);  ///< output: bsdf * dot(normal, k2) / pdf
 
-    // Do not next event estimation (but delay the adding of contribution)
-    bool nextEventValid = (dot(dirToLight, hit.geonrm) > 0.0f || pbrMat.diffuseTransmissionFactor > 0.0f) && lightPdf != 0.0f;
+    bsdfSample(sampleData, pbrMat);
 
-    // Evaluate BSDF for Light
-    if(nextEventValid)
+    path.throughput *= sampleData.bsdf_over_pdf;
+    path.ray.direction = sampleData.k2;
+    path.lastSamplePdf = sampleData.pdf;
+
+    if(sampleData.event_type == BSDF_EVENT_ABSORB)
+    {
+      // Exit tracing rays, but still finish this iteration; in particular the visibility test
+      // for the light that we may have hit.
+      result = SHADE_ABSORBED;
+    }
+    else
     {
-      BsdfEvaluateData evalData;
-      evalData.k1 = -r.direction;
-      evalData.k2 = dirToLight;
-      evalData.xi = vec3(rand(seed), rand(seed), rand(seed));
+      // Continue path
+      bool isSpecular     = (sampleData.event_type & BSDF_EVENT_IMPULSE) != 0;
+      bool isTransmission = (sampleData.event_type & BSDF_EVENT_TRANSMISSION) != 0;
 
-      bsdfEvaluate(evalData, pbrMat);
+      vec3 offsetDir  = dot(path.ray.direction, hit.geonrm) > 0 ? hit.geonrm : -hit.geonrm;
+      path.ray.origin = offsetRay(hit.pos, offsetDir);
 
-      if(evalData.pdf > 0.0)
+      // Flip the information if we are inside the object, but only if it is a solid object
+      // The doubleSided flag is used to know if the object is solid or thin-walled.
+      // This is not a glTF specification, but works in many cases.
+      if(isTransmission)
       {
-        const float mis_weight = (lightPdf == DIRAC) ? 1.0f : lightPdf / (lightPdf + evalData.pdf);
-
-        // sample weight
-        const vec3 w = throughput * lightRadianceOverPdf * mis_weight;
-        contribution += w * evalData.bsdf_diffuse;
-        contribution += w * evalData.bsdf_glossy;
+        path.isInside = !path.isInside;
       }
     }
+  }
 
-    // Sample BSDF
-    {
-      BsdfSampleData sampleData;
-      sampleData.k1            = -r.direction;  // outgoing direction
-      sampleData.xi            = vec3(rand(seed), rand(seed), rand(seed));
-      sampleData.event_type    = 0;                    ///< output: the type of event for the generated sample
-      sampleData.pdf           = 0.0;                  // output: pdf (non-projected hemisphere)
-      sampleData.bsdf_over_pdf = vec3(0.0, 0.0, 0.0);  ///< output: bsdf * dot(normal, k2) / pdf
+  // We are adding the contribution to the radiance only if the ray is not occluded by an object.
+  if(nextEventValid)
+  {
+    // shadow origin is the hit position offset by a small amount in the direction of the light
+    vec3 shadowRayOrigin = offsetRay(hit.pos, (dot(dirToLight, hit.geonrm) > 0.0f) ? hit.geonrm : -hit.geonrm);
+    shadow.ray           = Ray(shadowRayOrigin, dirToLight);
+    shadow.maxDist       = lightDist;
+    shadow.contribution  = contribution;
+    shadow.valid         = true;
+  }
 
-      bsdfSample(sampleData, pbrMat);
+  return result;
+}
 
-      throughput *= sampleData.bsdf_over_pdf;
-      r.direction   = sampleData.k2;
-      lastSamplePdf = sampleData.pdf;
+//-----------------------------------------------------------------------
+// Russian-Roulette (minimizing live state): returns false if the path,
+// with a low throughput that won't contribute, is terminated
+//-----------------------------------------------------------------------
+bool continuePath(inout PathState path, inout uint seed)
+{
+#if USE_RUSIAN_ROULETTE
+  float rrPcont = min(max(path.throughput.x, max(path.throughput.y, path.throughput.z)) + 0.001F, 0.95F);
+  if(rand(seed) >= rrPcont)
+    return false;
+  path.throughput /= rrPcont;  // boost the energy of the non-terminated paths
+#endif
+  return true;
+}
 
-      if(sampleData.event_type == BSDF_EVENT_ABSORB)
-      {
-        // Exit tracing rays, but still finish this iteration; in particular the visibility test
-        // for the light that we may have hit.
-        depth = pc.maxDepth;
-      }
-      else
-      {
-        // Continue path
-        bool isSpecular     = (sampleData.event_type & BSDF_EVENT_IMPULSE) != 0;
-        bool isTransmission = (sampleData.event_type & BSDF_EVENT_TRANSMISSION) != 0;
+//-----------------------------------------------------------------------
+//
+//-----------------------------------------------------------------------
+SampleResult pathTrace(Ray r, inout uint seed)
+{
+  PathState path = initPathState(r);
 
-        vec3 offsetDir = dot(r.direction, hit.geonrm) > 0 ? hit.geonrm : -hit.geonrm;
-        r.origin       = offsetRay(hit.pos, offsetDir);
+  SampleResult sampleResult;
+  sampleResult.depth    = 0;
+  sampleResult.normal   = vec3(0, 0, 0);
+  sampleResult.radiance = vec4(0, 0, 0, 1);
+  sampleResult.rnodeID  = -1;
 
-        // Flip the information if we are inside the object, but only if it is a solid object
-        // The doubleSided flag is used to know if the object is solid or thin-walled.
-        // This is not a glTF specification, but works in many cases.
-        if(isTransmission)
+  for(int depth = 0; depth < pc.maxDepth; depth++)
+  {
+    bool firstRay = (depth == 0);
+    traceRay(path.ray, seed);
+
+    HitState hit = hitPayload.hit;
+
+    // Hitting the environment, then exit
+    if(hitPayload.hitT == INFINITE)
+    {
+      if(firstRay)  // If we come in here, the first ray didn't hit anything
+      {
+        sampleResult.radiance.a = 0.0;  // Set it to transparent
+        vec3 backplate;
+        if(getBackplate(path.ray.direction, backplate))
         {
-          isInside = !isInside;
+          sampleResult.radiance.xyz = backplate;
+          return sampleResult;
         }
       }
+
+      addEnvironment(path);
+      sampleResult.radiance.xyz = path.radiance;
+      return sampleResult;
+    }
+
+    if(depth == 0)
+    {
+      sampleResult.normal  = hit.nrm;
+      sampleResult.depth   = hitPayload.hitT;
+      sampleResult.rnodeID = hitPayload.rnodeID;
+    }
+
+    ShadowRequest shadow;
+    int           result = shadeHit(path, hit, hitPayload.hitT, hitPayload.rnodeID, hitPayload.triangleID, firstRay, seed, shadow);
+    if(result == SHADE_TERMINATED)
+    {
+      sampleResult.radiance.xyz = path.radiance;
+      sampleResult.radiance.a   = 1.0;
+      return sampleResult;
     }
 
     // We are adding the contribution to the radiance only if the ray is not occluded by an object.
-    if(nextEventValid)
+    if(shadow.valid)
     {
-      // shadow origin is the hit position offset by a small amount in the direction of the light
-      vec3 shadowRayOrigin = offsetRay(hit.pos, (dot(dirToLight, hit.geonrm) > 0.0f) ? hit.geonrm : -hit.geonrm);
-      Ray  shadowRay       = Ray(shadowRayOrigin, dirToLight);
-      vec3 shadowFactor    = traceShadow(shadowRay, lightDist, seed);
-      // We are adding the contribution to the radiance only if the ray is not occluded by an object.
-      radiance += contribution * shadowFactor;
+      vec3 shadowFactor = traceShadow(shadow.ray, shadow.maxDist, seed);
+      path.radiance += shadow.contribution * shadowFactor;
     }
 
-#if USE_RUSIAN_ROULETTE
-    // Russian-Roulette (minimizing live state)
-    float rrPcont = min(max(throughput.x, max(throughput.y, throughput.z)) + 0.001F, 0.95F);
-    if(rand(seed) >= rrPcont)
-      break;                // paths with low throughput that won't contribute
-    throughput /= rrPcont;  // boost the energy of the non-terminated paths
-#endif
+    if(result == SHADE_ABSORBED || !continuePath(path, seed))
+      break;
   }
 
-  sampleResult.radiance.xyz = radiance;
+  sampleResult.radiance.xyz = path.radiance;
   return sampleResult;
 }
 
 
 //-----------------------------------------------------------------------
-// Sampling the pixel
+// Camera ray through the sample, with Depth-of-Field
 //-----------------------------------------------------------------------
-SampleResult samplePixel(inout uint seed, vec2 samplePos, vec2 subpixelJitter, vec2 imageSize, mat4 projMatrixI, mat4 viewMatrixI, float focalDist, float aperture)
+Ray getCameraRay(inout uint seed, vec2 samplePos, vec2 subpixelJitter, vec2 imageSize, mat4 projMatrixI, mat4 viewMatrixI, float focalDist, float aperture)
 {
   Ray ray = getRay(samplePos, subpixelJitter, imageSize, projMatrixI, viewMatrixI);
 
@@ -551,22 +732,94 @@ SampleResult samplePixel(inout uint seed, vec2 samplePos, vec2 subpixelJitter, v
   vec3  randomAperturePos = (cos(cam_r1) * cam_right.xyz + sin(cam_r1) * cam_up.xyz) * sqrt(cam_r2);
   vec3  finalRayDir       = normalize(focalPoint - randomAperturePos);
 
-  ray = Ray(ray.origin + randomAperturePos, finalRayDir);
-
-  SampleResult sampleResult = pathTrace(ray, seed);
+  return Ray(ray.origin + randomAperturePos, finalRayDir);
+}
 
 // Removing fireflies
+vec4 fireflyFilter(vec4 radiance)
+{
 #if USE_FIREFLY_FILTER
-  float lum = dot(sampleResult.radiance.xyz, vec3(1.0F / 3.0F));
+  float lum = dot(radiance.xyz, vec3(1.0F / 3.0F));
   if(lum > pc.maxLuminance)
   {
-    sampleResult.radiance *= pc.maxLuminance / lum;
+    radiance *= pc.maxLuminance / lum;
   }
 #endif
+  return radiance;
+}
+
+//-----------------------------------------------------------------------
+// Sampling the pixel
+//-----------------------------------------------------------------------
+SampleResult samplePixel(inout uint seed, vec2 samplePos, vec2 subpixelJitter, vec2 imageSize, mat4 projMatrixI, mat4 viewMatrixI, float focalDist, float aperture)
+{
+  Ray ray = getCameraRay(seed, samplePos, subpixelJitter, imageSize, projMatrixI, viewMatrixI, focalDist, aperture);
 
+  SampleResult sampleResult = pathTrace(ray, seed);
+  sampleResult.radiance     = fireflyFilter(sampleResult.radiance);
   return sampleResult;
 }
 
+//-----------------------------------------------------------------------
+// Adaptive sampling
+// varianceImage has the statistics of the luminance of each pixel: mean, sum of the
+// squared differences (Welford) and number of samples. After each frame,
+// adaptive.comp.glsl masks the tiles which have converged.
+//-----------------------------------------------------------------------
+int adaptiveSampleCount(vec2 samplePos)
+{
+  if(pc.adaptiveThreshold <= 0.0 || frameInfo.frameCount == 0)
+    return pc.maxSamples;
+
+  uvec2 tile = uvec2(samplePos) / ADAPTIVE_TILE_SIZE;
+  if(tileMask[tile.y * adaptiveInfo.tilesX + tile.x] == 0)
+    return 0;
+
+  // The samples saved on the converged tiles go to the others
+  float boost = min(float(adaptiveInfo.numTiles) / float(max(adaptiveInfo.activeTiles, 1)), ADAPTIVE_MAX_BOOST);
+  return max(1, int(float(pc.maxSamples) * boost + 0.5));
+}
+
+void addSampleStatistics(inout vec4 stats, vec4 radiance)
+{
+  float lum   = dot(radiance.xyz, vec3(1.0F / 3.0F));
+  float delta = lum - stats.x;
+  stats.z += 1.0;
+  stats.x += delta / stats.z;
+  stats.y += delta * (lum - stats.x);
+}
+
+//-----------------------------------------------------------------------
+// Temporal reprojection
+// At the first frame of an accumulation, motionImage has the offset to the pixel of
+// the previous frame, and the distance to the previous camera which the history must
+// have. The hit at the center of the pixel is at 'depth', or the environment at 0.
+//-----------------------------------------------------------------------
+void storeMotion(vec2 samplePos, vec2 imageSize, float depth)
+{
+  Ray ray = getRay(samplePos, vec2(0.5), imageSize, frameInfo.projMatrixI, frameInfo.viewMatrixI);
+
+  vec4  prevClip;
+  float prevDepth = 0.0;
+  if(depth > 0.0)
+  {
+    vec3 worldPos = ray.origin + ray.direction * depth;
+    prevClip      = frameInfo.prevViewProjMatrix * vec4(worldPos, 1.0);
+    prevDepth     = distance(worldPos, frameInfo.prevCamPos);
+  }
+  else
+  {
+    prevClip = frameInfo.prevViewProjMatrix * vec4(ray.direction, 0.0);  // Direction, at infinity
+  }
+
+  // Behind the previous camera: out of the history
+  vec2 prevPixel = vec2(-1.0);
+  if(prevClip.w > 0.0)
+    prevPixel = (prevClip.xy / prevClip.w * 0.5 + 0.5) * imageSize;
+  vec2 motion = clamp(prevPixel - (samplePos + 0.5), -imageSize, imageSize);
+  imageStore(motionImage, ivec2(samplePos), vec4(motion, prevDepth, 0.0));
+}
+
 
 //---
 vec3 debugRendering(vec2 samplePos, vec2 imageSize)
@@ -588,6 +841,7 @@ vec3 debugRendering(vec2 samplePos, vec2 imageSize)
   // Setting up the material
   GltfMaterialBuf   materials = GltfMaterialBuf(sceneDesc.materialAddress);  // Buffer of materials
   GltfShadeMaterial material  = materials.m[renderNode.materialID];          // Material of the hit object
+  specializeMaterial(material);
   MeshState         mesh      = MeshState(hit.nrm, hit.tangent, hit.bitangent, hit.geonrm, hit.uv, false);
   PbrMaterial       pbrMat    = evaluateMaterial(material, mesh);
 
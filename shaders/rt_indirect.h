@@ -63,13 +63,15 @@ void traceRay(Ray ray, inout uint seed)
     RenderNode      renderNode = RenderNodeBuf(sceneDesc.renderNodeAddress)._[instanceID];
     RenderPrimitive renderPrim = RenderPrimitiveBuf(sceneDesc.renderPrimitiveAddress)._[renderPrimID];
 
-    hitPayload.hitT    = hitT;
-    hitPayload.rnodeID = instanceID;
-    hitPayload.rprimID = renderPrimID;  // Should be equal to renderNode.rprimID
+    hitPayload.hitT       = hitT;
+    hitPayload.rnodeID    = instanceID;
+    hitPayload.rprimID    = renderPrimID;  // Should be equal to renderNode.rprimID
+    hitPayload.triangleID = triangleID;
 
     const vec3 barycentrics = vec3(1.0 - bary.x - bary.y, bary.x, bary.y);
 
     hitPayload.hit = getHitState(renderPrim, barycentrics, triangleID, worldRayOrigin, objectToWorld, worldToObject);
+    setTracedHitPosition(renderPrim, hitPayload.hit, worldRayOrigin, worldRayDirection, hitT);
   }
   else
   {
@@ -9,7 +9,9 @@
 #include "nvvkhl/shaders/vertex_accessor.h"
 
 // clang-format off
+#ifndef RT_CUSTOM_PUSH_CONSTANT // The wavefront kernels extend it
 layout(push_constant, scalar)                   uniform                             RtxPushConstant_ { PushConstantPathtracer pc; };
+#endif
 
 layout(buffer_reference, scalar)                readonly buffer                     GltfMaterialBuf  { GltfShadeMaterial m[]; };
 layout(buffer_reference, scalar)                readonly buffer                     RenderLightBuf  { Light _[]; };
@@ -19,11 +21,17 @@ layout(set = 0, binding = eTlas)					uniform accelerationStructureEXT    topLeve
 layout(set = 0, binding = eOutImage, rgba32f)		uniform image2D                     image;
 layout(set = 0, binding = eNormalDepth, rgba32f)	uniform image2D						normalDepth;
 layout(set = 0, binding = eSelect)					uniform image2D                     selectImage;
+layout(set = 0, binding = eVariance, rgba32f)		uniform image2D                     varianceImage;
+layout(set = 0, binding = eAdaptiveTiles, scalar)	readonly buffer                     AdaptiveTiles_  { AdaptiveInfo adaptiveInfo; uint tileMask[]; };
+layout(set = 0, binding = eMotion, rgba16f)		uniform image2D                     motionImage;
 
 // Scene (shared with raster)
 layout(set = 1, binding = eFrameInfo, scalar)		uniform                             FrameInfo_      { SceneFrameInfo frameInfo; };
 layout(set = 1, binding = eSceneDesc, scalar)		readonly buffer                     SceneDesc_      { SceneDescription sceneDesc; };
 layout(set = 1, binding = eTextures)				uniform sampler2D                   texturesMap[]; // all textures
+layout(set = 1, binding = eTextureFeedback)		buffer                              TextureFeedback_ { uint textureFeedback[]; };
+layout(set = 1, binding = eLightSampling, scalar)	readonly buffer                     LightSampling_  { LightSamplingInfo lightInfo; LightEntry lightEntries[]; };
+layout(set = 1, binding = eEmissiveNodes)			readonly buffer                     EmissiveNodes_  { uint emissiveNodes[]; };
 
 // Sun & Sky information
 layout(set = 2, binding = eSkyParam, scalar)		uniform                             SkyInfo_        { PhysicalSkyParameters  skyInfo; };
@@ -0,0 +1,97 @@
+#ifndef SCENE_FEATURES_H
+#define SCENE_FEATURES_H
+
+//-----------------------------------------------------------------------
+// Features of the scene, specialization of the path tracer
+// The scene scans the material extensions and the lights in use
+// (Scene::shaderFeatures), the pipelines of the path tracer are created
+// with the mask as SCENE_FEATURES, one variant per mask. The unused
+// features are stripped: their material values are set to the defaults,
+// such that the compiler removes their texture fetches and the branches
+// of the BSDF.
+
+#define SCENE_FEATURE_CLEARCOAT (1 << 0)              // KHR_materials_clearcoat
+#define SCENE_FEATURE_SHEEN (1 << 1)                  // KHR_materials_sheen
+#define SCENE_FEATURE_TRANSMISSION (1 << 2)           // KHR_materials_transmission
+#define SCENE_FEATURE_VOLUME (1 << 3)                 // KHR_materials_volume
+#define SCENE_FEATURE_IRIDESCENCE (1 << 4)            // KHR_materials_iridescence
+#define SCENE_FEATURE_ANISOTROPY (1 << 5)             // KHR_materials_anisotropy
+#define SCENE_FEATURE_DISPERSION (1 << 6)             // KHR_materials_dispersion
+#define SCENE_FEATURE_DIFFUSE_TRANSMISSION (1 << 7)   // KHR_materials_diffuse_transmission
+#define SCENE_FEATURE_SPECULAR (1 << 8)               // KHR_materials_specular
+#define SCENE_FEATURE_SPECULAR_GLOSSINESS (1 << 9)    // KHR_materials_pbrSpecularGlossiness
+#define SCENE_FEATURE_UNLIT (1 << 10)                 // KHR_materials_unlit
+#define SCENE_FEATURE_PUNCTUAL_LIGHTS (1 << 11)       // KHR_lights_punctual
+#define SCENE_FEATURE_EMISSIVE_TRIANGLES (1 << 12)    // Emissive materials, in the light table
+#define SCENE_FEATURE_ALL ((1 << 13) - 1)
+
+#define SCENE_FEATURES_CONSTANT_ID 1  // 0 is USE_SER or WAVEFRONT_STAGE
+
+#ifndef __cplusplus
+layout(constant_id = SCENE_FEATURES_CONSTANT_ID) const int SCENE_FEATURES = SCENE_FEATURE_ALL;
+
+bool hasSceneFeature(int feature)
+{
+  return (SCENE_FEATURES & feature) != 0;
+}
+
+// The material without the features absent from the scene
+void specializeMaterial(inout GltfShadeMaterial mat)
+{
+  if(!hasSceneFeature(SCENE_FEATURE_CLEARCOAT))
+  {
+    mat.clearcoatFactor                 = 0.0;
+    mat.clearcoatTexture.index          = -1;
+    mat.clearcoatRoughnessTexture.index = -1;
+    mat.clearcoatNormalTexture.index    = -1;
+  }
+  if(!hasSceneFeature(SCENE_FEATURE_SHEEN))
+  {
+    mat.sheenColorFactor            = vec3(0.0);
+    mat.sheenColorTexture.index     = -1;
+    mat.sheenRoughnessTexture.index = -1;
+  }
+  if(!hasSceneFeature(SCENE_FEATURE_TRANSMISSION))
+  {
+    mat.transmissionFactor        = 0.0;
+    mat.transmissionTexture.index = -1;
+  }
+  if(!hasSceneFeature(SCENE_FEATURE_VOLUME))
+  {
+    mat.thicknessFactor        = 0.0;  // Thin walled, no attenuation
+    mat.thicknessTexture.index = -1;
+  }
+  if(!hasSceneFeature(SCENE_FEATURE_IRIDESCENCE))
+  {
+    mat.iridescenceFactor                 = 0.0;
+    mat.iridescenceTexture.index          = -1;
+    mat.iridescenceThicknessTexture.index = -1;
+  }
+  if(!hasSceneFeature(SCENE_FEATURE_ANISOTROPY))
+  {
+    mat.anisotropyStrength      = 0.0;
+    mat.anisotropyTexture.index = -1;
+  }
+  if(!hasSceneFeature(SCENE_FEATURE_DISPERSION))
+    mat.dispersion = 0.0;
+  if(!hasSceneFeature(SCENE_FEATURE_DIFFUSE_TRANSMISSION))
+  {
+    mat.diffuseTransmissionFactor             = 0.0;
+    mat.diffuseTransmissionTexture.index      = -1;
+    mat.diffuseTransmissionColorTexture.index = -1;
+  }
+  if(!hasSceneFeature(SCENE_FEATURE_SPECULAR))
+  {
+    mat.specularFactor             = 1.0;
+    mat.specularTexture.index      = -1;
+    mat.specularColorFactor        = vec3(1.0);
+    mat.specularColorTexture.index = -1;
+  }
+  if(!hasSceneFeature(SCENE_FEATURE_SPECULAR_GLOSSINESS))
+    mat.usePbrSpecularGlossiness = 0;
+  if(!hasSceneFeature(SCENE_FEATURE_UNLIT))
+    mat.unlit = 0;
+}
+#endif  // __cplusplus
+
+#endif  // SCENE_FEATURES_H
@@ -0,0 +1,28 @@
+#ifndef TEXTURE_FEEDBACK_H
+#define TEXTURE_FEEDBACK_H
+
+//-----------------------------------------------------------------------
+// Texture streaming feedback (see TextureStreamer)
+// textureFeedback[materialID] holds 1 + log2 of the texture resolution needed
+// by the material, 0 when it wasn't seen. The buffer is declared by the layout
+// of the shader including this file.
+
+#define TEXTURE_FEEDBACK_FULL 15     // Largest resolution: 32k
+#define TEXTURE_FEEDBACK_INDIRECT 9  // Resolution for indirect hits: 512
+
+// log2 of the resolution where one texel covers one pixel
+uint textureFootprint(vec2 uvDx, vec2 uvDy)
+{
+  float d = max(length(uvDx), length(uvDy));
+  return uint(clamp(ceil(-log2(max(d, 1e-6))), 0.0, float(TEXTURE_FEEDBACK_FULL)));
+}
+
+void writeTextureFeedback(int materialID, uint log2Resolution)
+{
+  uint value = log2Resolution + 1;
+  // Reading first avoids most atomics, as many pixels share the same material
+  if(materialID >= 0 && materialID < MAX_FEEDBACK_MATERIALS && textureFeedback[materialID] < value)
+    atomicMax(textureFeedback[materialID], value);
+}
+
+#endif  // TEXTURE_FEEDBACK_H
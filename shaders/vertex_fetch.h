@@ -0,0 +1,82 @@
+#ifndef VERTEX_FETCH_H
+#define VERTEX_FETCH_H
+
+//-----------------------------------------------------------------------
+// Vertex attributes of a render primitive, in the format of SceneVk or in
+// the compact one (see compact_vertices.h). The compact primitives have their
+// position address tagged, the others use the accessors of nvvkhl.
+
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+#extension GL_EXT_buffer_reference2 : require
+#extension GL_EXT_scalar_block_layout : require
+
+#include "nvvkhl/shaders/dh_scn_desc.h"
+#include "nvvkhl/shaders/vertex_accessor.h"
+#include "compact_vertices.h"
+
+// clang-format off
+layout(buffer_reference, scalar) readonly buffer CompactHeader_ { CompactHeader h; };
+layout(buffer_reference, scalar) readonly buffer CompactPositions_ { uvec2 v[]; };
+layout(buffer_reference, scalar) readonly buffer CompactAttributes_ { uint v[]; };
+// clang-format on
+
+bool isCompact(in RenderPrimitive renderPrim)
+{
+  return (renderPrim.vertexBuffer.positionAddress & uint64_t(COMPACT_VERTEX_TAG)) != 0;
+}
+
+uint64_t compactAddress(uint64_t address)
+{
+  return address & ~uint64_t(COMPACT_VERTEX_TAG);
+}
+
+vec3 fetchPosition(in RenderPrimitive renderPrim, in uint idx)
+{
+  if(!isCompact(renderPrim))
+    return getVertexPosition(renderPrim, idx);
+  uint64_t      address = compactAddress(renderPrim.vertexBuffer.positionAddress);
+  CompactHeader header  = CompactHeader_(address).h;
+  uvec2         q       = CompactPositions_(address + COMPACT_HEADER_SIZE).v[idx];
+  return header.boundsMin + header.boundsExtent * vec3(unpackUnorm2x16(q.x), unpackUnorm2x16(q.y).x);
+}
+
+vec3 fetchInterpolatedNormal(in RenderPrimitive renderPrim, in uvec3 idx, in vec3 barycentrics)
+{
+  if(!isCompact(renderPrim))
+    return getInterpolatedVertexNormal(renderPrim, idx, barycentrics);
+  CompactAttributes_ normals = CompactAttributes_(renderPrim.vertexBuffer.normalAddress);
+  vec3               n0      = octDecode(unpackSnorm2x16(normals.v[idx.x]));
+  vec3               n1      = octDecode(unpackSnorm2x16(normals.v[idx.y]));
+  vec3               n2      = octDecode(unpackSnorm2x16(normals.v[idx.z]));
+  return normalize(n0 * barycentrics.x + n1 * barycentrics.y + n2 * barycentrics.z);
+}
+
+vec4 fetchTangent(in RenderPrimitive renderPrim, in uint idx)
+{
+  if(!isCompact(renderPrim))
+    return getVertexTangent(renderPrim, idx);
+  return unpackTangent(CompactAttributes_(renderPrim.vertexBuffer.tangentAddress).v[idx]);
+}
+
+vec2 fetchTexCoord(in uint64_t address, in uvec3 idx, in vec3 barycentrics)
+{
+  CompactAttributes_ texCoords = CompactAttributes_(address);
+  return unpackHalf2x16(texCoords.v[idx.x]) * barycentrics.x + unpackHalf2x16(texCoords.v[idx.y]) * barycentrics.y
+         + unpackHalf2x16(texCoords.v[idx.z]) * barycentrics.z;
+}
+
+vec2 fetchInterpolatedTexCoord0(in RenderPrimitive renderPrim, in uvec3 idx, in vec3 barycentrics)
+{
+  if(!isCompact(renderPrim) || renderPrim.vertexBuffer.texCoord0Address == 0)
+    return getInterpolatedVertexTexCoord0(renderPrim, idx, barycentrics);
+  return fetchTexCoord(renderPrim.vertexBuffer.texCoord0Address, idx, barycentrics);
+}
+
+vec2 fetchInterpolatedTexCoord1(in RenderPrimitive renderPrim, in uvec3 idx, in vec3 barycentrics)
+{
+  if(!isCompact(renderPrim) || renderPrim.vertexBuffer.texCoord1Address == 0)
+    return getInterpolatedVertexTexCoord1(renderPrim, idx, barycentrics);
+  return fetchTexCoord(renderPrim.vertexBuffer.texCoord1Address, idx, barycentrics);
+}
+
+#endif  // VERTEX_FETCH_H
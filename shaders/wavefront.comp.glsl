@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#version 460
+#extension GL_EXT_ray_tracing : require
+#extension GL_EXT_nonuniform_qualifier : enable
+#extension GL_EXT_scalar_block_layout : enable
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_shader_explicit_arithmetic_types : require
+#extension GL_EXT_buffer_reference2 : require
+#extension GL_EXT_shader_image_load_formatted : enable
+#extension GL_EXT_ray_query : require
+
+#define USE_FIREFLY_FILTER 1
+#define USE_RUSIAN_ROULETTE 1
+#define RT_CUSTOM_PUSH_CONSTANT 1
+
+#include "device_host.h"
+#include "dh_bindings.h"
+#include "payload.h"
+#include "get_hit.h"
+#include "wavefront.h"
+
+// Wavefront path tracing: the kernels of a bounce, see wavefront.h
+// The kernel is selected by the specialization constant, the pipeline of each
+// kernel only keeps its own code.
+layout(constant_id = 0) const int WAVEFRONT_STAGE = WAVEFRONT_STAGE_GENERATE;
+
+HitPayload hitPayload;  // Global hit payload, used by selectObject
+
+layout(local_size_x = WAVEFRONT_WORKGROUP_SIZE) in;
+#include "rt_layout.h"
+
+// clang-format off
+layout(push_constant, scalar) uniform WavefrontPushConstant_ { PushConstantPathtracer pc; PushConstantWavefront wf; };
+
+layout(buffer_reference, scalar) readonly buffer QueuesBuf { WavefrontQueues q; };
+layout(buffer_reference, scalar) buffer Paths { WavefrontPath p[]; };
+layout(buffer_reference, scalar) buffer Hits { WavefrontHit h[]; };
+layout(buffer_reference, scalar) buffer Queue { uint id[]; };
+layout(buffer_reference, scalar) buffer ShadowRays { WavefrontShadowRay r[]; };
+layout(buffer_reference, scalar) buffer Pixels { WavefrontPixel p[]; };
+layout(buffer_reference, scalar) buffer Counters { WavefrontCounters c; };
+// clang-format on
+
+#include "nvvkhl/shaders/pbr_mat_eval.h"      // Need texturesMap[]
+#include "nvvkhl/shaders/hdr_env_sampling.h"  // nedd envSamplingData[]
+
+// Depend on hitPayload and other layouts
+#include "rt_indirect.h"
+#include "rt_common.h"
+
+#if WAVEFRONT_MATERIAL_BINS != WAVEFRONT_WORKGROUP_SIZE
+#error "The sort stage uses one invocation per material bin"
+#endif
+
+shared uint s_bins[WAVEFRONT_MATERIAL_BINS];
+
+uint numGroups(uint count)
+{
+  return (count + WAVEFRONT_WORKGROUP_SIZE - 1) / WAVEFRONT_WORKGROUP_SIZE;
+}
+
+PathState loadPath(WavefrontPath p)
+{
+  PathState path;
+  path.ray           = Ray(p.origin, p.direction);
+  path.throughput    = p.throughput;
+  path.radiance      = p.radiance;
+  path.maxRoughness  = p.maxRoughness;
+  path.lastSamplePdf = p.lastSamplePdf;
+  path.isInside      = (p.flags & WAVEFRONT_PATH_INSIDE) != 0;
+  return path;
+}
+
+void storePath(inout WavefrontPath p, PathState path)
+{
+  p.origin        = path.ray.origin;
+  p.direction     = path.ray.direction;
+  p.throughput    = path.throughput;
+  p.radiance      = path.radiance;
+  p.maxRoughness  = path.maxRoughness;
+  p.lastSamplePdf = path.lastSamplePdf;
+  p.flags         = path.isInside ? WAVEFRONT_PATH_INSIDE : 0;
+}
+
+ivec2 pixelOfPath(uint pathID)
+{
+  uint pixel = wf.firstPixel + pathID;
+  return ivec2(pixel % wf.imageSize.x, pixel / wf.imageSize.x);
+}
+
+//-----------------------------------------------------------------------
+// Camera rays of all paths, the queue of the first bounce has all of them
+//
+void generate(WavefrontQueues q, uint pathID)
+{
+  if(pathID == 0)
+  {
+    Counters(q.counters).c.rayCount[0] = wf.numPaths;
+    Counters(q.counters).c.extendCmd   = DispatchCommand(numGroups(wf.numPaths), 1, 1);
+  }
+  if(pathID >= wf.numPaths)
+    return;
+
+  vec2 samplePos   = vec2(pixelOfPath(pathID));
+  int  sampleFrame = frameInfo.frameCount * pc.frameStride + pc.frameOffset;
+  uint seed        = xxhash32(uvec3(samplePos, sampleFrame * pc.maxSamples + wf.sample));
+
+  // Subpixel jitter: the first sample is centered on the first frame, see pathtrace.comp.glsl
+  vec2 subpixelJitter = vec2(rand(seed), rand(seed));
+  if(wf.sample == 0)
+  {
+    subpixelJitter = vec2(0.5f, 0.5f);
+    if(sampleFrame > 0)
+      subpixelJitter += ANTIALIASING_STANDARD_DEVIATION * sampleGaussian(vec2(rand(seed), rand(seed)));
+  }
+
+  Ray       ray  = getCameraRay(seed, samplePos, subpixelJitter, vec2(wf.imageSize), frameInfo.projMatrixI,
+                                frameInfo.viewMatrixI, pc.focalDistance, pc.aperture);
+  PathState path = initPathState(ray);
+
+  WavefrontPath p;
+  storePath(p, path);
+  p.seed  = seed;
+  p.alpha = 1.0;
+  Paths(q.paths).p[pathID]      = p;
+  Queue(q.rayQueues[0]).id[pathID] = pathID;
+
+  if(wf.sample == 0)
+  {
+    Pixels(q.pixels).p[pathID].normal = vec3(0);
+    Pixels(q.pixels).p[pathID].depth  = 0;
+  }
+}
+
+//-----------------------------------------------------------------------
+// Closest hit, with the stochastic opacity of traceRay() but without the
+// hit state
+//
+void extend(WavefrontQueues q, uint id)
+{
+  Counters counters = Counters(q.counters);
+  if(id >= counters.c.rayCount[wf.bounce & 1])
+    return;
+
+  uint          pathID = Queue(q.rayQueues[wf.bounce & 1]).id[id];
+  WavefrontPath p      = Paths(q.paths).p[pathID];
+  uint          seed   = p.seed;
+
+  rayQueryEXT rayQuery;
+  uint        rayFlags = gl_RayFlagsNoneEXT | gl_RayFlagsCullBackFacingTrianglesEXT;
+  rayQueryInitializeEXT(rayQuery, topLevelAS, rayFlags, 0xFF, p.origin, 0.0, p.direction, INFINITE);
+  while(rayQueryProceedEXT(rayQuery))
+  {
+    if(rayQueryGetIntersectionTypeEXT(rayQuery, false) == gl_RayQueryCandidateIntersectionTriangleEXT)
+    {
+      int  instanceID   = rayQueryGetIntersectionInstanceIdEXT(rayQuery, false);
+      int  renderPrimID = rayQueryGetIntersectionInstanceCustomIndexEXT(rayQuery, false);
+      int  triangleID   = rayQueryGetIntersectionPrimitiveIndexEXT(rayQuery, false);
+      vec2 bary         = rayQueryGetIntersectionBarycentricsEXT(rayQuery, false);
+
+      RenderNode      renderNode = RenderNodeBuf(sceneDesc.renderNodeAddress)._[instanceID];
+      RenderPrimitive renderPrim = RenderPrimitiveBuf(sceneDesc.renderPrimitiveAddress)._[renderPrimID];
+
+      float opacity = getOpacity(renderNode, renderPrim, triangleID, vec3(1.0 - bary.x - bary.y, bary.x, bary.y));
+      if(rand(seed) <= opacity)
+        rayQueryConfirmIntersectionEXT(rayQuery);
+    }
+  }
+
+  // Hitting the environment, the path ends
+  if(rayQueryGetIntersectionTypeEXT(rayQuery, true) == gl_RayQueryCommittedIntersectionNoneEXT)
+  {
+    PathState path = loadPath(p);
+    vec3      backplate;
+    if(wf.bounce == 0)
+      p.alpha = 0.0;  // Set it to transparent
+    if(wf.bounce == 0 && getBackplate(path.ray.direction, backplate))
+      path.radiance = backplate;
+    else
+      addEnvironment(path);
+    storePath(p, path);
+    p.seed                   = seed;
+    Paths(q.paths).p[pathID] = p;
+    Hits(q.hits).h[pathID].rnodeID = -1;
+    return;
+  }
+
+  WavefrontHit hit;
+  hit.bary       = rayQueryGetIntersectionBarycentricsEXT(rayQuery, true);
+  hit.hitT       = rayQueryGetIntersectionTEXT(rayQuery, true);
+  hit.rnodeID    = rayQueryGetIntersectionInstanceIdEXT(rayQuery, true);
+  hit.rprimID    = rayQueryGetIntersectionInstanceCustomIndexEXT(rayQuery, true);
+  hit.triangleID = rayQueryGetIntersectionPrimitiveIndexEXT(rayQuery, true);
+
+  int materialID = RenderNodeBuf(sceneDesc.renderNodeAddress)._[hit.rnodeID].materialID;
+  hit.bin        = uint(max(materialID, 0)) % WAVEFRONT_MATERIAL_BINS;
+  hit.binSlot    = atomicAdd(counters.c.binCounts[hit.bin], 1);
+  atomicAdd(counters.c.hitCount, 1);
+
+  Hits(q.hits).h[pathID]        = hit;
+  Paths(q.paths).p[pathID].seed = seed;
+}
+
+//-----------------------------------------------------------------------
+// Exclusive prefix sum of the bins, one invocation per bin
+//
+void sortBins(WavefrontQueues q, uint bin)
+{
+  Counters counters = Counters(q.counters);
+  uint     count    = counters.c.binCounts[bin];
+  s_bins[bin]       = count;
+  barrier();
+  for(uint offset = 1; offset < WAVEFRONT_MATERIAL_BINS; offset <<= 1)
+  {
+    uint value = bin >= offset ? s_bins[bin - offset] : 0;
+    barrier();
+    s_bins[bin] += value;
+    barrier();
+  }
+  counters.c.binOffsets[bin] = s_bins[bin] - count;
+
+  if(bin == 0)
+  {
+    counters.c.shadeCmd    = DispatchCommand(numGroups(counters.c.hitCount), 1, 1);
+    counters.c.shadowCount = 0;
+  }
+}
+
+void scatter(WavefrontQueues q, uint id)
+{
+  Counters counters = Counters(q.counters);
+  if(id >= counters.c.rayCount[wf.bounce & 1])
+    return;
+
+  uint         pathID = Queue(q.rayQueues[wf.bounce & 1]).id[id];
+  WavefrontHit hit    = Hits(q.hits).h[pathID];
+  if(hit.rnodeID < 0)
+    return;
+  Queue(q.shadeQueue).id[counters.c.binOffsets[hit.bin] + hit.binSlot] = pathID;
+}
+
+//-----------------------------------------------------------------------
+// Hits of the same material are consecutive
+//
+void shade(WavefrontQueues q, uint id)
+{
+  Counters counters = Counters(q.counters);
+  if(id >= counters.c.hitCount)
+    return;
+
+  uint          pathID = Queue(q.shadeQueue).id[id];
+  WavefrontPath p      = Paths(q.paths).p[pathID];
+  WavefrontHit  h      = Hits(q.hits).h[pathID];
+  uint          seed   = p.seed;
+
+  RenderNode      renderNode   = RenderNodeBuf(sceneDesc.renderNodeAddress)._[h.rnodeID];
+  RenderPrimitive renderPrim   = RenderPrimitiveBuf(sceneDesc.renderPrimitiveAddress)._[h.rprimID];
+  const vec3      barycentrics = vec3(1.0 - h.bary.x - h.bary.y, h.bary.x, h.bary.y);
+  HitState hit = getHitState(renderPrim, barycentrics, h.triangleID, p.origin, mat4x3(renderNode.objectToWorld),
+                             mat4x3(renderNode.worldToObject));
+  setTracedHitPosition(renderPrim, hit, p.origin, p.direction, h.hitT);
+
+  if(wf.bounce == 0 && wf.sample == 0)
+  {
+    Pixels(q.pixels).p[pathID].normal = hit.nrm;
+    Pixels(q.pixels).p[pathID].depth  = h.hitT;
+  }
+
+  PathState     path = loadPath(p);
+  ShadowRequest shadow;
+  int           result = shadeHit(path, hit, h.hitT, h.rnodeID, h.triangleID, wf.bounce == 0, seed, shadow);
+  if(result != SHADE_TERMINATED)
+  {
+    if(shadow.valid)
+    {
+      uint slot = atomicAdd(counters.c.shadowCount, 1);
+      ShadowRays(q.shadowRays).r[slot] = WavefrontShadowRay(shadow.ray.origin, shadow.maxDist, shadow.ray.direction, pathID,
+                                                            shadow.contribution, xxhash32(uvec3(seed, pathID, wf.bounce)));
+    }
+
+    // Compaction: only the paths which continue are in the queue of the next bounce
+    if(result == SHADE_CONTINUE && continuePath(path, seed) && wf.bounce + 1 < pc.maxDepth)
+    {
+      uint next = (wf.bounce + 1) & 1;
+      uint slot = atomicAdd(counters.c.rayCount[next], 1);
+      Queue(q.rayQueues[next]).id[slot] = pathID;
+    }
+  }
+
+  storePath(p, path);
+  p.seed                   = seed;
+  Paths(q.paths).p[pathID] = p;
+}
+
+//-----------------------------------------------------------------------
+// Dispatch sizes for the rest of the bounce and the next one, reset of
+// the queues which were consumed
+//
+void updateQueues(WavefrontQueues q, uint bin)
+{
+  Counters counters           = Counters(q.counters);
+  counters.c.binCounts[bin] = 0;
+  if(bin == 0)
+  {
+    uint next                      = (wf.bounce + 1) & 1;
+    counters.c.extendCmd           = DispatchCommand(numGroups(counters.c.rayCount[next]), 1, 1);
+    counters.c.shadowCmd           = DispatchCommand(numGroups(counters.c.shadowCount), 1, 1);
+    counters.c.rayCount[wf.bounce & 1] = 0;
+    counters.c.hitCount            = 0;
+  }
+}
+
+void traceShadowRay(WavefrontQueues q, uint id)
+{
+  if(id >= Counters(q.counters).c.shadowCount)
+    return;
+
+  WavefrontShadowRay shadowRay    = ShadowRays(q.shadowRays).r[id];
+  uint               seed         = shadowRay.seed;
+  vec3               shadowFactor = traceShadow(Ray(shadowRay.origin, shadowRay.direction), shadowRay.maxDist, seed);
+
+  // A single shadow ray per path and bounce
+  Paths(q.paths).p[shadowRay.pathID].radiance += shadowRay.contribution * shadowFactor;
+}
+
+//-----------------------------------------------------------------------
+// Same accumulation as pathtrace.comp.glsl, once all samples are done
+//
+void resolve(WavefrontQueues q, uint pathID)
+{
+  if(pathID >= wf.numPaths)
+    return;
+
+  WavefrontPath p        = Paths(q.paths).p[pathID];
+  vec4          radiance = fireflyFilter(vec4(p.radiance, p.alpha));
+  if(wf.sample > 0)
+    radiance += Pixels(q.pixels).p[pathID].radiance;
+  Pixels(q.pixels).p[pathID].radiance = radiance;
+  if(wf.sample + 1 < pc.maxSamples)
+    return;
+
+  ivec2          samplePos   = pixelOfPath(pathID);
+  WavefrontPixel pixel       = Pixels(q.pixels).p[pathID];
+  vec4           pixel_color = pixel.radiance / pc.maxSamples;
+
+  if(frameInfo.frameCount == 0)  // first frame
+  {
+    imageStore(image, samplePos, pixel_color);
+    if(pc.useRTDenoiser == 1)
+      imageStore(normalDepth, samplePos, vec4(pixel.normal, pixel.depth));
+  }
+  else
+  {
+    // Do accumulation over time
+    float a         = 1.0F / float(frameInfo.frameCount + 1);
+    vec4  old_color = imageLoad(image, samplePos);
+    imageStore(image, samplePos, mix(old_color, pixel_color, a));
+
+    if(pc.useRTDenoiser == 1)
+    {
+      vec4  oldNormalDepth = imageLoad(normalDepth, samplePos);
+      float new_depth      = min(oldNormalDepth.w, pixel.depth);
+      vec3  new_normal     = normalize(mix(oldNormalDepth.xyz, pixel.normal, a));
+      imageStore(normalDepth, samplePos, vec4(new_normal, new_depth));
+    }
+  }
+
+  // Adding to the selection buffer the selected object id
+  selectObject(vec2(samplePos), vec2(wf.imageSize));
+}
+
+void main()
+{
+  WavefrontQueues q  = QueuesBuf(wf.queues).q;
+  uint            id = gl_GlobalInvocationID.x;
+
+  switch(WAVEFRONT_STAGE)
+  {
+    case WAVEFRONT_STAGE_GENERATE:
+      generate(q, id);
+      break;
+    case WAVEFRONT_STAGE_EXTEND:
+      extend(q, id);
+      break;
+    case WAVEFRONT_STAGE_SORT:
+      sortBins(q, gl_LocalInvocationID.x);
+      break;
+    case WAVEFRONT_STAGE_SCATTER:
+      scatter(q, id);
+      break;
+    case WAVEFRONT_STAGE_SHADE:
+      shade(q, id);
+      break;
+    case WAVEFRONT_STAGE_QUEUES:
+      updateQueues(q, gl_LocalInvocationID.x);
+      break;
+    case WAVEFRONT_STAGE_SHADOW:
+      traceShadowRay(q, id);
+      break;
+    case WAVEFRONT_STAGE_RESOLVE:
+      resolve(q, id);
+      break;
+  }
+}
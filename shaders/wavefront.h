@@ -0,0 +1,126 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+//-----------------------------------------------------------------------
+// Wavefront path tracing (see WavefrontPathtracer)
+// One path per pixel of a tile of the image. Each bounce is a sequence of
+// kernels linked by queues of path indices:
+// - extend: traces the rays of the queue, the misses add the environment,
+//   the hits are counted per material bin
+// - sort: prefix sum of the bins
+// - scatter: the hits, grouped by material bin, into the shade queue
+// - shade: material evaluation and sampling, appends the shadow rays and the
+//   paths which continue (compacted queue of the next bounce)
+// - queues: dispatch sizes of the shadow and of the next extend
+// - shadow: next event estimation, adds the light contribution
+// Include after device_host.h
+
+#ifdef __cplusplus
+using uint  = uint32_t;
+using uvec2 = glm::uvec2;
+#endif
+
+#define WAVEFRONT_WORKGROUP_SIZE 128
+#define WAVEFRONT_MATERIAL_BINS 128  // Hits are binned by material ID modulo this, one workgroup sorts the bins
+
+// Kernels of wavefront.comp.glsl, selected by the specialization constant 0
+#define WAVEFRONT_STAGE_GENERATE 0
+#define WAVEFRONT_STAGE_EXTEND 1
+#define WAVEFRONT_STAGE_SORT 2
+#define WAVEFRONT_STAGE_SCATTER 3
+#define WAVEFRONT_STAGE_SHADE 4
+#define WAVEFRONT_STAGE_QUEUES 5
+#define WAVEFRONT_STAGE_SHADOW 6
+#define WAVEFRONT_STAGE_RESOLVE 7  // Adds the sample to the pixel, the last one writes the images
+#define WAVEFRONT_STAGE_COUNT 8
+
+#define WAVEFRONT_PATH_INSIDE (1 << 0)
+
+struct WavefrontPath
+{
+  vec3  origin;  // Next ray
+  uint  seed;
+  vec3  direction;
+  float lastSamplePdf;
+  vec3  throughput;
+  uint  flags;  // WAVEFRONT_PATH_*
+  vec3  radiance;
+  float alpha;  // 0 when the camera ray did not hit anything
+  vec2  maxRoughness;
+};
+
+// Closest hit of the extend, the hit state is computed by the shade
+struct WavefrontHit
+{
+  vec2  bary;
+  float hitT;
+  int   rnodeID;  // -1: miss
+  int   rprimID;
+  int   triangleID;
+  uint  bin;      // Material bin
+  uint  binSlot;  // Position in the bin
+};
+
+struct WavefrontShadowRay
+{
+  vec3  origin;
+  float maxDist;
+  vec3  direction;
+  uint  pathID;
+  vec3  contribution;  // Added to the radiance of the path if the light is not occluded
+  uint  seed;
+};
+
+// Sum of the samples of the frame, and first hit of the first sample for the denoiser
+struct WavefrontPixel
+{
+  vec4  radiance;
+  vec3  normal;
+  float depth;
+};
+
+// VkDispatchIndirectCommand
+struct DispatchCommand
+{
+  uint x;
+  uint y;
+  uint z;
+};
+
+// Reset before the first bounce of each sample
+struct WavefrontCounters
+{
+  DispatchCommand extendCmd;  // Rays of the queue of the bounce, also the scatter
+  DispatchCommand shadeCmd;   // Hits
+  DispatchCommand shadowCmd;  // Shadow rays
+  uint            rayCount[2];  // Queue of the bounce (bounce & 1) and of the next one
+  uint            hitCount;
+  uint            shadowCount;
+  uint            binCounts[WAVEFRONT_MATERIAL_BINS];
+  uint            binOffsets[WAVEFRONT_MATERIAL_BINS];
+};
+
+// Buffer addresses, numPaths elements unless noted
+struct WavefrontQueues
+{
+  uint64_t paths;          // WavefrontPath
+  uint64_t hits;           // WavefrontHit, per path
+  uint64_t rayQueues[2];   // uint path index, ping-pong between the bounces
+  uint64_t shadeQueue;     // uint path index, sorted by material bin
+  uint64_t shadowRays;     // WavefrontShadowRay
+  uint64_t pixels;         // WavefrontPixel, per path
+  uint64_t counters;       // WavefrontCounters
+};
+
+// Follows PushConstantPathtracer in the push constant of the kernels
+struct PushConstantWavefront
+{
+  uint64_t queues;      // WavefrontQueues
+  uvec2    imageSize;
+  uint     firstPixel;  // Tile: path i renders the pixel firstPixel + i
+  uint     numPaths;
+  int      sample;      // In [0, maxSamples[
+  int      bounce;      // In [0, maxDepth[
+};
+
+#endif  // WAVEFRONT_H
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cstddef>
+
+#include "adaptive_sampler.hpp"
+
+// nvpro-core
+#include "nvh/nvprint.hpp"
+#include "nvvk/debug_util_vk.hpp"
+#include "nvvk/error_vk.hpp"
+
+#include "_autogen/adaptive.comp.glsl.h"
+
+namespace gltfr {
+extern bool g_forceExternalShaders;
+}
+
+namespace {
+void memoryBarrier(VkCommandBuffer cmd, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+  const VkMemoryBarrier2 barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                 .srcStageMask  = srcStage,
+                                 .srcAccessMask = srcAccess,
+                                 .dstStageMask  = dstStage,
+                                 .dstAccessMask = dstAccess};
+  const VkDependencyInfo dependencyInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &barrier};
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+
+constexpr VkPipelineStageFlags2 kPathtraceStages = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+}  // namespace
+
+bool gltfr::AdaptiveSampler::init(Resources& res, VkDescriptorSetLayout rtxSetLayout)
+{
+  m_alloc  = res.m_allocator.get();
+  m_device = res.ctx.device;
+
+  const VkPushConstantRange        pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DH::PushConstantAdaptive)};
+  const VkPipelineLayoutCreateInfo layoutInfo{.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                                              .setLayoutCount         = 1,
+                                              .pSetLayouts            = &rtxSetLayout,
+                                              .pushConstantRangeCount = 1,
+                                              .pPushConstantRanges    = &pushConstantRange};
+  NVVK_CHECK(vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_layout));
+
+  if(!createPipeline(res))
+  {
+    LOGW("Adaptive sampling: the compute shader could not be created\n");
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Compute pipeline from the GLSL file, or the pre-compiled version
+//
+bool gltfr::AdaptiveSampler::createPipeline(Resources& res)
+{
+  VkShaderModuleCreateInfo shaderModuleCreateInfo{.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                                                  .codeSize = sizeof(adaptive_comp_glsl),
+                                                  .pCode    = &adaptive_comp_glsl[0]};
+  std::vector<uint32_t>    spirvCode;
+  if(res.hasGlslCompiler() && g_forceExternalShaders)
+  {
+    if(!res.compileGlslShader("adaptive.comp.glsl", shaderc_shader_kind::shaderc_compute_shader, spirvCode)
+       || !res.createShaderModuleCreateInfo(spirvCode, shaderModuleCreateInfo))
+      return false;
+  }
+
+  VkShaderModule shaderModule{};
+  NVVK_CHECK(vkCreateShaderModule(m_device, &shaderModuleCreateInfo, nullptr, &shaderModule));
+  const VkComputePipelineCreateInfo pipelineInfo{
+      .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .stage  = {.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                 .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                 .module = shaderModule,
+                 .pName  = "main"},
+      .layout = m_layout,
+  };
+  NVVK_CHECK(vkCreateComputePipelines(m_device, res.m_pipelineCache, 1, &pipelineInfo, nullptr, &m_pipeline));
+  vkDestroyShaderModule(m_device, shaderModule, nullptr);
+  nvvk::DebugUtil(m_device).setObjectName(m_pipeline, "adaptive.comp.glsl");
+  return true;
+}
+
+void gltfr::AdaptiveSampler::deinit()
+{
+  if(m_alloc == nullptr)
+    return;
+  if(m_info != nullptr)
+    m_alloc->unmap(m_readback);
+  m_alloc->destroy(m_tiles);
+  m_alloc->destroy(m_readback);
+  vkDestroyPipeline(m_device, m_pipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+  m_pipeline = VK_NULL_HANDLE;
+  m_layout   = VK_NULL_HANDLE;
+  m_info     = nullptr;
+  m_alloc    = nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Tiles for an image of 'size', the previous ones are retired
+//
+void gltfr::AdaptiveSampler::createBuffers(Resources& res, const VkExtent2D& size)
+{
+  if(m_info != nullptr)
+    m_alloc->unmap(m_readback);
+  res.retire(m_tiles);
+  res.retire(m_readback);
+
+  m_size                  = size;
+  const uint32_t tilesX   = (size.width + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE;
+  const uint32_t tilesY   = (size.height + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE;
+  const uint32_t numTiles = std::max(tilesX * tilesY, 1U);
+
+  m_tiles    = m_alloc->createBuffer(sizeof(DH::AdaptiveInfo) + numTiles * sizeof(uint32_t),
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  m_readback = m_alloc->createBuffer(sizeof(DH::AdaptiveInfo), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  m_info     = static_cast<DH::AdaptiveInfo*>(m_alloc->map(m_readback));
+  *m_info    = DH::AdaptiveInfo{.numTiles = numTiles, .activeTiles = numTiles, .frameCount = -1};
+
+  // The first frame traces all tiles, whatever the content of the mask
+  VkCommandBuffer cmd = res.createTempCmdBuffer();
+  vkCmdFillBuffer(cmd, m_tiles.buffer, 0, VK_WHOLE_SIZE, 0);
+  res.submitAndWaitTempCmdBuffer(cmd);
+
+  nvvk::DebugUtil(m_device).DBG_NAME(m_tiles.buffer);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_readback.buffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// One workgroup per tile, the variance image was written by the path tracer
+//
+void gltfr::AdaptiveSampler::cmdEvaluate(VkCommandBuffer cmd, VkDescriptorSet rtxSet, const DH::PushConstantAdaptive& pushConst)
+{
+  if(m_pipeline == VK_NULL_HANDLE || m_tiles.buffer == VK_NULL_HANDLE)
+    return;
+
+  // The path tracer wrote the variance, and read the mask
+  memoryBarrier(cmd, kPathtraceStages, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+  vkCmdFillBuffer(cmd, m_tiles.buffer, offsetof(DH::AdaptiveInfo, activeTiles), sizeof(uint32_t), 0);
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout, 0, 1, &rtxSet, 0, nullptr);
+  vkCmdPushConstants(cmd, m_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DH::PushConstantAdaptive), &pushConst);
+  vkCmdDispatch(cmd, (m_size.width + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE,
+                (m_size.height + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE, 1);
+
+  // The mask is used by the next frame, the header is read back
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+                kPathtraceStages | VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT);
+  const VkBufferCopy region{.size = sizeof(DH::AdaptiveInfo)};
+  vkCmdCopyBuffer(cmd, m_tiles.buffer, m_readback.buffer, 1, &region);
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT);
+}
+
+bool gltfr::AdaptiveSampler::isConverged(int frameCount) const
+{
+  if(m_info == nullptr)
+    return false;
+  // An evaluation of a later frame is from the previous accumulation
+  const DH::AdaptiveInfo info = *m_info;
+  return info.activeTiles == 0 && info.frameCount >= 0 && info.frameCount <= frameCount;
+}
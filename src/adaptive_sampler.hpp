@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Adaptive sampling of the path tracer
+
+  The RTX and indirect pipelines keep the statistics of the luminance of each
+  pixel in the variance G-Buffer. After the frame, cmdEvaluate() runs
+  adaptive.comp.glsl: one workgroup per tile of ADAPTIVE_TILE_SIZE pixels,
+  which is masked when the relative error of all its pixels is below the
+  threshold. The next frame skips the masked tiles, and gives their samples to
+  the others (up to ADAPTIVE_MAX_BOOST times maxSamples).
+
+  The number of active tiles is copied to a host buffer, the image is
+  converged when it reaches zero. It is read a few frames late.
+
+*/
+
+// nvpro-core
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "resources.hpp"
+
+#include "nvvkhl/shaders/dh_lighting.h"
+namespace DH {
+#include "shaders/device_host.h"
+}  // namespace DH
+
+namespace gltfr {
+
+class AdaptiveSampler
+{
+public:
+  ~AdaptiveSampler() { deinit(); }
+
+  // The layout of the ray tracing descriptor set, which has the variance image and the tiles
+  bool init(Resources& res, VkDescriptorSetLayout rtxSetLayout);
+  void deinit();
+
+  // Tiles for an image of 'size', the previous ones are retired
+  void createBuffers(Resources& res, const VkExtent2D& size);
+
+  // Binding eAdaptiveTiles of the ray tracing descriptor set
+  VkDescriptorBufferInfo getTilesBufferInfo() const { return {m_tiles.buffer, 0, VK_WHOLE_SIZE}; }
+
+  // Masks the converged tiles, after the path tracer wrote the variance image
+  void cmdEvaluate(VkCommandBuffer cmd, VkDescriptorSet rtxSet, const DH::PushConstantAdaptive& pushConst);
+
+  // All tiles converged, for the accumulation which is at 'frameCount'
+  bool isConverged(int frameCount) const;
+
+private:
+  bool createPipeline(Resources& res);
+
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  VkDevice                 m_device{VK_NULL_HANDLE};
+
+  VkPipelineLayout m_layout{VK_NULL_HANDLE};
+  VkPipeline       m_pipeline{VK_NULL_HANDLE};
+
+  VkExtent2D              m_size{};
+  nvvk::Buffer            m_tiles;     // AdaptiveInfo, then the mask of the tiles
+  nvvk::Buffer            m_readback;  // AdaptiveInfo of the last evaluation, host visible
+  DH::AdaptiveInfo*       m_info{nullptr};
+};
+
+}  // namespace gltfr
@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "animation_evaluator.hpp"
+#include "gltf_accessor.hpp"
+
+// nvpro-core
+#include "nvh/parallel_work.hpp"
+
+namespace {
+constexpr size_t   kParallelMinItems = 1024;  // Below, the threads cost more than they save
+constexpr uint32_t kMaxForwardSteps  = 4;     // Keys walked from the cursor before searching
+constexpr float    kMatchTolerance   = 1e-4F;  // Of the mapping against the matrices of the scene
+
+template <typename F>
+void parallelFor(size_t count, F&& fn)
+{
+  static const uint32_t numThreads = std::max(1U, std::thread::hardware_concurrency());
+  if(count < kParallelMinItems || numThreads == 1)
+  {
+    for(size_t i = 0; i < count; i++)
+      fn(i);
+    return;
+  }
+  nvh::parallel_batches<256>(count, fn, numThreads);
+}
+}  // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Flatten the channels of all animations, and sort the nodes of the current scene by depth
+//
+void gltfr::AnimationEvaluator::init(nvh::gltf::Scene& scene, bool cpuSkinning)
+{
+  clear();
+  const tinygltf::Model& model = scene.getModel();
+
+  std::unordered_map<int, Range> timesOfAccessor;  // Samplers often share their input
+  for(const tinygltf::Animation& animation : model.animations)
+  {
+    Range range{static_cast<uint32_t>(m_channelNode.size()), 0};
+    for(const tinygltf::AnimationChannel& channel : animation.channels)
+    {
+      if(channel.target_node < 0 || channel.sampler < 0 || channel.sampler >= static_cast<int>(animation.samplers.size()))
+        continue;
+
+      Path path;
+      if(channel.target_path == "translation")
+        path = eTranslation;
+      else if(channel.target_path == "rotation")
+        path = eRotation;
+      else if(channel.target_path == "scale")
+        path = eScale;
+      else if(channel.target_path == "weights")
+        path = eWeights;
+      else
+        continue;  // KHR_animation_pointer is not supported
+
+      const tinygltf::AnimationSampler& sampler = animation.samplers[channel.sampler];
+      Interpolation interpolation = sampler.interpolation == "STEP" ? eStep : (sampler.interpolation == "CUBICSPLINE" ? eCubicSpline : eLinear);
+
+      auto keys = timesOfAccessor.find(sampler.input);
+      if(keys == timesOfAccessor.end())
+      {
+        const std::vector<float> times = readAccessor(model, sampler.input, 1);
+        keys = timesOfAccessor.emplace(sampler.input, Range{static_cast<uint32_t>(m_times.size()), static_cast<uint32_t>(times.size())}).first;
+        m_times.insert(m_times.end(), times.begin(), times.end());
+      }
+      if(keys->second.count == 0)
+        continue;
+
+      const uint32_t           valuesPerKey = interpolation == eCubicSpline ? 3 : 1;
+      const std::vector<float> values       = readAccessor(model, sampler.output, path == eRotation ? 4 : (path == eWeights ? 1 : 3));
+      const uint32_t           components   = static_cast<uint32_t>(values.size() / (keys->second.count * valuesPerKey));
+      if(components == 0 || (path != eWeights && components != (path == eRotation ? 4U : 3U)))
+        continue;
+
+      m_channelNode.push_back(channel.target_node);
+      m_channelPath.push_back(path);
+      m_channelInterpolation.push_back(interpolation);
+      m_channelKeys.push_back(keys->second);
+      m_channelValues.push_back(static_cast<uint32_t>(m_values.size()));
+      m_channelComponents.push_back(components);
+      m_channelCursor.push_back(0);
+      m_values.insert(m_values.end(), values.begin(), values.end());
+      range.count++;
+    }
+    m_animations.push_back(range);
+  }
+
+  // Breadth first, such that the parents of a level are all in the previous levels
+  m_parents.assign(model.nodes.size(), -1);
+  std::vector<int> roots;
+  if(scene.getCurrentScene() >= 0 && scene.getCurrentScene() < static_cast<int>(model.scenes.size()))
+    roots = model.scenes[scene.getCurrentScene()].nodes;
+  std::vector<bool> visited(model.nodes.size(), false);
+  for(int root : roots)
+  {
+    if(root >= 0 && root < static_cast<int>(model.nodes.size()) && !visited[root])
+    {
+      visited[root] = true;
+      m_levelNodes.push_back(root);
+    }
+  }
+  size_t levelStart = 0;
+  while(levelStart < m_levelNodes.size())
+  {
+    const size_t levelEnd = m_levelNodes.size();
+    m_levels.push_back({static_cast<uint32_t>(levelStart), static_cast<uint32_t>(levelEnd - levelStart)});
+    for(size_t i = levelStart; i < levelEnd; i++)
+    {
+      for(int child : model.nodes[m_levelNodes[i]].children)
+      {
+        if(child < 0 || child >= static_cast<int>(model.nodes.size()) || visited[child])
+          continue;
+        visited[child]   = true;
+        m_parents[child] = m_levelNodes[i];
+        m_levelNodes.push_back(child);
+      }
+    }
+    levelStart = levelEnd;
+  }
+  m_worldMatrices.assign(model.nodes.size(), glm::mat4(1.0F));
+
+  // The render nodes of the scene are up to date: the mapping must give the same matrices
+  mapRenderNodes(scene);
+  m_sceneTraversal = true;
+  updateWorldMatrices(scene);
+  m_sceneTraversal = (cpuSkinning && !model.skins.empty()) || !matchesScene(scene);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The render nodes and lights of each node of the current scene
+// - The render nodes of an instanced node are its primitives times its instances, the instances of
+//   a primitive in order
+// - The lights are created in a depth first traversal, as the render nodes
+//
+void gltfr::AnimationEvaluator::mapRenderNodes(const nvh::gltf::Scene& scene)
+{
+  const tinygltf::Model&                    model       = scene.getModel();
+  const std::vector<nvh::gltf::RenderNode>& renderNodes = scene.getRenderNodes();
+
+  // Instance transforms of the nodes with EXT_mesh_gpu_instancing
+  std::vector<Range> nodeInstances(model.nodes.size());
+  for(size_t nodeID = 0; nodeID < model.nodes.size(); nodeID++)
+  {
+    const tinygltf::Node& node      = model.nodes[nodeID];
+    const auto            extension = node.extensions.find("EXT_mesh_gpu_instancing");
+    if(node.mesh < 0 || extension == node.extensions.end())
+      continue;
+    const tinygltf::Value& attributes = extension->second.Get("attributes");
+    auto readAttribute = [&](const char* name, int numComponents) {
+      return attributes.Has(name) ? readAccessor(model, attributes.Get(name).GetNumberAsInt(), numComponents) : std::vector<float>{};
+    };
+    const std::vector<float> translations = readAttribute("TRANSLATION", 3);
+    const std::vector<float> rotations    = readAttribute("ROTATION", 4);
+    const std::vector<float> scales       = readAttribute("SCALE", 3);
+    const size_t numInstances = std::max({translations.size() / 3, rotations.size() / 4, scales.size() / 3});
+
+    nodeInstances[nodeID] = {static_cast<uint32_t>(m_instanceMatrices.size()), static_cast<uint32_t>(numInstances)};
+    for(size_t i = 0; i < numInstances; i++)
+    {
+      glm::mat4 matrix(1.0F);
+      if(i < translations.size() / 3)
+        matrix = glm::translate(matrix, glm::vec3(translations[i * 3], translations[i * 3 + 1], translations[i * 3 + 2]));
+      if(i < rotations.size() / 4)
+        matrix *= glm::mat4_cast(glm::quat(rotations[i * 4 + 3], rotations[i * 4], rotations[i * 4 + 1], rotations[i * 4 + 2]));
+      if(i < scales.size() / 3)
+        matrix = glm::scale(matrix, glm::vec3(scales[i * 3], scales[i * 3 + 1], scales[i * 3 + 2]));
+      m_instanceMatrices.push_back(matrix);
+    }
+  }
+
+  // Render nodes grouped by node, the k-th render node of a primitive of an instanced node is its k-th instance
+  std::vector<std::vector<uint32_t>> nodeRenderNodes(model.nodes.size());
+  std::map<std::pair<int, int>, uint32_t> instanceCounts;  // By node and render primitive
+  m_renderNodeInstance.assign(renderNodes.size(), -1);
+  for(size_t i = 0; i < renderNodes.size(); i++)
+  {
+    const int nodeID = renderNodes[i].refNodeID;
+    if(nodeID < 0 || nodeID >= static_cast<int>(model.nodes.size()))
+      continue;
+    nodeRenderNodes[nodeID].push_back(static_cast<uint32_t>(i));
+    const Range instances = nodeInstances[nodeID];
+    if(instances.count == 0)
+      continue;
+    const uint32_t instance = instanceCounts[{nodeID, renderNodes[i].renderPrimID}]++;
+    if(instance < instances.count)
+      m_renderNodeInstance[i] = static_cast<int32_t>(instances.first + instance);
+  }
+  m_nodeRenderNodes.resize(model.nodes.size());
+  for(size_t nodeID = 0; nodeID < model.nodes.size(); nodeID++)
+  {
+    m_nodeRenderNodes[nodeID] = {static_cast<uint32_t>(m_renderNodeIDs.size()), static_cast<uint32_t>(nodeRenderNodes[nodeID].size())};
+    m_renderNodeIDs.insert(m_renderNodeIDs.end(), nodeRenderNodes[nodeID].begin(), nodeRenderNodes[nodeID].end());
+  }
+
+  // Lights, in the order of a depth first traversal of the current scene
+  m_nodeRenderLight.assign(model.nodes.size(), -1);
+  std::vector<int> stack;
+  for(uint32_t i = m_levels.empty() ? 0 : m_levels[0].count; i-- > 0;)
+    stack.push_back(m_levelNodes[i]);  // The roots, the first one on top
+  int32_t renderLight = 0;
+  while(!stack.empty())
+  {
+    const int nodeID = stack.back();
+    stack.pop_back();
+    const tinygltf::Node& node = model.nodes[nodeID];
+    if(node.light >= 0)
+      m_nodeRenderLight[nodeID] = renderLight++;
+    for(auto child = node.children.rbegin(); child != node.children.rend(); ++child)
+    {
+      if(*child >= 0 && *child < static_cast<int>(model.nodes.size()) && m_parents[*child] == nodeID)
+        stack.push_back(*child);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// The mapping gives the matrices computed by the scene
+//
+bool gltfr::AnimationEvaluator::matchesScene(const nvh::gltf::Scene& scene) const
+{
+  auto sameMatrix = [](const glm::mat4& a, const glm::mat4& b) {
+    const float scale = std::max(1.0F, std::max(glm::length(b[3]), glm::length(a[3])));
+    for(int c = 0; c < 4; c++)
+    {
+      for(int r = 0; r < 4; r++)
+      {
+        if(std::abs(a[c][r] - b[c][r]) > kMatchTolerance * scale)
+          return false;
+      }
+    }
+    return true;
+  };
+
+  const tinygltf::Model&                     model        = scene.getModel();
+  const std::vector<nvh::gltf::RenderNode>&  renderNodes  = scene.getRenderNodes();
+  const std::vector<nvh::gltf::RenderLight>& renderLights = scene.getRenderLights();
+  if(m_renderNodeIDs.size() != renderNodes.size())
+    return false;
+  for(size_t nodeID = 0; nodeID < m_nodeRenderNodes.size(); nodeID++)
+  {
+    const Range range = m_nodeRenderNodes[nodeID];
+    for(uint32_t i = range.first; i < range.first + range.count; i++)
+    {
+      const uint32_t renderNodeID = m_renderNodeIDs[i];
+      const int32_t  instance     = m_renderNodeInstance[renderNodeID];
+      const glm::mat4 matrix = instance >= 0 ? m_worldMatrices[nodeID] * m_instanceMatrices[instance] : m_worldMatrices[nodeID];
+      if(!sameMatrix(matrix, renderNodes[renderNodeID].worldMatrix))
+        return false;
+    }
+  }
+
+  size_t numLights = 0;
+  for(size_t nodeID = 0; nodeID < m_nodeRenderLight.size(); nodeID++)
+  {
+    const int32_t renderLight = m_nodeRenderLight[nodeID];
+    if(renderLight < 0)
+      continue;
+    numLights++;
+    if(renderLight >= static_cast<int32_t>(renderLights.size()) || renderLights[renderLight].light != model.nodes[nodeID].light
+       || !sameMatrix(m_worldMatrices[nodeID], renderLights[renderLight].worldMatrix))
+      return false;
+  }
+  return numLights == renderLights.size();
+}
+
+void gltfr::AnimationEvaluator::clear()
+{
+  m_animations.clear();
+  m_channelNode.clear();
+  m_channelPath.clear();
+  m_channelInterpolation.clear();
+  m_channelKeys.clear();
+  m_channelValues.clear();
+  m_channelComponents.clear();
+  m_channelCursor.clear();
+  m_times.clear();
+  m_values.clear();
+  m_parents.clear();
+  m_levels.clear();
+  m_levelNodes.clear();
+  m_worldMatrices.clear();
+  m_nodeRenderNodes.clear();
+  m_renderNodeIDs.clear();
+  m_renderNodeInstance.clear();
+  m_instanceMatrices.clear();
+  m_nodeRenderLight.clear();
+  m_sceneTraversal = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Sample one channel, the time is clamped to its keys
+//
+void gltfr::AnimationEvaluator::sampleChannel(tinygltf::Model& model, uint32_t channel, float time)
+{
+  const Range    keys  = m_channelKeys[channel];
+  const float*   times = &m_times[keys.first];
+  const uint32_t comps = m_channelComponents[channel];
+
+  // Key before the time: a few steps from the cursor when playing, a search otherwise
+  uint32_t key = std::min(m_channelCursor[channel], keys.count - 1);
+  if(time < times[key])
+  {
+    key = static_cast<uint32_t>(std::max<ptrdiff_t>(std::upper_bound(times, times + key, time) - times - 1, 0));
+  }
+  else
+  {
+    uint32_t steps = 0;
+    while(key + 1 < keys.count && time >= times[key + 1] && steps++ < kMaxForwardSteps)
+      key++;
+    if(key + 1 < keys.count && time >= times[key + 1])
+      key = static_cast<uint32_t>(std::upper_bound(times + key, times + keys.count, time) - times - 1);
+  }
+  m_channelCursor[channel] = key;
+
+  const uint32_t next = std::min(key + 1, keys.count - 1);
+  const float    dt   = times[next] - times[key];
+  const float    t    = (next != key && dt > 0.0F) ? std::clamp((time - times[key]) / dt, 0.0F, 1.0F) : 0.0F;
+
+  const Interpolation interpolation = m_channelInterpolation[channel];
+  const float*        values        = &m_values[m_channelValues[channel]];
+  const uint32_t      stride        = interpolation == eCubicSpline ? 3 * comps : comps;
+  const float*        v0            = values + key * stride + (interpolation == eCubicSpline ? comps : 0);
+  const float*        v1            = values + next * stride + (interpolation == eCubicSpline ? comps : 0);
+  const Path          path          = m_channelPath[channel];
+
+  thread_local std::vector<float> result;
+  result.resize(comps);
+  if(interpolation == eStep || t == 0.0F)
+  {
+    std::copy(v0, v0 + comps, result.begin());
+  }
+  else if(interpolation == eLinear && path == eRotation)
+  {
+    const glm::quat q = glm::slerp(glm::quat(v0[3], v0[0], v0[1], v0[2]), glm::quat(v1[3], v1[0], v1[1], v1[2]), t);
+    result            = {q.x, q.y, q.z, q.w};
+  }
+  else if(interpolation == eLinear)
+  {
+    for(uint32_t c = 0; c < comps; c++)
+      result[c] = v0[c] + (v1[c] - v0[c]) * t;
+  }
+  else
+  {  // Hermite spline, with the out-tangent of the key and the in-tangent of the next one
+    const float  t2 = t * t, t3 = t2 * t;
+    const float* b0 = v0 + comps;
+    const float* a1 = v1 - comps;
+    for(uint32_t c = 0; c < comps; c++)
+      result[c] = (2 * t3 - 3 * t2 + 1) * v0[c] + (t3 - 2 * t2 + t) * dt * b0[c] + (-2 * t3 + 3 * t2) * v1[c]
+                  + (t3 - t2) * dt * a1[c];
+  }
+
+  tinygltf::Node& node = model.nodes[m_channelNode[channel]];
+  switch(path)
+  {
+    case eTranslation:
+      node.translation.assign(result.begin(), result.end());
+      break;
+    case eRotation: {
+      const glm::quat q = glm::normalize(glm::quat(result[3], result[0], result[1], result[2]));
+      node.rotation     = {q.x, q.y, q.z, q.w};
+      break;
+    }
+    case eScale:
+      node.scale.assign(result.begin(), result.end());
+      break;
+    case eWeights:
+      node.weights.assign(result.begin(), result.end());
+      break;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// The time is the one of the animation info of the scene, advanced by the caller
+//
+void gltfr::AnimationEvaluator::evaluate(nvh::gltf::Scene& scene, int animationIndex)
+{
+  if(animationIndex < 0 || animationIndex >= static_cast<int>(m_animations.size()))
+    return;
+
+  const float      time  = scene.getAnimationInfo(animationIndex).currentTime;
+  tinygltf::Model& model = scene.getModel();
+  const Range      range = m_animations[animationIndex];
+  parallelFor(range.count, [&](uint64_t i) { sampleChannel(model, range.first + static_cast<uint32_t>(i), time); });
+
+  updateWorldMatrices(scene);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Each node of a level writes its world matrix, then the ones of its render nodes and light
+//
+void gltfr::AnimationEvaluator::updateWorldMatrices(nvh::gltf::Scene& scene)
+{
+  const tinygltf::Model& model = scene.getModel();
+  // The scene has no setter for the render nodes and lights, only their world matrix depends on the nodes
+  auto& renderNodes  = const_cast<std::vector<nvh::gltf::RenderNode>&>(scene.getRenderNodes());
+  auto& renderLights = const_cast<std::vector<nvh::gltf::RenderLight>&>(scene.getRenderLights());
+  for(const Range& level : m_levels)
+  {
+    parallelFor(level.count, [&](uint64_t i) {
+      const int nodeID        = m_levelNodes[level.first + i];
+      const int parentID      = m_parents[nodeID];
+      m_worldMatrices[nodeID] = (parentID >= 0 ? m_worldMatrices[parentID] : glm::mat4(1.0F)) * localMatrix(model.nodes[nodeID]);
+      if(m_sceneTraversal)
+        return;
+
+      const Range range = m_nodeRenderNodes[nodeID];
+      for(uint32_t r = range.first; r < range.first + range.count; r++)
+      {
+        const uint32_t renderNodeID = m_renderNodeIDs[r];
+        const int32_t  instance     = m_renderNodeInstance[renderNodeID];
+        renderNodes[renderNodeID].worldMatrix =
+            instance >= 0 ? m_worldMatrices[nodeID] * m_instanceMatrices[instance] : m_worldMatrices[nodeID];
+      }
+      if(m_nodeRenderLight[nodeID] >= 0)
+        renderLights[m_nodeRenderLight[nodeID]].worldMatrix = m_worldMatrices[nodeID];
+    });
+  }
+
+  if(m_sceneTraversal)
+    scene.updateRenderNodes();  // Also places the joints of the CPU skinning
+}
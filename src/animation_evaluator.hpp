@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Evaluation of the glTF animations and of the world matrices, on all cores
+
+  - The channels of all animations are stored as structures of arrays: key times
+    and values as floats, and a cursor per channel caching the last keyframe, such
+    that sampling a playing animation doesn't search the keys.
+  - The channels are sampled in parallel, the results are written in the glTF nodes.
+  - The nodes of the current scene are sorted by depth. The world matrices are
+    propagated one level at a time, the nodes of a level in parallel, and kept here:
+    the joint matrices of GpuAnimation are uploaded from worldMatrices().
+  - In the same pass, each node writes the world matrices of its render nodes, with
+    their instance transform (EXT_mesh_gpu_instancing), and of its light.
+
+  This replaces nvh::gltf::Scene::updateAnimation() and updateRenderNodes(). The mapping
+  of the render nodes and lights to the nodes is checked against the scene at init;
+  when it doesn't match, or the scene is skinned on the CPU, the render nodes are
+  still updated by the latter, which also places the joints.
+
+*/
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// nvpro-core
+#include "nvh/gltfscene.hpp"
+
+namespace gltfr {
+
+class AnimationEvaluator
+{
+public:
+  // Channels of all animations and hierarchy of the current scene
+  // 'cpuSkinning': the vertices are skinned by SceneVk, which needs the matrices of the scene
+  void init(nvh::gltf::Scene& scene, bool cpuSkinning);
+  void clear();
+  bool valid() const { return !m_worldMatrices.empty(); }
+
+  // Sample the animation at its current time, then update the world matrices
+  void evaluate(nvh::gltf::Scene& scene, int animationIndex);
+  // World matrices of all nodes and of the render nodes, after the nodes changed
+  void updateWorldMatrices(nvh::gltf::Scene& scene);
+
+  const std::vector<glm::mat4>& worldMatrices() const { return m_worldMatrices; }
+
+private:
+  enum Path : uint8_t
+  {
+    eTranslation,
+    eRotation,
+    eScale,
+    eWeights,
+  };
+  enum Interpolation : uint8_t
+  {
+    eStep,
+    eLinear,
+    eCubicSpline,
+  };
+
+  struct Range
+  {
+    uint32_t first{0};
+    uint32_t count{0};
+  };
+
+  void sampleChannel(tinygltf::Model& model, uint32_t channel, float time);
+  void mapRenderNodes(const nvh::gltf::Scene& scene);
+  bool matchesScene(const nvh::gltf::Scene& scene) const;
+
+  // Channels, by animation
+  std::vector<Range>         m_animations;
+  std::vector<int>           m_channelNode;
+  std::vector<Path>          m_channelPath;
+  std::vector<Interpolation> m_channelInterpolation;
+  std::vector<Range>         m_channelKeys;    // In m_times
+  std::vector<uint32_t>      m_channelValues;  // First value in m_values
+  std::vector<uint32_t>      m_channelComponents;
+  std::vector<uint32_t>      m_channelCursor;  // Key of the last sample, relative to the first key
+  std::vector<float>         m_times;
+  std::vector<float>         m_values;  // Cubic splines store in-tangent, value, out-tangent per key
+
+  // Hierarchy of the current scene
+  std::vector<int>       m_parents;
+  std::vector<Range>     m_levels;      // In m_levelNodes
+  std::vector<int>       m_levelNodes;  // Nodes sorted by depth
+  std::vector<glm::mat4> m_worldMatrices;
+
+  // Render nodes and lights of each node
+  std::vector<Range>     m_nodeRenderNodes;     // In m_renderNodeIDs
+  std::vector<uint32_t>  m_renderNodeIDs;       // Grouped by node
+  std::vector<int32_t>   m_renderNodeInstance;  // Per render node, in m_instanceMatrices, -1: not instanced
+  std::vector<glm::mat4> m_instanceMatrices;
+  std::vector<int32_t>   m_nodeRenderLight;  // Per node, -1: no light
+  bool                   m_sceneTraversal{false};  // Render nodes updated by nvh::gltf::Scene
+};
+
+}  // namespace gltfr
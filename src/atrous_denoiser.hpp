@@ -19,11 +19,15 @@
 
 #pragma once
 
+#include <algorithm>
+#include <memory>
+
 #include "resources.hpp"
 #include "nvvk/compute_vk.hpp"
 #include "imgui/imgui_helper.h"
 
 #include "_autogen/denoise.comp.glsl.h"
+#include "_autogen/denoise_tiled.comp.glsl.h"
 
 namespace gltfr {
 
@@ -32,28 +36,32 @@ extern bool g_forceExternalShaders;
 // This Denoiser class is used to remove noise from an image.
 // The implementation is based on the paper "A-Trous Wavelet Transform for Fast Global Illumination Filtering"
 // See: https://jo.dreggn.org/home/2010_atrous.pdf
+// With fp16 support, the tiled backend (denoise_tiled.comp.glsl) does the first two levels in one dispatch
+// from shared memory, and the other levels with fp16 math.
+// With the luminance statistics of the path tracer, the color weight follows the standard deviation
+// of each pixel, like the variance guided filter of SVGF.
 enum AtrousDenoiserImages
 {
   eNoisyImage = 0,
   eNormalDepthImage,
   eDenoisedImage,
+  eVarianceImage,
 };
 
 class AtrousDenoiser : public nvvk::PushComputeDispatcher<DH::PushConstantDenoiser, AtrousDenoiserImages>
 {
 public:
-  // images: inColor, normal-depth, outColor
+  // images: inColor, normal-depth, outColor, variance
   AtrousDenoiser(Resources& res)
       : PushComputeDispatcher(res.ctx.device)
   {
 
     VkShaderModuleCreateInfo shaderModuleCreateInfo{.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
-    if(res.hasSlangCompiler() && g_forceExternalShaders)
+    std::vector<uint32_t>    spirvCode;
+    if(res.hasGlslCompiler() && g_forceExternalShaders)
     {
-
-      shaderc::SpvCompilationResult compilationResult =
-          res.compileGlslShader("denoise.comp.glsl", shaderc_shader_kind::shaderc_compute_shader);
-      if(!res.createShaderModuleCreateInfo(compilationResult, shaderModuleCreateInfo))
+      if(!res.compileGlslShader("denoise.comp.glsl", shaderc_shader_kind::shaderc_compute_shader, spirvCode)
+         || !res.createShaderModuleCreateInfo(spirvCode, shaderModuleCreateInfo))
         return;
     }
     else
@@ -67,8 +75,10 @@ public:
     PushComputeDispatcher::getBindings().addBinding(eNoisyImage, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
     PushComputeDispatcher::getBindings().addBinding(eNormalDepthImage, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
     PushComputeDispatcher::getBindings().addBinding(eDenoisedImage, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    PushComputeDispatcher::getBindings().addBinding(eVarianceImage, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
     PushComputeDispatcher::setCode(shaderModuleCreateInfo.pCode, shaderModuleCreateInfo.codeSize);
     PushComputeDispatcher::finalizePipeline();
+    createTiled(res);
 
     m_pushConstant.stepWidth = 1;
     m_pushConstant.colorPhi  = 0.5f;
@@ -76,19 +86,62 @@ public:
     m_pushConstant.depthPhi  = 1.0f;
   }
 
+  // fp16 arithmetic and the loads of the 32-bit and 16-bit color images without format
+  static bool isTiledSupported(VkPhysicalDevice physicalDevice)
+  {
+    VkPhysicalDeviceVulkan12Features features12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2        features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &features12};
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    return features12.shaderFloat16 == VK_TRUE && features.features.shaderStorageImageReadWithoutFormat == VK_TRUE;
+  }
+
+  void createTiled(Resources& res)
+  {
+    if(!isTiledSupported(res.ctx.physicalDevice))
+      return;
+
+    VkShaderModuleCreateInfo shaderModuleCreateInfo{.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                                                    .codeSize = sizeof(denoise_tiled_comp_glsl),
+                                                    .pCode    = &denoise_tiled_comp_glsl[0]};
+    std::vector<uint32_t>    spirvCode;
+    if(res.hasGlslCompiler() && g_forceExternalShaders)
+    {
+      if(!res.compileGlslShader("denoise_tiled.comp.glsl", shaderc_shader_kind::shaderc_compute_shader, spirvCode)
+         || !res.createShaderModuleCreateInfo(spirvCode, shaderModuleCreateInfo))
+        return;
+    }
+
+    m_tiled = std::make_unique<nvvk::PushComputeDispatcher<DH::PushConstantDenoiser, AtrousDenoiserImages>>(res.ctx.device);
+    m_tiled->getBindings().addBinding(eNoisyImage, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_tiled->getBindings().addBinding(eNormalDepthImage, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_tiled->getBindings().addBinding(eDenoisedImage, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_tiled->getBindings().addBinding(eVarianceImage, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_tiled->setCode(shaderModuleCreateInfo.pCode, shaderModuleCreateInfo.codeSize);
+    m_tiled->finalizePipeline();
+  }
+
   void render(VkCommandBuffer       cmd,
               VkExtent2D            imgSize,
               VkDescriptorImageInfo colorBuffer,        // Original color buffer (noisy)
               VkDescriptorImageInfo resultBuffer,       // Result of the denoise buffer
               VkDescriptorImageInfo normalDepthBuffer,  // Normal and depth buffer
-              VkDescriptorImageInfo tmpBuffer)          // temp buffer for ping-pong
+              VkDescriptorImageInfo tmpBuffer,          // temp buffer for ping-pong
+              VkDescriptorImageInfo varianceBuffer,     // Luminance statistics: mean, M2, number of samples
+              bool                  hasVariance)        // The statistics are written by the path tracer
   {
 
 
     // Number of denoising iterations
-    m_pushConstant.colorPhi  = colorPhi;
-    m_pushConstant.normalPhi = normalPhi * normalPhi;
-    m_pushConstant.depthPhi  = depthPhi * depthPhi;
+    m_pushConstant.colorPhi    = colorPhi;
+    m_pushConstant.normalPhi   = normalPhi * normalPhi;
+    m_pushConstant.depthPhi    = depthPhi * depthPhi;
+    m_pushConstant.useVariance = (hasVariance && useVariance) ? 1 : 0;
+
+    if(m_tiled && useTiled)
+    {
+      renderTiled(cmd, imgSize, colorBuffer, resultBuffer, normalDepthBuffer, tmpBuffer, varianceBuffer);
+      return;
+    }
 
     if(numIterations % 2 == 0)
     {  // To make sure the end result is in resultBuffer
@@ -105,6 +158,7 @@ public:
       PushComputeDispatcher::updateBinding(eNoisyImage, colorBuffer.imageView, VK_IMAGE_LAYOUT_GENERAL);
       PushComputeDispatcher::updateBinding(eNormalDepthImage, normalDepthBuffer.imageView, VK_IMAGE_LAYOUT_GENERAL);
       PushComputeDispatcher::updateBinding(eDenoisedImage, resultBuffer.imageView, VK_IMAGE_LAYOUT_GENERAL);
+      PushComputeDispatcher::updateBinding(eVarianceImage, varianceBuffer.imageView, VK_IMAGE_LAYOUT_GENERAL);
 
       // Bind pipeline, descriptor sets, push constants
       glm::uvec3 blocks = {PushComputeDispatcher::getBlockCount(imgSize.width, WORKGROUP_SIZE),
@@ -119,6 +173,57 @@ public:
     }
   }
 
+  //--------------------------------------------------------------------------------------------------
+  // Tiled backend: the first two levels are fused, then one pass per level
+  //
+  void renderTiled(VkCommandBuffer       cmd,
+                   VkExtent2D            imgSize,
+                   VkDescriptorImageInfo colorBuffer,
+                   VkDescriptorImageInfo resultBuffer,
+                   VkDescriptorImageInfo normalDepthBuffer,
+                   VkDescriptorImageInfo tmpBuffer,
+                   VkDescriptorImageInfo varianceBuffer)
+  {
+    const int fusedLevels = std::min(numIterations, 2);
+    const int numPasses   = 1 + numIterations - fusedLevels;
+    if(numPasses % 2 == 0)
+    {  // To make sure the end result is in resultBuffer
+      std::swap(resultBuffer, tmpBuffer);
+    }
+
+    const glm::uvec3 blocks = {m_tiled->getBlockCount(imgSize.width, WORKGROUP_SIZE),
+                               m_tiled->getBlockCount(imgSize.height, WORKGROUP_SIZE), 1};
+    for(int pass = 0; pass < numPasses; pass++)
+    {
+      const int level            = (pass == 0) ? 0 : fusedLevels + pass - 1;
+      m_pushConstant.fusedLevels = (pass == 0) ? fusedLevels : 0;
+      m_pushConstant.stepWidth   = 1 << level;
+      m_pushConstant.colorPhi    = (colorPhi * colorPhi) / (1 << level);
+
+      if(pass > 0)
+      {
+        // The previous pass wrote the input of this one
+        const VkMemoryBarrier barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                                      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                             &barrier, 0, nullptr, 0, nullptr);
+      }
+
+      m_tiled->updateBinding(eNoisyImage, colorBuffer.imageView, VK_IMAGE_LAYOUT_GENERAL);
+      m_tiled->updateBinding(eNormalDepthImage, normalDepthBuffer.imageView, VK_IMAGE_LAYOUT_GENERAL);
+      m_tiled->updateBinding(eDenoisedImage, resultBuffer.imageView, VK_IMAGE_LAYOUT_GENERAL);
+      m_tiled->updateBinding(eVarianceImage, varianceBuffer.imageView, VK_IMAGE_LAYOUT_GENERAL);
+      m_tiled->dispatchBlocks(cmd, blocks, &m_pushConstant);
+
+      // Swap buffers for next pass
+      auto temp    = resultBuffer;
+      colorBuffer  = resultBuffer;
+      resultBuffer = tmpBuffer;
+      tmpBuffer    = temp;
+    }
+  }
+
   void onUi()
   {
     namespace PE = ImGuiH::PropertyEditor;
@@ -129,6 +234,9 @@ public:
       PE::SliderFloat("Normal Phi", &normalPhi, 0.0f, 1.0f, "%.3f");
       PE::SliderFloat("Depth Phi", &depthPhi, 0.0f, 1.0f, "%.3f");
       PE::SliderInt("Iterations", &numIterations, 1, 8);
+      PE::Checkbox("Variance Guided", &useVariance, "The color weight follows the standard deviation of each pixel (SVGF)");
+      if(m_tiled)
+        PE::Checkbox("Tiled FP16", &useTiled, "Shared memory tiles in fp16, the first two iterations in one pass");
       PE::treePop();
     }
   }
@@ -141,6 +249,10 @@ private:
   float depthPhi      = 0.1f;
   bool  isActive      = false;
   int   numIterations = 1;
+  bool  useTiled      = true;
+  bool  useVariance   = true;
+
+  std::unique_ptr<nvvk::PushComputeDispatcher<DH::PushConstantDenoiser, AtrousDenoiserImages>> m_tiled;  // Without fp16: nullptr
 
   DH::PushConstantDenoiser m_pushConstant{};
 };
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "batch_jobs.hpp"
+
+// nvpro-core
+#include "nvh/nvprint.hpp"
+
+namespace {
+bool parseVec3(const std::string& value, glm::vec3& v)
+{
+  return std::sscanf(value.c_str(), "%f,%f,%f", &v.x, &v.y, &v.z) == 3;
+}
+
+bool parseInt(const std::string& value, int& i)
+{
+  char end{};
+  return std::sscanf(value.c_str(), "%d%c", &i, &end) == 1;
+}
+}  // namespace
+
+bool gltfr::BatchJobs::load(const std::string& manifest)
+{
+  std::ifstream file(manifest);
+  if(!file)
+  {
+    LOGE("Batch: cannot read %s\n", manifest.c_str());
+    return false;
+  }
+  m_baseDir = std::filesystem::path(manifest).parent_path().string();
+  m_scenes.clear();
+
+  std::string line;
+  for(int lineNumber = 1; std::getline(file, line); lineNumber++)
+  {
+    const size_t first = line.find_first_not_of(" \t\r");
+    if(first == std::string::npos || line[first] == '#')
+      continue;
+
+    std::string scene;
+    BatchJob    job;
+    if(!parseJob(line, lineNumber, scene, job))
+      return false;
+
+    // The jobs of a scene are rendered together, in the order of the manifest
+    auto it = std::find_if(m_scenes.begin(), m_scenes.end(), [&](const BatchScene& s) { return s.filename == scene; });
+    if(it == m_scenes.end())
+      it = m_scenes.insert(m_scenes.end(), BatchScene{scene, {}});
+    it->jobs.push_back(job);
+  }
+
+  LOGI("Batch: %zu jobs on %zu scenes\n", numJobs(), m_scenes.size());
+  return !m_scenes.empty();
+}
+
+size_t gltfr::BatchJobs::numJobs() const
+{
+  size_t count = 0;
+  for(const BatchScene& scene : m_scenes)
+    count += scene.jobs.size();
+  return count;
+}
+
+//--------------------------------------------------------------------------------------------------
+// key=value pairs, the values with spaces are between quotes
+//
+bool gltfr::BatchJobs::parseJob(const std::string& line, int lineNumber, std::string& scene, BatchJob& job) const
+{
+  auto filePath = [&](const std::string& value) {
+    const std::filesystem::path p(value);
+    return p.is_absolute() ? value : (std::filesystem::path(m_baseDir) / p).string();
+  };
+
+  job.line   = lineNumber;
+  size_t pos = 0;
+  while(true)
+  {
+    pos = line.find_first_not_of(" \t\r", pos);
+    if(pos == std::string::npos)
+      break;
+
+    const size_t equal = line.find('=', pos);
+    if(equal == std::string::npos)
+    {
+      LOGE("Batch: line %d, expecting key=value\n", lineNumber);
+      return false;
+    }
+    const std::string key = line.substr(pos, equal - pos);
+
+    std::string value;
+    pos = equal + 1;
+    if(pos < line.size() && line[pos] == '"')
+    {
+      const size_t quote = line.find('"', pos + 1);
+      if(quote == std::string::npos)
+      {
+        LOGE("Batch: line %d, missing quote\n", lineNumber);
+        return false;
+      }
+      value = line.substr(pos + 1, quote - pos - 1);
+      pos   = quote + 1;
+    }
+    else
+    {
+      const size_t end = std::min(line.find_first_of(" \t\r", pos), line.size());
+      value            = line.substr(pos, end - pos);
+      pos              = end;
+    }
+
+    bool valid = true;
+    if(key == "scene")
+      scene = filePath(value);
+    else if(key == "output")
+      job.output = filePath(value);
+    else if(key == "env")
+      job.environment = (value == "sky") ? value : filePath(value);
+    else if(key == "variant")
+      job.variant = value;
+    else if(key == "camera")
+      valid = parseInt(value, job.camera);
+    else if(key == "eye")
+      valid = job.hasLookat = parseVec3(value, job.eye);
+    else if(key == "center")
+      valid = job.hasLookat = parseVec3(value, job.center);
+    else if(key == "up")
+      valid = parseVec3(value, job.up);
+    else if(key == "fov")
+      valid = std::sscanf(value.c_str(), "%f", &job.fov) == 1;
+    else if(key == "samples")
+      valid = parseInt(value, job.samples);
+    else
+    {
+      LOGE("Batch: line %d, unknown key '%s'\n", lineNumber, key.c_str());
+      return false;
+    }
+    if(!valid)
+    {
+      LOGE("Batch: line %d, invalid value of '%s': %s\n", lineNumber, key.c_str(), value.c_str());
+      return false;
+    }
+  }
+
+  if(scene.empty() || job.output.empty())
+  {
+    LOGE("Batch: line %d, a job needs a scene and an output\n", lineNumber);
+    return false;
+  }
+  return true;
+}
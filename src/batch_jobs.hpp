@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Batch rendering: the jobs of a manifest (--batch)
+
+  One job per line, as key=value pairs; values with spaces are quoted, and
+  lines starting with '#' are comments.
+
+    scene=car.glb output=car_front.png camera=0 variant=Red samples=1024
+    scene=car.glb output=car_sky.jpg env=sky eye=4,1,4 center=0,0.5,0 fov=35
+    scene=room.gltf output="room day.png" env=studio.hdr
+
+  - scene, output: the glTF/OBJ file and the image (.png, .jpg)
+  - env:           an .hdr file, or 'sky'; the environment of the previous job otherwise
+  - variant:       name or index of the material variant, the first one otherwise
+  - camera:        index of a camera of the glTF, or eye/center/up/fov (degrees)
+  - samples:       samples per pixel, the frames of --frames otherwise
+
+  Relative paths are from the directory of the manifest. The jobs are grouped
+  by scene, in the order of the first job of each scene, such that a scene is
+  loaded only once.
+
+*/
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace gltfr {
+
+struct BatchJob
+{
+  std::string output;
+  std::string environment;  // .hdr file, "sky", or empty to keep the current one
+  std::string variant;      // Name or index, empty for the first variant
+  int         camera{-1};   // Camera of the glTF, -1: the look-at below, or the camera of the scene
+  bool        hasLookat{false};
+  glm::vec3   eye{0.0F};
+  glm::vec3   center{0.0F};
+  glm::vec3   up{0.0F, 1.0F, 0.0F};
+  float       fov{0.0F};    // Degrees, 0: the one of the scene
+  int         samples{0};   // Samples per pixel, 0: the default frames
+  int         line{0};      // In the manifest, for the messages
+};
+
+struct BatchScene
+{
+  std::string           filename;
+  std::vector<BatchJob> jobs;
+};
+
+class BatchJobs
+{
+public:
+  // Reads the manifest, false if it can't be read or a job is invalid
+  bool load(const std::string& manifest);
+
+  const std::vector<BatchScene>& scenes() const { return m_scenes; }
+  size_t                         numJobs() const;
+
+private:
+  bool parseJob(const std::string& line, int lineNumber, std::string& scene, BatchJob& job) const;
+
+  std::string             m_baseDir;
+  std::vector<BatchScene> m_scenes;
+};
+
+}  // namespace gltfr
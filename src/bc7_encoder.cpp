@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include "bc7_encoder.hpp"
+
+namespace {
+constexpr std::array<int, 16> kWeights{0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+constexpr int                 kRefineIterations = 2;
+
+using Texels = std::array<std::array<int, 4>, 16>;
+
+// Endpoints of mode 6: 7 bits per channel and one p-bit per endpoint
+struct Mode6
+{
+  std::array<std::array<int, 4>, 2> color{};
+  std::array<int, 2>                pbit{};
+  std::array<uint8_t, 16>           index{};
+  uint32_t                          error{std::numeric_limits<uint32_t>::max()};
+};
+
+//--------------------------------------------------------------------------------------------------
+// Best palette entry of each texel, returns the squared error of the block
+//
+uint32_t findIndices(const Texels& texels, Mode6& mode)
+{
+  std::array<std::array<int, 4>, 16> palette{};
+  for(int i = 0; i < 16; i++)
+  {
+    for(int c = 0; c < 4; c++)
+    {
+      const int e0  = (mode.color[0][c] << 1) | mode.pbit[0];
+      const int e1  = (mode.color[1][c] << 1) | mode.pbit[1];
+      palette[i][c] = ((64 - kWeights[i]) * e0 + kWeights[i] * e1 + 32) >> 6;
+    }
+  }
+
+  uint32_t total = 0;
+  for(int t = 0; t < 16; t++)
+  {
+    uint32_t best = std::numeric_limits<uint32_t>::max();
+    for(int i = 0; i < 16; i++)
+    {
+      uint32_t err = 0;
+      for(int c = 0; c < 4; c++)
+      {
+        const int d = texels[t][c] - palette[i][c];
+        err += d * d;
+      }
+      if(err < best)
+      {
+        best          = err;
+        mode.index[t] = static_cast<uint8_t>(i);
+      }
+    }
+    total += best;
+  }
+  return total;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Quantize the endpoints with the four combinations of p-bits, keeps the best in 'best'
+//
+void quantizeEndpoints(const Texels& texels, const std::array<std::array<float, 4>, 2>& endpoints, Mode6& best)
+{
+  for(int p = 0; p < 4; p++)
+  {
+    Mode6 mode;
+    mode.pbit = {p & 1, p >> 1};
+    for(int e = 0; e < 2; e++)
+      for(int c = 0; c < 4; c++)
+        mode.color[e][c] = std::clamp(static_cast<int>(std::lround((endpoints[e][c] - mode.pbit[e]) * 0.5F)), 0, 127);
+    mode.error = findIndices(texels, mode);
+    if(mode.error < best.error)
+      best = mode;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Endpoints minimizing the error for the current indices
+//
+bool refineEndpoints(const Texels& texels, const Mode6& mode, std::array<std::array<float, 4>, 2>& endpoints)
+{
+  float                a = 0, b = 0, c = 0;
+  std::array<float, 4> x0{}, x1{};
+  for(int t = 0; t < 16; t++)
+  {
+    const float w = kWeights[mode.index[t]] / 64.0F;
+    a += (1 - w) * (1 - w);
+    b += (1 - w) * w;
+    c += w * w;
+    for(int ch = 0; ch < 4; ch++)
+    {
+      x0[ch] += (1 - w) * texels[t][ch];
+      x1[ch] += w * texels[t][ch];
+    }
+  }
+  const float det = a * c - b * b;
+  if(std::abs(det) < 1e-6F)
+    return false;
+  for(int ch = 0; ch < 4; ch++)
+  {
+    endpoints[0][ch] = std::clamp((c * x0[ch] - b * x1[ch]) / det, 0.0F, 255.0F);
+    endpoints[1][ch] = std::clamp((a * x1[ch] - b * x0[ch]) / det, 0.0F, 255.0F);
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Initial endpoints: extent of the texels along their principal axis
+//
+std::array<std::array<float, 4>, 2> principalEndpoints(const Texels& texels)
+{
+  std::array<float, 4> mean{};
+  for(const auto& t : texels)
+    for(int c = 0; c < 4; c++)
+      mean[c] += t[c] / 16.0F;
+
+  std::array<std::array<float, 4>, 4> cov{};
+  for(const auto& t : texels)
+    for(int i = 0; i < 4; i++)
+      for(int j = 0; j < 4; j++)
+        cov[i][j] += (t[i] - mean[i]) * (t[j] - mean[j]);
+
+  // Power iteration
+  std::array<float, 4> axis{1, 1, 1, 1};
+  for(int iter = 0; iter < 8; iter++)
+  {
+    std::array<float, 4> next{};
+    for(int i = 0; i < 4; i++)
+      for(int j = 0; j < 4; j++)
+        next[i] += cov[i][j] * axis[j];
+    const float len = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+    if(len < 1e-6F)
+      return {mean, mean};  // Uniform block
+    for(int i = 0; i < 4; i++)
+      axis[i] = next[i] / len;
+  }
+
+  float tmin = std::numeric_limits<float>::max();
+  float tmax = -std::numeric_limits<float>::max();
+  for(const auto& t : texels)
+  {
+    float d = 0;
+    for(int c = 0; c < 4; c++)
+      d += (t[c] - mean[c]) * axis[c];
+    tmin = std::min(tmin, d);
+    tmax = std::max(tmax, d);
+  }
+
+  std::array<std::array<float, 4>, 2> endpoints{};
+  for(int c = 0; c < 4; c++)
+  {
+    endpoints[0][c] = std::clamp(mean[c] + tmin * axis[c], 0.0F, 255.0F);
+    endpoints[1][c] = std::clamp(mean[c] + tmax * axis[c], 0.0F, 255.0F);
+  }
+  return endpoints;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Bit layout of mode 6, from the least significant bit:
+// mode (7), R0 R1 G0 G1 B0 B1 A0 A1 (7 each), P0 P1, anchor index (3), 15 indices (4)
+//
+void packMode6(Mode6 mode, uint8_t* out)
+{
+  // The most significant bit of the first index is implicit: zero
+  if(mode.index[0] >= 8)
+  {
+    std::swap(mode.color[0], mode.color[1]);
+    std::swap(mode.pbit[0], mode.pbit[1]);
+    for(uint8_t& i : mode.index)
+      i = static_cast<uint8_t>(15 - i);
+  }
+
+  std::fill(out, out + 16, uint8_t(0));
+  uint32_t pos = 0;
+  auto     put = [&](uint32_t value, uint32_t count) {
+    for(uint32_t i = 0; i < count; i++, pos++)
+      out[pos >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (pos & 7));
+  };
+
+  put(1 << 6, 7);
+  for(int c = 0; c < 4; c++)
+  {
+    put(mode.color[0][c], 7);
+    put(mode.color[1][c], 7);
+  }
+  put(mode.pbit[0], 1);
+  put(mode.pbit[1], 1);
+  put(mode.index[0], 3);
+  for(int t = 1; t < 16; t++)
+    put(mode.index[t], 4);
+}
+
+void compressBlock(const Texels& texels, uint8_t* out)
+{
+  Mode6 best;
+  auto  endpoints = principalEndpoints(texels);
+  quantizeEndpoints(texels, endpoints, best);
+  for(int iter = 0; iter < kRefineIterations && best.error > 0; iter++)
+  {
+    const uint32_t previous = best.error;
+    if(!refineEndpoints(texels, best, endpoints))
+      break;
+    quantizeEndpoints(texels, endpoints, best);
+    if(best.error >= previous)
+      break;
+  }
+  packMode6(best, out);
+}
+}  // namespace
+
+
+std::vector<uint8_t> compressBC7(const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+  const uint32_t       blocksX = (width + 3) / 4;
+  const uint32_t       blocksY = (height + 3) / 4;
+  std::vector<uint8_t> blocks(size_t(blocksX) * blocksY * 16);
+
+  Texels texels{};
+  for(uint32_t by = 0; by < blocksY; by++)
+  {
+    for(uint32_t bx = 0; bx < blocksX; bx++)
+    {
+      for(uint32_t t = 0; t < 16; t++)
+      {
+        const uint32_t x     = std::min(bx * 4 + (t & 3), width - 1);
+        const uint32_t y     = std::min(by * 4 + (t >> 2), height - 1);
+        const uint8_t* texel = &rgba[(size_t(y) * width + x) * 4];
+        for(int c = 0; c < 4; c++)
+          texels[t][c] = texel[c];
+      }
+      compressBlock(texels, &blocks[(size_t(by) * blocksX + bx) * 16]);
+    }
+  }
+  return blocks;
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Compress a RGBA8 image to BC7, using mode 6 (one subset, RGBA endpoints, 4-bit indices)
+// - Endpoints from the principal axis of each block, refined by least squares
+// - Blocks on the right and bottom borders are padded by clamping
+// Returns 16 bytes per 4x4 block, rows of blocks from the top.
+std::vector<uint8_t> compressBC7(const uint8_t* rgba, uint32_t width, uint32_t height);
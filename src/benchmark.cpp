@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "benchmark.hpp"
+#include "telemetry.hpp"
+
+// nvpro-core
+#include "nvh/nvprint.hpp"
+
+namespace {
+std::string quoted(const std::string& text)
+{
+  std::string result = "\"";
+  for(const char c : text)
+  {
+    if(c == '"' || c == '\\')
+    {
+      result += '\\';
+      result += c;
+    }
+    else if(static_cast<unsigned char>(c) < 0x20)
+    {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      result += escaped;
+    }
+    else
+    {
+      result += c;
+    }
+  }
+  return result + "\"";
+}
+
+std::string number(double value)
+{
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.3f", value);
+  return text;
+}
+
+double megabytes(VkDeviceSize size)
+{
+  return static_cast<double>(size) / (1024.0 * 1024.0);
+}
+}  // namespace
+
+void gltfr::BenchmarkRun::addFrame(nvh::Profiler& profiler, VkDeviceSize memoryUsage)
+{
+  frames++;
+  peakMemory = std::max(peakMemory, memoryUsage);
+  for(const char* section : kProfilerSections)
+  {
+    nvh::Profiler::TimerInfo info{};
+    if(!profiler.getTimerInfo(section, info))
+      continue;
+
+    auto it = std::find_if(passes.begin(), passes.end(), [&](const BenchmarkPass& p) { return p.name == section; });
+    if(it == passes.end())
+      it = passes.insert(passes.end(), BenchmarkPass{.name = section, .min = info.gpu.last / 1000.0});
+    const double time = info.gpu.last / 1000.0;  // The profiler is in microseconds
+    it->total += time;
+    it->min = std::min(it->min, time);
+    it->max = std::max(it->max, time);
+    it->count++;
+  }
+}
+
+std::vector<std::string> gltfr::BenchmarkReport::readSceneList(const std::string& filename)
+{
+  const std::filesystem::path path(filename);
+  const std::string           extension = path.extension().string();
+  if(extension == ".gltf" || extension == ".glb" || extension == ".obj")
+    return {filename};
+
+  std::ifstream file(filename);
+  if(!file)
+  {
+    LOGE("Benchmark: cannot read %s\n", filename.c_str());
+    return {};
+  }
+
+  std::vector<std::string> scenes;
+  std::string              line;
+  while(std::getline(file, line))
+  {
+    const size_t first = line.find_first_not_of(" \t\r");
+    if(first == std::string::npos || line[first] == '#')
+      continue;
+    const size_t                last = line.find_last_not_of(" \t\r");
+    const std::filesystem::path scene(line.substr(first, last - first + 1));
+    scenes.push_back(scene.is_absolute() ? scene.string() : (path.parent_path() / scene).string());
+  }
+  return scenes;
+}
+
+VkDeviceSize gltfr::BenchmarkReport::deviceMemoryUsage(VkPhysicalDevice physicalDevice)
+{
+  static bool hasMemoryBudget = [&]() {
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> extensions(count);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, extensions.data());
+    return std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties& ext) {
+      return strcmp(ext.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+    });
+  }();
+  if(!hasMemoryBudget)
+    return 0;
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+  VkPhysicalDeviceMemoryProperties2 memProps{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, &budgetProps};
+  vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memProps);
+
+  VkDeviceSize usage = 0;
+  for(uint32_t i = 0; i < memProps.memoryProperties.memoryHeapCount; i++)
+  {
+    if(memProps.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+      usage += budgetProps.heapUsage[i];
+  }
+  return usage;
+}
+
+void gltfr::BenchmarkReport::setDevice(VkPhysicalDevice physicalDevice, VkExtent2D size)
+{
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  m_device        = properties.deviceName;
+  m_driverVersion = properties.driverVersion;
+  m_size          = size;
+}
+
+gltfr::BenchmarkScene& gltfr::BenchmarkReport::addScene(const std::string& filename)
+{
+  m_scenes.push_back({.filename = filename});
+  return m_scenes.back();
+}
+
+//--------------------------------------------------------------------------------------------------
+// The report, all times in milliseconds and memory in MB
+//
+bool gltfr::BenchmarkReport::write(const std::string& filename) const
+{
+  std::ofstream file(filename);
+  if(!file)
+  {
+    LOGE("Benchmark: cannot write %s\n", filename.c_str());
+    return false;
+  }
+
+  VkDeviceSize peakMemory = 0;
+  file << "{\n";
+  file << "  \"device\": " << quoted(m_device) << ",\n";
+  file << "  \"driverVersion\": " << m_driverVersion << ",\n";
+  file << "  \"size\": [" << m_size.width << ", " << m_size.height << "],\n";
+  file << "  \"settings\": {";
+  for(size_t i = 0; i < m_settings.size(); i++)
+    file << (i ? ", " : "") << quoted(m_settings[i].first) << ": " << number(m_settings[i].second);
+  file << "},\n";
+  file << "  \"scenes\": [";
+  for(size_t s = 0; s < m_scenes.size(); s++)
+  {
+    const BenchmarkScene& scene = m_scenes[s];
+    file << (s ? "," : "") << "\n    {\n";
+    file << "      \"file\": " << quoted(std::filesystem::path(scene.filename).generic_string()) << ",\n";
+    file << "      \"loaded\": " << (scene.loaded ? "true" : "false") << ",\n";
+    file << "      \"load\": {";
+    for(const auto& [stage, time] : scene.loadStages)
+      file << quoted(stage) << ": " << number(time) << ", ";
+    file << "\"total\": " << number(scene.loadTime) << "},\n";
+    file << "      \"accelCached\": " << (scene.accelCached ? "true" : "false") << ",\n";
+    file << "      \"views\": " << scene.views << ",\n";
+    file << "      \"runs\": [";
+    for(size_t r = 0; r < scene.runs.size(); r++)
+    {
+      const BenchmarkRun& run       = scene.runs[r];
+      const double        frameTime = run.frames ? run.time / run.frames : 0.0;
+      file << (r ? "," : "") << "\n        {\n";
+      file << "          \"renderer\": " << quoted(run.renderer) << ",\n";
+      file << "          \"mode\": " << quoted(run.mode) << ",\n";
+      file << "          \"frames\": " << run.frames << ",\n";
+      file << "          \"frameTime\": " << number(frameTime) << ",\n";
+      file << "          \"samplesPerSecond\": " << number(run.time > 0.0 ? run.samplesPerFrame * run.frames / (run.time / 1000.0) : 0.0) << ",\n";
+      file << "          \"peakMemoryMB\": " << number(megabytes(run.peakMemory)) << ",\n";
+      file << "          \"passes\": {";
+      for(size_t p = 0; p < run.passes.size(); p++)
+      {
+        const BenchmarkPass& pass = run.passes[p];
+        file << (p ? "," : "") << "\n            " << quoted(pass.name) << ": {\"average\": " << number(pass.total / pass.count)
+             << ", \"min\": " << number(pass.min) << ", \"max\": " << number(pass.max) << "}";
+      }
+      file << (run.passes.empty() ? "}" : "\n          }") << "\n        }";
+      peakMemory = std::max(peakMemory, run.peakMemory);
+    }
+    file << (scene.runs.empty() ? "]" : "\n      ]") << "\n    }";
+  }
+  file << (m_scenes.empty() ? "]" : "\n  ]") << ",\n";
+  file << "  \"peakMemoryMB\": " << number(megabytes(peakMemory)) << "\n";
+  file << "}\n";
+
+  LOGI("Benchmark: %s\n", filename.c_str());
+  return true;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Benchmark: reproducible timings, written as a JSON report (--benchmark)
+
+  The list has one scene per line, relative to the directory of the list, and
+  lines starting with '#' are comments; a glTF, GLB or OBJ file is a list of
+  one scene.
+
+  Each scene is loaded on the main thread, for the timings of the stages of
+  the load, then each configuration (renderer and render mode) renders the
+  warm-up frames, and the measured frames over the views of the scene: its
+  cameras, or an orbit around the scene camera. A run records, over the
+  measured frames:
+
+  - the frame time, from the submission to the end of the frame on the GPU
+  - the GPU time of the sections of the profiler (Raytrace, Raster, ...)
+  - the samples per second of the path tracer, pixels x samples per frame
+  - the peak of the device-local memory in use (VK_EXT_memory_budget)
+
+*/
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// nvpro-core
+#include "nvh/profiler.hpp"
+
+namespace gltfr {
+
+struct BenchmarkPass
+{
+  std::string name;
+  double      total{0.0};  // ms
+  double      min{0.0};
+  double      max{0.0};
+  uint32_t    count{0};
+};
+
+struct BenchmarkRun
+{
+  std::string                renderer;
+  std::string                mode;
+  uint32_t                   frames{0};
+  double                     time{0.0};  // ms, all the measured frames
+  double                     samplesPerFrame{0.0};
+  VkDeviceSize               peakMemory{0};
+  std::vector<BenchmarkPass> passes;
+
+  // The GPU time of the sections of the last frame the profiler has the results of
+  void addFrame(nvh::Profiler& profiler, VkDeviceSize memoryUsage);
+};
+
+struct BenchmarkScene
+{
+  std::string                                 filename;
+  bool                                        loaded{false};
+  std::vector<std::pair<std::string, double>> loadStages;  // Name and ms
+  double                                      loadTime{0.0};
+  bool                                        accelCached{false};
+  uint32_t                                    views{0};
+  std::vector<BenchmarkRun>                   runs;
+};
+
+class BenchmarkReport
+{
+public:
+  // The scenes of a list, or the scene itself
+  static std::vector<std::string> readSceneList(const std::string& filename);
+  // Device-local memory in use by the process, 0 without VK_EXT_memory_budget
+  static VkDeviceSize deviceMemoryUsage(VkPhysicalDevice physicalDevice);
+
+  void setDevice(VkPhysicalDevice physicalDevice, VkExtent2D size);
+  void setSettings(std::vector<std::pair<std::string, double>>&& settings) { m_settings = std::move(settings); }
+
+  BenchmarkScene& addScene(const std::string& filename);
+  bool            write(const std::string& filename) const;
+
+private:
+  std::string                                 m_device;
+  uint32_t                                    m_driverVersion{0};
+  VkExtent2D                                  m_size{};
+  std::vector<std::pair<std::string, double>> m_settings;
+  std::vector<BenchmarkScene>                 m_scenes;
+};
+
+}  // namespace gltfr
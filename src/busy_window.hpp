@@ -24,6 +24,9 @@
     This function place a Popup window in the middle of the screen, blocking all inputs and is
     use to show the application is busy doing something
 
+    When not blocking, a small progress window is shown instead and the application
+    continues to render.
+
 */
 
 
@@ -35,10 +38,18 @@
 class BusyWindow
 {
 public:
-  void start(const std::string& reason)
+  void start(const std::string& reason, bool blocking = true)
+  {
+    m_busy     = true;
+    m_blocking = blocking;
+    m_reason   = reason;
+    m_progress = -1.0F;
+  }
+  // Progress [0..1] of a non-blocking work, negative for indeterminate
+  void setProgress(float progress, const std::string& reason)
   {
-    m_busy   = true;
-    m_reason = reason;
+    m_progress = progress;
+    m_reason   = reason;
   }
   void stop()
   {
@@ -47,6 +58,7 @@ public:
   }
   void consumeDone() { m_done = false; }
   bool isBusy() const { return m_busy; }
+  bool isBlocking() const { return m_busy && m_blocking; }
   bool isDone() const { return m_done; }
 
   // Display a modal window when loading assets or other long operation on separated thread
@@ -55,6 +67,12 @@ public:
     if(m_reason.empty())
       return;
 
+    if(!m_blocking)
+    {
+      showProgress();
+      return;
+    }
+
     // Display a modal window when loading assets or other long operation on separated thread
     ImGui::OpenPopup("Busy Info");
 
@@ -78,7 +96,27 @@ public:
   }
 
 private:
+  // Display a small window at the bottom of the viewport, without blocking inputs
+  inline void showProgress()
+  {
+    const ImGuiViewport* viewport = ImGui::GetMainViewport();
+    const ImVec2         pos(viewport->WorkPos.x + viewport->WorkSize.x * 0.5F, viewport->WorkPos.y + viewport->WorkSize.y - 10.0F);
+    ImGui::SetNextWindowPos(pos, ImGuiCond_Always, ImVec2(0.5F, 1.0F));
+    ImGui::SetNextWindowSize(ImVec2(300, 0));
+    ImGui::SetNextWindowBgAlpha(0.8F);
+    const ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoInputs | ImGuiWindowFlags_NoSavedSettings
+                                   | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav;
+    if(ImGui::Begin("Busy Progress", nullptr, flags))
+    {
+      const float progress = m_progress < 0.0F ? -.20f * float(ImGui::GetTime()) : m_progress;
+      ImGui::ProgressBar(progress, ImVec2(-1.0f, 0.0f), m_reason.c_str());
+    }
+    ImGui::End();
+  }
+
   std::atomic<bool> m_busy{false};
+  bool              m_blocking{true};
   bool              m_done{false};
+  float             m_progress{-1.0F};
   std::string       m_reason;
 };
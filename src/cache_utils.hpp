@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Helpers for the on-disk caches of the application
+
+  - Hasher: incremental 64-bit FNV-1a, used to build the cache keys
+  - getCacheDirectory: where the cache files are stored
+  - readCacheFile / writeCacheFile: binary file access
+
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "vulkan/vulkan_core.h"
+
+namespace gltfr {
+
+struct Hasher
+{
+  uint64_t value = 0xcbf29ce484222325ULL;
+
+  Hasher& add(const void* data, size_t size)
+  {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for(size_t i = 0; i < size; i++)
+    {
+      value ^= bytes[i];
+      value *= 0x100000001b3ULL;
+    }
+    return *this;
+  }
+
+  template <typename T>
+  Hasher& add(const T& v)
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "Only plain data can be hashed");
+    return add(&v, sizeof(T));
+  }
+
+  Hasher& add(const std::string& str) { return add(str.data(), str.size()); }
+
+  // 64-bit words at a time, for large buffers (not the same value as add())
+  Hasher& addWords(const void* data, size_t size)
+  {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t         i     = 0;
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+      uint64_t word;
+      std::memcpy(&word, bytes + i, sizeof(word));
+      value = (value ^ word) * 0x100000001b3ULL;
+      value ^= value >> 32;
+    }
+    return add(bytes + i, size - i);
+  }
+
+  template <typename T>
+  Hasher& add(const std::vector<T>& vec)
+  {
+    add(vec.size());
+    return add(vec.data(), vec.size() * sizeof(T));
+  }
+
+  // Identify the GPU and driver, for data that is only valid on the same device
+  Hasher& addDevice(VkPhysicalDevice physicalDevice)
+  {
+    VkPhysicalDeviceIDProperties idProps{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES};
+    VkPhysicalDeviceProperties2  props{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &idProps};
+    vkGetPhysicalDeviceProperties2(physicalDevice, &props);
+    add(idProps.deviceUUID);
+    add(idProps.driverUUID);
+    add(props.properties.driverVersion);
+    return add(props.properties.pipelineCacheUUID);
+  }
+
+  std::string toString() const
+  {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(value));
+    return buf;
+  }
+};
+
+// Directory of the cache files, created if needed
+inline std::filesystem::path getCacheDirectory()
+{
+  std::error_code       ec;
+  std::filesystem::path dir = std::filesystem::temp_directory_path(ec) / "vk_gltf_renderer_cache";
+  std::filesystem::create_directories(dir, ec);
+  return dir;
+}
+
+inline bool readCacheFile(const std::filesystem::path& path, std::vector<char>& data)
+{
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if(!file)
+    return false;
+  data.resize(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  return static_cast<bool>(file.read(data.data(), data.size()));
+}
+
+// Write to a temporary file first, such that a reader never sees a partial file
+inline bool writeCacheFile(const std::filesystem::path& path, const void* data, size_t size)
+{
+  std::filesystem::path tmpPath = path;
+  tmpPath += ".tmp";
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if(!file || !file.write(static_cast<const char*>(data), size))
+      return false;
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, path, ec);
+  return !ec;
+}
+
+}  // namespace gltfr
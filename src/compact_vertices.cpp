@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "compact_vertices.hpp"
+#include "gltf_accessor.hpp"
+
+// nvpro-core
+#include "nvh/nvprint.hpp"
+#include "nvh/timesampler.hpp"
+#include "nvvk/buffers_vk.hpp"
+#include "nvvk/commands_vk.hpp"
+#include "nvvk/debug_util_vk.hpp"
+#include "nvvk/error_vk.hpp"
+#include "nvvkhl/shaders/dh_scn_desc.h"
+
+#include "_autogen/compact_vertices.comp.glsl.h"
+
+namespace gltfr {
+extern bool g_forceExternalShaders;
+}
+
+namespace {
+constexpr VkDeviceSize kUpdateBufferMaxSize = 65536;  // Limit of vkCmdUpdateBuffer
+
+// Bounds of the positions, from the accessor or from its data
+void positionBounds(const tinygltf::Model& model, int accessorID, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+  const tinygltf::Accessor& accessor = model.accessors[accessorID];
+  if(accessor.minValues.size() == 3 && accessor.maxValues.size() == 3 && !accessor.sparse.isSparse)
+  {
+    boundsMin = {accessor.minValues[0], accessor.minValues[1], accessor.minValues[2]};
+    boundsMax = {accessor.maxValues[0], accessor.maxValues[1], accessor.maxValues[2]};
+    return;
+  }
+  const std::vector<float> positions = readAccessor(model, accessorID, 3);
+  boundsMin                          = glm::vec3(std::numeric_limits<float>::max());
+  boundsMax                          = glm::vec3(-std::numeric_limits<float>::max());
+  for(size_t i = 0; i + 2 < positions.size(); i += 3)
+  {
+    const glm::vec3 p(positions[i], positions[i + 1], positions[i + 2]);
+    boundsMin = glm::min(boundsMin, p);
+    boundsMax = glm::max(boundsMax, p);
+  }
+}
+}  // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Compute pipeline, only using push constants and buffer addresses
+//
+bool gltfr::CompactVertices::createPipeline(Resources& res)
+{
+  m_device = res.ctx.device;
+
+  VkShaderModuleCreateInfo shaderModuleCreateInfo{.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+  std::vector<uint32_t>    spirvCode;
+  if(res.hasGlslCompiler() && g_forceExternalShaders)
+  {
+    if(!res.compileGlslShader("compact_vertices.comp.glsl", shaderc_shader_kind::shaderc_compute_shader, spirvCode)
+       || !res.createShaderModuleCreateInfo(spirvCode, shaderModuleCreateInfo))
+      return false;
+  }
+  else
+  {
+    // Pre-compiled version
+    shaderModuleCreateInfo = {.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                              .codeSize = sizeof(compact_vertices_comp_glsl),
+                              .pCode    = &compact_vertices_comp_glsl[0]};
+  }
+
+  const VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DH::PushConstantCompact)};
+  const VkPipelineLayoutCreateInfo layoutInfo{.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                                              .pushConstantRangeCount = 1,
+                                              .pPushConstantRanges    = &pushConstantRange};
+  NVVK_CHECK(vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_pipelineLayout));
+
+  VkShaderModule shaderModule{};
+  NVVK_CHECK(vkCreateShaderModule(m_device, &shaderModuleCreateInfo, nullptr, &shaderModule));
+  const VkComputePipelineCreateInfo pipelineInfo{
+      .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .stage  = {.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                 .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                 .module = shaderModule,
+                 .pName  = "main"},
+      .layout = m_pipelineLayout,
+  };
+  NVVK_CHECK(vkCreateComputePipelines(m_device, res.m_pipelineCache, 1, &pipelineInfo, nullptr, &m_pipeline));
+  vkDestroyShaderModule(m_device, shaderModule, nullptr);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_pipeline);
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Called by the loader, with the scene allocator and the compute queue
+// - One dispatch per primitive encodes its vertices in new buffers
+// - Once executed, the fp32 buffers are destroyed and replaced
+// - The render primitives are rewritten with the new addresses, the compact ones tagged
+//
+uint32_t gltfr::CompactVertices::compact(Resources&                   res,
+                                         const nvh::gltf::Scene&      scene,
+                                         SceneVkStreamed&             sceneVk,
+                                         const std::vector<uint32_t>& keep)
+{
+  nvh::ScopedTimer st(__FUNCTION__);
+
+  if(m_pipeline == VK_NULL_HANDLE && !createPipeline(res))
+  {
+    LOGW("Compact vertices: the compute shader could not be created, the vertices are kept in fp32\n");
+    return 0;
+  }
+
+  nvvk::ResourceAllocator*                       alloc      = res.m_sceneAllocator.get();
+  const tinygltf::Model&                         model      = scene.getModel();
+  const std::vector<nvh::gltf::RenderPrimitive>& primitives = scene.getRenderPrimitives();
+  constexpr VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+  nvvk::CommandPool cmdPool(m_device, res.ctx.compute.familyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, res.ctx.compute.queue);
+  VkCommandBuffer   cmd = cmdPool.createCommandBuffer();
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+
+  struct Replacement
+  {
+    uint32_t                       renderPrimID;
+    SceneVkStreamed::VertexBuffers buffers;
+  };
+  std::vector<Replacement> replacements;
+  auto address = [&](const nvvk::Buffer& buffer) -> VkDeviceAddress {
+    return buffer.buffer != VK_NULL_HANDLE ? nvvk::getBufferDeviceAddress(m_device, buffer.buffer) : 0;
+  };
+
+  // A buffer shared by several primitives is left as it is, for all of them: it would be replaced
+  // and destroyed under the others
+  std::unordered_map<VkBuffer, uint32_t> users;
+  for(uint32_t primID = 0; primID < static_cast<uint32_t>(primitives.size()); primID++)
+  {
+    const VkBuffer buffer = sceneVk.mutableVertexBuffers(primID).position.buffer;
+    if(buffer != VK_NULL_HANDLE)
+      users[buffer]++;
+  }
+
+  for(uint32_t primID = 0; primID < static_cast<uint32_t>(primitives.size()); primID++)
+  {
+    const SceneVkStreamed::VertexBuffers& src      = sceneVk.mutableVertexBuffers(primID);
+    const auto                            position = primitives[primID].pPrimitive->attributes.find("POSITION");
+    if(std::binary_search(keep.begin(), keep.end(), primID) || src.position.buffer == VK_NULL_HANDLE
+       || position == primitives[primID].pPrimitive->attributes.end() || users[src.position.buffer] > 1)
+      continue;
+
+    glm::vec3 boundsMin, boundsMax;
+    positionBounds(model, position->second, boundsMin, boundsMax);
+    const uint32_t     vertexCount = static_cast<uint32_t>(model.accessors[position->second].count);
+    const VkDeviceSize attribSize  = std::max<VkDeviceSize>(vertexCount * sizeof(uint32_t), 4);
+
+    Replacement                     replacement{.renderPrimID = primID, .buffers = src};
+    SceneVkStreamed::VertexBuffers& dst = replacement.buffers;
+    dst.position  = alloc->createBuffer(COMPACT_HEADER_SIZE + VkDeviceSize(vertexCount) * sizeof(glm::uvec2),
+                                        usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    dst.normal    = src.normal.buffer != VK_NULL_HANDLE ? alloc->createBuffer(attribSize, usage) : nvvk::Buffer{};
+    dst.tangent   = src.tangent.buffer != VK_NULL_HANDLE ? alloc->createBuffer(attribSize, usage) : nvvk::Buffer{};
+    dst.texCoord0 = src.texCoord0.buffer != VK_NULL_HANDLE ? alloc->createBuffer(attribSize, usage) : nvvk::Buffer{};
+    dst.texCoord1 = src.texCoord1.buffer != VK_NULL_HANDLE ? alloc->createBuffer(attribSize, usage) : nvvk::Buffer{};
+
+    const DH::CompactHeader header{.boundsMin = boundsMin, .boundsExtent = boundsMax - boundsMin};
+    vkCmdUpdateBuffer(cmd, dst.position.buffer, 0, sizeof(header), &header);
+
+    const DH::PushConstantCompact pc{.srcPositions  = address(src.position),
+                                     .srcNormals    = address(src.normal),
+                                     .srcTangents   = address(src.tangent),
+                                     .srcTexCoords0 = address(src.texCoord0),
+                                     .srcTexCoords1 = address(src.texCoord1),
+                                     .dstPositions  = address(dst.position) + COMPACT_HEADER_SIZE,
+                                     .dstNormals    = address(dst.normal),
+                                     .dstTangents   = address(dst.tangent),
+                                     .dstTexCoords0 = address(dst.texCoord0),
+                                     .dstTexCoords1 = address(dst.texCoord1),
+                                     .boundsMin     = header.boundsMin,
+                                     .vertexCount   = vertexCount,
+                                     .boundsExtent  = header.boundsExtent};
+    vkCmdPushConstants(cmd, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+    vkCmdDispatch(cmd, (vertexCount + COMPACT_WORKGROUP_SIZE - 1) / COMPACT_WORKGROUP_SIZE, 1, 1);
+    replacements.push_back(replacement);
+  }
+  if(replacements.empty())
+  {
+    cmdPool.destroy(cmd);
+    return 0;
+  }
+  cmdPool.submitAndWait(cmd);
+
+  // The fp32 buffers are no longer needed: the acceleration structures are built
+  std::unordered_set<uint32_t> compacted;
+  for(Replacement& replacement : replacements)
+  {
+    SceneVkStreamed::VertexBuffers& buffers = sceneVk.mutableVertexBuffers(replacement.renderPrimID);
+    alloc->destroy(buffers.position);
+    alloc->destroy(buffers.normal);
+    alloc->destroy(buffers.tangent);
+    alloc->destroy(buffers.texCoord0);
+    alloc->destroy(buffers.texCoord1);
+    buffers = replacement.buffers;  // The colors are kept
+    compacted.insert(replacement.renderPrimID);
+  }
+
+  // The render primitives with the new addresses
+  std::vector<nvvkhl_shaders::RenderPrimitive> renderPrims(primitives.size());
+  for(uint32_t primID = 0; primID < static_cast<uint32_t>(primitives.size()); primID++)
+  {
+    const SceneVkStreamed::VertexBuffers& buffers    = sceneVk.mutableVertexBuffers(primID);
+    nvvkhl_shaders::RenderPrimitive&      renderPrim = renderPrims[primID];
+    renderPrim.indexAddress                          = address(sceneVk.indices()[primID]);
+    renderPrim.vertexBuffer.positionAddress          = address(buffers.position) | (compacted.count(primID) ? COMPACT_VERTEX_TAG : 0);
+    renderPrim.vertexBuffer.normalAddress            = address(buffers.normal);
+    renderPrim.vertexBuffer.colorAddress             = address(buffers.color);
+    renderPrim.vertexBuffer.tangentAddress           = address(buffers.tangent);
+    renderPrim.vertexBuffer.texCoord0Address         = address(buffers.texCoord0);
+    renderPrim.vertexBuffer.texCoord1Address         = address(buffers.texCoord1);
+  }
+  cmd = cmdPool.createCommandBuffer();
+  const VkDeviceSize size = renderPrims.size() * sizeof(nvvkhl_shaders::RenderPrimitive);
+  for(VkDeviceSize offset = 0; offset < size; offset += kUpdateBufferMaxSize)
+  {
+    vkCmdUpdateBuffer(cmd, sceneVk.renderPrimitiveBuffer(), offset, std::min(kUpdateBufferMaxSize, size - offset),
+                      reinterpret_cast<const uint8_t*>(renderPrims.data()) + offset);
+  }
+  cmdPool.submitAndWait(cmd);
+
+  LOGI("Compact vertices: %zu of %zu render primitives\n", replacements.size(), primitives.size());
+  return static_cast<uint32_t>(replacements.size());
+}
+
+void gltfr::CompactVertices::destroy()
+{
+  if(m_device == VK_NULL_HANDLE)
+    return;
+  vkDestroyPipeline(m_device, m_pipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+  m_pipeline       = VK_NULL_HANDLE;
+  m_pipelineLayout = VK_NULL_HANDLE;
+}
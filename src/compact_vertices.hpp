@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Compact vertex attributes (--compactVertices)
+
+  Once the acceleration structures are built from the vertices of SceneVk, the
+  positions, normals, tangents and texture coordinates of the rigid render
+  primitives are encoded by a compute shader (see shaders/compact_vertices.h):
+  16-bit positions in the bounds of the primitive, octahedral normals and
+  tangents, half float texture coordinates; 20 bytes per vertex instead of 48.
+  The fp32 buffers are destroyed, the compact ones take their place in SceneVk
+  and in the render primitives read by the shaders (shaders/vertex_fetch.h).
+
+  The deformed primitives keep their format: the animation writes their
+  vertices, and their BLAS are refit from them.
+
+  The BLAS keep the fp32 positions: the path tracers take the hit position of
+  the compact primitives on the ray, not from the 16-bit vertices, so the next
+  rays start on the traced surface. Position buffers shared by several render
+  primitives are not compacted.
+
+*/
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// nvpro-core
+#include "nvh/gltfscene.hpp"
+
+#include "resources.hpp"
+#include "scene_vk_streamed.hpp"
+
+namespace DH {
+#include "shaders/compact_vertices.h"
+}
+
+namespace gltfr {
+
+class CompactVertices
+{
+public:
+  // Encode the vertices of the render primitives not in 'keep' (sorted), and replace their
+  // buffers in 'sceneVk'. Returns the number of compacted primitives.
+  uint32_t compact(Resources& res, const nvh::gltf::Scene& scene, SceneVkStreamed& sceneVk, const std::vector<uint32_t>& keep);
+  // Release the pipeline
+  void destroy();
+
+private:
+  bool createPipeline(Resources& res);
+
+  VkDevice         m_device{VK_NULL_HANDLE};
+  VkPipelineLayout m_pipelineLayout{VK_NULL_HANDLE};
+  VkPipeline       m_pipeline{VK_NULL_HANDLE};
+};
+
+}  // namespace gltfr
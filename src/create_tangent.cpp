@@ -24,8 +24,11 @@
  */
 
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <thread>
 #include <vector>
-#include <mutex>
 #include <tiny_gltf.h>
 #include <mikktspace.h>
 #include <glm/gtx/norm.hpp>
@@ -35,6 +38,12 @@
 #include "nvvkhl/shaders/func.h"
 
 
+// Large primitives are split in ranges of faces for the simple tangents, which only depend on their face.
+// MikkTSpace groups the corners over the whole primitive: it runs once per primitive.
+static constexpr uint32_t kFacesPerRange = 1 << 18;
+// Vertices finalized by a job
+static constexpr uint32_t kVerticesPerRange = 1 << 18;
+
 struct UserData
 {
   tinygltf::Model*     model            = nullptr;
@@ -45,118 +54,300 @@ struct UserData
   int32_t              tanAccessorIndex = -1;
 };
 
+// Attributes of a primitive packed as structure of arrays, and the tangents of its faces or corners
+// The results are written per face or per corner, without sharing, then welded per vertex in index
+// order: the tangents do not depend on the threads.
+struct PackedPrimitive
+{
+  std::vector<uint32_t> indices;
+  std::vector<float>    px, py, pz;
+  std::vector<float>    nx, ny, nz;
+  std::vector<float>    u, v;
 
-// MikkTSpace interface functions
-static int32_t getNumFaces(const SMikkTSpaceContext* pContext)
+  // MikkTSpace: tangent and sign of each corner, each vertex takes the one of its last corner
+  std::vector<glm::vec4> cornerTangents;
+  std::vector<uint32_t>  vertexOwner;  // Corner, ~0U for unused vertices
+
+  // Simple: tangent and bitangent of each face, summed per vertex over its faces
+  std::vector<glm::vec3> faceTangents;
+  std::vector<glm::vec3> faceBitangents;
+  std::vector<uint32_t>  vertexCornerOffsets;  // numVertices + 1, into vertexCorners
+  std::vector<uint32_t>  vertexCorners;        // Corners of each vertex, in index order
+
+  uint32_t numVertices() const { return static_cast<uint32_t>(px.size()); }
+  uint32_t numFaces() const { return static_cast<uint32_t>(indices.size() / 3); }
+};
+
+// A range of faces of a primitive (simple), or a range of vertices when finalizing
+struct WorkRange
 {
-  const UserData*            userdata  = static_cast<const UserData*>(pContext->m_pUserData);
-  const tinygltf::Primitive* primitive = userdata->primitive;
-  const tinygltf::Model*     model     = userdata->model;
-  const int32_t              count     = static_cast<int32_t>(tinygltf::utils::getIndexCount(*model, *primitive));
-  return count / 3;
-}
+  uint32_t primitive = 0;
+  uint32_t first     = 0;
+  uint32_t count     = 0;
+};
 
-static int32_t getNumVerticesOfFace(const SMikkTSpaceContext* pContext, const int32_t iFace)
+
+template <typename T>
+static T* accessorData(tinygltf::Model& model, int32_t accessorIndex, size_t& stride)
 {
-  return 3;  // Assuming triangles
+  const tinygltf::Accessor&   accessor   = model.accessors[accessorIndex];
+  const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+  tinygltf::Buffer&           buffer     = model.buffers[bufferView.buffer];
+  stride                                 = accessor.ByteStride(bufferView);
+  return reinterpret_cast<T*>(buffer.data.data() + bufferView.byteOffset + accessor.byteOffset);
 }
 
-inline static int32_t getIndex(const SMikkTSpaceContext* pContext, const int32_t iFace, const int32_t iVert)
+//--------------------------------------------------------------------------------------------------
+// Copy the indices and the attributes used by the tangent generation, avoiding the accessor
+// lookups in the per-corner callbacks
+//
+static void packPrimitive(const UserData& userData, PackedPrimitive& packed, bool mikktspace)
 {
-  const UserData*             userdata   = static_cast<const UserData*>(pContext->m_pUserData);
-  const tinygltf::Primitive*  primitive  = userdata->primitive;
-  const tinygltf::Model*      model      = userdata->model;
-  const tinygltf::Accessor&   accessor   = model->accessors[primitive->indices];
-  const tinygltf::BufferView& bufferView = model->bufferViews[accessor.bufferView];
-  const tinygltf::Buffer&     buffer     = model->buffers[bufferView.buffer];
-  const uint8_t*              data       = buffer.data.data() + bufferView.byteOffset + accessor.byteOffset;
-  const size_t                stride     = accessor.ByteStride(bufferView);
+  tinygltf::Model&           model       = *userData.model;
+  const tinygltf::Primitive& primitive   = *userData.primitive;
+  const uint32_t             numVertices = static_cast<uint32_t>(model.accessors[userData.posAccessorIndex].count);
 
-  const int32_t offset = iFace * 3 + iVert;
-  assert(accessor.sparse.isSparse == false);
-  switch(accessor.componentType)
+  if(primitive.indices >= 0)
   {
-    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-      return *reinterpret_cast<const uint32_t*>(data + offset * stride);
+    const tinygltf::Accessor& accessor = model.accessors[primitive.indices];
+    assert(accessor.sparse.isSparse == false);
+    size_t         stride = 0;
+    const uint8_t* data   = accessorData<uint8_t>(model, primitive.indices, stride);
+    packed.indices.resize(accessor.count);
+    for(size_t i = 0; i < accessor.count; i++)
+    {
+      switch(accessor.componentType)
+      {
+        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+          packed.indices[i] = *reinterpret_cast<const uint32_t*>(data + i * stride);
+          break;
+        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+          packed.indices[i] = *reinterpret_cast<const uint16_t*>(data + i * stride);
+          break;
+        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
+          packed.indices[i] = *reinterpret_cast<const uint8_t*>(data + i * stride);
+          break;
+        default:
+          packed.indices[i] = 0;
+      }
     }
-    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-      return *reinterpret_cast<const uint16_t*>(data + offset * stride);
+  }
+  else
+  {
+    packed.indices.resize(numVertices);
+    std::iota(packed.indices.begin(), packed.indices.end(), 0U);
+  }
+  packed.indices.resize(packed.indices.size() / 3 * 3);  // Triangles only
+
+  auto unpack = [&](int32_t accessorIndex, std::initializer_list<std::vector<float>*> channels) {
+    size_t         stride = 0;
+    const uint8_t* data   = accessorData<const uint8_t>(model, accessorIndex, stride);
+    size_t         c      = 0;
+    for(std::vector<float>* channel : channels)
+    {
+      channel->resize(numVertices);
+      for(uint32_t i = 0; i < numVertices; i++)
+        (*channel)[i] = reinterpret_cast<const float*>(data + i * stride)[c];
+      c++;
     }
-    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-      return *reinterpret_cast<const uint8_t*>(data + offset * stride);
+  };
+  unpack(userData.posAccessorIndex, {&packed.px, &packed.py, &packed.pz});
+  unpack(userData.nrmAccessorIndex, {&packed.nx, &packed.ny, &packed.nz});
+  unpack(userData.uvAccessorIndex, {&packed.u, &packed.v});
+
+  if(mikktspace)
+  {
+    packed.cornerTangents.assign(packed.indices.size(), glm::vec4(0.0F));
+  }
+  else
+  {
+    packed.faceTangents.assign(packed.numFaces(), glm::vec3(0.0F));
+    packed.faceBitangents.assign(packed.numFaces(), glm::vec3(0.0F));
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Which corners give the tangent of each vertex, in index order
+// - MikkTSpace: the last corner, as when the corners were written in the attribute one after the other
+// - Simple: all corners, their faces are summed in this order
+//
+static void buildVertexCorners(PackedPrimitive& packed, bool mikktspace)
+{
+  const uint32_t numVertices = packed.numVertices();
+  const uint32_t numCorners  = static_cast<uint32_t>(packed.indices.size());
+  if(mikktspace)
+  {
+    packed.vertexOwner.assign(numVertices, ~0U);
+    for(uint32_t c = 0; c < numCorners; c++)
+    {
+      if(packed.indices[c] < numVertices)
+        packed.vertexOwner[packed.indices[c]] = c;
     }
+    return;
+  }
+
+  packed.vertexCornerOffsets.assign(size_t(numVertices) + 1, 0);
+  for(uint32_t index : packed.indices)
+  {
+    if(index < numVertices)
+      packed.vertexCornerOffsets[index + 1]++;
+  }
+  std::partial_sum(packed.vertexCornerOffsets.begin(), packed.vertexCornerOffsets.end(), packed.vertexCornerOffsets.begin());
+  packed.vertexCorners.resize(packed.vertexCornerOffsets.back());
+  std::vector<uint32_t> cursor(packed.vertexCornerOffsets.begin(), packed.vertexCornerOffsets.end() - 1);
+  for(uint32_t c = 0; c < numCorners; c++)
+  {
+    if(packed.indices[c] < numVertices)
+      packed.vertexCorners[cursor[packed.indices[c]]++] = c;
   }
-  return 0;
 }
 
-template <typename T>
-inline static T* getAttributeData(const SMikkTSpaceContext* pContext, const int32_t iFace, const int32_t iVert, int32_t accessorIndex)
+
+// MikkTSpace interface functions
+static int32_t getNumFaces(const SMikkTSpaceContext* pContext)
 {
-  auto             userdata = static_cast<const UserData*>(pContext->m_pUserData);
-  tinygltf::Model* model    = userdata->model;
-  const int32_t    index    = getIndex(pContext, iFace, iVert);
+  return static_cast<int32_t>(static_cast<const PackedPrimitive*>(pContext->m_pUserData)->numFaces());
+}
 
-  const tinygltf::Accessor&   accessor   = model->accessors[accessorIndex];
-  const tinygltf::BufferView& bufferView = model->bufferViews[accessor.bufferView];
-  tinygltf::Buffer&           buffer     = model->buffers[bufferView.buffer];
+static int32_t getNumVerticesOfFace(const SMikkTSpaceContext* pContext, const int32_t iFace)
+{
+  return 3;  // Assuming triangles
+}
 
-  uint8_t*     data   = buffer.data.data() + bufferView.byteOffset + accessor.byteOffset;
-  const size_t stride = accessor.ByteStride(bufferView);
-  return reinterpret_cast<T*>(data + index * stride);
+inline static uint32_t getIndex(const SMikkTSpaceContext* pContext, const int32_t iFace, const int32_t iVert)
+{
+  return static_cast<const PackedPrimitive*>(pContext->m_pUserData)->indices[size_t(iFace) * 3 + iVert];
 }
 
 inline static void getPosition(const SMikkTSpaceContext* pContext, float fvPosOut[], const int32_t iFace, const int32_t iVert)
 {
-  const glm::vec3* positions =
-      getAttributeData<glm::vec3>(pContext, iFace, iVert, static_cast<const UserData*>(pContext->m_pUserData)->posAccessorIndex);
-  std::memcpy(fvPosOut, positions, sizeof(glm::vec3));
+  const PackedPrimitive& packed = *static_cast<const PackedPrimitive*>(pContext->m_pUserData);
+  const uint32_t         index  = getIndex(pContext, iFace, iVert);
+  fvPosOut[0]                   = packed.px[index];
+  fvPosOut[1]                   = packed.py[index];
+  fvPosOut[2]                   = packed.pz[index];
 }
 
 inline static void getNormal(const SMikkTSpaceContext* pContext, float fvNormOut[], const int32_t iFace, const int32_t iVert)
 {
-  const glm::vec3* normals =
-      getAttributeData<glm::vec3>(pContext, iFace, iVert, static_cast<const UserData*>(pContext->m_pUserData)->nrmAccessorIndex);
-  std::memcpy(fvNormOut, normals, sizeof(glm::vec3));
+  const PackedPrimitive& packed = *static_cast<const PackedPrimitive*>(pContext->m_pUserData);
+  const uint32_t         index  = getIndex(pContext, iFace, iVert);
+  fvNormOut[0]                  = packed.nx[index];
+  fvNormOut[1]                  = packed.ny[index];
+  fvNormOut[2]                  = packed.nz[index];
 }
 
 inline static void getTexCoord(const SMikkTSpaceContext* pContext, float fvTexcOut[], const int32_t iFace, const int32_t iVert)
 {
-  const glm::vec2* texcoords =
-      getAttributeData<glm::vec2>(pContext, iFace, iVert, static_cast<const UserData*>(pContext->m_pUserData)->uvAccessorIndex);
-  std::memcpy(fvTexcOut, texcoords, sizeof(glm::vec2));
+  const PackedPrimitive& packed = *static_cast<const PackedPrimitive*>(pContext->m_pUserData);
+  const uint32_t         index  = getIndex(pContext, iFace, iVert);
+  fvTexcOut[0]                  = packed.u[index];
+  fvTexcOut[1]                  = packed.v[index];
 }
 
+// Per corner, the vertex takes the tangent of its last corner in finalizeTangents()
 inline static void setTSpaceBasic(const SMikkTSpaceContext* pContext, const float fvTangent[], const float fSign, const int32_t iFace, const int32_t iVert)
 {
-  glm::vec4*       tangent = getAttributeData<glm::vec4>(pContext, iFace, iVert,
-                                                   static_cast<const UserData*>(pContext->m_pUserData)->tanAccessorIndex);
-  const glm::vec3* normal =
-      getAttributeData<glm::vec3>(pContext, iFace, iVert, static_cast<const UserData*>(pContext->m_pUserData)->nrmAccessorIndex);
+  PackedPrimitive& packed = *static_cast<PackedPrimitive*>(pContext->m_pUserData);
+  packed.cornerTangents[size_t(iFace) * 3 + iVert] = {fvTangent[0], fvTangent[1], fvTangent[2], fSign};
+}
 
-  // MikkTSpace uses the variation in texture coordinates to calculate the tangent and bitangent vectors.
-  // In case of incorrect input values, the resulting tangent might not be orthogonal to the normal.
-  // This additional check ensures the tangent is orthogonal to the normal and corrects it if necessary.
-  glm::vec3 tng = {fvTangent[0], fvTangent[1], fvTangent[2]};
-  if(glm::abs(glm::dot(tng, *normal)) < 0.9f)
+// Simpler version of the tangent space generation, for a range of faces
+// The tangent and bitangent of each face, from the UV gradients, are summed per vertex in finalizeTangents().
+static void simpleCreateTangents(PackedPrimitive& packed, uint32_t firstFace, uint32_t numFaces)
+{
+  const uint32_t* indices = packed.indices.data();
+  for(uint32_t f = firstFace; f < firstFace + numFaces; f++)
   {
-    // The sign is flipped for Vulkan as the texture coordinates are flipped from OpenGL
-    *tangent = {fvTangent[0], fvTangent[1], fvTangent[2], -fSign};
+    const uint32_t i0 = indices[f * 3 + 0];
+    const uint32_t i1 = indices[f * 3 + 1];
+    const uint32_t i2 = indices[f * 3 + 2];
+
+    const float e1x = packed.px[i1] - packed.px[i0], e1y = packed.py[i1] - packed.py[i0], e1z = packed.pz[i1] - packed.pz[i0];
+    const float e2x = packed.px[i2] - packed.px[i0], e2y = packed.py[i2] - packed.py[i0], e2z = packed.pz[i2] - packed.pz[i0];
+    const float du1 = packed.u[i1] - packed.u[i0], dv1 = packed.v[i1] - packed.v[i0];
+    const float du2 = packed.u[i2] - packed.u[i0], dv2 = packed.v[i2] - packed.v[i0];
+
+    const float det = du1 * dv2 - du2 * dv1;
+    if(std::abs(det) < 1e-12F)
+      continue;  // Degenerate UVs: the vertex falls back to makeFastTangent() if no other face contributes
+    const float r = 1.0F / det;
+
+    packed.faceTangents[f] = {(e1x * dv2 - e2x * dv1) * r, (e1y * dv2 - e2y * dv1) * r, (e1z * dv2 - e2z * dv1) * r};
+    packed.faceBitangents[f] = {(e2x * du1 - e1x * du2) * r, (e2y * du1 - e1y * du2) * r, (e2z * du1 - e1z * du2) * r};
   }
-  else
+}
+
+//--------------------------------------------------------------------------------------------------
+// Weld the tangents of a range of vertices and write them to the TANGENT attribute
+// The tangent is made orthogonal to the normal; when it can't be, a tangent is made from the normal.
+// The sign is flipped for Vulkan as the texture coordinates are flipped from OpenGL.
+//
+static void finalizeTangents(const UserData& userData, const PackedPrimitive& packed, uint32_t first, uint32_t count, bool mikktspace)
+{
+  size_t     stride   = 0;
+  uint8_t*   tangents = accessorData<uint8_t>(*userData.model, userData.tanAccessorIndex, stride);
+  const auto end      = first + count;
+  for(uint32_t i = first; i < end; i++)
   {
-    *tangent = makeFastTangent(*normal);
+    const glm::vec3 n = {packed.nx[i], packed.ny[i], packed.nz[i]};
+    glm::vec3       t(0.0F);
+    glm::vec3       b(0.0F);
+    float           mikkSign = 1.0F;
+    if(mikktspace)
+    {
+      if(packed.vertexOwner[i] != ~0U)
+      {
+        const glm::vec4& corner = packed.cornerTangents[packed.vertexOwner[i]];
+        t                       = glm::vec3(corner);
+        mikkSign                = corner.w;
+      }
+    }
+    else
+    {
+      for(uint32_t c = packed.vertexCornerOffsets[i]; c < packed.vertexCornerOffsets[i + 1]; c++)
+      {
+        const uint32_t face = packed.vertexCorners[c] / 3;
+        t += packed.faceTangents[face];
+        b += packed.faceBitangents[face];
+      }
+    }
+
+    // MikkTSpace uses the variation in texture coordinates to calculate the tangent and bitangent vectors.
+    // In case of incorrect input values, the resulting tangent might not be orthogonal to the normal.
+    // This additional check ensures the tangent is orthogonal to the normal and corrects it if necessary.
+    const float len = glm::length(t);
+    glm::vec4   tangent;
+    if(len > 1e-12F && glm::abs(glm::dot(t / len, n)) < 0.9F)
+    {
+      t = glm::normalize(t - n * glm::dot(n, t));
+      float sign;
+      if(mikktspace)
+        sign = mikkSign >= 0.0F ? 1.0F : -1.0F;
+      else
+        sign = glm::dot(glm::cross(n, t), b) >= 0.0F ? 1.0F : -1.0F;
+      tangent = {t, -sign};
+    }
+    else
+    {
+      tangent = makeFastTangent(n);
+    }
+    *reinterpret_cast<glm::vec4*>(tangents + i * stride) = tangent;
   }
 }
 
-// Simpler version of the tangent space generation
-void simpleCreateTangents(SMikkTSpaceContext* mikkContext)
+// Split 'count' elements of a primitive in ranges
+static void appendRanges(std::vector<WorkRange>& ranges, uint32_t primitive, uint32_t count, uint32_t rangeSize)
 {
-  auto userData = static_cast<UserData*>(mikkContext->m_pUserData);
-  tinygltf::utils::simpleCreateTangents(*userData->model, *userData->primitive);
+  for(uint32_t first = 0; first < count; first += rangeSize)
+    ranges.push_back({primitive, first, std::min(rangeSize, count - first)});
 }
 
 // Recompute the tangents for all primitives in the model
 // forceCreation: If true, it will create the TANGENT attribute if it doesn't exist
+// The work is balanced over the threads by splitting the primitives in ranges of faces (simple) and
+// of vertices, such that a scene made of a single large mesh uses all the cores. MikkTSpace runs
+// once per primitive, in parallel over the primitives. The result does not depend on the threads.
 void recomputeTangents(tinygltf::Model& model, bool forceCreation, bool mikktspace)
 {
   SMikkTSpaceInterface mikkInterface   = {};
@@ -201,18 +392,53 @@ void recomputeTangents(tinygltf::Model& model, bool forceCreation, bool mikktspa
     }
   }
 
-  uint32_t num_threads = std::min((uint32_t)userDatas.size(), std::thread::hardware_concurrency());
+  if(userDatas.empty())
+    return;
+
+  const uint32_t numThreads = std::max(1U, std::thread::hardware_concurrency());
+
+  std::vector<PackedPrimitive> packed(userDatas.size());
   nvh::parallel_batches<1>(
       userDatas.size(),
       [&](uint64_t i) {
-        SMikkTSpaceContext mikkContext = {};
-        mikkContext.m_pInterface       = &mikkInterface;
-        mikkContext.m_pUserData        = &userDatas[i];
+        packPrimitive(userDatas[i], packed[i], mikktspace);
+        buildVertexCorners(packed[i], mikktspace);
+      },
+      std::min(static_cast<uint32_t>(userDatas.size()), numThreads));
 
+  // Tangents of the corners (MikkTSpace, whole primitives) or of the faces (simple, face ranges)
+  std::vector<WorkRange> faceRanges;
+  for(uint32_t p = 0; p < packed.size(); p++)
+    appendRanges(faceRanges, p, packed[p].numFaces(), mikktspace ? std::max(packed[p].numFaces(), 1U) : kFacesPerRange);
+  // The largest primitives first, they would otherwise start last
+  std::stable_sort(faceRanges.begin(), faceRanges.end(), [](const WorkRange& a, const WorkRange& b) { return a.count > b.count; });
+  nvh::parallel_batches<1>(
+      faceRanges.size(),
+      [&](uint64_t i) {
+        const WorkRange& range = faceRanges[i];
         if(mikktspace)
+        {
+          SMikkTSpaceContext mikkContext = {};
+          mikkContext.m_pInterface       = &mikkInterface;
+          mikkContext.m_pUserData        = &packed[range.primitive];
           genTangSpaceDefault(&mikkContext);
+        }
         else
-          simpleCreateTangents(&mikkContext);
+        {
+          simpleCreateTangents(packed[range.primitive], range.first, range.count);
+        }
+      },
+      std::min(static_cast<uint32_t>(faceRanges.size()), numThreads));
+
+  // Welding per vertex and writing the attributes
+  std::vector<WorkRange> vertexRanges;
+  for(uint32_t p = 0; p < packed.size(); p++)
+    appendRanges(vertexRanges, p, packed[p].numVertices(), kVerticesPerRange);
+  nvh::parallel_batches<1>(
+      vertexRanges.size(),
+      [&](uint64_t i) {
+        const WorkRange& range = vertexRanges[i];
+        finalizeTangents(userDatas[range.primitive], packed[range.primitive], range.first, range.count, mikktspace);
       },
-      num_threads);
+      std::min(static_cast<uint32_t>(vertexRanges.size()), numThreads));
 }
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "dynamic_resolution.hpp"
+
+// nvpro-core
+#include "imgui/imgui_helper.h"
+
+namespace PE = ImGuiH::PropertyEditor;
+
+float gltfr::DynamicResolution::update(nvh::Profiler& profiler, const std::vector<std::string>& sections, bool interacting)
+{
+  if(!enabled)
+    return setScale(1.0F);
+
+  if(m_ignoreReset)
+  {
+    interacting   = false;
+    m_ignoreReset = false;
+  }
+
+  // Idle: back to full resolution
+  m_idleFrames = interacting ? 0 : m_idleFrames + 1;
+  if(m_idleFrames >= kIdleFrames)
+    return setScale(1.0F);
+
+  if(m_settleFrames > 0)
+  {
+    m_settleFrames--;
+    return m_scale;
+  }
+
+  double gpuTime = 0.0;  // ms
+  for(const std::string& section : sections)
+  {
+    nvh::Profiler::TimerInfo info{};
+    if(profiler.getTimerInfo(section.c_str(), info))
+      gpuTime += info.gpu.average / 1000.0;
+  }
+  if(gpuTime <= 0.0)
+    return m_scale;
+
+  // The cost follows the number of pixels: the square of the scale
+  float scale = m_scale;
+  if(gpuTime > targetFrameTime)
+  {
+    const float fit = m_scale * static_cast<float>(std::sqrt(targetFrameTime / gpuTime));
+    scale           = std::floor(fit / kStep) * kStep;
+  }
+  else
+  {
+    // One step up, when it is expected to fit with a margin
+    const float next     = m_scale + kStep;
+    const float expected = static_cast<float>(gpuTime) * (next / m_scale) * (next / m_scale);
+    if(expected < 0.9F * targetFrameTime)
+      scale = next;
+  }
+  return setScale(std::clamp(scale, std::min(minScale, 1.0F), 1.0F));
+}
+
+float gltfr::DynamicResolution::setScale(float scale)
+{
+  if(scale != m_scale)
+  {
+    m_scale        = scale;
+    m_settleFrames = kSettleFrames;
+    m_ignoreReset  = true;
+  }
+  return m_scale;
+}
+
+void gltfr::DynamicResolution::onUI()
+{
+  if(PE::treeNode("Dynamic Resolution"))
+  {
+    PE::Checkbox("Enable", &enabled, "Lower the resolution while the camera moves or the scene is edited");
+    PE::SliderFloat("Target Frame Time", &targetFrameTime, 4.0F, 100.0F, "%.1f ms", ImGuiSliderFlags_Logarithmic,
+                    "GPU time of the renderer and the tonemapper");
+    PE::SliderFloat("Min Scale", &minScale, kStep, 1.0F, "%.3f", 0, "Lowest fraction of the resolution");
+    PE::Text("Current Scale", std::to_string(static_cast<int>(m_scale * 100.0F + 0.5F)) + " %");
+    PE::treePop();
+  }
+}
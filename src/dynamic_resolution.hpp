@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Dynamic resolution
+
+  While the camera moves or the scene is edited, the internal resolution of
+  the renderers follows the GPU time of their profiler sections, to stay
+  under the target frame time. The cost is taken as proportional to the
+  number of pixels, and the scale moves by steps of kStep, such that the
+  G-Buffers are not re-created every frame. After each change, the timers
+  are given a few frames to measure the new resolution. Once nothing
+  changed for kIdleFrames, the scene is rendered at full resolution.
+
+*/
+
+#include <string>
+#include <vector>
+
+// nvpro-core
+#include "nvh/profiler.hpp"
+
+namespace gltfr {
+
+class DynamicResolution
+{
+public:
+  // After the frame: the render scale of the next frames. 'interacting' when the
+  // accumulation or the scene was reset by this frame.
+  float update(nvh::Profiler& profiler, const std::vector<std::string>& sections, bool interacting);
+
+  void onUI();
+
+  bool  enabled{false};
+  float targetFrameTime{16.0F};  // GPU time in ms, for the sum of the sections
+  float minScale{0.5F};
+
+private:
+  static constexpr float kStep         = 0.125F;
+  static constexpr int   kIdleFrames   = 10;
+  static constexpr int   kSettleFrames = 8;  // Averages of the profiler with the new resolution
+
+  float setScale(float scale);
+
+  float m_scale{1.0F};
+  int   m_idleFrames{0};
+  int   m_settleFrames{0};
+  bool  m_ignoreReset{false};  // The new G-Buffers reset the accumulation
+};
+
+}  // namespace gltfr
@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <cassert>
+
+#include "frame_graph.hpp"
+
+// nvpro-core
+#include "nvvk/error_vk.hpp"
+#include "nvvkhl/application.hpp"
+
+namespace {
+constexpr VkAccessFlags2 kWriteAccess = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+                                        | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
+                                        | VK_ACCESS_2_MEMORY_WRITE_BIT;
+}  // namespace
+
+void gltfr::FrameGraph::init(VkDevice device, uint32_t graphicsFamily, VkQueue computeQueue, uint32_t computeFamily)
+{
+  m_device         = device;
+  m_dutil          = std::make_unique<nvvk::DebugUtil>(device);
+  m_graphicsFamily = graphicsFamily;
+  m_computeFamily  = computeFamily;
+  m_computeQueue   = computeQueue;
+  if(m_computeQueue == VK_NULL_HANDLE)
+    return;
+
+  VkSemaphoreTypeCreateInfo timelineInfo{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO, .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE};
+  const VkSemaphoreCreateInfo semaphoreInfo{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = &timelineInfo};
+  NVVK_CHECK(vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_graphicsTimeline));
+  NVVK_CHECK(vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_computeTimeline));
+
+  for(Slot& slot : m_slots)
+  {
+    const VkCommandPoolCreateInfo poolInfo{.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                                           .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                                           .queueFamilyIndex = m_computeFamily};
+    NVVK_CHECK(vkCreateCommandPool(m_device, &poolInfo, nullptr, &slot.pool));
+    const VkCommandBufferAllocateInfo allocInfo{.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                                                .commandPool        = slot.pool,
+                                                .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                                                .commandBufferCount = 1};
+    NVVK_CHECK(vkAllocateCommandBuffers(m_device, &allocInfo, &slot.cmd));
+  }
+}
+
+void gltfr::FrameGraph::deinit()
+{
+  if(m_device == VK_NULL_HANDLE)
+    return;
+  waitIdle();  // The work of the last frame is never submitted
+  for(Slot& slot : m_slots)
+  {
+    vkDestroyCommandPool(m_device, slot.pool, nullptr);
+    slot = {};
+  }
+  vkDestroySemaphore(m_device, m_graphicsTimeline, nullptr);
+  vkDestroySemaphore(m_device, m_computeTimeline, nullptr);
+  m_graphicsTimeline = VK_NULL_HANDLE;
+  m_computeTimeline  = VK_NULL_HANDLE;
+  m_images.clear();
+  m_dutil.reset();
+  m_device = VK_NULL_HANDLE;
+}
+
+void gltfr::FrameGraph::waitIdle()
+{
+  if(m_lastComputeValue == 0)
+    return;
+  const VkSemaphoreWaitInfo waitInfo{.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+                                     .semaphoreCount = 1,
+                                     .pSemaphores    = &m_computeTimeline,
+                                     .pValues        = &m_lastComputeValue};
+  NVVK_CHECK(vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX));
+}
+
+//--------------------------------------------------------------------------------------------------
+// The images written by the compute queue in the previous frame are given back to the graphics
+// queue: the frame waits for them at kGraphicsWaitStages, or for everything when async compute
+// stops, such that the graphics passes can use them at any stage.
+//
+void gltfr::FrameGraph::beginFrame(VkCommandBuffer cmd, nvvkhl::Application* app)
+{
+  m_frame++;
+  m_graphicsCmd = cmd;
+  m_app         = app;
+  m_computeCmd  = VK_NULL_HANDLE;
+  // The semaphores are given to the submission of the frame, the headless frames are kept simple
+  m_async = m_asyncRequested && m_computeQueue != VK_NULL_HANDLE && app != nullptr && !app->isHeadless();
+
+  const VkPipelineStageFlags2 waitStages = m_async ? kGraphicsWaitStages : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+  if(m_pendingValue != 0)
+  {
+    // The previous frame was submitted by the application
+    submitCompute();
+    if(app != nullptr)
+      app->addWaitSemaphore({.sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+                             .semaphore = m_computeTimeline,
+                             .value     = m_lastComputeValue,
+                             .stageMask = waitStages});
+    else
+      waitIdle();
+  }
+
+  std::vector<VkImageMemoryBarrier2> acquires;
+  for(auto it = m_images.begin(); it != m_images.end();)
+  {
+    ImageState& state = it->second;
+    if(state.computeOwned)
+    {
+      VkImageMemoryBarrier2 acquire = makeBarrier(it->first, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, waitStages,
+                                                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
+      acquire.srcQueueFamilyIndex = m_computeFamily;
+      acquire.dstQueueFamilyIndex = m_graphicsFamily;
+      acquires.push_back(acquire);
+      state.computeOwned = false;
+    }
+    if(state.queue == eAsyncCompute)
+    {
+      // Ordered by the wait of the frame, the next graphics accesses chain on it
+      state = {.queue = eGraphics, .writeStages = waitStages, .visibleStages = waitStages, .lastFrame = state.lastFrame};
+    }
+
+    // The images not used for a while could be destroyed, their handles reused
+    if(state.lastFrame + kSlots + 1 < m_frame)
+      it = m_images.erase(it);
+    else
+      ++it;
+  }
+  cmdBarriers(cmd, acquires);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The dependencies on the previous accesses of the images:
+// - same queue: a barrier when the pass writes, or reads at a stage which does not see the last write
+// - graphics to compute: the semaphores order them, the images change of queue family if needed
+//
+void gltfr::FrameGraph::addPass(const std::string&                          name,
+                                QueueType                                   queue,
+                                const std::vector<ImageUse>&                uses,
+                                const std::function<void(VkCommandBuffer)>& record)
+{
+  assert(m_graphicsCmd != VK_NULL_HANDLE && "Passes are added between beginFrame and endFrame");
+  const QueueType passQueue = (queue == eAsyncCompute && m_async) ? eAsyncCompute : eGraphics;
+  assert((passQueue == eAsyncCompute || m_computeCmd == VK_NULL_HANDLE) && "The graphics passes come before the async ones");
+  const bool transferOwnership = passQueue == eAsyncCompute && m_graphicsFamily != m_computeFamily;
+
+  std::vector<VkImageMemoryBarrier2> releases;
+  std::vector<VkImageMemoryBarrier2> barriers;
+  for(const ImageUse& use : uses)
+  {
+    ImageState& state = m_images.try_emplace(use.image).first->second;
+    state.lastFrame   = m_frame;
+    const bool writes = (use.access & kWriteAccess) != 0;
+
+    if(state.queue != passQueue)
+    {
+      if(transferOwnership)
+      {
+        // Released after the last graphics access, acquired before the pass
+        VkImageMemoryBarrier2 release = makeBarrier(use.image, state.writeStages | state.readStages, state.writeAccess,
+                                                    VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+        release.srcQueueFamilyIndex = m_graphicsFamily;
+        release.dstQueueFamilyIndex = m_computeFamily;
+        releases.push_back(release);
+        VkImageMemoryBarrier2 acquire = makeBarrier(use.image, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, use.stage, use.access);
+        acquire.srcQueueFamilyIndex = m_graphicsFamily;
+        acquire.dstQueueFamilyIndex = m_computeFamily;
+        barriers.push_back(acquire);
+      }
+      // The compute work waits for the whole graphics submission: everything is visible
+      state = {.queue = passQueue, .writeStages = 0, .writeAccess = 0, .visibleStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, .lastFrame = m_frame};
+    }
+    else if(writes || (state.writeAccess != 0 && (use.stage & ~state.visibleStages) != 0))
+    {
+      barriers.push_back(makeBarrier(use.image, state.writeStages | (writes ? state.readStages : 0), state.writeAccess,
+                                     use.stage, use.access));
+    }
+
+    if(writes)
+    {
+      state.writeStages   = use.stage;
+      state.writeAccess   = use.access & kWriteAccess;
+      state.readStages    = 0;
+      state.visibleStages = 0;
+    }
+    else
+    {
+      state.readStages |= use.stage;
+      state.visibleStages |= use.stage;
+    }
+  }
+
+  VkCommandBuffer cmd = m_graphicsCmd;
+  if(passQueue == eAsyncCompute)
+  {
+    cmdBarriers(m_graphicsCmd, releases);
+    cmd = computeCmd();
+  }
+  auto scope = m_dutil->scopeLabel(cmd, name);
+  cmdBarriers(cmd, barriers);
+  record(cmd);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The command buffer of the compute queue, the one of the slot is reset once its last work is done
+//
+VkCommandBuffer gltfr::FrameGraph::computeCmd()
+{
+  if(m_computeCmd != VK_NULL_HANDLE)
+    return m_computeCmd;
+
+  Slot&                     slot = m_slots[m_frame % kSlots];
+  const VkSemaphoreWaitInfo waitInfo{.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+                                     .semaphoreCount = 1,
+                                     .pSemaphores    = &m_computeTimeline,
+                                     .pValues        = &slot.value};
+  NVVK_CHECK(vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX));
+  NVVK_CHECK(vkResetCommandPool(m_device, slot.pool, 0));
+
+  const VkCommandBufferBeginInfo beginInfo{.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                                           .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+  NVVK_CHECK(vkBeginCommandBuffer(slot.cmd, &beginInfo));
+  m_computeCmd = slot.cmd;
+  return m_computeCmd;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The compute work of the frame waits for its graphics submission, which the application does after
+// the UI: signaling the graphics timeline is added to it, and the compute work is submitted by the
+// next beginFrame().
+//
+void gltfr::FrameGraph::endFrame()
+{
+  if(m_computeCmd != VK_NULL_HANDLE)
+  {
+    // Back to the graphics family, acquired by the next beginFrame()
+    std::vector<VkImageMemoryBarrier2> releases;
+    if(m_graphicsFamily != m_computeFamily)
+    {
+      for(auto& [image, state] : m_images)
+      {
+        if(state.queue != eAsyncCompute || state.lastFrame != m_frame)
+          continue;
+        VkImageMemoryBarrier2 release = makeBarrier(image, state.writeStages | state.readStages, state.writeAccess,
+                                                    VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+        release.srcQueueFamilyIndex = m_computeFamily;
+        release.dstQueueFamilyIndex = m_graphicsFamily;
+        releases.push_back(release);
+        state.computeOwned = true;
+      }
+    }
+    cmdBarriers(m_computeCmd, releases);
+    NVVK_CHECK(vkEndCommandBuffer(m_computeCmd));
+
+    m_app->addSignalSemaphore({.sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+                               .semaphore = m_graphicsTimeline,
+                               .value     = m_frame,
+                               .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT});
+    m_pendingValue = m_frame;
+  }
+  m_computeCmd  = VK_NULL_HANDLE;
+  m_graphicsCmd = VK_NULL_HANDLE;
+  m_app         = nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Submitted once the graphics work it waits for is: no wait of the device or of a queue happens
+// before a signal which is not submitted yet
+//
+void gltfr::FrameGraph::submitCompute()
+{
+  Slot&                       slot = m_slots[m_pendingValue % kSlots];
+  const VkSemaphoreSubmitInfo waitGraphics{.sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+                                           .semaphore = m_graphicsTimeline,
+                                           .value     = m_pendingValue,
+                                           .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT};
+  const VkSemaphoreSubmitInfo signalCompute{.sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+                                            .semaphore = m_computeTimeline,
+                                            .value     = m_pendingValue,
+                                            .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT};
+  const VkCommandBufferSubmitInfo cmdInfo{.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO, .commandBuffer = slot.cmd};
+  const VkSubmitInfo2             submit{.sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+                                         .waitSemaphoreInfoCount   = 1,
+                                         .pWaitSemaphoreInfos      = &waitGraphics,
+                                         .commandBufferInfoCount   = 1,
+                                         .pCommandBufferInfos      = &cmdInfo,
+                                         .signalSemaphoreInfoCount = 1,
+                                         .pSignalSemaphoreInfos    = &signalCompute};
+  NVVK_CHECK(vkQueueSubmit2(m_computeQueue, 1, &submit, VK_NULL_HANDLE));
+
+  slot.value         = m_pendingValue;
+  m_lastComputeValue = m_pendingValue;
+  m_pendingValue     = 0;
+}
+
+void gltfr::FrameGraph::cmdBarriers(VkCommandBuffer cmd, const std::vector<VkImageMemoryBarrier2>& barriers)
+{
+  if(barriers.empty())
+    return;
+  const VkDependencyInfo dependencyInfo{.sType                   = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+                                        .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+                                        .pImageMemoryBarriers    = barriers.data()};
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+
+VkImageMemoryBarrier2 gltfr::FrameGraph::makeBarrier(VkImage               image,
+                                                     VkPipelineStageFlags2 srcStage,
+                                                     VkAccessFlags2        srcAccess,
+                                                     VkPipelineStageFlags2 dstStage,
+                                                     VkAccessFlags2        dstAccess)
+{
+  return {.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+          .srcStageMask        = srcStage,
+          .srcAccessMask       = srcAccess,
+          .dstStageMask        = dstStage,
+          .dstAccessMask       = dstAccess,
+          .oldLayout           = VK_IMAGE_LAYOUT_GENERAL,
+          .newLayout           = VK_IMAGE_LAYOUT_GENERAL,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image               = image,
+          .subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS}};
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Frame graph of the passes after the renderers
+
+  Each pass declares the images it reads and writes, with the stage and the
+  access. The graph keeps the last accesses of the images from one pass, and
+  one frame, to the next and records the barriers before each pass: the
+  passes themselves do not synchronize with each other. All images stay in
+  the GENERAL layout.
+
+  The passes of eAsyncCompute run on the second compute queue when async
+  compute is on, while the next frame is traced on the graphics queue:
+
+    graphics  | frame N: trace, snapshot  | frame N+1: trace, snapshot | ...
+    compute   |                           | frame N: denoise, tonemap  | ...
+
+  - The compute work of frame N waits for the graphics submission of frame N
+    (timeline semaphore, signaled by the frame of nvvkhl::Application). It is
+    submitted at the beginning of frame N+1: waiting for the device in between,
+    e.g. in the UI, never waits for a signal which is not submitted.
+  - The graphics submission of frame N+1 waits for the compute work of frame N
+    at kGraphicsWaitStages only: the display, the copies and blits of the end of
+    the frame and the readback of the saved images. The trace does not wait.
+  - When the queues are of different families, the images go to the compute
+    family before their first read there, and all images written on the compute
+    queue come back to the graphics family at the beginning of the next frame.
+
+  The async passes must come after the graphics passes of the frame, and the
+  images they read must not be written by the next frame before
+  kGraphicsWaitStages (copy them to a snapshot first). Without an application
+  frame (batch rendering, temporary command buffers), everything runs on the
+  graphics command buffer.
+
+*/
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// nvpro-core
+#include "nvvk/debug_util_vk.hpp"
+
+namespace nvvkhl {
+class Application;
+}
+
+namespace gltfr {
+
+class FrameGraph
+{
+public:
+  enum QueueType
+  {
+    eGraphics,
+    eAsyncCompute,  // The compute queue with async compute, the graphics queue otherwise
+  };
+
+  struct ImageUse
+  {
+    VkImage               image{VK_NULL_HANDLE};
+    VkPipelineStageFlags2 stage{VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT};
+    VkAccessFlags2        access{VK_ACCESS_2_SHADER_READ_BIT};
+  };
+
+  // Shortcuts for the uses of the passes
+  static ImageUse computeRead(VkImage image) { return {image, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT}; }
+  static ImageUse computeWrite(VkImage image) { return {image, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT}; }
+  static ImageUse computeReadWrite(VkImage image)
+  {
+    return {image, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT};
+  }
+
+  // Stages of the graphics queue which wait for the async compute of the previous frame
+  static constexpr VkPipelineStageFlags2 kGraphicsWaitStages =
+      VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT;
+
+  ~FrameGraph() { deinit(); }
+
+  // 'computeQueue' can be null, then all passes run on the graphics queue
+  void init(VkDevice device, uint32_t graphicsFamily, VkQueue computeQueue, uint32_t computeFamily);
+  void deinit();
+
+  void setAsyncCompute(bool enable) { m_asyncRequested = enable; }
+  // The eAsyncCompute passes of the current frame run on the compute queue
+  bool isAsyncCompute() const { return m_async; }
+
+  // Beginning of the frame, before anything uses the images written by the graph.
+  // 'app' is the application submitting 'cmd' with its frame, null for a temporary command buffer.
+  void beginFrame(VkCommandBuffer cmd, nvvkhl::Application* app);
+  // The barriers for 'uses', then 'record' in the command buffer of the queue of the pass
+  void addPass(const std::string& name, QueueType queue, const std::vector<ImageUse>& uses, const std::function<void(VkCommandBuffer)>& record);
+  // Before the application submits its frame: the async compute work is submitted after it
+  void endFrame();
+
+  // The compute queue is done, e.g. before using the images outside of the frames
+  void waitIdle();
+
+private:
+  static constexpr uint32_t kSlots = 3;  // Compute command buffers in flight, as the frames of the application
+
+  struct ImageState
+  {
+    QueueType             queue{eGraphics};
+    VkPipelineStageFlags2 writeStages{VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT};  // Last write, unknown for a new image
+    VkAccessFlags2        writeAccess{VK_ACCESS_2_MEMORY_WRITE_BIT};
+    VkPipelineStageFlags2 readStages{0};     // Reads since the last write
+    VkPipelineStageFlags2 visibleStages{0};  // Stages which can already read the last write
+    bool                  computeOwned{false};
+    uint64_t              lastFrame{0};
+  };
+
+  struct Slot
+  {
+    VkCommandPool   pool{VK_NULL_HANDLE};
+    VkCommandBuffer cmd{VK_NULL_HANDLE};
+    uint64_t        value{0};  // Compute timeline value of the last submission
+  };
+
+  VkCommandBuffer computeCmd();
+  void            submitCompute();
+  static void     cmdBarriers(VkCommandBuffer cmd, const std::vector<VkImageMemoryBarrier2>& barriers);
+  static VkImageMemoryBarrier2 makeBarrier(VkImage               image,
+                                           VkPipelineStageFlags2 srcStage,
+                                           VkAccessFlags2        srcAccess,
+                                           VkPipelineStageFlags2 dstStage,
+                                           VkAccessFlags2        dstAccess);
+
+  VkDevice                         m_device{VK_NULL_HANDLE};
+  std::unique_ptr<nvvk::DebugUtil> m_dutil;
+  uint32_t                         m_graphicsFamily{~0U};
+  uint32_t                         m_computeFamily{~0U};
+  VkQueue                          m_computeQueue{VK_NULL_HANDLE};
+  VkSemaphore                      m_graphicsTimeline{VK_NULL_HANDLE};  // Signaled by the frames with async compute
+  VkSemaphore                      m_computeTimeline{VK_NULL_HANDLE};
+  Slot                             m_slots[kSlots];
+
+  nvvkhl::Application* m_app{nullptr};
+  VkCommandBuffer      m_graphicsCmd{VK_NULL_HANDLE};
+  VkCommandBuffer      m_computeCmd{VK_NULL_HANDLE};  // Of the current frame, once a pass was recorded
+  uint64_t             m_frame{0};
+  uint64_t             m_pendingValue{0};      // Compute work recorded by the previous frame, not submitted yet
+  uint64_t             m_lastComputeValue{0};  // Last submitted compute work
+  bool                 m_asyncRequested{true};
+  bool                 m_async{false};
+
+  std::unordered_map<VkImage, ImageState> m_images;
+};
+
+}  // namespace gltfr
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "geometry_dedup.hpp"
+#include "cache_utils.hpp"
+
+// nvpro-core
+#include "nvh/nvprint.hpp"
+#include "nvh/parallel_work.hpp"
+#include "nvh/timesampler.hpp"
+
+namespace {
+
+// The elements of an accessor in its buffer
+struct AccessorData
+{
+  const uint8_t* data{nullptr};
+  size_t         elementSize{0};
+  size_t         stride{0};
+  size_t         count{0};
+  uint64_t       hash{0};
+  bool           valid{false};
+
+  bool   tight() const { return stride == elementSize; }
+  size_t size() const { return count * elementSize; }
+};
+
+AccessorData getAccessorData(const tinygltf::Model& model, const tinygltf::Accessor& accessor)
+{
+  AccessorData result;
+  if(accessor.sparse.isSparse || accessor.count == 0 || accessor.bufferView < 0
+     || accessor.bufferView >= static_cast<int>(model.bufferViews.size()))
+    return result;
+
+  const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+  if(view.buffer < 0 || view.buffer >= static_cast<int>(model.buffers.size()))
+    return result;
+
+  const int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+  const int numComponents = tinygltf::GetNumComponentsInType(accessor.type);
+  const int stride        = accessor.ByteStride(view);
+  if(componentSize <= 0 || numComponents <= 0 || stride <= 0)
+    return result;
+
+  const std::vector<unsigned char>& buffer = model.buffers[view.buffer].data;
+  result.elementSize                       = size_t(componentSize) * size_t(numComponents);
+  result.stride                            = size_t(stride);
+  result.count                             = accessor.count;
+
+  const size_t offset = view.byteOffset + accessor.byteOffset;
+  if(offset + result.stride * (result.count - 1) + result.elementSize > buffer.size())
+    return result;
+
+  result.data  = buffer.data() + offset;
+  result.valid = true;
+  return result;
+}
+
+uint64_t hashAccessor(const tinygltf::Accessor& accessor, const AccessorData& data)
+{
+  gltfr::Hasher hasher;
+  hasher.add(accessor.componentType).add(accessor.type).add(accessor.normalized).add(data.count);
+  if(data.tight())
+    return hasher.addWords(data.data, data.size()).value;
+
+  for(size_t i = 0; i < data.count; i++)
+    hasher.addWords(data.data + i * data.stride, data.elementSize);
+  return hasher.value;
+}
+
+bool sameElements(const AccessorData& a, const AccessorData& b)
+{
+  if(a.count != b.count || a.elementSize != b.elementSize)
+    return false;
+  if(a.tight() && b.tight())
+    return std::memcmp(a.data, b.data, a.size()) == 0;
+  for(size_t i = 0; i < a.count; i++)
+  {
+    if(std::memcmp(a.data + i * a.stride, b.data + i * b.stride, a.elementSize) != 0)
+      return false;
+  }
+  return true;
+}
+
+bool sameAccessor(const tinygltf::Accessor& a, const tinygltf::Accessor& b)
+{
+  return a.componentType == b.componentType && a.type == b.type && a.normalized == b.normalized;
+}
+
+// The accessors of a primitive, as nvh::gltf::Scene distinguishes its render primitives
+std::string primitiveKey(const tinygltf::Primitive& primitive)
+{
+  std::string key = std::to_string(primitive.indices);
+  for(const auto& [name, accessor] : primitive.attributes)
+    key += ";" + name + ":" + std::to_string(accessor);
+  return key;
+}
+
+size_t countUniquePrimitives(const tinygltf::Model& model)
+{
+  std::unordered_set<std::string> keys;
+  for(const tinygltf::Mesh& mesh : model.meshes)
+  {
+    for(const tinygltf::Primitive& primitive : mesh.primitives)
+      keys.insert(primitiveKey(primitive));
+  }
+  return keys.size();
+}
+
+}  // namespace
+
+gltfr::DedupStats gltfr::dedupGeometry(tinygltf::Model& model)
+{
+  nvh::ScopedTimer st(__FUNCTION__);
+
+  DedupStats stats;
+  for(const tinygltf::Mesh& mesh : model.meshes)
+    stats.primitives += static_cast<uint32_t>(mesh.primitives.size());
+  if(stats.primitives < 2)
+    return stats;
+
+  // The meshes of the skinned nodes are deformed per render primitive, they keep their accessors
+  std::vector<bool> skinnedMesh(model.meshes.size(), false);
+  for(const tinygltf::Node& node : model.nodes)
+  {
+    if(node.skin >= 0 && node.mesh >= 0 && node.mesh < static_cast<int>(model.meshes.size()))
+      skinnedMesh[node.mesh] = true;
+  }
+  auto isMergeable = [&](size_t meshID, const tinygltf::Primitive& primitive) {
+    return !skinnedMesh[meshID] && primitive.targets.empty();
+  };
+  auto validAccessor = [&](int accessor) { return accessor >= 0 && accessor < static_cast<int>(model.accessors.size()); };
+
+  // Accessors of the primitives that can be merged
+  std::vector<bool> used(model.accessors.size(), false);
+  for(size_t meshID = 0; meshID < model.meshes.size(); meshID++)
+  {
+    for(const tinygltf::Primitive& primitive : model.meshes[meshID].primitives)
+    {
+      if(!isMergeable(meshID, primitive))
+        continue;
+      if(validAccessor(primitive.indices))
+        used[primitive.indices] = true;
+      for(const auto& [name, accessor] : primitive.attributes)
+      {
+        if(validAccessor(accessor))
+          used[accessor] = true;
+      }
+    }
+  }
+  std::vector<int> accessors;
+  for(size_t i = 0; i < used.size(); i++)
+  {
+    if(used[i])
+      accessors.push_back(static_cast<int>(i));
+  }
+  if(accessors.empty())
+    return stats;
+
+  const size_t before = countUniquePrimitives(model);
+
+  // Hashing the contents, the largest part of the work
+  std::vector<AccessorData> data(accessors.size());
+  const uint32_t            numThreads = std::max(1U, std::thread::hardware_concurrency());
+  nvh::parallel_batches<1>(
+      accessors.size(),
+      [&](uint64_t i) {
+        const tinygltf::Accessor& accessor = model.accessors[accessors[i]];
+        data[i]                            = getAccessorData(model, accessor);
+        if(data[i].valid)
+          data[i].hash = hashAccessor(accessor, data[i]);
+      },
+      std::min(static_cast<uint32_t>(accessors.size()), numThreads));
+
+  // The first accessor with the same contents replaces the others
+  std::vector<int>                                   canonical(model.accessors.size());
+  std::unordered_map<uint64_t, std::vector<size_t>> buckets;
+  for(size_t i = 0; i < canonical.size(); i++)
+    canonical[i] = static_cast<int>(i);
+  for(size_t i = 0; i < accessors.size(); i++)
+  {
+    if(!data[i].valid)
+      continue;
+    std::vector<size_t>& bucket = buckets[data[i].hash];
+    const auto           match  = std::find_if(bucket.begin(), bucket.end(), [&](size_t j) {
+      return sameAccessor(model.accessors[accessors[i]], model.accessors[accessors[j]]) && sameElements(data[i], data[j]);
+    });
+    if(match != bucket.end())
+      canonical[accessors[i]] = accessors[*match];
+    else
+      bucket.push_back(i);
+  }
+
+  for(size_t meshID = 0; meshID < model.meshes.size(); meshID++)
+  {
+    for(tinygltf::Primitive& primitive : model.meshes[meshID].primitives)
+    {
+      if(!isMergeable(meshID, primitive))
+        continue;
+      if(validAccessor(primitive.indices))
+        primitive.indices = canonical[primitive.indices];
+      for(auto& [name, accessor] : primitive.attributes)
+      {
+        if(validAccessor(accessor))
+          accessor = canonical[accessor];
+      }
+    }
+  }
+
+  stats.merged = static_cast<uint32_t>(before - countUniquePrimitives(model));
+  if(stats.merged > 0)
+    LOGI("Geometry: %u of %u primitives are instances of another one\n", stats.merged, stats.primitives);
+  return stats;
+}
+
+uint32_t gltfr::splitDeformedInstances(tinygltf::Model& model)
+{
+  auto validMesh     = [&](int mesh) { return mesh >= 0 && mesh < static_cast<int>(model.meshes.size()); };
+  auto validAccessor = [&](int accessor) { return accessor >= 0 && accessor < static_cast<int>(model.accessors.size()); };
+
+  // Render primitives deformed by at least one of their nodes, and used by several nodes
+  std::unordered_map<std::string, uint32_t> users;
+  std::unordered_set<std::string>           deformed;
+  for(const tinygltf::Node& node : model.nodes)
+  {
+    if(!validMesh(node.mesh))
+      continue;
+    for(const tinygltf::Primitive& primitive : model.meshes[node.mesh].primitives)
+    {
+      const std::string key = primitiveKey(primitive);
+      users[key]++;
+      if(node.skin >= 0 || !primitive.targets.empty())
+        deformed.insert(key);
+    }
+  }
+  auto isShared = [&](const std::string& key) { return deformed.count(key) && users[key] > 1; };
+
+  // The first node keeps the render primitive, the next ones get a copy
+  std::unordered_set<std::string> kept;
+  uint32_t                        added = 0;
+  for(tinygltf::Node& node : model.nodes)
+  {
+    if(!validMesh(node.mesh))
+      continue;
+    bool copy = false;
+    for(const tinygltf::Primitive& primitive : model.meshes[node.mesh].primitives)
+    {
+      const std::string key = primitiveKey(primitive);
+      if(isShared(key) && !kept.insert(key).second)
+        copy = true;
+    }
+    if(!copy)
+      continue;
+
+    tinygltf::Mesh mesh = model.meshes[node.mesh];
+    for(tinygltf::Primitive& primitive : mesh.primitives)
+    {
+      if(!isShared(primitiveKey(primitive)))
+        continue;
+      for(const char* name : {"POSITION", "NORMAL"})
+      {
+        auto it = primitive.attributes.find(name);
+        if(it == primitive.attributes.end() || !validAccessor(it->second))
+          continue;
+        model.accessors.push_back(model.accessors[it->second]);
+        it->second = static_cast<int>(model.accessors.size() - 1);
+      }
+    }
+    model.meshes.push_back(std::move(mesh));
+    node.mesh = static_cast<int>(model.meshes.size() - 1);
+    added++;
+  }
+
+  if(added > 0)
+    LOGI("Geometry: %u meshes copied for the nodes sharing a deformed mesh\n", added);
+  return added;
+}
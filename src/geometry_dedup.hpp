@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Deduplication of the geometry of a glTF model, before it is given to nvh::gltf::Scene
+
+  Exporters often write the same mesh several times, under different mesh indices, and
+  TinyConverter creates one mesh per OBJ shape. The render primitives of the scene are keyed
+  by their accessors, so each copy would get its own vertex buffers and BLAS.
+
+  - The contents of the accessors of the primitives are hashed in parallel: the component
+    type, the type, the count, and the elements read through the buffer view stride.
+  - Accessors with the same hash and the same elements are replaced by the first of them.
+  - The primitives then have identical accessors, nvh::gltf::Scene creates a single render
+    primitive for them, and their render nodes become instances of the same BLAS in the TLAS.
+
+  The primitives with morph targets, and the meshes of the skinned nodes, are left as they are:
+  GpuAnimation deforms each render primitive once. Sparse accessors are not merged.
+  The duplicated bytes stay in the buffers of the model, only the GPU copies are shared.
+
+  The opposite is done for the deformed primitives used by several nodes: each node after the
+  first gets a copy of the mesh, with copies of the POSITION and NORMAL accessors (the same buffer
+  views), so it has its own render primitive and vertex buffers, deformed by its skin and weights.
+
+*/
+
+#include <cstdint>
+
+#include <tiny_gltf.h>
+
+namespace gltfr {
+
+struct DedupStats
+{
+  uint32_t primitives{0};  // Primitives of the model
+  uint32_t merged{0};      // Primitives that now share the geometry of another one
+};
+
+DedupStats dedupGeometry(tinygltf::Model& model);
+
+// Returns the number of meshes added for the nodes sharing a deformed mesh
+uint32_t splitDeformedInstances(tinygltf::Model& model);
+
+}  // namespace gltfr
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "gltf_accessor.hpp"
+
+namespace {
+float readComponent(const uint8_t* data, int componentType, bool normalized)
+{
+  switch(componentType)
+  {
+    case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+      float value;
+      std::memcpy(&value, data, sizeof(float));
+      return value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      return normalized ? *data / 255.0F : float(*data);
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+      uint16_t value;
+      std::memcpy(&value, data, sizeof(uint16_t));
+      return normalized ? value / 65535.0F : float(value);
+    }
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+      return normalized ? std::max(int8_t(*data) / 127.0F, -1.0F) : float(int8_t(*data));
+    case TINYGLTF_COMPONENT_TYPE_SHORT: {
+      int16_t value;
+      std::memcpy(&value, data, sizeof(int16_t));
+      return normalized ? std::max(value / 32767.0F, -1.0F) : float(value);
+    }
+    default:
+      return 0.0F;
+  }
+}
+
+uint32_t readIndex(const uint8_t* data, int componentType)
+{
+  if(componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
+    return *data;
+  if(componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
+  {
+    uint16_t value;
+    std::memcpy(&value, data, sizeof(uint16_t));
+    return value;
+  }
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(uint32_t));
+  return value;
+}
+}  // namespace
+
+//--------------------------------------------------------------------------------------------------
+// The first 'numComponents' components of each element of the accessor, as floats.
+// Integer types are normalized when the accessor says so. Sparse values are applied on top.
+//
+std::vector<float> gltfr::readAccessor(const tinygltf::Model& model, int accessorID, int numComponents)
+{
+  if(accessorID < 0 || accessorID >= static_cast<int>(model.accessors.size()))
+    return {};
+
+  const tinygltf::Accessor& accessor = model.accessors[accessorID];
+  const int                 compSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+  const int                 numComp  = std::min(tinygltf::GetNumComponentsInType(accessor.type), numComponents);
+  std::vector<float>        result(accessor.count * numComponents, 0.0F);
+
+  if(accessor.bufferView >= 0)
+  {
+    const tinygltf::BufferView& view   = model.bufferViews[accessor.bufferView];
+    const int                   stride = accessor.ByteStride(view);
+    const uint8_t* data = model.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset;
+    for(size_t i = 0; i < accessor.count; i++)
+    {
+      for(int c = 0; c < numComp; c++)
+        result[i * numComponents + c] = readComponent(data + i * stride + c * compSize, accessor.componentType, accessor.normalized);
+    }
+  }
+
+  if(accessor.sparse.isSparse)
+  {
+    const auto&                 sparse      = accessor.sparse;
+    const tinygltf::BufferView& indexView   = model.bufferViews[sparse.indices.bufferView];
+    const tinygltf::BufferView& valueView   = model.bufferViews[sparse.values.bufferView];
+    const uint8_t*              indices     = model.buffers[indexView.buffer].data.data() + indexView.byteOffset + sparse.indices.byteOffset;
+    const uint8_t*              values      = model.buffers[valueView.buffer].data.data() + valueView.byteOffset + sparse.values.byteOffset;
+    const int                   indexSize   = tinygltf::GetComponentSizeInBytes(sparse.indices.componentType);
+    const int                   elementSize = compSize * tinygltf::GetNumComponentsInType(accessor.type);
+    for(int i = 0; i < sparse.count; i++)
+    {
+      const uint32_t index = readIndex(indices + i * indexSize, sparse.indices.componentType);
+      if(index >= accessor.count)
+        continue;
+      for(int c = 0; c < numComp; c++)
+        result[index * numComponents + c] = readComponent(values + i * elementSize + c * compSize, accessor.componentType, accessor.normalized);
+    }
+  }
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Indices of the primitive, generated for the non-indexed ones
+//
+std::vector<uint32_t> gltfr::readIndices(const tinygltf::Model& model, int accessorID, size_t numVertices)
+{
+  std::vector<uint32_t> result;
+  if(accessorID < 0 || accessorID >= static_cast<int>(model.accessors.size()))
+  {
+    result.resize(numVertices);
+    for(size_t i = 0; i < numVertices; i++)
+      result[i] = static_cast<uint32_t>(i);
+    return result;
+  }
+
+  const tinygltf::Accessor& accessor = model.accessors[accessorID];
+  if(accessor.bufferView < 0)
+    return result;
+  const tinygltf::BufferView& view   = model.bufferViews[accessor.bufferView];
+  const int                   stride = accessor.ByteStride(view);
+  const uint8_t* data = model.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset;
+  result.resize(accessor.count);
+  for(size_t i = 0; i < accessor.count; i++)
+    result[i] = readIndex(data + i * stride, accessor.componentType);
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Matrix of the node, from its matrix or its translation, rotation and scale
+//
+glm::mat4 gltfr::localMatrix(const tinygltf::Node& node)
+{
+  if(node.matrix.size() == 16)
+    return glm::mat4(glm::make_mat4(node.matrix.data()));
+
+  glm::mat4 matrix(1.0F);
+  if(node.translation.size() == 3)
+    matrix = glm::translate(matrix, glm::vec3(glm::make_vec3(node.translation.data())));
+  if(node.rotation.size() == 4)
+    matrix *= glm::mat4_cast(glm::quat(float(node.rotation[3]), float(node.rotation[0]), float(node.rotation[1]),
+                                       float(node.rotation[2])));
+  if(node.scale.size() == 3)
+    matrix = glm::scale(matrix, glm::vec3(glm::make_vec3(node.scale.data())));
+  return matrix;
+}
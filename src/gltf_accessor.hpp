@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "tiny_gltf.h"
+
+namespace gltfr {
+
+// The first 'numComponents' components of each element of the accessor, as floats.
+// Integer types are normalized when the accessor says so, sparse values are applied.
+std::vector<float> readAccessor(const tinygltf::Model& model, int accessorID, int numComponents);
+
+// Indices of the accessor as 32-bit integers, 0..numVertices-1 without accessor
+std::vector<uint32_t> readIndices(const tinygltf::Model& model, int accessorID, size_t numVertices);
+
+// Local transformation of the node
+glm::mat4 localMatrix(const tinygltf::Node& node);
+
+}  // namespace gltfr
@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "gltf_accessor.hpp"
+#include "gpu_animation.hpp"
+
+// nvpro-core
+#include "nvh/nvprint.hpp"
+#include "nvh/timesampler.hpp"
+#include "nvvk/buffers_vk.hpp"
+#include "nvvk/debug_util_vk.hpp"
+#include "nvvk/error_vk.hpp"
+
+#include "_autogen/animation.comp.glsl.h"
+
+namespace gltfr {
+extern bool g_forceExternalShaders;
+}
+
+namespace {
+constexpr VkDeviceSize kUpdateBufferMaxSize = 65536;  // Limit of vkCmdUpdateBuffer
+}  // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Compute pipeline, only using push constants and buffer addresses
+//
+bool gltfr::GpuAnimation::createPipeline(Resources& res)
+{
+  VkShaderModuleCreateInfo shaderModuleCreateInfo{.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+  std::vector<uint32_t>    spirvCode;
+  if(res.hasGlslCompiler() && g_forceExternalShaders)
+  {
+    if(!res.compileGlslShader("animation.comp.glsl", shaderc_shader_kind::shaderc_compute_shader, spirvCode)
+       || !res.createShaderModuleCreateInfo(spirvCode, shaderModuleCreateInfo))
+      return false;
+  }
+  else
+  {
+    // Pre-compiled version
+    shaderModuleCreateInfo = {.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                              .codeSize = sizeof(animation_comp_glsl),
+                              .pCode    = &animation_comp_glsl[0]};
+  }
+
+  const VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DH::PushConstantAnimation)};
+  const VkPipelineLayoutCreateInfo layoutInfo{.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                                              .pushConstantRangeCount = 1,
+                                              .pPushConstantRanges    = &pushConstantRange};
+  NVVK_CHECK(vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_pipelineLayout));
+
+  VkShaderModule shaderModule{};
+  NVVK_CHECK(vkCreateShaderModule(m_device, &shaderModuleCreateInfo, nullptr, &shaderModule));
+  const VkComputePipelineCreateInfo pipelineInfo{
+      .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .stage  = {.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                 .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                 .module = shaderModule,
+                 .pName  = "main"},
+      .layout = m_pipelineLayout,
+  };
+  NVVK_CHECK(vkCreateComputePipelines(m_device, res.m_pipelineCache, 1, &pipelineInfo, nullptr, &m_pipeline));
+  vkDestroyShaderModule(m_device, shaderModule, nullptr);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_pipeline);
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// One job per deformed render primitive. The nodes sharing a deformed mesh got their own render
+// primitives at parse (splitDeformedInstances), each primitive is deformed by its only node.
+//
+void gltfr::GpuAnimation::init(Resources& res, const nvh::gltf::Scene& scene, const nvvkhl::SceneVk& sceneVk)
+{
+  nvh::ScopedTimer st(__FUNCTION__);
+
+  deinit();
+  m_alloc  = res.m_allocator.get();
+  m_device = res.ctx.device;
+  if(m_pipeline == VK_NULL_HANDLE && !createPipeline(res))
+  {
+    LOGW("GPU animation: the compute shader could not be created, the CPU is used\n");
+    return;
+  }
+
+  const tinygltf::Model&                         model      = scene.getModel();
+  const std::vector<nvh::gltf::RenderPrimitive>& primitives = scene.getRenderPrimitives();
+
+  m_inverseBindMatrices.resize(model.skins.size());
+  for(size_t s = 0; s < model.skins.size(); s++)
+  {
+    const tinygltf::Skin& skin = model.skins[s];
+    m_inverseBindMatrices[s].assign(skin.joints.size(), glm::mat4(1.0F));
+    const std::vector<float> data = readAccessor(model, skin.inverseBindMatrices, 16);
+    for(size_t j = 0; j < skin.joints.size() && (j + 1) * 16 <= data.size(); j++)
+      m_inverseBindMatrices[s][j] = glm::make_mat4(&data[j * 16]);
+  }
+
+  VkCommandBuffer cmd    = res.createTempCmdBuffer();
+  auto            upload = [&](const std::vector<float>& data) -> VkDeviceAddress {
+    if(data.empty())
+      return 0;
+    m_buffers.push_back(m_alloc->createBuffer(cmd, data.size() * sizeof(float), data.data(),
+                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT));
+    return nvvk::getBufferDeviceAddress(m_device, m_buffers.back().buffer);
+  };
+
+  std::vector<bool> done(primitives.size(), false);
+  uint32_t          numJoints  = 0;
+  uint32_t          numWeights = 0;
+  for(const nvh::gltf::RenderNode& renderNode : scene.getRenderNodes())
+  {
+    if(renderNode.refNodeID < 0 || done[renderNode.renderPrimID])
+      continue;
+    const tinygltf::Node&      node      = model.nodes[renderNode.refNodeID];
+    const tinygltf::Primitive& primitive = *primitives[renderNode.renderPrimID].pPrimitive;
+    const bool                 skinned   = node.skin >= 0 && !model.skins[node.skin].joints.empty()
+                                           && primitive.attributes.count("JOINTS_0") && primitive.attributes.count("WEIGHTS_0");
+    if((!skinned && primitive.targets.empty()) || !primitive.attributes.count("POSITION"))
+      continue;
+    done[renderNode.renderPrimID] = true;
+
+    const auto&                           vertexBuffers = sceneVk.vertexBuffers()[renderNode.renderPrimID];
+    const auto                            attribute     = [&](const std::map<std::string, int>& attributes, const char* name) {
+      auto it = attributes.find(name);
+      return it == attributes.end() ? -1 : it->second;
+    };
+
+    Job                        job;
+    DH::PushConstantAnimation& pc = job.pushConstant;
+    job.node                      = renderNode.refNodeID;
+    pc.vertexCount                = static_cast<uint32_t>(model.accessors[attribute(primitive.attributes, "POSITION")].count);
+    pc.restPositions              = upload(readAccessor(model, attribute(primitive.attributes, "POSITION"), 3));
+    pc.outPositions               = nvvk::getBufferDeviceAddress(m_device, vertexBuffers.position.buffer);
+    if(vertexBuffers.normal.buffer != VK_NULL_HANDLE && attribute(primitive.attributes, "NORMAL") >= 0)
+    {
+      pc.restNormals = upload(readAccessor(model, attribute(primitive.attributes, "NORMAL"), 3));
+      pc.outNormals  = nvvk::getBufferDeviceAddress(m_device, vertexBuffers.normal.buffer);
+    }
+
+    if(skinned)
+    {
+      job.skin        = node.skin;
+      job.jointOffset = numJoints;
+      numJoints += static_cast<uint32_t>(model.skins[node.skin].joints.size());
+
+      std::vector<float> joints = readAccessor(model, attribute(primitive.attributes, "JOINTS_0"), 4);
+      std::vector<uint32_t> jointIndices(joints.size());
+      for(size_t i = 0; i < joints.size(); i++)  // Out of range joints are not weighted by valid models
+        jointIndices[i] = std::min(static_cast<uint32_t>(joints[i]), static_cast<uint32_t>(model.skins[node.skin].joints.size() - 1));
+      m_buffers.push_back(m_alloc->createBuffer(cmd, jointIndices.size() * sizeof(uint32_t), jointIndices.data(),
+                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT));
+      pc.joints  = nvvk::getBufferDeviceAddress(m_device, m_buffers.back().buffer);
+      pc.weights = upload(readAccessor(model, attribute(primitive.attributes, "WEIGHTS_0"), 4));
+    }
+
+    if(!primitive.targets.empty())
+    {
+      job.weightOffset = numWeights;
+      pc.numTargets    = static_cast<uint32_t>(primitive.targets.size());
+      numWeights += pc.numTargets;
+
+      std::vector<float> positions, normals;
+      for(const std::map<std::string, int>& target : primitive.targets)
+      {
+        std::vector<float> deltas = readAccessor(model, attribute(target, "POSITION"), 3);
+        deltas.resize(size_t(pc.vertexCount) * 3, 0.0F);
+        positions.insert(positions.end(), deltas.begin(), deltas.end());
+        if(pc.outNormals != 0)
+        {
+          deltas = readAccessor(model, attribute(target, "NORMAL"), 3);
+          deltas.resize(size_t(pc.vertexCount) * 3, 0.0F);
+          normals.insert(normals.end(), deltas.begin(), deltas.end());
+        }
+      }
+      pc.morphPositions = upload(positions);
+      pc.morphNormals   = upload(normals);
+    }
+    m_jobs.push_back(job);
+  }
+  res.submitAndWaitTempCmdBuffer(cmd);
+  m_alloc->finalizeAndReleaseStaging();
+
+  if(m_jobs.empty())
+    return;
+
+  m_jointMatrices.assign(numJoints, glm::mat4(1.0F));
+  m_morphWeights.assign(numWeights, 0.0F);
+  m_weightsByteOffset = (numJoints * sizeof(glm::mat4) + 15) & ~VkDeviceSize(15);
+  m_frameData         = m_alloc->createBuffer(m_weightsByteOffset + std::max<VkDeviceSize>(numWeights * sizeof(float), 16),
+                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+                                                  | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_frameData.buffer);
+  const VkDeviceAddress frameAddress = nvvk::getBufferDeviceAddress(m_device, m_frameData.buffer);
+  for(Job& job : m_jobs)
+  {
+    if(job.skin >= 0)
+      job.pushConstant.jointMatrices = frameAddress + job.jointOffset * sizeof(glm::mat4);
+    if(job.pushConstant.numTargets > 0)
+      job.pushConstant.morphWeights = frameAddress + m_weightsByteOffset + job.weightOffset * sizeof(float);
+  }
+  LOGI("GPU animation: %zu primitives, %u joints, %u morph weights\n", m_jobs.size(), numJoints, numWeights);
+}
+
+void gltfr::GpuAnimation::deinit()
+{
+  if(m_alloc == nullptr)
+    return;
+  for(nvvk::Buffer& buffer : m_buffers)
+    m_alloc->destroy(buffer);
+  m_alloc->destroy(m_frameData);
+  m_buffers.clear();
+  m_jobs.clear();
+  m_inverseBindMatrices.clear();
+  m_jointMatrices.clear();
+  m_morphWeights.clear();
+}
+
+void gltfr::GpuAnimation::retire(Resources& res)
+{
+  for(nvvk::Buffer& buffer : m_buffers)
+    res.retire(buffer);
+  res.retire(m_frameData);
+  deinit();
+}
+
+void gltfr::GpuAnimation::destroy()
+{
+  deinit();
+  if(m_device == VK_NULL_HANDLE)
+    return;
+  vkDestroyPipeline(m_device, m_pipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+  m_pipeline       = VK_NULL_HANDLE;
+  m_pipelineLayout = VK_NULL_HANDLE;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The joint matrices are relative to the skinned node, its world matrix is applied by the renderers
+//
+void gltfr::GpuAnimation::cmdAnimate(VkCommandBuffer                cmd,
+                                     const nvh::gltf::Scene&        scene,
+                                     const std::vector<glm::mat4>& worldMatrices,
+                                     UploadRing&                    ring)
+{
+  if(m_jobs.empty())
+    return;
+
+  const tinygltf::Model& model = scene.getModel();
+  for(const Job& job : m_jobs)
+  {
+    const tinygltf::Node& node = model.nodes[job.node];
+    if(job.skin >= 0)
+    {
+      const glm::mat4             inverseNode = glm::inverse(worldMatrices[job.node]);
+      const std::vector<int>&     joints      = model.skins[job.skin].joints;
+      const std::vector<glm::mat4>& bind      = m_inverseBindMatrices[job.skin];
+      for(size_t j = 0; j < joints.size(); j++)
+        m_jointMatrices[job.jointOffset + j] = inverseNode * worldMatrices[joints[j]] * bind[j];
+    }
+    if(job.pushConstant.numTargets > 0)
+    {
+      const std::vector<double>& weights = node.weights.empty() ? model.meshes[node.mesh].weights : node.weights;
+      for(uint32_t t = 0; t < job.pushConstant.numTargets; t++)
+        m_morphWeights[job.weightOffset + t] = t < weights.size() ? float(weights[t]) : 0.0F;
+    }
+  }
+
+  // The previous frame may still read the frame data and the vertices
+  VkMemoryBarrier2 barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                           .srcStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                           .dstStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                           .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_WRITE_BIT};
+  VkDependencyInfo dependencyInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &barrier};
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+  auto uploadFrameData = [&](VkDeviceSize offset, const void* data, VkDeviceSize size) {
+    if(size == 0 || ring.copy(m_frameData.buffer, offset, data, size))
+      return;
+    for(VkDeviceSize done = 0; done < size; done += kUpdateBufferMaxSize)  // Too large for the ring
+      vkCmdUpdateBuffer(cmd, m_frameData.buffer, offset + done, std::min(kUpdateBufferMaxSize, size - done),
+                        static_cast<const uint8_t*>(data) + done);
+  };
+  uploadFrameData(0, m_jointMatrices.data(), m_jointMatrices.size() * sizeof(glm::mat4));
+  uploadFrameData(m_weightsByteOffset, m_morphWeights.data(), m_morphWeights.size() * sizeof(float));
+  ring.flush(cmd);
+
+  barrier = {.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+             .srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+             .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+             .dstStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+             .dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT};
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+  for(const Job& job : m_jobs)
+  {
+    vkCmdPushConstants(cmd, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DH::PushConstantAnimation), &job.pushConstant);
+    vkCmdDispatch(cmd, (job.pushConstant.vertexCount + ANIMATION_WORKGROUP_SIZE - 1) / ANIMATION_WORKGROUP_SIZE, 1, 1);
+  }
+
+  // The vertices are read by the raster, the path tracer and the BLAS refit
+  barrier = {.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+             .srcStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+             .srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+             .dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+             .dstAccessMask = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT};
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
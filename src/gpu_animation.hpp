@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Skinning and morph targets evaluated by a compute shader
+
+  - At load, the rest positions and normals, the joints and weights, and the morph
+    target deltas of the deformed primitives are uploaded once.
+  - Each frame, only the joint matrices and the morph weights are uploaded, through
+    the upload ring. One dispatch per deformed primitive writes the positions and
+    normals in the vertex buffers of the scene, read by the raster, the path tracer
+    and the BLAS refit.
+
+  The animation of the nodes is evaluated on the CPU, by AnimationEvaluator.
+
+*/
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// nvpro-core
+#include "nvh/gltfscene.hpp"
+#include "nvvkhl/gltf_scene_vk.hpp"
+
+#include "resources.hpp"
+#include "upload_ring.hpp"
+
+namespace DH {
+#include "shaders/animation.h"
+}
+
+namespace gltfr {
+
+class GpuAnimation
+{
+public:
+  // Upload the static data of the deformed primitives of the scene
+  void init(Resources& res, const nvh::gltf::Scene& scene, const nvvkhl::SceneVk& sceneVk);
+  // Release the data of the scene
+  void deinit();
+  // Same, once the frames in flight are done with it
+  void retire(Resources& res);
+  // Release everything, including the pipeline
+  void destroy();
+
+  // True when the scene has deformed primitives
+  bool isActive() const { return !m_jobs.empty(); }
+
+  // Upload the joint matrices and morph weights, and deform the vertices
+  // 'worldMatrices' are the world matrices of all nodes (AnimationEvaluator)
+  void cmdAnimate(VkCommandBuffer cmd, const nvh::gltf::Scene& scene, const std::vector<glm::mat4>& worldMatrices, UploadRing& ring);
+
+private:
+  struct Job
+  {
+    DH::PushConstantAnimation pushConstant{};
+    int                       node{-1};  // Skinned node, or node with the morph weights
+    int                       skin{-1};
+    uint32_t                  jointOffset{0};   // In m_jointMatrices
+    uint32_t                  weightOffset{0};  // In m_morphWeights
+  };
+
+  bool createPipeline(Resources& res);
+
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  VkDevice                 m_device{VK_NULL_HANDLE};
+  VkPipelineLayout         m_pipelineLayout{VK_NULL_HANDLE};
+  VkPipeline               m_pipeline{VK_NULL_HANDLE};
+
+  std::vector<Job>          m_jobs;
+  std::vector<nvvk::Buffer> m_buffers;    // Static data of the jobs
+  nvvk::Buffer              m_frameData;  // Joint matrices, then morph weights
+  VkDeviceSize              m_weightsByteOffset{0};
+
+  std::vector<std::vector<glm::mat4>> m_inverseBindMatrices;  // Per skin
+  std::vector<glm::mat4>              m_jointMatrices;
+  std::vector<float>                  m_morphWeights;
+};
+
+}  // namespace gltfr
@@ -0,0 +1,462 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+
+#include "gpu_driven_raster.hpp"
+
+// nvpro-core
+#include "nvh/nvprint.hpp"
+#include "nvh/timesampler.hpp"
+#include "nvvk/buffers_vk.hpp"
+#include "nvvk/debug_util_vk.hpp"
+#include "nvvk/error_vk.hpp"
+
+#include "_autogen/cull.comp.glsl.h"
+#include "_autogen/hiz.comp.glsl.h"
+#include "_autogen/index_pool.comp.glsl.h"
+
+namespace gltfr {
+extern bool g_forceExternalShaders;
+}
+
+namespace {
+constexpr VkBufferUsageFlags kStorageUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+void memoryBarrier(VkCommandBuffer cmd, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+  const VkMemoryBarrier2 barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                 .srcStageMask  = srcStage,
+                                 .srcAccessMask = srcAccess,
+                                 .dstStageMask  = dstStage,
+                                 .dstAccessMask = dstAccess};
+  const VkDependencyInfo dependencyInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &barrier};
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+}  // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Compute pipeline from the GLSL file, or the pre-compiled version
+//
+bool gltfr::GpuDrivenRaster::createPipeline(Resources&        res,
+                                            const char*       filename,
+                                            const uint32_t*   code,
+                                            size_t            codeSize,
+                                            VkPipelineLayout  layout,
+                                            VkPipeline&       pipeline)
+{
+  VkShaderModuleCreateInfo shaderModuleCreateInfo{.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, .codeSize = codeSize, .pCode = code};
+  std::vector<uint32_t> spirvCode;
+  if(res.hasGlslCompiler() && g_forceExternalShaders)
+  {
+    if(!res.compileGlslShader(filename, shaderc_shader_kind::shaderc_compute_shader, spirvCode)
+       || !res.createShaderModuleCreateInfo(spirvCode, shaderModuleCreateInfo))
+      return false;
+  }
+
+  VkShaderModule shaderModule{};
+  NVVK_CHECK(vkCreateShaderModule(m_device, &shaderModuleCreateInfo, nullptr, &shaderModule));
+  const VkComputePipelineCreateInfo pipelineInfo{
+      .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .stage  = {.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                 .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                 .module = shaderModule,
+                 .pName  = "main"},
+      .layout = layout,
+  };
+  NVVK_CHECK(vkCreateComputePipelines(m_device, res.m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline));
+  vkDestroyShaderModule(m_device, shaderModule, nullptr);
+  nvvk::DebugUtil(m_device).setObjectName(pipeline, filename);
+  return true;
+}
+
+bool gltfr::GpuDrivenRaster::init(Resources& res, Scene& scene)
+{
+  nvh::ScopedTimer st(__FUNCTION__);
+
+  m_alloc  = res.m_allocator.get();
+  m_device = res.ctx.device;
+
+  // Cull and index pool: scene descriptor set, and the push constant
+  const VkPushConstantRange sceneRange{VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                       static_cast<uint32_t>(std::max(sizeof(DH::PushConstantCull), sizeof(DH::PushConstantIndexPool)))};
+  const VkPipelineLayoutCreateInfo sceneLayoutInfo{.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                                                   .setLayoutCount         = 1,
+                                                   .pSetLayouts            = &scene.m_sceneDescriptorSetLayout,
+                                                   .pushConstantRangeCount = 1,
+                                                   .pPushConstantRanges    = &sceneRange};
+  NVVK_CHECK(vkCreatePipelineLayout(m_device, &sceneLayoutInfo, nullptr, &m_sceneLayout));
+
+  // Hi-Z: the depth attachment is pushed, it changes with the resolution
+  const VkDescriptorSetLayoutBinding depthBinding{.binding         = 0,
+                                                  .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                  .descriptorCount = 1,
+                                                  .stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT};
+  const VkDescriptorSetLayoutCreateInfo setLayoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                                                      .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
+                                                      .bindingCount = 1,
+                                                      .pBindings    = &depthBinding};
+  NVVK_CHECK(vkCreateDescriptorSetLayout(m_device, &setLayoutInfo, nullptr, &m_hizSetLayout));
+  const VkPushConstantRange        hizRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DH::PushConstantHiz)};
+  const VkPipelineLayoutCreateInfo hizLayoutInfo{.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                                                 .setLayoutCount         = 1,
+                                                 .pSetLayouts            = &m_hizSetLayout,
+                                                 .pushConstantRangeCount = 1,
+                                                 .pPushConstantRanges    = &hizRange};
+  NVVK_CHECK(vkCreatePipelineLayout(m_device, &hizLayoutInfo, nullptr, &m_hizLayout));
+
+  const VkSamplerCreateInfo samplerInfo{.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+                                        .magFilter    = VK_FILTER_NEAREST,
+                                        .minFilter    = VK_FILTER_NEAREST,
+                                        .mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+                                        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                                        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                                        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE};
+  NVVK_CHECK(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_depthSampler));
+
+  bool ok = createPipeline(res, "cull.comp.glsl", cull_comp_glsl, sizeof(cull_comp_glsl), m_sceneLayout, m_cullPipeline);
+  ok = ok && createPipeline(res, "index_pool.comp.glsl", index_pool_comp_glsl, sizeof(index_pool_comp_glsl), m_sceneLayout, m_indexPoolPipeline);
+  ok = ok && createPipeline(res, "hiz.comp.glsl", hiz_comp_glsl, sizeof(hiz_comp_glsl), m_hizLayout, m_hizPipeline);
+  if(!ok)
+    LOGW("GPU-driven raster: the compute shaders could not be created\n");
+
+  m_cullInfo = m_alloc->createBuffer(sizeof(DH::CullInfo), kStorageUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  m_counts   = m_alloc->createBuffer(sizeof(uint32_t) * eBucketCount,
+                                     kStorageUsage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_cullInfo.buffer);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_counts.buffer);
+  m_dirty = true;
+  return ok;
+}
+
+void gltfr::GpuDrivenRaster::destroyBuffers()
+{
+  m_alloc->destroy(m_indexPool);
+  m_alloc->destroy(m_primitives);
+  m_alloc->destroy(m_candidates);
+  m_alloc->destroy(m_commands);
+  m_alloc->destroy(m_drawData);
+  m_numCandidates = 0;
+  m_bucketOffsets = {};
+  m_bucketSizes   = {};
+}
+
+void gltfr::GpuDrivenRaster::retireBuffers(Resources& res)
+{
+  for(nvvk::Buffer* buffer : {&m_indexPool, &m_primitives, &m_candidates, &m_commands, &m_drawData})
+    res.retire(*buffer);
+  m_numCandidates = 0;
+  m_bucketOffsets = {};
+  m_bucketSizes   = {};
+}
+
+void gltfr::GpuDrivenRaster::deinit()
+{
+  if(m_alloc == nullptr)
+    return;
+  destroyBuffers();
+  m_alloc->destroy(m_cullInfo);
+  m_alloc->destroy(m_counts);
+  m_alloc->destroy(m_hiz);
+  vkDestroyPipeline(m_device, m_cullPipeline, nullptr);
+  vkDestroyPipeline(m_device, m_indexPoolPipeline, nullptr);
+  vkDestroyPipeline(m_device, m_hizPipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_sceneLayout, nullptr);
+  vkDestroyPipelineLayout(m_device, m_hizLayout, nullptr);
+  vkDestroyDescriptorSetLayout(m_device, m_hizSetLayout, nullptr);
+  vkDestroySampler(m_device, m_depthSampler, nullptr);
+  m_cullPipeline      = VK_NULL_HANDLE;
+  m_indexPoolPipeline = VK_NULL_HANDLE;
+  m_hizPipeline       = VK_NULL_HANDLE;
+  m_sceneLayout       = VK_NULL_HANDLE;
+  m_hizLayout         = VK_NULL_HANDLE;
+  m_hizSetLayout      = VK_NULL_HANDLE;
+  m_depthSampler      = VK_NULL_HANDLE;
+  m_alloc             = nullptr;
+  m_hizValid          = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Index pool, bounds of the primitives and draw candidates, the previous ones are retired
+//
+void gltfr::GpuDrivenRaster::update(Resources& res, Scene& scene, bool wireframe)
+{
+  if(!m_dirty || m_cullPipeline == VK_NULL_HANDLE)
+    return;
+  nvh::ScopedTimer st(__FUNCTION__);
+  m_dirty    = false;
+  m_hizValid = false;  // Could be from before the draws were disabled
+  retireBuffers(res);
+
+  const tinygltf::Model&                         model      = scene.m_gltfScene->getModel();
+  const std::vector<nvh::gltf::RenderPrimitive>& primitives = scene.m_gltfScene->getRenderPrimitives();
+  const std::vector<nvh::gltf::RenderNode>&      renderNodes = scene.m_gltfScene->getRenderNodes();
+  const std::vector<uint32_t>&                   deformed    = scene.getDeformedPrimitives();
+
+  // Bounds from the POSITION accessor, the glTF requires its min and max
+  std::vector<DH::PrimitiveCullInfo> cullInfos(primitives.size());
+  uint32_t                           numIndices = 0;
+  for(size_t i = 0; i < primitives.size(); i++)
+  {
+    DH::PrimitiveCullInfo& info = cullInfos[i];
+    info.firstIndex             = numIndices;
+    info.indexCount             = static_cast<uint32_t>(primitives[i].indexCount);
+    info.bboxMin                = glm::vec3(1.0F);
+    info.bboxMax                = glm::vec3(-1.0F);
+    numIndices += info.indexCount;
+
+    const auto position = primitives[i].pPrimitive->attributes.find("POSITION");
+    if(position == primitives[i].pPrimitive->attributes.end()
+       || std::binary_search(deformed.begin(), deformed.end(), static_cast<uint32_t>(i)))
+      continue;
+    const tinygltf::Accessor& accessor = model.accessors[position->second];
+    if(accessor.minValues.size() >= 3 && accessor.maxValues.size() >= 3)
+    {
+      info.bboxMin = glm::vec3(accessor.minValues[0], accessor.minValues[1], accessor.minValues[2]);
+      info.bboxMax = glm::vec3(accessor.maxValues[0], accessor.maxValues[1], accessor.maxValues[2]);
+    }
+  }
+
+  // Candidates, grouped by bucket
+  std::vector<DH::DrawCandidate> candidates;
+  auto addBucket = [&](Bucket bucket, const std::vector<uint32_t>& nodeIDs) {
+    m_bucketOffsets[bucket] = static_cast<uint32_t>(candidates.size());
+    for(uint32_t nodeID : nodeIDs)
+    {
+      if(renderNodes[nodeID].visible)
+        candidates.push_back({static_cast<int>(nodeID), renderNodes[nodeID].renderPrimID, static_cast<uint32_t>(bucket)});
+    }
+    m_bucketSizes[bucket] = static_cast<uint32_t>(candidates.size()) - m_bucketOffsets[bucket];
+  };
+  addBucket(eBucketSolid, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterSolid));
+  addBucket(eBucketSolidDoubleSided, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterSolidDoubleSided));
+  addBucket(eBucketBlend, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterBlend));
+  addBucket(eBucketWireframe, wireframe ? scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterAll) : std::vector<uint32_t>{});
+  m_numCandidates = static_cast<uint32_t>(candidates.size());
+  if(candidates.empty() || numIndices == 0)
+    return;
+
+  VkCommandBuffer cmd = res.createTempCmdBuffer();
+  m_primitives        = m_alloc->createBuffer(cmd, cullInfos, kStorageUsage);
+  m_candidates        = m_alloc->createBuffer(cmd, candidates, kStorageUsage);
+  m_commands = m_alloc->createBuffer(candidates.size() * sizeof(DH::DrawIndexedCommand), kStorageUsage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+  m_drawData  = m_alloc->createBuffer(candidates.size() * sizeof(DH::DrawData), kStorageUsage);
+  m_indexPool = m_alloc->createBuffer(numIndices * sizeof(uint32_t), kStorageUsage | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_primitives.buffer);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_candidates.buffer);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_commands.buffer);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_drawData.buffer);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_indexPool.buffer);
+
+  // Copy of the indices, read from the render primitives of the scene
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_indexPoolPipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_sceneLayout, 0, 1, &scene.m_sceneDescriptorSet, 0, nullptr);
+  DH::PushConstantIndexPool pushConst{.dst = nvvk::getBufferDeviceAddress(m_device, m_indexPool.buffer)};
+  for(size_t i = 0; i < primitives.size(); i++)
+  {
+    pushConst.renderPrimID = static_cast<int>(i);
+    pushConst.firstIndex   = cullInfos[i].firstIndex;
+    pushConst.numTriangles = cullInfos[i].indexCount / 3;
+    if(pushConst.numTriangles == 0)
+      continue;
+    vkCmdPushConstants(cmd, m_sceneLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DH::PushConstantIndexPool), &pushConst);
+    vkCmdDispatch(cmd, (pushConst.numTriangles + INDEX_POOL_WORKGROUP_SIZE - 1) / INDEX_POOL_WORKGROUP_SIZE, 1, 1);
+  }
+  res.submitAndWaitTempCmdBuffer(cmd);
+  m_alloc->finalizeAndReleaseStaging();
+
+  LOGI("GPU-driven raster: %u draw candidates, %u pooled indices\n", m_numCandidates, numIndices);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Level 0 is half the depth resolution, down to 1x1
+//
+void gltfr::GpuDrivenRaster::createHiz(Resources& res, const VkExtent2D& depthSize)
+{
+  if(m_alloc == nullptr)
+    return;
+  res.retire(m_hiz);
+  m_hizValid  = false;
+  m_depthSize = depthSize;
+  m_hizLevelSizes.clear();
+  m_hizLevelOffsets.clear();
+
+  VkExtent2D size{std::max(1U, (depthSize.width + 1) / 2), std::max(1U, (depthSize.height + 1) / 2)};
+  uint32_t   numTexels = 0;
+  while(m_hizLevelSizes.size() < HIZ_MAX_LEVELS)
+  {
+    m_hizLevelSizes.push_back(size);
+    m_hizLevelOffsets.push_back(numTexels);
+    numTexels += size.width * size.height;
+    if(size.width == 1 && size.height == 1)
+      break;
+    size = {std::max(1U, (size.width + 1) / 2), std::max(1U, (size.height + 1) / 2)};
+  }
+  m_hiz = m_alloc->createBuffer(numTexels * sizeof(float), kStorageUsage);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_hiz.buffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The Hi-Z is only used when it was built by the previous frame, with occlusion culling
+//
+void gltfr::GpuDrivenRaster::cmdUpdateCullInfo(VkCommandBuffer cmd, bool occlusion, VkPipelineStageFlags2 dstStages)
+{
+  if(!occlusion)
+    m_hizValid = false;  // Not built by the frames without occlusion culling
+
+  const VkDevice device  = m_device;
+  auto           address = [device](const nvvk::Buffer& buffer) {
+    return buffer.buffer == VK_NULL_HANDLE ? VkDeviceAddress(0) : nvvk::getBufferDeviceAddress(device, buffer.buffer);
+  };
+
+  DH::CullInfo info{};
+  info.hizViewProj   = m_hizViewProj;
+  info.candidates    = address(m_candidates);
+  info.primitives    = address(m_primitives);
+  info.commands      = address(m_commands);
+  info.drawData      = address(m_drawData);
+  info.counts        = address(m_counts);
+  info.numCandidates = m_numCandidates;
+  for(uint32_t b = 0; b < eBucketCount; b++)
+    info.bucketOffsets[b] = m_bucketOffsets[b];
+  if(occlusion && m_hizValid && m_hiz.buffer != VK_NULL_HANDLE)
+  {
+    info.hiz       = address(m_hiz);
+    info.hizSize   = {m_hizLevelSizes[0].width, m_hizLevelSizes[0].height};
+    info.hizLevels = static_cast<uint32_t>(m_hizLevelSizes.size());
+    for(size_t l = 0; l < m_hizLevelSizes.size(); l++)
+      info.hizLevelOffsets[l] = m_hizLevelOffsets[l];
+  }
+
+  // The previous frame may still read the commands, and write the Hi-Z
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_TRANSFER_BIT | dstStages,
+                VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+  vkCmdUpdateBuffer(cmd, m_cullInfo.buffer, 0, sizeof(DH::CullInfo), &info);
+  vkCmdFillBuffer(cmd, m_counts.buffer, 0, VK_WHOLE_SIZE, 0);
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, dstStages,
+                VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+}
+
+VkDeviceAddress gltfr::GpuDrivenRaster::cullInfoAddress() const
+{
+  return nvvk::getBufferDeviceAddress(m_device, m_cullInfo.buffer);
+}
+
+void gltfr::GpuDrivenRaster::cmdCull(VkCommandBuffer cmd, Scene& scene, bool occlusion)
+{
+  if(!occlusion)
+    m_hizValid = false;
+  if(m_numCandidates == 0 || m_commands.buffer == VK_NULL_HANDLE)
+    return;
+
+  cmdUpdateCullInfo(cmd, occlusion, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+
+  const DH::PushConstantCull pushConst{.cullInfo = cullInfoAddress()};
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_sceneLayout, 0, 1, &scene.m_sceneDescriptorSet, 0, nullptr);
+  vkCmdPushConstants(cmd, m_sceneLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DH::PushConstantCull), &pushConst);
+  vkCmdDispatch(cmd, (m_numCandidates + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+                VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT);
+}
+
+void gltfr::GpuDrivenRaster::cmdDraw(VkCommandBuffer cmd, Bucket bucket, VkPipelineLayout layout, DH::PushConstantRasterIndirect pushConst) const
+{
+  if(m_bucketSizes[bucket] == 0)
+    return;
+
+  pushConst.drawOffset = m_bucketOffsets[bucket];
+  pushConst.drawData   = nvvk::getBufferDeviceAddress(m_device, m_drawData.buffer);
+  vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                     sizeof(DH::PushConstantRasterIndirect), &pushConst);
+  vkCmdBindIndexBuffer(cmd, m_indexPool.buffer, 0, VK_INDEX_TYPE_UINT32);
+  vkCmdDrawIndexedIndirectCount(cmd, m_commands.buffer, m_bucketOffsets[bucket] * sizeof(DH::DrawIndexedCommand),
+                                m_counts.buffer, bucket * sizeof(uint32_t), m_bucketSizes[bucket], sizeof(DH::DrawIndexedCommand));
+}
+
+//--------------------------------------------------------------------------------------------------
+// The depth attachment is sampled by the first level, then each level reduces the previous one
+//
+void gltfr::GpuDrivenRaster::cmdBuildHiz(VkCommandBuffer cmd, VkImage depthImage, VkImageView depthView, const glm::mat4& viewProj)
+{
+  if(m_hiz.buffer == VK_NULL_HANDLE || m_hizPipeline == VK_NULL_HANDLE)
+    return;
+
+  // The culling of this frame (compute or task shader) read the previous Hi-Z
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                VK_ACCESS_2_SHADER_WRITE_BIT);
+
+  const VkImageSubresourceRange range{VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+  VkImageMemoryBarrier2         imageBarrier{.sType         = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+                                             .srcStageMask  = VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                                             .srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                             .dstStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                                             .dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                                             .oldLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                                             .newLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                                             .image         = depthImage,
+                                             .subresourceRange = range};
+  const VkDependencyInfo dependencyInfo{.sType                   = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+                                        .imageMemoryBarrierCount = 1,
+                                        .pImageMemoryBarriers    = &imageBarrier};
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+  const VkDescriptorImageInfo depthInfo{m_depthSampler, depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+  const VkWriteDescriptorSet  write{.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                    .dstBinding      = 0,
+                                    .descriptorCount = 1,
+                                    .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                    .pImageInfo      = &depthInfo};
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_hizPipeline);
+  vkCmdPushDescriptorSetKHR(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_hizLayout, 0, 1, &write);
+
+  const VkDeviceAddress hizAddress = nvvk::getBufferDeviceAddress(m_device, m_hiz.buffer);
+  for(size_t l = 0; l < m_hizLevelSizes.size(); l++)
+  {
+    const VkExtent2D    src = l == 0 ? m_depthSize : m_hizLevelSizes[l - 1];
+    const VkExtent2D    dst = m_hizLevelSizes[l];
+    DH::PushConstantHiz pushConst{};
+    pushConst.src       = l == 0 ? 0 : hizAddress + m_hizLevelOffsets[l - 1] * sizeof(float);
+    pushConst.dst       = hizAddress + m_hizLevelOffsets[l] * sizeof(float);
+    pushConst.srcSize   = {src.width, src.height};
+    pushConst.dstSize   = {dst.width, dst.height};
+    pushConst.fromDepth = l == 0 ? 1 : 0;
+    if(l > 0)
+      memoryBarrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT);
+    vkCmdPushConstants(cmd, m_hizLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DH::PushConstantHiz), &pushConst);
+    vkCmdDispatch(cmd, (dst.width + HIZ_WORKGROUP_SIZE - 1) / HIZ_WORKGROUP_SIZE,
+                  (dst.height + HIZ_WORKGROUP_SIZE - 1) / HIZ_WORKGROUP_SIZE, 1);
+  }
+
+  // Back to the layout of the G-Buffer
+  imageBarrier.srcStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+  imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+  imageBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+  imageBarrier.dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  imageBarrier.oldLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  imageBarrier.newLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+  m_hizViewProj = viewProj;
+  m_hizValid    = true;
+}
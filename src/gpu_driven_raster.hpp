@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  GPU-driven raster: culling on the GPU and one indirect draw per pipeline
+
+  - The indices of all render primitives are copied to a shared index pool, the
+    vertex shader fetches the positions with the buffer address of the primitive,
+    so there is no vertex pool.
+  - The draw candidates (visible render node and pipeline) are built when the
+    scene or the visibility changes.
+  - Each frame, the cull shader tests the candidates against the frustum and the
+    Hi-Z pyramid of the previous frame, and appends the visible ones to the
+    commands of their bucket. vkCmdDrawIndexedIndirectCount draws each bucket,
+    the vertex shader finds its render node with gl_DrawID.
+  - After the raster, the Hi-Z is rebuilt from the depth attachment.
+
+  The occlusion test uses the depth and the matrices of the previous frame: an
+  object which becomes visible can appear one frame late. Deformed primitives
+  (skinning, morph targets) are never culled, their bounds are not known.
+
+*/
+
+#include <array>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// nvpro-core
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "resources.hpp"
+#include "scene.hpp"
+
+#include "nvvkhl/shaders/dh_lighting.h"
+namespace DH {
+#include "shaders/device_host.h"
+#include "shaders/gpu_driven.h"
+}  // namespace DH
+
+namespace gltfr {
+
+class GpuDrivenRaster
+{
+public:
+  enum Bucket
+  {
+    eBucketSolid,
+    eBucketSolidDoubleSided,
+    eBucketBlend,
+    eBucketWireframe,
+    eBucketCount
+  };
+  static_assert(eBucketCount == DRAW_BUCKET_COUNT);
+
+  // Pipelines, using the descriptor set of the scene
+  bool init(Resources& res, Scene& scene);
+  void deinit();
+
+  // The draw candidates are rebuilt by the next update()
+  void setDirty() { m_dirty = true; }
+  void update(Resources& res, Scene& scene, bool wireframe);
+
+  // Hi-Z for a depth attachment of 'depthSize', invalid until the first cmdBuildHiz
+  void createHiz(Resources& res, const VkExtent2D& depthSize);
+
+  // Outside of the rendering: cull the candidates into the indirect commands
+  void cmdCull(VkCommandBuffer cmd, Scene& scene, bool occlusion);
+  // Outside of the rendering: the Hi-Z information for the shaders of 'dstStages' (also done by cmdCull)
+  void cmdUpdateCullInfo(VkCommandBuffer cmd, bool occlusion, VkPipelineStageFlags2 dstStages);
+  VkDeviceAddress cullInfoAddress() const;
+  // Inside of the rendering, with the raster pipeline of the bucket bound
+  void cmdDraw(VkCommandBuffer cmd, Bucket bucket, VkPipelineLayout layout, DH::PushConstantRasterIndirect pushConst) const;
+  // After the rendering: Hi-Z of the depth attachment, for the culling of the next frame
+  void cmdBuildHiz(VkCommandBuffer cmd, VkImage depthImage, VkImageView depthView, const glm::mat4& viewProj);
+
+  uint32_t numCandidates() const { return m_numCandidates; }
+
+private:
+  bool createPipeline(Resources& res, const char* filename, const uint32_t* code, size_t codeSize, VkPipelineLayout layout, VkPipeline& pipeline);
+  void destroyBuffers();
+  void retireBuffers(Resources& res);  // Still used by the frames in flight
+
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  VkDevice                 m_device{VK_NULL_HANDLE};
+
+  VkPipelineLayout      m_sceneLayout{VK_NULL_HANDLE};  // Cull and index pool
+  VkPipelineLayout      m_hizLayout{VK_NULL_HANDLE};
+  VkDescriptorSetLayout m_hizSetLayout{VK_NULL_HANDLE};  // Push descriptor, depth attachment
+  VkPipeline            m_cullPipeline{VK_NULL_HANDLE};
+  VkPipeline            m_indexPoolPipeline{VK_NULL_HANDLE};
+  VkPipeline            m_hizPipeline{VK_NULL_HANDLE};
+  VkSampler             m_depthSampler{VK_NULL_HANDLE};
+
+  nvvk::Buffer m_indexPool;
+  nvvk::Buffer m_primitives;  // PrimitiveCullInfo
+  nvvk::Buffer m_candidates;  // DrawCandidate
+  nvvk::Buffer m_commands;    // DrawIndexedCommand
+  nvvk::Buffer m_drawData;    // DrawData
+  nvvk::Buffer m_counts;      // Visible draws per bucket
+  nvvk::Buffer m_cullInfo;
+  nvvk::Buffer m_hiz;
+
+  bool                                m_dirty{true};
+  uint32_t                            m_numCandidates{0};
+  std::array<uint32_t, eBucketCount> m_bucketOffsets{};
+  std::array<uint32_t, eBucketCount> m_bucketSizes{};
+
+  bool                   m_hizValid{false};
+  glm::mat4              m_hizViewProj{1.0F};
+  VkExtent2D             m_depthSize{};
+  std::vector<VkExtent2D> m_hizLevelSizes;
+  std::vector<uint32_t>   m_hizLevelOffsets;
+};
+
+}  // namespace gltfr
@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "hdr_environment.hpp"
+#include "mapped_file.hpp"
+
+// nvpro-core
+#include "nvh/nvprint.hpp"
+#include "nvh/timesampler.hpp"
+#include "nvvk/buffers_vk.hpp"
+#include "nvvk/commands_vk.hpp"
+#include "nvvk/debug_util_vk.hpp"
+#include "nvvk/error_vk.hpp"
+#include "nvvk/images_vk.hpp"
+#include "nvvk/specialization.hpp"
+#include "nvvkhl/shaders/dh_hdr.h"
+
+namespace DH {
+#include "shaders/hdr_prepare.h"
+}  // namespace DH
+
+#include "_autogen/hdr_prepare.comp.glsl.h"
+
+namespace gltfr {
+extern bool g_forceExternalShaders;
+}
+
+namespace {
+constexpr VkBufferUsageFlags kStorageUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+constexpr uint32_t kMaxGroups  = 65535;       // Of a dispatch, the kernels loop over the rest
+constexpr uint32_t kWhiteTexel = 0x81808080;  // RGBE of (1, 1, 1)
+
+void memoryBarrier(VkCommandBuffer cmd, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+  const VkMemoryBarrier2 barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                 .srcStageMask  = srcStage,
+                                 .srcAccessMask = srcAccess,
+                                 .dstStageMask  = dstStage,
+                                 .dstAccessMask = dstAccess};
+  const VkDependencyInfo dependencyInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &barrier};
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+
+// Each kernel reads what the previous one wrote
+void computeBarrier(VkCommandBuffer cmd)
+{
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+}
+
+uint32_t groupCount(uint32_t count, uint32_t groupSize)
+{
+  return std::clamp((count + groupSize - 1) / groupSize, 1U, kMaxGroups);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Radiance .hdr: a text header, then the scanlines, top to bottom
+//
+bool readLine(const uint8_t*& ptr, const uint8_t* end, std::string_view& line)
+{
+  const uint8_t* eol = std::find(ptr, end, '\n');
+  if(eol == end)
+    return false;
+  line = std::string_view(reinterpret_cast<const char*>(ptr), eol - ptr);
+  if(!line.empty() && line.back() == '\r')
+    line.remove_suffix(1);
+  ptr = eol + 1;
+  return true;
+}
+
+bool readRadianceHeader(const uint8_t*& ptr, const uint8_t* end, uint32_t& width, uint32_t& height)
+{
+  std::string_view line;
+  if(!readLine(ptr, end, line) || line.substr(0, 2) != "#?")
+    return false;
+  while(readLine(ptr, end, line) && !line.empty())
+  {
+    if(line.substr(0, 7) == "FORMAT=" && line != "FORMAT=32-bit_rle_rgbe")
+    {
+      LOGW("HDR: unsupported format %.*s\n", static_cast<int>(line.size()), line.data());
+      return false;
+    }
+  }
+  // Only the usual orientation, rows from the top and columns from the left
+  if(!readLine(ptr, end, line))
+    return false;
+  const std::string resolution(line);
+  return std::sscanf(resolution.c_str(), "-Y %u +X %u", &height, &width) == 2 && width > 0 && height > 0;
+}
+
+// Flat texels, with the run-length encoding of the old format: (1,1,1,n) repeats the previous texel
+bool decodeFlatScanline(const uint8_t*& ptr, const uint8_t* end, uint32_t width, uint8_t* out)
+{
+  uint32_t x     = 0;
+  uint32_t shift = 0;
+  while(x < width)
+  {
+    if(end - ptr < 4)
+      return false;
+    const uint8_t* texel = ptr;
+    ptr += 4;
+    if(texel[0] == 1 && texel[1] == 1 && texel[2] == 1)
+    {
+      const size_t count = shift < 32 ? size_t(texel[3]) << shift : 0;
+      if(x == 0 || count > width - x)
+        return false;
+      for(size_t i = 0; i < count; i++, x++)
+        std::memcpy(out + x * 4, out + (x - 1) * 4, 4);
+      shift += 8;
+    }
+    else
+    {
+      std::memcpy(out + x * 4, texel, 4);
+      x++;
+      shift = 0;
+    }
+  }
+  return true;
+}
+
+// The channels of a scanline one after the other, each with runs and literals
+bool decodeScanline(const uint8_t*& ptr, const uint8_t* end, uint32_t width, uint8_t* out)
+{
+  const bool rle = width >= 8 && width < 0x8000 && end - ptr >= 4 && ptr[0] == 2 && ptr[1] == 2 && (ptr[2] & 0x80) == 0;
+  if(!rle)
+    return decodeFlatScanline(ptr, end, width, out);
+  if(((uint32_t(ptr[2]) << 8) | ptr[3]) != width)
+    return false;
+  ptr += 4;
+
+  for(uint32_t channel = 0; channel < 4; channel++)
+  {
+    uint32_t x = 0;
+    while(x < width)
+    {
+      if(ptr >= end)
+        return false;
+      uint32_t   count = *ptr++;
+      const bool run   = count > 128;
+      if(run)
+        count -= 128;
+      if(count == 0 || count > width - x || end - ptr < (run ? 1 : ptrdiff_t(count)))
+        return false;
+      for(uint32_t i = 0; i < count; i++)
+        out[(x + i) * 4 + channel] = run ? ptr[0] : ptr[i];
+      ptr += run ? 1 : count;
+      x += count;
+    }
+  }
+  return true;
+}
+
+// The scanlines after the header, in 'texels' of width * height RGBE texels
+bool decodeRadiance(const uint8_t* ptr, const uint8_t* end, uint32_t width, uint32_t height, uint8_t* texels)
+{
+  const size_t rowSize = size_t(width) * 4;
+  for(uint32_t y = 0; y < height; y++)
+  {
+    if(!decodeScanline(ptr, end, width, texels + rowSize * y))
+      return false;
+  }
+  return true;
+}
+}  // namespace
+
+
+gltfr::HdrEnvironment::HdrEnvironment(Resources& res)
+    : m_device(res.ctx.device)
+    , m_physicalDevice(res.ctx.physicalDevice)
+    , m_queue(res.ctx.compute)
+    , m_alloc(std::make_unique<nvvk::ResourceAllocatorDma>(res.ctx.device, res.ctx.physicalDevice))
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+// The device must not use the environment anymore, see Resources::retire
+//
+gltfr::HdrEnvironment::~HdrEnvironment()
+{
+  m_dome.reset();
+  m_alloc->destroy(m_texture);
+  m_alloc->destroy(m_accel);
+  vkDestroyDescriptorSetLayout(m_device, m_setLayout, nullptr);
+  vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Loader thread: decode or read the texels from the cache, then prepare everything on the GPU
+//
+bool gltfr::HdrEnvironment::create(Resources& res, const std::string& filename)
+{
+  nvh::ScopedTimer st(std::string(__FUNCTION__) + " " + filename);
+
+  nvvk::Buffer upload;
+  if(!loadTexels(filename, upload))
+    return false;
+  const bool ok = prepare(res, upload);
+  m_alloc->destroy(upload);
+  if(!ok)
+    return false;
+
+  createDescriptorSet();
+  m_dome = std::make_unique<nvvkhl::HdrEnvDome>(m_device, m_physicalDevice, m_alloc.get(), m_queue.familyIndex);
+  m_dome->create(m_set, m_setLayout);
+  m_alloc->finalizeAndReleaseStaging();
+  m_valid = !filename.empty();
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The RGBE texels in a host visible buffer, read by the first kernel
+// The file is only run-length decoded, directly in the mapped buffer.
+//
+bool gltfr::HdrEnvironment::loadTexels(const std::string& filename, nvvk::Buffer& upload)
+{
+  auto createUpload = [&](VkExtent2D size) {
+    const VkDeviceSize bytes = VkDeviceSize(size.width) * size.height * sizeof(uint32_t);
+    upload = m_alloc->createBuffer(bytes, kStorageUsage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_size = size;
+    return static_cast<uint8_t*>(m_alloc->map(upload));
+  };
+
+  if(filename.empty())
+  {
+    std::memcpy(createUpload({1, 1}), &kWhiteTexel, sizeof(kWhiteTexel));
+    m_alloc->unmap(upload);
+    return true;
+  }
+
+  MappedFile file;
+  if(!file.open(filename))
+  {
+    LOGE("HDR: cannot open %s\n", filename.c_str());
+    return false;
+  }
+
+  const uint8_t* ptr = file.data();
+  const uint8_t* end = file.data() + file.size();
+  VkExtent2D     size{};
+  if(!readRadianceHeader(ptr, end, size.width, size.height))
+  {
+    LOGE("HDR: %s is not a valid Radiance file\n", filename.c_str());
+    return false;
+  }
+
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(m_physicalDevice, &props);
+  const uint32_t maxDimension = props.limits.maxImageDimension2D;
+  if(size.width > maxDimension || size.height > maxDimension)
+  {
+    LOGE("HDR: %ux%u exceeds the image size limit of the device (%u)\n", size.width, size.height, maxDimension);
+    return false;
+  }
+
+  const bool decoded = decodeRadiance(ptr, end, size.width, size.height, createUpload(size));
+  m_alloc->unmap(upload);
+  if(!decoded)
+  {
+    LOGE("HDR: %s is not a valid Radiance file\n", filename.c_str());
+    m_alloc->destroy(upload);
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The image with its mips and pdf, and the alias table, built by the kernels of hdr_prepare.comp.glsl
+//
+bool gltfr::HdrEnvironment::prepare(Resources& res, const nvvk::Buffer& upload)
+{
+  const uint32_t numTexels = m_size.width * m_size.height;
+  const uint32_t numBlocks = (numTexels + HDR_PREPARE_BLOCK_SIZE - 1) / HDR_PREPARE_BLOCK_SIZE;
+
+  // Pipelines, one per kernel
+  VkShaderModuleCreateInfo shaderModuleCreateInfo{.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                                                  .codeSize = sizeof(hdr_prepare_comp_glsl),
+                                                  .pCode    = hdr_prepare_comp_glsl};
+  std::vector<uint32_t> spirvCode;
+  if(res.hasGlslCompiler() && g_forceExternalShaders)
+  {
+    if(!res.compileGlslShader("hdr_prepare.comp.glsl", shaderc_shader_kind::shaderc_compute_shader, spirvCode)
+       || !res.createShaderModuleCreateInfo(spirvCode, shaderModuleCreateInfo))
+      return false;
+  }
+
+  const std::array<VkDescriptorSetLayoutBinding, 2> imageBindings{{
+      {.binding = HDR_PREPARE_BINDING_SRC, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = HDR_PREPARE_BINDING_DST, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+  }};
+  const VkDescriptorSetLayoutCreateInfo setLayoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                                                      .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR,
+                                                      .bindingCount = static_cast<uint32_t>(imageBindings.size()),
+                                                      .pBindings    = imageBindings.data()};
+  VkDescriptorSetLayout imageSetLayout{};
+  NVVK_CHECK(vkCreateDescriptorSetLayout(m_device, &setLayoutInfo, nullptr, &imageSetLayout));
+  const VkPushConstantRange        pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DH::PushConstantHdr)};
+  const VkPipelineLayoutCreateInfo layoutInfo{.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                                              .setLayoutCount         = 1,
+                                              .pSetLayouts            = &imageSetLayout,
+                                              .pushConstantRangeCount = 1,
+                                              .pPushConstantRanges    = &pushConstantRange};
+  VkPipelineLayout layout{};
+  NVVK_CHECK(vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &layout));
+
+  VkShaderModule shaderModule{};
+  NVVK_CHECK(vkCreateShaderModule(m_device, &shaderModuleCreateInfo, nullptr, &shaderModule));
+  // The specializations must outlive the create infos
+  std::vector<nvvk::Specialization>        specializations(HDR_STAGE_COUNT);
+  std::vector<VkComputePipelineCreateInfo> pipelineInfos(HDR_STAGE_COUNT);
+  std::array<VkPipeline, HDR_STAGE_COUNT>  pipelines{};
+  for(uint32_t stage = 0; stage < HDR_STAGE_COUNT; stage++)
+  {
+    specializations[stage].add(0, static_cast<int32_t>(stage));
+    pipelineInfos[stage] = {
+        .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage  = {.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                   .stage               = VK_SHADER_STAGE_COMPUTE_BIT,
+                   .module              = shaderModule,
+                   .pName               = "main",
+                   .pSpecializationInfo = specializations[stage].getSpecialization()},
+        .layout = layout,
+    };
+  }
+  const VkResult result = vkCreateComputePipelines(m_device, res.m_pipelineCache, HDR_STAGE_COUNT, pipelineInfos.data(),
+                                                   nullptr, pipelines.data());
+  vkDestroyShaderModule(m_device, shaderModule, nullptr);
+
+  auto destroyPipelines = [&]() {
+    for(VkPipeline pipeline : pipelines)
+      vkDestroyPipeline(m_device, pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, layout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, imageSetLayout, nullptr);
+  };
+  if(result != VK_SUCCESS)
+  {
+    LOGW("HDR: the preparation kernels could not be created\n");
+    destroyPipelines();
+    return false;
+  }
+
+  // The image, sampled with its mips, and one storage view per level
+  const VkImageCreateInfo imageInfo =
+      nvvk::makeImage2DCreateInfo(m_size, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, true);
+  const VkSamplerCreateInfo samplerInfo{.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+                                        .magFilter    = VK_FILTER_LINEAR,
+                                        .minFilter    = VK_FILTER_LINEAR,
+                                        .mipmapMode   = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+                                        .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+                                        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                                        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                                        .maxLod       = VK_LOD_CLAMP_NONE};
+  const nvvk::Image           image    = m_alloc->createImage(imageInfo);
+  const VkImageViewCreateInfo viewInfo = nvvk::makeImageViewCreateInfo(image.image, imageInfo);
+  m_texture                            = m_alloc->createTexture(image, viewInfo, samplerInfo);
+  m_texture.descriptor.imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  nvvk::DebugUtil(m_device).setObjectName(m_texture.image, "HDR environment");
+
+  std::vector<VkImageView> levelViews(imageInfo.mipLevels);
+  for(uint32_t level = 0; level < imageInfo.mipLevels; level++)
+  {
+    VkImageViewCreateInfo levelInfo         = viewInfo;
+    levelInfo.subresourceRange.baseMipLevel = level;
+    levelInfo.subresourceRange.levelCount   = 1;
+    NVVK_CHECK(vkCreateImageView(m_device, &levelInfo, nullptr, &levelViews[level]));
+  }
+
+  // The alias table is kept, the rest is only used by the kernels
+  m_accel = m_alloc->createBuffer(VkDeviceSize(numTexels) * sizeof(nvvkhl_shaders::EnvAccel), kStorageUsage);
+  nvvk::Buffer weights = m_alloc->createBuffer(VkDeviceSize(numTexels) * sizeof(float), kStorageUsage);
+  nvvk::Buffer blocks  = m_alloc->createBuffer(VkDeviceSize(numBlocks + 1) * sizeof(DH::HdrBlock), kStorageUsage);
+  nvvk::Buffer sums    = m_alloc->createBuffer(VkDeviceSize(numTexels + 2) * sizeof(uint64_t), kStorageUsage);
+  nvvk::Buffer heavies = m_alloc->createBuffer(VkDeviceSize(numTexels) * sizeof(uint32_t), kStorageUsage);
+  nvvk::Buffer info    = m_alloc->createBuffer(sizeof(DH::HdrPrepareInfo), kStorageUsage,
+                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  DH::PushConstantHdr pushConst{};
+  pushConst.texels    = nvvk::getBufferDeviceAddress(m_device, upload.buffer);
+  pushConst.weights   = nvvk::getBufferDeviceAddress(m_device, weights.buffer);
+  pushConst.blocks    = nvvk::getBufferDeviceAddress(m_device, blocks.buffer);
+  pushConst.sums      = nvvk::getBufferDeviceAddress(m_device, sums.buffer);
+  pushConst.heavies   = nvvk::getBufferDeviceAddress(m_device, heavies.buffer);
+  pushConst.accel     = nvvk::getBufferDeviceAddress(m_device, m_accel.buffer);
+  pushConst.info      = nvvk::getBufferDeviceAddress(m_device, info.buffer);
+  pushConst.size      = {m_size.width, m_size.height};
+  pushConst.numTexels = numTexels;
+  pushConst.numBlocks = numBlocks;
+
+  // Storage views of two levels, the same one for all kernels except the mips
+  auto pushImages = [&](VkCommandBuffer cmd, VkImageView src, VkImageView dst) {
+    const VkDescriptorImageInfo srcInfo{VK_NULL_HANDLE, src, VK_IMAGE_LAYOUT_GENERAL};
+    const VkDescriptorImageInfo dstInfo{VK_NULL_HANDLE, dst, VK_IMAGE_LAYOUT_GENERAL};
+    const std::array<VkWriteDescriptorSet, 2> writes{{
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstBinding      = HDR_PREPARE_BINDING_SRC,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .pImageInfo      = &srcInfo},
+        {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstBinding      = HDR_PREPARE_BINDING_DST,
+         .descriptorCount = 1,
+         .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .pImageInfo      = &dstInfo},
+    }};
+    vkCmdPushDescriptorSetKHR(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, static_cast<uint32_t>(writes.size()), writes.data());
+  };
+  auto dispatch = [&](VkCommandBuffer cmd, uint32_t stage, uint32_t groups) {
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[stage]);
+    vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DH::PushConstantHdr), &pushConst);
+    vkCmdDispatch(cmd, groups, 1, 1);
+  };
+
+  {
+    nvh::ScopedTimer st("Prepare HDR on the GPU");
+    nvvk::CommandPool cmdPool(m_device, m_queue.familyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, m_queue.queue);
+    VkCommandBuffer   cmd = cmdPool.createCommandBuffer();
+
+    const VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, imageInfo.mipLevels, 0, 1};
+    nvvk::cmdBarrierImageLayout(cmd, m_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, range);
+
+    // Level 0 and the alias table
+    pushImages(cmd, levelViews[0], levelViews[0]);
+    const uint32_t blockGroups = std::min(numBlocks, kMaxGroups);
+    dispatch(cmd, HDR_STAGE_WEIGHTS, blockGroups);
+    for(uint32_t stage : {HDR_STAGE_TOTAL, HDR_STAGE_BLOCKS, HDR_STAGE_OFFSETS, HDR_STAGE_SCATTER, HDR_STAGE_ALIAS})
+    {
+      computeBarrier(cmd);
+      dispatch(cmd, stage, (stage == HDR_STAGE_TOTAL || stage == HDR_STAGE_OFFSETS) ? 1 : blockGroups);
+    }
+
+    // Each level averages the previous one, alpha included
+    for(uint32_t level = 1; level < imageInfo.mipLevels; level++)
+    {
+      const VkExtent2D levelSize{std::max(m_size.width >> level, 1U), std::max(m_size.height >> level, 1U)};
+      pushConst.size      = {levelSize.width, levelSize.height};
+      pushConst.numTexels = levelSize.width * levelSize.height;
+      computeBarrier(cmd);
+      pushImages(cmd, levelViews[level - 1], levelViews[level]);
+      dispatch(cmd, HDR_STAGE_MIP, groupCount(pushConst.numTexels, HDR_PREPARE_WORKGROUP_SIZE));
+    }
+
+    nvvk::cmdBarrierImageLayout(cmd, m_texture.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range);
+    cmdPool.submitAndWait(cmd);
+  }
+
+  m_integral = static_cast<const DH::HdrPrepareInfo*>(m_alloc->map(info))->integral;
+  m_alloc->unmap(info);
+
+  for(VkImageView view : levelViews)
+    vkDestroyImageView(m_device, view, nullptr);
+  for(nvvk::Buffer* buffer : {&weights, &blocks, &sums, &heavies, &info})
+    m_alloc->destroy(*buffer);
+  destroyPipelines();
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The descriptor set of nvvkhl::HdrEnv, read by environmentSample() and the dome
+//
+void gltfr::HdrEnvironment::createDescriptorSet()
+{
+  const std::array<VkDescriptorSetLayoutBinding, 2> bindings{{
+      {.binding         = nvvkhl_shaders::EnvBindings::eHdr,
+       .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+       .descriptorCount = 1,
+       .stageFlags      = VK_SHADER_STAGE_ALL},
+      {.binding         = nvvkhl_shaders::EnvBindings::eImpSamples,
+       .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags      = VK_SHADER_STAGE_ALL},
+  }};
+  const VkDescriptorSetLayoutCreateInfo layoutInfo{.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                                                   .bindingCount = static_cast<uint32_t>(bindings.size()),
+                                                   .pBindings    = bindings.data()};
+  NVVK_CHECK(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_setLayout));
+
+  const std::array<VkDescriptorPoolSize, 2> poolSizes{{{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1}, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1}}};
+  const VkDescriptorPoolCreateInfo poolInfo{.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                                            .maxSets       = 1,
+                                            .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+                                            .pPoolSizes    = poolSizes.data()};
+  NVVK_CHECK(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_pool));
+  const VkDescriptorSetAllocateInfo allocInfo{.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                                              .descriptorPool     = m_pool,
+                                              .descriptorSetCount = 1,
+                                              .pSetLayouts        = &m_setLayout};
+  NVVK_CHECK(vkAllocateDescriptorSets(m_device, &allocInfo, &m_set));
+
+  const VkDescriptorBufferInfo              accelInfo{m_accel.buffer, 0, VK_WHOLE_SIZE};
+  const std::array<VkWriteDescriptorSet, 2> writes{{
+      {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .dstSet          = m_set,
+       .dstBinding      = nvvkhl_shaders::EnvBindings::eHdr,
+       .descriptorCount = 1,
+       .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+       .pImageInfo      = &m_texture.descriptor},
+      {.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .dstSet          = m_set,
+       .dstBinding      = nvvkhl_shaders::EnvBindings::eImpSamples,
+       .descriptorCount = 1,
+       .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .pBufferInfo     = &accelInfo},
+  }};
+  vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  HDR environment, prepared on the GPU
+
+  Same descriptor set as nvvkhl::HdrEnv (EnvBindings of dh_hdr.h): the image, with the pdf in
+  its alpha, and the EnvAccel alias table of environmentSample().
+
+  - The .hdr file is only run-length decoded on the CPU, to its RGBE texels, directly in the
+    mapped upload buffer. This costs about as much as reading the file, so nothing is cached.
+  - The kernels of hdr_prepare.comp.glsl convert the texels to float, build the importance
+    sampling table and the mip chain.
+  - nvvkhl::HdrEnvDome prefilters the environment for the raster (compute).
+
+  create() is called by a loader thread, the environment has its own allocator and uses the
+  compute queue. The Scene swaps it with the current one once it is ready.
+
+*/
+
+#include <memory>
+#include <string>
+
+// nvpro-core
+#include "nvvk/resourceallocator_vk.hpp"
+#include "nvvkhl/hdr_env_dome.hpp"
+
+#include "resources.hpp"
+
+namespace gltfr {
+
+class HdrEnvironment
+{
+public:
+  explicit HdrEnvironment(Resources& res);
+  ~HdrEnvironment();
+
+  // Load and prepare the environment, an empty filename makes a white environment which is not valid
+  bool create(Resources& res, const std::string& filename);
+
+  bool                  isValid() const { return m_valid; }
+  float                 getIntegral() const { return m_integral; }  // Of max(r,g,b) over the sphere
+  VkExtent2D            getHdrImageSize() const { return m_size; }
+  VkDescriptorSetLayout getDescriptorSetLayout() const { return m_setLayout; }
+  VkDescriptorSet       getDescriptorSet() const { return m_set; }
+  nvvkhl::HdrEnvDome&   getDome() { return *m_dome; }
+
+private:
+  bool loadTexels(const std::string& filename, nvvk::Buffer& upload);
+  bool prepare(Resources& res, const nvvk::Buffer& upload);
+  void createDescriptorSet();
+
+  VkDevice                                    m_device{VK_NULL_HANDLE};
+  VkPhysicalDevice                            m_physicalDevice{VK_NULL_HANDLE};
+  Queue                                       m_queue;
+  std::unique_ptr<nvvk::ResourceAllocatorDma> m_alloc;
+
+  nvvk::Texture                       m_texture;  // RGB and pdf, with the mips
+  nvvk::Buffer                        m_accel;    // EnvAccel per texel
+  VkDescriptorPool                    m_pool{VK_NULL_HANDLE};
+  VkDescriptorSetLayout               m_setLayout{VK_NULL_HANDLE};
+  VkDescriptorSet                     m_set{VK_NULL_HANDLE};
+  std::unique_ptr<nvvkhl::HdrEnvDome> m_dome;
+
+  VkExtent2D m_size{1, 1};
+  float      m_integral{1.0F};
+  bool       m_valid{false};
+};
+
+}  // namespace gltfr
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <chrono>
+
+#include "image_readback.hpp"
+#include "utilities.hpp"
+
+// nvpro-core
+#include "nvvk/error_vk.hpp"
+
+namespace {
+void memoryBarrier(VkCommandBuffer cmd, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+  const VkMemoryBarrier2 barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                 .srcStageMask  = srcStage,
+                                 .srcAccessMask = srcAccess,
+                                 .dstStageMask  = dstStage,
+                                 .dstAccessMask = dstAccess};
+  const VkDependencyInfo dependencyInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &barrier};
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+}  // namespace
+
+void gltfr::ImageReadback::init(Resources& res)
+{
+  m_alloc  = res.m_allocator.get();
+  m_device = res.ctx.device;
+  m_stop   = false;
+
+  // The encoding of PNG and JPEG takes longer than a frame, a few images are encoded at once
+  const uint32_t numWorkers = std::clamp(std::thread::hardware_concurrency() / 2, 1U, 4U);
+  for(uint32_t i = 0; i < numWorkers; i++)
+    m_workers.emplace_back(&ImageReadback::workerLoop, this);
+}
+
+void gltfr::ImageReadback::deinit()
+{
+  if(m_alloc == nullptr)
+    return;
+  flush();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_encodeCv.notify_all();
+  for(std::thread& worker : m_workers)
+    worker.join();
+  m_workers.clear();
+
+  for(std::unique_ptr<Slot>& slot : m_slots)
+    destroySlot(*slot);
+  m_slots.clear();
+  m_alloc = nullptr;
+}
+
+void gltfr::ImageReadback::destroySlot(Slot& slot)
+{
+  if(slot.data != nullptr)
+    m_alloc->unmap(slot.buffer);
+  m_alloc->destroy(slot.buffer);
+  vkDestroyEvent(m_device, slot.event, nullptr);
+  slot = {};
+}
+
+//--------------------------------------------------------------------------------------------------
+// A free slot with a buffer of at least 'bytes'
+// Beyond kMaxSlots, waits for a worker: the copies still in flight can be in the command buffer
+// being recorded, a new slot is created when no image is being encoded.
+//
+gltfr::ImageReadback::Slot& gltfr::ImageReadback::acquireSlot(VkDeviceSize bytes)
+{
+  update();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  auto findFree = [&]() -> Slot* {
+    Slot* found = nullptr;
+    for(std::unique_ptr<Slot>& slot : m_slots)
+    {
+      if(slot->state == eFree && (found == nullptr || slot->capacity >= bytes))
+        found = slot.get();
+    }
+    return found;
+  };
+
+  Slot* slot = findFree();
+  if(slot == nullptr && m_slots.size() >= kMaxSlots)
+  {
+    m_freeCv.wait(lock, [&]() {
+      slot = findFree();
+      return slot != nullptr || std::none_of(m_slots.begin(), m_slots.end(), [](const std::unique_ptr<Slot>& s) {
+               return s->state == eEncoding;
+             });
+    });
+  }
+  if(slot == nullptr)
+    slot = m_slots.emplace_back(std::make_unique<Slot>()).get();
+  lock.unlock();
+
+  // Neither the GPU nor a worker uses a free slot
+  if(slot->capacity < bytes)
+  {
+    destroySlot(*slot);
+    slot->buffer   = m_alloc->createBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    slot->capacity = bytes;
+    slot->data     = m_alloc->map(slot->buffer);
+    const VkEventCreateInfo eventInfo{.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO};
+    NVVK_CHECK(vkCreateEvent(m_device, &eventInfo, nullptr, &slot->event));
+  }
+  NVVK_CHECK(vkResetEvent(m_device, slot->event));
+  return *slot;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Copy of the image to a buffer of the ring, the event tells the host when it can be read
+//
+void gltfr::ImageReadback::cmdSave(VkCommandBuffer    cmd,
+                                   VkImage            image,
+                                   VkFormat           format,
+                                   const VkExtent2D&  size,
+                                   const std::string& filename,
+                                   uint32_t           samples)
+{
+  const VkDeviceSize texelSize = (format == VK_FORMAT_R32G32B32A32_SFLOAT) ? 4 * sizeof(float) : 4;
+  Slot&              slot      = acquireSlot(texelSize * size.width * size.height);
+  slot.format                  = format;
+  slot.size                    = size;
+  slot.filename                = filename;
+  slot.samples                 = samples;
+
+  // The renderer and the tonemapper wrote the image
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+  const VkBufferImageCopy region{.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, .imageExtent = {size.width, size.height, 1}};
+  vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_GENERAL, slot.buffer.buffer, 1, &region);
+  // The next commands can write the image again
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_NONE);
+
+  const VkMemoryBarrier2 toHost{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                .srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                .dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT,
+                                .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT};
+  const VkDependencyInfo dependencyInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &toHost};
+  vkCmdSetEvent2(cmd, slot.event, &dependencyInfo);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  slot.state = eCopying;
+}
+
+void gltfr::ImageReadback::update()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for(std::unique_ptr<Slot>& slot : m_slots)
+  {
+    if(slot->state == eCopying && vkGetEventStatus(m_device, slot->event) == VK_EVENT_SET)
+    {
+      slot->state = eEncoding;
+      m_encodeQueue.push_back(slot.get());
+      m_encodeCv.notify_one();
+    }
+  }
+}
+
+void gltfr::ImageReadback::flush()
+{
+  while(true)
+  {
+    update();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(std::all_of(m_slots.begin(), m_slots.end(), [](const std::unique_ptr<Slot>& s) { return s->state == eFree; }))
+      break;
+    m_freeCv.wait_for(lock, std::chrono::milliseconds(1));
+  }
+}
+
+void gltfr::ImageReadback::workerLoop()
+{
+  while(true)
+  {
+    Slot* slot = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_encodeCv.wait(lock, [&]() { return m_stop || !m_encodeQueue.empty(); });
+      if(m_encodeQueue.empty())
+        return;
+      slot = m_encodeQueue.front();
+      m_encodeQueue.pop_front();
+    }
+
+    if(slot->format == VK_FORMAT_R32G32B32A32_SFLOAT)
+      writeRgba32fImage(slot->filename, slot->size, static_cast<const float*>(slot->data), slot->samples);
+    else
+      writeRgba8Image(slot->filename, slot->size, static_cast<const uint8_t*>(slot->data));
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      slot->state = eFree;
+    }
+    m_freeCv.notify_all();
+  }
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Asynchronous readback of the rendered images
+
+  cmdSave() records the copy of an image to a host visible buffer in the
+  command buffer of the frame, followed by an event. update(), at each frame,
+  hands the copies whose event is set to the workers, which encode the files
+  (see writeRgba8Image / writeRgba32fImage). Neither the copy nor the encoding
+  waits on the render thread.
+
+  The buffers are reused from one image to the next. When the workers are
+  late, the render thread waits for one of them beyond kMaxSlots images.
+
+*/
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// nvpro-core
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "resources.hpp"
+
+namespace gltfr {
+
+class ImageReadback
+{
+public:
+  ~ImageReadback() { deinit(); }
+
+  void init(Resources& res);
+  void deinit();  // The pending images are written first
+
+  // Copy of 'image', in the GENERAL layout, after the commands which wrote it
+  // RGBA8 is written as PNG/JPEG/BMP, RGBA32F as EXR/HDR, 'samples' of the accumulation in the EXR header
+  void cmdSave(VkCommandBuffer cmd, VkImage image, VkFormat format, const VkExtent2D& size, const std::string& filename, uint32_t samples = 0);
+
+  // At each frame: the copies which completed are encoded
+  void update();
+
+  // Waits for all the recorded copies to be written, their command buffers must be submitted
+  void flush();
+
+private:
+  enum SlotState
+  {
+    eFree,
+    eCopying,   // Recorded, waiting for the event
+    eEncoding,  // Given to a worker
+  };
+
+  struct Slot
+  {
+    nvvk::Buffer buffer;
+    VkDeviceSize capacity{0};
+    const void*  data{nullptr};  // Mapped buffer
+    VkEvent      event{VK_NULL_HANDLE};
+    VkFormat     format{VK_FORMAT_UNDEFINED};
+    VkExtent2D   size{};
+    std::string  filename;
+    uint32_t     samples{0};
+    SlotState    state{eFree};
+  };
+
+  static constexpr size_t kMaxSlots = 6;
+
+  Slot& acquireSlot(VkDeviceSize bytes);
+  void  destroySlot(Slot& slot);
+  void  workerLoop();
+
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  VkDevice                 m_device{VK_NULL_HANDLE};
+
+  std::vector<std::unique_ptr<Slot>> m_slots;
+  std::deque<Slot*>                  m_encodeQueue;
+  std::mutex                         m_mutex;  // The states of the slots and the queue
+  std::condition_variable            m_encodeCv;
+  std::condition_variable            m_freeCv;
+  std::vector<std::thread>           m_workers;
+  bool                               m_stop{false};
+};
+
+}  // namespace gltfr
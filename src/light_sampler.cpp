@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#include <glm/gtc/constants.hpp>
+
+#include "light_sampler.hpp"
+
+// nvpro-core
+#include "fileformats/tinygltf_utils.hpp"
+#include "nvh/nvprint.hpp"
+#include "nvh/timesampler.hpp"
+#include "nvvk/debug_util_vk.hpp"
+
+#include "gltf_accessor.hpp"
+
+namespace {
+float luminance(const std::vector<double>& color)
+{
+  return color.size() < 3 ? 1.0F : static_cast<float>(0.2126 * color[0] + 0.7152 * color[1] + 0.0722 * color[2]);
+}
+
+// Radiance of the emissive surface of the material, without the texture
+float emissiveLuminance(const tinygltf::Material& material)
+{
+  return luminance(material.emissiveFactor) * tinygltf::utils::getEmissiveStrength(material).emissiveStrength;
+}
+
+// Watts of the glTF light, in the units of the renderer (see light_contrib.h)
+float punctualPower(const tinygltf::Light& light, float sceneRadius)
+{
+  const float intensity = static_cast<float>(light.intensity) * luminance(light.color);
+  if(light.type == "directional")
+    return glm::pi<float>() * sceneRadius * sceneRadius * intensity;  // Lux on the disk of the scene
+  if(light.type == "spot")
+    return glm::two_pi<float>() * (1.0F - static_cast<float>(std::cos(light.spot.outerConeAngle))) * intensity;
+  return 4.0F * glm::pi<float>() * intensity;
+}
+}  // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Table of the scene: the triangles of the emissive render nodes are read once
+//
+void gltfr::LightSampler::build(Resources& res, const nvh::gltf::Scene& scene)
+{
+  nvh::ScopedTimer st(__FUNCTION__);
+  m_alloc = res.m_allocator.get();
+
+  const tinygltf::Model&                         model       = scene.getModel();
+  const std::vector<nvh::gltf::RenderNode>&      renderNodes = scene.getRenderNodes();
+  const std::vector<nvh::gltf::RenderPrimitive>& primitives  = scene.getRenderPrimitives();
+
+  m_sceneRadius = std::max(scene.getSceneBounds().radius(), 1e-3F);
+  m_numPunctual = static_cast<uint32_t>(scene.getRenderLights().size());
+  m_emissiveNodes.clear();
+  m_triangleAreas.clear();
+
+  for(uint32_t nodeID : findEmissiveNodes(scene))
+  {
+    const nvh::gltf::RenderNode& renderNode = renderNodes[nodeID];
+    const tinygltf::Primitive&   primitive  = *primitives[renderNode.renderPrimID].pPrimitive;
+    const std::vector<float>     values     = readAccessor(model, primitive.attributes.at("POSITION"), 3);
+    const std::vector<uint32_t>  indices    = readIndices(model, primitive.indices, values.size() / 3);
+
+    std::vector<glm::vec3> positions(values.size() / 3);
+    for(size_t i = 0; i < positions.size(); i++)
+      positions[i] = glm::vec3(renderNode.worldMatrix * glm::vec4(values[i * 3 + 0], values[i * 3 + 1], values[i * 3 + 2], 1.0F));
+
+    const EmissiveNode node{.renderNode   = nodeID,
+                            .firstEntry   = m_numPunctual + static_cast<uint32_t>(m_triangleAreas.size()),
+                            .numTriangles = static_cast<uint32_t>(indices.size() / 3)};
+    for(uint32_t t = 0; t < node.numTriangles; t++)
+    {
+      const glm::vec3& p0 = positions[indices[t * 3 + 0]];
+      const glm::vec3& p1 = positions[indices[t * 3 + 1]];
+      const glm::vec3& p2 = positions[indices[t * 3 + 2]];
+      m_triangleAreas.push_back(0.5F * glm::length(glm::cross(p1 - p0, p2 - p0)));
+    }
+    m_emissiveNodes.push_back(node);
+  }
+
+  std::vector<float> powers;
+  computePowers(scene, powers);
+  buildAliasTable(powers);
+  createBuffers(res, static_cast<uint32_t>(renderNodes.size()));
+  LOGI("Light sampling: %u punctual lights, %zu emissive triangles\n", m_numPunctual, m_triangleAreas.size());
+}
+
+void gltfr::LightSampler::deinit()
+{
+  if(m_alloc == nullptr)
+    return;
+  m_alloc->destroy(m_lights);
+  m_alloc->destroy(m_nodes);
+  m_alloc = nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Lights, materials or visibility changed: the table is only built again if the powers differ
+//
+bool gltfr::LightSampler::update(Resources& res, const nvh::gltf::Scene& scene, UploadRing& uploadRing)
+{
+  if(m_alloc == nullptr)
+    return false;
+
+  const std::vector<uint32_t> nodes = findEmissiveNodes(scene);
+  bool sameNodes = (nodes.size() == m_emissiveNodes.size()) && (scene.getRenderLights().size() == m_numPunctual);
+  for(size_t i = 0; sameNodes && i < nodes.size(); i++)
+    sameNodes = (nodes[i] == m_emissiveNodes[i].renderNode);
+  if(!sameNodes)
+  {
+    build(res, scene);
+    return true;
+  }
+
+  std::vector<float> powers;
+  computePowers(scene, powers);
+  if(powers == m_powers)
+    return false;
+
+  buildAliasTable(powers);
+  if(uploadRing.copy(m_lights.buffer, 0, &m_info, sizeof(DH::LightSamplingInfo))
+     && uploadRing.copy(m_lights.buffer, sizeof(DH::LightSamplingInfo), m_entries.data(), m_entries.size() * sizeof(DH::LightEntry)))
+    return false;
+
+  // Too large for the upload ring
+  createBuffers(res, static_cast<uint32_t>(scene.getRenderNodes().size()));
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Irradiance of the lights at the bounds of the scene, as if all were at the center,
+// against the one of the environment
+//
+float gltfr::LightSampler::lightsWeight(float envIrradiance) const
+{
+  if(m_info.numEntries == 0)
+    return 0.0F;
+  if(envIrradiance <= 0.0F)
+    return 1.0F;
+  const float lightsIrradiance = m_info.totalPower / (4.0F * glm::pi<float>() * m_sceneRadius * m_sceneRadius);
+  return std::clamp(lightsIrradiance / (lightsIrradiance + envIrradiance), 0.05F, 0.95F);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Render nodes with a material which emits, and triangles
+//
+std::vector<uint32_t> gltfr::LightSampler::findEmissiveNodes(const nvh::gltf::Scene& scene) const
+{
+  const tinygltf::Model&                         model       = scene.getModel();
+  const std::vector<nvh::gltf::RenderNode>&      renderNodes = scene.getRenderNodes();
+  const std::vector<nvh::gltf::RenderPrimitive>& primitives  = scene.getRenderPrimitives();
+
+  std::vector<uint32_t> nodes;
+  for(uint32_t nodeID = 0; nodeID < static_cast<uint32_t>(renderNodes.size()); nodeID++)
+  {
+    const nvh::gltf::RenderNode& renderNode = renderNodes[nodeID];
+    if(renderNode.materialID < 0 || renderNode.materialID >= static_cast<int>(model.materials.size())
+       || emissiveLuminance(model.materials[renderNode.materialID]) <= 0.0F)
+      continue;
+    const tinygltf::Primitive& primitive = *primitives[renderNode.renderPrimID].pPrimitive;
+    if(primitive.mode == TINYGLTF_MODE_TRIANGLES && primitive.attributes.find("POSITION") != primitive.attributes.end())
+      nodes.push_back(nodeID);
+  }
+  return nodes;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Power of all entries: punctual lights first, then the emissive triangles (pi * L * area)
+//
+void gltfr::LightSampler::computePowers(const nvh::gltf::Scene& scene, std::vector<float>& powers) const
+{
+  const tinygltf::Model&                    model       = scene.getModel();
+  const std::vector<nvh::gltf::RenderNode>& renderNodes = scene.getRenderNodes();
+
+  powers.resize(m_numPunctual + m_triangleAreas.size());
+  const std::vector<nvh::gltf::RenderLight>& renderLights = scene.getRenderLights();
+  for(uint32_t i = 0; i < m_numPunctual; i++)
+    powers[i] = punctualPower(model.lights[renderLights[i].light], m_sceneRadius);
+
+  for(const EmissiveNode& node : m_emissiveNodes)
+  {
+    const nvh::gltf::RenderNode& renderNode = renderNodes[node.renderNode];
+    const float radiance = renderNode.visible ? emissiveLuminance(model.materials[renderNode.materialID]) : 0.0F;
+    for(uint32_t t = 0; t < node.numTriangles; t++)
+      powers[node.firstEntry + t] = glm::pi<float>() * radiance * m_triangleAreas[node.firstEntry - m_numPunctual + t];
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Alias table of the powers (Vose), an entry is kept with aliasProb, otherwise its alias is used
+//
+void gltfr::LightSampler::buildAliasTable(const std::vector<float>& powers)
+{
+  m_powers = powers;
+
+  const uint32_t numEntries = static_cast<uint32_t>(powers.size());
+  const double   totalPower = std::accumulate(powers.begin(), powers.end(), 0.0);
+
+  m_entries.assign(numEntries, DH::LightEntry{.aliasProb = 1.0F, .renderNode = -1});
+  for(uint32_t i = 0; i < m_numPunctual; i++)
+    m_entries[i].index = i;
+  for(const EmissiveNode& node : m_emissiveNodes)
+  {
+    for(uint32_t t = 0; t < node.numTriangles; t++)
+    {
+      m_entries[node.firstEntry + t].renderNode = static_cast<int>(node.renderNode);
+      m_entries[node.firstEntry + t].index      = t;
+    }
+  }
+  for(uint32_t i = 0; i < numEntries; i++)
+    m_entries[i].alias = i;
+
+  // Nothing emits, but the entries are still looked up by the hits of the emissive triangles
+  m_info = DH::LightSamplingInfo{.numEntries = totalPower > 0.0 ? numEntries : 0U,
+                                 .numPunctual = m_numPunctual,
+                                 .totalPower  = static_cast<float>(totalPower)};
+  if(totalPower <= 0.0)
+    return;
+
+  std::vector<double>   scaled(numEntries);
+  std::vector<uint32_t> small;
+  std::vector<uint32_t> large;
+  for(uint32_t i = 0; i < numEntries; i++)
+  {
+    m_entries[i].selectPdf = static_cast<float>(powers[i] / totalPower);
+    scaled[i]              = powers[i] * numEntries / totalPower;
+    (scaled[i] < 1.0 ? small : large).push_back(i);
+  }
+  while(!small.empty() && !large.empty())
+  {
+    const uint32_t s = small.back();
+    const uint32_t l = large.back();
+    small.pop_back();
+    m_entries[s].aliasProb = static_cast<float>(scaled[s]);
+    m_entries[s].alias     = l;
+    scaled[l]              = (scaled[l] + scaled[s]) - 1.0;
+    if(scaled[l] < 1.0)
+    {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // The remaining ones are at 1, up to the rounding
+}
+
+//--------------------------------------------------------------------------------------------------
+// Buffers of the current table, the previous ones are retired
+//
+void gltfr::LightSampler::createBuffers(Resources& res, uint32_t numRenderNodes)
+{
+  res.retire(m_lights);
+  res.retire(m_nodes);
+
+  // At least one entry and one node: the buffers are always bound
+  std::vector<uint8_t> lights(sizeof(DH::LightSamplingInfo) + std::max<size_t>(m_entries.size(), 1) * sizeof(DH::LightEntry), 0);
+  std::memcpy(lights.data(), &m_info, sizeof(DH::LightSamplingInfo));
+  std::memcpy(lights.data() + sizeof(DH::LightSamplingInfo), m_entries.data(), m_entries.size() * sizeof(DH::LightEntry));
+
+  std::vector<uint32_t> nodes(std::max(numRenderNodes, 1U), LIGHT_ENTRY_NONE);
+  for(const EmissiveNode& node : m_emissiveNodes)
+    nodes[node.renderNode] = node.firstEntry;
+
+  constexpr VkBufferUsageFlags kUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  VkCommandBuffer              cmd    = res.createTempCmdBuffer();
+  m_lights                            = m_alloc->createBuffer(cmd, lights, kUsage);
+  m_nodes                             = m_alloc->createBuffer(cmd, nodes, kUsage);
+  res.submitAndWaitTempCmdBuffer(cmd);
+  m_alloc->finalizeAndReleaseStaging();
+
+  nvvk::DebugUtil(res.ctx.device).DBG_NAME(m_lights.buffer);
+  nvvk::DebugUtil(res.ctx.device).DBG_NAME(m_nodes.buffer);
+}
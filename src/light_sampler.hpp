@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Light sampling of the path tracer
+
+  All punctual lights of the scene and the triangles of the emissive render
+  nodes are entries of an alias table (Vose), built on the host from their
+  power: a light is picked in constant time, with a probability proportional
+  to its power (see sampleLights() in rt_common.h).
+
+  - Buffer eLightSampling: LightSamplingInfo, then the entries.
+  - Buffer eEmissiveNodes: per render node, the first entry of its triangles
+    or LIGHT_ENTRY_NONE; the BSDF hits use it for the MIS with the light.
+
+  The geometry of the emissive triangles is read once, a change of the
+  powers (intensity, emission, visibility) only uploads the table again.
+  The buffers are re-created when the emissive render nodes are not the same.
+
+*/
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// nvpro-core
+#include "nvh/gltfscene.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "resources.hpp"
+#include "upload_ring.hpp"
+
+#include "nvvkhl/shaders/dh_lighting.h"
+namespace DH {
+#include "shaders/device_host.h"
+}  // namespace DH
+
+namespace gltfr {
+
+class LightSampler
+{
+public:
+  ~LightSampler() { deinit(); }
+
+  // Table of the scene, the previous buffers are retired
+  void build(Resources& res, const nvh::gltf::Scene& scene);
+  void deinit();
+
+  // Lights, materials or visibility changed: returns true if the buffers were re-created,
+  // otherwise the new table, if any, is copied with the upload ring
+  bool update(Resources& res, const nvh::gltf::Scene& scene, UploadRing& uploadRing);
+
+  // Probability of sampling the lights instead of the environment, of irradiance 'envIrradiance'
+  float lightsWeight(float envIrradiance) const;
+
+  VkDescriptorBufferInfo getLightsBufferInfo() const { return {m_lights.buffer, 0, VK_WHOLE_SIZE}; }
+  VkDescriptorBufferInfo getNodesBufferInfo() const { return {m_nodes.buffer, 0, VK_WHOLE_SIZE}; }
+
+  uint32_t numEntries() const { return static_cast<uint32_t>(m_entries.size()); }
+
+private:
+  struct EmissiveNode
+  {
+    uint32_t renderNode;
+    uint32_t firstEntry;
+    uint32_t numTriangles;
+  };
+
+  std::vector<uint32_t> findEmissiveNodes(const nvh::gltf::Scene& scene) const;
+  void                  computePowers(const nvh::gltf::Scene& scene, std::vector<float>& powers) const;
+  void                  buildAliasTable(const std::vector<float>& powers);
+  void                  createBuffers(Resources& res, uint32_t numRenderNodes);
+
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+
+  float                        m_sceneRadius{1.0F};
+  uint32_t                     m_numPunctual{0};
+  std::vector<EmissiveNode>    m_emissiveNodes;
+  std::vector<float>           m_triangleAreas;  // World space, of all emissive triangles
+  std::vector<float>           m_powers;         // Of the current table
+  std::vector<DH::LightEntry>  m_entries;
+  DH::LightSamplingInfo        m_info{};
+
+  nvvk::Buffer m_lights;  // LightSamplingInfo, then the entries
+  nvvk::Buffer m_nodes;   // First entry of each render node
+};
+
+}  // namespace gltfr
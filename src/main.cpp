@@ -17,8 +17,18 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <sstream>
 #include <thread>
 
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
 #if defined(WIN32)
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -30,8 +40,8 @@
 #include "imgui/imgui_helper.h"
 
 // NV Vulkan headers
+#include "nvh/timesampler.hpp"
 #include "nvvk/extensions_vk.hpp"
-#include "nvvk/raypicker_vk.hpp"
 #include "nvvkhl/element_camera.hpp"
 #include "nvvkhl/element_dbgprintf.hpp"
 #include "nvvkhl/element_logger.hpp"
@@ -40,10 +50,16 @@
 #include "nvvkhl/tonemap_postprocess.hpp"
 
 // Application specific headers
+#include "batch_jobs.hpp"
+#include "benchmark.hpp"
 #include "busy_window.hpp"
+#include "dynamic_resolution.hpp"
+#include "image_readback.hpp"
 #include "renderer.hpp"
 #include "scene.hpp"
+#include "screen_picker.hpp"
 #include "settings.hpp"
+#include "telemetry.hpp"
 #include "utilities.hpp"
 #include "vk_context.hpp"
 #include "stb_image.h"
@@ -82,11 +98,32 @@ std::vector<std::string>                  g_applicationSearchPaths;  // Search p
 std::string g_inFilename;
 std::string g_outImageFilename;
 std::string g_inHdr;
+std::string g_batchFilename;     // Manifest of the batch rendering (headless)
+uint32_t    g_batchFrames = 1;   // Frames of the jobs without samples
+std::string g_benchmarkFilename;                   // Scenes of the benchmark (headless)
+std::string g_benchmarkOutput = "benchmark.json";  // Report of the benchmark
+uint32_t    g_benchmarkWarmup = 16;                // Frames of each configuration before the measured ones
+uint32_t    g_benchmarkFrames = 128;               // Measured frames of each configuration
+std::string g_telemetryFilename;                   // Per-frame telemetry, JSON lines
+std::string g_mergeFilenames;    // Accumulations of the shares to merge, separated by ';'
+int         g_forceGPU = -1;     // Index of the physical device, -1 for the first discrete GPU
 
 namespace PE = ImGuiH::PropertyEditor;
 
 namespace gltfr {
 bool g_forceExternalShaders = false;
+bool g_useBlasCache         = true;  // Compacted BLAS are cached on disk
+bool g_parallelObj          = true;  // Multithreaded OBJ loader
+int  g_textureBudgetMB      = 1024;  // GPU memory for the streamed textures, 0: no streaming
+bool g_compressTextures     = false;  // PNG/JPEG textures compressed to BC7, cached on disk
+bool g_gpuAnimation         = false;  // Skinning and morph targets evaluated by a compute shader
+bool g_meshlets             = true;   // Meshlets of the primitives, for the mesh shader raster
+bool g_compactVertices      = false;  // Quantized vertices of the rigid primitives (CompactVertices)
+bool g_dedupGeometry        = true;   // Identical primitives share their render primitive and BLAS
+bool g_specializeShaders    = true;   // Path tracer pipelines without the material and light features absent from the scene
+bool g_dynamicResolution    = false;  // Lower internal resolution while the camera moves or the scene is edited
+bool g_asyncCompute         = false;  // Post-processing of the path tracer on the compute queue, see FrameGraph
+bool g_opacityMicromaps     = true;   // Alpha textures baked in opacity micromaps, when the device supports them
 
 extern PathtraceSettings g_pathtraceSettings;
 
@@ -109,16 +146,20 @@ public:
     ctx.GCT0           = {app->getQueue(0).queue, app->getQueue(0).familyIndex};  // See creation of queues in main()
     ctx.compute        = {app->getQueue(1).queue, app->getQueue(1).familyIndex};
     ctx.transfer       = {app->getQueue(2).queue, app->getQueue(2).familyIndex};
+    ctx.asyncCompute   = {app->getQueue(3).queue, app->getQueue(3).familyIndex};
+    ctx.framesInFlight = app->getFrameCycleSize();
 
     m_resources.init(ctx);
     m_scene.init(m_resources);
+    m_readback.init(m_resources);
+    m_dynamicResolution.enabled = g_dynamicResolution;
+    m_resources.m_frameGraph.setAsyncCompute(g_asyncCompute);
 
-    nvvk::ResourceAllocator* alloc         = m_resources.m_allocator.get();
-    uint32_t                 c_queue_index = ctx.compute.familyIndex;
+    nvvk::ResourceAllocator* alloc = m_resources.m_allocator.get();
 
     m_tonemapper.init(ctx.device, alloc);
 
-    m_picker = std::make_unique<nvvk::RayPickerKHR>(ctx.device, ctx.physicalDevice, alloc, c_queue_index);  // RTX Picking utility
+    m_picker.init(m_resources);  // RTX Picking utility
 
     m_emptyRenderer = makeRendererEmpty();
     m_tonemapper.createComputePipeline();
@@ -130,7 +171,7 @@ public:
       m_settings.envSystem    = Settings::eHdr;
       m_settings.maxLuminance = m_scene.m_hdrEnv->getIntegral();
     }
-    if(!g_inFilename.empty())
+    if(!g_inFilename.empty() && g_batchFilename.empty())
     {
       if(m_app->isHeadless())
       {
@@ -147,13 +188,19 @@ public:
   //--------------------------------------------------------------------------------------------------
   void onDetach() override
   {
+    // The loader uses the scene and its allocator until it returns
+    m_scene.cancelStagedLoad();
+    joinWorker();
     vkDeviceWaitIdle(m_resources.ctx.device);
+    m_readback.deinit();
+    m_resources.releaseRetired();
     m_scene.deinit(m_resources);
     m_emptyRenderer->deinit(m_resources);
     if(m_renderer != nullptr)
       m_renderer->deinit(m_resources);
     m_renderer.reset();
-    m_picker->destroy();
+    m_picker.deinit();
+    m_resources.deinit();
   }
 
   //--------------------------------------------------------------------------------------------------
@@ -162,38 +209,125 @@ public:
   //--------------------------------------------------------------------------------------------------
   void onRender(VkCommandBuffer cmd) override
   {
-    if(m_busy.isBusy())
-      return;
+    {
+      Telemetry::PhaseTimer phase(Telemetry::ePhaseBegin);
+
+      // The post-processing of the previous frame is submitted, the images it wrote are waited for
+      m_resources.m_frameGraph.beginFrame(cmd, m_app);
+      if(m_busy.isBlocking())
+      {
+        m_resources.m_frameGraph.endFrame();
+        return;
+      }
+
+      // The frame of this command buffer was waited for, the objects retired before are released
+      // Not while a blocking job runs, it can use the same allocators
+      m_resources.beginFrame();
+      m_readback.update();
+      recordSaves(cmd);
+    }
+
     if(m_busy.isDone())
     {
       // Post busy work
       m_busy.consumeDone();
     }
 
+    {
+      // Swap in the scene being loaded, or bind its textures when they are streamed
+      Telemetry::PhaseTimer phase(Telemetry::ePhaseStreaming);
+      m_scene.updateStagedLoad(m_resources);
+      m_scene.updateTextureStreaming(m_resources);
+    }
+
+    {
+      // The picks of the previous frames, the result of the oldest one
+      Telemetry::PhaseTimer phase(Telemetry::ePhasePicking);
+      m_picker.cmdPick(cmd);
+    }
+
+    renderFrame(cmd);
+    m_resources.m_frameGraph.endFrame();
+    endTelemetryFrame();
+  }
+
+  //--------------------------------------------------------------------------------------------------
+  // The line of the frame, with the memory of each category
+  //
+  void endTelemetryFrame()
+  {
+    Telemetry& telemetry = Telemetry::getInstance();
+    if(telemetry.isEnabled())
+      m_resources.m_memory.publish(telemetry);
+    telemetry.endFrame(*g_elemProfiler);
+  }
+
+  //--------------------------------------------------------------------------------------------------
+  // The changes since the last frame, the renderer and the tonemapper
+  //
+  void renderFrame(VkCommandBuffer cmd)
+  {
     // Handle changes that have happened since last frame
-    handleChanges(cmd);
+    {
+      Telemetry::PhaseTimer phase(Telemetry::ePhaseChanges);
+      handleChanges();
+    }
 
     if(m_renderer && m_scene.isValid())
     {
       // Animate, update Vulkan buffers: scene, frame, acceleration structures
       // It could stop rendering if the scene is not ready or reached max frames
-      if(m_scene.processFrame(cmd, m_settings))
+      bool rendered = false;
+      {
+        Telemetry::PhaseTimer phase(Telemetry::ePhaseScene);
+        rendered = m_scene.processFrame(cmd, m_resources, m_settings);
+      }
+      if(rendered)
       {
+        Telemetry::PhaseTimer phase(Telemetry::ePhaseRender);
         m_renderer->render(cmd, m_resources, m_scene, m_settings, *g_elemProfiler.get());
+        if(m_settings.renderSystem == Settings::ePathtracer)
+        {
+          const VkExtent2D size = m_resources.getRenderSize();
+          Telemetry::getInstance().add(Telemetry::eSamples, uint64_t(size.width) * size.height
+                                                                * std::max(g_pathtraceSettings.maxSamples, 1));
+        }
       }
+      updateRenderScale(rendered && m_scene.m_sceneFrameInfo.frameCount == 0);
     }
     else
     {
+      Telemetry::PhaseTimer phase(Telemetry::ePhaseRender);
       m_emptyRenderer->render(cmd, m_resources, m_scene, m_settings, *g_elemProfiler.get());
     }
 
+    Telemetry::PhaseTimer postPhase(Telemetry::ePhasePost);
+
 
     // Apply tone mapper to the final image
-    {
-      auto sec = g_elemProfiler->timeRecurring("Tonemapper", cmd);
-      setTonemapperInputOutput();
-      m_tonemapper.runCompute(cmd, m_resources.m_finalImage->getSize());
-    }
+    // On the async compute queue when the result of the renderer is in the frame graph
+    setTonemapperInputOutput();
+    const VkImage result = (m_renderer != nullptr && m_scene.isValid()) ? m_renderer->getResultImage() : VK_NULL_HANDLE;
+    std::vector<FrameGraph::ImageUse> uses{FrameGraph::computeWrite(m_resources.m_finalImage->getColorImage())};
+    if(result != VK_NULL_HANDLE)
+      uses.push_back(FrameGraph::computeRead(result));
+    m_resources.m_frameGraph.addPass("Tonemapper", result != VK_NULL_HANDLE ? FrameGraph::eAsyncCompute : FrameGraph::eGraphics,
+                                     uses, [&](VkCommandBuffer passCmd) {
+                                       // The profiler only times the command buffer of the frame
+                                       std::optional<nvvk::ProfilerVK::Section> sec;
+                                       if(passCmd == cmd)
+                                         sec.emplace(*g_elemProfiler, "Tonemapper", passCmd);
+                                       m_tonemapper.runCompute(passCmd, m_resources.m_finalImage->getSize());
+                                     });
+  }
+
+  //--------------------------------------------------------------------------------------------------
+  // Internal resolution of the next frames, from the GPU time of the renderer and the tonemapper
+  // The new G-Buffers are created by handleChanges()
+  void updateRenderScale(bool interacting)
+  {
+    const char* section = (m_settings.renderSystem == Settings::ePathtracer) ? "Raytrace" : "Raster";
+    m_resources.setRenderScale(m_dynamicResolution.update(*g_elemProfiler, {section, "Tonemapper"}, interacting));
   }
 
   //--------------------------------------------------------------------------------------------------
@@ -237,6 +371,15 @@ public:
         ImGuiH::CameraWidget();
       }
       m_settings.onUI();
+      if(headerManager.beginHeader("Performance"))
+      {
+        PE::begin();
+        m_dynamicResolution.onUI();
+        if(PE::Checkbox("Async Post-Processing", &g_asyncCompute,
+                        "Denoiser, silhouette and tonemapper of the path tracer on the compute queue, overlapping the next frame"))
+          m_resources.m_frameGraph.setAsyncCompute(g_asyncCompute);
+        PE::end();
+      }
       if(headerManager.beginHeader("Tonemapper"))
       {
         m_tonemapper.onUI();
@@ -244,6 +387,8 @@ public:
 
       if(!m_busy.isBusy())
         m_scene.onUI(m_resources, m_settings, m_app->getWindowHandle());
+      if(const std::string hdr = m_scene.takeRequestedHdr(); !hdr.empty())
+        onFileDrop(hdr.c_str());
     }
     ImGui::End();  // Settings
 
@@ -258,7 +403,17 @@ public:
       if((ImGui::IsWindowHovered(ImGuiFocusedFlags_RootWindow) && (m_mouseClickState.isMouseClicked(ImGuiMouseButton_Left)))
          || ImGui::IsKeyPressed(ImGuiKey_Space))
       {
-        screenPicking();
+        screenPicking(false);
+      }
+      else if(m_settings.showHoverInfo && ImGui::IsWindowHovered(ImGuiFocusedFlags_RootWindow) && !ImGui::IsAnyMouseDown())
+      {
+        screenPicking(true);
+        if(!m_hoverInfo.empty())
+          ImGui::SetTooltip("%s", m_hoverInfo.c_str());
+      }
+      else
+      {
+        m_hoverInfo.clear();
       }
 
       // Display the G-Buffer image
@@ -281,7 +436,11 @@ public:
     }
 
     if(m_busy.isBusy())
+    {
+      if(!m_busy.isBlocking())
+        m_busy.setProgress(m_scene.loadProgress(), m_scene.loadStageName());
       m_busy.show();
+    }
   }
 
   //--------------------------------------------------------------------------------------------------
@@ -293,7 +452,7 @@ public:
 
     auto getSaveImage = [&]() {
       std::string filename =
-          NVPSystem::windowSaveFileDialog(m_app->getWindowHandle(), "Save Image", "PNG(.png),JPG(.jpg)|*.png;*.jpg");
+          NVPSystem::windowSaveFileDialog(m_app->getWindowHandle(), "Save Image", "PNG(.png),JPG(.jpg),EXR(.exr)|*.png;*.jpg;*.exr");
       if(!filename.empty())
       {
         std::filesystem::path ext = std::filesystem::path(filename).extension();
@@ -353,14 +512,14 @@ public:
       bool mikktspace = ImGui::MenuItem("Recreate Tangents - MikkTSpace");
       ImGui::SetItemTooltip("This fixes NULL tangents");
 
-      if(recreate || mikktspace)
+      if((recreate || mikktspace) && !m_busy.isBusy() && !m_scene.isLoading())
       {
         vkDeviceWaitIdle(m_resources.ctx.device);
         m_busy.start("Recreate Tangents");
-        std::thread([&, mikktspace]() {
+        startWorker([&, mikktspace]() {
           m_scene.recreateTangents(mikktspace);
           m_busy.stop();
-        }).detach();
+        });
       }
 
       ImGui::EndMenu();
@@ -441,41 +600,403 @@ public:
 #endif  // !NDEBUG
   }
 
-  void saveRenderedImage(const std::string& filename)
+  //--------------------------------------------------------------------------------------------------
+  // The image is copied at the beginning of the next frame, and written by the readback workers
+  //
+  void saveRenderedImage(const std::string& filename) { m_pendingSaves.push_back(filename); }
+
+  // EXR and HDR files are the linear color of the renderer, the others the tonemapped image
+  void recordSaves(VkCommandBuffer cmd)
   {
-    m_app->saveImageToFile(m_resources.m_finalImage->getColorImage(), m_resources.m_finalImage->getSize(), filename);
+    for(const std::string& filename : m_pendingSaves)
+    {
+      const std::string extension = std::filesystem::path(filename).extension().string();
+      const bool        radiance  = (extension == ".exr" || extension == ".hdr") && m_renderer && m_scene.isValid()
+                            && m_renderer->getRadianceImage() != VK_NULL_HANDLE;
+      if(radiance)
+      {
+        // Samples per pixel of the accumulation, the weight of the share when merged (--merge)
+        const uint32_t samples =
+            uint32_t(m_scene.m_sceneFrameInfo.frameCount + 1) * uint32_t(std::max(g_pathtraceSettings.maxSamples, 1));
+        m_readback.cmdSave(cmd, m_renderer->getRadianceImage(), VK_FORMAT_R32G32B32A32_SFLOAT, m_renderer->getRadianceSize(),
+                           filename, samples);
+      }
+      else
+        m_readback.cmdSave(cmd, m_resources.m_finalImage->getColorImage(), VK_FORMAT_R8G8B8A8_UNORM,
+                           m_resources.m_finalImage->getSize(), filename);
+    }
+    m_pendingSaves.clear();
+  }
+
+  // Outside of the frames: the images are copied now, and written before returning
+  void flushSaves()
+  {
+    if(!m_pendingSaves.empty())
+    {
+      VkCommandBuffer cmd = m_app->createTempCmdBuffer();
+      m_resources.m_frameGraph.beginFrame(cmd, nullptr);  // Waits for the async post-processing
+      recordSaves(cmd);
+      m_resources.m_frameGraph.endFrame();
+      m_app->submitAndWaitTempCmdBuffer(cmd);
+    }
+    m_readback.flush();
   }
 
   void onLastHeadlessFrame() override
   {
+    if(!g_benchmarkFilename.empty())
+    {
+      runBenchmark();
+      return;
+    }
+    if(!g_batchFilename.empty())
+    {
+      runBatch();
+      return;
+    }
     std::filesystem::path filename(m_scene.getFilename());
     saveRenderedImage(g_outImageFilename.empty() ? filename.replace_extension(".jpg").string() : g_outImageFilename);
+    flushSaves();
   }
 
   //--------------------------------------------------------------------------------------------------
-  // Handle the file drop event: glTF, HDR, OBJ
+  // Batch rendering (--batch), after the headless frames
+  // The jobs of a scene are rendered in a row, while the next scene is loaded by a separate thread.
+  // The device, the pipeline cache and the environment are kept from one job to the next.
   //
-  void onFileDrop(const char* filename) override
+  void runBatch()
   {
-    if(m_busy.isBusy())
+    BatchJobs batch;
+    if(!batch.load(g_batchFilename))
       return;
-    m_busy.start("Loading");
-    vkDeviceWaitIdle(m_resources.ctx.device);
 
-    // Loading file in a separate thread
-    std::string loadFile = filename;
-    std::thread([&, loadFile]() {
-      m_scene.load(m_resources, loadFile);
-      m_busy.stop();
-    }).detach();
+    const std::vector<BatchScene>& scenes = batch.scenes();
+    std::thread                    loader;
+    std::atomic<int>               loadResult{0};  // 0: loading, 1: loaded, -1: failed
+    auto                           startLoad = [&](size_t index) {
+      loadResult = 0;
+      loader     = std::thread([&, filename = scenes[index].filename]() {
+        loadResult = m_scene.loadStaged(m_resources, filename) ? 1 : -1;
+      });
+    };
+
+    nvh::Stopwatch batchTime;
+    size_t         numRendered = 0;
+    startLoad(0);
+    for(size_t s = 0; s < scenes.size(); s++)
+    {
+      // Swap in the scene and bind its textures, the previous one renders meanwhile
+      while(loadResult == 0 || m_scene.isLoading())
+      {
+        renderBatchFrame(true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      loader.join();
+      if(loadResult < 0)
+      {
+        LOGE("Batch: cannot load %s, skipping its %zu jobs\n", scenes[s].filename.c_str(), scenes[s].jobs.size());
+        if(s + 1 < scenes.size())
+          startLoad(s + 1);
+        continue;
+      }
 
-    // Visualize the HDR if it is a HDR file
-    std::filesystem::path ext = std::filesystem::path(filename).extension();
-    if(ext == ".hdr")
+      const nvh::CameraManipulator::Camera sceneCamera = CameraManip.getCamera();
+      const std::vector<BatchJob>&         jobs        = scenes[s].jobs;
+      bool                                 preloading  = false;
+      for(auto job = jobs.begin(); job != jobs.end(); ++job)
+      {
+        const int frames = setupBatchJob(*job, sceneCamera);
+
+        // The next scene loads beside the remaining jobs, once none of them loads an HDR: the
+        // loader and the HDR creation would both use the allocators
+        const bool loadsHdr = std::any_of(job + 1, jobs.end(), [&](const BatchJob& j) {
+          return !j.environment.empty() && j.environment != "sky" && j.environment != m_batchHdr;
+        });
+        if(!preloading && !loadsHdr && s + 1 < scenes.size())
+        {
+          startLoad(s + 1);
+          preloading = true;
+        }
+
+        // All the frames of the accumulation, or until the adaptive sampling converged
+        nvh::Stopwatch jobTime;
+        do
+        {
+          renderBatchFrame(false);
+        } while(m_scene.m_sceneFrameInfo.frameCount < frames - 1 && !(m_renderer && m_renderer->isConverged(m_scene)));
+
+        saveRenderedImage(job->output);
+        numRendered++;
+        LOGI("Batch: %s, %d frames in %.2f s\n", job->output.c_str(), m_scene.m_sceneFrameInfo.frameCount + 1,
+             jobTime.elapsed() / 1000.0);
+      }
+      if(!preloading && s + 1 < scenes.size())
+        startLoad(s + 1);
+    }
+    flushSaves();
+    LOGI("Batch: %zu of %zu jobs rendered in %.2f s\n", numRendered, batch.numJobs(), batchTime.elapsed() / 1000.0);
+  }
+
+  //--------------------------------------------------------------------------------------------------
+  // Benchmark (--benchmark), after the headless frame
+  // Each scene is loaded on this thread, for the timings of the load, then rendered with each
+  // renderer and render mode. The frames are submitted and waited for one by one, as the batch.
+  //
+  void runBenchmark()
+  {
+    struct Configuration
     {
+      Settings::RenderSystem renderer;
+      RenderMode             mode;
+      const char*            modeName;
+    };
+    static constexpr Configuration kConfigurations[] = {
+        {Settings::ePathtracer, RenderMode::eRTX, "RTX"},
+        {Settings::ePathtracer, RenderMode::eIndirect, "Indirect"},
+        {Settings::ePathtracer, RenderMode::eWavefront, "Wavefront"},
+        {Settings::eRaster, RenderMode::eIndirect, ""},
+    };
+
+    const std::vector<std::string> scenes = BenchmarkReport::readSceneList(g_benchmarkFilename);
+    if(scenes.empty())
+      return;
+
+    // The profiler has the results of a frame a few frames later: the warm-up covers them
+    const uint32_t warmup = std::max(g_benchmarkWarmup, 8U);
+    const uint32_t frames = std::max(g_benchmarkFrames, 1U);
+
+    BenchmarkReport report;
+    report.setDevice(m_resources.ctx.physicalDevice, m_resources.m_finalImage->getSize());
+    report.setSettings({{"warmupFrames", warmup},
+                        {"measuredFrames", frames},
+                        {"maxSamples", g_pathtraceSettings.maxSamples},
+                        {"maxDepth", g_pathtraceSettings.maxDepth},
+                        {"adaptiveThreshold", g_pathtraceSettings.adaptiveThreshold},
+                        {"temporal", g_pathtraceSettings.temporal ? 1.0 : 0.0}});
+
+    for(const std::string& filename : scenes)
+    {
+      BenchmarkScene& entry = report.addScene(filename);
+      LOGI("Benchmark: %s\n", filename.c_str());
+      nvh::Stopwatch loadTime;
+      if(!m_scene.load(m_resources, filename))
+      {
+        LOGE("Benchmark: cannot load %s\n", filename.c_str());
+        continue;
+      }
+      renderBatchFrame(false);  // The renderer of the new scene
+      entry.loaded      = true;
+      entry.loadTime    = loadTime.elapsed();
+      entry.accelCached = m_scene.loadTimings().accelCached;
+      entry.loadStages  = {{"parse", m_scene.loadTimings().parse},
+                           {"geometry", m_scene.loadTimings().geometry},
+                           {"accel", m_scene.loadTimings().accel},
+                           {"textures", m_scene.loadTimings().textures}};
+
+      const std::vector<nvh::CameraManipulator::Camera> views = benchmarkViews();
+      entry.views                                             = uint32_t(views.size());
+      for(const Configuration& config : kConfigurations)
+      {
+        if(m_settings.renderSystem != config.renderer || !m_renderer)
+        {
+          m_settings.renderSystem = config.renderer;
+          createRenderers();
+        }
+        g_pathtraceSettings.renderMode = config.mode;  // The pipeline is created by handleChange
+        if(!m_renderer)
+          continue;
+
+        BenchmarkRun run{.renderer = Settings::rendererNames[config.renderer], .mode = config.modeName};
+        m_settings.maxFrames = std::numeric_limits<int>::max();  // Accumulating through all the frames of a view
+        CameraManip.setCamera(views[0], true);
+        m_scene.resetFrameCount();
+        for(uint32_t i = 0; i < warmup; i++)
+          renderBatchFrame(false);
+
+        // The views share the measured frames, the accumulation restarts at each of them
+        size_t         view = 0;
+        nvh::Stopwatch runTime;
+        for(uint32_t i = 0; i < frames; i++)
+        {
+          const size_t frameView = size_t(i) * views.size() / frames;
+          if(frameView != view)
+          {
+            view = frameView;
+            CameraManip.setCamera(views[view], true);
+          }
+          renderBatchFrame(false);
+          run.addFrame(*g_elemProfiler, BenchmarkReport::deviceMemoryUsage(m_resources.ctx.physicalDevice));
+        }
+        run.time = runTime.elapsed();
+        if(config.renderer == Settings::ePathtracer)
+        {
+          const VkExtent2D size = m_resources.m_finalImage->getSize();
+          run.samplesPerFrame   = double(size.width) * size.height * std::max(g_pathtraceSettings.maxSamples, 1);
+        }
+        LOGI("Benchmark: %s %s, %.3f ms per frame\n", run.renderer.c_str(), run.mode.c_str(), run.time / run.frames);
+        entry.runs.push_back(std::move(run));
+      }
+    }
+    report.write(g_benchmarkOutput);
+  }
+
+  //--------------------------------------------------------------------------------------------------
+  // Views of the benchmark: the cameras of the scene, or an orbit around the point of interest
+  //
+  std::vector<nvh::CameraManipulator::Camera> benchmarkViews() const
+  {
+    constexpr int                               kOrbitViews = 4;
+    const nvh::CameraManipulator::Camera        current     = CameraManip.getCamera();
+    std::vector<nvh::CameraManipulator::Camera> views;
+    for(const nvh::gltf::RenderCamera& camera : m_scene.m_gltfScene->getRenderCameras())
+    {
+      nvh::CameraManipulator::Camera view = current;
+      view.eye                            = camera.eye;
+      view.ctr                            = camera.center;
+      view.up                             = camera.up;
+      view.fov                            = glm::degrees(float(camera.yfov));
+      views.push_back(view);
+    }
+    if(views.empty())
+    {
+      for(int i = 0; i < kOrbitViews; i++)
+      {
+        const glm::mat4 rotation = glm::rotate(glm::mat4(1.0F), glm::two_pi<float>() * float(i) / kOrbitViews, current.up);
+        nvh::CameraManipulator::Camera view     = current;
+        view.eye = current.ctr + glm::vec3(rotation * glm::vec4(current.eye - current.ctr, 0.0F));
+        views.push_back(view);
+      }
+    }
+    return views;
+  }
+
+  //--------------------------------------------------------------------------------------------------
+  // Environment, variant, camera and accumulation of a batch job, returns the number of frames
+  //
+  int setupBatchJob(const BatchJob& job, const nvh::CameraManipulator::Camera& sceneCamera)
+  {
+    if(job.environment == "sky")
+    {
+      m_settings.envSystem = Settings::eSky;
+    }
+    else if(!job.environment.empty())
+    {
+      if(job.environment != m_batchHdr)
+      {
+        m_scene.load(m_resources, job.environment);
+        m_batchHdr = job.environment;
+      }
       m_settings.envSystem    = Settings::eHdr;
       m_settings.maxLuminance = m_scene.m_hdrEnv->getIntegral();
     }
+
+    // By name or index, the first variant otherwise
+    const std::vector<std::string>& variants = m_scene.m_gltfScene->getVariants();
+    int                             variant  = int(std::find(variants.begin(), variants.end(), job.variant) - variants.begin());
+    if(job.variant.empty())
+      variant = 0;
+    else if(variant == int(variants.size()) && std::sscanf(job.variant.c_str(), "%d", &variant) != 1)
+      LOGW("Batch: line %d, no variant %s\n", job.line, job.variant.c_str());
+    m_scene.selectVariant(variant);
+
+    nvh::CameraManipulator::Camera              camera  = sceneCamera;
+    const std::vector<nvh::gltf::RenderCamera>& cameras = m_scene.m_gltfScene->getRenderCameras();
+    if(job.camera >= 0 && job.camera < int(cameras.size()))
+    {
+      camera.eye = cameras[job.camera].eye;
+      camera.ctr = cameras[job.camera].center;
+      camera.up  = cameras[job.camera].up;
+      camera.fov = glm::degrees(float(cameras[job.camera].yfov));
+    }
+    else if(job.camera >= 0)
+    {
+      LOGW("Batch: line %d, the scene has %zu cameras\n", job.line, cameras.size());
+    }
+    else if(job.hasLookat)
+    {
+      camera.eye = job.eye;
+      camera.ctr = job.center;
+      camera.up  = job.up;
+    }
+    if(job.fov > 0.0F)
+      camera.fov = job.fov;
+    CameraManip.setCamera(camera, true);
+
+    // A new accumulation, which is not reprojected from the previous job
+    const int samplesPerFrame = std::max(g_pathtraceSettings.maxSamples, 1);
+    const int frames          = job.samples > 0 ? (job.samples + samplesPerFrame - 1) / samplesPerFrame : int(g_batchFrames);
+    m_settings.maxFrames      = frames - 1;
+    m_scene.resetFrameCount();
+    return frames;
+  }
+
+  //--------------------------------------------------------------------------------------------------
+  // One frame of the batch, submitted and waited for
+  // The pending scene is only swapped in with 'swapScene', between the jobs of two scenes.
+  //
+  void renderBatchFrame(bool swapScene)
+  {
+    // As the profiler element does at each frame of the application
+    g_elemProfiler->endFrame();
+    g_elemProfiler->beginFrame();
+
+    VkCommandBuffer cmd = m_app->createTempCmdBuffer();
+    m_resources.m_frameGraph.beginFrame(cmd, nullptr);  // Everything on this command buffer
+    m_resources.beginFrame();
+    m_readback.update();
+    recordSaves(cmd);  // The image of the previous job
+    if(swapScene)
+      m_scene.updateStagedLoad(m_resources);
+    m_scene.updateTextureStreaming(m_resources);
+    renderFrame(cmd);
+    m_resources.m_frameGraph.endFrame();
+    m_app->submitAndWaitTempCmdBuffer(cmd);
+    endTelemetryFrame();
+  }
+
+  //--------------------------------------------------------------------------------------------------
+  // Handle the file drop event: glTF, HDR, OBJ
+  //
+  void onFileDrop(const char* filename) override
+  {
+    if(m_busy.isBusy() || m_scene.isLoading())
+      return;
+
+    std::string           loadFile = filename;
+    std::filesystem::path ext      = std::filesystem::path(filename).extension();
+    if(ext != ".hdr")
+    {
+      // Staged loading in a separate thread, the current scene continues to render
+      m_busy.start("Loading", false);
+      startWorker([&, loadFile]() {
+        m_scene.loadStaged(m_resources, loadFile);
+        m_busy.stop();
+      });
+      return;
+    }
+
+    // Prepared in a separate thread, the current environment renders until the new one is swapped
+    // in by the main thread (updateStagedLoad), which then visualizes it (handleChanges)
+    m_busy.start("Loading", false);
+    startWorker([&, loadFile]() {
+      m_scene.createHdr(m_resources, loadFile);
+      m_busy.stop();
+    });
+  }
+
+  //--------------------------------------------------------------------------------------------------
+  // Loading and the other work of m_busy run on one thread at a time, joined before the next one
+  // starts (the previous one is done, m_busy was checked) and at shutdown
+  //
+  void startWorker(std::function<void()> work)
+  {
+    joinWorker();
+    m_worker = std::thread(std::move(work));
+  }
+  void joinWorker()
+  {
+    if(m_worker.joinable())
+      m_worker.join();
   }
 
   //--------------------------------------------------------------------------------------------------
@@ -493,6 +1014,8 @@ public:
       std::string           text =
           fmt::format("{} - {}x{} | {:.0f} FPS / {:.3f}ms | Frame {}", p.filename().string(), size.width, size.height,
                       ImGui::GetIO().Framerate, 1000.F / ImGui::GetIO().Framerate, m_scene.m_sceneFrameInfo.frameCount);
+      if(m_renderer && m_scene.isValid() && m_renderer->isConverged(m_scene))
+        text += " (converged)";
 
       glfwSetWindowTitle(m_app->getWindowHandle(), text.c_str());
       dirty_timer = 0;
@@ -501,10 +1024,10 @@ public:
 
 private:
   //--------------------------------------------------------------------------------------------------
-  // Invoked when the user double-clicks on the viewport
-  // It uses the picking utility to find the object under the mouse cursor
+  // Invoked when the user clicks on the viewport, or hovers it with 'hover'
+  // It requests a pick of the object under the mouse cursor, the result comes a few frames later
   //
-  void screenPicking()
+  void screenPicking(bool hover)
   {
     // Pick under mouse cursor
     if(!m_scene.isValid() || !m_scene.m_gltfSceneRtx || m_scene.m_gltfSceneRtx->tlas() == VK_NULL_HANDLE)
@@ -518,28 +1041,28 @@ private:
     mouse_pos                    = mouse_pos - corner;
     const ImVec2 local_mouse_pos = mouse_pos / main_size;
 
-    // Finding current camera matrices
-    const glm::mat4& view = CameraManip.getMatrix();
-    glm::mat4        proj = glm::perspectiveRH_ZO(glm::radians(CameraManip.getFov()), aspect_ratio, 0.1F, 1000.0F);
-    proj[1][1] *= -1;
-
-    // Setting up the data to do picking
-    nvvk::RayPickerKHR::PickInfo pickInfo{
-        .modelViewInv   = glm::inverse(view),
-        .perspectiveInv = glm::inverse(proj),
-        .pickX          = local_mouse_pos.x,
-        .pickY          = local_mouse_pos.y,
-    };
-
-    // Run and wait for result
-    VkCommandBuffer cmd = m_app->createTempCmdBuffer();
-    m_picker->run(cmd, pickInfo);
-    m_app->submitAndWaitTempCmdBuffer(cmd);
+    if(hover)
+    {
+      m_picker.request({local_mouse_pos.x, local_mouse_pos.y}, aspect_ratio,
+                       [this](const nvvk::RayPickerKHR::PickResult& pr) { onHoverPicked(pr); }, true);
+      return;
+    }
 
+    // The clicks of the moment, not the ones of the frame of the result
+    const bool singleClick = m_mouseClickState.isMouseSingleClicked(ImGuiMouseButton_Left);
+    const bool doubleClick = m_mouseClickState.isMouseDoubleClicked(ImGuiMouseButton_Left);
+    m_picker.request({local_mouse_pos.x, local_mouse_pos.y}, aspect_ratio,
+                     [this, singleClick, doubleClick](const nvvk::RayPickerKHR::PickResult& pr) {
+                       onClickPicked(pr, singleClick, doubleClick);
+                     });
+  }
 
-    // Retrieving picking information
-    const nvvk::RayPickerKHR::PickResult pr = m_picker->getResult();
-    if(pr.instanceID == ~0)
+  //--------------------------------------------------------------------------------------------------
+  // Result of a click: selection, and the interest position on a double-click
+  //
+  void onClickPicked(const nvvk::RayPickerKHR::PickResult& pr, bool singleClick, bool doubleClick)
+  {
+    if(pr.instanceID == ~0 || !m_scene.isValid() || pr.instanceID >= m_scene.m_gltfScene->getRenderNodes().size())
     {
       LOGI("Nothing Hit\n");
       m_scene.selectRenderNode(-1);
@@ -558,13 +1081,13 @@ private:
     glm::vec3       center;
     glm::vec3       up;
     CameraManip.getLookat(eye, center, up);
-    if(m_mouseClickState.isMouseDoubleClicked(ImGuiMouseButton_Left))
+    if(doubleClick)
       CameraManip.setLookat(eye, world_pos, up, false);
 
     // Logging picking info.
     const nvh::gltf::RenderNode& renderNode = m_scene.m_gltfScene->getRenderNodes()[pr.instanceID];
     const tinygltf::Node&        node       = m_scene.m_gltfScene->getModel().nodes[renderNode.refNodeID];
-    if(m_mouseClickState.isMouseSingleClicked(ImGuiMouseButton_Left))
+    if(singleClick)
       m_scene.selectRenderNode(pr.instanceID);
 
     LOGI("Node Name: %s\n", node.name.c_str());
@@ -573,17 +1096,32 @@ private:
     LOGI("{%3.2f, %3.2f, %3.2f}, Dist: %3.2f\n", world_pos.x, world_pos.y, world_pos.z, pr.hitT);
   }
 
+  //--------------------------------------------------------------------------------------------------
+  // Result of a hover: the tooltip of the viewport
+  //
+  void onHoverPicked(const nvvk::RayPickerKHR::PickResult& pr)
+  {
+    m_hoverInfo.clear();
+    if(pr.instanceID == ~0 || pr.hitT <= 0.F || !m_scene.isValid() || pr.instanceID >= m_scene.m_gltfScene->getRenderNodes().size())
+      return;
+
+    const nvh::gltf::RenderNode& renderNode = m_scene.m_gltfScene->getRenderNodes()[pr.instanceID];
+    const tinygltf::Node&        node       = m_scene.m_gltfScene->getModel().nodes[renderNode.refNodeID];
+    m_hoverInfo = fmt::format("{}\nNode: {}, Mesh: {}, Dist: {:.2f}", node.name.empty() ? "<unnamed>" : node.name,
+                              renderNode.refNodeID, node.mesh, pr.hitT);
+  }
+
   //--------------------------------------------------------------------------------------------------
   // Create the renderer based on the settings
+  // The previous renderer is retired, it is destroyed once the frames in flight are done with it
   // Note: the tonemapper input/output should be re-adjusted after creating the renderer
   //
   void createRenderers()
   {
     nvh::ScopedTimer st(__FUNCTION__);
 
-    vkDeviceWaitIdle(m_resources.ctx.device);
+    m_resources.retire(std::move(m_renderer));
     m_resources.resetSlangCompiler();  // Resetting the Slang session
-    m_renderer.reset();
     if(!m_scene.isValid())
       return;
     switch(m_settings.renderSystem)
@@ -612,7 +1150,6 @@ private:
 
     nvh::ScopedTimer st(__FUNCTION__);
 
-    vkDeviceWaitIdle(m_resources.ctx.device);
     m_resources.resetSlangCompiler();  // Resetting the Slang session
     if(!m_scene.isValid() || !m_renderer)
       return;
@@ -625,20 +1162,21 @@ private:
   // - Scene changes
   // - Resolution changes
   //
-  void handleChanges(VkCommandBuffer cmd)
+  void handleChanges()
   {
+    // A new environment was swapped in, prepared with its mips by the loader
     if(m_scene.hasDirtyFlag(Scene::eHdrEnv))
     {
-      m_scene.generateHdrMipmap(cmd, m_resources);
+      if(m_scene.m_hdrEnv->isValid())
+        m_settings.envSystem = Settings::eHdr;
       m_settings.setDefaultLuminance(m_scene.m_hdrEnv->getIntegral());
     }
 
     // Scene changed (new scene)
     if(m_scene.hasDirtyFlag(Scene::eNewScene))
     {
-      vkDeviceWaitIdle(m_resources.ctx.device);
       createRenderers();
-      m_picker->setTlas(m_scene.m_gltfSceneRtx->tlas());  // The screen picker is using the new TLAS
+      m_picker.setTlas(m_scene.m_gltfSceneRtx->tlas());  // The screen picker is using the new TLAS
     }
 
     // Letting the renderer handle any changes
@@ -651,6 +1189,7 @@ private:
     m_scene.setDirtyFlag(Scene::eNewScene, false);
     m_scene.setDirtyFlag(Scene::eHdrEnv, false);
     m_scene.setDirtyFlag(Scene::eNodeVisibility, false);
+    m_scene.setDirtyFlag(Scene::eSceneDescriptorSet, false);
     m_resources.setGBuffersChanged(false);
   }
 
@@ -661,6 +1200,7 @@ private:
     m_settingsHandler.setSetting("Renderer", reinterpret_cast<int*>(&m_settings.renderSystem));
     m_settingsHandler.setSetting("MaxFrames", &m_settings.maxFrames);
     m_settingsHandler.setSetting("ShowAxis", &m_settings.showAxis);
+    m_settingsHandler.setSetting("ShowHoverInfo", &m_settings.showHoverInfo);
     m_settingsHandler.setSetting("SilhouetteColor", &m_settings.silhouetteColor);
     m_settingsHandler.setSetting("BackgrounfColor", &m_settings.solidBackgroundColor);
     m_settingsHandler.setSetting("Tonemapper", &m_tonemapper.settings().method);
@@ -671,14 +1211,20 @@ private:
   nvvkhl::Application*                m_app = nullptr;
   Resources                           m_resources;
   Settings                            m_settings;
+  DynamicResolution                   m_dynamicResolution;
   Scene                               m_scene;
   std::unique_ptr<gltfr::Renderer>    m_emptyRenderer{};
   std::unique_ptr<gltfr::Renderer>    m_renderer{};
   nvvkhl::TonemapperPostProcess       m_tonemapper;
-  std::unique_ptr<nvvk::RayPickerKHR> m_picker{};
+  ScreenPicker                        m_picker;
+  std::string                         m_hoverInfo;  // Tooltip of the last hover pick
   ImGuiH::SettingsHandler             m_settingsHandler;
   BusyWindow                          m_busy;
+  std::thread                         m_worker;  // Work of m_busy: loading, tangents
   ClickStateMachine                   m_mouseClickState;
+  ImageReadback                       m_readback;
+  std::vector<std::string>            m_pendingSaves;       // Copied at the beginning of the next frame
+  std::string                         m_batchHdr{g_inHdr};  // Environment of the batch jobs
 };
 
 
@@ -716,14 +1262,82 @@ auto main(int argc, char** argv) -> int
 
   cli.addArgument({"--headless"}, &appInfo.headless, "Run in headless mode");
   cli.addArgument({"--frames"}, &appInfo.headlessFrameCount, "Number of frames to render in headless mode");
+  cli.addArgument({"--batch"}, &g_batchFilename, "Render the jobs of a manifest, in headless mode");
+  cli.addArgument({"--benchmark"}, &g_benchmarkFilename, "Render the scenes of a list with each renderer, in headless mode");
+  cli.addArgument({"--benchmarkOutput"}, &g_benchmarkOutput, "The JSON report of the benchmark");
+  cli.addArgument({"--benchmarkWarmup"}, &g_benchmarkWarmup, "Frames of each configuration before the measured ones");
+  cli.addArgument({"--benchmarkFrames"}, &g_benchmarkFrames, "Measured frames of each configuration");
+  cli.addArgument({"--telemetry"}, &g_telemetryFilename, "Write the counters and timings of each frame to a JSON-lines file");
+  cli.addArgument({"--gpu"}, &g_forceGPU, "Index of the GPU to render with");
+  cli.addArgument({"--shareIndex"}, &gltfr::g_pathtraceSettings.shareIndex, "Distributed rendering: the share of the samples of this process");
+  cli.addArgument({"--shareCount"}, &gltfr::g_pathtraceSettings.shareCount, "Distributed rendering: the number of processes");
+  cli.addArgument({"--merge"}, &g_mergeFilenames, "Merge the EXR accumulations of the shares ('a.exr;b.exr'), weighted by their samples, to --out");
   cli.addArgument({"--size"}, &appInfo.windowSize, "Window size in [W H] format");
   cli.addArgument({"--vsync"}, &appInfo.vSync, "Turn on vsync");
   cli.addArgument({"--maxDepth"}, &gltfr::g_pathtraceSettings.maxDepth);
   cli.addArgument({"--maxSamples"}, &gltfr::g_pathtraceSettings.maxSamples);
   cli.addArgument({"--renderMode"}, (int*)&gltfr::g_pathtraceSettings.renderMode);
+  cli.addArgument({"--adaptiveThreshold"}, &gltfr::g_pathtraceSettings.adaptiveThreshold,
+                  "Relative error at which the tiles stop sampling, 0 to disable adaptive sampling");
+  cli.addArgument({"--adaptiveMinSamples"}, &gltfr::g_pathtraceSettings.adaptiveMinSamples, "Samples per pixel before a tile can converge");
+  cli.addArgument({"--temporal"}, &gltfr::g_pathtraceSettings.temporal, "Reproject the accumulation when only the camera moves");
   cli.addArgument({"--forceExternalShaders"}, &gltfr::g_forceExternalShaders);
+  cli.addArgument({"--blasCache"}, &gltfr::g_useBlasCache, "Cache the acceleration structures on disk");
+  cli.addArgument({"--parallelObj"}, &gltfr::g_parallelObj, "Load OBJ files with the multithreaded loader");
+  cli.addArgument({"--textureBudget"}, &gltfr::g_textureBudgetMB, "Memory for the streamed textures in MB, 0 to disable streaming");
+  cli.addArgument({"--compressTextures"}, &gltfr::g_compressTextures, "Compress the textures to BC7, cached on disk");
+  cli.addArgument({"--gpuAnimation"}, &gltfr::g_gpuAnimation, "Skinning and morph targets evaluated on the GPU");
+  cli.addArgument({"--meshlets"}, &gltfr::g_meshlets, "Build the meshlets and LODs of the mesh shader raster");
+  cli.addArgument({"--dedupGeometry"}, &gltfr::g_dedupGeometry,
+                  "Merge the identical primitives of different meshes, instances of the same BLAS");
+  cli.addArgument({"--specializeShaders"}, &gltfr::g_specializeShaders,
+                  "Strip the material extensions and the lights absent from the scene out of the path tracer");
+  cli.addArgument({"--compactVertices"}, &gltfr::g_compactVertices,
+                  "Quantized positions, octahedral normals and tangents, half float texture coordinates");
+  cli.addArgument({"--dynamicResolution"}, &gltfr::g_dynamicResolution,
+                  "Lower the internal resolution while the camera moves, to keep the frame time");
+  cli.addArgument({"--asyncCompute"}, &gltfr::g_asyncCompute,
+                  "Post-processing of the path tracer on the compute queue, overlapping the next frame");
+  cli.addArgument({"--opacityMicromaps"}, &gltfr::g_opacityMicromaps,
+                  "Bake the alpha-tested textures in opacity micromaps, any-hit only for the unknown micro-triangles");
   cli.parse(argc, argv);
 
+  // Distributed rendering: the accumulations of the shares are merged on the CPU
+  if(!g_mergeFilenames.empty())
+  {
+    std::vector<std::string> inputs;
+    std::stringstream        stream(g_mergeFilenames);
+    for(std::string input; std::getline(stream, input, ';');)
+    {
+      if(!input.empty())
+        inputs.push_back(input);
+    }
+    return gltfr::mergeRgba32fImages(inputs, g_outImageFilename.empty() ? "merged.exr" : g_outImageFilename) ? 0 : 1;
+  }
+
+  if(!g_telemetryFilename.empty())
+    gltfr::Telemetry::getInstance().open(g_telemetryFilename);
+
+  // The jobs of the batch are rendered after a first headless frame, --frames is the default of the jobs
+  if(!g_batchFilename.empty())
+  {
+    g_batchFrames              = std::max(appInfo.headlessFrameCount, 1U);
+    appInfo.headless           = true;
+    appInfo.headlessFrameCount = 1;
+  }
+
+  // The benchmark also runs after a first headless frame, at a fixed internal resolution
+  if(!g_benchmarkFilename.empty())
+  {
+    appInfo.headless           = true;
+    appInfo.headlessFrameCount = 1;
+    gltfr::g_dynamicResolution = false;
+  }
+
+  // Headless renders a fixed number of frames, the textures must be complete from the start
+  if(appInfo.headless)
+    gltfr::g_textureBudgetMB = 0;
+
 
 #ifdef USE_DGBPRINTF
   g_elemDebugPrintf = std::make_shared<nvvkhl::ElementDbgPrintf>();
@@ -748,6 +1362,7 @@ auto main(int argc, char** argv) -> int
 
   // Vulkan Context creation information
   VkContextSettings vkSetup;
+  vkSetup.forceGPU = g_forceGPU;
   if(!appInfo.headless)
   {
     nvvkhl::addSurfaceExtensions(vkSetup.instanceExtensions);
@@ -764,6 +1379,8 @@ auto main(int argc, char** argv) -> int
   VkPhysicalDeviceNestedCommandBufferFeaturesEXT nestedCmdFeature{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_NESTED_COMMAND_BUFFER_FEATURES_EXT};
   VkPhysicalDeviceRayTracingInvocationReorderFeaturesNV reorderFeature{
       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_INVOCATION_REORDER_FEATURES_NV};
+  VkPhysicalDeviceMeshShaderFeaturesEXT meshFeatures{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT};
+  VkPhysicalDeviceOpacityMicromapFeaturesEXT micromapFeatures{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_OPACITY_MICROMAP_FEATURES_EXT};
   vkSetup.deviceExtensions.emplace_back(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME, &accel_feature);
   vkSetup.deviceExtensions.emplace_back(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME, &rt_pipeline_feature);
   vkSetup.deviceExtensions.emplace_back(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
@@ -773,6 +1390,9 @@ auto main(int argc, char** argv) -> int
   vkSetup.deviceExtensions.emplace_back(VK_EXT_SHADER_OBJECT_EXTENSION_NAME, &shaderObjFeature);
   vkSetup.deviceExtensions.emplace_back(VK_EXT_NESTED_COMMAND_BUFFER_EXTENSION_NAME, &nestedCmdFeature);
   vkSetup.deviceExtensions.emplace_back(VK_NV_RAY_TRACING_INVOCATION_REORDER_EXTENSION_NAME, &reorderFeature, false);
+  vkSetup.deviceExtensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, nullptr, false);
+  vkSetup.deviceExtensions.emplace_back(VK_EXT_MESH_SHADER_EXTENSION_NAME, &meshFeatures, false);  // Meshlet raster
+  vkSetup.deviceExtensions.emplace_back(VK_EXT_OPACITY_MICROMAP_EXTENSION_NAME, &micromapFeatures, false);  // Alpha-tested BLAS
 
 #ifdef USE_AFTERMATH
   // #Aftermath - Initialization
@@ -796,9 +1416,10 @@ auto main(int argc, char** argv) -> int
 
 
   // Request the creation of all needed queues
-  vkSetup.queues = {VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT,  // GTC for rendering
-                    VK_QUEUE_COMPUTE_BIT,                                                  // Compute
-                    VK_QUEUE_TRANSFER_BIT};                                                // Transfer
+  vkSetup.queues         = {VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT,  // GTC for rendering
+                            VK_QUEUE_COMPUTE_BIT,                                                  // Compute
+                            VK_QUEUE_TRANSFER_BIT};                                                // Transfer
+  vkSetup.optionalQueues = {VK_QUEUE_COMPUTE_BIT};  // Async compute, post-processing: FrameGraph runs without it
 
   ValidationSettings vvlInfo{};
   // vvlInfo.validate_best_practices = true;
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Read-only memory mapping of a file
+
+  The pages are backed by the file, they are only read when accessed and can be
+  dropped by the OS under memory pressure, which avoids holding a second copy of
+  large files in memory while they are parsed.
+
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gltfr {
+
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile&)            = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool open(const std::filesystem::path& path)
+  {
+    close();
+#ifdef _WIN32
+    m_file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(m_file == INVALID_HANDLE_VALUE)
+      return false;
+    LARGE_INTEGER fileSize{};
+    if(!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0)
+    {
+      close();
+      return false;
+    }
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(m_mapping == nullptr)
+    {
+      close();
+      return false;
+    }
+    m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    m_fd = ::open(path.c_str(), O_RDONLY);
+    if(m_fd < 0)
+      return false;
+    struct stat st{};
+    if(fstat(m_fd, &st) != 0 || st.st_size == 0)
+    {
+      close();
+      return false;
+    }
+    void* ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if(ptr == MAP_FAILED)
+    {
+      close();
+      return false;
+    }
+    madvise(ptr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    m_data = static_cast<const uint8_t*>(ptr);
+    m_size = static_cast<size_t>(st.st_size);
+#endif
+    if(m_data == nullptr)
+    {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close()
+  {
+#ifdef _WIN32
+    if(m_data)
+      UnmapViewOfFile(m_data);
+    if(m_mapping)
+      CloseHandle(m_mapping);
+    if(m_file != INVALID_HANDLE_VALUE)
+      CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file    = INVALID_HANDLE_VALUE;
+#else
+    if(m_data)
+      munmap(const_cast<uint8_t*>(m_data), m_size);
+    if(m_fd >= 0)
+      ::close(m_fd);
+    m_fd = -1;
+#endif
+    m_data = nullptr;
+    m_size = 0;
+  }
+
+  const uint8_t* data() const { return m_data; }
+  size_t         size() const { return m_size; }
+
+private:
+  const uint8_t* m_data{nullptr};
+  size_t         m_size{0};
+#ifdef _WIN32
+  HANDLE m_file{INVALID_HANDLE_VALUE};
+  HANDLE m_mapping{nullptr};
+#else
+  int m_fd{-1};
+#endif
+};
+
+}  // namespace gltfr
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+#include "memory_budget.hpp"
+#include "telemetry.hpp"
+
+// nvpro-core
+#include "nvh/nvprint.hpp"
+
+#include "stb_image.h"
+
+namespace {
+constexpr VkDeviceSize kMinBatch         = 64ULL << 20;
+constexpr VkDeviceSize kMaxBatch         = 2ULL << 30;
+constexpr VkDeviceSize kMinTextureBudget = 64ULL << 20;
+constexpr VkDeviceSize kHeadroom         = 256ULL << 20;  // G-Buffers, swapchain, transient buffers
+constexpr VkDeviceSize kVertexBytes      = 64;            // Position, normal, tangent, texcoord, color of SceneVk
+
+VkDeviceSize megabytes(VkDeviceSize bytes)
+{
+  return bytes >> 20;
+}
+
+int accessorCount(const tinygltf::Model& model, int accessor)
+{
+  return accessor >= 0 && accessor < static_cast<int>(model.accessors.size()) ? static_cast<int>(model.accessors[accessor].count) : 0;
+}
+
+// Decoded size of an image, from its header
+VkDeviceSize decodedImageBytes(const tinygltf::Model& model, const tinygltf::Image& image, const std::string& baseDir)
+{
+  int width = image.width, height = image.height, components = 0;
+  if(width <= 0 || height <= 0)
+  {
+    width = height = 0;
+    if(image.bufferView >= 0)
+    {
+      const tinygltf::BufferView& view   = model.bufferViews[image.bufferView];
+      const tinygltf::Buffer&     buffer = model.buffers[view.buffer];
+      if(view.byteOffset + view.byteLength <= buffer.data.size())
+        stbi_info_from_memory(buffer.data.data() + view.byteOffset, static_cast<int>(view.byteLength), &width, &height, &components);
+    }
+    else if(!image.uri.empty() && image.uri.rfind("data:", 0) != 0)
+    {
+      const std::string path = (std::filesystem::path(baseDir) / image.uri).string();
+      stbi_info(path.c_str(), &width, &height, &components);
+    }
+  }
+  return VkDeviceSize(width) * VkDeviceSize(height) * 4 * 4 / 3;  // RGBA8 and the mips
+}
+}  // namespace
+
+const char* gltfr::MemoryBudget::categoryName(Category category)
+{
+  static const char* names[] = {"Geometry", "Textures", "Acceleration Structures", "Scratch", "G-Buffers"};
+  return names[category];
+}
+
+void gltfr::MemoryBudget::init(VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  m_device         = device;
+  m_physicalDevice = physicalDevice;
+
+  uint32_t count = 0;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr);
+  std::vector<VkExtensionProperties> extensions(count);
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, extensions.data());
+  m_hasMemoryBudget = std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties& ext) {
+    return strcmp(ext.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+// The largest device-local heap. Without VK_EXT_memory_budget, its size and the usage of the
+// categories.
+//
+gltfr::MemoryBudget::Heaps gltfr::MemoryBudget::query() const
+{
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+  VkPhysicalDeviceMemoryProperties2 memProps{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2};
+  memProps.pNext = m_hasMemoryBudget ? &budgetProps : nullptr;
+  vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memProps);
+
+  Heaps heaps;
+  for(uint32_t i = 0; i < memProps.memoryProperties.memoryHeapCount; i++)
+  {
+    const VkMemoryHeap& heap = memProps.memoryProperties.memoryHeaps[i];
+    if((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0)
+      continue;
+    const VkDeviceSize budget = m_hasMemoryBudget ? budgetProps.heapBudget[i] : heap.size;
+    if(budget > heaps.budget)
+      heaps = {budget, m_hasMemoryBudget ? budgetProps.heapUsage[i] : 0};
+  }
+  if(!m_hasMemoryBudget)
+  {
+    for(int i = 0; i < eNumCategories; i++)
+      heaps.usage += get(Category(i));
+  }
+  return heaps;
+}
+
+//--------------------------------------------------------------------------------------------------
+// What the parsed scene needs, before anything is created
+//
+gltfr::MemoryBudget::SceneEstimate gltfr::MemoryBudget::estimate(const nvh::gltf::Scene& scene,
+                                                                 const std::string&      baseDir,
+                                                                 bool                    compressTextures) const
+{
+  const tinygltf::Model& model = scene.getModel();
+
+  SceneEstimate result;
+  for(const nvh::gltf::RenderPrimitive& renderPrim : scene.getRenderPrimitives())
+  {
+    const tinygltf::Primitive& primitive = *renderPrim.pPrimitive;
+    const auto                 position  = primitive.attributes.find("POSITION");
+    const int vertexCount = position != primitive.attributes.end() ? accessorCount(model, position->second) : 0;
+    const int indexCount  = primitive.indices >= 0 ? accessorCount(model, primitive.indices) : vertexCount;
+    result.geometry += VkDeviceSize(vertexCount) * kVertexBytes + VkDeviceSize(indexCount) * sizeof(uint32_t);
+
+    // The sizes of the build of the BLAS, as SceneRtx creates them
+    const VkAccelerationStructureGeometryKHR geometry{
+        .sType        = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
+        .geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR,
+        .geometry     = {.triangles = {.sType        = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR,
+                                       .vertexFormat = VK_FORMAT_R32G32B32_SFLOAT,
+                                       .vertexStride = sizeof(float) * 3,
+                                       .maxVertex    = static_cast<uint32_t>(std::max(vertexCount - 1, 0)),
+                                       .indexType    = VK_INDEX_TYPE_UINT32}},
+        .flags        = VK_GEOMETRY_OPAQUE_BIT_KHR};
+    const VkAccelerationStructureBuildGeometryInfoKHR buildInfo{
+        .sType         = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+        .type          = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+        .flags         = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR,
+        .mode          = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
+        .geometryCount = 1,
+        .pGeometries   = &geometry};
+    const uint32_t                           triangles = static_cast<uint32_t>(indexCount / 3);
+    VkAccelerationStructureBuildSizesInfoKHR sizes{.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR};
+    vkGetAccelerationStructureBuildSizesKHR(m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo, &triangles, &sizes);
+    result.accel += sizes.accelerationStructureSize;
+    result.maxScratch = std::max(result.maxScratch, sizes.buildScratchSize);
+  }
+  // The instances of the TLAS, and the TLAS itself
+  result.accel += VkDeviceSize(scene.getRenderNodes().size()) * (sizeof(VkAccelerationStructureInstanceKHR) + 128);
+
+  for(const tinygltf::Image& image : model.images)
+    result.textures += decodedImageBytes(model, image, baseDir);
+  if(compressTextures)
+    result.textures /= 4;  // BC7: one byte per texel
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+// How to create the scene within the memory available. The geometry and the BLAS are created
+// while the previous scene is still displayed, its textures once the previous scene is released.
+//
+gltfr::MemoryBudget::Plan gltfr::MemoryBudget::plan(const SceneEstimate& estimate, VkDeviceSize textureBudget)
+{
+  const Heaps        heaps     = query();
+  const VkDeviceSize available = heaps.budget > heaps.usage ? heaps.budget - heaps.usage : 0;
+  const VkDeviceSize resident  = estimate.geometry + estimate.accel / 2;  // The BLAS are compacted to about half
+  const VkDeviceSize previous  = get(eGeometry) + get(eTextures) + get(eAccel) + get(eScratch);
+
+  LOGI("Memory: %llu MB available, the scene needs %llu MB of geometry, %llu MB of acceleration structures, %llu MB of textures\n",
+       megabytes(available), megabytes(estimate.geometry), megabytes(estimate.accel), megabytes(estimate.textures));
+
+  Plan plan;
+  plan.textureBudget = textureBudget;
+  if(resident + std::max(kMinBatch, estimate.maxScratch) > available)
+  {
+    LOGE("Memory: the scene does not fit, %llu MB needed and %llu MB available\n", megabytes(resident), megabytes(available));
+    plan.fits = false;
+    return plan;
+  }
+
+  // Smaller batches of BLAS builds when the default one does not fit beside the scene
+  const VkDeviceSize remaining    = available - resident;
+  const VkDeviceSize defaultBatch = std::clamp(available / 4, kMinBatch, kMaxBatch);
+  plan.blasBatch                  = std::clamp(std::min(defaultBatch, remaining), std::max(kMinBatch, estimate.maxScratch), kMaxBatch);
+  if(plan.blasBatch < defaultBatch)
+    LOGW("Memory: BLAS built in batches of %llu MB\n", megabytes(plan.blasBatch));
+
+  // The textures, streamed when they do not fit
+  const VkDeviceSize room     = remaining + previous > kHeadroom ? remaining + previous - kHeadroom : 0;
+  const VkDeviceSize textures = textureBudget > 0 ? std::min(estimate.textures, textureBudget) : estimate.textures;
+  if(textures > room)
+  {
+    plan.textureBudget  = std::max(room, kMinTextureBudget);
+    plan.reduceGBuffers = true;
+    LOGW("Memory: textures streamed under %llu MB, reduced G-Buffers\n", megabytes(plan.textureBudget));
+  }
+  m_reduceGBuffers = plan.reduceGBuffers;
+  return plan;
+}
+
+VkDeviceSize gltfr::MemoryBudget::imageBytes(VkExtent2D size, const std::vector<VkFormat>& formats)
+{
+  VkDeviceSize texelBytes = 0;
+  for(VkFormat format : formats)
+  {
+    switch(format)
+    {
+      case VK_FORMAT_R8_UNORM:
+        texelBytes += 1;
+        break;
+      case VK_FORMAT_R16G16B16A16_SFLOAT:
+        texelBytes += 8;
+        break;
+      case VK_FORMAT_R32G32B32A32_SFLOAT:
+        texelBytes += 16;
+        break;
+      default:
+        texelBytes += 4;  // RGBA8, R32, D32
+        break;
+    }
+  }
+  return VkDeviceSize(size.width) * size.height * texelBytes;
+}
+
+void gltfr::MemoryBudget::publish(Telemetry& telemetry) const
+{
+  const Heaps heaps = query();
+  telemetry.setGauge(Telemetry::eMemoryBudget, heaps.budget);
+  telemetry.setGauge(Telemetry::eMemoryUsage, heaps.usage);
+  for(int i = 0; i < eNumCategories; i++)
+    telemetry.setGauge(Telemetry::Gauge(Telemetry::eMemoryGeometry + i), get(Category(i)));
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  GPU memory accounting and planning
+
+  - query(): the budget and the usage of the device-local heaps, from
+    VK_EXT_memory_budget (the heap sizes and no usage without it).
+  - set()/get(): the bytes of each category of the current scene and renderer,
+    measured by the modules which create them (the scene allocator is only
+    used by the loader while a scene is created).
+  - estimate(): before createVulkanScene, what the parsed scene needs: the
+    vertices and indices, the decoded texture sizes from the image headers,
+    and the acceleration structures from vkGetAccelerationStructureBuildSizesKHR.
+  - plan(): how to stay within what is available, in this order:
+      1. smaller BLAS build batches, the scratch of a batch is the peak
+      2. the textures streamed under a budget: the lower mips stay resident
+      3. reduced G-Buffers: no temporal history and no async post-processing
+         snapshots for the path tracer
+    A scene whose geometry and compacted acceleration structures do not fit
+    is not loaded, the current scene stays.
+
+  The scratch buffers of static scenes are always released after the build,
+  animated scenes keep theirs for the refits.
+
+*/
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// nvpro-core
+#include "nvh/gltfscene.hpp"
+
+namespace gltfr {
+
+class Telemetry;
+
+class MemoryBudget
+{
+public:
+  enum Category
+  {
+    eGeometry,  // Vertices, indices, materials; and the textures when they are not deferred
+    eTextures,  // Deferred or streamed textures
+    eAccel,     // BLAS and TLAS
+    eScratch,   // Kept for the refits of the animated scenes
+    eGBuffers,  // Of the renderer
+    eNumCategories
+  };
+  static const char* categoryName(Category category);
+
+  struct Heaps
+  {
+    VkDeviceSize budget{0};
+    VkDeviceSize usage{0};
+  };
+
+  struct SceneEstimate
+  {
+    VkDeviceSize geometry{0};
+    VkDeviceSize textures{0};
+    VkDeviceSize accel{0};       // Before compaction
+    VkDeviceSize maxScratch{0};  // Of the largest BLAS, the smallest possible batch
+  };
+
+  struct Plan
+  {
+    bool         fits{true};
+    VkDeviceSize blasBatch{0};      // Memory of a batch of BLAS builds
+    VkDeviceSize textureBudget{0};  // 0: the textures at full resolution
+    bool         reduceGBuffers{false};
+  };
+
+  void init(VkDevice device, VkPhysicalDevice physicalDevice);
+
+  Heaps query() const;
+
+  void         set(Category category, VkDeviceSize bytes) { m_bytes[category].store(bytes, std::memory_order_relaxed); }
+  VkDeviceSize get(Category category) const { return m_bytes[category].load(std::memory_order_relaxed); }
+
+  SceneEstimate estimate(const nvh::gltf::Scene& scene, const std::string& baseDir, bool compressTextures) const;
+  // 'textureBudget': the budget of the streamed textures chosen by the user, 0 for full resolution
+  Plan plan(const SceneEstimate& estimate, VkDeviceSize textureBudget);
+
+  // The last plan reduced the G-Buffers, read by the renderers when they create them
+  bool reduceGBuffers() const { return m_reduceGBuffers; }
+
+  // Size of images with these formats
+  static VkDeviceSize imageBytes(VkExtent2D size, const std::vector<VkFormat>& formats);
+
+  // The gauges of the telemetry
+  void publish(Telemetry& telemetry) const;
+
+private:
+  VkDevice                  m_device{VK_NULL_HANDLE};
+  VkPhysicalDevice          m_physicalDevice{VK_NULL_HANDLE};
+  bool                      m_hasMemoryBudget{false};
+  std::atomic<VkDeviceSize> m_bytes[eNumCategories]{};
+  std::atomic<bool>         m_reduceGBuffers{false};
+};
+
+}  // namespace gltfr
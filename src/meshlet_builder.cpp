@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+#include "meshlet_builder.hpp"
+
+namespace {
+constexpr float    kMinLevelReduction = 0.75F;  // A level must have less than 75% of the triangles of the previous one
+constexpr uint32_t kMaxGridSize       = 1024;
+constexpr uint32_t kMinGridSize       = 2;
+
+void computeBounds(const std::vector<glm::vec3>&  positions,
+                   const std::vector<uint32_t>&   vertices,
+                   const std::vector<glm::uvec3>& triangles,
+                   DH::Meshlet&                   meshlet)
+{
+  glm::vec3 bmin(std::numeric_limits<float>::max());
+  glm::vec3 bmax(-std::numeric_limits<float>::max());
+  for(uint32_t v : vertices)
+  {
+    bmin = glm::min(bmin, positions[v]);
+    bmax = glm::max(bmax, positions[v]);
+  }
+  meshlet.center = (bmin + bmax) * 0.5F;
+  meshlet.radius = 0.0F;
+  for(uint32_t v : vertices)
+    meshlet.radius = std::max(meshlet.radius, glm::length(positions[v] - meshlet.center));
+
+  // Normal cone: never culled when the normals spread over more than a hemisphere
+  std::vector<glm::vec3> normals;
+  normals.reserve(triangles.size());
+  glm::vec3 axis(0.0F);
+  for(const glm::uvec3& t : triangles)
+  {
+    const glm::vec3 n   = glm::cross(positions[t.y] - positions[t.x], positions[t.z] - positions[t.x]);
+    const float     len = glm::length(n);
+    if(len <= 0.0F)
+      continue;
+    normals.push_back(n / len);
+    axis += normals.back();
+  }
+  meshlet.coneAxis   = glm::vec3(0.0F, 0.0F, 1.0F);
+  meshlet.coneCutoff = 1.0F;
+  const float axisLength = glm::length(axis);
+  if(normals.empty() || axisLength <= 0.0F)
+    return;
+  axis /= axisLength;
+  float minDot = 1.0F;
+  for(const glm::vec3& n : normals)
+    minDot = std::min(minDot, glm::dot(axis, n));
+  if(minDot <= 0.1F)
+    return;
+  meshlet.coneAxis   = axis;
+  meshlet.coneCutoff = std::sqrt(1.0F - minDot * minDot);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Meshlets of the triangles, appended to the mesh
+//
+void buildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<glm::uvec3>& triangles, float error, gltfr::MeshletMesh& mesh)
+{
+  DH::MeshletLevel level{};
+  level.meshletOffset  = static_cast<uint32_t>(mesh.meshlets.size());
+  level.triangleOffset = static_cast<uint32_t>(mesh.levelTriangles.size());
+  level.error          = error;
+
+  std::vector<int32_t>    localIndex(positions.size(), -1);
+  std::vector<uint32_t>   vertices;
+  std::vector<glm::uvec3> meshletTriangles;
+  uint32_t                levelTriangle = 0;
+
+  auto flush = [&]() {
+    if(meshletTriangles.empty())
+      return;
+    DH::Meshlet meshlet{};
+    meshlet.vertexOffset        = static_cast<uint32_t>(mesh.vertices.size());
+    meshlet.triangleOffset      = static_cast<uint32_t>(mesh.triangles.size());
+    meshlet.levelTriangleOffset = levelTriangle;
+    meshlet.counts              = static_cast<uint32_t>(vertices.size()) | (static_cast<uint32_t>(meshletTriangles.size()) << 8);
+    computeBounds(positions, vertices, meshletTriangles, meshlet);
+    for(const glm::uvec3& t : meshletTriangles)
+    {
+      mesh.triangles.push_back(localIndex[t.x] | (localIndex[t.y] << 8) | (localIndex[t.z] << 16));
+      mesh.levelTriangles.push_back(t);
+    }
+    mesh.vertices.insert(mesh.vertices.end(), vertices.begin(), vertices.end());
+    mesh.meshlets.push_back(meshlet);
+    levelTriangle += static_cast<uint32_t>(meshletTriangles.size());
+    for(uint32_t v : vertices)
+      localIndex[v] = -1;
+    vertices.clear();
+    meshletTriangles.clear();
+  };
+
+  for(const glm::uvec3& t : triangles)
+  {
+    const uint32_t newVertices = (localIndex[t.x] < 0 ? 1 : 0) + (localIndex[t.y] < 0 && t.y != t.x ? 1 : 0)
+                                 + (localIndex[t.z] < 0 && t.z != t.x && t.z != t.y ? 1 : 0);
+    if(vertices.size() + newVertices > MESHLET_MAX_VERTICES || meshletTriangles.size() + 1 > MESHLET_MAX_TRIANGLES)
+      flush();
+    for(uint32_t v : {t.x, t.y, t.z})
+    {
+      if(localIndex[v] < 0)
+      {
+        localIndex[v] = static_cast<int32_t>(vertices.size());
+        vertices.push_back(v);
+      }
+    }
+    meshletTriangles.push_back(t);
+  }
+  flush();
+
+  level.meshletCount = static_cast<uint32_t>(mesh.meshlets.size()) - level.meshletOffset;
+  mesh.levels.push_back(level);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Vertex clustering: the vertices of each cell of the grid are merged to the one closest to their
+// average, the triangles becoming degenerate are removed
+//
+std::vector<glm::uvec3> simplify(const std::vector<glm::vec3>&  positions,
+                                 const std::vector<glm::uvec3>& triangles,
+                                 const glm::vec3&               origin,
+                                 float                          cellSize)
+{
+  struct Cell
+  {
+    glm::vec3 sum{0.0F};
+    uint32_t  count{0};
+    uint32_t  representative{0};
+    float     distance{std::numeric_limits<float>::max()};
+  };
+  auto cellKey = [&](uint32_t v) {
+    const glm::uvec3 c = glm::uvec3(glm::max((positions[v] - origin) / cellSize, glm::vec3(0.0F)));
+    return (uint64_t(c.x) << 42) | (uint64_t(c.y) << 21) | uint64_t(c.z);
+  };
+
+  std::unordered_map<uint64_t, Cell> cells;
+  std::vector<uint64_t>              keys(positions.size(), ~0ULL);
+  for(const glm::uvec3& t : triangles)
+  {
+    for(uint32_t v : {t.x, t.y, t.z})
+    {
+      if(keys[v] != ~0ULL)
+        continue;
+      keys[v]    = cellKey(v);
+      Cell& cell = cells[keys[v]];
+      cell.sum += positions[v];
+      cell.count++;
+    }
+  }
+  for(uint32_t v = 0; v < keys.size(); v++)
+  {
+    if(keys[v] == ~0ULL)
+      continue;
+    Cell&       cell     = cells[keys[v]];
+    const float distance = glm::length(positions[v] - cell.sum / float(cell.count));
+    if(distance < cell.distance)
+    {
+      cell.distance       = distance;
+      cell.representative = v;
+    }
+  }
+
+  std::vector<glm::uvec3> result;
+  for(const glm::uvec3& t : triangles)
+  {
+    const glm::uvec3 r(cells[keys[t.x]].representative, cells[keys[t.y]].representative, cells[keys[t.z]].representative);
+    if(r.x != r.y && r.y != r.z && r.x != r.z)
+      result.push_back(r);
+  }
+  return result;
+}
+}  // namespace
+
+gltfr::MeshletMesh gltfr::buildMeshletMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, bool withLods)
+{
+  MeshletMesh             mesh;
+  std::vector<glm::uvec3> triangles;
+  triangles.reserve(indices.size() / 3);
+  for(size_t i = 0; i + 2 < indices.size(); i += 3)
+  {
+    if(indices[i] < positions.size() && indices[i + 1] < positions.size() && indices[i + 2] < positions.size())
+      triangles.emplace_back(indices[i], indices[i + 1], indices[i + 2]);
+  }
+  if(triangles.empty())
+    return mesh;
+
+  glm::vec3 bmin(std::numeric_limits<float>::max());
+  glm::vec3 bmax(-std::numeric_limits<float>::max());
+  for(const glm::vec3& p : positions)
+  {
+    bmin = glm::min(bmin, p);
+    bmax = glm::max(bmax, p);
+  }
+  mesh.center = (bmin + bmax) * 0.5F;
+  mesh.radius = glm::length(bmax - bmin) * 0.5F;
+
+  buildMeshlets(positions, triangles, 0.0F, mesh);
+  if(!withLods)
+    return mesh;
+
+  // Coarser grids until the level fits in a meshlet
+  const float extent       = std::max(std::max(bmax.x - bmin.x, bmax.y - bmin.y), bmax.z - bmin.z);
+  size_t      numTriangles = triangles.size();
+  for(uint32_t grid = kMaxGridSize; grid >= kMinGridSize && mesh.levels.size() < MESHLET_MAX_LEVELS; grid /= 2)
+  {
+    if(numTriangles <= MESHLET_MAX_TRIANGLES || extent <= 0.0F)
+      break;
+    const float             cellSize   = extent / float(grid);
+    std::vector<glm::uvec3> simplified = simplify(positions, triangles, bmin, cellSize);
+    if(simplified.empty() || float(simplified.size()) > kMinLevelReduction * float(numTriangles))
+      continue;
+    // A merged vertex moves at most by the diagonal of its cell
+    buildMeshlets(positions, simplified, cellSize * std::sqrt(3.0F), mesh);
+    numTriangles = simplified.size();
+  }
+  return mesh;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nvvkhl/shaders/dh_lighting.h"
+namespace DH {
+#include "shaders/device_host.h"
+#include "shaders/meshlet.h"
+}  // namespace DH
+
+namespace gltfr {
+
+// Meshlets of one render primitive, the offsets are local to the primitive
+struct MeshletMesh
+{
+  std::vector<DH::MeshletLevel> levels;          // Level 0 is the original mesh
+  std::vector<DH::Meshlet>      meshlets;        // All levels
+  std::vector<uint32_t>         vertices;        // Vertex index of the primitive, per meshlet vertex
+  std::vector<uint32_t>         triangles;       // Three 8-bit meshlet vertex indices
+  std::vector<glm::uvec3>       levelTriangles;  // Vertex indices of the primitive, in meshlet order
+  glm::vec3                     center{0.0F};
+  float                         radius{0.0F};
+};
+
+// Meshlets of the triangles, then of the coarser levels made by vertex clustering when 'withLods'.
+// - Meshlets are filled in triangle order, up to MESHLET_MAX_VERTICES and MESHLET_MAX_TRIANGLES
+// - The bounding sphere and the normal cone are computed for each meshlet
+// - The coarse levels only use vertices of the original mesh, their attributes remain valid
+MeshletMesh buildMeshletMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, bool withLods);
+
+}  // namespace gltfr
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+
+#include "meshlet_raster.hpp"
+
+// nvpro-core
+#include "nvh/nvprint.hpp"
+#include "nvh/timesampler.hpp"
+#include "nvvk/buffers_vk.hpp"
+#include "nvvk/debug_util_vk.hpp"
+
+namespace {
+constexpr uint32_t kMaxGroupCount   = 65535;     // Guaranteed maxTaskWorkGroupCount in each dimension
+constexpr uint32_t kMaxTasksPerDraw = 1U << 22;  // Guaranteed maxTaskWorkGroupTotalCount
+}  // namespace
+
+void gltfr::MeshletRaster::init(Resources& res)
+{
+  m_alloc  = res.m_allocator.get();
+  m_device = res.ctx.device;
+  m_dirty  = true;
+}
+
+void gltfr::MeshletRaster::deinit()
+{
+  if(m_alloc == nullptr)
+    return;
+  m_alloc->destroy(m_tasks);
+  m_numTasks      = 0;
+  m_bucketOffsets = {};
+  m_bucketSizes   = {};
+  m_alloc         = nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+// One task per chunk of the level 0 meshlets of each visible render node
+//
+void gltfr::MeshletRaster::update(Resources& res, const Scene& scene, bool wireframe)
+{
+  if(!m_dirty || m_alloc == nullptr)
+    return;
+  nvh::ScopedTimer st(__FUNCTION__);
+  m_dirty = false;
+  res.retire(m_tasks);  // Still used by the frames in flight
+
+  const MeshletScene&                       meshlets    = scene.getMeshletScene();
+  const std::vector<nvh::gltf::RenderNode>& renderNodes = scene.m_gltfScene->getRenderNodes();
+
+  std::vector<DH::MeshletTask> tasks;
+  auto addBucket = [&](Bucket bucket, const std::vector<uint32_t>& nodeIDs) {
+    m_bucketOffsets[bucket] = static_cast<uint32_t>(tasks.size());
+    for(uint32_t nodeID : nodeIDs)
+    {
+      const nvh::gltf::RenderNode& renderNode = renderNodes[nodeID];
+      if(!renderNode.visible)
+        continue;
+      const uint32_t numChunks = (meshlets.numMeshlets(renderNode.renderPrimID) + MESHLET_TASK_SIZE - 1) / MESHLET_TASK_SIZE;
+      for(uint32_t chunk = 0; chunk < numChunks; chunk++)
+        tasks.push_back({static_cast<int>(nodeID), renderNode.renderPrimID, chunk});
+    }
+    m_bucketSizes[bucket] = static_cast<uint32_t>(tasks.size()) - m_bucketOffsets[bucket];
+  };
+  addBucket(GpuDrivenRaster::eBucketSolid, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterSolid));
+  addBucket(GpuDrivenRaster::eBucketSolidDoubleSided, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterSolidDoubleSided));
+  addBucket(GpuDrivenRaster::eBucketBlend, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterBlend));
+  addBucket(GpuDrivenRaster::eBucketWireframe,
+            wireframe ? scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterAll) : std::vector<uint32_t>{});
+  m_numTasks = static_cast<uint32_t>(tasks.size());
+  if(tasks.empty())
+    return;
+
+  VkCommandBuffer cmd = res.createTempCmdBuffer();
+  m_tasks = m_alloc->createBuffer(cmd, tasks, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_tasks.buffer);
+  res.submitAndWaitTempCmdBuffer(cmd);
+  m_alloc->finalizeAndReleaseStaging();
+
+  LOGI("Meshlet raster: %u tasks\n", m_numTasks);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The tasks of the bucket, in 2D grids within the guaranteed limits of the task workgroup count
+//
+void gltfr::MeshletRaster::cmdDraw(VkCommandBuffer cmd, Bucket bucket, VkPipelineLayout layout, DH::PushConstantMeshlet pushConst) const
+{
+  if(m_bucketSizes[bucket] == 0)
+    return;
+
+  pushConst.tasks = nvvk::getBufferDeviceAddress(m_device, m_tasks.buffer);
+  for(uint32_t first = 0; first < m_bucketSizes[bucket]; first += kMaxTasksPerDraw)
+  {
+    pushConst.taskOffset = m_bucketOffsets[bucket] + first;
+    pushConst.numTasks   = std::min(m_bucketSizes[bucket] - first, kMaxTasksPerDraw);
+    const uint32_t groupsX = std::min(pushConst.numTasks, kMaxGroupCount);
+    const uint32_t groupsY = (pushConst.numTasks + groupsX - 1) / groupsX;
+    vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                       0, sizeof(DH::PushConstantMeshlet), &pushConst);
+    vkCmdDrawMeshTasksEXT(cmd, groupsX, groupsY, 1);
+  }
+}
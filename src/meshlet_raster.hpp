@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Mesh shader raster of the meshlets (see MeshletScene)
+
+  - The tasks (visible render node, and a chunk of MESHLET_TASK_SIZE meshlets of
+    its primitive) are built per bucket when the scene or the visibility changes.
+  - One vkCmdDrawMeshTasksEXT per bucket: each task workgroup selects the LOD
+    level of its render node from the projected error, culls its meshlets against
+    the frustum, the normal cone and the Hi-Z of GpuDrivenRaster, and launches a
+    mesh workgroup per visible meshlet.
+
+*/
+
+#include <array>
+
+// nvpro-core
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "gpu_driven_raster.hpp"
+#include "resources.hpp"
+#include "scene.hpp"
+
+namespace DH {
+#include "shaders/meshlet.h"
+}  // namespace DH
+
+namespace gltfr {
+
+class MeshletRaster
+{
+public:
+  using Bucket = GpuDrivenRaster::Bucket;
+
+  void init(Resources& res);
+  void deinit();
+
+  // The tasks are rebuilt by the next update()
+  void setDirty() { m_dirty = true; }
+  void update(Resources& res, const Scene& scene, bool wireframe);
+
+  // Inside of the rendering, with the mesh pipeline of the bucket bound
+  void cmdDraw(VkCommandBuffer cmd, Bucket bucket, VkPipelineLayout layout, DH::PushConstantMeshlet pushConst) const;
+
+  uint32_t numTasks() const { return m_numTasks; }
+
+private:
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  VkDevice                 m_device{VK_NULL_HANDLE};
+
+  nvvk::Buffer                                        m_tasks;  // MeshletTask, grouped by bucket
+  bool                                                m_dirty{true};
+  uint32_t                                            m_numTasks{0};
+  std::array<uint32_t, GpuDrivenRaster::eBucketCount> m_bucketOffsets{};
+  std::array<uint32_t, GpuDrivenRaster::eBucketCount> m_bucketSizes{};
+};
+
+}  // namespace gltfr
@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "meshlet_scene.hpp"
+
+#include "nvh/nvprint.hpp"
+#include "nvh/parallel_work.hpp"
+#include "nvh/timesampler.hpp"
+#include "nvvk/buffers_vk.hpp"
+#include "nvvk/debug_util_vk.hpp"
+
+// Local to application
+#include "cache_utils.hpp"
+#include "gltf_accessor.hpp"
+
+constexpr uint64_t MESHLET_CACHE_MAGIC   = 0x4c534d4652544c47ULL;  // "GLTRFMSL"
+constexpr uint32_t MESHLET_CACHE_VERSION = 1;
+
+namespace {
+constexpr VkBufferUsageFlags kStorageUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+struct MeshletCacheHeader
+{
+  uint64_t magic         = MESHLET_CACHE_MAGIC;
+  uint32_t version       = MESHLET_CACHE_VERSION;
+  uint32_t numPrimitives = 0;
+};
+
+// Followed by the arrays of the mesh
+struct MeshletCacheMesh
+{
+  uint32_t  numLevels{0};
+  uint32_t  numMeshlets{0};
+  uint32_t  numVertices{0};
+  uint32_t  numTriangles{0};
+  uint32_t  numLevelTriangles{0};
+  glm::vec3 center{0.0F};
+  float     radius{0.0F};
+};
+
+template <typename T>
+void appendArray(std::vector<char>& data, const std::vector<T>& array)
+{
+  const char* begin = reinterpret_cast<const char*>(array.data());
+  data.insert(data.end(), begin, begin + array.size() * sizeof(T));
+}
+
+template <typename T>
+bool readArray(const std::vector<char>& data, size_t& offset, uint32_t count, std::vector<T>& array)
+{
+  if(offset + count * sizeof(T) > data.size())
+    return false;
+  array.resize(count);
+  std::memcpy(array.data(), data.data() + offset, count * sizeof(T));
+  offset += count * sizeof(T);
+  return true;
+}
+
+struct PrimitiveGeometry
+{
+  std::vector<glm::vec3> positions;
+  std::vector<uint32_t>  indices;
+};
+}  // namespace
+
+bool gltfr::MeshletScene::isSupported(VkPhysicalDevice physicalDevice)
+{
+  uint32_t count = 0;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr);
+  std::vector<VkExtensionProperties> extensions(count);
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, extensions.data());
+
+  bool hasMeshShader = false;
+  for(const VkExtensionProperties& ext : extensions)
+  {
+    hasMeshShader |= (strcmp(ext.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0);
+  }
+  if(!hasMeshShader)
+    return false;
+
+  VkPhysicalDeviceMeshShaderFeaturesEXT meshFeatures{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT};
+  VkPhysicalDeviceFeatures2             features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &meshFeatures};
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+  return meshFeatures.meshShader == VK_TRUE && meshFeatures.taskShader == VK_TRUE;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The meshlets of all primitives are built on all cores, unless the cache has them
+//
+void gltfr::MeshletScene::init(Resources& res, const nvh::gltf::Scene& scene, const std::vector<uint32_t>& deformedPrimitives)
+{
+  nvh::ScopedTimer st(__FUNCTION__);
+  deinit();
+  m_alloc  = res.m_allocator.get();
+  m_device = res.ctx.device;
+
+  const tinygltf::Model&                         model      = scene.getModel();
+  const std::vector<nvh::gltf::RenderPrimitive>& primitives = scene.getRenderPrimitives();
+  if(primitives.empty())
+    return;
+
+  // Geometry of the primitives, and the key of the cache
+  std::vector<PrimitiveGeometry> geometries(primitives.size());
+  const uint32_t                 numThreads = std::max(1U, std::min(static_cast<uint32_t>(primitives.size()), std::thread::hardware_concurrency()));
+  nvh::parallel_batches<1>(
+      primitives.size(),
+      [&](uint64_t i) {
+        const tinygltf::Primitive& primitive = *primitives[i].pPrimitive;
+        const auto                 position  = primitive.attributes.find("POSITION");
+        if(position == primitive.attributes.end() || primitive.mode != TINYGLTF_MODE_TRIANGLES)
+          return;
+        const std::vector<float> values = readAccessor(model, position->second, 3);
+        geometries[i].positions.resize(values.size() / 3);
+        std::memcpy(geometries[i].positions.data(), values.data(), geometries[i].positions.size() * sizeof(glm::vec3));
+        geometries[i].indices = readIndices(model, primitive.indices, geometries[i].positions.size());
+      },
+      numThreads);
+
+  Hasher hasher;
+  hasher.add(MESHLET_CACHE_VERSION).add(geometries.size());
+  for(size_t i = 0; i < geometries.size(); i++)
+  {
+    const bool deformed = std::binary_search(deformedPrimitives.begin(), deformedPrimitives.end(), static_cast<uint32_t>(i));
+    hasher.add(geometries[i].positions).add(geometries[i].indices).add(deformed);
+  }
+  const std::filesystem::path cachePath = getCacheDirectory() / (hasher.toString() + ".meshlets");
+
+  std::vector<MeshletMesh> meshes;
+  if(!loadCache(cachePath, meshes) || meshes.size() != primitives.size())
+  {
+    meshes.assign(primitives.size(), {});
+    nvh::parallel_batches<1>(
+        primitives.size(),
+        [&](uint64_t i) {
+          const bool deformed = std::binary_search(deformedPrimitives.begin(), deformedPrimitives.end(), static_cast<uint32_t>(i));
+          meshes[i] = buildMeshletMesh(geometries[i].positions, geometries[i].indices, !deformed);
+        },
+        numThreads);
+    if(!saveCache(cachePath, meshes))
+      LOGW("Meshlet cache %s could not be written\n", cachePath.string().c_str());
+  }
+
+  upload(res, meshes, deformedPrimitives);
+}
+
+void gltfr::MeshletScene::deinit()
+{
+  if(m_alloc == nullptr)
+    return;
+  for(nvvk::Buffer& buffer : m_buffers)
+    m_alloc->destroy(buffer);
+  m_buffers.clear();
+  m_alloc->destroy(m_sceneDesc);
+  m_level0Meshlets.clear();
+  m_totalMeshlets = 0;
+}
+
+void gltfr::MeshletScene::retire(Resources& res)
+{
+  for(nvvk::Buffer& buffer : m_buffers)
+    res.retire(buffer);
+  res.retire(m_sceneDesc);
+  deinit();
+}
+
+VkDeviceAddress gltfr::MeshletScene::sceneDescAddress() const
+{
+  return nvvk::getBufferDeviceAddress(m_device, m_sceneDesc.buffer);
+}
+
+bool gltfr::MeshletScene::loadCache(const std::filesystem::path& path, std::vector<MeshletMesh>& meshes) const
+{
+  std::vector<char> data;
+  if(!readCacheFile(path, data) || data.size() < sizeof(MeshletCacheHeader))
+    return false;
+
+  MeshletCacheHeader header;
+  std::memcpy(&header, data.data(), sizeof(header));
+  if(header.magic != MESHLET_CACHE_MAGIC || header.version != MESHLET_CACHE_VERSION)
+  {
+    LOGW("Meshlet cache %s doesn't match the scene, rebuilding\n", path.string().c_str());
+    return false;
+  }
+
+  size_t offset = sizeof(header);
+  meshes.resize(header.numPrimitives);
+  for(MeshletMesh& mesh : meshes)
+  {
+    MeshletCacheMesh info;
+    if(offset + sizeof(info) > data.size())
+      return false;
+    std::memcpy(&info, data.data() + offset, sizeof(info));
+    offset += sizeof(info);
+    mesh.center = info.center;
+    mesh.radius = info.radius;
+    if(!readArray(data, offset, info.numLevels, mesh.levels) || !readArray(data, offset, info.numMeshlets, mesh.meshlets)
+       || !readArray(data, offset, info.numVertices, mesh.vertices) || !readArray(data, offset, info.numTriangles, mesh.triangles)
+       || !readArray(data, offset, info.numLevelTriangles, mesh.levelTriangles))
+      return false;
+  }
+  return true;
+}
+
+bool gltfr::MeshletScene::saveCache(const std::filesystem::path& path, const std::vector<MeshletMesh>& meshes) const
+{
+  std::vector<char>        data(sizeof(MeshletCacheHeader));
+  const MeshletCacheHeader header{.numPrimitives = static_cast<uint32_t>(meshes.size())};
+  std::memcpy(data.data(), &header, sizeof(header));
+  for(const MeshletMesh& mesh : meshes)
+  {
+    const MeshletCacheMesh info{.numLevels         = static_cast<uint32_t>(mesh.levels.size()),
+                                .numMeshlets       = static_cast<uint32_t>(mesh.meshlets.size()),
+                                .numVertices       = static_cast<uint32_t>(mesh.vertices.size()),
+                                .numTriangles      = static_cast<uint32_t>(mesh.triangles.size()),
+                                .numLevelTriangles = static_cast<uint32_t>(mesh.levelTriangles.size()),
+                                .center            = mesh.center,
+                                .radius            = mesh.radius};
+    const char* begin = reinterpret_cast<const char*>(&info);
+    data.insert(data.end(), begin, begin + sizeof(info));
+    appendArray(data, mesh.levels);
+    appendArray(data, mesh.meshlets);
+    appendArray(data, mesh.vertices);
+    appendArray(data, mesh.triangles);
+    appendArray(data, mesh.levelTriangles);
+  }
+  return writeCacheFile(path, data.data(), data.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+// All primitives are concatenated, the offsets become global
+//
+void gltfr::MeshletScene::upload(Resources& res, const std::vector<MeshletMesh>& meshes, const std::vector<uint32_t>& deformedPrimitives)
+{
+  std::vector<DH::MeshletPrimitive> primitives(meshes.size());
+  std::vector<DH::MeshletLevel>     levels;
+  std::vector<DH::Meshlet>          meshlets;
+  std::vector<uint32_t>             vertices;
+  std::vector<uint32_t>             triangles;
+  std::vector<glm::uvec3>           levelTriangles;
+  m_level0Meshlets.assign(meshes.size(), 0);
+
+  for(size_t i = 0; i < meshes.size(); i++)
+  {
+    const MeshletMesh&    mesh = meshes[i];
+    DH::MeshletPrimitive& prim = primitives[i];
+    prim.center                = mesh.center;
+    prim.radius                = mesh.radius;
+    prim.levelOffset           = static_cast<uint32_t>(levels.size());
+    prim.levelCount            = static_cast<uint32_t>(mesh.levels.size());
+    prim.deformed = std::binary_search(deformedPrimitives.begin(), deformedPrimitives.end(), static_cast<uint32_t>(i)) ? 1 : 0;
+    if(!mesh.levels.empty())
+      m_level0Meshlets[i] = mesh.levels[0].meshletCount;
+
+    const uint32_t meshletOffset       = static_cast<uint32_t>(meshlets.size());
+    const uint32_t levelTriangleOffset = static_cast<uint32_t>(levelTriangles.size());
+    for(DH::MeshletLevel level : mesh.levels)
+    {
+      level.meshletOffset += meshletOffset;
+      level.triangleOffset += levelTriangleOffset;
+      levels.push_back(level);
+    }
+    const uint32_t vertexOffset   = static_cast<uint32_t>(vertices.size());
+    const uint32_t triangleOffset = static_cast<uint32_t>(triangles.size());
+    for(DH::Meshlet meshlet : mesh.meshlets)
+    {
+      meshlet.vertexOffset += vertexOffset;
+      meshlet.triangleOffset += triangleOffset;
+      meshlets.push_back(meshlet);
+    }
+    vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+    triangles.insert(triangles.end(), mesh.triangles.begin(), mesh.triangles.end());
+    levelTriangles.insert(levelTriangles.end(), mesh.levelTriangles.begin(), mesh.levelTriangles.end());
+  }
+  m_totalMeshlets = static_cast<uint32_t>(meshlets.size());
+  if(meshlets.empty())
+    return;
+
+  VkCommandBuffer cmd     = res.createTempCmdBuffer();
+  auto            address = [&](const auto& array) {
+    m_buffers.push_back(m_alloc->createBuffer(cmd, array, kStorageUsage));
+    nvvk::DebugUtil(m_device).setObjectName(m_buffers.back().buffer, "Meshlets");
+    return nvvk::getBufferDeviceAddress(m_device, m_buffers.back().buffer);
+  };
+  DH::MeshletSceneDesc desc{};
+  desc.primitives     = address(primitives);
+  desc.levels         = address(levels);
+  desc.meshlets       = address(meshlets);
+  desc.vertices       = address(vertices);
+  desc.triangles      = address(triangles);
+  desc.levelTriangles = address(levelTriangles);
+  m_sceneDesc         = m_alloc->createBuffer(cmd, std::vector<DH::MeshletSceneDesc>{desc}, kStorageUsage);
+  nvvk::DebugUtil(m_device).DBG_NAME(m_sceneDesc.buffer);
+  res.submitAndWaitTempCmdBuffer(cmd);
+  m_alloc->finalizeAndReleaseStaging();
+
+  LOGI("Meshlets: %u meshlets, %zu levels\n", m_totalMeshlets, levels.size());
+}
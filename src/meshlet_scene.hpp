@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Meshlets of the render primitives, for the mesh shader raster
+
+  - At load, the triangles of each primitive are split in meshlets of at most
+    MESHLET_MAX_VERTICES and MESHLET_MAX_TRIANGLES, with a bounding sphere and
+    a normal cone. Coarser LOD levels are made by vertex clustering, they only
+    reference vertices of the primitive, so the vertex buffers of the scene are
+    used by all levels.
+  - The primitives are processed in parallel, and the result is cached on disk,
+    keyed by the positions and indices.
+  - The deformed primitives (skinning, morph targets) only have level 0, their
+    bounds are the ones of the rest pose and are not used for culling.
+
+*/
+
+#include <filesystem>
+#include <vector>
+
+// nvpro-core
+#include "nvh/gltfscene.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "meshlet_builder.hpp"
+#include "resources.hpp"
+
+namespace gltfr {
+
+class MeshletScene
+{
+public:
+  // VK_EXT_mesh_shader with task and mesh shaders
+  static bool isSupported(VkPhysicalDevice physicalDevice);
+
+  // Build or load the meshlets of all render primitives, and upload them
+  void init(Resources& res, const nvh::gltf::Scene& scene, const std::vector<uint32_t>& deformedPrimitives);
+  void deinit();
+  void retire(Resources& res);  // Deinit once the frames in flight are done with the buffers
+
+  bool            isValid() const { return m_sceneDesc.buffer != VK_NULL_HANDLE; }
+  VkDeviceAddress sceneDescAddress() const;  // MeshletSceneDesc
+
+  // Meshlets of the level 0 of the render primitive, the task shaders are launched for those
+  uint32_t numMeshlets(int renderPrimID) const { return m_level0Meshlets[renderPrimID]; }
+  uint32_t totalMeshlets() const { return m_totalMeshlets; }
+
+private:
+  bool loadCache(const std::filesystem::path& path, std::vector<MeshletMesh>& meshes) const;
+  bool saveCache(const std::filesystem::path& path, const std::vector<MeshletMesh>& meshes) const;
+  void upload(Resources& res, const std::vector<MeshletMesh>& meshes, const std::vector<uint32_t>& deformedPrimitives);
+
+  nvvk::ResourceAllocator*  m_alloc{nullptr};
+  VkDevice                  m_device{VK_NULL_HANDLE};
+  std::vector<nvvk::Buffer> m_buffers;  // Arrays of the MeshletSceneDesc
+  nvvk::Buffer              m_sceneDesc;
+  std::vector<uint32_t>     m_level0Meshlets;
+  uint32_t                  m_totalMeshlets{0};
+};
+
+}  // namespace gltfr
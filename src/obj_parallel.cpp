@@ -0,0 +1,844 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+
+  Multithreaded OBJ loader
+
+  1. The file is memory mapped and split in chunks at line boundaries
+  2. Each chunk is parsed in parallel: vertex attributes, faces and state changes (o, g, usemtl)
+     Relative (negative) indices are kept relative to the chunk and fixed once all chunks are known
+  3. The state changes are replayed in order to split the faces in shapes and per-material primitives
+  4. Each shape is converted in parallel: triangulation, as tinyobj does, and de-duplication of the vertices
+  5. The buffers of all primitives are packed in a single glTF buffer
+
+  Materials are parsed by tinyobj and converted by TinyConverter, like the single threaded path.
+
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "obj_parallel.hpp"
+
+#include "fileformats/tiny_converter.hpp"
+#include "nvh/nvprint.hpp"
+#include "nvh/parallel_work.hpp"
+#include "nvh/timesampler.hpp"
+#include "tiny_obj_loader.h"
+
+// Local to application
+#include "mapped_file.hpp"
+
+namespace {
+
+constexpr int32_t NO_INDEX       = INT32_MIN;
+constexpr size_t  MIN_CHUNK_SIZE = 1 << 20;
+
+// Face corner, indices are 0-based. When the local mask is set, the index is relative to the start of the chunk.
+struct FaceVertex
+{
+  int32_t v         = NO_INDEX;
+  int32_t vt        = NO_INDEX;
+  int32_t vn        = NO_INDEX;
+  uint8_t localMask = 0;  // 1: v, 2: vt, 4: vn
+};
+
+// Change of the parser state, applying from the face `faceID` of the chunk
+struct StateChange
+{
+  enum Type
+  {
+    eGroup,
+    eMaterial
+  };
+  Type        type;
+  std::string name;
+  uint32_t    faceID;
+};
+
+struct ObjChunk
+{
+  const char* begin = nullptr;
+  const char* end   = nullptr;
+
+  std::vector<glm::vec3>   positions;
+  std::vector<glm::vec3>   normals;
+  std::vector<glm::vec2>   texcoords;
+  std::vector<FaceVertex>  corners;
+  std::vector<uint32_t>    faceOffsets = {0};  // First corner of each face, plus the end
+  std::vector<StateChange> changes;
+  std::vector<std::string> mtllibs;
+  bool                     unsupported = false;
+
+  // Number of attributes before this chunk
+  int32_t basePos = 0;
+  int32_t baseNrm = 0;
+  int32_t baseTex = 0;
+
+  uint32_t numFaces() const { return static_cast<uint32_t>(faceOffsets.size() - 1); }
+};
+
+struct Segment
+{
+  uint32_t chunk;
+  uint32_t faceBegin;
+  uint32_t faceEnd;
+};
+
+struct ObjPrimitive
+{
+  int                  material = -1;
+  std::vector<Segment> segments;
+
+  // Result of the conversion
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  std::vector<glm::vec2> texcoords;
+  std::vector<uint32_t>  indices;
+  glm::vec3              posMin{FLT_MAX};
+  glm::vec3              posMax{-FLT_MAX};
+};
+
+struct ObjShape
+{
+  std::string               name;
+  std::vector<ObjPrimitive> primitives;
+
+  ObjPrimitive& primitive(int material)
+  {
+    for(ObjPrimitive& p : primitives)
+    {
+      if(p.material == material)
+        return p;
+    }
+    primitives.push_back({.material = material});
+    return primitives.back();
+  }
+  bool hasFaces() const { return !primitives.empty(); }
+};
+
+inline bool isSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipSpaces(const char* p, const char* end)
+{
+  while(p < end && isSpace(*p))
+    p++;
+  return p;
+}
+
+inline bool parseFloat(const char*& p, const char* end, float& value)
+{
+  p = skipSpaces(p, end);
+  if(p < end && *p == '+')
+    p++;
+  auto result = std::from_chars(p, end, value);
+  if(result.ec != std::errc())
+    return false;
+  p = result.ptr;
+  return true;
+}
+
+inline bool parseInt(const char*& p, const char* end, int32_t& value)
+{
+  auto result = std::from_chars(p, end, value);
+  if(result.ec != std::errc())
+    return false;
+  p = result.ptr;
+  return true;
+}
+
+// Rest of the line, without the surrounding spaces
+inline std::string parseName(const char* p, const char* end)
+{
+  p = skipSpaces(p, end);
+  while(end > p && isSpace(end[-1]))
+    end--;
+  return {p, end};
+}
+
+// OBJ index to 0-based index: positive are absolute, negative are relative to the current count
+inline void setIndex(int32_t objIndex, int32_t localCount, int32_t& index, uint8_t& localMask, uint8_t bit)
+{
+  if(objIndex > 0)
+  {
+    index = objIndex - 1;
+  }
+  else if(objIndex < 0)
+  {
+    index = localCount + objIndex;
+    localMask |= bit;
+  }
+}
+
+bool parseFace(const char* p, const char* end, ObjChunk& chunk)
+{
+  const int32_t numPos = static_cast<int32_t>(chunk.positions.size());
+  const int32_t numTex = static_cast<int32_t>(chunk.texcoords.size());
+  const int32_t numNrm = static_cast<int32_t>(chunk.normals.size());
+
+  size_t numCorners = 0;
+  while(true)
+  {
+    p = skipSpaces(p, end);
+    if(p >= end)
+      break;
+
+    FaceVertex fv;
+    int32_t    value = 0;
+    if(!parseInt(p, end, value))
+      return false;
+    setIndex(value, numPos, fv.v, fv.localMask, 1);
+    if(p < end && *p == '/')
+    {
+      p++;
+      if(p < end && *p != '/')
+      {
+        if(!parseInt(p, end, value))
+          return false;
+        setIndex(value, numTex, fv.vt, fv.localMask, 2);
+      }
+      if(p < end && *p == '/')
+      {
+        p++;
+        if(!parseInt(p, end, value))
+          return false;
+        setIndex(value, numNrm, fv.vn, fv.localMask, 4);
+      }
+    }
+    chunk.corners.push_back(fv);
+    numCorners++;
+  }
+
+  if(numCorners < 3)
+  {
+    chunk.corners.resize(chunk.corners.size() - numCorners);
+    return true;
+  }
+  chunk.faceOffsets.push_back(static_cast<uint32_t>(chunk.corners.size()));
+  return true;
+}
+
+void parseLine(const char* p, const char* end, ObjChunk& chunk)
+{
+  p = skipSpaces(p, end);
+  if(p >= end || *p == '#')
+    return;
+
+  auto keyword = [&](const char* word) {
+    const size_t len = strlen(word);
+    if(size_t(end - p) > len && strncmp(p, word, len) == 0 && isSpace(p[len]))
+    {
+      p += len;
+      return true;
+    }
+    return false;
+  };
+
+  if(keyword("v"))
+  {
+    glm::vec3 v{};
+    if(!parseFloat(p, end, v.x) || !parseFloat(p, end, v.y) || !parseFloat(p, end, v.z))
+      chunk.unsupported = true;
+    chunk.positions.push_back(v);  // Vertex colors are ignored, as with the default tinyobj config
+  }
+  else if(keyword("vn"))
+  {
+    glm::vec3 n{};
+    if(!parseFloat(p, end, n.x) || !parseFloat(p, end, n.y) || !parseFloat(p, end, n.z))
+      chunk.unsupported = true;
+    chunk.normals.push_back(n);
+  }
+  else if(keyword("vt"))
+  {
+    glm::vec2 t{};
+    if(!parseFloat(p, end, t.x))
+      chunk.unsupported = true;
+    parseFloat(p, end, t.y);  // Optional
+    chunk.texcoords.push_back(t);
+  }
+  else if(keyword("f"))
+  {
+    if(!parseFace(p, end, chunk))
+      chunk.unsupported = true;
+  }
+  else if(keyword("o") || keyword("g"))
+  {
+    chunk.changes.push_back({StateChange::eGroup, parseName(p, end), chunk.numFaces()});
+  }
+  else if(keyword("usemtl"))
+  {
+    chunk.changes.push_back({StateChange::eMaterial, parseName(p, end), chunk.numFaces()});
+  }
+  else if(keyword("mtllib"))
+  {
+    chunk.mtllibs.push_back(parseName(p, end));
+  }
+  else if(keyword("l") || keyword("p") || keyword("curv") || keyword("surf"))
+  {
+    chunk.unsupported = true;  // Leave it to tinyobj
+  }
+}
+
+void parseChunk(ObjChunk& chunk)
+{
+  const char* p = chunk.begin;
+  while(p < chunk.end && !chunk.unsupported)
+  {
+    const char* eol = static_cast<const char*>(memchr(p, '\n', chunk.end - p));
+    eol             = eol ? eol : chunk.end;
+    if(eol > p && eol[-1] == '\\')
+      chunk.unsupported = true;  // Line continuation
+    parseLine(p, eol, chunk);
+    p = eol + 1;
+  }
+}
+
+struct VertexKey
+{
+  int32_t v, vt, vn;
+  bool    operator==(const VertexKey& o) const { return v == o.v && vt == o.vt && vn == o.vn; }
+};
+
+struct VertexKeyHash
+{
+  size_t operator()(const VertexKey& k) const
+  {
+    size_t h = std::hash<int32_t>()(k.v);
+    h ^= std::hash<int32_t>()(k.vt) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    h ^= std::hash<int32_t>()(k.vn) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h;
+  }
+};
+
+// Position of a face corner, nullptr when the index is out of range
+const glm::vec3* cornerPosition(const ObjChunk& chunk, uint32_t c, const std::vector<glm::vec3>& positions)
+{
+  const FaceVertex& fv = chunk.corners[c];
+  const int32_t     v  = (fv.localMask & 1) ? fv.v + chunk.basePos : fv.v;
+  return v >= 0 && v < static_cast<int32_t>(positions.size()) ? &positions[v] : nullptr;
+}
+
+// Normal of a polygon (Newell), for its corners without a normal. Zero for degenerate faces.
+glm::vec3 computeFaceNormal(const ObjChunk& chunk, uint32_t first, uint32_t last, const std::vector<glm::vec3>& positions)
+{
+  glm::vec3 n(0.0F);
+  for(uint32_t c = first; c < last; c++)
+  {
+    const glm::vec3* p0 = cornerPosition(chunk, c, positions);
+    const glm::vec3* p1 = cornerPosition(chunk, c + 1 < last ? c + 1 : first, positions);
+    if(p0 == nullptr || p1 == nullptr)
+      return glm::vec3(0.0F);
+    n += glm::vec3((p0->y - p1->y) * (p0->z + p1->z), (p0->z - p1->z) * (p0->x + p1->x), (p0->x - p1->x) * (p0->y + p1->y));
+  }
+  const float length = glm::length(n);
+  return length > 0.0F ? n / length : glm::vec3(0.0F);
+}
+
+// Point in the triangle, test of tinyobj
+bool pnpoly(const float vx[3], const float vy[3], float tx, float ty)
+{
+  bool inside = false;
+  for(int i = 0, j = 2; i < 3; j = i++)
+  {
+    if(((vy[i] > ty) != (vy[j] > ty)) && (tx < (vx[j] - vx[i]) * (ty - vy[i]) / (vy[j] - vy[i]) + vx[i]))
+      inside = !inside;
+  }
+  return inside;
+}
+
+// Corners of the triangles of a face, as tinyobj triangulates them such that the output is the same:
+// - Quads are split along their shortest diagonal
+// - Larger polygons are ear clipped, in the plane of the two axes the first corner found is the most facing
+// False when an index is out of range.
+bool triangulateFace(const ObjChunk& chunk, uint32_t first, uint32_t last, const std::vector<glm::vec3>& positions, std::vector<uint32_t>& triangles)
+{
+  const uint32_t numCorners = last - first;
+  for(uint32_t c = first; c < last; c++)
+  {
+    if(cornerPosition(chunk, c, positions) == nullptr)
+      return false;
+  }
+  auto position = [&](uint32_t c) { return *cornerPosition(chunk, c, positions); };
+
+  if(numCorners == 3)
+  {
+    triangles.insert(triangles.end(), {first, first + 1, first + 2});
+    return true;
+  }
+  if(numCorners == 4)
+  {
+    const glm::vec3 e02 = position(first + 2) - position(first);
+    const glm::vec3 e13 = position(first + 3) - position(first + 1);
+    if(glm::dot(e02, e02) < glm::dot(e13, e13))
+      triangles.insert(triangles.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+    else
+      triangles.insert(triangles.end(), {first, first + 1, first + 3, first + 1, first + 2, first + 3});
+    return true;
+  }
+
+  // The two axes to work in
+  int axes[2] = {1, 2};
+  for(uint32_t k = 0; k < numCorners; k++)
+  {
+    const glm::vec3 v0 = position(first + k % numCorners);
+    const glm::vec3 v1 = position(first + (k + 1) % numCorners);
+    const glm::vec3 v2 = position(first + (k + 2) % numCorners);
+    const glm::vec3 e0 = v1 - v0;
+    const glm::vec3 e1 = v2 - v1;
+    const float     cx = std::fabs(e0.y * e1.z - e0.z * e1.y);
+    const float     cy = std::fabs(e0.z * e1.x - e0.x * e1.z);
+    const float     cz = std::fabs(e0.x * e1.y - e0.y * e1.x);
+    if(cx > FLT_EPSILON || cy > FLT_EPSILON || cz > FLT_EPSILON)
+    {
+      if(!(cx > cy && cx > cz))
+      {
+        axes[0] = 0;
+        if(cz > cx && cz > cy)
+          axes[1] = 1;
+      }
+      break;
+    }
+  }
+
+  // Orientation of the polygon in these axes
+  float area = 0.0F;
+  for(uint32_t k = 0; k < numCorners; k++)
+  {
+    const glm::vec3 v0 = position(first + k);
+    const glm::vec3 v1 = position(first + (k + 1) % numCorners);
+    area += (v0[axes[0]] * v1[axes[1]] - v1[axes[0]] * v0[axes[1]]) * 0.5F;
+  }
+
+  std::vector<uint32_t> remaining(numCorners);
+  for(uint32_t k = 0; k < numCorners; k++)
+    remaining[k] = first + k;
+
+  size_t guess             = 0;
+  size_t iterations        = remaining.size();  // Left without removing a corner
+  size_t previousRemaining = remaining.size();
+  while(remaining.size() > 3 && iterations > 0)
+  {
+    const size_t n = remaining.size();
+    if(guess >= n)
+      guess -= n;
+    if(previousRemaining != n)
+    {
+      previousRemaining = n;
+      iterations        = n;
+    }
+    else
+    {
+      iterations--;
+    }
+
+    uint32_t ind[3];
+    float    vx[3];
+    float    vy[3];
+    for(size_t k = 0; k < 3; k++)
+    {
+      ind[k]              = remaining[(guess + k) % n];
+      const glm::vec3 pos = position(ind[k]);
+      vx[k]               = pos[axes[0]];
+      vy[k]               = pos[axes[1]];
+    }
+
+    // A reflex corner, turning against the polygon
+    const float cross = (vx[1] - vx[0]) * (vy[2] - vy[1]) - (vy[1] - vy[0]) * (vx[2] - vx[1]);
+    if(cross * area < 0.0F)
+    {
+      guess++;
+      continue;
+    }
+
+    // No other corner in the triangle
+    bool overlap = false;
+    for(size_t other = 3; other < n && !overlap; other++)
+    {
+      const glm::vec3 pos = position(remaining[(guess + other) % n]);
+      overlap             = pnpoly(vx, vy, pos[axes[0]], pos[axes[1]]);
+    }
+    if(overlap)
+    {
+      guess++;
+      continue;
+    }
+
+    // An ear, its middle corner is removed
+    triangles.insert(triangles.end(), {ind[0], ind[1], ind[2]});
+    remaining.erase(remaining.begin() + static_cast<ptrdiff_t>((guess + 1) % n));
+  }
+  if(remaining.size() == 3)
+    triangles.insert(triangles.end(), {remaining[0], remaining[1], remaining[2]});
+  return true;
+}
+
+// Triangulate the faces of the primitive and de-duplicate its vertices
+bool convertPrimitive(ObjPrimitive&                 prim,
+                      const std::vector<ObjChunk>&  chunks,
+                      const std::vector<glm::vec3>& positions,
+                      const std::vector<glm::vec3>& normals,
+                      const std::vector<glm::vec2>& texcoords)
+{
+  std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexToIdx;
+  bool                                                   hasNormal   = false;
+  bool                                                   hasTexcoord = false;
+
+  // In a file with normals, the corners without one get the normal of their face: their vertices
+  // are not shared with other faces, the key has the face in place of the normal (negative)
+  uint32_t  faceCount = 0;
+  glm::vec3 faceNormal{0.0F};
+
+  auto addVertex = [&](const ObjChunk& chunk, const FaceVertex& fv) -> bool {
+    VertexKey key{fv.v, fv.vt, fv.vn};
+    if(fv.localMask & 1)
+      key.v += chunk.basePos;
+    if(fv.localMask & 2)
+      key.vt += chunk.baseTex;
+    if(fv.localMask & 4)
+      key.vn += chunk.baseNrm;
+    if(key.v < 0 || key.v >= static_cast<int32_t>(positions.size()))
+      return false;
+    if(key.vt != NO_INDEX && (key.vt < 0 || key.vt >= static_cast<int32_t>(texcoords.size())))
+      return false;
+    if(key.vn != NO_INDEX && (key.vn < 0 || key.vn >= static_cast<int32_t>(normals.size())))
+      return false;
+    const bool useFaceNormal = key.vn == NO_INDEX && !normals.empty();
+    if(useFaceNormal)
+      key.vn = -1 - static_cast<int32_t>(faceCount);
+
+    auto [it, inserted] = vertexToIdx.try_emplace(key, static_cast<uint32_t>(prim.positions.size()));
+    if(inserted)
+    {
+      const glm::vec3& pos = positions[key.v];
+      prim.positions.push_back(pos);
+      prim.posMin = glm::min(prim.posMin, pos);
+      prim.posMax = glm::max(prim.posMax, pos);
+      prim.normals.push_back(useFaceNormal ? faceNormal : key.vn != NO_INDEX ? normals[key.vn] : glm::vec3(0));
+      // OBJ texture coordinates have their origin at the bottom
+      prim.texcoords.push_back(key.vt != NO_INDEX ? glm::vec2(texcoords[key.vt].x, 1.0F - texcoords[key.vt].y) : glm::vec2(0));
+      hasNormal |= !useFaceNormal && key.vn != NO_INDEX;  // Otherwise, the normals are generated with the scene
+      hasTexcoord |= key.vt != NO_INDEX;
+    }
+    prim.indices.push_back(it->second);
+    return true;
+  };
+
+  std::vector<uint32_t> triangles;
+  for(const Segment& seg : prim.segments)
+  {
+    const ObjChunk& chunk = chunks[seg.chunk];
+    for(uint32_t f = seg.faceBegin; f < seg.faceEnd; f++)
+    {
+      const uint32_t first = chunk.faceOffsets[f];
+      const uint32_t last  = chunk.faceOffsets[f + 1];
+      if(!normals.empty())
+        faceNormal = computeFaceNormal(chunk, first, last, positions);
+      faceCount++;
+      triangles.clear();
+      if(!triangulateFace(chunk, first, last, positions, triangles))
+        return false;
+      for(uint32_t c : triangles)
+      {
+        if(!addVertex(chunk, chunk.corners[c]))
+          return false;
+      }
+    }
+  }
+
+  if(!hasNormal)
+    prim.normals.clear();
+  if(!hasTexcoord)
+    prim.texcoords.clear();
+  return true;
+}
+
+// Materials, and their textures, converted by TinyConverter from the content of the .mtl files
+void convertMaterials(const std::filesystem::path&          objDir,
+                      const std::vector<std::string>&       mtllibs,
+                      tinygltf::Model&                      model,
+                      std::unordered_map<std::string, int>& materialIDs)
+{
+  std::string mtlText;
+  for(const std::string& mtllib : mtllibs)
+  {
+    std::ifstream     file(objDir / mtllib);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    mtlText += ss.str() + "\n";
+  }
+
+  tinyobj::ObjReaderConfig readerConfig;
+  readerConfig.mtl_search_path = objDir.string();
+  tinyobj::ObjReader reader;
+  reader.ParseFromString(mtlText.empty() ? "" : "mtllib materials.mtl\n", mtlText, readerConfig);
+
+  TinyConverter converter;
+  converter.convert(model, reader);
+
+  for(size_t i = 0; i < reader.GetMaterials().size(); i++)
+  {
+    materialIDs.try_emplace(reader.GetMaterials()[i].name, static_cast<int>(i));
+  }
+
+  // Geometry is added by the caller
+  model.meshes.clear();
+  model.nodes.clear();
+  model.scenes.clear();
+  model.accessors.clear();
+  model.bufferViews.clear();
+  model.buffers.clear();
+}
+
+template <typename T>
+int addAccessor(tinygltf::Model& model, size_t byteOffset, const std::vector<T>& data, int componentType, int type, int target)
+{
+  tinygltf::BufferView view;
+  view.buffer     = 0;
+  view.byteOffset = byteOffset;
+  view.byteLength = data.size() * sizeof(T);
+  view.target     = target;
+  model.bufferViews.push_back(view);
+
+  tinygltf::Accessor accessor;
+  accessor.bufferView    = static_cast<int>(model.bufferViews.size() - 1);
+  accessor.componentType = componentType;
+  accessor.type          = type;
+  accessor.count         = data.size();
+  model.accessors.push_back(accessor);
+  return static_cast<int>(model.accessors.size() - 1);
+}
+
+}  // namespace
+
+
+bool loadObjParallel(const std::string& filename, tinygltf::Model& model)
+{
+  nvh::ScopedTimer st(__FUNCTION__);
+
+  gltfr::MappedFile file;
+  if(!file.open(filename))
+    return false;
+
+  // Splitting the file in chunks, at line boundaries
+  const char*    text       = reinterpret_cast<const char*>(file.data());
+  const size_t   size       = file.size();
+  const uint32_t numThreads = std::max(1U, std::thread::hardware_concurrency());
+  const size_t   chunkSize  = std::max(MIN_CHUNK_SIZE, size / (numThreads * 4) + 1);
+
+  std::vector<ObjChunk> chunks;
+  for(const char* p = text; p < text + size;)
+  {
+    const char* end = std::min(p + chunkSize, text + size);
+    const char* eol = static_cast<const char*>(memchr(end, '\n', text + size - end));
+    end             = eol ? eol + 1 : text + size;
+    chunks.push_back({.begin = p, .end = end});
+    p = end;
+  }
+
+  // Parsing all chunks
+  nvh::parallel_batches<1>(
+      chunks.size(), [&](uint64_t i) { parseChunk(chunks[i]); }, numThreads);
+
+  std::vector<std::string> mtllibs;
+  int32_t                  numPos = 0, numNrm = 0, numTex = 0;
+  for(ObjChunk& chunk : chunks)
+  {
+    if(chunk.unsupported)
+    {
+      LOGW("OBJ: unsupported elements, using the single threaded loader\n");
+      return false;
+    }
+    chunk.basePos = numPos;
+    chunk.baseNrm = numNrm;
+    chunk.baseTex = numTex;
+    numPos += static_cast<int32_t>(chunk.positions.size());
+    numNrm += static_cast<int32_t>(chunk.normals.size());
+    numTex += static_cast<int32_t>(chunk.texcoords.size());
+    mtllibs.insert(mtllibs.end(), chunk.mtllibs.begin(), chunk.mtllibs.end());
+  }
+
+  // Gathering the attributes of all chunks
+  std::vector<glm::vec3> positions(numPos), normals(numNrm);
+  std::vector<glm::vec2> texcoords(numTex);
+  nvh::parallel_batches<1>(
+      chunks.size(),
+      [&](uint64_t i) {
+        ObjChunk& chunk = chunks[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.basePos);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.baseNrm);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.baseTex);
+        chunk.positions = {};
+        chunk.normals   = {};
+        chunk.texcoords = {};
+      },
+      numThreads);
+
+  std::unordered_map<std::string, int> materialIDs;
+  convertMaterials(std::filesystem::path(filename).parent_path(), mtllibs, model, materialIDs);
+
+  // Replaying the state changes to split the faces in shapes and primitives
+  std::vector<ObjShape> shapes(1);
+  int                   material = -1;
+  for(uint32_t c = 0; c < chunks.size(); c++)
+  {
+    const ObjChunk& chunk = chunks[c];
+    uint32_t        face  = 0;
+    auto            flush = [&](uint32_t faceEnd) {
+      if(faceEnd > face)
+        shapes.back().primitive(material).segments.push_back({c, face, faceEnd});
+      face = faceEnd;
+    };
+    for(const StateChange& change : chunk.changes)
+    {
+      flush(change.faceID);
+      if(change.type == StateChange::eGroup)
+      {
+        if(shapes.back().hasFaces())
+          shapes.emplace_back();
+        shapes.back().name = change.name;
+      }
+      else
+      {
+        auto it  = materialIDs.find(change.name);
+        material = it != materialIDs.end() ? it->second : -1;
+      }
+    }
+    flush(chunk.numFaces());
+  }
+  if(!shapes.back().hasFaces())
+    shapes.pop_back();
+
+  // Converting each shape
+  std::vector<ObjPrimitive*> primitives;
+  for(ObjShape& shape : shapes)
+  {
+    for(ObjPrimitive& prim : shape.primitives)
+      primitives.push_back(&prim);
+  }
+  std::atomic<bool> valid = true;
+  nvh::parallel_batches<1>(
+      primitives.size(),
+      [&](uint64_t i) {
+        if(!convertPrimitive(*primitives[i], chunks, positions, normals, texcoords))
+          valid = false;
+      },
+      numThreads);
+  if(!valid)
+  {
+    LOGW("OBJ: index out of range, using the single threaded loader\n");
+    return false;
+  }
+
+  if(model.materials.empty())
+  {
+    model.materials.emplace_back();  // Default material
+  }
+
+  // Packing all primitives in a single buffer
+  std::vector<size_t> primOffsets(primitives.size());
+  size_t              bufferSize = 0;
+  for(size_t i = 0; i < primitives.size(); i++)
+  {
+    primOffsets[i] = bufferSize;
+    const ObjPrimitive& prim = *primitives[i];
+    bufferSize += prim.indices.size() * sizeof(uint32_t) + prim.positions.size() * sizeof(glm::vec3)
+                  + prim.normals.size() * sizeof(glm::vec3) + prim.texcoords.size() * sizeof(glm::vec2);
+  }
+  model.buffers.emplace_back();
+  model.buffers[0].data.resize(bufferSize);
+
+  size_t primID = 0;
+  model.scenes.emplace_back();
+  for(ObjShape& shape : shapes)
+  {
+    tinygltf::Mesh mesh;
+    mesh.name = shape.name;
+    for(ObjPrimitive& prim : shape.primitives)
+    {
+      size_t offset = primOffsets[primID++];
+
+      tinygltf::Primitive primitive;
+      primitive.mode     = TINYGLTF_MODE_TRIANGLES;
+      primitive.material = prim.material < static_cast<int>(model.materials.size()) ? prim.material : -1;
+      primitive.indices  = addAccessor(model, offset, prim.indices, TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT,
+                                       TINYGLTF_TYPE_SCALAR, TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+      offset += prim.indices.size() * sizeof(uint32_t);
+
+      primitive.attributes["POSITION"] = addAccessor(model, offset, prim.positions, TINYGLTF_COMPONENT_TYPE_FLOAT,
+                                                     TINYGLTF_TYPE_VEC3, TINYGLTF_TARGET_ARRAY_BUFFER);
+      model.accessors.back().minValues = {prim.posMin.x, prim.posMin.y, prim.posMin.z};
+      model.accessors.back().maxValues = {prim.posMax.x, prim.posMax.y, prim.posMax.z};
+      offset += prim.positions.size() * sizeof(glm::vec3);
+
+      if(!prim.normals.empty())
+      {
+        primitive.attributes["NORMAL"] = addAccessor(model, offset, prim.normals, TINYGLTF_COMPONENT_TYPE_FLOAT,
+                                                     TINYGLTF_TYPE_VEC3, TINYGLTF_TARGET_ARRAY_BUFFER);
+        offset += prim.normals.size() * sizeof(glm::vec3);
+      }
+      if(!prim.texcoords.empty())
+      {
+        primitive.attributes["TEXCOORD_0"] = addAccessor(model, offset, prim.texcoords, TINYGLTF_COMPONENT_TYPE_FLOAT,
+                                                         TINYGLTF_TYPE_VEC2, TINYGLTF_TARGET_ARRAY_BUFFER);
+      }
+      mesh.primitives.push_back(primitive);
+    }
+    model.meshes.push_back(mesh);
+
+    tinygltf::Node node;
+    node.name = shape.name;
+    node.mesh = static_cast<int>(model.meshes.size() - 1);
+    model.nodes.push_back(node);
+    model.scenes[0].nodes.push_back(static_cast<int>(model.nodes.size() - 1));
+  }
+  model.defaultScene = 0;
+
+  // Copying the data of all primitives in the buffer
+  nvh::parallel_batches<1>(
+      primitives.size(),
+      [&](uint64_t i) {
+        const ObjPrimitive& prim = *primitives[i];
+        uint8_t*            dst  = model.buffers[0].data.data() + primOffsets[i];
+        auto                copy = [&](const auto& vec) {
+          memcpy(dst, vec.data(), vec.size() * sizeof(vec[0]));
+          dst += vec.size() * sizeof(vec[0]);
+        };
+        copy(prim.indices);
+        copy(prim.positions);
+        copy(prim.normals);
+        copy(prim.texcoords);
+      },
+      numThreads);
+
+  return true;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <string>
+#include <tiny_gltf.h>
+
+// Multithreaded loading of an OBJ file into a glTF model
+// - The text is split in chunks, parsed in parallel
+// - Each shape is converted in parallel, with its vertices de-duplicated
+// - Materials are converted by TinyConverter, as with the single threaded path
+// Returns false if the file can't be read or uses unsupported elements; the caller should
+// then use tinyobj and TinyConverter.
+bool loadObjParallel(const std::string& filename, tinygltf::Model& model);
@@ -0,0 +1,853 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "opacity_micromap.hpp"
+
+#include "fileformats/tinygltf_utils.hpp"
+#include "nvh/nvprint.hpp"
+#include "nvh/parallel_work.hpp"
+#include "nvh/timesampler.hpp"
+#include "nvvk/buffers_vk.hpp"
+#include "nvvk/error_vk.hpp"
+#include "stb_image.h"
+
+// Local to application
+#include "cache_utils.hpp"
+#include "gltf_accessor.hpp"
+
+constexpr uint64_t OMM_CACHE_MAGIC   = 0x4d4d4f4652544c47ULL;  // "GLTRFOMM"
+constexpr uint32_t OMM_CACHE_VERSION = 1;
+
+namespace {
+constexpr uint32_t     kMaxSubdivisionLevel    = 5;     // 1024 micro-triangles, 256 bytes per triangle
+constexpr float        kTexelsPerMicroTriangle = 4.0F;  // Finest level wanted by the bake
+constexpr int          kMaxFootprint           = 64;    // Texels on a side, larger micro-triangles are unknown
+constexpr float        kCutoffMargin           = 1.0F / 1024.0F;  // Precision of the filtering, around the cutoff
+constexpr VkDeviceSize kInputAlignment         = 256;  // Of the build inputs of the micromap
+
+// 4-state values of a micro-triangle
+constexpr uint8_t kTransparent        = 0;
+constexpr uint8_t kOpaque             = 1;
+constexpr uint8_t kUnknownTransparent = 2;
+constexpr uint8_t kUnknownOpaque      = 3;
+
+struct OmmCacheHeader
+{
+  uint64_t magic         = OMM_CACHE_MAGIC;
+  uint32_t version       = OMM_CACHE_VERSION;
+  uint32_t numPrimitives = 0;
+};
+
+// Followed by the arrays of the primitive
+struct OmmCachePrimitive
+{
+  uint32_t renderPrimID{0};
+  uint32_t numIndices{0};
+  uint32_t numTriangles{0};
+  uint32_t dataSize{0};
+};
+
+template <typename T>
+void appendArray(std::vector<char>& data, const std::vector<T>& array)
+{
+  const char* begin = reinterpret_cast<const char*>(array.data());
+  data.insert(data.end(), begin, begin + array.size() * sizeof(T));
+}
+
+template <typename T>
+bool readArray(const std::vector<char>& data, size_t& offset, uint32_t count, std::vector<T>& array)
+{
+  if(offset + count * sizeof(T) > data.size())
+    return false;
+  array.resize(count);
+  std::memcpy(array.data(), data.data() + offset, count * sizeof(T));
+  offset += count * sizeof(T);
+  return true;
+}
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// What the any-hit shaders read for the alpha test (getOpacity)
+struct BakeMaterial
+{
+  float alphaFactor{1.0F};
+  float alphaCutoff{0.5F};
+  int   imageID{-1};  // Of the base color texture, -1: no texture
+  int   wrapS{TINYGLTF_TEXTURE_WRAP_REPEAT};
+  int   wrapT{TINYGLTF_TEXTURE_WRAP_REPEAT};
+};
+
+struct BakeInput
+{
+  uint32_t              renderPrimID{0};
+  int                   materialID{-1};
+  std::vector<float>    texCoords;  // TEXCOORD_0
+  std::vector<float>    alphas;     // Of COLOR_0, empty when there are no vertex colors
+  std::vector<uint32_t> indices;
+};
+
+struct AlphaImage
+{
+  int                  width{0};
+  int                  height{0};
+  std::vector<uint8_t> alpha;
+  std::vector<char>    encoded;  // File or buffer view contents, for the key of the cache
+  uint64_t             hash{0};
+
+  float texel(int x, int y, int wrapS, int wrapT) const
+  {
+    return alpha[size_t(wrap(y, height, wrapT)) * width + wrap(x, width, wrapS)] / 255.0F;
+  }
+
+  static int wrap(int x, int size, int mode)
+  {
+    switch(mode)
+    {
+      case TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE:
+        return std::clamp(x, 0, size - 1);
+      case TINYGLTF_TEXTURE_WRAP_MIRRORED_REPEAT: {
+        const int m = ((x % (2 * size)) + 2 * size) % (2 * size);
+        return m < size ? m : 2 * size - 1 - m;
+      }
+      default:
+        return ((x % size) + size) % size;
+    }
+  }
+};
+
+// Encoded image, from its buffer view or its file, as the texture streamer reads it
+bool readEncodedImage(const tinygltf::Model& model, const tinygltf::Image& image, const std::filesystem::path& baseDir, std::vector<char>& encoded)
+{
+  if(image.bufferView >= 0)
+  {
+    const tinygltf::BufferView& view = model.bufferViews[image.bufferView];
+    const char* begin = reinterpret_cast<const char*>(model.buffers[view.buffer].data.data() + view.byteOffset);
+    encoded.assign(begin, begin + view.byteLength);
+    return true;
+  }
+  if(!image.uri.empty() && image.uri.find("data:") != 0)
+    return readCacheFile(baseDir / image.uri, encoded);
+  return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Micro-triangles in the order of the bird curve, as defined by the Vulkan specification.
+// The barycentrics (u, v) are the weights of the second and third vertices of the triangle.
+//
+uint32_t extractEvenBits(uint32_t x)
+{
+  x &= 0x55555555;
+  x = (x | (x >> 1)) & 0x33333333;
+  x = (x | (x >> 2)) & 0x0f0f0f0f;
+  x = (x | (x >> 4)) & 0x00ff00ff;
+  x = (x | (x >> 8)) & 0x0000ffff;
+  return x;
+}
+
+// Exclusive prefix XOR
+uint32_t prefixEor(uint32_t x)
+{
+  x ^= x >> 1;
+  x ^= x >> 2;
+  x ^= x >> 4;
+  x ^= x >> 8;
+  return x;
+}
+
+void microTriangle(uint32_t index, uint32_t level, glm::vec2 bary[3])
+{
+  if(level == 0)
+  {
+    bary[0] = {0.0F, 0.0F};
+    bary[1] = {1.0F, 0.0F};
+    bary[2] = {0.0F, 1.0F};
+    return;
+  }
+
+  const uint32_t b0   = extractEvenBits(index);
+  const uint32_t b1   = extractEvenBits(index >> 1);
+  const uint32_t fx   = prefixEor(b0);
+  const uint32_t fy   = prefixEor(b0 & ~b1);
+  const uint32_t t    = fy ^ b1;
+  const uint32_t mask = (1U << level) - 1;
+
+  uint32_t       iu      = ((fx & ~t) | (b0 & ~t) | (~b0 & ~fx & t)) & mask;
+  uint32_t       iv      = (fy ^ b0) & mask;
+  const uint32_t iw      = ((~fx & ~t) | (b0 & ~t) | (~b0 & fx & t)) & mask;
+  const bool     upright = ((iu ^ iv ^ iw) & 1) != 0;
+  if(!upright)
+  {
+    iu++;
+    iv++;
+  }
+
+  const float scale = 1.0F / float(1U << level);
+  const float d     = upright ? scale : -scale;
+  bary[0]           = {iu * scale, iv * scale};
+  bary[1]           = {bary[0].x + d, bary[0].y};
+  bary[2]           = {bary[0].x, bary[0].y + d};
+}
+
+// Level with about kTexelsPerMicroTriangle texels per micro-triangle, each level has 4 times more
+uint32_t subdivisionLevel(float texelArea, uint32_t maxLevel)
+{
+  const float microTriangles = texelArea / kTexelsPerMicroTriangle;
+  uint32_t    level          = 0;
+  while(level < maxLevel && float(1U << (2 * level)) < microTriangles)
+    level++;
+  return level;
+}
+
+//--------------------------------------------------------------------------------------------------
+// State of a micro-triangle, from the range of alpha over the texels its bilinear samples can read.
+// 'margin' are texels added on each side, for the precision of the texture coordinates.
+//
+uint8_t classify(const BakeMaterial& material, const AlphaImage* image, const glm::vec2 texel[3], const float alpha[3], float margin)
+{
+  float textureMin = 1.0F;
+  float textureMax = 1.0F;
+  if(image != nullptr)
+  {
+    const glm::vec2 lo = glm::min(glm::min(texel[0], texel[1]), texel[2]) - 0.5F - margin;
+    const glm::vec2 hi = glm::max(glm::max(texel[0], texel[1]), texel[2]) - 0.5F + margin;
+    const int       x0 = static_cast<int>(std::floor(lo.x));
+    const int       y0 = static_cast<int>(std::floor(lo.y));
+    const int       x1 = static_cast<int>(std::floor(hi.x)) + 1;
+    const int       y1 = static_cast<int>(std::floor(hi.y)) + 1;
+    if(x1 - x0 > kMaxFootprint || y1 - y0 > kMaxFootprint)
+      return kUnknownOpaque;
+
+    textureMin = 1.0F;
+    textureMax = 0.0F;
+    for(int y = y0; y <= y1; y++)
+    {
+      for(int x = x0; x <= x1; x++)
+      {
+        const float a = image->texel(x, y, material.wrapS, material.wrapT);
+        textureMin    = std::min(textureMin, a);
+        textureMax    = std::max(textureMax, a);
+      }
+    }
+  }
+
+  // The vertex colors are interpolated linearly, their range is at the corners
+  const float colorMin = std::max(std::min(std::min(alpha[0], alpha[1]), alpha[2]), 0.0F);
+  const float colorMax = std::max(std::max(alpha[0], alpha[1]), alpha[2]);
+  const float factor   = std::max(material.alphaFactor, 0.0F);
+  const float minAlpha = factor * textureMin * colorMin;
+  const float maxAlpha = factor * textureMax * colorMax;
+
+  if(minAlpha >= material.alphaCutoff + kCutoffMargin)
+    return kOpaque;
+  if(maxAlpha < material.alphaCutoff - kCutoffMargin)
+    return kTransparent;
+  return (minAlpha + maxAlpha) * 0.5F >= material.alphaCutoff ? kUnknownOpaque : kUnknownTransparent;
+}
+
+uint32_t specialIndex(VkOpacityMicromapSpecialIndexEXT index)
+{
+  return static_cast<uint32_t>(static_cast<int32_t>(index));
+}
+
+bool isSpecialIndex(uint32_t index)
+{
+  return static_cast<int32_t>(index) < 0;
+}
+}  // namespace
+
+bool gltfr::OpacityMicromaps::isSupported(VkPhysicalDevice physicalDevice)
+{
+  uint32_t count = 0;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr);
+  std::vector<VkExtensionProperties> extensions(count);
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, extensions.data());
+
+  bool hasMicromap = false;
+  for(const VkExtensionProperties& ext : extensions)
+  {
+    hasMicromap |= (strcmp(ext.extensionName, VK_EXT_OPACITY_MICROMAP_EXTENSION_NAME) == 0);
+  }
+  if(!hasMicromap)
+    return false;
+
+  VkPhysicalDeviceOpacityMicromapFeaturesEXT micromapFeatures{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_OPACITY_MICROMAP_FEATURES_EXT};
+  VkPhysicalDeviceFeatures2 features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &micromapFeatures};
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+  return micromapFeatures.micromap == VK_TRUE;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The primitives are baked on all cores, unless the cache has them
+//
+bool gltfr::OpacityMicromaps::create(nvvk::ResourceAllocator*     alloc,
+                                     VkPhysicalDevice             physicalDevice,
+                                     nvvk::CommandPool&           cmdPool,
+                                     const nvh::gltf::Scene&      scene,
+                                     const std::vector<uint32_t>& deformedPrimitives,
+                                     const std::filesystem::path& baseDir,
+                                     bool                         halfTexCoords,
+                                     bool                         useCache)
+{
+  nvh::ScopedTimer st(__FUNCTION__);
+  destroy();
+  m_alloc  = alloc;
+  m_device = alloc->getDevice();
+
+  const tinygltf::Model&                         model      = scene.getModel();
+  const std::vector<nvh::gltf::RenderPrimitive>& primitives = scene.getRenderPrimitives();
+
+  // The material of each render primitive, when all its render nodes have the same one
+  std::vector<int> primMaterial(primitives.size(), -2);  // -2: no render node, -1: not baked
+  for(const nvh::gltf::RenderNode& renderNode : scene.getRenderNodes())
+  {
+    int& materialID = primMaterial[renderNode.renderPrimID];
+    materialID      = (materialID == -2 || materialID == renderNode.materialID) ? renderNode.materialID : -1;
+  }
+  for(uint32_t primID : deformedPrimitives)
+    primMaterial[primID] = -1;
+
+  // Only the alpha test decides the opacity: the shadow rays are stopped by these materials
+  std::vector<BakeMaterial> materials(model.materials.size());
+  std::vector<bool>         bakeable(model.materials.size(), false);
+  for(size_t i = 0; i < model.materials.size(); i++)
+  {
+    const tinygltf::Material& material = model.materials[i];
+    if(material.alphaMode != "MASK" || tinygltf::utils::hasElementName(material.extensions, KHR_MATERIALS_TRANSMISSION_EXTENSION_NAME)
+       || tinygltf::utils::hasElementName(material.extensions, "KHR_materials_pbrSpecularGlossiness"))
+      continue;
+
+    BakeMaterial& bake  = materials[i];
+    bake.alphaFactor    = static_cast<float>(material.pbrMetallicRoughness.baseColorFactor[3]);
+    bake.alphaCutoff    = static_cast<float>(material.alphaCutoff);
+    const int textureID = material.pbrMetallicRoughness.baseColorTexture.index;
+    if(textureID >= 0)
+    {
+      if(textureID >= static_cast<int>(model.textures.size()))
+        continue;
+      const tinygltf::Texture& texture = model.textures[textureID];
+      if(texture.source < 0 || texture.source >= static_cast<int>(model.images.size()))
+        continue;
+      bake.imageID = texture.source;
+      if(texture.sampler >= 0 && texture.sampler < static_cast<int>(model.samplers.size()))
+      {
+        bake.wrapS = model.samplers[texture.sampler].wrapS;
+        bake.wrapT = model.samplers[texture.sampler].wrapT;
+      }
+    }
+    bakeable[i] = true;
+  }
+
+  std::vector<BakeInput> inputs;
+  for(size_t i = 0; i < primitives.size(); i++)
+  {
+    const int materialID = primMaterial[i];
+    if(materialID < 0 || materialID >= static_cast<int>(bakeable.size()) || !bakeable[materialID])
+      continue;
+    const tinygltf::Primitive& primitive    = *primitives[i].pPrimitive;
+    const bool                 hasTexCoords = primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end();
+    if(primitive.mode != TINYGLTF_MODE_TRIANGLES || primitive.attributes.find("POSITION") == primitive.attributes.end()
+       || (materials[materialID].imageID >= 0 && !hasTexCoords)
+       || tinygltf::utils::hasElementName(primitive.extensions, "KHR_materials_variants"))
+      continue;
+    inputs.push_back({.renderPrimID = static_cast<uint32_t>(i), .materialID = materialID});
+  }
+  if(inputs.empty())
+    return false;
+
+  // Geometry of the primitives and encoded images, the key of the cache
+  std::vector<int> imageIDs;
+  for(const BakeInput& input : inputs)
+  {
+    if(materials[input.materialID].imageID >= 0)
+      imageIDs.push_back(materials[input.materialID].imageID);
+  }
+  std::sort(imageIDs.begin(), imageIDs.end());
+  imageIDs.erase(std::unique(imageIDs.begin(), imageIDs.end()), imageIDs.end());
+  std::vector<AlphaImage> images(model.images.size());
+  std::vector<uint8_t>    imageRead(model.images.size(), 0);
+  const uint32_t          numThreads = std::max(1U, std::thread::hardware_concurrency());
+  nvh::parallel_batches<1>(
+      imageIDs.size(),
+      [&](uint64_t i) {
+        AlphaImage& image = images[imageIDs[i]];
+        if(readEncodedImage(model, model.images[imageIDs[i]], baseDir, image.encoded))
+        {
+          image.hash             = Hasher().addWords(image.encoded.data(), image.encoded.size()).value;
+          imageRead[imageIDs[i]] = 1;
+        }
+      },
+      std::min(static_cast<uint32_t>(std::max<size_t>(imageIDs.size(), 1)), numThreads));
+  nvh::parallel_batches<1>(
+      inputs.size(),
+      [&](uint64_t i) {
+        BakeInput&                 input       = inputs[i];
+        const tinygltf::Primitive& primitive   = *primitives[input.renderPrimID].pPrimitive;
+        const int                  position    = primitive.attributes.at("POSITION");
+        const size_t               numVertices = model.accessors[position].count;
+        input.indices                          = readIndices(model, primitive.indices, numVertices);
+        const auto texCoords                   = primitive.attributes.find("TEXCOORD_0");
+        input.texCoords = texCoords != primitive.attributes.end() ? readAccessor(model, texCoords->second, 2) :
+                                                                     std::vector<float>(numVertices * 2, 0.0F);
+        const auto colors = primitive.attributes.find("COLOR_0");
+        if(colors != primitive.attributes.end() && model.accessors[colors->second].type == TINYGLTF_TYPE_VEC4)
+        {
+          const std::vector<float> rgba = readAccessor(model, colors->second, 4);
+          input.alphas.resize(rgba.size() / 4);
+          for(size_t v = 0; v < input.alphas.size(); v++)
+            input.alphas[v] = rgba[v * 4 + 3];
+        }
+
+        // Attributes shorter than the positions aren't baked
+        const bool valid = input.texCoords.size() >= numVertices * 2 && (input.alphas.empty() || input.alphas.size() >= numVertices)
+                           && std::all_of(input.indices.begin(), input.indices.end(), [&](uint32_t v) { return v < numVertices; });
+        if(!valid)
+          input.indices.clear();
+      },
+      std::min(static_cast<uint32_t>(inputs.size()), numThreads));
+
+  // Primitives whose image cannot be read keep the any-hit, as their triangles are not all valid
+  inputs.erase(std::remove_if(inputs.begin(), inputs.end(),
+                              [&](const BakeInput& input) {
+                                const int imageID = materials[input.materialID].imageID;
+                                return (imageID >= 0 && !imageRead[imageID]) || input.indices.size() < 3;
+                              }),
+               inputs.end());
+  if(inputs.empty())
+    return false;
+
+  VkPhysicalDeviceOpacityMicromapPropertiesEXT micromapProps{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_OPACITY_MICROMAP_PROPERTIES_EXT};
+  VkPhysicalDeviceProperties2 props{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &micromapProps};
+  vkGetPhysicalDeviceProperties2(physicalDevice, &props);
+  const uint32_t maxLevel = std::min(kMaxSubdivisionLevel, micromapProps.maxOpacity4StateSubdivisionLevel);
+
+  Hasher hasher;
+  hasher.add(OMM_CACHE_VERSION).add(maxLevel).add(halfTexCoords).add(inputs.size());
+  for(const BakeInput& input : inputs)
+  {
+    const BakeMaterial& material = materials[input.materialID];
+    hasher.add(input.renderPrimID).add(input.texCoords).add(input.alphas).add(input.indices);
+    hasher.add(material.alphaFactor).add(material.alphaCutoff).add(material.wrapS).add(material.wrapT);
+    hasher.add(material.imageID >= 0 ? images[material.imageID].hash : 0ULL);
+  }
+  const std::filesystem::path cachePath = useCache ? getCacheDirectory() / (hasher.toString() + ".omm") : std::filesystem::path();
+
+  std::vector<BakedPrimitive> baked;
+  auto matchesInputs = [&]() {
+    if(baked.size() != inputs.size())
+      return false;
+    for(size_t i = 0; i < baked.size(); i++)
+    {
+      if(baked[i].renderPrimID != inputs[i].renderPrimID || baked[i].indices.size() != inputs[i].indices.size() / 3)
+        return false;
+    }
+    return true;
+  };
+  if(!useCache || !loadCache(cachePath, baked) || !matchesInputs())
+  {
+    // Decoding the images, only the alpha is kept
+    std::vector<uint8_t> decoded(model.images.size(), 0);
+    nvh::parallel_batches<1>(
+        imageIDs.size(),
+        [&](uint64_t i) {
+          AlphaImage& image = images[imageIDs[i]];
+          int         channels = 0;
+          stbi_uc*    pixels   = image.encoded.empty() ? nullptr :
+                                                         stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(image.encoded.data()),
+                                                                               static_cast<int>(image.encoded.size()),
+                                                                               &image.width, &image.height, &channels, 4);
+          if(pixels == nullptr)
+            return;
+          image.alpha.resize(size_t(image.width) * image.height);
+          for(size_t t = 0; t < image.alpha.size(); t++)
+            image.alpha[t] = pixels[t * 4 + 3];
+          stbi_image_free(pixels);
+          decoded[imageIDs[i]] = 1;
+        },
+        std::min(static_cast<uint32_t>(std::max<size_t>(imageIDs.size(), 1)), numThreads));
+
+    baked.assign(inputs.size(), {});
+    nvh::parallel_batches<1>(
+        inputs.size(),
+        [&](uint64_t i) {
+          const BakeInput&    input    = inputs[i];
+          const BakeMaterial& material = materials[input.materialID];
+          const AlphaImage*   image    = material.imageID >= 0 ? &images[material.imageID] : nullptr;
+          BakedPrimitive&     result   = baked[i];
+          result.renderPrimID          = input.renderPrimID;
+          const size_t numTriangles    = input.indices.size() / 3;
+          if(image != nullptr && !decoded[material.imageID])
+          {  // Kept for the any-hit
+            result.indices.assign(numTriangles, specialIndex(VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT));
+            return;
+          }
+
+          const glm::vec2 imageSize = image != nullptr ? glm::vec2(image->width, image->height) : glm::vec2(1.0F);
+          std::unordered_map<std::string, uint32_t> sharedTriangles;  // Level and data of the triangles
+          std::vector<uint8_t>                      states;
+          result.indices.resize(numTriangles);
+          for(size_t t = 0; t < numTriangles; t++)
+          {
+            glm::vec2 texel[3];
+            float     alpha[3];
+            for(int c = 0; c < 3; c++)
+            {
+              const uint32_t v = input.indices[t * 3 + c];
+              texel[c] = glm::vec2(input.texCoords[v * 2 + 0], input.texCoords[v * 2 + 1]) * imageSize;
+              alpha[c] = input.alphas.empty() ? 1.0F : input.alphas[v];
+            }
+
+            // Half float texture coordinates are within half of their ulp
+            float margin = 0.0F;
+            if(halfTexCoords && image != nullptr)
+            {
+              const glm::vec2 maxCoord = glm::max(glm::max(glm::abs(texel[0]), glm::abs(texel[1])), glm::abs(texel[2])) / imageSize;
+              margin = std::exp2(std::floor(std::log2(std::max(std::max(maxCoord.x, maxCoord.y), 1e-4F))) - 11.0F)
+                       * std::max(imageSize.x, imageSize.y);
+            }
+
+            const float    area  = 0.5F * std::abs((texel[1].x - texel[0].x) * (texel[2].y - texel[0].y)
+                                                   - (texel[2].x - texel[0].x) * (texel[1].y - texel[0].y));
+            const uint32_t level = image != nullptr ? subdivisionLevel(area, maxLevel) : 0;
+            states.resize(size_t(1) << (2 * level));
+            for(uint32_t m = 0; m < states.size(); m++)
+            {
+              glm::vec2 bary[3];
+              microTriangle(m, level, bary);
+              glm::vec2 microTexel[3];
+              float     microAlpha[3];
+              for(int c = 0; c < 3; c++)
+              {
+                const float w0 = 1.0F - bary[c].x - bary[c].y;
+                microTexel[c]  = texel[0] * w0 + texel[1] * bary[c].x + texel[2] * bary[c].y;
+                microAlpha[c]  = alpha[0] * w0 + alpha[1] * bary[c].x + alpha[2] * bary[c].y;
+              }
+              states[m] = classify(material, image, microTexel, microAlpha, margin);
+            }
+
+            // Uniform triangles have no data
+            const bool uniform = std::all_of(states.begin(), states.end(), [&](uint8_t s) { return s == states[0]; });
+            const bool unknown = std::all_of(states.begin(), states.end(), [](uint8_t s) { return s >= kUnknownTransparent; });
+            if(uniform && states[0] == kOpaque)
+              result.indices[t] = specialIndex(VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_OPAQUE_EXT);
+            else if(uniform && states[0] == kTransparent)
+              result.indices[t] = specialIndex(VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_TRANSPARENT_EXT);
+            else if(unknown)
+              result.indices[t] = specialIndex(VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT);
+            else
+            {
+              std::string key(1, static_cast<char>(level));
+              key.resize(1 + std::max<size_t>(states.size() / 4, 1), 0);
+              for(uint32_t m = 0; m < states.size(); m++)
+                key[1 + m / 4] = static_cast<char>(key[1 + m / 4] | (states[m] << ((m % 4) * 2)));
+
+              const auto [it, inserted] = sharedTriangles.try_emplace(key, static_cast<uint32_t>(result.triangles.size()));
+              if(inserted)
+              {
+                result.triangles.push_back({.dataOffset       = static_cast<uint32_t>(result.data.size()),
+                                            .subdivisionLevel = static_cast<uint16_t>(level),
+                                            .format           = VK_OPACITY_MICROMAP_FORMAT_4_STATE_EXT});
+                result.data.insert(result.data.end(), key.begin() + 1, key.end());
+              }
+              result.indices[t] = it->second;
+            }
+          }
+        },
+        std::min(static_cast<uint32_t>(inputs.size()), numThreads));
+
+    if(useCache && !saveCache(cachePath, baked))
+      LOGW("Opacity micromap cache %s could not be written\n", cachePath.string().c_str());
+  }
+
+  build(cmdPool, primitives.size(), baked);
+
+  // The material edits are compared against the baked alpha
+  m_bakedMaterials.clear();
+  for(const BakeInput& input : inputs)
+  {
+    if(m_geometryIndex[input.renderPrimID] < 0)
+      continue;
+    const tinygltf::Material& material = model.materials[input.materialID];
+    m_bakedMaterials.push_back({.renderPrimID = input.renderPrimID,
+                                .materialID   = input.materialID,
+                                .alphaFactor  = material.pbrMetallicRoughness.baseColorFactor[3],
+                                .alphaCutoff  = material.alphaCutoff,
+                                .textureID    = material.pbrMetallicRoughness.baseColorTexture.index});
+  }
+  return isValid();
+}
+
+void gltfr::OpacityMicromaps::destroy()
+{
+  if(m_alloc == nullptr)
+    return;
+  if(m_micromap != VK_NULL_HANDLE)
+    vkDestroyMicromapEXT(m_device, m_micromap, nullptr);
+  m_micromap = VK_NULL_HANDLE;
+  m_alloc->destroy(m_storage);
+  m_alloc->destroy(m_inputs);
+  m_geometryIndex.clear();
+  m_geometryMicromaps.clear();
+  m_geometryUsages.clear();
+  m_bakedMaterials.clear();
+}
+
+void gltfr::OpacityMicromaps::destroyBuildInputs()
+{
+  if(m_alloc != nullptr)
+    m_alloc->destroy(m_inputs);
+}
+
+const VkAccelerationStructureTrianglesOpacityMicromapEXT* gltfr::OpacityMicromaps::getGeometryMicromap(uint32_t renderPrimID) const
+{
+  if(renderPrimID >= m_geometryIndex.size() || m_geometryIndex[renderPrimID] < 0)
+    return nullptr;
+  return &m_geometryMicromaps[m_geometryIndex[renderPrimID]];
+}
+
+std::vector<uint32_t> gltfr::OpacityMicromaps::takeStalePrimitives(const tinygltf::Model& model)
+{
+  std::vector<uint32_t> stale;
+  auto                  isStale = [&](const BakedMaterial& baked) {
+    if(baked.materialID < 0 || baked.materialID >= static_cast<int>(model.materials.size()))
+      return true;
+    const tinygltf::Material& material = model.materials[baked.materialID];
+    return material.alphaMode != "MASK" || material.alphaCutoff != baked.alphaCutoff
+           || material.pbrMetallicRoughness.baseColorFactor[3] != baked.alphaFactor
+           || material.pbrMetallicRoughness.baseColorTexture.index != baked.textureID;
+  };
+  for(const BakedMaterial& baked : m_bakedMaterials)
+  {
+    if(isStale(baked))
+      stale.push_back(baked.renderPrimID);
+  }
+  std::erase_if(m_bakedMaterials, isStale);
+  return stale;
+}
+
+bool gltfr::OpacityMicromaps::loadCache(const std::filesystem::path& path, std::vector<BakedPrimitive>& baked) const
+{
+  std::vector<char> data;
+  if(!readCacheFile(path, data) || data.size() < sizeof(OmmCacheHeader))
+    return false;
+
+  OmmCacheHeader header;
+  std::memcpy(&header, data.data(), sizeof(header));
+  if(header.magic != OMM_CACHE_MAGIC || header.version != OMM_CACHE_VERSION)
+  {
+    LOGW("Opacity micromap cache %s doesn't match the scene, baking\n", path.string().c_str());
+    return false;
+  }
+
+  size_t offset = sizeof(header);
+  baked.resize(header.numPrimitives);
+  for(BakedPrimitive& primitive : baked)
+  {
+    OmmCachePrimitive info;
+    if(offset + sizeof(info) > data.size())
+      return false;
+    std::memcpy(&info, data.data() + offset, sizeof(info));
+    offset += sizeof(info);
+    primitive.renderPrimID = info.renderPrimID;
+    if(!readArray(data, offset, info.numIndices, primitive.indices) || !readArray(data, offset, info.numTriangles, primitive.triangles)
+       || !readArray(data, offset, info.dataSize, primitive.data))
+      return false;
+  }
+  return true;
+}
+
+bool gltfr::OpacityMicromaps::saveCache(const std::filesystem::path& path, const std::vector<BakedPrimitive>& baked) const
+{
+  std::vector<char>    data(sizeof(OmmCacheHeader));
+  const OmmCacheHeader header{.numPrimitives = static_cast<uint32_t>(baked.size())};
+  std::memcpy(data.data(), &header, sizeof(header));
+  for(const BakedPrimitive& primitive : baked)
+  {
+    const OmmCachePrimitive info{.renderPrimID = primitive.renderPrimID,
+                                 .numIndices   = static_cast<uint32_t>(primitive.indices.size()),
+                                 .numTriangles = static_cast<uint32_t>(primitive.triangles.size()),
+                                 .dataSize     = static_cast<uint32_t>(primitive.data.size())};
+    const char* begin = reinterpret_cast<const char*>(&info);
+    data.insert(data.end(), begin, begin + sizeof(info));
+    appendArray(data, primitive.indices);
+    appendArray(data, primitive.triangles);
+    appendArray(data, primitive.data);
+  }
+  return writeCacheFile(path, data.data(), data.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+// All primitives are concatenated in one micromap, each BLAS geometry has its range of indices
+//
+void gltfr::OpacityMicromaps::build(nvvk::CommandPool& cmdPool, size_t numRenderPrimitives, const std::vector<BakedPrimitive>& baked)
+{
+  std::vector<VkMicromapTriangleEXT> triangles;
+  std::vector<uint8_t>               data;
+  std::vector<uint32_t>              indices;
+  std::vector<uint32_t>              triangleLevels(kMaxSubdivisionLevel + 1, 0);  // Of the micromap
+  std::vector<size_t>                indexOffsets;
+  m_geometryIndex.assign(numRenderPrimitives, -1);
+  m_geometryUsages.clear();
+
+  uint32_t numSpecial = 0;
+  for(const BakedPrimitive& primitive : baked)
+  {
+    if(primitive.renderPrimID >= numRenderPrimitives)
+      continue;
+    const uint32_t triangleOffset = static_cast<uint32_t>(triangles.size());
+    for(VkMicromapTriangleEXT triangle : primitive.triangles)
+    {
+      triangle.dataOffset += static_cast<uint32_t>(data.size());
+      triangleLevels[std::min<uint32_t>(triangle.subdivisionLevel, kMaxSubdivisionLevel)]++;
+      triangles.push_back(triangle);
+    }
+    data.insert(data.end(), primitive.data.begin(), primitive.data.end());
+
+    // The usage counts of the geometry are the levels of its referenced triangles
+    std::vector<uint32_t> levels(kMaxSubdivisionLevel + 1, 0);
+    indexOffsets.push_back(indices.size());
+    for(uint32_t index : primitive.indices)
+    {
+      if(isSpecialIndex(index) || index >= primitive.triangles.size())
+      {
+        indices.push_back(isSpecialIndex(index) ? index : specialIndex(VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT));
+        numSpecial++;
+        continue;
+      }
+      levels[std::min<uint32_t>(primitive.triangles[index].subdivisionLevel, kMaxSubdivisionLevel)]++;
+      indices.push_back(index + triangleOffset);
+    }
+    std::vector<VkMicromapUsageEXT>& usages = m_geometryUsages.emplace_back();
+    for(uint32_t level = 0; level < levels.size(); level++)
+    {
+      if(levels[level] > 0)
+        usages.push_back({.count = levels[level], .subdivisionLevel = level, .format = VK_OPACITY_MICROMAP_FORMAT_4_STATE_EXT});
+    }
+    m_geometryIndex[primitive.renderPrimID] = static_cast<int32_t>(m_geometryUsages.size() - 1);
+  }
+  if(indices.empty())
+    return;
+
+  // The micromap is never empty, even when all triangles have special indices
+  if(triangles.empty())
+  {
+    triangles.push_back({.dataOffset = 0, .subdivisionLevel = 0, .format = VK_OPACITY_MICROMAP_FORMAT_4_STATE_EXT});
+    data.push_back(kUnknownOpaque);
+    triangleLevels[0]++;
+  }
+  std::vector<VkMicromapUsageEXT> micromapUsages;
+  for(uint32_t level = 0; level < triangleLevels.size(); level++)
+  {
+    if(triangleLevels[level] > 0)
+      micromapUsages.push_back({.count = triangleLevels[level], .subdivisionLevel = level, .format = VK_OPACITY_MICROMAP_FORMAT_4_STATE_EXT});
+  }
+
+  // One buffer for the build inputs, each array aligned as the build requires
+  const VkDeviceSize trianglesSize = triangles.size() * sizeof(VkMicromapTriangleEXT);
+  const VkDeviceSize dataOffset    = alignUp(trianglesSize, kInputAlignment);
+  const VkDeviceSize indexOffset   = alignUp(dataOffset + data.size(), kInputAlignment);
+  const VkDeviceSize inputsSize    = indexOffset + indices.size() * sizeof(uint32_t);
+  m_inputs = m_alloc->createBuffer(inputsSize + kInputAlignment,
+                                   VK_BUFFER_USAGE_MICROMAP_BUILD_INPUT_READ_ONLY_BIT_EXT
+                                       | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR
+                                       | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  const VkDeviceAddress bufferAddress = nvvk::getBufferDeviceAddress(m_device, m_inputs.buffer);
+  const VkDeviceAddress inputsAddress = alignUp(bufferAddress, kInputAlignment);
+  const VkDeviceSize    base          = inputsAddress - bufferAddress;
+
+  VkCommandBuffer cmd = cmdPool.createCommandBuffer();
+  m_alloc->getStaging()->cmdToBuffer(cmd, m_inputs.buffer, base, trianglesSize, triangles.data());
+  m_alloc->getStaging()->cmdToBuffer(cmd, m_inputs.buffer, base + dataOffset, data.size(), data.data());
+  m_alloc->getStaging()->cmdToBuffer(cmd, m_inputs.buffer, base + indexOffset, indices.size() * sizeof(uint32_t), indices.data());
+
+  // The indices are read by the BLAS builds
+  const VkMemoryBarrier2 uploadBarrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                       .srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                       .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                       .dstStageMask  = VK_PIPELINE_STAGE_2_MICROMAP_BUILD_BIT_EXT
+                                                       | VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                                       .dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_MICROMAP_READ_BIT_EXT};
+  const VkDependencyInfo uploadDependency{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &uploadBarrier};
+  vkCmdPipelineBarrier2(cmd, &uploadDependency);
+
+  VkMicromapBuildInfoEXT buildInfo{.sType               = VK_STRUCTURE_TYPE_MICROMAP_BUILD_INFO_EXT,
+                                   .type                = VK_MICROMAP_TYPE_OPACITY_MICROMAP_EXT,
+                                   .flags               = VK_BUILD_MICROMAP_PREFER_FAST_TRACE_BIT_EXT,
+                                   .mode                = VK_BUILD_MICROMAP_MODE_BUILD_EXT,
+                                   .usageCountsCount    = static_cast<uint32_t>(micromapUsages.size()),
+                                   .pUsageCounts        = micromapUsages.data(),
+                                   .triangleArrayStride = sizeof(VkMicromapTriangleEXT)};
+  VkMicromapBuildSizesInfoEXT sizeInfo{VK_STRUCTURE_TYPE_MICROMAP_BUILD_SIZES_INFO_EXT};
+  vkGetMicromapBuildSizesEXT(m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo, &sizeInfo);
+
+  m_storage = m_alloc->createBuffer(sizeInfo.micromapSize, VK_BUFFER_USAGE_MICROMAP_STORAGE_BIT_EXT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  const VkMicromapCreateInfoEXT createInfo{.sType  = VK_STRUCTURE_TYPE_MICROMAP_CREATE_INFO_EXT,
+                                           .buffer = m_storage.buffer,
+                                           .size   = sizeInfo.micromapSize,
+                                           .type   = VK_MICROMAP_TYPE_OPACITY_MICROMAP_EXT};
+  NVVK_CHECK(vkCreateMicromapEXT(m_device, &createInfo, nullptr, &m_micromap));
+
+  nvvk::Buffer scratch = m_alloc->createBuffer(sizeInfo.buildScratchSize + kInputAlignment,
+                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  buildInfo.dstMicromap                 = m_micromap;
+  buildInfo.scratchData.deviceAddress   = alignUp(nvvk::getBufferDeviceAddress(m_device, scratch.buffer), kInputAlignment);
+  buildInfo.triangleArray.deviceAddress = inputsAddress;
+  buildInfo.data.deviceAddress          = inputsAddress + dataOffset;
+  vkCmdBuildMicromapsEXT(cmd, 1, &buildInfo);
+
+  // The BLAS builds read the micromap
+  const VkMemoryBarrier2 buildBarrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                      .srcStageMask  = VK_PIPELINE_STAGE_2_MICROMAP_BUILD_BIT_EXT,
+                                      .srcAccessMask = VK_ACCESS_2_MICROMAP_WRITE_BIT_EXT,
+                                      .dstStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                                      .dstAccessMask = VK_ACCESS_2_MICROMAP_READ_BIT_EXT};
+  const VkDependencyInfo buildDependency{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &buildBarrier};
+  vkCmdPipelineBarrier2(cmd, &buildDependency);
+  cmdPool.submitAndWait(cmd);
+  m_alloc->finalizeAndReleaseStaging();
+  m_alloc->destroy(scratch);
+
+  // The usage counts are complete, the geometries can point to them
+  m_geometryMicromaps.resize(m_geometryUsages.size());
+  for(size_t i = 0; i < m_geometryUsages.size(); i++)
+  {
+    m_geometryMicromaps[i] = {.sType            = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_TRIANGLES_OPACITY_MICROMAP_EXT,
+                              .indexType        = VK_INDEX_TYPE_UINT32,
+                              .indexBuffer      = {.deviceAddress = inputsAddress + indexOffset + indexOffsets[i] * sizeof(uint32_t)},
+                              .indexStride      = sizeof(uint32_t),
+                              .baseTriangle     = 0,
+                              .usageCountsCount = static_cast<uint32_t>(m_geometryUsages[i].size()),
+                              .pUsageCounts     = m_geometryUsages[i].data(),
+                              .micromap         = m_micromap};
+  }
+
+  LOGI("Opacity micromaps: %zu primitives, %zu micromap triangles, %u uniform triangles, %zu KB\n", m_geometryUsages.size(),
+       triangles.size(), numSpecial, (data.size() + trianglesSize) >> 10);
+}
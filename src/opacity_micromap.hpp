@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Opacity micromaps of the alpha-tested primitives (VK_EXT_opacity_micromap)
+
+  - The render primitives with a MASK material (the same in all their render nodes, without
+    transmission nor variants) which are not deformed, have the alpha of their base color
+    texture baked at scene creation, against the full resolution of the image.
+  - Each triangle is subdivided in 4^level micro-triangles, the level follows its area in
+    texels. A micro-triangle is opaque or transparent when all texels it can sample are on the
+    same side of the alpha cutoff (with the factor and the vertex colors), unknown otherwise.
+    Triangles which are entirely opaque or transparent use the special indices, without data.
+  - The triangles of all baked primitives are in one micromap, referenced by their BLAS (see
+    SceneRtxCached::attachOpacityMicromaps). The traversal resolves the known micro-triangles,
+    the any-hit shaders and the candidates of the ray queries only see the unknown ones.
+  - The bake is cached on disk, keyed by the geometry, the texture coordinates, the alpha of the
+    materials and the images.
+
+  The material editor does not re-bake: when the alpha of a baked material is edited (mode,
+  cutoff, factor or base color texture), the instances of its primitives ignore their micromaps
+  (see SceneRtxCached::disableStaleMicromaps) and any-hit decides all their triangles, until the
+  scene is loaded again. Without the extension, nothing is attached and all triangles of the
+  MASK primitives go through any-hit.
+
+*/
+
+#include <filesystem>
+#include <vector>
+
+// nvpro-core
+#include "nvh/gltfscene.hpp"
+#include "nvvk/commands_vk.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+
+namespace gltfr {
+
+class OpacityMicromaps
+{
+public:
+  OpacityMicromaps() = default;
+  ~OpacityMicromaps() { destroy(); }
+
+  // VK_EXT_opacity_micromap with the micromap feature
+  static bool isSupported(VkPhysicalDevice physicalDevice);
+
+  // Bake, or load from the cache, the micromaps of the eligible render primitives and build them
+  // on the queue of the command pool. False when there is nothing to bake.
+  // 'halfTexCoords': the shaders read the texture coordinates as half floats (CompactVertices).
+  bool create(nvvk::ResourceAllocator*     alloc,
+              VkPhysicalDevice             physicalDevice,
+              nvvk::CommandPool&           cmdPool,
+              const nvh::gltf::Scene&      scene,
+              const std::vector<uint32_t>& deformedPrimitives,
+              const std::filesystem::path& baseDir,
+              bool                         halfTexCoords,
+              bool                         useCache);
+  void destroy();
+
+  // The indices of the geometries are read by the BLAS builds, once done they can be released
+  void destroyBuildInputs();
+
+  bool isValid() const { return m_micromap != VK_NULL_HANDLE; }
+
+  // To chain on the triangles of the BLAS geometry, nullptr when the render primitive isn't baked
+  const VkAccelerationStructureTrianglesOpacityMicromapEXT* getGeometryMicromap(uint32_t renderPrimID) const;
+
+  // The baked render primitives whose material no longer has the alpha they were baked for,
+  // each is only returned once
+  std::vector<uint32_t> takeStalePrimitives(const tinygltf::Model& model);
+
+private:
+  // Micromap triangles of a render primitive, their data offsets are relative to its data
+  struct BakedPrimitive
+  {
+    uint32_t                           renderPrimID{0};
+    std::vector<uint32_t>              indices;    // Per triangle, into 'triangles' or a special index
+    std::vector<VkMicromapTriangleEXT> triangles;  // Identical micro-triangle states are shared
+    std::vector<uint8_t>               data;       // 2 bits per micro-triangle, in the bird curve order
+  };
+
+  // Alpha of the material a render primitive was baked for
+  struct BakedMaterial
+  {
+    uint32_t renderPrimID{0};
+    int      materialID{-1};
+    double   alphaFactor{1.0};
+    double   alphaCutoff{0.5};
+    int      textureID{-1};
+  };
+
+  bool loadCache(const std::filesystem::path& path, std::vector<BakedPrimitive>& baked) const;
+  bool saveCache(const std::filesystem::path& path, const std::vector<BakedPrimitive>& baked) const;
+  void build(nvvk::CommandPool& cmdPool, size_t numRenderPrimitives, const std::vector<BakedPrimitive>& baked);
+
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  VkDevice                 m_device{VK_NULL_HANDLE};
+
+  VkMicromapEXT m_micromap{VK_NULL_HANDLE};
+  nvvk::Buffer  m_storage;  // Of the micromap
+  nvvk::Buffer  m_inputs;   // Triangles, data and indices, the indices are read by the BLAS builds
+
+  // Per render primitive, the usage counts are referenced by the geometry micromaps
+  std::vector<int32_t>                                            m_geometryIndex;  // -1: not baked
+  std::vector<VkAccelerationStructureTrianglesOpacityMicromapEXT> m_geometryMicromaps;
+  std::vector<std::vector<VkMicromapUsageEXT>>                    m_geometryUsages;
+  std::vector<BakedMaterial>                                      m_bakedMaterials;
+};
+
+}  // namespace gltfr
@@ -58,9 +58,19 @@ public:
 
   // Use getOutputImage to get the final rendered image
   virtual VkDescriptorImageInfo getOutputImage() const { return {}; }
+  // The image of getOutputImage() when it is written by passes of Resources::m_frameGraph,
+  // the tonemapper can then run on the async compute queue
+  virtual VkImage getResultImage() const { return VK_NULL_HANDLE; }
+
+  // Linear color before the tonemapper, RGBA32F in the GENERAL layout, for the EXR/HDR files
+  virtual VkImage    getRadianceImage() const { return VK_NULL_HANDLE; }
+  virtual VkExtent2D getRadianceSize() const { return {}; }
 
   // Use hot-reload the shaders
   virtual bool reloadShaders(Resources& res, Scene& scene) = 0;
+
+  // The accumulation reached the target quality, before Settings::maxFrames
+  virtual bool isConverged(const Scene& /*scene*/) const { return false; }
 };
 
 // Add under here all the different renderers
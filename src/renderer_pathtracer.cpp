@@ -19,7 +19,10 @@
 
 
 // Purpose: Pathtracer renderer implementation
+#include <algorithm>
 #include <iostream>
+#include <optional>
+#include <thread>
 
 // nvpro-core
 #include "nvh/cameramanipulator.hpp"
@@ -36,7 +39,11 @@
 
 // Local to application
 #include "silhouette.hpp"
+#include "adaptive_sampler.hpp"
 #include "atrous_denoiser.hpp"
+#include "temporal_reprojection.hpp"
+#include "wavefront_pathtracer.hpp"
+#include "opacity_micromap.hpp"
 #include "renderer.hpp"
 
 extern std::shared_ptr<nvvkhl::ElementDbgPrintf> g_elemDebugPrintf;
@@ -51,11 +58,13 @@ namespace PE = ImGuiH::PropertyEditor;
 #include "_autogen/shadow.rmiss.glsl.h"
 #include "_autogen/shadow.rahit.glsl.h"
 #include "_autogen/shadow.rchit.glsl.h"
+#include "_autogen/wavefront.comp.glsl.h"
 #include "nvvk/shaders_vk.hpp"
 #include "collapsing_header_manager.h"
 
 namespace gltfr {
 extern bool g_forceExternalShaders;
+extern bool g_opacityMicromaps;
 
 // Settings for the pathtracer
 PathtraceSettings g_pathtraceSettings;
@@ -76,17 +85,33 @@ public:
   void                  handleChange(Resources& res, Scene& scene) override;
   VkDescriptorImageInfo getOutputImage() const override
   {
+    if(m_gOutput)
+      return m_gOutput->getDescriptorImageInfo();
     return m_gBuffers->getDescriptorImageInfo(GBufferType::eRgbResult);
   }
+  VkImage getResultImage() const override
+  {
+    return m_gOutput ? m_gOutput->getColorImage() : m_gBuffers->getColorImage(GBufferType::eRgbResult);
+  }
+  VkImage    getRadianceImage() const override { return m_gBuffers->getColorImage(GBufferType::eRgbLinear); }
+  VkExtent2D getRadianceSize() const override { return m_gBuffers->getSize(); }
 
   bool reloadShaders(Resources& res, Scene& /*scene*/) override;
 
+  bool isConverged(const Scene& scene) const override
+  {
+    return m_pushConst.adaptiveThreshold > 0.0f && m_adaptive->isConverged(scene.m_sceneFrameInfo.frameCount);
+  }
+
 private:
   void createRtxPipeline(Resources& res, Scene& scene);
   void createIndirectPipeline(Resources& res, Scene& scene);
+  void createWavefront(Resources& res, Scene& scene);
   bool initShaders(Resources& res, bool reload);
   void createRtxSet();
   void writeRtxSet(Scene& scene);
+  void retirePipelines(Resources& res);
+  void selectPipelineVariant(Resources& res, uint32_t features);
   void deinit();
   void createGBuffer(Resources& res);
 
@@ -98,19 +123,60 @@ private:
   std::unique_ptr<nvvkhl::PipelineContainer>    m_rtxPipe{};       // Raytracing pipeline
   std::unique_ptr<nvvkhl::PipelineContainer>    m_indirectPipe{};  // Raytracing pipeline
   std::unique_ptr<nvvkhl::GBuffer>              m_gBuffers{};      // G-Buffers: RGBA32F
+  std::unique_ptr<nvvkhl::GBuffer>              m_gOutput{};       // Upscaled eRgbResult, for a lower render scale
+  std::unique_ptr<nvvkhl::GBuffer>              m_gPost{};         // Inputs of the async post-processing, see PostBufferType
+  std::unique_ptr<nvvkhl::GBuffer>              m_gHistory{};      // Temporal reprojection, see HistoryBufferType
   std::unique_ptr<nvvk::DebugUtil>              m_dutil{};
   std::unique_ptr<Silhouette>                   m_silhouette{};
   std::unique_ptr<AtrousDenoiser>               m_denoiser{};
+  std::unique_ptr<WavefrontPathtracer>          m_wavefront{};  // eWavefront render mode
+  std::unique_ptr<AdaptiveSampler>              m_adaptive{};
+  std::unique_ptr<TemporalReprojection>         m_temporal{};
+
+  // Pipelines specialized for other features of the scene (see shaders/scene_features.h), most recent last.
+  // Going back to a previous scene, or undoing an edit of the materials, does not compile them again.
+  struct PipelineVariant
+  {
+    std::unique_ptr<nvvkhl::PipelineContainer> rtxPipe;
+    std::unique_ptr<nvvk::SBTWrapper>          sbt;
+    std::unique_ptr<nvvkhl::PipelineContainer> indirectPipe;
+  };
+  void retireVariant(Resources& res, PipelineVariant& variant);
+
+  static constexpr size_t                           kMaxPipelineVariants = 4;
+  std::vector<std::pair<uint32_t, PipelineVariant>> m_pipelineVariants;
+  uint32_t                                          m_shaderFeatures{SCENE_FEATURE_ALL};  // Of the current pipelines
 
   nvh::Bbox m_sceneBBox{};
+  bool      m_hasHistory{false};       // The G-Buffers have an accumulation which can be reprojected
+  bool      m_reducedGBuffers{false};  // Without the history and the post-processing snapshots, see MemoryBudget
 
   enum GBufferType
   {
-    eRgbLinear,    // Result from path-tracing
-    eRgbResult,    // Final result
-    eSilhouette,   // Buffer to store object ID for silhouette
-    eNormalDepth,  // Denoise - Normal
-    eTempResult,   // Denoise - Temporary result
+    eRgbLinear,           // Result from path-tracing
+    eRgbResult,           // Final result
+    eSilhouette,          // Buffer to store object ID for silhouette
+    eNormalDepth,         // Denoise - Normal
+    eTempResult,          // Denoise - Temporary result
+    eVariance,            // Adaptive sampling - Luminance statistics
+    eMotion,              // Reprojection - Motion to the previous frame
+  };
+
+  // Copies of the previous accumulation for the reprojection, 1x1 with reduced G-Buffers
+  enum HistoryBufferType
+  {
+    eHistoryColor,        // Previous accumulation
+    eHistoryVariance,     // Previous luminance statistics
+    eHistoryNormalDepth,  // Previous normal / depth
+  };
+
+  // Copies of the G-Buffers read by the async post-processing, while the next frame traces
+  enum PostBufferType
+  {
+    ePostColor,
+    ePostNormalDepth,
+    ePostVariance,
+    ePostSilhouette,
   };
 
   std::vector<VkFormat> m_gbufferFormats = {
@@ -119,6 +185,13 @@ private:
       VK_FORMAT_R8_UNORM,             // For selection, silhouette
       VK_FORMAT_R16G16B16A16_SFLOAT,  // Normal / Depth (Normal in RGB, Depth in A) used by denoiser
       VK_FORMAT_R16G16B16A16_SFLOAT,  // Temp result (Denoiser / Ping-pong for multiple passes)
+      VK_FORMAT_R32G32B32A32_SFLOAT,  // Mean, sum of squared differences and number of samples of the luminance, first hit
+      VK_FORMAT_R16G16B16A16_SFLOAT,  // Motion in pixels (RG), distance to the previous camera (B)
+  };
+  std::vector<VkFormat> m_historyFormats = {
+      VK_FORMAT_R32G32B32A32_SFLOAT,  // Copies of eRgbLinear, eVariance and eNormalDepth
+      VK_FORMAT_R32G32B32A32_SFLOAT,
+      VK_FORMAT_R16G16B16A16_SFLOAT,
   };
 
   // Creating all shaders
@@ -132,14 +205,16 @@ private:
     eShadowCH,
     eShadowAH,
     eIndirect,
+    eWavefront,
     eShaderGroupCount
   };
-  std::vector<shaderc::SpvCompilationResult>    m_spvShader{};
+  std::vector<std::vector<uint32_t>>            m_spvShader{};
   std::array<VkShaderModule, eShaderGroupCount> m_shaderModules{};
 
   VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_rtPipelineProperties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR};
   VkPhysicalDeviceRayTracingInvocationReorderPropertiesNV m_reorderProperties{
       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_INVOCATION_REORDER_PROPERTIES_NV};
+  bool m_opacityMicromaps{false};  // The BLAS can reference opacity micromaps, see OpacityMicromaps
 };
 
 //------------------------------------------------------------------------------
@@ -166,16 +241,21 @@ bool RendererPathtracer::init(Resources& res, Scene& scene)
   prop2.pNext                  = &m_rtPipelineProperties;
   m_rtPipelineProperties.pNext = &m_reorderProperties;
   vkGetPhysicalDeviceProperties2(res.ctx.physicalDevice, &prop2);
+  m_opacityMicromaps = g_opacityMicromaps && OpacityMicromaps::isSupported(res.ctx.physicalDevice);
 
   const uint32_t t_queue_index = res.ctx.transfer.familyIndex;
 
   m_rtxSet = std::make_unique<nvvk::DescriptorSetContainer>(m_device);  // Descriptor set for RTX
   m_sbt    = std::make_unique<nvvk::SBTWrapper>();
   m_sbt->setup(m_device, t_queue_index, res.m_allocator.get(), m_rtPipelineProperties);
-  m_gBuffers = std::make_unique<nvvkhl::GBuffer>(m_device, res.m_allocator.get());
 
   createGBuffer(res);
   createRtxSet();
+  m_adaptive = std::make_unique<AdaptiveSampler>();
+  m_adaptive->init(res, m_rtxSet->getLayout());
+  m_adaptive->createBuffers(res, m_gBuffers->getSize());
+  m_temporal = std::make_unique<TemporalReprojection>();
+  m_temporal->init(res, m_rtxSet->getLayout());
   writeRtxSet(scene);
 
 
@@ -193,27 +273,27 @@ bool RendererPathtracer::initShaders(Resources& res, bool reload)
 
   if((reload || g_forceExternalShaders) && res.hasGlslCompiler())
   {
-    m_spvShader.resize(eShaderGroupCount);
-    m_spvShader[eRaygen]     = res.compileGlslShader("pathtrace.rgen.glsl", shaderc_shader_kind::shaderc_raygen_shader);
-    m_spvShader[eMiss]       = res.compileGlslShader("pathtrace.rmiss.glsl", shaderc_shader_kind::shaderc_miss_shader);
-    m_spvShader[eShadowMiss] = res.compileGlslShader("shadow.rmiss.glsl", shaderc_shader_kind::shaderc_miss_shader);
-    m_spvShader[eClosestHit] = res.compileGlslShader("pathtrace.rchit.glsl", shaderc_shader_kind::shaderc_closesthit_shader);
-    m_spvShader[eAnyHit]   = res.compileGlslShader("pathtrace.rahit.glsl", shaderc_shader_kind::shaderc_anyhit_shader);
-    m_spvShader[eShadowCH] = res.compileGlslShader("shadow.rchit.glsl", shaderc_shader_kind::shaderc_closesthit_shader);
-    m_spvShader[eShadowAH] = res.compileGlslShader("shadow.rahit.glsl", shaderc_shader_kind::shaderc_anyhit_shader);
-    m_spvShader[eIndirect] = res.compileGlslShader("pathtrace.comp.glsl", shaderc_shader_kind::shaderc_compute_shader);
+    const std::vector<GlslShaderFile> shaderFiles = {
+        {"pathtrace.rgen.glsl", shaderc_shader_kind::shaderc_raygen_shader},
+        {"pathtrace.rmiss.glsl", shaderc_shader_kind::shaderc_miss_shader},
+        {"shadow.rmiss.glsl", shaderc_shader_kind::shaderc_miss_shader},
+        {"pathtrace.rchit.glsl", shaderc_shader_kind::shaderc_closesthit_shader},
+        {"pathtrace.rahit.glsl", shaderc_shader_kind::shaderc_anyhit_shader},
+        {"shadow.rchit.glsl", shaderc_shader_kind::shaderc_closesthit_shader},
+        {"shadow.rahit.glsl", shaderc_shader_kind::shaderc_anyhit_shader},
+        {"pathtrace.comp.glsl", shaderc_shader_kind::shaderc_compute_shader},
+        {"wavefront.comp.glsl", shaderc_shader_kind::shaderc_compute_shader},
+    };
 
+    // All shaders are compiled in parallel
+    if(!res.compileGlslShaders(shaderFiles, m_spvShader))
+    {
+      LOGE("Error when loading shaders\n");
+      return false;
+    }
     for(size_t i = 0; i < m_spvShader.size(); i++)
     {
-      auto& s = m_spvShader[i];
-
-      if(s.GetCompilationStatus() != shaderc_compilation_status_success)
-      {
-        LOGE("Error when loading shaders: %zu\n", i);
-        LOGE("Error %s\n", s.GetErrorMessage().c_str());
-        return false;
-      }
-      m_shaderModules[i] = res.createShaderModule(s);
+      m_shaderModules[i] = res.createShaderModule(m_spvShader[i]);
     }
   }
   else
@@ -226,6 +306,7 @@ bool RendererPathtracer::initShaders(Resources& res, bool reload)
     const auto& rahshadow_shd   = std::vector<uint32_t>{std::begin(shadow_rahit_glsl), std::end(shadow_rahit_glsl)};
     const auto& rchshadow_shd   = std::vector<uint32_t>{std::begin(shadow_rchit_glsl), std::end(shadow_rchit_glsl)};
     const auto& comp_shd        = std::vector<uint32_t>{std::begin(pathtrace_comp_glsl), std::end(pathtrace_comp_glsl)};
+    const auto& wavefront_shd   = std::vector<uint32_t>{std::begin(wavefront_comp_glsl), std::end(wavefront_comp_glsl)};
 
     m_shaderModules[eRaygen]     = nvvk::createShaderModule(m_device, rgen_shd);
     m_shaderModules[eMiss]       = nvvk::createShaderModule(m_device, rmiss_shd);
@@ -235,6 +316,7 @@ bool RendererPathtracer::initShaders(Resources& res, bool reload)
     m_shaderModules[eShadowCH]   = nvvk::createShaderModule(m_device, rchshadow_shd);
     m_shaderModules[eShadowAH]   = nvvk::createShaderModule(m_device, rahshadow_shd);
     m_shaderModules[eIndirect]   = nvvk::createShaderModule(m_device, comp_shd);
+    m_shaderModules[eWavefront]  = nvvk::createShaderModule(m_device, wavefront_shd);
   }
 
   m_dutil->DBG_NAME(m_shaderModules[eRaygen]);
@@ -245,6 +327,7 @@ bool RendererPathtracer::initShaders(Resources& res, bool reload)
   m_dutil->DBG_NAME(m_shaderModules[eShadowCH]);
   m_dutil->DBG_NAME(m_shaderModules[eShadowAH]);
   m_dutil->DBG_NAME(m_shaderModules[eIndirect]);
+  m_dutil->DBG_NAME(m_shaderModules[eWavefront]);
 
   return true;
 }
@@ -258,18 +341,74 @@ bool RendererPathtracer::reloadShaders(Resources& res, Scene& /*scene*/)
   }
   if(!initShaders(res, true))
     return false;
-  if(m_sbt)
-    m_sbt->destroy();
-  if(m_rtxPipe)
-    m_rtxPipe->destroy(m_device);
-  if(m_indirectPipe)
-    m_indirectPipe->destroy(m_device);
-  m_rtxPipe.reset();
-  m_indirectPipe.reset();
-  //m_sbt.reset();
+  retirePipelines(res);
   return true;
 }
 
+//------------------------------------------------------------------------------
+// The pipelines and the shading binding table can still be used by the frames in
+// flight, they are destroyed once those are done. They are re-created by handleChange.
+//
+void RendererPathtracer::retirePipelines(Resources& res)
+{
+  PipelineVariant current{std::move(m_rtxPipe), std::move(m_sbt), std::move(m_indirectPipe)};
+  retireVariant(res, current);
+  for(auto& [features, variant] : m_pipelineVariants)
+    retireVariant(res, variant);
+  m_pipelineVariants.clear();
+  res.retire(std::move(m_wavefront));
+  m_sbt = std::make_unique<nvvk::SBTWrapper>();
+  m_sbt->setup(m_device, res.ctx.transfer.familyIndex, res.m_allocator.get(), m_rtPipelineProperties);
+}
+
+void RendererPathtracer::retireVariant(Resources& res, PipelineVariant& variant)
+{
+  for(std::unique_ptr<nvvkhl::PipelineContainer>* container : {&variant.rtxPipe, &variant.indirectPipe})
+  {
+    if(*container)
+      res.retire([device = m_device, pipelines = std::shared_ptr<nvvkhl::PipelineContainer>(std::move(*container))]() {
+        pipelines->destroy(device);
+      });
+  }
+  if(variant.sbt)
+    res.retire([sbt = std::shared_ptr<nvvk::SBTWrapper>(std::move(variant.sbt))]() { sbt->destroy(); });
+}
+
+//------------------------------------------------------------------------------
+// The features of the scene changed: the current pipelines are kept for their
+// features, and the ones of the new features are reused when they exist.
+// Those missing are created by handleChange. The wavefront kernels own their
+// queues, they are created again.
+//
+void RendererPathtracer::selectPipelineVariant(Resources& res, uint32_t features)
+{
+  m_pipelineVariants.push_back({m_shaderFeatures, {std::move(m_rtxPipe), std::move(m_sbt), std::move(m_indirectPipe)}});
+  res.retire(std::move(m_wavefront));
+  m_shaderFeatures = features;
+
+  auto it = std::find_if(m_pipelineVariants.begin(), m_pipelineVariants.end(),
+                         [&](const auto& variant) { return variant.first == features; });
+  if(it != m_pipelineVariants.end())
+  {
+    m_rtxPipe      = std::move(it->second.rtxPipe);
+    m_sbt          = std::move(it->second.sbt);
+    m_indirectPipe = std::move(it->second.indirectPipe);
+    m_pipelineVariants.erase(it);
+  }
+  else
+  {
+    m_sbt = std::make_unique<nvvk::SBTWrapper>();
+    m_sbt->setup(m_device, res.ctx.transfer.familyIndex, res.m_allocator.get(), m_rtPipelineProperties);
+  }
+
+  // The least recently used, the frames in flight can still use the previous pipelines
+  while(m_pipelineVariants.size() > kMaxPipelineVariants)
+  {
+    retireVariant(res, m_pipelineVariants.front().second);
+    m_pipelineVariants.erase(m_pipelineVariants.begin());
+  }
+}
+
 //------------------------------------------------------------------------------
 // Creating the descriptor set for the ray tracing
 // - Top level acceleration structure
@@ -284,6 +423,12 @@ void RendererPathtracer::createRtxSet()
   m_rtxSet->addBinding(RtxBindings::eOutImage, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_ALL);
   m_rtxSet->addBinding(RtxBindings::eNormalDepth, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_ALL);
   m_rtxSet->addBinding(RtxBindings::eSelect, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_ALL);
+  m_rtxSet->addBinding(RtxBindings::eVariance, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_ALL);
+  m_rtxSet->addBinding(RtxBindings::eAdaptiveTiles, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_ALL);
+  m_rtxSet->addBinding(RtxBindings::eMotion, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_ALL);
+  m_rtxSet->addBinding(RtxBindings::eHistoryColor, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_ALL);
+  m_rtxSet->addBinding(RtxBindings::eHistoryVariance, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_ALL);
+  m_rtxSet->addBinding(RtxBindings::eHistoryNormalDepth, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_ALL);
   m_rtxSet->initLayout();
   m_rtxSet->initPool(1);
   m_dutil->DBG_NAME(m_rtxSet->getLayout());
@@ -310,15 +455,27 @@ void RendererPathtracer::writeRtxSet(Scene& scene)
       .pAccelerationStructures    = &tlas,
   };
 
-  const VkDescriptorImageInfo outImage    = m_gBuffers->getDescriptorImageInfo(GBufferType::eRgbLinear);
-  const VkDescriptorImageInfo normalDepth = m_gBuffers->getDescriptorImageInfo(GBufferType::eNormalDepth);
-  const VkDescriptorImageInfo selectImage = m_gBuffers->getDescriptorImageInfo(GBufferType::eSilhouette);  // for selection
+  const VkDescriptorImageInfo  outImage           = m_gBuffers->getDescriptorImageInfo(GBufferType::eRgbLinear);
+  const VkDescriptorImageInfo  normalDepth        = m_gBuffers->getDescriptorImageInfo(GBufferType::eNormalDepth);
+  const VkDescriptorImageInfo  selectImage        = m_gBuffers->getDescriptorImageInfo(GBufferType::eSilhouette);  // for selection
+  const VkDescriptorImageInfo  variance           = m_gBuffers->getDescriptorImageInfo(GBufferType::eVariance);
+  const VkDescriptorBufferInfo tiles              = m_adaptive->getTilesBufferInfo();
+  const VkDescriptorImageInfo  motion             = m_gBuffers->getDescriptorImageInfo(GBufferType::eMotion);
+  const VkDescriptorImageInfo  historyColor       = m_gHistory->getDescriptorImageInfo(HistoryBufferType::eHistoryColor);
+  const VkDescriptorImageInfo  historyVariance    = m_gHistory->getDescriptorImageInfo(HistoryBufferType::eHistoryVariance);
+  const VkDescriptorImageInfo  historyNormalDepth = m_gHistory->getDescriptorImageInfo(HistoryBufferType::eHistoryNormalDepth);
 
   std::vector<VkWriteDescriptorSet> writes;
   writes.emplace_back(m_rtxSet->makeWrite(0, RtxBindings::eTlas, &desc_as_info));
   writes.emplace_back(m_rtxSet->makeWrite(0, RtxBindings::eOutImage, &outImage));
   writes.emplace_back(m_rtxSet->makeWrite(0, RtxBindings::eNormalDepth, &normalDepth));
   writes.emplace_back(m_rtxSet->makeWrite(0, RtxBindings::eSelect, &selectImage));
+  writes.emplace_back(m_rtxSet->makeWrite(0, RtxBindings::eVariance, &variance));
+  writes.emplace_back(m_rtxSet->makeWrite(0, RtxBindings::eAdaptiveTiles, &tiles));
+  writes.emplace_back(m_rtxSet->makeWrite(0, RtxBindings::eMotion, &motion));
+  writes.emplace_back(m_rtxSet->makeWrite(0, RtxBindings::eHistoryColor, &historyColor));
+  writes.emplace_back(m_rtxSet->makeWrite(0, RtxBindings::eHistoryVariance, &historyVariance));
+  writes.emplace_back(m_rtxSet->makeWrite(0, RtxBindings::eHistoryNormalDepth, &historyNormalDepth));
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
@@ -333,9 +490,22 @@ void RendererPathtracer::deinit()
     m_rtxPipe->destroy(m_device);
   if(m_indirectPipe)
     m_indirectPipe->destroy(m_device);
+  for(auto& [features, variant] : m_pipelineVariants)
+  {
+    if(variant.sbt)
+      variant.sbt->destroy();
+    if(variant.rtxPipe)
+      variant.rtxPipe->destroy(m_device);
+    if(variant.indirectPipe)
+      variant.indirectPipe->destroy(m_device);
+  }
+  m_pipelineVariants.clear();
   m_rtxSet.reset();
   m_rtxPipe.reset();
   m_indirectPipe.reset();
+  m_wavefront.reset();
+  m_adaptive.reset();
+  m_temporal.reset();
   m_sbt.reset();
   for(auto& s : m_shaderModules)
   {
@@ -350,14 +520,38 @@ void RendererPathtracer::deinit()
 //
 void RendererPathtracer::createGBuffer(Resources& res)
 {
-  m_gBuffers->destroy();
-  m_gBuffers->create(res.m_finalImage->getSize(), m_gbufferFormats, VK_FORMAT_UNDEFINED);
+  res.retire(std::move(m_gBuffers));  // Still used by the frames in flight
+  res.retire(std::move(m_gOutput));
+  res.retire(std::move(m_gPost));  // Created by the first frame with async post-processing
+  res.retire(std::move(m_gHistory));
+  const VkExtent2D renderSize = res.getRenderSize();
+  m_gBuffers = std::make_unique<nvvkhl::GBuffer>(m_device, res.m_allocator.get());
+  m_gBuffers->create(renderSize, m_gbufferFormats, VK_FORMAT_UNDEFINED);
+  m_hasHistory = false;
+
+  // When the memory is short, the history is not used: still bound, but only 1x1
+  m_reducedGBuffers           = res.m_memory.reduceGBuffers();
+  const VkExtent2D historySize = m_reducedGBuffers ? VkExtent2D{1, 1} : renderSize;
+  m_gHistory                   = std::make_unique<nvvkhl::GBuffer>(m_device, res.m_allocator.get());
+  m_gHistory->create(historySize, m_historyFormats, VK_FORMAT_UNDEFINED);
+  VkDeviceSize gbufferBytes = MemoryBudget::imageBytes(renderSize, m_gbufferFormats)
+                              + MemoryBudget::imageBytes(historySize, m_historyFormats);
+
+  // Dynamic resolution: the result is upscaled to the size of the final image
+  const VkExtent2D finalSize = res.m_finalImage->getSize();
+  if(finalSize.width != m_gBuffers->getSize().width || finalSize.height != m_gBuffers->getSize().height)
+  {
+    m_gOutput = std::make_unique<nvvkhl::GBuffer>(m_device, res.m_allocator.get());
+    m_gOutput->create(finalSize, {m_gbufferFormats[GBufferType::eRgbResult]}, VK_FORMAT_UNDEFINED);
+    gbufferBytes += MemoryBudget::imageBytes(finalSize, {m_gbufferFormats[GBufferType::eRgbResult]});
+  }
+  res.m_memory.set(MemoryBudget::eGBuffers, gbufferBytes);
 }
 
 //------------------------------------------------------------------------------
 // Rendering the scene using ray tracing
 //
-void RendererPathtracer::render(VkCommandBuffer cmd, Resources& /*res*/, Scene& scene, Settings& settings, nvvk::ProfilerVK& profiler)
+void RendererPathtracer::render(VkCommandBuffer cmd, Resources& res, Scene& scene, Settings& settings, nvvk::ProfilerVK& profiler)
 {
   auto scopeDbg = m_dutil->DBG_SCOPE(cmd);
   auto sec      = profiler.timeRecurring("Raytrace", cmd);
@@ -370,6 +564,13 @@ void RendererPathtracer::render(VkCommandBuffer cmd, Resources& /*res*/, Scene&
   m_pushConst.dbgMethod     = g_pathtraceSettings.dbgMethod;
   m_pushConst.maxLuminance  = settings.maxLuminance;
   m_pushConst.useRTDenoiser = m_denoiser->isActivated();
+  // The wavefront kernels always take maxSamples, and do not keep the statistics of the pixels
+  const bool useAdaptive         = g_pathtraceSettings.renderMode != RenderMode::eWavefront;
+  m_pushConst.adaptiveThreshold  = useAdaptive ? g_pathtraceSettings.adaptiveThreshold : 0.0f;
+  m_pushConst.adaptiveMinSamples = g_pathtraceSettings.adaptiveMinSamples;
+  m_pushConst.useTemporal        = (useAdaptive && g_pathtraceSettings.temporal && !m_reducedGBuffers) ? 1 : 0;
+  m_pushConst.frameStride        = std::max(g_pathtraceSettings.shareCount, 1);
+  m_pushConst.frameOffset        = std::clamp(g_pathtraceSettings.shareIndex, 0, m_pushConst.frameStride - 1);
   if(lastSelected != scene.getSelectedRenderNode() || scene.m_sceneFrameInfo.frameCount <= 0)
   {
     lastSelected                   = scene.getSelectedRenderNode();
@@ -383,7 +584,7 @@ void RendererPathtracer::render(VkCommandBuffer cmd, Resources& /*res*/, Scene&
   m_pushConst.focalDistance = g_pathtraceSettings.focalDistance;
   m_pushConst.aperture      = g_pathtraceSettings.aperture;
   if(g_elemDebugPrintf)
-    m_pushConst.mouseCoord = g_elemDebugPrintf->getMouseCoord();
+    m_pushConst.mouseCoord = glm::floor(g_elemDebugPrintf->getMouseCoord() * res.getRenderScale());
 
   // Ray trace
   VkDescriptorSet dsHdr   = scene.m_hdrEnv->getDescriptorSet();
@@ -393,68 +594,204 @@ void RendererPathtracer::render(VkCommandBuffer cmd, Resources& /*res*/, Scene&
   const VkExtent2D size = m_gBuffers->getSize();
 
   std::vector<VkDescriptorSet> desc_sets{m_rtxSet->getSet(), dsScene, dsSky, dsHdr};
-  if(g_pathtraceSettings.renderMode == 0)
+  // All tiles converged: the image is final, the path tracer only runs for a new selection
+  const bool converged = isConverged(scene) && m_pushConst.selectedRenderNode == -1;
+  // Only the camera moved since the previous accumulation: it is reprojected on the first frame
+  const bool reproject = m_pushConst.useTemporal == 1 && m_hasHistory && scene.m_sceneFrameInfo.frameCount == 0
+                         && scene.isCameraReset();
+
+  auto        image   = [&](GBufferType type) { return m_gBuffers->getColorImage(type); };
+  auto        history = [&](HistoryBufferType type) { return m_gHistory->getColorImage(type); };
+  FrameGraph& graph = res.m_frameGraph;
+  if(!converged)
   {
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtxPipe->plines[0]);
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtxPipe->layout, 0,
-                            static_cast<uint32_t>(desc_sets.size()), desc_sets.data(), 0, nullptr);
-    vkCmdPushConstants(cmd, m_rtxPipe->layout, VK_SHADER_STAGE_ALL, 0, sizeof(DH::PushConstantPathtracer), &m_pushConst);
-
-    const std::array<VkStridedDeviceAddressRegionKHR, 4>& regions = m_sbt->getRegions();
-    vkCmdTraceRaysKHR(cmd, regions.data(), &regions[1], &regions[2], &regions[3], size.width, size.height, 1);
+    // The trace, the reprojection and the adaptive sampling synchronize internally
+    const VkPipelineStageFlags2 traceStages = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    const VkAccessFlags2        traceAccess = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT;
+    graph.addPass("Trace", FrameGraph::eGraphics,
+                  {{image(GBufferType::eRgbLinear), traceStages, traceAccess},
+                   {image(GBufferType::eNormalDepth), traceStages, traceAccess},
+                   {image(GBufferType::eVariance), traceStages, traceAccess},
+                   {image(GBufferType::eSilhouette), traceStages, traceAccess}},
+                  [&](VkCommandBuffer cmd) {
+                    if(reproject)
+                    {
+                      m_temporal->cmdSaveHistory(cmd,
+                                                 {{image(GBufferType::eRgbLinear), history(HistoryBufferType::eHistoryColor)},
+                                                  {image(GBufferType::eVariance), history(HistoryBufferType::eHistoryVariance)},
+                                                  {image(GBufferType::eNormalDepth), history(HistoryBufferType::eHistoryNormalDepth)}},
+                                                 size);
+                    }
+
+                    if(g_pathtraceSettings.renderMode == 0)
+                    {
+                      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtxPipe->plines[0]);
+                      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtxPipe->layout, 0,
+                                              static_cast<uint32_t>(desc_sets.size()), desc_sets.data(), 0, nullptr);
+                      vkCmdPushConstants(cmd, m_rtxPipe->layout, VK_SHADER_STAGE_ALL, 0, sizeof(DH::PushConstantPathtracer), &m_pushConst);
+
+                      const std::array<VkStridedDeviceAddressRegionKHR, 4>& regions = m_sbt->getRegions();
+                      vkCmdTraceRaysKHR(cmd, regions.data(), &regions[1], &regions[2], &regions[3], size.width, size.height, 1);
+                    }
+                    else if(g_pathtraceSettings.renderMode == RenderMode::eWavefront)
+                    {
+                      m_wavefront->cmdRender(cmd, desc_sets, m_pushConst);
+                    }
+                    else
+                    {
+                      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_indirectPipe->plines[0]);
+                      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_indirectPipe->layout, 0,
+                                              static_cast<uint32_t>(desc_sets.size()), desc_sets.data(), 0, nullptr);
+                      vkCmdPushConstants(cmd, m_indirectPipe->layout, VK_SHADER_STAGE_ALL, 0,
+                                         sizeof(DH::PushConstantPathtracer), &m_pushConst);
+
+                      VkExtent2D groups = getGroupCounts(size);
+                      vkCmdDispatch(cmd, groups.width, groups.height, 1);
+                    }
+
+                    if(reproject)
+                    {
+                      const DH::PushConstantReproject reprojectConst{.depthTolerance  = 0.05f,
+                                                                     .normalTolerance = 0.9f,
+                                                                     .maxHistory = g_pathtraceSettings.temporalMaxHistory};
+                      m_temporal->cmdReproject(cmd, m_rtxSet->getSet(), reprojectConst, size);
+                    }
+
+                    if(m_pushConst.adaptiveThreshold > 0.0f)
+                    {
+                      const DH::PushConstantAdaptive adaptive{.threshold  = m_pushConst.adaptiveThreshold,
+                                                              .minSamples = m_pushConst.adaptiveMinSamples,
+                                                              .frameCount = scene.m_sceneFrameInfo.frameCount};
+                      m_adaptive->cmdEvaluate(cmd, m_rtxSet->getSet(), adaptive);
+                    }
+                  });
+    m_hasHistory = m_pushConst.useTemporal == 1;
   }
-  else
-  {
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_indirectPipe->plines[0]);
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_indirectPipe->layout, 0,
-                            static_cast<uint32_t>(desc_sets.size()), desc_sets.data(), 0, nullptr);
-    vkCmdPushConstants(cmd, m_indirectPipe->layout, VK_SHADER_STAGE_ALL, 0, sizeof(DH::PushConstantPathtracer), &m_pushConst);
 
-    VkExtent2D groups = getGroupCounts(size);
-    vkCmdDispatch(cmd, groups.width, groups.height, 1);
+  // Post-processing: on the async compute queue, unless the result is upscaled (blit, graphics only)
+  // or the memory is short (the async post-processing reads copies of the G-Buffers)
+  const FrameGraph::QueueType postQueue  = (m_gOutput || m_reducedGBuffers) ? FrameGraph::eGraphics : FrameGraph::eAsyncCompute;
+  const bool                  async      = postQueue == FrameGraph::eAsyncCompute && graph.isAsyncCompute();
+  const bool                  denoise    = m_denoiser->isActivated();
+  const bool                  silhouette = m_silhouette->isValid() && scene.getSelectedRenderNode() != -1;
+
+  // The inputs of the post-processing, copied when the next frame traces while they are read
+  VkDescriptorImageInfo colorBuffer       = m_gBuffers->getDescriptorImageInfo(GBufferType::eRgbLinear);
+  VkDescriptorImageInfo normalDepthBuffer = m_gBuffers->getDescriptorImageInfo(GBufferType::eNormalDepth);
+  VkDescriptorImageInfo varianceBuffer    = m_gBuffers->getDescriptorImageInfo(GBufferType::eVariance);
+  VkDescriptorImageInfo silhouetteBuffer  = m_gBuffers->getDescriptorImageInfo(GBufferType::eSilhouette);
+  VkImage               colorImage        = image(GBufferType::eRgbLinear);
+  VkImage               normalDepthImage  = image(GBufferType::eNormalDepth);
+  VkImage               varianceImage     = image(GBufferType::eVariance);
+  VkImage               silhouetteImage   = image(GBufferType::eSilhouette);
+  if(async && (denoise || silhouette))
+  {
+    if(!m_gPost)
+    {
+      const std::vector<VkFormat> postFormats = {m_gbufferFormats[GBufferType::eRgbLinear], m_gbufferFormats[GBufferType::eNormalDepth],
+                                                 m_gbufferFormats[GBufferType::eVariance], m_gbufferFormats[GBufferType::eSilhouette]};
+      m_gPost = std::make_unique<nvvkhl::GBuffer>(m_device, res.m_allocator.get());
+      m_gPost->create(size, postFormats, VK_FORMAT_UNDEFINED);
+      res.m_memory.set(MemoryBudget::eGBuffers, res.m_memory.get(MemoryBudget::eGBuffers) + MemoryBudget::imageBytes(size, postFormats));
+    }
+    std::vector<std::pair<VkImage, VkImage>> copies;
+    std::vector<FrameGraph::ImageUse>        uses;
+    auto snapshot = [&](VkImage& src, VkDescriptorImageInfo& info, uint32_t index) {
+      const VkImage dst = m_gPost->getColorImage(index);
+      copies.emplace_back(src, dst);
+      uses.push_back({src, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT});
+      uses.push_back({dst, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT});
+      src  = dst;
+      info = m_gPost->getDescriptorImageInfo(index);
+    };
+    if(denoise)
+    {
+      snapshot(colorImage, colorBuffer, PostBufferType::ePostColor);
+      snapshot(normalDepthImage, normalDepthBuffer, PostBufferType::ePostNormalDepth);
+      snapshot(varianceImage, varianceBuffer, PostBufferType::ePostVariance);
+    }
+    if(silhouette)
+      snapshot(silhouetteImage, silhouetteBuffer, PostBufferType::ePostSilhouette);
+
+    graph.addPass("Snapshot", FrameGraph::eGraphics, uses, [&](VkCommandBuffer cmd) {
+      const VkImageCopy region{.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                               .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                               .extent         = {size.width, size.height, 1}};
+      for(const auto& [src, dst] : copies)
+        vkCmdCopyImage(cmd, src, VK_IMAGE_LAYOUT_GENERAL, dst, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+    });
   }
 
-  // Making sure the rendered image is ready to be used
-  VkImage outImage = m_gBuffers->getColorImage(GBufferType::eRgbLinear);
-  VkImageMemoryBarrier barrier = nvvk::makeImageMemoryBarrier(outImage, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT,
-                                                              VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
-  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
-                       0, nullptr, 1, &barrier);
-
-  if(m_denoiser->isActivated())
+  const VkImage resultImage = image(GBufferType::eRgbResult);
+  if(denoise)
   {
-    // Initial buffers
-    VkDescriptorImageInfo colorBuffer       = m_gBuffers->getDescriptorImageInfo(GBufferType::eRgbLinear);
-    VkDescriptorImageInfo resultBuffer      = m_gBuffers->getDescriptorImageInfo(GBufferType::eRgbResult);
-    VkDescriptorImageInfo tmpBuffer         = m_gBuffers->getDescriptorImageInfo(GBufferType::eTempResult);
-    VkDescriptorImageInfo normalDepthBuffer = m_gBuffers->getDescriptorImageInfo(GBufferType::eNormalDepth);
-
-    m_denoiser->render(cmd, size, colorBuffer, resultBuffer, normalDepthBuffer, tmpBuffer);
+    const VkDescriptorImageInfo resultBuffer = m_gBuffers->getDescriptorImageInfo(GBufferType::eRgbResult);
+    const VkDescriptorImageInfo tmpBuffer    = m_gBuffers->getDescriptorImageInfo(GBufferType::eTempResult);
+    graph.addPass("Denoise", postQueue,
+                  {FrameGraph::computeRead(colorImage), FrameGraph::computeRead(normalDepthImage),
+                   FrameGraph::computeRead(varianceImage), FrameGraph::computeReadWrite(image(GBufferType::eTempResult)),
+                   FrameGraph::computeReadWrite(resultImage)},
+                  [&](VkCommandBuffer passCmd) {
+                    // The profiler only times the command buffer of the frame
+                    std::optional<nvvk::ProfilerVK::Section> denoiseSec;
+                    if(passCmd == cmd)
+                      denoiseSec.emplace(profiler, "Denoiser", passCmd);
+                    // The statistics of the luminance guide the color weight, when the path tracer keeps them
+                    m_denoiser->render(passCmd, size, colorBuffer, resultBuffer, normalDepthBuffer, tmpBuffer, varianceBuffer, useAdaptive);
+                  });
   }
   else
   {
     // Blit the 32-bit color buffer to the 16-bit color buffer
-    VkOffset3D  minCorner = {0, 0, 0};
-    VkOffset3D  maxCorner = {int(m_gBuffers->getSize().width), int(m_gBuffers->getSize().height), 1};
-    VkImageBlit blitRegions{
-        .srcSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1},
-        .srcOffsets     = {minCorner, maxCorner},
-        .dstSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1},
-        .dstOffsets     = {minCorner, maxCorner},
-    };
-    vkCmdBlitImage(cmd, m_gBuffers->getColorImage(GBufferType::eRgbLinear), VK_IMAGE_LAYOUT_GENERAL,
-                   m_gBuffers->getColorImage(GBufferType::eRgbResult), VK_IMAGE_LAYOUT_GENERAL, 1, &blitRegions, VK_FILTER_LINEAR);
+    graph.addPass("Blit", FrameGraph::eGraphics,
+                  {{colorImage, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT},
+                   {resultImage, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT}},
+                  [&](VkCommandBuffer cmd) {
+                    VkOffset3D  minCorner = {0, 0, 0};
+                    VkOffset3D  maxCorner = {int(size.width), int(size.height), 1};
+                    VkImageBlit blitRegions{
+                        .srcSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1},
+                        .srcOffsets     = {minCorner, maxCorner},
+                        .dstSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1},
+                        .dstOffsets     = {minCorner, maxCorner},
+                    };
+                    vkCmdBlitImage(cmd, colorImage, VK_IMAGE_LAYOUT_GENERAL, resultImage, VK_IMAGE_LAYOUT_GENERAL, 1,
+                                   &blitRegions, VK_FILTER_LINEAR);
+                  });
   }
 
   // Silhouette : adding a contour around the selected object on top of the eRgbResult
-  if(m_silhouette->isValid() && scene.getSelectedRenderNode() != -1)
+  if(silhouette)
+  {
+    graph.addPass("Silhouette", postQueue, {FrameGraph::computeRead(silhouetteImage), FrameGraph::computeReadWrite(resultImage)},
+                  [&](VkCommandBuffer cmd) {
+                    m_silhouette->updateBinding(SilhoutteImages::eObjectID, silhouetteBuffer.imageView, VK_IMAGE_LAYOUT_GENERAL);
+                    m_silhouette->updateBinding(SilhoutteImages::eRGBAIImage,
+                                                m_gBuffers->getColorImageView(GBufferType::eRgbResult), VK_IMAGE_LAYOUT_GENERAL);
+                    m_silhouette->setColor(nvvkhl_shaders::toLinear(settings.silhouetteColor));
+                    m_silhouette->dispatch(cmd, size);
+                  });
+  }
+
+  // Lower render scale: upscaled to the final size
+  if(m_gOutput)
   {
-    m_silhouette->updateBinding(SilhoutteImages::eObjectID, m_gBuffers->getColorImageView(GBufferType::eSilhouette),
-                                VK_IMAGE_LAYOUT_GENERAL);
-    m_silhouette->updateBinding(SilhoutteImages::eRGBAIImage, m_gBuffers->getColorImageView(GBufferType::eRgbResult),
-                                VK_IMAGE_LAYOUT_GENERAL);
-    m_silhouette->setColor(nvvkhl_shaders::toLinear(settings.silhouetteColor));
-    m_silhouette->dispatch(cmd, m_gBuffers->getSize());
+    graph.addPass("Upscale", FrameGraph::eGraphics,
+                  {{resultImage, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT},
+                   {m_gOutput->getColorImage(), VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT}},
+                  [&](VkCommandBuffer cmd) {
+                    VkOffset3D  minCorner = {0, 0, 0};
+                    VkOffset3D  srcCorner = {int(size.width), int(size.height), 1};
+                    VkOffset3D  dstCorner = {int(m_gOutput->getSize().width), int(m_gOutput->getSize().height), 1};
+                    VkImageBlit blitRegions{
+                        .srcSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1},
+                        .srcOffsets     = {minCorner, srcCorner},
+                        .dstSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1},
+                        .dstOffsets     = {minCorner, dstCorner},
+                    };
+                    vkCmdBlitImage(cmd, resultImage, VK_IMAGE_LAYOUT_GENERAL, m_gOutput->getColorImage(),
+                                   VK_IMAGE_LAYOUT_GENERAL, 1, &blitRegions, VK_FILTER_LINEAR);
+                  });
   }
 }
 
@@ -489,11 +826,28 @@ bool RendererPathtracer::onUI()
       ImGui::EndDisabled();
       PE::treePop();
     }
+    if(PE::treeNode("Adaptive Sampling"))
+    {
+      changed |= PE::SliderFloat("Error Threshold", &g_pathtraceSettings.adaptiveThreshold, 0.0f, 0.5f, "%.4f",
+                                 ImGuiSliderFlags_Logarithmic, "Relative error at which a tile stops sampling, 0 to disable");
+      changed |= PE::SliderInt("Min Samples", &g_pathtraceSettings.adaptiveMinSamples, 2, 1024, "%d",
+                               ImGuiSliderFlags_Logarithmic, "Samples of each pixel before its tile can converge");
+      PE::treePop();
+    }
+    if(PE::treeNode("Temporal Reprojection"))
+    {
+      changed |= PE::Checkbox("Enable", &g_pathtraceSettings.temporal,
+                              "When only the camera moves, the surfaces which stay visible keep their samples (RTX and Indirect). "
+                              "The reprojected samples stay in the accumulation, which does not converge to the reference");
+      changed |= PE::SliderInt("Max History", &g_pathtraceSettings.temporalMaxHistory, 0, 1024, "%d",
+                               ImGuiSliderFlags_Logarithmic, "Samples kept from the previous accumulation");
+      PE::treePop();
+    }
     if(PE::treeNode("Extra"))
     {
       changed |= PE::Combo("Debug Method", reinterpret_cast<int32_t*>(&g_pathtraceSettings.dbgMethod),
                            "None\0Metallic\0Roughness\0Normal\0Tangent\0Bitangent\0BaseColor\0Emissive\0Opacity\0TexCoord0\0TexCoord1\0\0");
-      changed |= PE::Combo("Render Mode", reinterpret_cast<int32_t*>(&g_pathtraceSettings.renderMode), "RTX\0Indirect\0\0");
+      changed |= PE::Combo("Render Mode", reinterpret_cast<int32_t*>(&g_pathtraceSettings.renderMode), "RTX\0Indirect\0Wavefront\0\0");
       PE::treePop();
     }
 
@@ -511,34 +865,67 @@ bool RendererPathtracer::onUI()
 void RendererPathtracer::handleChange(Resources& res, Scene& scene)
 {
   bool writeDescriptor = scene.hasDirtyFlag(Scene::eHdrEnv);
-  bool gbufferChanged  = res.hasGBuffersChanged();
+  bool gbufferChanged  = res.hasGBuffersChanged() || m_reducedGBuffers != res.m_memory.reduceGBuffers();
 
+  const bool featuresChanged = scene.getShaderFeatures() != m_shaderFeatures;
+  if(featuresChanged)
+    selectPipelineVariant(res, scene.getShaderFeatures());
   if((g_pathtraceSettings.renderMode == RenderMode::eRTX) && !m_rtxPipe)
     createRtxPipeline(res, scene);
   if((g_pathtraceSettings.renderMode == RenderMode::eIndirect) && !m_indirectPipe)
     createIndirectPipeline(res, scene);
+  if((g_pathtraceSettings.renderMode == RenderMode::eWavefront) && !m_wavefront)
+    createWavefront(res, scene);
 
-
-  if(gbufferChanged || writeDescriptor)
+  if(gbufferChanged || writeDescriptor || featuresChanged)
   {
-    vkDeviceWaitIdle(m_device);
     scene.resetFrameCount();  // Any change in the scene requires a reset of the frame count
   }
   if(gbufferChanged)
   {
     // Need to recreate the output G-Buffers with the new size
     createGBuffer(res);
+    m_adaptive->createBuffers(res, m_gBuffers->getSize());
+    if(m_wavefront)
+      m_wavefront->createBuffers(res, m_gBuffers->getSize());
     writeDescriptor = true;
   }
   if(writeDescriptor)
   {
-    // Writing the descriptor set for the ray tracing
+    // Writing a new descriptor set for the ray tracing, the current one can still be in use
     // Which includes the top level acceleration structure and the output images
+    res.retire(std::move(m_rtxSet));
+    createRtxSet();
     writeRtxSet(scene);
   }
 }
 
 
+//------------------------------------------------------------------------------
+// Join a deferred host operation with as many threads as the driver can use,
+// and return the result of the operation.
+//
+static VkResult joinDeferredOperation(VkDevice device, VkDeferredOperationKHR operation)
+{
+  const uint32_t numThreads =
+      std::min(vkGetDeferredOperationMaxConcurrencyKHR(device, operation), std::max(1U, std::thread::hardware_concurrency()));
+
+  auto join = [&]() {
+    // VK_THREAD_IDLE_KHR: no work for now, but more may come. VK_THREAD_DONE_KHR or VK_SUCCESS: done for this thread
+    while(vkDeferredOperationJoinKHR(device, operation) == VK_THREAD_IDLE_KHR)
+      std::this_thread::yield();
+  };
+
+  std::vector<std::thread> threads;
+  for(uint32_t i = 1; i < numThreads; i++)
+    threads.emplace_back(join);
+  join();
+  for(auto& t : threads)
+    t.join();
+
+  return vkGetDeferredOperationResultKHR(device, operation);
+}
+
 //------------------------------------------------------------------------------
 // Creating the ray tracing pipeline
 //
@@ -638,8 +1025,15 @@ void RendererPathtracer::createRtxPipeline(Resources& res, Scene& scene)
       (m_reorderProperties.rayTracingInvocationReorderReorderingHint & VK_RAY_TRACING_INVOCATION_REORDER_MODE_REORDER_NV) ? 1 : 0;
   nvvk::Specialization specialization;
   specialization.add(0, supportSER);
+  specialization.add(SCENE_FEATURES_CONSTANT_ID, static_cast<int32_t>(m_shaderFeatures));
   stages[eRaygen].pSpecializationInfo = specialization.getSpecialization();
 
+  // The any-hit shaders read the materials for the opacity and the shadow transmission
+  nvvk::Specialization featureSpecialization;
+  featureSpecialization.add(SCENE_FEATURES_CONSTANT_ID, static_cast<int32_t>(m_shaderFeatures));
+  stages[eAnyHit].pSpecializationInfo   = featureSpecialization.getSpecialization();
+  stages[eShadowAH].pSpecializationInfo = featureSpecialization.getSpecialization();
+
   // Creating of the pipeline layout
   const VkPushConstantRange pushConstantRange{.stageFlags = VK_SHADER_STAGE_ALL, .offset = 0, .size = sizeof(DH::PushConstantPathtracer)};
   std::vector<VkDescriptorSetLayout> descSetLayouts = {m_rtxSet->getLayout(), scene.m_sceneDescriptorSetLayout,
@@ -665,7 +1059,20 @@ void RendererPathtracer::createRtxPipeline(Resources& res, Scene& scene)
       .maxPipelineRayRecursionDepth = 2,  // Ray depth
       .layout                       = m_rtxPipe->layout,
   };
-  NVVK_CHECK(vkCreateRayTracingPipelinesKHR(m_device, {}, {}, 1, &rtPipelineCreateInfo, nullptr, (m_rtxPipe->plines).data()));
+  // Required to trace the BLAS with micromaps; the ray queries of the other modes need no flag
+  if(m_opacityMicromaps)
+    rtPipelineCreateInfo.flags |= VK_PIPELINE_CREATE_RAY_TRACING_OPACITY_MICROMAP_BIT_EXT;
+  // The creation is deferred, such that the driver can compile the pipeline on multiple threads
+  VkDeferredOperationKHR deferredOp{VK_NULL_HANDLE};
+  NVVK_CHECK(vkCreateDeferredOperationKHR(m_device, nullptr, &deferredOp));
+  VkResult result = vkCreateRayTracingPipelinesKHR(m_device, deferredOp, res.m_pipelineCache, 1, &rtPipelineCreateInfo,
+                                                   nullptr, (m_rtxPipe->plines).data());
+  if(result == VK_OPERATION_DEFERRED_KHR)
+    result = joinDeferredOperation(m_device, deferredOp);
+  else if(result == VK_OPERATION_NOT_DEFERRED_KHR)
+    result = VK_SUCCESS;
+  vkDestroyDeferredOperationKHR(m_device, deferredOp, nullptr);
+  NVVK_CHECK(result);
   m_dutil->DBG_NAME(m_rtxPipe->plines[0]);
 
   // Creating the Shading Binding Table
@@ -700,12 +1107,16 @@ void RendererPathtracer::createIndirectPipeline(Resources& res, Scene& scene)
   NVVK_CHECK(vkCreatePipelineLayout(m_device, &pipeLayoutCreateInfo, nullptr, &m_indirectPipe->layout));
   m_dutil->DBG_NAME(m_indirectPipe->layout);
 
+  nvvk::Specialization specialization;
+  specialization.add(SCENE_FEATURES_CONSTANT_ID, static_cast<int32_t>(m_shaderFeatures));
+
   VkShaderModule                  module = m_shaderModules[eIndirect];
   VkPipelineShaderStageCreateInfo comp_shd{
-      .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-      .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
-      .module = module,
-      .pName  = "main",
+      .sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+      .stage               = VK_SHADER_STAGE_COMPUTE_BIT,
+      .module              = module,
+      .pName               = "main",
+      .pSpecializationInfo = specialization.getSpecialization(),
   };
 
   VkComputePipelineCreateInfo cpCreateInfo{
@@ -714,10 +1125,23 @@ void RendererPathtracer::createIndirectPipeline(Resources& res, Scene& scene)
       .layout = m_indirectPipe->layout,
   };
 
-  NVVK_CHECK(vkCreateComputePipelines(m_device, {}, 1, &cpCreateInfo, nullptr, &m_indirectPipe->plines[0]));
+  NVVK_CHECK(vkCreateComputePipelines(m_device, res.m_pipelineCache, 1, &cpCreateInfo, nullptr, &m_indirectPipe->plines[0]));
   m_dutil->DBG_NAME(m_indirectPipe->plines[0]);
 }
 
+//------------------------------------------------------------------------------
+// Kernels and queues of the wavefront path tracer, same descriptor sets as the indirect pipeline
+//
+void RendererPathtracer::createWavefront(Resources& res, Scene& scene)
+{
+  const std::vector<VkDescriptorSetLayout> descSetLayouts = {m_rtxSet->getLayout(), scene.m_sceneDescriptorSetLayout,
+                                                             scene.m_sky->getDescriptorSetLayout(),
+                                                             scene.m_hdrEnv->getDescriptorSetLayout()};
+  m_wavefront = std::make_unique<WavefrontPathtracer>();
+  m_wavefront->init(res, m_shaderModules[eWavefront], descSetLayouts, m_shaderFeatures);
+  m_wavefront->createBuffers(res, m_gBuffers->getSize());
+}
+
 
 //------------------------------------------------------------------------------
 // Factory function to create the renderer
@@ -18,6 +18,9 @@
  */
 
 
+#include <algorithm>
+#include <thread>
+
 #include <glm/glm.hpp>
 
 // Purpose: Raster renderer implementation
@@ -29,12 +32,16 @@ namespace DH {
 // Pre-compiled shaders
 #include "_autogen/raster.frag.glsl.h"
 #include "_autogen/raster.vert.glsl.h"
+#include "_autogen/raster_indirect.vert.glsl.h"
 #include "_autogen/raster_overlay.frag.glsl.h"
+#include "_autogen/raster.mesh.glsl.h"
+#include "_autogen/raster.task.glsl.h"
 
 
 #include "imgui.h"
 
 #include "nvh/cameramanipulator.hpp"
+#include "nvh/parallel_work.hpp"
 #include "nvh/timesampler.hpp"
 #include "nvvk/debug_util_vk.hpp"
 #include "nvvk/descriptorsets_vk.hpp"
@@ -46,6 +53,8 @@ namespace DH {
 #include "nvvkhl/shaders/dh_tonemap.h"
 #include "shaders/dh_bindings.h"
 
+#include "gpu_driven_raster.hpp"
+#include "meshlet_raster.hpp"
 #include "renderer.hpp"
 #include "silhouette.hpp"
 #include "nvvk/shaders_vk.hpp"
@@ -53,6 +62,7 @@ namespace DH {
 
 
 constexpr auto RASTER_SS_SIZE = 2;  // Change this for the default Super-Sampling resolution multiplier for raster;
+constexpr size_t kMinDrawsPerRecord = 512;  // Below this, recording on another thread costs more than it saves
 
 namespace PE = ImGuiH::PropertyEditor;
 
@@ -62,6 +72,10 @@ struct RasterSettings
 {
   bool             showWireframe{false};
   bool             useSuperSample{true};
+  bool             gpuDriven{false};         // Culling and indirect draws on the GPU
+  bool             occlusionCulling{true};  // Hi-Z of the previous frame, GPU-driven only
+  bool             meshShaders{false};      // Meshlets culled by task shaders, GPU-driven only
+  float            lodPixelError{1.0F};     // Coarsest meshlet level whose error stays below, in pixels
   DH::EDebugMethod dbgMethod{DH::eDbgMethod_none};
 } g_rasterSettings;
 
@@ -72,10 +86,10 @@ class RendererRaster : public Renderer
 
 public:
   RendererRaster() = default;
-  ~RendererRaster() { deinit(); };
+  ~RendererRaster() { destroy(); };
 
   bool init(Resources& res, Scene& scene) override;
-  void deinit(Resources& /*res*/) override { deinit(); }
+  void deinit(Resources& /*res*/) override { destroy(); }
   void render(VkCommandBuffer cmd, Resources& res, Scene& scene, Settings& settings, nvvk::ProfilerVK& profiler) override;
 
 
@@ -83,18 +97,38 @@ public:
   void handleChange(Resources& res, Scene& scene) override;
 
   VkDescriptorImageInfo getOutputImage() const override { return m_gSimpleBuffers->getDescriptorImageInfo(); }
+  VkImage               getRadianceImage() const override { return m_gSimpleBuffers->getColorImage(); }
+  VkExtent2D            getRadianceSize() const override { return m_gSimpleBuffers->getSize(); }
 
   bool reloadShaders(Resources& res, Scene& scene) override;
 
 private:
   void createRasterPipeline(Resources& res, Scene& scene);
-  void createRecordCommandBuffer();
-  void freeRecordCommandBuffer();
+  void createMeshPipeline(Resources& res, Scene& scene);
+  void createPipelineSet(Resources&                                                       res,
+                         nvvkhl::PipelineContainer&                                       container,
+                         const std::vector<std::pair<VkShaderModule, VkShaderStageFlagBits>>& preRasterShaders);
+  // A node drawn by the CPU-driven raster, with the pipeline of its list
+  struct RasterDraw
+  {
+    uint32_t pipeline;
+    uint32_t nodeID;
+  };
+
+  void createRecordCommandBuffers(uint32_t count);
+  void freeRecordCommandBuffers(Resources& res);
+  void destroyRecordCommandBuffers();
   void recordRasterScene(Scene& scene);
-  void renderNodes(VkCommandBuffer cmd, Scene& scene, const std::vector<uint32_t>& nodeIDs);
-  void renderRasterScene(VkCommandBuffer cmd, Scene& scene);
+  std::vector<RasterDraw> collectDraws(const Scene& scene) const;
+  void renderNodes(VkCommandBuffer cmd, Scene& scene, const RasterDraw* draws, size_t numDraws);
+  void renderRasterScene(VkCommandBuffer cmd, Scene& scene, const RasterDraw* draws, size_t numDraws);
+  void renderRasterSceneIndirect(VkCommandBuffer cmd, Scene& scene);
+  void renderRasterSceneMeshlets(VkCommandBuffer cmd, Scene& scene);
+  bool useMeshShaders(const Scene& scene) const;
   bool initShaders(Resources& res, bool reload);
+  void retirePipelines(Resources& res);
   void deinit();
+  void destroy();
   void createGBuffer(Resources& res, Scene& scene);
 
   enum PipelineType
@@ -102,7 +136,9 @@ private:
     eRasterSolid,
     eRasterSolidDoubleSided,
     eRasterBlend,
-    eRasterWireframe
+    eRasterWireframe,
+    // The same pipelines, pulling the vertices of the GPU-driven draws, follow
+    eRasterPipelineCount
   };
 
   enum GBufferType
@@ -114,25 +150,35 @@ private:
   DH::PushConstantRaster m_pushConst{};
 
   std::unique_ptr<nvvkhl::PipelineContainer> m_rasterPipepline{};      // Raster scene pipeline
+  std::unique_ptr<nvvkhl::PipelineContainer> m_meshPipeline{};         // Same pipelines with task and mesh shaders
   std::unique_ptr<nvvkhl::GBuffer>           m_gSuperSampleBuffers{};  // G-Buffers: RGBA32F, R8, Depth32F
   std::unique_ptr<nvvkhl::GBuffer>           m_gSimpleBuffers{};       // G-Buffers: RGBA32F
   std::unique_ptr<nvvk::DebugUtil>           m_dbgUtil{};
   std::unique_ptr<Silhouette>                m_silhouette{};
+  std::unique_ptr<GpuDrivenRaster>           m_gpuDriven{};
+  std::unique_ptr<MeshletRaster>             m_meshletRaster{};
 
   enum ShaderStages
   {
     eVertex,
     eFragment,
     eFragmentOverlay,
+    eVertexIndirect,
+    eTask,  // Task and mesh shaders, only with VK_EXT_mesh_shader
+    eMesh,
     // Last entry is the number of shaders
     eShaderGroupCount
   };
-  std::vector<shaderc::SpvCompilationResult>    m_spvShader;
+  std::vector<std::vector<uint32_t>>            m_spvShader;
   std::array<VkShaderModule, eShaderGroupCount> m_shaderModules{};
 
-  VkCommandBuffer m_recordedSceneCmd{VK_NULL_HANDLE};
-  VkDevice        m_device{VK_NULL_HANDLE};
-  VkCommandPool   m_commandPool{VK_NULL_HANDLE};
+  // The scene is recorded in several secondary command buffers, one per thread, each from its own pool
+  std::vector<VkCommandBuffer> m_recordedSceneCmds;
+  std::vector<VkCommandPool>   m_recordPools;
+  bool                         m_recordDirty{false};  // Settings changed by the UI, the scene is recorded again
+  VkDevice                     m_device{VK_NULL_HANDLE};
+  uint32_t                     m_queueFamilyIndex{~0U};
+  bool                         m_meshShaderSupport{false};
 };
 
 //--------------------------------------------------------------------------------------------------
@@ -145,21 +191,27 @@ bool RendererRaster::initShaders(Resources& res, bool reload)
   if(res.hasGlslCompiler() && (reload || g_forceExternalShaders))
   {
     // Loading the shaders
-    m_spvShader.resize(eShaderGroupCount);
-    m_spvShader[eVertex]   = res.compileGlslShader("raster.vert.glsl", shaderc_shader_kind::shaderc_vertex_shader);
-    m_spvShader[eFragment] = res.compileGlslShader("raster.frag.glsl", shaderc_shader_kind::shaderc_fragment_shader);
-    m_spvShader[eFragmentOverlay] = res.compileGlslShader("raster_overlay.frag.glsl", shaderc_shader_kind::shaderc_fragment_shader);
+    std::vector<GlslShaderFile> shaderFiles = {
+        {"raster.vert.glsl", shaderc_shader_kind::shaderc_vertex_shader},
+        {"raster.frag.glsl", shaderc_shader_kind::shaderc_fragment_shader},
+        {"raster_overlay.frag.glsl", shaderc_shader_kind::shaderc_fragment_shader},
+        {"raster_indirect.vert.glsl", shaderc_shader_kind::shaderc_vertex_shader},
+    };
+    if(m_meshShaderSupport)
+    {
+      shaderFiles.push_back({"raster.task.glsl", shaderc_shader_kind::shaderc_task_shader});
+      shaderFiles.push_back({"raster.mesh.glsl", shaderc_shader_kind::shaderc_mesh_shader});
+    }
 
+    // All shaders are compiled in parallel
+    if(!res.compileGlslShaders(shaderFiles, m_spvShader))
+    {
+      LOGE("Error when loading shaders\n");
+      return false;
+    }
     for(size_t i = 0; i < m_spvShader.size(); i++)
     {
-      auto& s = m_spvShader[i];
-      if(s.GetCompilationStatus() != shaderc_compilation_status_success)
-      {
-        LOGE("Error when loading shaders\n");
-        LOGE("Error %s\n", s.GetErrorMessage().c_str());
-        return false;
-      }
-      m_shaderModules[i] = res.createShaderModule(s);
+      m_shaderModules[i] = res.createShaderModule(m_spvShader[i]);
     }
   }
   else
@@ -167,15 +219,30 @@ bool RendererRaster::initShaders(Resources& res, bool reload)
     const auto& vert_shd = std::vector<uint32_t>{std::begin(raster_vert_glsl), std::end(raster_vert_glsl)};
     const auto& frag_shd = std::vector<uint32_t>{std::begin(raster_frag_glsl), std::end(raster_frag_glsl)};
     const auto& overlay_shd = std::vector<uint32_t>{std::begin(raster_overlay_frag_glsl), std::end(raster_overlay_frag_glsl)};
+    const auto& indirect_shd = std::vector<uint32_t>{std::begin(raster_indirect_vert_glsl), std::end(raster_indirect_vert_glsl)};
 
     m_shaderModules[eVertex]          = nvvk::createShaderModule(m_device, vert_shd);
     m_shaderModules[eFragment]        = nvvk::createShaderModule(m_device, frag_shd);
     m_shaderModules[eFragmentOverlay] = nvvk::createShaderModule(m_device, overlay_shd);
+    m_shaderModules[eVertexIndirect]  = nvvk::createShaderModule(m_device, indirect_shd);
+    if(m_meshShaderSupport)
+    {
+      const auto& task_shd = std::vector<uint32_t>{std::begin(raster_task_glsl), std::end(raster_task_glsl)};
+      const auto& mesh_shd = std::vector<uint32_t>{std::begin(raster_mesh_glsl), std::end(raster_mesh_glsl)};
+      m_shaderModules[eTask] = nvvk::createShaderModule(m_device, task_shd);
+      m_shaderModules[eMesh] = nvvk::createShaderModule(m_device, mesh_shd);
+    }
   }
 
   m_dbgUtil->DBG_NAME(m_shaderModules[eVertex]);
   m_dbgUtil->DBG_NAME(m_shaderModules[eFragment]);
   m_dbgUtil->DBG_NAME(m_shaderModules[eFragmentOverlay]);
+  m_dbgUtil->DBG_NAME(m_shaderModules[eVertexIndirect]);
+  if(m_meshShaderSupport)
+  {
+    m_dbgUtil->DBG_NAME(m_shaderModules[eTask]);
+    m_dbgUtil->DBG_NAME(m_shaderModules[eMesh]);
+  }
 
   return true;
 }
@@ -184,9 +251,9 @@ bool RendererRaster::reloadShaders(Resources& res, Scene& scene)
 {
   if(!initShaders(res, true))
     return false;
-  deinit();
+  retirePipelines(res);
   createRasterPipeline(res, scene);
-  freeRecordCommandBuffer();
+  freeRecordCommandBuffers(res);
   return true;
 }
 
@@ -196,9 +263,11 @@ bool RendererRaster::reloadShaders(Resources& res, Scene& scene)
 //
 bool RendererRaster::init(Resources& res, Scene& scene)
 {
-  m_device      = res.ctx.device;
-  m_commandPool = res.m_tempCommandPool->getCommandPool();
-  m_dbgUtil     = std::make_unique<nvvk::DebugUtil>(m_device);
+  m_device           = res.ctx.device;
+  m_queueFamilyIndex = res.ctx.GCT0.familyIndex;
+  m_dbgUtil          = std::make_unique<nvvk::DebugUtil>(m_device);
+
+  m_meshShaderSupport = MeshletScene::isSupported(res.ctx.physicalDevice);
 
   if(!initShaders(res, false))
   {
@@ -206,9 +275,11 @@ bool RendererRaster::init(Resources& res, Scene& scene)
   }
 
   m_silhouette = std::make_unique<Silhouette>(res);
+  m_gpuDriven  = std::make_unique<GpuDrivenRaster>();
+  m_gpuDriven->init(res, scene);
+  m_meshletRaster = std::make_unique<MeshletRaster>();
+  m_meshletRaster->init(res);
 
-  m_gSuperSampleBuffers = std::make_unique<nvvkhl::GBuffer>(m_device, res.m_allocator.get());
-  m_gSimpleBuffers      = std::make_unique<nvvkhl::GBuffer>(m_device, res.m_allocator.get());
   createGBuffer(res, scene);
   createRasterPipeline(res, scene);
 
@@ -216,19 +287,52 @@ bool RendererRaster::init(Resources& res, Scene& scene)
 }
 
 //--------------------------------------------------------------------------------------------------
-// Destroying all allocated resources
+// The pipelines can still be used by the frames in flight, they are destroyed once those are done
+//
+void RendererRaster::retirePipelines(Resources& res)
+{
+  for(std::unique_ptr<nvvkhl::PipelineContainer>* container : {&m_rasterPipepline, &m_meshPipeline})
+  {
+    if(*container)
+      res.retire([device = m_device, pipelines = std::shared_ptr<nvvkhl::PipelineContainer>(std::move(*container))]() {
+        pipelines->destroy(device);
+      });
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Destroying the pipelines, the shaders can be reloaded
 //
 void RendererRaster::deinit()
 {
   if(m_rasterPipepline)
     m_rasterPipepline->destroy(m_device);
   m_rasterPipepline.reset();
+  if(m_meshPipeline)
+    m_meshPipeline->destroy(m_device);
+  m_meshPipeline.reset();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Destroying all allocated resources
+//
+void RendererRaster::destroy()
+{
+  deinit();
+  destroyRecordCommandBuffers();
+  if(m_gpuDriven)
+    m_gpuDriven->deinit();
+  m_gpuDriven.reset();
+  if(m_meshletRaster)
+    m_meshletRaster->deinit();
+  m_meshletRaster.reset();
 }
 
 //--------------------------------------------------------------------------------------------------
 // Create two G-Buffers, one for the super-sampled and one for the simple
 // The rendering happens in the super-sampled and then blit to the simple
 // The super-sampled is used for the rasterization and the simple for the UI
+// The previous G-Buffers are retired, they can still be used by the frames in flight
 //
 void RendererRaster::createGBuffer(Resources& res, Scene& scene)
 {
@@ -237,34 +341,47 @@ void RendererRaster::createGBuffer(Resources& res, Scene& scene)
   static VkFormat depthFormat = nvvk::findDepthFormat(res.ctx.physicalDevice);  // Not all depth are supported
 
   // Normal size G-Buffer in which the super-sampling will be blitzed
-  m_gSimpleBuffers->destroy();
+  res.retire(std::move(m_gSimpleBuffers));
+  m_gSimpleBuffers = std::make_unique<nvvkhl::GBuffer>(m_device, res.m_allocator.get());
   m_gSimpleBuffers->create(res.m_finalImage->getSize(), {VK_FORMAT_R32G32B32A32_SFLOAT}, VK_FORMAT_UNDEFINED);
 
   // Super-Sampled G-Buffer: larger size to accommodate the super-sampling
-  VkExtent2D superSampleSize = res.m_finalImage->getSize();
+  // At the render scale of the dynamic resolution, the blit to the simple G-Buffer upscales
+  VkExtent2D superSampleSize = res.getRenderSize();
   if(g_rasterSettings.useSuperSample)
   {
     superSampleSize.width *= RASTER_SS_SIZE;
     superSampleSize.height *= RASTER_SS_SIZE;
   }
 
-  m_gSuperSampleBuffers->destroy();
+  res.retire(std::move(m_gSuperSampleBuffers));
+  m_gSuperSampleBuffers = std::make_unique<nvvkhl::GBuffer>(m_device, res.m_allocator.get());
   m_gSuperSampleBuffers->create(superSampleSize, {VK_FORMAT_R32G32B32A32_SFLOAT, VK_FORMAT_R8_UNORM}, depthFormat);
+  res.m_memory.set(MemoryBudget::eGBuffers,
+                   MemoryBudget::imageBytes(res.m_finalImage->getSize(), {VK_FORMAT_R32G32B32A32_SFLOAT})
+                       + MemoryBudget::imageBytes(superSampleSize, {VK_FORMAT_R32G32B32A32_SFLOAT, VK_FORMAT_R8_UNORM, depthFormat}));
 
   LOGI(":%dx%d", superSampleSize.width, superSampleSize.height);
+  // The sky and dome descriptor sets are written in place: only the frames of the graphics queue are
+  // waited for, the loader and the texture streaming continue on their queues
+  vkQueueWaitIdle(res.ctx.GCT0.queue);
   scene.m_sky->setOutImage(m_gSuperSampleBuffers->getDescriptorImageInfo());
-  scene.m_hdrDome->setOutImage(m_gSuperSampleBuffers->getDescriptorImageInfo());
+  scene.m_hdrEnv->getDome().setOutImage(m_gSuperSampleBuffers->getDescriptorImageInfo());
+  if(m_gpuDriven)
+    m_gpuDriven->createHiz(res, superSampleSize);
 }
 
 //--------------------------------------------------------------------------------------------------
 // Rendering the scene
 // - Draw first the sky or HDR dome
 // - Record the scene rendering (if not already done)
+// - GPU-driven: cull the draws, or with mesh shaders, update the Hi-Z used by the task shaders
 // - Execute the scene rendering
+// - GPU-driven: build the Hi-Z for the culling of the next frame
 // - Draw the bounding box of the selected node (if any)
 // - Blit the super-sampled G-Buffer to the simple G-Buffer
 //
-void RendererRaster::render(VkCommandBuffer cmd, Resources& /*res*/, Scene& scene, Settings& settings, nvvk::ProfilerVK& profiler)
+void RendererRaster::render(VkCommandBuffer cmd, Resources& res, Scene& scene, Settings& settings, nvvk::ProfilerVK& profiler)
 {
   auto scopeDbg = m_dbgUtil->DBG_SCOPE(cmd);
   auto sec      = profiler.timeRecurring("Raster", cmd);
@@ -300,17 +417,32 @@ void RendererRaster::render(VkCommandBuffer cmd, Resources& /*res*/, Scene& scen
         auto hdrsec = profiler.timeRecurring("HDR Dome", cmd);
 
         std::array<float, 4> color{settings.hdrEnvIntensity, settings.hdrEnvIntensity, settings.hdrEnvIntensity, 1.0F};
-        scene.m_hdrDome->draw(cmd, view, proj, imgSize, color.data(), settings.hdrEnvRotation, settings.hdrBlur);
+        scene.m_hdrEnv->getDome().draw(cmd, view, proj, imgSize, color.data(), settings.hdrEnvRotation, settings.hdrBlur);
       }
     }
   }
 
   // Scene is recorded to avoid CPU overhead
-  if(m_recordedSceneCmd == VK_NULL_HANDLE)
+  if(m_recordedSceneCmds.empty())
   {
+    if(useMeshShaders(scene))
+      m_meshletRaster->update(res, scene, g_rasterSettings.showWireframe);
+    else if(g_rasterSettings.gpuDriven)
+      m_gpuDriven->update(res, scene, g_rasterSettings.showWireframe);
     recordRasterScene(scene);
   }
 
+  // The recorded indirect draws consume the commands of the culling
+  if(useMeshShaders(scene))
+  {
+    m_gpuDriven->cmdUpdateCullInfo(cmd, g_rasterSettings.occlusionCulling, VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT);
+  }
+  else if(g_rasterSettings.gpuDriven)
+  {
+    auto cullsec = profiler.timeRecurring("Cull", cmd);
+    m_gpuDriven->cmdCull(cmd, scene, g_rasterSettings.occlusionCulling);
+  }
+
   // Execute recorded command buffer - the scene graph traversal is already in the secondary command buffer,
   // but still need to execute it
   {
@@ -365,10 +497,17 @@ void RendererRaster::render(VkCommandBuffer cmd, Resources& /*res*/, Scene& scen
     };
 
     vkCmdBeginRendering(cmd, &renderingInfo);
-    vkCmdExecuteCommands(cmd, 1, &m_recordedSceneCmd);
+    vkCmdExecuteCommands(cmd, static_cast<uint32_t>(m_recordedSceneCmds.size()), m_recordedSceneCmds.data());
     vkCmdEndRendering(cmd);
   }
 
+  if(g_rasterSettings.gpuDriven && g_rasterSettings.occlusionCulling)
+  {
+    auto hizsec = profiler.timeRecurring("Hi-Z", cmd);
+    m_gpuDriven->cmdBuildHiz(cmd, m_gSuperSampleBuffers->getDepthImage(), m_gSuperSampleBuffers->getDepthImageView(),
+                             scene.m_sceneFrameInfo.projMatrix * scene.m_sceneFrameInfo.viewMatrix);
+  }
+
   {
     // Silhouette: rendering the selected node in the second color attachment
     if(m_silhouette->isValid())
@@ -413,6 +552,23 @@ bool RendererRaster::onUI()
     PE::begin();
     changed |= PE::Checkbox("Show Wireframe", &g_rasterSettings.showWireframe);
     changed |= PE::Checkbox("Use Super Sample", &g_rasterSettings.useSuperSample);
+    changed |= PE::Checkbox("GPU-Driven", &g_rasterSettings.gpuDriven, "Frustum and occlusion culling in a compute shader, one indirect draw per pipeline");
+    if(g_rasterSettings.gpuDriven)
+    {
+      changed |= PE::Checkbox("Occlusion Culling", &g_rasterSettings.occlusionCulling, "Test against the depth of the previous frame");
+      if(m_meshPipeline)
+        changed |= PE::Checkbox("Mesh Shaders", &g_rasterSettings.meshShaders, "Meshlets culled and LOD selected by task shaders");
+      if(m_meshPipeline && g_rasterSettings.meshShaders)
+      {
+        changed |= PE::SliderFloat("LOD Pixel Error", &g_rasterSettings.lodPixelError, 0.1F, 32.0F, "%.1f",
+                                   ImGuiSliderFlags_Logarithmic, "Screen error allowed for the simplified levels");
+        PE::Text("Meshlet Tasks", std::to_string(m_meshletRaster->numTasks()));
+      }
+      else
+      {
+        PE::Text("Draw Candidates", std::to_string(m_gpuDriven->numCandidates()));
+      }
+    }
     changed |= PE::Combo("Debug Method", reinterpret_cast<int32_t*>(&g_rasterSettings.dbgMethod),
                          "None\0Metallic\0Roughness\0Normal\0Tangent\0Bitangent\0BaseColor\0Emissive\0Opacity\0TexCoord0\0TexCoord1\0\0");
     PE::end();
@@ -420,8 +576,7 @@ bool RendererRaster::onUI()
   }
   if(changed)
   {
-    vkDeviceWaitIdle(m_device);
-    freeRecordCommandBuffer();
+    m_recordDirty = true;  // Re-recorded by handleChange, before the next rendering
   }
   return changed;
 }
@@ -431,18 +586,17 @@ bool RendererRaster::onUI()
 //
 void RendererRaster::handleChange(Resources& res, Scene& scene)
 {
-  static int  lastSelection       = -1;
-  static bool lastUseSuperSample  = g_rasterSettings.useSuperSample;
-  bool        resetRecorededScene = (lastSelection != scene.getSelectedRenderNode());
-  bool        gbufferChanged      = res.hasGBuffersChanged() || (lastUseSuperSample != g_rasterSettings.useSuperSample);
-  bool        updateHdrDome       = scene.hasDirtyFlag(Scene::eHdrEnv);
-  bool        visibilityChanged   = scene.hasDirtyFlag(Scene::eNodeVisibility);
-
-  if(gbufferChanged || resetRecorededScene || updateHdrDome || visibilityChanged)
-  {
-    vkDeviceWaitIdle(m_device);
-    lastSelection = scene.getSelectedRenderNode();
-    freeRecordCommandBuffer();
+  // The selection is in the frame info, it does not need the scene to be recorded again
+  static bool lastUseSuperSample = g_rasterSettings.useSuperSample;
+  bool        gbufferChanged     = res.hasGBuffersChanged() || (lastUseSuperSample != g_rasterSettings.useSuperSample);
+  bool        updateHdrDome      = scene.hasDirtyFlag(Scene::eHdrEnv);
+  bool        visibilityChanged  = scene.hasDirtyFlag(Scene::eNodeVisibility);
+  bool        descriptorChanged  = scene.hasDirtyFlag(Scene::eSceneDescriptorSet);
+
+  if(gbufferChanged || updateHdrDome || visibilityChanged || descriptorChanged || m_recordDirty)
+  {
+    m_recordDirty = false;
+    freeRecordCommandBuffers(res);
   }
   if(gbufferChanged)
   {
@@ -453,7 +607,7 @@ void RendererRaster::handleChange(Resources& res, Scene& scene)
   }
   if(updateHdrDome)
   {
-    scene.m_hdrDome->setOutImage(m_gSuperSampleBuffers->getDescriptorImageInfo());
+    scene.m_hdrEnv->getDome().setOutImage(m_gSuperSampleBuffers->getDescriptorImageInfo());
   }
 }
 
@@ -471,14 +625,14 @@ void RendererRaster::createRasterPipeline(Resources& res, Scene& scene)
   m_rasterPipepline                      = std::make_unique<nvvkhl::PipelineContainer>();
 
   VkDescriptorSetLayout sceneSet   = scene.m_sceneDescriptorSetLayout;
-  VkDescriptorSetLayout hdrDomeSet = scene.m_hdrDome->getDescLayout();
+  VkDescriptorSetLayout hdrDomeSet = scene.m_hdrEnv->getDome().getDescLayout();
   VkDescriptorSetLayout skySet     = scene.m_sky->getDescriptorSetLayout();
 
   // Creating the Pipeline Layout
   std::vector<VkDescriptorSetLayout> layouts{sceneSet, hdrDomeSet, skySet};
   const VkPushConstantRange pushConstantRanges = {.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
                                                   .offset = 0,
-                                                  .size   = sizeof(DH::PushConstantRaster)};
+                                                  .size   = sizeof(DH::PushConstantRasterIndirect)};
   VkPipelineLayoutCreateInfo create_info{
       .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
       .setLayoutCount         = static_cast<uint32_t>(layouts.size()),
@@ -488,6 +642,54 @@ void RendererRaster::createRasterPipeline(Resources& res, Scene& scene)
   };
   vkCreatePipelineLayout(m_device, &create_info, nullptr, &m_rasterPipepline->layout);
 
+  createPipelineSet(res, *m_rasterPipepline, {{m_shaderModules[eVertex], VK_SHADER_STAGE_VERTEX_BIT}});
+  createPipelineSet(res, *m_rasterPipepline, {{m_shaderModules[eVertexIndirect], VK_SHADER_STAGE_VERTEX_BIT}});
+  if(m_meshShaderSupport)
+    createMeshPipeline(res, scene);
+
+  // Cleanup
+  for(VkShaderModule& shaderModule : m_shaderModules)
+  {
+    vkDestroyShaderModule(m_device, shaderModule, nullptr);
+    shaderModule = VK_NULL_HANDLE;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// The mesh shader pipelines have their own layout: the push constant is also used by the task
+// and mesh stages, which the pipelines with a vertex shader must not declare
+//
+void RendererRaster::createMeshPipeline(Resources& res, Scene& scene)
+{
+  m_meshPipeline = std::make_unique<nvvkhl::PipelineContainer>();
+
+  std::vector<VkDescriptorSetLayout> layouts{scene.m_sceneDescriptorSetLayout, scene.m_hdrEnv->getDome().getDescLayout(),
+                                             scene.m_sky->getDescriptorSetLayout()};
+  const VkPushConstantRange pushConstantRanges = {.stageFlags = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT
+                                                                | VK_SHADER_STAGE_FRAGMENT_BIT,
+                                                  .offset = 0,
+                                                  .size   = sizeof(DH::PushConstantMeshlet)};
+  VkPipelineLayoutCreateInfo create_info{
+      .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount         = static_cast<uint32_t>(layouts.size()),
+      .pSetLayouts            = layouts.data(),
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges    = &pushConstantRanges,
+  };
+  vkCreatePipelineLayout(m_device, &create_info, nullptr, &m_meshPipeline->layout);
+
+  createPipelineSet(res, *m_meshPipeline,
+                    {{m_shaderModules[eTask], VK_SHADER_STAGE_TASK_BIT_EXT}, {m_shaderModules[eMesh], VK_SHADER_STAGE_MESH_BIT_EXT}});
+}
+
+//--------------------------------------------------------------------------------------------------
+// Solid, double sided, blend and wireframe pipelines, appended to the container.
+// There is no vertex input, the vertex or mesh shaders fetch the positions (see vertex_fetch.h).
+//
+void RendererRaster::createPipelineSet(Resources&                                                       res,
+                                       nvvkhl::PipelineContainer&                                       container,
+                                       const std::vector<std::pair<VkShaderModule, VkShaderStageFlagBits>>& preRasterShaders)
+{
   std::vector<VkFormat>         color_format = {m_gSuperSampleBuffers->getColorFormat(GBufferType::eSuperSample),
                                                 m_gSuperSampleBuffers->getColorFormat(GBufferType::eSilhouette)};
   VkPipelineRenderingCreateInfo renderingInfo{
@@ -498,13 +700,8 @@ void RendererRaster::createRasterPipeline(Resources& res, Scene& scene)
   };
 
   // Creating the Pipeline
-  nvvk::GraphicsPipelineGeneratorCombined gpb(m_device, m_rasterPipepline->layout, {} /*m_offscreenRenderPass*/);
+  nvvk::GraphicsPipelineGeneratorCombined gpb(m_device, container.layout, {} /*m_offscreenRenderPass*/);
   gpb.createInfo.pNext = &renderingInfo;
-  gpb.addBindingDescriptions({{0, sizeof(glm::vec3)}});
-  gpb.addAttributeDescriptions({
-      {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0},  // Position
-  });
-
   {
     // Solid
     gpb.rasterizationState.depthBiasEnable         = VK_TRUE;
@@ -522,14 +719,15 @@ void RendererRaster::createRasterPipeline(Resources& res, Scene& scene)
       gpb.setBlendAttachmentState(1, blend_state);
     }
 
-    gpb.addShader(m_shaderModules[eVertex], VK_SHADER_STAGE_VERTEX_BIT);
+    for(const auto& [shaderModule, stage] : preRasterShaders)
+      gpb.addShader(shaderModule, stage);
     gpb.addShader(m_shaderModules[eFragment], VK_SHADER_STAGE_FRAGMENT_BIT);
-    m_rasterPipepline->plines.push_back(gpb.createPipeline());
-    m_dbgUtil->DBG_NAME(m_rasterPipepline->plines[eRasterSolid]);
+    container.plines.push_back(gpb.createPipeline(res.m_pipelineCache));
+    m_dbgUtil->DBG_NAME(container.plines.back());
     // Double Sided
     gpb.rasterizationState.cullMode = VK_CULL_MODE_NONE;
-    m_rasterPipepline->plines.push_back(gpb.createPipeline());
-    m_dbgUtil->DBG_NAME(m_rasterPipepline->plines[eRasterSolidDoubleSided]);
+    container.plines.push_back(gpb.createPipeline(res.m_pipelineCache));
+    m_dbgUtil->DBG_NAME(container.plines.back());
 
     // Blend
     gpb.rasterizationState.cullMode = VK_CULL_MODE_NONE;
@@ -540,8 +738,8 @@ void RendererRaster::createRasterPipeline(Resources& res, Scene& scene)
     blend_state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
     blend_state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
     gpb.setBlendAttachmentState(0, blend_state);
-    m_rasterPipepline->plines.push_back(gpb.createPipeline());
-    m_dbgUtil->DBG_NAME(m_rasterPipepline->plines[eRasterBlend]);
+    container.plines.push_back(gpb.createPipeline(res.m_pipelineCache));
+    m_dbgUtil->DBG_NAME(container.plines.back());
 
     // Revert Blend Mode
     blend_state.blendEnable = VK_FALSE;
@@ -551,54 +749,91 @@ void RendererRaster::createRasterPipeline(Resources& res, Scene& scene)
   // Wireframe
   {
     gpb.clearShaders();
-    gpb.addShader(m_shaderModules[eVertex], VK_SHADER_STAGE_VERTEX_BIT);
+    for(const auto& [shaderModule, stage] : preRasterShaders)
+      gpb.addShader(shaderModule, stage);
     gpb.addShader(m_shaderModules[eFragmentOverlay], VK_SHADER_STAGE_FRAGMENT_BIT);
     gpb.rasterizationState.depthBiasEnable = VK_FALSE;
     gpb.rasterizationState.polygonMode     = VK_POLYGON_MODE_LINE;
     gpb.rasterizationState.lineWidth       = 1.0F;
     gpb.depthStencilState.depthWriteEnable = VK_FALSE;
-    m_rasterPipepline->plines.push_back(gpb.createPipeline());
-    m_dbgUtil->DBG_NAME(m_rasterPipepline->plines[eRasterWireframe]);
+    container.plines.push_back(gpb.createPipeline(res.m_pipelineCache));
+    m_dbgUtil->DBG_NAME(container.plines.back());
   }
-
-  // Cleanup
-  vkDestroyShaderModule(m_device, m_shaderModules[eVertex], nullptr);
-  vkDestroyShaderModule(m_device, m_shaderModules[eFragment], nullptr);
-  vkDestroyShaderModule(m_device, m_shaderModules[eFragmentOverlay], nullptr);
 }
 
 
 //--------------------------------------------------------------------------------------------------
-// Raster commands are recorded to be replayed, this allocates that command buffer
+// Raster commands are recorded to be replayed, this allocates the command buffers. Each one has
+// its own pool, such that they can be recorded by different threads.
 //
-void RendererRaster::createRecordCommandBuffer()
+void RendererRaster::createRecordCommandBuffers(uint32_t count)
 {
-  VkCommandBufferAllocateInfo alloc_info{
-      .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-      .commandPool        = m_commandPool,
-      .level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
-      .commandBufferCount = 1,
+  const VkCommandPoolCreateInfo poolInfo{
+      .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+      .queueFamilyIndex = m_queueFamilyIndex,
   };
-  vkAllocateCommandBuffers(m_device, &alloc_info, &m_recordedSceneCmd);
+  m_recordPools.resize(count);
+  m_recordedSceneCmds.resize(count);
+  for(uint32_t i = 0; i < count; i++)
+  {
+    NVVK_CHECK(vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_recordPools[i]));
+    VkCommandBufferAllocateInfo alloc_info{
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool        = m_recordPools[i],
+        .level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+        .commandBufferCount = 1,
+    };
+    NVVK_CHECK(vkAllocateCommandBuffers(m_device, &alloc_info, &m_recordedSceneCmds[i]));
+  }
 }
 
 //--------------------------------------------------------------------------------------------------
-// Freeing the raster recoded command buffer
+// Freeing the raster recorded command buffers, once the frames in flight are done executing them.
+// Destroying the pools frees their command buffers.
 //
-void RendererRaster::freeRecordCommandBuffer()
+void RendererRaster::freeRecordCommandBuffers(Resources& res)
 {
-  vkFreeCommandBuffers(m_device, m_commandPool, 1, &m_recordedSceneCmd);
-  m_recordedSceneCmd = VK_NULL_HANDLE;
+  if(!m_recordPools.empty())
+  {
+    res.retire([device = m_device, pools = std::move(m_recordPools)]() {
+      for(VkCommandPool pool : pools)
+        vkDestroyCommandPool(device, pool, nullptr);
+    });
+  }
+  m_recordPools.clear();
+  m_recordedSceneCmds.clear();
+  if(m_gpuDriven)
+    m_gpuDriven->setDirty();  // Visibility or wireframe could have changed
+  if(m_meshletRaster)
+    m_meshletRaster->setDirty();
+}
+
+void RendererRaster::destroyRecordCommandBuffers()
+{
+  for(VkCommandPool pool : m_recordPools)
+    vkDestroyCommandPool(m_device, pool, nullptr);
+  m_recordPools.clear();
+  m_recordedSceneCmds.clear();
 }
 
 //--------------------------------------------------------------------------------------------------
-// Recording in a secondary command buffer, the raster rendering of the scene.
+// Recording in secondary command buffers, the raster rendering of the scene.
+// The draws of the CPU-driven raster are split in contiguous ranges, recorded in parallel and
+// executed in order, such that the blend-able nodes keep their order.
+// The GPU-driven and mesh shader versions only have a few draws, they are recorded in one buffer.
 //
 void RendererRaster::recordRasterScene(Scene& scene)
 {
   nvh::ScopedTimer st(__FUNCTION__);
 
-  createRecordCommandBuffer();
+  std::vector<RasterDraw> draws;
+  if(!useMeshShaders(scene) && !g_rasterSettings.gpuDriven)
+    draws = collectDraws(scene);
+
+  const uint32_t maxRecords = std::max(1U, std::thread::hardware_concurrency());
+  const uint32_t numRecords = std::clamp(static_cast<uint32_t>(draws.size() / kMinDrawsPerRecord), 1U, maxRecords);
+  createRecordCommandBuffers(numRecords);
 
   std::vector<VkFormat> colorFormat = {m_gSuperSampleBuffers->getColorFormat(GBufferType::eSuperSample),
                                        m_gSuperSampleBuffers->getColorFormat(GBufferType::eSilhouette)};
@@ -620,48 +855,82 @@ void RendererRaster::recordRasterScene(Scene& scene)
       .pInheritanceInfo = &inheritInfo,
   };
 
-  vkBeginCommandBuffer(m_recordedSceneCmd, &beginInfo);
-  renderRasterScene(m_recordedSceneCmd, scene);
-  vkEndCommandBuffer(m_recordedSceneCmd);
+  nvh::parallel_batches<1>(
+      numRecords,
+      [&](uint64_t i) {
+        const size_t first = draws.size() * i / numRecords;
+        const size_t last  = draws.size() * (i + 1) / numRecords;
+
+        VkCommandBuffer cmd = m_recordedSceneCmds[i];
+        vkBeginCommandBuffer(cmd, &beginInfo);
+        renderRasterScene(cmd, scene, draws.data() + first, last - first);
+        vkEndCommandBuffer(cmd);
+      },
+      numRecords);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The visible nodes in the order of rendering: solid, double-sided, blend-able and the wireframe
+// on top, if active.
+std::vector<RendererRaster::RasterDraw> RendererRaster::collectDraws(const Scene& scene) const
+{
+  const std::vector<nvh::gltf::RenderNode>& renderNodes = scene.m_gltfScene->getRenderNodes();
+
+  std::vector<RasterDraw> draws;
+  auto addNodes = [&](PipelineType pipeline, const std::vector<uint32_t>& nodeIDs) {
+    for(uint32_t nodeID : nodeIDs)
+    {
+      if(renderNodes[nodeID].visible)
+        draws.push_back({static_cast<uint32_t>(pipeline), nodeID});
+    }
+  };
+  addNodes(eRasterSolid, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterSolid));
+  addNodes(eRasterSolidDoubleSided, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterSolidDoubleSided));
+  addNodes(eRasterBlend, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterBlend));
+  if(g_rasterSettings.showWireframe)
+    addNodes(eRasterWireframe, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterAll));
+  return draws;
 }
 
 //--------------------------------------------------------------------------------------------------
-// Rendering the GLTF nodes (instances) contained in the list
-// The list should be: solid, blendable, all
-void RendererRaster::renderNodes(VkCommandBuffer cmd, Scene& scene, const std::vector<uint32_t>& nodeIDs)
+// Rendering the GLTF nodes (instances) of the draws, binding the pipeline when it changes.
+// Called from several threads: the push constant is a local copy.
+void RendererRaster::renderNodes(VkCommandBuffer cmd, Scene& scene, const RasterDraw* draws, size_t numDraws)
 {
   auto scope_dbg = m_dbgUtil->DBG_SCOPE(cmd);
 
-  const VkDeviceSize                             offsets{0};
   const std::vector<nvh::gltf::RenderNode>&      renderNodes = scene.m_gltfScene->getRenderNodes();
   const std::vector<nvh::gltf::RenderPrimitive>& subMeshes   = scene.m_gltfScene->getRenderPrimitives();
 
-  for(const uint32_t& nodeID : nodeIDs)
+  DH::PushConstantRaster pushConst = m_pushConst;
+  uint32_t               pipeline  = eRasterPipelineCount;
+  for(size_t i = 0; i < numDraws; i++)
   {
-    const nvh::gltf::RenderNode&      renderNode = renderNodes[nodeID];
+    const nvh::gltf::RenderNode&      renderNode = renderNodes[draws[i].nodeID];
     const nvh::gltf::RenderPrimitive& subMesh = subMeshes[renderNode.renderPrimID];  // Mesh referred by the draw object
 
-    if(!renderNode.visible)
-      continue;
+    if(draws[i].pipeline != pipeline)
+    {
+      pipeline = draws[i].pipeline;
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_rasterPipepline->plines[pipeline]);
+    }
 
-    m_pushConst.materialID         = renderNode.materialID;
-    m_pushConst.renderNodeID       = static_cast<int>(nodeID);
-    m_pushConst.renderPrimID       = renderNode.renderPrimID;
-    m_pushConst.selectedRenderNode = scene.getSelectedRenderNode();
+    pushConst.materialID   = renderNode.materialID;
+    pushConst.renderNodeID = static_cast<int>(draws[i].nodeID);
+    pushConst.renderPrimID = renderNode.renderPrimID;
     vkCmdPushConstants(cmd, m_rasterPipepline->layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-                       sizeof(DH::PushConstantRaster), &m_pushConst);
+                       sizeof(DH::PushConstantRaster), &pushConst);
 
-    vkCmdBindVertexBuffers(cmd, 0, 1, &scene.m_gltfSceneVk->vertexBuffers()[renderNode.renderPrimID].position.buffer, &offsets);
     vkCmdBindIndexBuffer(cmd, scene.m_gltfSceneVk->indices()[renderNode.renderPrimID].buffer, 0, VK_INDEX_TYPE_UINT32);
     vkCmdDrawIndexed(cmd, subMesh.indexCount, 1, 0, 0, 0);
   }
 }
 
 //--------------------------------------------------------------------------------------------------
-// Render the entire scene for raster. Splitting the solid and blend-able element and rendering
-// on top, the wireframe if active.
-// This is done in a recoded command buffer to be replay
-void RendererRaster::renderRasterScene(VkCommandBuffer cmd, Scene& scene)
+// Render the scene for raster, see collectDraws for the order of the draws.
+// This is done in recorded command buffers to be replayed, each one renders a range of the draws
+// and sets its own state.
+void RendererRaster::renderRasterScene(VkCommandBuffer cmd, Scene& scene, const RasterDraw* draws, size_t numDraws)
 {
   auto scope_dbg = m_dbgUtil->DBG_SCOPE(cmd);
 
@@ -675,27 +944,84 @@ void RendererRaster::renderRasterScene(VkCommandBuffer cmd, Scene& scene)
   vkCmdSetScissor(cmd, 0, 1, &scissor);
 
 
-  std::vector dset = {scene.m_sceneDescriptorSet, scene.m_hdrDome->getDescSet(), scene.m_sky->getDescriptorSet()};
+  std::vector dset = {scene.m_sceneDescriptorSet, scene.m_hdrEnv->getDome().getDescSet(), scene.m_sky->getDescriptorSet()};
   vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_rasterPipepline->layout, 0,
                           static_cast<uint32_t>(dset.size()), dset.data(), 0, nullptr);
-  // Draw solid
-  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_rasterPipepline->plines[eRasterSolid]);
-  renderNodes(cmd, scene, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterSolid));
-  //
-  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_rasterPipepline->plines[eRasterSolidDoubleSided]);
-  renderNodes(cmd, scene, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterSolidDoubleSided));
-  // Draw blend-able
-  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_rasterPipepline->plines[eRasterBlend]);
-  renderNodes(cmd, scene, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterBlend));
+  if(useMeshShaders(scene))
+  {
+    renderRasterSceneMeshlets(cmd, scene);
+    return;
+  }
+  if(g_rasterSettings.gpuDriven)
+  {
+    renderRasterSceneIndirect(cmd, scene);
+    return;
+  }
 
-  if(g_rasterSettings.showWireframe)
+  renderNodes(cmd, scene, draws, numDraws);
+}
+
+//--------------------------------------------------------------------------------------------------
+// GPU-driven version: one indirect draw per pipeline, the commands are written by the culling
+// of each frame, so the recorded command buffer stays valid until the candidates change.
+void RendererRaster::renderRasterSceneIndirect(VkCommandBuffer cmd, Scene& scene)
+{
+  DH::PushConstantRasterIndirect pushConst{.raster = m_pushConst};
+
+  const std::array<std::pair<PipelineType, GpuDrivenRaster::Bucket>, 4> draws{{
+      {eRasterSolid, GpuDrivenRaster::eBucketSolid},
+      {eRasterSolidDoubleSided, GpuDrivenRaster::eBucketSolidDoubleSided},
+      {eRasterBlend, GpuDrivenRaster::eBucketBlend},
+      {eRasterWireframe, GpuDrivenRaster::eBucketWireframe},
+  }};
+  for(const auto& [pipeline, bucket] : draws)
   {
-    // Draw wireframe
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_rasterPipepline->plines[eRasterWireframe]);
-    renderNodes(cmd, scene, scene.m_gltfScene->getShadedNodes(nvh::gltf::Scene::eRasterAll));
+    if(bucket == GpuDrivenRaster::eBucketWireframe && !g_rasterSettings.showWireframe)
+      continue;
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_rasterPipepline->plines[eRasterPipelineCount + pipeline]);
+    m_gpuDriven->cmdDraw(cmd, bucket, m_rasterPipepline->layout, pushConst);
   }
 }
 
+//--------------------------------------------------------------------------------------------------
+// Mesh shader version: one task draw per pipeline, the task shaders cull the meshlets each frame
+// with the Hi-Z of GpuDrivenRaster, so the recorded command buffer stays valid as well.
+void RendererRaster::renderRasterSceneMeshlets(VkCommandBuffer cmd, Scene& scene)
+{
+  // Not compatible with the layout of the other pipelines, the push constant ranges differ
+  std::vector dset = {scene.m_sceneDescriptorSet, scene.m_hdrEnv->getDome().getDescSet(), scene.m_sky->getDescriptorSet()};
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_meshPipeline->layout, 0,
+                          static_cast<uint32_t>(dset.size()), dset.data(), 0, nullptr);
+
+  DH::PushConstantMeshlet pushConst{.raster = m_pushConst};
+  pushConst.meshletScene       = scene.getMeshletScene().sceneDescAddress();
+  pushConst.cullInfo           = m_gpuDriven->cullInfoAddress();
+  pushConst.lodPixelError      = g_rasterSettings.lodPixelError;
+  pushConst.viewportHeight     = static_cast<float>(m_gSuperSampleBuffers->getSize().height);
+  const uint32_t occlusionFlag = g_rasterSettings.occlusionCulling ? MESHLET_FLAG_OCCLUSION : 0;
+
+  const std::array<std::pair<PipelineType, GpuDrivenRaster::Bucket>, 4> draws{{
+      {eRasterSolid, GpuDrivenRaster::eBucketSolid},
+      {eRasterSolidDoubleSided, GpuDrivenRaster::eBucketSolidDoubleSided},
+      {eRasterBlend, GpuDrivenRaster::eBucketBlend},
+      {eRasterWireframe, GpuDrivenRaster::eBucketWireframe},
+  }};
+  for(const auto& [pipeline, bucket] : draws)
+  {
+    if(bucket == GpuDrivenRaster::eBucketWireframe && !g_rasterSettings.showWireframe)
+      continue;
+    // Back faces are only culled by the single sided pipeline
+    pushConst.flags = occlusionFlag | (bucket == GpuDrivenRaster::eBucketSolid ? MESHLET_FLAG_CONE_CULLING : 0);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_meshPipeline->plines[pipeline]);
+    m_meshletRaster->cmdDraw(cmd, bucket, m_meshPipeline->layout, pushConst);
+  }
+}
+
+bool RendererRaster::useMeshShaders(const Scene& scene) const
+{
+  return g_rasterSettings.gpuDriven && g_rasterSettings.meshShaders && m_meshPipeline && scene.getMeshletScene().isValid();
+}
+
 //--------------------------------------------------------------------------------------------------
 // Create the raster renderer
 //
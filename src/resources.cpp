@@ -23,12 +23,23 @@
 #include <dlfcn.h>
 #endif
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <thread>
+
 #include "resources.hpp"
+#include "cache_utils.hpp"
 #include "vulkan/vulkan_core.h"
 #include "nvvk/renderpasses_vk.hpp"
 #include "nvvk/debug_util_vk.hpp"
 #include "nvvk/error_vk.hpp"
+#include "nvvk/shaders_vk.hpp"
 #include "nvvkhl/glsl_compiler.hpp"
+#include "nvh/fileoperations.hpp"
+#include "nvh/parallel_work.hpp"
 #include "nvh/timesampler.hpp"
 
 extern std::vector<std::string> g_applicationSearchPaths;  // Used by the shader manager
@@ -65,16 +76,21 @@ static bool checkLibraryAvailability(const char* libraryName)
 //
 // The G-Buffers are used to store the result of the renderers.
 // The allocator is used to allocate memory for the Vulkan objects.
+// The scene allocator is only used by the scene, such that a scene can be
+// created on a separate thread while the current one is still rendering.
 // The shader manager is used to compile the shaders.
 // The temporary command pool is used to create temporary command buffers.
+// The pipeline cache is used for all pipelines and is reloaded from disk.
 void gltfr::Resources::init(VulkanInfo& _ctx)
 {
   ctx = _ctx;
 
   m_allocator       = std::make_unique<nvvk::ResourceAllocatorDma>(ctx.device, ctx.physicalDevice);
-  m_finalImage      = std::make_unique<nvvkhl::GBuffer>(ctx.device, m_allocator.get());
+  m_sceneAllocator  = std::make_unique<nvvk::ResourceAllocatorDma>(ctx.device, ctx.physicalDevice);
   m_tempCommandPool = std::make_unique<nvvk::CommandPool>(ctx.device, ctx.GCT0.familyIndex,
                                                           VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, ctx.GCT0.queue);
+  m_frameGraph.init(ctx.device, ctx.GCT0.familyIndex, ctx.asyncCompute.queue, ctx.asyncCompute.familyIndex);
+  m_memory.init(ctx.device, ctx.physicalDevice);
 
   // Shader compilers
   const bool glslCompilerFound = checkLibraryAvailability("shaderc_shared");
@@ -100,23 +116,177 @@ void gltfr::Resources::init(VulkanInfo& _ctx)
     LOGW("Slang shared library not found, Slang compilation not available\n");
   }
 
+  createPipelineCache();
 
   resizeGbuffers({128, 128});
 }
 
+//------------------------------------------------------------------
+// Saving the pipeline cache for the next run of the application
+void gltfr::Resources::deinit()
+{
+  m_frameGraph.deinit();
+  releaseRetired();
+  savePipelineCache();
+  vkDestroyPipelineCache(ctx.device, m_pipelineCache, nullptr);
+  m_pipelineCache = VK_NULL_HANDLE;
+}
+
+//------------------------------------------------------------------
+// The pipeline cache data is only valid for the same device and driver,
+// therefore the file is named after them.
+static std::filesystem::path getPipelineCachePath(VkPhysicalDevice physicalDevice)
+{
+  gltfr::Hasher hasher;
+  hasher.addDevice(physicalDevice);
+  return gltfr::getCacheDirectory() / ("pipelines_" + hasher.toString() + ".bin");
+}
+
+//------------------------------------------------------------------
+// Create the pipeline cache, with the data of the previous run if it
+// matches the current device. The header is checked before giving the
+// data to the driver, as not all drivers are robust to foreign data.
+void gltfr::Resources::createPipelineCache()
+{
+  std::vector<char> data;
+  readCacheFile(getPipelineCachePath(ctx.physicalDevice), data);
+
+  VkPipelineCacheHeaderVersionOne header{};
+  if(data.size() >= sizeof(header))
+  {
+    std::memcpy(&header, data.data(), sizeof(header));
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(ctx.physicalDevice, &props);
+    if(header.headerSize < sizeof(header) || header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+       || header.vendorID != props.vendorID || header.deviceID != props.deviceID
+       || std::memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+      data.clear();
+    }
+  }
+  else
+  {
+    data.clear();
+  }
+
+  VkPipelineCacheCreateInfo createInfo{
+      .sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .initialDataSize = data.size(),
+      .pInitialData    = data.data(),
+  };
+  if(vkCreatePipelineCache(ctx.device, &createInfo, nullptr, &m_pipelineCache) != VK_SUCCESS)
+  {
+    // Start from an empty cache if the driver refuses the data
+    createInfo.initialDataSize = 0;
+    createInfo.pInitialData    = nullptr;
+    NVVK_CHECK(vkCreatePipelineCache(ctx.device, &createInfo, nullptr, &m_pipelineCache));
+  }
+  if(!data.empty())
+    LOGI("Pipeline cache: %zu bytes loaded\n", data.size());
+}
+
+//------------------------------------------------------------------
+// Write the content of the pipeline cache to disk
+void gltfr::Resources::savePipelineCache() const
+{
+  if(m_pipelineCache == VK_NULL_HANDLE)
+    return;
+
+  size_t dataSize = 0;
+  if(vkGetPipelineCacheData(ctx.device, m_pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+    return;
+  std::vector<char> data(dataSize);
+  if(vkGetPipelineCacheData(ctx.device, m_pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+    return;
+  if(!writeCacheFile(getPipelineCachePath(ctx.physicalDevice), data.data(), dataSize))
+    LOGW("Could not write the pipeline cache\n");
+}
+
 //------------------------------------------------------------------
 // Resize the G-Buffers, which is only a color buffer, as this is
 // to display the result of the renderers.
 // The image is created with the VK_FORMAT_R8G8B8A8_UNORM format,
 // therefore the image should be tonemapped before displaying.
+// The previous image is retired, as it can still be used by the frames
+// in flight.
 void gltfr::Resources::resizeGbuffers(const VkExtent2D& size)
 {
-  vkDeviceWaitIdle(ctx.device);
-  m_finalImage->destroy();
+  retire(std::move(m_finalImage));
+  m_finalImage = std::make_unique<nvvkhl::GBuffer>(ctx.device, m_allocator.get());
   m_finalImage->create(size, {VK_FORMAT_R8G8B8A8_UNORM}, VK_FORMAT_UNDEFINED);
   setGBuffersChanged(true);
 }
 
+//------------------------------------------------------------------
+// Size of the G-Buffers of the renderers, at least one pixel
+VkExtent2D gltfr::Resources::getRenderSize() const
+{
+  const VkExtent2D size = m_finalImage->getSize();
+  if(m_renderScale >= 1.0F)
+    return size;
+  return {std::max(1U, static_cast<uint32_t>(std::lround(static_cast<float>(size.width) * m_renderScale))),
+          std::max(1U, static_cast<uint32_t>(std::lround(static_cast<float>(size.height) * m_renderScale)))};
+}
+
+void gltfr::Resources::setRenderScale(float scale)
+{
+  if(scale == m_renderScale)
+    return;
+  m_renderScale = scale;
+  setGBuffersChanged(true);
+}
+
+//------------------------------------------------------------------
+// Retired objects are released after framesInFlight() + 1 frames: the
+// frame recording when retire() was called, and the one being prepared
+// by the UI, which can still reference the object, are both complete.
+void gltfr::Resources::retire(std::function<void()>&& release)
+{
+  std::lock_guard<std::mutex> lock(m_retiredMutex);
+  m_retired.push_back({m_frame, std::move(release)});
+}
+
+void gltfr::Resources::retire(nvvk::Buffer& buffer)
+{
+  if(buffer.buffer == VK_NULL_HANDLE)
+    return;
+  retire([alloc = m_allocator.get(), buffer]() mutable { alloc->destroy(buffer); });
+  buffer = {};
+}
+
+void gltfr::Resources::beginFrame()
+{
+  std::deque<Retired> released;
+  {
+    std::lock_guard<std::mutex> lock(m_retiredMutex);
+    m_frame++;
+    while(!m_retired.empty() && m_frame > m_retired.front().frame + ctx.framesInFlight)
+    {
+      released.push_back(std::move(m_retired.front()));
+      m_retired.pop_front();
+    }
+  }
+  // Outside of the lock: releasing an object can retire others
+  for(Retired& retired : released)
+    retired.release();
+}
+
+void gltfr::Resources::releaseRetired()
+{
+  while(true)
+  {
+    std::deque<Retired> released;
+    {
+      std::lock_guard<std::mutex> lock(m_retiredMutex);
+      if(m_retired.empty())
+        return;
+      released.swap(m_retired);
+    }
+    for(Retired& retired : released)
+      retired.release();
+  }
+}
+
 //------------------------------------------------------------------
 // Utility function to create a temporary command buffer
 VkCommandBuffer gltfr::Resources::createTempCmdBuffer()
@@ -136,58 +306,265 @@ void gltfr::Resources::submitAndWaitTempCmdBuffer(VkCommandBuffer cmd)
 
 //------------------------------------------------------------------
 // Those are the default compiler options for the GLSL to SPIR-V
+// They are also part of the key of the SPIR-V cache, see compileGlslShaderCached
 //
+struct GlslCompilerOptions
+{
+  shaderc_spirv_version      spirvVersion = shaderc_spirv_version_1_6;
+  shaderc_env_version        envVersion   = shaderc_env_version_vulkan_1_3;
+  bool                       debugInfo    = true;
+  shaderc_optimization_level optimization = shaderc_optimization_level_zero;  // shaderc_optimization_level_performance
+};
+static const GlslCompilerOptions s_glslCompilerOptions;
+
 void setCompilerOptions(nvvkhl::GlslCompiler* glslC)
 {
+  const GlslCompilerOptions& options = s_glslCompilerOptions;
   glslC->resetOptions();
-  glslC->options()->SetTargetSpirv(shaderc_spirv_version::shaderc_spirv_version_1_6);
-  glslC->options()->SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
-  glslC->options()->SetGenerateDebugInfo();
-  //#if _DEBUG
-  glslC->options()->SetOptimizationLevel(shaderc_optimization_level_zero);
-  //#else
-  //  glslC->options()->SetOptimizationLevel(shaderc_optimization_level_performance);
-  //#endif
+  glslC->options()->SetTargetSpirv(options.spirvVersion);
+  glslC->options()->SetTargetEnvironment(shaderc_target_env_vulkan, options.envVersion);
+  if(options.debugInfo)
+    glslC->options()->SetGenerateDebugInfo();
+  glslC->options()->SetOptimizationLevel(options.optimization);
+}
+
+//------------------------------------------------------------------
+// Compiler, and the options given by setCompilerOptions
+static void hashCompilerOptions(gltfr::Hasher& hasher)
+{
+  const GlslCompilerOptions& options  = s_glslCompilerOptions;
+  unsigned int               version  = 0;
+  unsigned int               revision = 0;
+  shaderc_get_spv_version(&version, &revision);  // Of the glslang/SPIRV-Tools built in shaderc
+  hasher.add(std::string("glsl")).add(version).add(revision);
+  hasher.add(options.spirvVersion).add(options.envVersion).add(options.debugInfo).add(options.optimization);
+}
+
+
+//------------------------------------------------------------------
+// Find a file included by a shader: relative to the including file
+// first, then in the search paths, like the compilers do.
+static std::filesystem::path findShaderInclude(const std::string& name, const std::filesystem::path& parentDir)
+{
+  std::error_code ec;
+  if(std::filesystem::exists(parentDir / name, ec))
+    return parentDir / name;
+  for(const auto& path : g_applicationSearchPaths)
+  {
+    if(std::filesystem::exists(std::filesystem::path(path) / name, ec))
+      return std::filesystem::path(path) / name;
+  }
+  return {};
 }
 
+//------------------------------------------------------------------
+// Hash the shader source and, recursively, all the files it includes
+// (#include for GLSL and Slang, import for Slang). Includes which cannot
+// be found are hashed by name, the compiler will report the error.
+static void hashShaderSources(gltfr::Hasher& hasher, const std::filesystem::path& path, std::set<std::filesystem::path>& visited)
+{
+  std::error_code ec;
+  if(!visited.insert(std::filesystem::weakly_canonical(path, ec)).second)
+    return;
+
+  std::vector<char> source;
+  if(!gltfr::readCacheFile(path, source))
+  {
+    hasher.add(path.string());
+    return;
+  }
+  hasher.add(path.filename().string());
+  hasher.add(source);
+
+  std::istringstream stream(std::string(source.begin(), source.end()));
+  std::string        line;
+  while(std::getline(stream, line))
+  {
+    const size_t start = line.find_first_not_of(" \t");
+    if(start == std::string::npos)
+      continue;
+
+    std::vector<std::string> candidates;
+    if(line.compare(start, 8, "#include") == 0)
+    {
+      const size_t open  = line.find_first_of("\"<", start + 8);
+      const size_t close = open == std::string::npos ? open : line.find_first_of("\">", open + 1);
+      if(close == std::string::npos)
+        continue;
+      candidates.push_back(line.substr(open + 1, close - open - 1));
+    }
+    else if(line.compare(start, 7, "import ") == 0)
+    {
+      // Slang module: a.b_c is searched as a/b_c.slang and a/b-c.slang
+      std::string module = line.substr(start + 7, line.find(';', start) - start - 7);
+      module.erase(0, module.find_first_not_of(" \t"));
+      module.erase(module.find_last_not_of(" \t\r") + 1);
+      std::replace(module.begin(), module.end(), '.', '/');
+      candidates.push_back(module + ".slang");
+      std::replace(module.begin(), module.end(), '_', '-');
+      candidates.push_back(module + ".slang");
+    }
+
+    bool found = false;
+    for(const auto& name : candidates)
+    {
+      const std::filesystem::path include = findShaderInclude(name, path.parent_path());
+      if(!include.empty())
+      {
+        hashShaderSources(hasher, include, visited);
+        found = true;
+        break;
+      }
+    }
+    if(!found && !candidates.empty())
+      hasher.add(candidates[0]);
+  }
+}
+
+//------------------------------------------------------------------
+// Path of the compiled SPIR-V in the cache, or empty if the shader
+// file cannot be found.
+static std::filesystem::path getSpirvCachePath(gltfr::Hasher hasher, const std::string& filename)
+{
+  const std::string fullPath = nvh::findFile(filename, g_applicationSearchPaths, true);
+  if(fullPath.empty())
+    return {};
+  std::set<std::filesystem::path> visited;
+  hashShaderSources(hasher, fullPath, visited);
+  return gltfr::getCacheDirectory() / (hasher.toString() + ".spv");
+}
+
+static bool readSpirvCache(const std::filesystem::path& path, std::vector<uint32_t>& spirv)
+{
+  std::vector<char> data;
+  if(path.empty() || !gltfr::readCacheFile(path, data))
+    return false;
+  constexpr uint32_t spirvMagic = 0x07230203;
+  if(data.size() < sizeof(uint32_t) || data.size() % sizeof(uint32_t) != 0
+     || *reinterpret_cast<const uint32_t*>(data.data()) != spirvMagic)
+    return false;
+  spirv.resize(data.size() / sizeof(uint32_t));
+  std::memcpy(spirv.data(), data.data(), data.size());
+  return true;
+}
+
+static void writeSpirvCache(const std::filesystem::path& path, const std::vector<uint32_t>& spirv)
+{
+  if(!path.empty())
+    gltfr::writeCacheFile(path, spirv.data(), spirv.size() * sizeof(uint32_t));
+}
+
+//------------------------------------------------------------------
+// Compile a GLSL shader to SPIR-V with the given compiler
+// The result is taken from the cache if the shader and its includes did not change.
+static bool compileGlslShaderCached(nvvkhl::GlslCompiler&  glslC,
+                                    const std::string&     filename,
+                                    shaderc_shader_kind    shaderKind,
+                                    std::vector<uint32_t>& spirv)
+{
+  gltfr::Hasher hasher;
+  hashCompilerOptions(hasher);
+  hasher.add(shaderKind);
+  const std::filesystem::path cachePath = getSpirvCachePath(hasher, filename);
+  if(readSpirvCache(cachePath, spirv))
+    return true;
+
+  setCompilerOptions(&glslC);
+  shaderc::SpvCompilationResult compResult = glslC.compileFile(filename, shaderKind);
+  if(compResult.GetCompilationStatus() != shaderc_compilation_status_success)
+  {
+    LOGE("Error compiling shader %s\n%s\n", filename.c_str(), compResult.GetErrorMessage().c_str());
+    return false;
+  }
+  spirv.assign(compResult.begin(), compResult.end());
+  writeSpirvCache(cachePath, spirv);
+  return true;
+}
 
 //------------------------------------------------------------------
 // Compile a GLSL shader to SPIR-V
-// Return the result of the compilation as ShaderC object
-shaderc::SpvCompilationResult gltfr::Resources::compileGlslShader(const std::string& filename, shaderc_shader_kind shaderKind) const
+bool gltfr::Resources::compileGlslShader(const std::string& filename, shaderc_shader_kind shaderKind, std::vector<uint32_t>& spirv) const
 {
   // nvh::ScopedTimer st(__FUNCTION__);
   if(!m_glslC)
-    return {};
-  setCompilerOptions(m_glslC.get());
-  return m_glslC->compileFile(filename, shaderKind);
+    return false;
+  return compileGlslShaderCached(*m_glslC, filename, shaderKind, spirv);
 }
 
 //------------------------------------------------------------------
-// Create a shader module from the SPIR-V result
-//
-VkShaderModule gltfr::Resources::createShaderModule(shaderc::SpvCompilationResult& compResult) const
+// Compile multiple GLSL shaders in parallel
+// The GlslCompiler options are modified for each compilation, therefore
+// each job uses its own compiler instead of the shared one.
+bool gltfr::Resources::compileGlslShaders(const std::vector<GlslShaderFile>& files, std::vector<std::vector<uint32_t>>& spirv) const
 {
-  // nvh::ScopedTimer st(__FUNCTION__);
   if(!m_glslC)
-    return {};
-  return m_glslC->createModule(ctx.device, compResult);
+    return false;
+
+  spirv.resize(files.size());
+  std::vector<uint8_t> success(files.size(), 0);
+  const uint32_t numThreads = std::min(static_cast<uint32_t>(files.size()), std::max(1U, std::thread::hardware_concurrency()));
+  nvh::parallel_batches<1>(
+      files.size(),
+      [&](uint64_t i) {
+        nvvkhl::GlslCompiler glslC;
+        for(const auto& path : g_applicationSearchPaths)
+          glslC.addInclude(path);
+        success[i] = compileGlslShaderCached(glslC, files[i].filename, files[i].shaderKind, spirv[i]) ? 1 : 0;
+      },
+      numThreads);
+
+  return std::all_of(success.begin(), success.end(), [](uint8_t s) { return s != 0; });
 }
 
 //------------------------------------------------------------------
-// Create the structure to pass to vkCreateShaderModule if
-// the compilation was successful
-//
-bool gltfr::Resources::createShaderModuleCreateInfo(shaderc::SpvCompilationResult& compResult, VkShaderModuleCreateInfo& createInfo)
+// Compile a Slang shader to SPIR-V, using the same cache as GLSL
+bool gltfr::Resources::compileSlangShader(const std::string&    filename,
+                                          std::vector<uint32_t>& spirv,
+                                          const std::string&    entryPointName,
+                                          SlangStage            stage) const
 {
-  if(compResult.GetNumErrors() > 0)
+  if(!m_slangC)
+    return false;
+
+  Hasher hasher;
+  hasher.add(std::string("slang:spirv_1_5:scalar")).add(entryPointName).add(stage);
+  const std::filesystem::path cachePath = getSpirvCachePath(hasher, filename);
+  if(readSpirvCache(cachePath, spirv))
+    return true;
+
+  const std::string       fullPath = nvh::findFile(filename, g_applicationSearchPaths, true);
+  slang::ICompileRequest* request  = m_slangC->createCompileRequest(fullPath, entryPointName, stage);
+  if(SLANG_FAILED(request->compile()))
   {
-    LOGE("Error in compiling the shader: %s", compResult.GetErrorMessage().c_str());
+    LOGE("Error compiling shader %s, %s\n", fullPath.c_str(), request->getDiagnosticOutput());
+    request->release();
     return false;
   }
+  m_slangC->getSpirvCode(request, spirv);
+  writeSpirvCache(cachePath, spirv);
+  return true;
+}
+
+//------------------------------------------------------------------
+// Create a shader module from the SPIR-V code
+//
+VkShaderModule gltfr::Resources::createShaderModule(const std::vector<uint32_t>& spirv) const
+{
+  // nvh::ScopedTimer st(__FUNCTION__);
+  return nvvk::createShaderModule(ctx.device, spirv);
+}
+
+//------------------------------------------------------------------
+// Create the structure to pass to vkCreateShaderModule
+// The SPIR-V code must outlive the structure.
+//
+bool gltfr::Resources::createShaderModuleCreateInfo(const std::vector<uint32_t>& spirv, VkShaderModuleCreateInfo& createInfo)
+{
+  if(spirv.empty())
+    return false;
   createInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = (compResult.end() - compResult.begin()) * sizeof(uint32_t);
-  createInfo.pCode    = reinterpret_cast<const uint32_t*>(compResult.begin());
+  createInfo.codeSize = spirv.size() * sizeof(uint32_t);
+  createInfo.pCode    = spirv.data();
 
   return true;
 }
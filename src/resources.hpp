@@ -28,13 +28,24 @@ It holds the Vulkan resources, such as
 - the physical device
 - the queue
 - the queue family
-- the allocator
+- the allocator, and the scene allocator (used by the loader thread)
 - the G-Buffers (just the color final image)
 - the temporary command pool
-- and the GLSL compiler.
+- the frame graph of the passes after the renderers, with the async compute queue
+- the accounting of the GPU memory, and the planning of the scenes within the budget
+- the pipeline cache, persisted on disk
+- the GLSL and Slang compilers, with a cache of the compiled SPIR-V
+- and the queue of retired objects, destroyed once the frames in flight are
+  done with them, such that resizing or swapping renderers and scenes does not
+  need to wait for the device to be idle.
 
 */
 
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
 // nvpro-core
 #include "nvvk/resourceallocator_vk.hpp"
 #include "nvvk/context_vk.hpp"
@@ -43,6 +54,8 @@ It holds the Vulkan resources, such as
 #include "nvvkhl/glsl_compiler.hpp"
 
 // Local to application
+#include "frame_graph.hpp"
+#include "memory_budget.hpp"
 #include "slang_compiler.hpp"
 
 namespace gltfr {
@@ -52,6 +65,12 @@ struct Queue
   uint32_t familyIndex = ~0U;
 };
 
+struct GlslShaderFile
+{
+  std::string         filename;
+  shaderc_shader_kind shaderKind;
+};
+
 struct VulkanInfo
 {
   VkDevice         device{};
@@ -59,6 +78,8 @@ struct VulkanInfo
   Queue            GCT0;
   Queue            compute;
   Queue            transfer;
+  Queue            asyncCompute;  // Post-processing of the frames, see FrameGraph
+  uint32_t         framesInFlight{3};  // Frame cycle of nvvkhl::Application
 };
 
 // Resources for the renderer
@@ -66,22 +87,56 @@ class Resources
 {
 public:
   void init(VulkanInfo& _ctx);
+  void deinit();
   void resizeGbuffers(const VkExtent2D& size);
 
+  // Deferred destruction: the function is called once the frames recorded so far have executed.
+  // Can be called from any thread, the functions are called by the main thread in beginFrame().
+  void retire(std::function<void()>&& release);
+  template <typename T>
+  void retire(std::unique_ptr<T>&& object)
+  {
+    if(object)
+      retire([shared = std::shared_ptr<T>(std::move(object))]() mutable { shared.reset(); });
+  }
+  void retire(nvvk::Buffer& buffer);  // Allocated with m_allocator, the handle is reset
+  // Called at the beginning of each frame, after the fence of the frame was waited
+  void beginFrame();
+  // Call all pending functions, the device must be idle
+  void releaseRetired();
+
   // Create a temporary command buffer
   VkCommandBuffer createTempCmdBuffer();
   void            submitAndWaitTempCmdBuffer(VkCommandBuffer cmd);
 
-  // Shader compilation
-  shaderc::SpvCompilationResult compileGlslShader(const std::string& filename, shaderc_shader_kind shaderKind) const;
-  VkShaderModule                createShaderModule(shaderc::SpvCompilationResult& compResult) const;
-  static bool createShaderModuleCreateInfo(shaderc::SpvCompilationResult& compResult, VkShaderModuleCreateInfo& createInfo);
-  void resetSlangCompiler();
+  // Shader compilation, the SPIR-V is cached on disk using the source and its includes as key
+  bool compileGlslShader(const std::string& filename, shaderc_shader_kind shaderKind, std::vector<uint32_t>& spirv) const;
+  // Compile all files in parallel, the SPIR-V is returned in the same order
+  bool compileGlslShaders(const std::vector<GlslShaderFile>& files, std::vector<std::vector<uint32_t>>& spirv) const;
+  bool compileSlangShader(const std::string&    filename,
+                          std::vector<uint32_t>& spirv,
+                          const std::string&    entryPointName = "main",
+                          SlangStage            stage          = SLANG_STAGE_COMPUTE) const;
+  VkShaderModule createShaderModule(const std::vector<uint32_t>& spirv) const;
+  static bool    createShaderModuleCreateInfo(const std::vector<uint32_t>& spirv, VkShaderModuleCreateInfo& createInfo);
+  void           resetSlangCompiler();
+
+  // Write the pipeline cache to disk
+  void savePipelineCache() const;
+
+  // Frames in flight of nvvkhl::Application, the UploadRing has a segment per frame
+  uint32_t framesInFlight() const { return ctx.framesInFlight; }
 
   // Did the resolution changed?
   bool hasGBuffersChanged() const { return m_hasGBufferChanged; }
   void setGBuffersChanged(bool changed) { m_hasGBufferChanged = changed; }
 
+  // Internal resolution of the renderers, a fraction of the final image (dynamic resolution).
+  // A new scale re-creates the G-Buffers, the renderers upscale into the final image.
+  VkExtent2D getRenderSize() const;
+  float      getRenderScale() const { return m_renderScale; }
+  void       setRenderScale(float scale);
+
   bool hasGlslCompiler() const { return m_glslC != nullptr; }
   bool hasSlangCompiler() const { return m_slangC != nullptr; }
 
@@ -89,13 +144,29 @@ public:
   VulkanInfo ctx{};
 
   std::unique_ptr<nvvk::ResourceAllocatorDma> m_allocator{};
+  std::unique_ptr<nvvk::ResourceAllocatorDma> m_sceneAllocator{};  // Scene buffers, textures and AS (loader thread)
   std::unique_ptr<nvvkhl::GBuffer>            m_finalImage{};  // G-Buffers: color
   std::unique_ptr<nvvk::CommandPool>          m_tempCommandPool{};
+  FrameGraph                                  m_frameGraph;
+  MemoryBudget                                m_memory;
   std::unique_ptr<nvvkhl::GlslCompiler>       m_glslC{};
   std::unique_ptr<SlangCompiler>              m_slangC{};
+  VkPipelineCache                             m_pipelineCache{VK_NULL_HANDLE};  // Used for all pipelines
 
 private:
-  bool m_hasGBufferChanged{false};
+  void createPipelineCache();
+
+  struct Retired
+  {
+    uint64_t              frame{0};  // Frame in which the object was last used
+    std::function<void()> release;
+  };
+
+  bool                m_hasGBufferChanged{false};
+  float               m_renderScale{1.0F};
+  std::mutex          m_retiredMutex;
+  std::deque<Retired> m_retired;
+  uint64_t            m_frame{0};
 };
 
 }  // namespace gltfr
\ No newline at end of file
@@ -17,9 +17,16 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <glm/gtc/constants.hpp>
+
 #include "scene.hpp"
 
 #include "fileformats/tiny_converter.hpp"
+#include "fileformats/tinygltf_utils.hpp"
 #include "nvh/cameramanipulator.hpp"
 #include "nvh/timesampler.hpp"
 #include "nvvkhl/element_camera.hpp"
@@ -28,12 +35,110 @@
 #include "shaders/dh_bindings.h"
 #include "tiny_obj_loader.h"
 #include "create_tangent.hpp"
+#include "obj_parallel.hpp"
 #include "nvvkhl/shaders/dh_tonemap.h"
+#include "nvvkhl/shaders/dh_scn_desc.h"
 #include "collapsing_header_manager.h"
+#include "mapped_file.hpp"
+#include "cache_utils.hpp"
+#include "geometry_dedup.hpp"
+#include "telemetry.hpp"
 
 extern std::shared_ptr<nvvkhl::ElementCamera> g_elemCamera;  // Is accessed elsewhere in the App
+namespace gltfr {
+extern bool g_useBlasCache;
+extern bool g_parallelObj;
+extern int  g_textureBudgetMB;
+extern bool g_compressTextures;
+extern bool g_gpuAnimation;
+extern bool g_meshlets;
+extern bool g_compactVertices;
+extern bool g_dedupGeometry;
+extern bool g_specializeShaders;
+extern bool g_opacityMicromaps;
+}
 namespace PE = ImGuiH::PropertyEditor;
 
+namespace {
+constexpr VkDeviceSize kUploadRingFrameSize    = 2 << 20;  // Per frame, larger updates use the scene allocator
+constexpr uint32_t     kNumSceneDescriptorSets = 4;        // The current scene descriptor set, and the retired ones
+
+// Memory used by the scene allocator, the categories of the scene are measured from its changes
+VkDeviceSize sceneMemoryUsed(gltfr::Resources& res)
+{
+  VkDeviceSize allocated = 0, used = 0;
+  res.m_sceneAllocator->getDMA()->getUtilization(allocated, used);
+  return used;
+}
+
+// Render primitives whose vertices are deformed by the animation: morph targets, or used by a skinned node
+std::vector<uint32_t> collectDeformedPrimitives(const nvh::gltf::Scene& scene)
+{
+  const tinygltf::Model&                           model      = scene.getModel();
+  const std::vector<nvh::gltf::RenderPrimitive>&   primitives = scene.getRenderPrimitives();
+  std::vector<bool>                                deformed(primitives.size(), false);
+  for(size_t i = 0; i < primitives.size(); i++)
+    deformed[i] = !primitives[i].pPrimitive->targets.empty();
+  for(const nvh::gltf::RenderNode& renderNode : scene.getRenderNodes())
+  {
+    if(renderNode.refNodeID >= 0 && model.nodes[renderNode.refNodeID].skin >= 0)
+      deformed[renderNode.renderPrimID] = true;
+  }
+
+  std::vector<uint32_t> result;
+  for(size_t i = 0; i < deformed.size(); i++)
+  {
+    if(deformed[i])
+      result.push_back(static_cast<uint32_t>(i));
+  }
+  return result;
+}
+
+// Hash of what deforms each render primitive: the transforms of the joints, their parents, and the
+// morph weights. Zero for the primitives which are not deformed.
+std::vector<uint64_t> hashDeformations(const nvh::gltf::Scene& scene, const std::vector<uint32_t>& deformedPrimitives)
+{
+  std::vector<uint64_t> hashes(scene.getRenderPrimitives().size(), 0);
+  if(deformedPrimitives.empty())
+    return hashes;
+
+  const tinygltf::Model& model = scene.getModel();
+  std::vector<int>       parents(model.nodes.size(), -1);
+  for(size_t i = 0; i < model.nodes.size(); i++)
+  {
+    for(int child : model.nodes[i].children)
+      parents[child] = static_cast<int>(i);
+  }
+  auto hashNode = [&](gltfr::Hasher& hasher, const tinygltf::Node& node) {
+    hasher.add(node.translation).add(node.rotation).add(node.scale).add(node.matrix).add(node.weights);
+  };
+
+  std::vector<gltfr::Hasher> hashers(hashes.size());
+  for(const nvh::gltf::RenderNode& renderNode : scene.getRenderNodes())
+  {
+    if(renderNode.refNodeID < 0 || !std::binary_search(deformedPrimitives.begin(), deformedPrimitives.end(),
+                                                        static_cast<uint32_t>(renderNode.renderPrimID)))
+      continue;
+    gltfr::Hasher&        hasher = hashers[renderNode.renderPrimID];
+    const tinygltf::Node& node   = model.nodes[renderNode.refNodeID];
+    hasher.add(node.weights);
+    if(node.mesh >= 0)
+      hasher.add(model.meshes[node.mesh].weights);
+    if(node.skin >= 0)
+    {
+      for(int joint : model.skins[node.skin].joints)
+      {
+        for(int n = joint; n >= 0; n = parents[n])
+          hashNode(hasher, model.nodes[n]);
+      }
+    }
+  }
+  for(uint32_t primID : deformedPrimitives)
+    hashes[primID] = hashers[primID].value;
+  return hashes;
+}
+}  // namespace
+
 constexpr uint32_t MAXTEXTURES = 1000;  // Maximum textures allowed in the application
 
 
@@ -46,23 +151,64 @@ void gltfr::Scene::init(Resources& res)
 {
   nvvk::ResourceAllocator* alloc = res.m_allocator.get();
 
-  createHdr(res, "");  // Initialize the environment with nothing (constant white: for now)
+  // Initialize the environment with nothing (constant white: for now)
+  createHdr(res, "");
+  commitPendingHdr(res);
   m_sky = std::make_unique<nvvkhl::PhysicalSkyDome>();  // Sun&Sky
   m_sky->setup(res.ctx.device, alloc);
 
   // Create the buffer of the current frame, changing at each frame
   {
     m_sceneFrameInfoBuffer =
-        res.m_allocator->createBuffer(sizeof(DH::SceneFrameInfo), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        res.m_allocator->createBuffer(sizeof(DH::SceneFrameInfo), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     nvvk::DebugUtil(res.ctx.device).DBG_NAME(m_sceneFrameInfoBuffer.buffer);
   }
 
+  // Staging of the per-frame updates: frame info and changed render nodes
+  m_uploadRing.init(res.m_allocator.get(), kUploadRingFrameSize, res.framesInFlight());
+
+  createPlaceholderTextures(res);
+
+  // Feedback of the shaders for the texture streaming, read by the host each frame
+  {
+    m_textureFeedbackBuffer =
+        res.m_allocator->createBuffer(MAX_FEEDBACK_MATERIALS * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    nvvk::DebugUtil(res.ctx.device).DBG_NAME(m_textureFeedbackBuffer.buffer);
+    m_textureFeedback = static_cast<uint32_t*>(res.m_allocator->map(m_textureFeedbackBuffer));
+    std::memset(m_textureFeedback, 0, MAX_FEEDBACK_MATERIALS * sizeof(uint32_t));
+  }
+
   VkDevice device = res.ctx.device;
   createDescriptorPool(device);
   createDescriptorSet(device);
 }
 
+//--------------------------------------------------------------------------------------------------
+// Create the 1x1 textures bound in place of the scene textures while they are streamed
+//
+void gltfr::Scene::createPlaceholderTextures(Resources& res)
+{
+  const std::array<std::array<uint8_t, 4>, eNumPlaceholders> colors = {{
+      {255, 255, 255, 255},  // ePlaceholderWhite
+      {0, 0, 0, 255},        // ePlaceholderBlack
+      {128, 128, 255, 255},  // ePlaceholderFlatNormal
+  }};
+
+  const VkImageCreateInfo   imageInfo   = nvvk::makeImage2DCreateInfo({1, 1}, VK_FORMAT_R8G8B8A8_UNORM);
+  const VkSamplerCreateInfo samplerInfo = nvvk::makeSamplerCreateInfo();
+
+  VkCommandBuffer cmd = res.createTempCmdBuffer();
+  for(size_t i = 0; i < colors.size(); i++)
+  {
+    m_placeholderTextures[i] = res.m_allocator->createTexture(cmd, colors[i].size(), colors[i].data(), imageInfo, samplerInfo);
+    nvvk::DebugUtil(res.ctx.device).DBG_NAME(m_placeholderTextures[i].image);
+  }
+  res.submitAndWaitTempCmdBuffer(cmd);
+  res.m_allocator->finalizeAndReleaseStaging();
+}
+
 //--------------------------------------------------------------------------------------------------
 // De-initialization of the scene object
 // - Destroy the buffers
@@ -72,14 +218,31 @@ void gltfr::Scene::init(Resources& res)
 void gltfr::Scene::deinit(Resources& res)
 {
   res.m_allocator->destroy(m_sceneFrameInfoBuffer);
+  m_uploadRing.deinit();
+  m_gpuAnimation.destroy();
+  m_compactVertices.destroy();
+  m_meshletScene.deinit();
+  m_lightSampler.deinit();
+  m_textureStreamer.reset();
+  m_pendingTextureStreamer.reset();
+  res.m_allocator->unmap(m_textureFeedbackBuffer);
+  res.m_allocator->destroy(m_textureFeedbackBuffer);
+  m_textureFeedback = nullptr;
+  for(nvvk::Texture& texture : m_placeholderTextures)
+  {
+    res.m_allocator->destroy(texture);
+  }
 
   destroyDescriptorSet(res.ctx.device);
 
   m_gltfSceneVk.reset();
   m_gltfSceneRtx.reset();
   m_gltfScene.reset();
+  m_pendingSceneVk.reset();
+  m_pendingSceneRtx.reset();
+  m_pendingScene.reset();
   m_hdrEnv.reset();
-  m_hdrDome.reset();
+  m_pendingHdrEnv.reset();
   m_sky.reset();
 }
 
@@ -107,6 +270,19 @@ void gltfr::Scene::fitObjectToView() const
   }
 }
 
+//--------------------------------------------------------------------------------------------------
+// Select a material variant, the materials of all render nodes may change
+//
+void gltfr::Scene::selectVariant(int variant)
+{
+  if(!m_gltfScene || variant < 0 || variant >= int(m_gltfScene->getVariants().size()) || variant == m_gltfScene->getCurrentVariant())
+    return;
+  m_gltfScene->setCurrentVariant(variant);
+  for(uint32_t id = 0; id < m_uploadedRenderNodes.size(); id++)
+    m_dirtyRenderNodes.push_back(id);
+  m_dirtyFlags.set(eVulkanScene);
+}
+
 //--------------------------------------------------------------------------------------------------
 // Select a render node
 // - tells the scene graph to select the node
@@ -130,7 +306,7 @@ void gltfr::Scene::selectRenderNode(int renderNodeIndex)
 std::string gltfr::Scene::getFilename() const
 {
   if(m_gltfScene != nullptr)
-    return m_gltfScene->getFilename();
+    return m_filename;
   return "empty";
 }
 
@@ -151,31 +327,322 @@ void gltfr::Scene::recreateTangents(bool mikktspace)
 
 //--------------------------------------------------------------------------------------------------
 // Load a scene or HDR environment
+// Everything, including the textures, is created before returning.
 //
 bool gltfr::Scene::load(Resources& resources, const std::string& filename)
 {
-  const std::string extension   = std::filesystem::path(filename).extension().string();
-  bool              sceneloaded = false;
+  const std::string extension = std::filesystem::path(filename).extension().string();
+
+  if(extension == ".hdr")
+  {
+    if(!createHdr(resources, filename))
+      return false;
+    commitPendingHdr(resources);
+  }
+  else
+  {
+    if(!parseScene(filename))
+      return false;
+    // Compressed textures are created by the TextureStreamer, without a budget, once the scene is committed
+    const bool compress = g_compressTextures;
+    if(!createVulkanScene(resources, compress))
+    {
+      m_pendingScene.reset();
+      return false;
+    }
+    commitPendingScene(resources);
+    if(compress && m_gltfSceneVk && m_gltfSceneVk->hasDeferredTextures())
+    {
+      // Complete on return, like the other textures of load(): compressed at full resolution, not streamed
+      m_textureBudget = 0;
+      nvh::Stopwatch texturesTime;
+      createSceneTextures(resources);
+      m_loadTimings.textures = texturesTime.elapsed();
+      commitSceneTextures(resources);
+    }
+  }
+
+  resetFrameCount();
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Staged loading of a glTF or OBJ scene, called from the loader thread
+// - Parse, upload the geometry and build the acceleration structures in the pending scene
+// - Wait for the main thread to swap the pending scene with the current one (updateStagedLoad)
+// - Stream the textures, which are bound by the main thread once ready
+// The current scene continues to render until the swap.
+//
+bool gltfr::Scene::loadStaged(Resources& resources, const std::string& filename)
+{
+  m_loadStage = eLoadParse;
+  if(m_textureStreamer)
+    m_textureStreamer->suspend();  // The compute queue is needed by the loader
+  if(!parseScene(filename))
+  {
+    if(m_textureStreamer)
+      m_textureStreamer->resume();
+    m_loadStage = eLoadIdle;
+    return false;
+  }
+
+  if(!createVulkanScene(resources, true))
+  {
+    m_pendingScene.reset();
+    if(m_textureStreamer)
+      m_textureStreamer->resume();
+    m_loadStage = eLoadIdle;
+    return false;
+  }
+
+  // Hand over to the main thread, and wait for it to take the scene and release the previous one
+  m_loadStage = eLoadReady;
+  for(int stage = m_loadStage; stage != eLoadTextures && !m_cancelLoad; stage = m_loadStage)
+    m_loadStage.wait(stage);
+  if(m_cancelLoad)
+  {
+    m_loadStage = eLoadIdle;  // The pending scene is destroyed with the Scene
+    return false;
+  }
+
+  // The scene is now displayed with placeholder textures
+  if(m_gltfSceneVk && m_gltfSceneVk->hasDeferredTextures())
+  {
+    nvh::ScopedTimer st("Stream textures");
+    nvh::Stopwatch   texturesTime;
+    createSceneTextures(resources);
+    m_loadTimings.textures = texturesTime.elapsed();
+  }
+
+  m_loadProgress = 1.0F;
+  m_loadStage    = eLoadTexturesReady;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Called by the main thread before joining the loader thread (shutdown)
+// The loader finishes its current stage, and no longer waits for the main thread to swap the scene.
+//
+void gltfr::Scene::cancelStagedLoad()
+{
+  m_cancelLoad = true;
+  for(int waiting : {eLoadReady, eLoadRetiring})
+    m_loadStage.compare_exchange_strong(waiting, eLoadIdle);
+  m_loadStage.notify_all();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Create the deferred textures of the current scene, on the loader thread
+// With a budget or compression, the TextureStreamer creates them, otherwise SceneVk does.
+// The streamer is pending until the main thread takes it, see commitSceneTextures.
+//
+void gltfr::Scene::createSceneTextures(Resources& resources)
+{
+  if(m_textureBudget > 0 || g_compressTextures)
+  {
+    // With a budget, only the low resolution mips are created, the rest is streamed on demand
+    auto streamer = std::make_unique<TextureStreamer>(resources, m_textureBudget, g_compressTextures);
+    if(streamer->create(m_gltfScene->getModel(), m_gltfSceneVk->baseDir()))
+      m_pendingTextureStreamer = std::move(streamer);
+    else
+      LOGI("Textures cannot be streamed or compressed, creating them at full resolution\n");
+  }
+
+  if(!m_pendingTextureStreamer)
+  {
+    const VkDeviceSize used = sceneMemoryUsed(resources);
+    // Note: the texture creation transitions the images to shader-read layout, which can't be
+    //       recorded on a transfer-only queue. Using the compute queue, running beside GCT0.
+    nvvk::CommandPool cmdPool(resources.ctx.device, resources.ctx.compute.familyIndex,
+                              VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, resources.ctx.compute.queue);
+    VkCommandBuffer   cmd = cmdPool.createCommandBuffer();
+    m_gltfSceneVk->createDeferredTextures(cmd, m_gltfScene->getModel());
+    cmdPool.submitAndWait(cmd);
+    resources.m_sceneAllocator->finalizeAndReleaseStaging();
+    resources.m_memory.set(MemoryBudget::eTextures, sceneMemoryUsed(resources) - used);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Main thread: the textures created by createSceneTextures are bound
+//
+void gltfr::Scene::commitSceneTextures(Resources& resources)
+{
+  if(m_pendingTextureStreamer)
+  {
+    m_textureStreamer = std::move(m_pendingTextureStreamer);
+    resources.m_memory.set(MemoryBudget::eTextures, m_textureStreamer->residentBytes());
+  }
+  writeDescriptorSet(resources);  // In a new descriptor set, the current one can still be in use
+}
+
+//--------------------------------------------------------------------------------------------------
+// Called by the main thread at each frame, advancing the staged loading
+//
+void gltfr::Scene::updateStagedLoad(Resources& resources)
+{
+  commitPendingHdr(resources);
 
-  if(extension == ".gltf" || extension == ".glb")
+  switch(m_loadStage)
   {
-    m_gltfScene = std::make_unique<nvh::gltf::Scene>();
-    m_sceneGraph.reset();
-    m_selectedRenderNode = -1;
+    case eLoadReady:
+      // The previous scene is retired, the loader continues with the textures once it is destroyed,
+      // such that the scene allocator is not used by both threads
+      commitPendingScene(resources);
+      resetFrameCount();
+      m_loadStage = eLoadRetiring;
+      resources.retire([this]() {
+        m_loadStage = eLoadTextures;
+        m_loadStage.notify_one();
+      });
+      break;
+    case eLoadTexturesReady:
+      commitSceneTextures(resources);
+      resetFrameCount();
+      m_loadStage = eLoadIdle;
+      break;
+    default:
+      break;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Called by the main thread at each frame, once the scene is loaded
+// The images which finished streaming are swapped. The frames in flight still sample the current
+// descriptors, the textures are written in a new descriptor set and the current one is retired.
+//
+void gltfr::Scene::updateTextureStreaming(Resources& resources)
+{
+  if(!m_textureStreamer || m_loadStage != eLoadIdle)
+    return;
+
+  std::vector<uint32_t> changedTextures;
+  if(m_textureStreamer->update(m_textureFeedback, MAX_FEEDBACK_MATERIALS, changedTextures))
+  {
+    writeDescriptorSet(resources);
+    resetFrameCount();
+    resources.m_memory.set(MemoryBudget::eTextures, m_textureStreamer->residentBytes());
+  }
+}
+
+const char* gltfr::Scene::loadStageName() const
+{
+  if(m_hdrLoading)
+    return "Preparing environment";
+  switch(m_loadStage)
+  {
+    case eLoadParse:
+      return "Parsing";
+    case eLoadGeometry:
+      return "Uploading geometry";
+    case eLoadAccel:
+      return "Building acceleration structures";
+    case eLoadReady:
+    case eLoadRetiring:
+      return "Preparing scene";
+    case eLoadTextures:
+    case eLoadTexturesReady:
+      return "Streaming textures";
+    default:
+      return "";
+  }
+}
 
-    // Loading the scene
-    if(m_gltfScene->load(filename))
+//--------------------------------------------------------------------------------------------------
+// Load a .glb directly from the memory mapped file
+// Reading the file in memory first would hold the file twice: the file content and the copy of
+// its binary chunk in the model buffers. Images are not decoded, this is done by SceneVk.
+//
+static bool loadGlbMapped(const std::string& filename, tinygltf::Model& model)
+{
+  nvh::ScopedTimer st(__FUNCTION__);
+
+  gltfr::MappedFile file;
+  if(!file.open(filename) || file.size() > std::numeric_limits<unsigned int>::max())
+    return false;
+
+  tinygltf::TinyGLTF tcontext;
+  tcontext.SetImageLoader([](tinygltf::Image*, const int, std::string*, std::string*, int, int, const unsigned char*,
+                             int, void*) { return true; },
+                          nullptr);
+
+  std::string warn, error;
+  const std::string baseDir = std::filesystem::path(filename).parent_path().string();
+  const bool result = tcontext.LoadBinaryFromMemory(&model, &error, &warn, file.data(),
+                                                    static_cast<unsigned int>(file.size()), baseDir);
+  if(!warn.empty())
+    LOGW("%s\n", warn.c_str());
+  if(!result)
+    LOGE("Error loading %s: %s\n", filename.c_str(), error.c_str());
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Parse a glTF or OBJ file into the pending scene
+//
+bool gltfr::Scene::parseScene(const std::string& filename)
+{
+  const std::string extension = std::filesystem::path(filename).extension().string();
+
+  nvh::Stopwatch parseTime;
+  m_loadTimings     = {};
+  m_loadProgress    = 0.0F;
+  m_pendingFilename = filename;
+  m_pendingScene    = std::make_unique<nvh::gltf::Scene>();
+  tinygltf::Model objModel;
+
+  // The identical geometry is merged, and the shared deformed geometry split per node, before the scene
+  // creates its render primitives
+  auto takeModel = [&](tinygltf::Model&& model) {
+    if(g_dedupGeometry)
+      dedupGeometry(model);
+    splitDeformedInstances(model);
+    m_pendingScene->takeModel(std::move(model));
+  };
+  // Scenes loaded by nvh::gltf::Scene are parsed again when they have duplicates or shared deformed meshes
+  auto dedupLoaded = [&]() {
+    tinygltf::Model& loaded = m_pendingScene->getModel();
+    const bool       merged = g_dedupGeometry && dedupGeometry(loaded).merged > 0;
+    const bool       split  = splitDeformedInstances(loaded) > 0;
+    if(merged || split)
     {
-      sceneloaded  = true;
-      m_sceneGraph = std::make_unique<GltfModelUI>(m_gltfScene->getModel(), m_gltfScene->getSceneBounds());
-      createVulkanScene(resources);
+      tinygltf::Model model = std::move(m_pendingScene->getModel());
+      m_pendingScene        = std::make_unique<nvh::gltf::Scene>();
+      m_pendingScene->takeModel(std::move(model));
+    }
+  };
+
+  if(extension == ".glb")
+  {
+    // Parsing from the mapped file, and falling back to the regular loader when it fails
+    tinygltf::Model model;
+    if(loadGlbMapped(filename, model))
+    {
+      takeModel(std::move(model));
+    }
+    else if(m_pendingScene->load(filename))
+    {
+      dedupLoaded();
     }
     else
     {
-      m_gltfScene.reset();
+      m_pendingScene.reset();
       return false;
     }
   }
+  else if(extension == ".gltf")
+  {
+    if(!m_pendingScene->load(filename))
+    {
+      m_pendingScene.reset();
+      return false;
+    }
+    dedupLoaded();
+  }
+  else if(extension == ".obj" && g_parallelObj && loadObjParallel(filename, objModel))
+  {
+    takeModel(std::move(objModel));
+  }
   else if(extension == ".obj")
   {
     tinyobj::ObjReaderConfig reader_config;
@@ -186,38 +653,53 @@ bool gltfr::Scene::load(Resources& resources, const std::string& filename)
     std::string warn   = reader.Warning();
     std::string error  = reader.Error();
 
-    if(result)
-    {
-      sceneloaded = true;
-      TinyConverter   converter;
-      tinygltf::Model model;
-      converter.convert(model, reader);
-      m_gltfScene = std::make_unique<nvh::gltf::Scene>();
-      m_gltfScene->takeModel(std::move(model));
-      m_sceneGraph = std::make_unique<GltfModelUI>(m_gltfScene->getModel(), m_gltfScene->getSceneBounds());
-      createVulkanScene(resources);
-    }
-    else
+    if(!result)
     {
-      m_gltfScene.reset();
+      m_pendingScene.reset();
       LOGE("Error loading OBJ: %s\n", error.c_str());
       LOGW("Warning: %s\n", warn.c_str());
       return false;
     }
+    TinyConverter   converter;
+    tinygltf::Model model;
+    converter.convert(model, reader);
+    takeModel(std::move(model));
   }
-  else if(extension == ".hdr")
+  else
   {
-    createHdr(resources, filename);
-    sceneloaded = false;
+    m_pendingScene.reset();
+    LOGE("Unknown file type: %s\n", filename.c_str());
+    return false;
   }
 
-  if(sceneloaded)
+  m_loadTimings.parse = parseTime.elapsed();
+  m_loadProgress      = 0.25F;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Make the pending scene the current one, the previous scene is retired
+// - It is destroyed once the frames in flight are done with it
+//
+void gltfr::Scene::commitPendingScene(Resources& resources)
+{
+  resources.retire(std::move(m_textureStreamer));  // Textures of the previous scene
+  resources.retire(std::move(m_gltfSceneRtx));
+  resources.retire(std::move(m_gltfSceneVk));
+  m_gltfSceneRtx = std::move(m_pendingSceneRtx);
+  m_gltfSceneVk  = std::move(m_pendingSceneVk);
+  m_gltfScene    = std::move(m_pendingScene);
+  m_filename     = m_pendingFilename;
+  for(int i = 0; i < MemoryBudget::eNumCategories; i++)
+    resources.m_memory.set(MemoryBudget::Category(i), m_pendingMemory[i]);
+
+  m_selectedRenderNode = -1;
+  m_sceneGraph.reset();
+  if(m_gltfScene->valid())
   {
-    postSceneCreateProcess(resources, filename);
+    m_sceneGraph = std::make_unique<GltfModelUI>(m_gltfScene->getModel(), m_gltfScene->getSceneBounds());
+    postSceneCreateProcess(resources, m_pendingFilename);
   }
-
-  resetFrameCount();
-  return true;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -231,7 +713,34 @@ void gltfr::Scene::postSceneCreateProcess(Resources& resources, const std::strin
 
   setDirtyFlag(Scene::eNewScene, true);
 
+  m_lightSampler.build(resources, *m_gltfScene);
   writeDescriptorSet(resources);
+  buildNodeRenderNodes();
+  updateShaderFeatures();
+
+  // The counts do not change with the scene, they are not computed each frame
+  const tinygltf::Model& tiny = m_gltfScene->getModel();
+  m_statistics              = {
+      {"Nodes", std::to_string(tiny.nodes.size())},
+      {"Render Nodes", std::to_string(m_gltfScene->getRenderNodes().size())},
+      {"Render Primitives", std::to_string(m_gltfScene->getNumRenderPrimitives())},
+      {"Materials", std::to_string(tiny.materials.size())},
+      {"Triangles", std::to_string(m_gltfScene->getNumTriangles())},
+      {"Lights", std::to_string(tiny.lights.size())},
+      {"Textures", std::to_string(tiny.textures.size())},
+      {"Images", std::to_string(tiny.images.size())},
+  };
+
+  m_gpuAnimation.retire(resources);
+  if(g_gpuAnimation && m_gltfScene->hasAnimation())
+    m_gpuAnimation.init(resources, *m_gltfScene, *m_gltfSceneVk);
+  m_animationEvaluator.clear();
+  if(m_gltfScene->hasAnimation())
+    m_animationEvaluator.init(*m_gltfScene, !m_gpuAnimation.isActive());
+
+  m_meshletScene.retire(resources);
+  if(g_meshlets && MeshletScene::isSupported(resources.ctx.physicalDevice))
+    m_meshletScene.init(resources, *m_gltfScene, m_deformedPrimitives);
 
   // Scene camera fitting
   nvh::Bbox                                   bbox    = m_gltfScene->getSceneBounds();
@@ -240,6 +749,56 @@ void gltfr::Scene::postSceneCreateProcess(Resources& resources, const std::strin
   g_elemCamera->setSceneRadius(bbox.radius());  // Navigation help
 }
 
+//--------------------------------------------------------------------------------------------------
+// Features of the materials and of the lights, for the specialization of the path tracer.
+// A material extension counts once present, even with a factor which disables it: the
+// editor can change the factors without a new pipeline.
+//
+void gltfr::Scene::updateShaderFeatures()
+{
+  if(!g_specializeShaders)
+  {
+    m_shaderFeatures = SCENE_FEATURE_ALL;
+    return;
+  }
+
+  static const std::pair<const char*, uint32_t> kMaterialExtensions[] = {
+      {KHR_MATERIALS_CLEARCOAT_EXTENSION_NAME, SCENE_FEATURE_CLEARCOAT},
+      {KHR_MATERIALS_SHEEN_EXTENSION_NAME, SCENE_FEATURE_SHEEN},
+      {KHR_MATERIALS_TRANSMISSION_EXTENSION_NAME, SCENE_FEATURE_TRANSMISSION},
+      {KHR_MATERIALS_VOLUME_EXTENSION_NAME, SCENE_FEATURE_VOLUME},
+      {KHR_MATERIALS_IRIDESCENCE_EXTENSION_NAME, SCENE_FEATURE_IRIDESCENCE},
+      {KHR_MATERIALS_ANISOTROPY_EXTENSION_NAME, SCENE_FEATURE_ANISOTROPY},
+      {KHR_MATERIALS_DISPERSION_EXTENSION_NAME, SCENE_FEATURE_DISPERSION},
+      {KHR_MATERIALS_DIFFUSE_TRANSMISSION_EXTENSION_NAME, SCENE_FEATURE_DIFFUSE_TRANSMISSION},
+      {KHR_MATERIALS_SPECULAR_EXTENSION_NAME, SCENE_FEATURE_SPECULAR},
+      {"KHR_materials_pbrSpecularGlossiness", SCENE_FEATURE_SPECULAR_GLOSSINESS},
+      {"KHR_materials_unlit", SCENE_FEATURE_UNLIT},
+  };
+
+  const tinygltf::Model& model    = m_gltfScene->getModel();
+  uint32_t               features = 0;
+  for(const tinygltf::Material& material : model.materials)
+  {
+    for(const auto& [name, feature] : kMaterialExtensions)
+    {
+      if(tinygltf::utils::hasElementName(material.extensions, name))
+        features |= feature;
+    }
+    // Same test as the light table
+    const bool emissive = std::any_of(material.emissiveFactor.begin(), material.emissiveFactor.end(),
+                                      [](double c) { return c > 0.0; });
+    if(emissive && tinygltf::utils::getEmissiveStrength(material).emissiveStrength > 0.0F)
+      features |= SCENE_FEATURE_EMISSIVE_TRIANGLES;
+  }
+  if(!m_gltfScene->getRenderLights().empty())
+    features |= SCENE_FEATURE_PUNCTUAL_LIGHTS;
+
+  if(features != m_shaderFeatures)
+    LOGI("Shader features: 0x%x\n", features);
+  m_shaderFeatures = features;
+}
+
 //--------------------------------------------------------------------------------------------------
 // Save the scene
 //
@@ -263,9 +822,9 @@ bool gltfr::Scene::save(const std::string& filename) const
 void gltfr::Scene::createDescriptorPool(VkDevice device)
 {
   const std::vector<VkDescriptorPoolSize> poolSizes{
-      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAXTEXTURES},
-      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1},
-      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1},
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAXTEXTURES * kNumSceneDescriptorSets},
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kNumSceneDescriptorSets},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * kNumSceneDescriptorSets},
   };
 
   const VkDescriptorPoolCreateInfo poolInfo = {
@@ -298,6 +857,18 @@ void gltfr::Scene::createDescriptorSet(VkDevice device)
                             .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                             .descriptorCount = MAXTEXTURES,  // Not all will be filled - but pipeline will be cached
                             .stageFlags      = VK_SHADER_STAGE_ALL});
+  layoutBindings.push_back({.binding         = SceneBindings::eTextureFeedback,
+                            .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                            .descriptorCount = 1,
+                            .stageFlags      = VK_SHADER_STAGE_ALL});
+  layoutBindings.push_back({.binding         = SceneBindings::eLightSampling,
+                            .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                            .descriptorCount = 1,
+                            .stageFlags      = VK_SHADER_STAGE_ALL});
+  layoutBindings.push_back({.binding         = SceneBindings::eEmissiveNodes,
+                            .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                            .descriptorCount = 1,
+                            .stageFlags      = VK_SHADER_STAGE_ALL});
 
   const VkDescriptorBindingFlags flags[] = {
       VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,  // Flags for binding 0 (uniform buffer)
@@ -306,6 +877,9 @@ void gltfr::Scene::createDescriptorSet(VkDevice device)
       VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |                // Can update while in use
           VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |  // Can update unused entries
           VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,  // Not all array elements need to be valid (0,2,3 vs 0,1,2,3)
+      VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,    // Flags for binding 3 (texture feedback)
+      VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,    // Flags for binding 4 (light sampling)
+      VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,    // Flags for binding 5 (emissive render nodes)
   };
   const VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlags{
       .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
@@ -323,30 +897,61 @@ void gltfr::Scene::createDescriptorSet(VkDevice device)
   NVVK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &m_sceneDescriptorSetLayout));
   nvvk::DebugUtil(device).DBG_NAME(m_sceneDescriptorSetLayout);
 
-  // Allocate the descriptor set, needed only for larger descriptor sets
+  allocateDescriptorSet(device);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Allocate the descriptor set, needed only for larger descriptor sets
+//
+bool gltfr::Scene::allocateDescriptorSet(VkDevice device)
+{
   const VkDescriptorSetAllocateInfo allocInfo = {
       .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
       .descriptorPool     = m_descriptorPool,
       .descriptorSetCount = 1,
       .pSetLayouts        = &m_sceneDescriptorSetLayout,
   };
-  NVVK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &m_sceneDescriptorSet));
+  if(vkAllocateDescriptorSets(device, &allocInfo, &m_sceneDescriptorSet) != VK_SUCCESS)
+  {
+    m_sceneDescriptorSet = VK_NULL_HANDLE;
+    return false;
+  }
   nvvk::DebugUtil(device).DBG_NAME(m_sceneDescriptorSet);
+  return true;
 }
 
 //--------------------------------------------------------------------------------------------------
 // Write the descriptor set for the scene
+// The current set can still be used by the frames in flight, the descriptors are written in a new
+// one and the current set is retired.
 //
-void gltfr::Scene::writeDescriptorSet(Resources& resources) const
+void gltfr::Scene::writeDescriptorSet(Resources& resources)
 {
   if(!m_gltfScene->valid())
   {
     return;
   }
 
+  const VkDevice device = resources.ctx.device;
+  resources.retire([device, pool = m_descriptorPool, set = m_sceneDescriptorSet]() {
+    vkFreeDescriptorSets(device, pool, 1, &set);
+  });
+  if(!allocateDescriptorSet(device))
+  {
+    // All sets of the pool are retired: only the frames of the graphics queue can still use them
+    vkQueueWaitIdle(resources.ctx.GCT0.queue);
+    resources.releaseRetired();
+    if(!allocateDescriptorSet(device))
+      LOGE("The scene descriptor set could not be allocated\n");
+  }
+  setDirtyFlag(Scene::eSceneDescriptorSet, true);
+
   // Write to descriptors
   const VkDescriptorBufferInfo frameBufferInfo{m_sceneFrameInfoBuffer.buffer, 0, VK_WHOLE_SIZE};
   const VkDescriptorBufferInfo sceneBufferInfo{m_gltfSceneVk->sceneDesc().buffer, 0, VK_WHOLE_SIZE};
+  const VkDescriptorBufferInfo feedbackBufferInfo{m_textureFeedbackBuffer.buffer, 0, VK_WHOLE_SIZE};
+  const VkDescriptorBufferInfo lightsBufferInfo = m_lightSampler.getLightsBufferInfo();
+  const VkDescriptorBufferInfo nodesBufferInfo  = m_lightSampler.getNodesBufferInfo();
 
   std::vector<VkWriteDescriptorSet> writeDescriptorSets;
   writeDescriptorSets.push_back({.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -363,23 +968,71 @@ void gltfr::Scene::writeDescriptorSet(Resources& resources) const
                                  .descriptorCount = 1,
                                  .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                                  .pBufferInfo     = &sceneBufferInfo});
+  writeDescriptorSets.push_back({.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                 .dstSet          = m_sceneDescriptorSet,
+                                 .dstBinding      = SceneBindings::eTextureFeedback,
+                                 .dstArrayElement = 0,
+                                 .descriptorCount = 1,
+                                 .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                 .pBufferInfo     = &feedbackBufferInfo});
+  writeDescriptorSets.push_back({.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                 .dstSet          = m_sceneDescriptorSet,
+                                 .dstBinding      = SceneBindings::eLightSampling,
+                                 .dstArrayElement = 0,
+                                 .descriptorCount = 1,
+                                 .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                 .pBufferInfo     = &lightsBufferInfo});
+  writeDescriptorSets.push_back({.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                 .dstSet          = m_sceneDescriptorSet,
+                                 .dstBinding      = SceneBindings::eEmissiveNodes,
+                                 .dstArrayElement = 0,
+                                 .descriptorCount = 1,
+                                 .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                 .pBufferInfo     = &nodesBufferInfo});
 
   std::vector<VkDescriptorImageInfo> descImageInfos;
-  descImageInfos.reserve(m_gltfSceneVk->nbTextures());
-  for(const nvvk::Texture& texture : m_gltfSceneVk->textures())  // All texture samplers
+  if(m_textureStreamer)
+  {
+    // Streamed textures, with their current resolution
+    const std::vector<VkDescriptorImageInfo>& streamed = m_textureStreamer->descriptors();
+    descImageInfos.assign(streamed.begin(), streamed.begin() + std::min(streamed.size(), size_t(MAXTEXTURES)));
+  }
+  else if(m_gltfSceneVk->hasDeferredTextures())
   {
-    descImageInfos.emplace_back(texture.descriptor);
+    // Textures are still streaming: bind a placeholder matching the usage of each texture
+    const tinygltf::Model& model = m_gltfScene->getModel();
+    descImageInfos.resize(std::min(model.textures.size(), size_t(MAXTEXTURES)),
+                          m_placeholderTextures[ePlaceholderWhite].descriptor);
+    auto setPlaceholder = [&](int textureID, PlaceholderTexture placeholder) {
+      if(textureID >= 0 && textureID < static_cast<int>(descImageInfos.size()))
+        descImageInfos[textureID] = m_placeholderTextures[placeholder].descriptor;
+    };
+    for(const tinygltf::Material& material : model.materials)
+    {
+      setPlaceholder(material.normalTexture.index, ePlaceholderFlatNormal);
+      setPlaceholder(material.emissiveTexture.index, ePlaceholderBlack);
+    }
+  }
+  else
+  {
+    descImageInfos.reserve(m_gltfSceneVk->nbTextures());
+    for(const nvvk::Texture& texture : m_gltfSceneVk->textures())  // All texture samplers
+    {
+      descImageInfos.emplace_back(texture.descriptor);
+    }
   }
   writeDescriptorSets.push_back({.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                                  .dstSet          = m_sceneDescriptorSet,
                                  .dstBinding      = SceneBindings::eTextures,
                                  .dstArrayElement = 0,
-                                 .descriptorCount = m_gltfSceneVk->nbTextures(),
+                                 .descriptorCount = static_cast<uint32_t>(descImageInfos.size()),
                                  .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                                  .pImageInfo      = descImageInfos.data()});
 
   vkUpdateDescriptorSets(resources.ctx.device, static_cast<uint32_t>(writeDescriptorSets.size()),
                          writeDescriptorSets.data(), 0, nullptr);
+  Telemetry::getInstance().add(Telemetry::eDescriptorWrites);
+  Telemetry::getInstance().add(Telemetry::eTextureDescriptors, descImageInfos.size());
 }
 
 void gltfr::Scene::destroyDescriptorSet(VkDevice device)
@@ -392,6 +1045,147 @@ void gltfr::Scene::destroyDescriptorSet(VkDevice device)
   }
 }
 
+//--------------------------------------------------------------------------------------------------
+// Render nodes of each glTF node, and the content of the render node buffer after the creation
+//
+void gltfr::Scene::buildNodeRenderNodes()
+{
+  const std::vector<nvh::gltf::RenderNode>& renderNodes = m_gltfScene->getRenderNodes();
+
+  m_nodeRenderNodes.assign(m_gltfScene->getModel().nodes.size(), {});
+  m_uploadedRenderNodes.resize(renderNodes.size());
+  for(size_t i = 0; i < renderNodes.size(); i++)
+  {
+    const nvh::gltf::RenderNode& renderNode = renderNodes[i];
+    if(renderNode.refNodeID >= 0 && renderNode.refNodeID < static_cast<int>(m_nodeRenderNodes.size()))
+      m_nodeRenderNodes[renderNode.refNodeID].push_back(static_cast<uint32_t>(i));
+    m_uploadedRenderNodes[i] = {renderNode.worldMatrix, renderNode.materialID, renderNode.renderPrimID};
+  }
+  m_dirtyRenderNodes.clear();
+
+  // Nodes used as joints, their changes deform the skinned vertices
+  const tinygltf::Model& model = m_gltfScene->getModel();
+  m_jointNodes.assign(model.nodes.size(), false);
+  for(const tinygltf::Skin& skin : model.skins)
+  {
+    for(int joint : skin.joints)
+    {
+      if(joint >= 0 && joint < static_cast<int>(m_jointNodes.size()))
+        m_jointNodes[joint] = true;
+    }
+  }
+
+  m_deformedPrimitives = collectDeformedPrimitives(*m_gltfScene);
+  m_deformationHashes  = hashDeformations(*m_gltfScene, m_deformedPrimitives);
+  m_dirtyBlas.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// After the animation, find the deformed primitives whose BLAS need to be refit
+//
+void gltfr::Scene::findChangedDeformations()
+{
+  const std::vector<uint64_t> hashes = hashDeformations(*m_gltfScene, m_deformedPrimitives);
+  for(uint32_t primID : m_deformedPrimitives)
+  {
+    if(hashes[primID] != m_deformationHashes[primID])
+      m_dirtyBlas.push_back(primID);
+  }
+  m_deformationHashes = hashes;
+}
+
+//--------------------------------------------------------------------------------------------------
+// A node changed: its render nodes and the ones of its children need to be uploaded
+//
+void gltfr::Scene::markNodeDirty(int nodeID)
+{
+  if(nodeID < 0 || nodeID >= static_cast<int>(m_nodeRenderNodes.size()))
+    return;
+  const std::vector<uint32_t>& renderNodes = m_nodeRenderNodes[nodeID];
+  m_dirtyRenderNodes.insert(m_dirtyRenderNodes.end(), renderNodes.begin(), renderNodes.end());
+  for(int child : m_gltfScene->getModel().nodes[nodeID].children)
+    markNodeDirty(child);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The node or one of its children is a joint: a change of its transform deforms skinned vertices
+//
+bool gltfr::Scene::affectsSkinning(int nodeID) const
+{
+  if(nodeID < 0 || nodeID >= static_cast<int>(m_jointNodes.size()))
+    return false;
+  if(m_jointNodes[nodeID])
+    return true;
+  for(int child : m_gltfScene->getModel().nodes[nodeID].children)
+  {
+    if(affectsSkinning(child))
+      return true;
+  }
+  return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Compare the render nodes with what was uploaded, when the changes are not known (animation)
+//
+void gltfr::Scene::findChangedRenderNodes()
+{
+  const std::vector<nvh::gltf::RenderNode>& renderNodes = m_gltfScene->getRenderNodes();
+  if(renderNodes.size() != m_uploadedRenderNodes.size())
+    buildNodeRenderNodes();
+
+  for(size_t i = 0; i < renderNodes.size(); i++)
+  {
+    const nvh::gltf::RenderNode& renderNode = renderNodes[i];
+    const UploadedRenderNode&    uploaded   = m_uploadedRenderNodes[i];
+    if(renderNode.worldMatrix != uploaded.worldMatrix || renderNode.materialID != uploaded.materialID
+       || renderNode.renderPrimID != uploaded.renderPrimID)
+      m_dirtyRenderNodes.push_back(static_cast<uint32_t>(i));
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Upload the given render nodes through the upload ring, the consecutive ones are copied at once
+// Returns false if they don't fit in the ring, nothing is uploaded then.
+//
+bool gltfr::Scene::uploadRenderNodes(std::vector<uint32_t>& renderNodeIDs)
+{
+  const std::vector<nvh::gltf::RenderNode>& renderNodes = m_gltfScene->getRenderNodes();
+  if(renderNodes.size() != m_uploadedRenderNodes.size())
+    return false;
+
+  std::sort(renderNodeIDs.begin(), renderNodeIDs.end());
+  renderNodeIDs.erase(std::unique(renderNodeIDs.begin(), renderNodeIDs.end()), renderNodeIDs.end());
+  if(renderNodeIDs.empty())
+    return true;
+
+  // Room for the frame info, and the alignment of each range
+  const VkDeviceSize needed = renderNodeIDs.size() * sizeof(nvvkhl_shaders::RenderNode)
+                              + renderNodeIDs.size() * 16 + sizeof(DH::SceneFrameInfo);
+  if(m_uploadRing.usedBytes() + needed > m_uploadRing.frameSize())
+    return false;
+
+  const VkBuffer                          dst = m_gltfSceneVk->renderNodeBuffer();
+  std::vector<nvvkhl_shaders::RenderNode> range;
+  for(size_t i = 0; i < renderNodeIDs.size();)
+  {
+    const uint32_t first = renderNodeIDs[i];
+    range.clear();
+    for(; i < renderNodeIDs.size() && renderNodeIDs[i] == first + range.size(); i++)
+    {
+      const nvh::gltf::RenderNode& renderNode = renderNodes[renderNodeIDs[i]];
+      nvvkhl_shaders::RenderNode   info{};
+      info.objectToWorld = renderNode.worldMatrix;
+      info.worldToObject = glm::inverse(renderNode.worldMatrix);
+      info.materialID    = renderNode.materialID;
+      info.renderPrimID  = renderNode.renderPrimID;
+      range.push_back(info);
+      m_uploadedRenderNodes[renderNodeIDs[i]] = {renderNode.worldMatrix, renderNode.materialID, renderNode.renderPrimID};
+    }
+    m_uploadRing.copy(dst, first * sizeof(nvvkhl_shaders::RenderNode), range.data(), range.size() * sizeof(nvvkhl_shaders::RenderNode));
+  }
+  return true;
+}
+
 //--------------------------------------------------------------------------------------------------
 // Processing the frame is something call at each frame
 // If something has changed, we need to update one of the following:
@@ -401,7 +1195,7 @@ void gltfr::Scene::destroyDescriptorSet(VkDevice device)
 // - Update the Vulkan scene
 // - Update the RTX scene
 //
-bool gltfr::Scene::processFrame(VkCommandBuffer cmd, Settings& settings)
+bool gltfr::Scene::processFrame(VkCommandBuffer cmd, Resources& resources, Settings& settings)
 {
   // Dealing with animation
   if(m_gltfScene->hasAnimation() && m_animControl.doAnimation())
@@ -417,8 +1211,8 @@ bool gltfr::Scene::processFrame(VkCommandBuffer cmd, Settings& settings)
       animInfo.incrementTime(deltaTime);
     }
 
-    m_gltfScene->updateAnimation(m_animControl.currentAnimation);
-    m_gltfScene->updateRenderNodes();
+    m_animationEvaluator.evaluate(*m_gltfScene, m_animControl.currentAnimation);
+    findChangedDeformations();
 
     m_animControl.clearStates();
 
@@ -433,32 +1227,89 @@ bool gltfr::Scene::processFrame(VkCommandBuffer cmd, Settings& settings)
   if(!updateFrameCount(settings))
     return false;
 
+  // The scene allocator is used by the loader thread while the textures are streamed,
+  // the changes are kept and uploaded once it is done.
+  const bool canUpload = (m_loadStage != eLoadTextures) && (m_loadStage != eLoadTexturesReady);
+
+  Telemetry& telemetry = Telemetry::getInstance();
+  m_uploadRing.beginFrame();
+
   // Check for scene changes
-  if(m_dirtyFlags.test(eVulkanScene))
+  if(canUpload && m_dirtyFlags.test(eVulkanScene))
   {
-    m_gltfSceneVk->updateRenderNodesBuffer(cmd, *m_gltfScene);       // Animation, changing nodes transform
-    m_gltfSceneVk->updateRenderPrimitivesBuffer(cmd, *m_gltfScene);  // Animation
-    m_gltfSceneVk->updateRenderLightsBuffer(cmd, *m_gltfScene);      // changing lights data
+    findChangedRenderNodes();  // Animation, variants: only the render nodes which changed are uploaded
+    m_dirtyFlags.set(eVulkanRenderNodes);
+    m_dirtyFlags.set(eVulkanLights);
+    if(m_gpuAnimation.isActive())
+      m_gpuAnimation.cmdAnimate(cmd, *m_gltfScene, m_animationEvaluator.worldMatrices(), m_uploadRing);  // Skinning and morph targets in a compute pass
+    else
+    {
+      m_gltfSceneVk->updateRenderPrimitivesBuffer(cmd, *m_gltfScene);  // Animation
+      telemetry.add(Telemetry::eStagingUploads);
+    }
     m_dirtyFlags.reset(eVulkanScene);
   }
-  if(m_dirtyFlags.test(eVulkanMaterial))
+  if(canUpload && m_dirtyFlags.test(eVulkanRenderNodes))
+  {
+    if(!uploadRenderNodes(m_dirtyRenderNodes))
+    {
+      // Too many for the upload ring
+      m_gltfSceneVk->updateRenderNodesBuffer(cmd, *m_gltfScene);
+      telemetry.add(Telemetry::eStagingUploads);
+      for(size_t i = 0; i < m_uploadedRenderNodes.size(); i++)
+      {
+        const nvh::gltf::RenderNode& renderNode = m_gltfScene->getRenderNodes()[i];
+        m_uploadedRenderNodes[i] = {renderNode.worldMatrix, renderNode.materialID, renderNode.renderPrimID};
+      }
+    }
+    m_dirtyRenderNodes.clear();
+    m_dirtyFlags.reset(eVulkanRenderNodes);
+  }
+  // The light table follows the powers of the lights and of the emissive materials
+  bool lightTableChanged = canUpload && (m_dirtyFlags.test(eVulkanLights) || m_dirtyFlags.test(eVulkanMaterial));
+  if(canUpload && m_dirtyFlags.test(eVulkanLights))
+  {
+    m_gltfSceneVk->updateRenderLightsBuffer(cmd, *m_gltfScene);  // changing lights data
+    telemetry.add(Telemetry::eStagingUploads);
+    m_dirtyFlags.reset(eVulkanLights);
+  }
+  if(canUpload && m_dirtyFlags.test(eVulkanMaterial))
   {
     m_gltfSceneVk->updateMaterialBuffer(cmd, *m_gltfScene);
+    telemetry.add(Telemetry::eStagingUploads);
+    // The baked opacity no longer matches the edited alpha, the instances are updated with the TLAS
+    if(m_gltfSceneRtx->disableStaleMicromaps(*m_gltfScene))
+      m_dirtyFlags.set(eRtxScene);
     m_dirtyFlags.reset(eVulkanMaterial);
   }
-  if(m_dirtyFlags.test(eVulkanAttributes))
+  if(lightTableChanged && m_lightSampler.update(resources, *m_gltfScene, m_uploadRing))
+    writeDescriptorSet(resources);  // New buffers
+  if(lightTableChanged)
+    updateShaderFeatures();
+  if(canUpload && m_dirtyFlags.test(eVulkanAttributes))
   {
     m_gltfSceneVk->updateVertexBuffers(cmd, *m_gltfScene);
+    telemetry.add(Telemetry::eStagingUploads);
     m_dirtyFlags.reset(eVulkanAttributes);
   }
-  if(m_dirtyFlags.test(eRtxScene))
+  if(canUpload && m_dirtyFlags.test(eRtxScene))
   {
+    // Only the deformed BLAS are refit, rigid motion only needs the instances of the TLAS
+    std::sort(m_dirtyBlas.begin(), m_dirtyBlas.end());
+    m_dirtyBlas.erase(std::unique(m_dirtyBlas.begin(), m_dirtyBlas.end()), m_dirtyBlas.end());
+    m_gltfSceneRtx->cmdUpdateDynamicBlas(cmd, m_dirtyBlas);
+    telemetry.add(Telemetry::eBlasRefits, m_dirtyBlas.size());
+    m_dirtyBlas.clear();
     m_gltfSceneRtx->updateTopLevelAS(cmd, *m_gltfScene);
-    m_gltfSceneRtx->updateBottomLevelAS(cmd, *m_gltfScene);
+    telemetry.add(Telemetry::eTlasUpdates);
 
     m_dirtyFlags.reset(eRtxScene);
   }
 
+  // The camera of the previous frame, for the temporal reprojection
+  m_sceneFrameInfo.prevViewProjMatrix = m_sceneFrameInfo.projMatrix * m_sceneFrameInfo.viewMatrix;
+  m_sceneFrameInfo.prevCamPos         = m_sceneFrameInfo.camPos;
+
   // Update the camera
   const glm::vec2& clip       = CameraManip.getClipPlanes();
   m_sceneFrameInfo.viewMatrix = CameraManip.getMatrix();
@@ -485,31 +1336,31 @@ bool gltfr::Scene::processFrame(VkCommandBuffer cmd, Settings& settings)
     SET_FLAG(m_sceneFrameInfo.flags, USE_HDR_FLAG);
     m_sceneFrameInfo.nbLights = 0;
   }
+  // Share of the light samples between the light table and the environment
+  {
+    float envIrradiance = 0.0F;
+    if(settings.envSystem == Settings::eSky)
+      envIrradiance = m_sceneFrameInfo.light[0].intensity;  // The sun dominates the sky
+    else
+      envIrradiance = glm::pi<float>() * m_hdrEnv->getIntegral() * settings.hdrEnvIntensity;
+    m_sceneFrameInfo.lightsWeight = m_lightSampler.lightsWeight(envIrradiance);
+  }
   if(settings.useSolidBackground)
   {
     SET_FLAG(m_sceneFrameInfo.flags, USE_SOLID_BACKGROUND_FLAG);
     m_sceneFrameInfo.backgroundColor = nvvkhl_shaders::toLinear(settings.solidBackgroundColor);
   }
 
+  // Selection is read by the shaders, changing it does not require recording the raster again
+  m_sceneFrameInfo.selectedRenderNode = m_selectedRenderNode;
 
-  vkCmdUpdateBuffer(cmd, m_sceneFrameInfoBuffer.buffer, 0, sizeof(DH::SceneFrameInfo), &m_sceneFrameInfo);
 
-  // Barrier to ensure the buffer is updated before rendering
-  std::array<VkBufferMemoryBarrier2, 1> bufferBarriers = {
-      {{.sType         = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
-        .srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,  // vkCmdUpdateBuffer uses transfer
-        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
-        .dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-        .dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT,
-        .buffer        = m_sceneFrameInfoBuffer.buffer,
-        .offset        = 0,
-        .size          = sizeof(DH::SceneFrameInfo)}},
-  };
+  if(!m_uploadRing.copy(m_sceneFrameInfoBuffer.buffer, 0, &m_sceneFrameInfo, sizeof(DH::SceneFrameInfo)))
+    vkCmdUpdateBuffer(cmd, m_sceneFrameInfoBuffer.buffer, 0, sizeof(DH::SceneFrameInfo), &m_sceneFrameInfo);
 
-  VkDependencyInfo dependencyInfo = {.sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-                                     .bufferMemoryBarrierCount = uint32_t(bufferBarriers.size()),
-                                     .pBufferMemoryBarriers    = bufferBarriers.data()};
-  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+  // Copies of the frame, with a barrier to ensure the buffers are updated before rendering
+  telemetry.add(Telemetry::eUploadBytes, m_uploadRing.usedBytes());
+  m_uploadRing.flush(cmd);
 
 
   // Update the sky
@@ -529,94 +1380,225 @@ bool gltfr::Scene::processFrame(VkCommandBuffer cmd, Settings& settings)
 // The sceneRtx is the Vulkan representation of the scene for ray tracing
 // - Bottom-level acceleration structures
 // - Top-level acceleration structure
-void gltfr::Scene::createVulkanScene(Resources& res)
+// Before anything is created, the memory plan chooses the BLAS batches and the texture budget, and
+// the scene is refused when it does not fit.
+bool gltfr::Scene::createVulkanScene(Resources& res, bool deferTextures)
 {
   nvh::ScopedTimer st(std::string("\n") + __FUNCTION__);
 
-  nvvk::ResourceAllocator* alloc = res.m_allocator.get();
+  m_pendingMemory = {};
+  MemoryBudget::Plan plan;
+  if(m_pendingScene->valid())
+  {
+    const std::string baseDir = std::filesystem::path(m_pendingFilename).parent_path().string();
+    MemoryBudget::SceneEstimate estimate = res.m_memory.estimate(*m_pendingScene, baseDir, deferTextures && g_compressTextures);
+    if(!deferTextures)
+    {  // Created with the geometry, while the previous scene is still resident
+      estimate.geometry += estimate.textures;
+      estimate.textures = 0;
+    }
+    plan = res.m_memory.plan(estimate, VkDeviceSize(std::max(g_textureBudgetMB, 0)) << 20);
+    if(!plan.fits)
+      return false;
+    m_textureBudget = plan.textureBudget;
+  }
 
-  m_gltfSceneVk = std::make_unique<nvvkhl::SceneVk>(res.ctx.device, res.ctx.physicalDevice, alloc);
-  m_gltfSceneRtx = std::make_unique<nvvkhl::SceneRtx>(res.ctx.device, res.ctx.physicalDevice, alloc, res.ctx.compute.familyIndex);
+  nvvk::ResourceAllocator* alloc = res.m_sceneAllocator.get();
 
-  if(m_gltfScene->valid())
+  m_pendingSceneVk = std::make_unique<SceneVkStreamed>(res.ctx.device, res.ctx.physicalDevice, alloc);
+  m_pendingSceneRtx = std::make_unique<SceneRtxCached>(res.ctx.device, res.ctx.physicalDevice, alloc, res.ctx.compute.familyIndex);
+  m_pendingSceneVk->setDeferTextures(deferTextures);
+  m_pendingSceneVk->setBaseDir(std::filesystem::path(m_pendingFilename).parent_path());  // Scenes given with takeModel() have no filename
+
+  if(m_pendingScene->valid())
   {
+    if(deferTextures)
+      m_loadStage = eLoadGeometry;
+
     // Create the Vulkan side of the scene
     // Since we load and display simultaneously, we need to use a second GTC queue
     nvvk::CommandPool cmd_pool(res.ctx.device, res.ctx.compute.familyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
                                res.ctx.compute.queue);
     VkCommandBuffer   cmd;
+    nvh::Stopwatch    stageTime;
+    VkDeviceSize      used = sceneMemoryUsed(res);
     {  // Creating the scene in Vulkan buffers
       cmd = cmd_pool.createCommandBuffer();
-      m_gltfSceneVk->create(cmd, *m_gltfScene, false);
+      m_pendingSceneVk->create(cmd, *m_pendingScene, false);
       // This method is simpler, but it is not as efficient as the while-loop below
       // m_sceneRtx->create(cmd, *m_scene, *m_sceneVk, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
       cmd_pool.submitAndWait(cmd);
-      res.m_allocator->finalizeAndReleaseStaging();  // Make sure there are no pending staging buffers and clear them up
+      res.m_sceneAllocator->finalizeAndReleaseStaging();  // Make sure there are no pending staging buffers and clear them up
     }
+    m_loadTimings.geometry = stageTime.elapsed();
+    stageTime.reset();
+    m_pendingMemory[MemoryBudget::eGeometry] = sceneMemoryUsed(res) - used;
+    used                                     = sceneMemoryUsed(res);
+    m_loadProgress = 0.5F;
+    if(deferTextures)
+      m_loadStage = eLoadAccel;
 
     // Create the acceleration structure, and compact the BLAS
+    // The BLAS are built in batches limited by the memory budget. The compacted sizes of a batch are only
+    // known once it is built, so its compaction is recorded together with the build of the next batch,
+    // and the compaction of the last batch together with the TLAS. The GPU is not waiting on a separate
+    // compaction submit, and there is one submission per batch.
     VkBuildAccelerationStructureFlagsKHR blasBuildFlags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR
                                                           | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR
                                                           | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
-    m_gltfSceneRtx->createBottomLevelAccelerationStructure(*m_gltfScene, *m_gltfSceneVk, blasBuildFlags);
-    bool finished = false;
-    do
-    {
-      {  // Building the BLAS
-        cmd      = cmd_pool.createCommandBuffer();
-        finished = m_gltfSceneRtx->cmdBuildBottomLevelAccelerationStructure(cmd, 512'000'000);
-        cmd_pool.submitAndWait(cmd);
-      }
-      {  // Compacting the BLAS
+    m_pendingSceneRtx->createBottomLevelAccelerationStructure(*m_pendingScene, *m_pendingSceneVk, blasBuildFlags);
+
+    // The alpha-tested primitives get the opacity micromaps of their texture, any-hit is only invoked for
+    // the micro-triangles which are neither opaque nor transparent. The bake is cached with the BLAS.
+    if(g_opacityMicromaps && OpacityMicromaps::isSupported(res.ctx.physicalDevice))
+    {
+      auto micromaps = std::make_unique<OpacityMicromaps>();
+      if(micromaps->create(alloc, res.ctx.physicalDevice, cmd_pool, *m_pendingScene, collectDeformedPrimitives(*m_pendingScene),
+                           std::filesystem::path(m_pendingFilename).parent_path(), g_compactVertices, g_useBlasCache))
+        m_pendingSceneRtx->attachOpacityMicromaps(std::move(micromaps));
+    }
+
+    // The compacted BLAS are cached on disk. Animated scenes are always built, as they need the build data to refit.
+    // The BLAS referencing micromaps are not cached, they are built when the others are restored, see SceneRtxCached.
+    std::filesystem::path blasCachePath;
+    if(g_useBlasCache && !m_pendingScene->hasAnimation())
+    {
+      blasCachePath = SceneRtxCached::getBlasCachePath(*m_pendingScene, blasBuildFlags, res.ctx.physicalDevice);
+    }
+    const bool blasRestored =
+        m_pendingSceneRtx->restoreBlas(cmd_pool, blasCachePath, m_pendingScene->getRenderPrimitives().size());
+
+    const VkDeviceSize blasBudget = plan.blasBatch;
+
+    VkFence                 fence{};
+    const VkFenceCreateInfo fenceInfo{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    NVVK_CHECK(vkCreateFence(res.ctx.device, &fenceInfo, nullptr, &fence));
+    auto submitAndWaitFence = [&](VkCommandBuffer cmdBuf) {
+      cmd_pool.submit(1, &cmdBuf, fence);
+      NVVK_CHECK(vkWaitForFences(res.ctx.device, 1, &fence, VK_TRUE, UINT64_MAX));
+      NVVK_CHECK(vkResetFences(res.ctx.device, 1, &fence));
+      cmd_pool.destroy(cmdBuf);
+    };
+
+    if(!blasRestored)
+    {  // Building the first batch of BLAS
+      cmd           = cmd_pool.createCommandBuffer();
+      bool finished = m_pendingSceneRtx->cmdBuildBottomLevelAccelerationStructure(cmd, blasBudget);
+      submitAndWaitFence(cmd);
+
+      while(!finished)
+      {  // Compacting batch N while building batch N+1
         cmd = cmd_pool.createCommandBuffer();
-        m_gltfSceneRtx->cmdCompactBlas(cmd);
-        cmd_pool.submitAndWait(cmd);
+        m_pendingSceneRtx->cmdCompactBlas(cmd);
+        finished = m_pendingSceneRtx->cmdBuildBottomLevelAccelerationStructure(cmd, blasBudget);
+        submitAndWaitFence(cmd);
+        m_pendingSceneRtx->destroyNonCompactedBlas();
       }
-      m_gltfSceneRtx->destroyNonCompactedBlas();
-    } while(!finished);
+    }
 
-    {  // Creating the top-level acceleration structure
+    {  // Compacting the last batch and creating the top-level acceleration structure
       cmd = cmd_pool.createCommandBuffer();
-      m_gltfSceneRtx->cmdCreateBuildTopLevelAccelerationStructure(cmd, *m_gltfScene);
-      cmd_pool.submitAndWait(cmd);
+      if(!blasRestored)
+        m_pendingSceneRtx->cmdCompactBlas(cmd);
+
+      // The compacted BLAS must be written before the TLAS build reads them
+      const VkMemoryBarrier2 barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                     .srcStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_COPY_BIT_KHR
+                                                     | VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                                     .srcAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+                                     .dstStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                                     .dstAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR};
+      const VkDependencyInfo dependencyInfo{.sType              = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+                                            .memoryBarrierCount = 1,
+                                            .pMemoryBarriers    = &barrier};
+      vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+      // The deformed primitives get BLAS which can be refit (animation or joint edits), the compacted ones are only
+      // used by rigid primitives
+      m_pendingSceneRtx->cmdCreateDynamicBlas(cmd, collectDeformedPrimitives(*m_pendingScene));
+
+      m_pendingSceneRtx->cmdCreateBuildTopLevelAccelerationStructure(cmd, *m_pendingScene);
+      submitAndWaitFence(cmd);
+      Telemetry::getInstance().add(Telemetry::eTlasUpdates);
+      if(!blasRestored)
+        Telemetry::getInstance().add(Telemetry::eBlasBuilds, m_pendingScene->getRenderPrimitives().size());
+      m_pendingSceneRtx->destroyRetiredBlas();
+      m_pendingSceneRtx->destroyMicromapInputs();
+      if(!blasRestored)
+        m_pendingSceneRtx->destroyNonCompactedBlas();
+    }
+    vkDestroyFence(res.ctx.device, fence, nullptr);
+
+    if(!blasRestored && !blasCachePath.empty())
+    {
+      m_pendingSceneRtx->saveBlas(cmd_pool, blasCachePath);
     }
-    if(!m_gltfScene->hasAnimation())
+    if(!m_pendingScene->hasAnimation())
     {
-      m_gltfSceneRtx->destroyScratchBuffers();
+      m_pendingSceneRtx->destroyScratchBuffers();
     }
+    m_pendingMemory[MemoryBudget::eScratch] = m_pendingSceneRtx->dynamicScratchSize();
+    m_pendingMemory[MemoryBudget::eAccel]   = sceneMemoryUsed(res) - used - m_pendingMemory[MemoryBudget::eScratch];
+
+    // The acceleration structures are built: the vertices of the rigid primitives can be compacted
+    if(g_compactVertices)
+    {
+      used = sceneMemoryUsed(res);
+      m_compactVertices.compact(res, *m_pendingScene, *m_pendingSceneVk, collectDeformedPrimitives(*m_pendingScene));
+      m_pendingMemory[MemoryBudget::eGeometry] -= std::min(used - sceneMemoryUsed(res), m_pendingMemory[MemoryBudget::eGeometry]);
+    }
+    m_loadTimings.accel       = stageTime.elapsed();
+    m_loadTimings.accelCached = blasRestored;
+    m_loadProgress            = 0.75F;
   }
   else
   {
-    m_gltfSceneRtx.reset();
-    m_gltfSceneVk.reset();
+    m_pendingSceneRtx.reset();
+    m_pendingSceneVk.reset();
   }
+  return true;
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create the HDR environment
+// Create the HDR environment, on any thread
+// The new environment is prepared alongside the current one, which continues to render until
+// the main thread swaps them (commitPendingHdr). The compute queue is taken from the streamer.
 //
-void gltfr::Scene::createHdr(Resources& res, const std::string& filename)
+bool gltfr::Scene::createHdr(Resources& res, const std::string& filename)
 {
   nvh::ScopedTimer st(std::string("\n") + __FUNCTION__);
 
-  nvvk::ResourceAllocator* alloc          = res.m_allocator.get();
-  const uint32_t           c_family_queue = res.ctx.compute.familyIndex;
-
-  m_hdrEnv  = std::make_unique<nvvkhl::HdrEnv>(res.ctx.device, res.ctx.physicalDevice, alloc, c_family_queue);
-  m_hdrDome = std::make_unique<nvvkhl::HdrEnvDome>(res.ctx.device, res.ctx.physicalDevice, alloc, c_family_queue);
-  m_hdrEnv->loadEnvironment(filename, true);
-  m_hdrDome->create(m_hdrEnv->getDescriptorSet(), m_hdrEnv->getDescriptorSetLayout());
-  alloc->finalizeAndReleaseStaging();
+  m_hdrLoading = true;
+  if(m_textureStreamer)
+    m_textureStreamer->suspend();
+  auto       hdrEnv = std::make_unique<HdrEnvironment>(res);
+  const bool ok     = hdrEnv->create(res, filename);
+  if(m_textureStreamer)
+    m_textureStreamer->resume();
 
-  m_hdrFilename = std::filesystem::path(filename).filename().string();
-  setDirtyFlag(Scene::eHdrEnv, true);
+  if(ok)
+  {
+    m_pendingHdrEnv      = std::move(hdrEnv);
+    m_pendingHdrFilename = std::filesystem::path(filename).filename().string();
+    m_hdrReady           = true;
+  }
+  m_hdrLoading = false;
+  return ok;
 }
 
-void gltfr::Scene::generateHdrMipmap(VkCommandBuffer cmd, Resources& res)
+//--------------------------------------------------------------------------------------------------
+// Main thread: the prepared environment replaces the current one, which is retired
+//
+void gltfr::Scene::commitPendingHdr(Resources& res)
 {
-  vkQueueWaitIdle(res.ctx.GCT0.queue);
-  nvvk::cmdGenerateMipmaps(cmd, m_hdrEnv->getHdrTexture().image, VK_FORMAT_R32G32B32A32_SFLOAT,
-                           m_hdrEnv->getHdrImageSize(), nvvk::mipLevels(m_hdrEnv->getHdrImageSize()));
+  if(!m_hdrReady)
+    return;
+  res.retire(std::move(m_hdrEnv));
+  m_hdrEnv      = std::move(m_pendingHdrEnv);
+  m_hdrFilename = m_pendingHdrFilename;
+  m_hdrReady    = false;
+  setDirtyFlag(Scene::eHdrEnv, true);
+  resetFrameCount();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -633,7 +1615,10 @@ bool gltfr::Scene::updateFrameCount(Settings& settings)
 
   if(ref_cam_matrix != m || ref_fov != fov)
   {
+    // The accumulation can be reprojected, unless something else reset it too
+    const bool accumulating = m_sceneFrameInfo.frameCount >= 0;
     resetFrameCount();
+    m_cameraReset = accumulating;
     ref_cam_matrix = m;
     ref_fov        = fov;
   }
@@ -651,6 +1636,7 @@ bool gltfr::Scene::updateFrameCount(Settings& settings)
 void gltfr::Scene::resetFrameCount()
 {
   m_sceneFrameInfo.frameCount = -1;
+  m_cameraReset               = false;
 }
 
 nvh::Bbox gltfr::Scene::getRenderNodeBbox(int nodeID) const
@@ -704,17 +1690,13 @@ bool gltfr::Scene::onUI(Resources& resources, Settings& settings, GLFWwindow* wi
     reset |= ImGui::RadioButton("Hdr", reinterpret_cast<int*>(&settings.envSystem), Settings::eHdr);
     ImGui::EndDisabled();
     ImGui::SameLine();
+    ImGui::BeginDisabled(isLoading());
     if(ImGui::SmallButton("Load##env"))
     {
-      std::string filename = NVPSystem::windowOpenFileDialog(winHandle, "Load HDR", "HDR(.hdr)|*.hdr");
-      if(!filename.empty())
-      {
-        vkDeviceWaitIdle(resources.ctx.device);
-        createHdr(resources, filename);
-        settings.envSystem = Settings::eHdr;
-        reset              = true;
-      }
+      // Prepared by the worker thread of the application, like a dropped file (see main.cpp onFileDrop)
+      m_requestedHdr = NVPSystem::windowOpenFileDialog(winHandle, "Load HDR", "HDR(.hdr)|*.hdr");
     }
+    ImGui::EndDisabled();
 
     // When switching the environment, reset Firefly max luminance
     if(cache_env_system != settings.envSystem && m_hdrEnv)
@@ -753,18 +1735,32 @@ bool gltfr::Scene::onUI(Resources& resources, Settings& settings, GLFWwindow* wi
       if(headerManager.beginHeader("Multiple Scenes"))
       {
         ImGui::PushID("Scenes");
+        // Created on this thread, with the scene allocator and the compute queue of the loader
+        ImGui::BeginDisabled(isLoading());
         for(size_t i = 0; i < m_gltfScene->getModel().scenes.size(); i++)
         {
           if(ImGui::RadioButton(m_gltfScene->getModel().scenes[i].name.c_str(), m_gltfScene->getCurrentScene() == i))
           {
             m_gltfScene->setCurrentScene(int(i));
-            vkDeviceWaitIdle(resources.ctx.device);
-            createVulkanScene(resources);
-            postSceneCreateProcess(resources, m_gltfScene->getFilename());
+            // Re-creating the Vulkan scene of the same model, through the pending scene
+            m_pendingScene    = std::move(m_gltfScene);
+            m_pendingFilename = m_filename;
+            if(m_textureStreamer)
+              m_textureStreamer->suspend();
+            const bool created = createVulkanScene(resources, false);
+            if(m_textureStreamer)
+              m_textureStreamer->resume();
+            if(!created)
+            {
+              m_gltfScene = std::move(m_pendingScene);
+              break;
+            }
+            commitPendingScene(resources);
             reset = true;
             setDirtyFlag(Scene::eNewScene, true);
           }
         }
+        ImGui::EndDisabled();
         ImGui::PopID();
       }
     }
@@ -779,8 +1775,7 @@ bool gltfr::Scene::onUI(Resources& resources, Settings& settings, GLFWwindow* wi
         {
           if(ImGui::Selectable(m_gltfScene->getVariants()[i].c_str(), m_gltfScene->getCurrentVariant() == i))
           {
-            m_gltfScene->setCurrentVariant(int(i));
-            m_dirtyFlags.set(eVulkanScene);
+            selectVariant(int(i));
             reset = true;
           }
         }
@@ -837,13 +1832,28 @@ bool gltfr::Scene::onUI(Resources& resources, Settings& settings, GLFWwindow* wi
 
       if(transformChanged || lightChanged || visibilityChanged)
       {
-        m_dirtyFlags.set(eVulkanScene);
+        // Only the render nodes under the changed nodes are uploaded, and the skinned vertices when a joint moved
+        bool jointChanged = false;
+        for(int nodeID : m_sceneGraph->changedNodes())
+        {
+          markNodeDirty(nodeID);
+          jointChanged |= transformChanged && affectsSkinning(nodeID);
+        }
+        if(jointChanged)
+          m_dirtyFlags.set(eVulkanScene);
+        m_dirtyFlags.set(eVulkanRenderNodes);
+        m_dirtyFlags.set(eVulkanLights);  // Lights can be attached to the nodes
         m_dirtyFlags.set(eRtxScene);
 
         if(visibilityChanged)
           m_dirtyFlags.set(eNodeVisibility);
 
-        m_gltfScene->updateRenderNodes();
+        if(m_animationEvaluator.valid())
+          m_animationEvaluator.updateWorldMatrices(*m_gltfScene);
+        else
+          m_gltfScene->updateRenderNodes();
+        if(jointChanged)
+          findChangedDeformations();  // The BLAS of the skinned primitives are refit
         reset = true;
       }
 
@@ -859,16 +1869,21 @@ bool gltfr::Scene::onUI(Resources& resources, Settings& settings, GLFWwindow* wi
 
     if(headerManager.beginHeader("Statistics"))
     {
-      const tinygltf::Model& tiny = m_gltfScene->getModel();
       PE::begin("Stat_Val");
-      PE::Text("Nodes", std::to_string(tiny.nodes.size()));
-      PE::Text("Render Nodes", std::to_string(m_gltfScene->getRenderNodes().size()));
-      PE::Text("Render Primitives", std::to_string(m_gltfScene->getNumRenderPrimitives()));
-      PE::Text("Materials", std::to_string(tiny.materials.size()));
-      PE::Text("Triangles", std::to_string(m_gltfScene->getNumTriangles()));
-      PE::Text("Lights", std::to_string(tiny.lights.size()));
-      PE::Text("Textures", std::to_string(tiny.textures.size()));
-      PE::Text("Images", std::to_string(tiny.images.size()));
+      for(const auto& [name, value] : m_statistics)
+        PE::Text(name, value);
+      if(m_textureStreamer)
+      {
+        PE::Text("Texture Memory", std::to_string(m_textureStreamer->residentBytes() >> 20) + " / "
+                                       + std::to_string(m_textureStreamer->budget() >> 20) + " MB");
+      }
+      const MemoryBudget::Heaps heaps = resources.m_memory.query();
+      PE::Text("GPU Memory", std::to_string(heaps.usage >> 20) + " / " + std::to_string(heaps.budget >> 20) + " MB");
+      for(int i = 0; i < MemoryBudget::eNumCategories; i++)
+      {
+        const auto category = MemoryBudget::Category(i);
+        PE::Text(MemoryBudget::categoryName(category), std::to_string(resources.m_memory.get(category) >> 20) + " MB");
+      }
       PE::end();
     }
 
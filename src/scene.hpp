@@ -30,6 +30,21 @@ The scene is:
 
 The scene graph is used to show the hierarchy of the scene in the UI.
 
+Loading can be staged (loadStaged) on a separate thread: the file is parsed, the geometry uploaded
+and the acceleration structures built in a pending scene, while the current scene is still rendered.
+The main thread then swaps the pending scene (updateStagedLoad), displays it with placeholder
+textures, and the loader thread continues by streaming the textures.
+
+The HDR environment is prepared the same way (createHdr, see HdrEnvironment): the current one is
+rendered until the main thread swaps in the new one.
+
+With a texture budget (g_textureBudgetMB), the textures start with their low resolution mips
+and are streamed by the TextureStreamer, following the feedback written by the shaders.
+
+Per-frame updates (frame info, render nodes) are staged in the UploadRing. The render nodes
+changed by the UI are tracked per node, the ones changed by the animation are found by comparing
+with the last upload; only those are copied.
+
 
 
 
@@ -38,6 +53,9 @@ The scene graph is used to show the hierarchy of the scene in the UI.
 
 
 #include <string>
+#include <utility>
+#include <atomic>
+#include <array>
 #include <bitset>
 #include <glm/glm.hpp>
 
@@ -46,21 +64,30 @@ The scene graph is used to show the hierarchy of the scene in the UI.
 namespace DH {
 #include "shaders/device_host.h"  // Include the device/host structures
 }
+#include "shaders/scene_features.h"  // SCENE_FEATURE_*, the specialization of the path tracer
 
 // nvpro-core
 #include "nvh/gltfscene.hpp"
 #include "nvvk/descriptorsets_vk.hpp"
 #include "nvvkhl/gltf_scene_rtx.hpp"
 #include "nvvkhl/gltf_scene_vk.hpp"
-#include "nvvkhl/hdr_env.hpp"
-#include "nvvkhl/hdr_env_dome.hpp"
 #include "nvvkhl/sky.hpp"
 
 // Local to application
 #include "animation_control.hpp"
+#include "animation_evaluator.hpp"
+#include "compact_vertices.hpp"
+#include "gpu_animation.hpp"
+#include "hdr_environment.hpp"
+#include "light_sampler.hpp"
+#include "meshlet_scene.hpp"
 #include "resources.hpp"
 #include "scene_graph_ui.hpp"
+#include "scene_rtx_cached.hpp"
+#include "scene_vk_streamed.hpp"
 #include "settings.hpp"
+#include "texture_streamer.hpp"
+#include "upload_ring.hpp"
 
 
 namespace gltfr {
@@ -77,6 +104,28 @@ public:
   bool load(Resources& resources, const std::string& filename);
   bool save(const std::string& filename) const;
 
+  // Staged loading (glTF, OBJ): loadStaged on a separate thread, updateStagedLoad on the main thread each frame
+  bool        loadStaged(Resources& resources, const std::string& filename);
+  void        updateStagedLoad(Resources& resources);
+  bool        isLoading() const { return m_loadStage != eLoadIdle || m_hdrLoading; }
+  void        cancelStagedLoad();  // Main thread: the loader stops at its next stage, before it is joined
+  float       loadProgress() const { return m_loadProgress; }
+  const char* loadStageName() const;
+
+  // Durations of the stages of the last load, in milliseconds
+  struct LoadTimings
+  {
+    double parse{0.0};
+    double geometry{0.0};       // Materials, geometry and, unless deferred, the textures
+    double accel{0.0};          // BLAS (build and compaction, or restored from the cache) and TLAS
+    double textures{0.0};       // Deferred textures
+    bool   accelCached{false};  // The BLAS were restored from the cache
+  };
+  const LoadTimings& loadTimings() const { return m_loadTimings; }
+
+  // Texture streaming, on the main thread each frame
+  void updateTextureStreaming(Resources& resources);
+
   // Validation and state checks
   bool isValid() const { return (m_gltfScene != nullptr) && m_gltfScene->valid(); }
   bool hasDirtyFlag(int flag) const { return m_dirtyFlags.test(flag); }
@@ -84,10 +133,17 @@ public:
 
   // Frame processing
   void resetFrameCount();
+  bool isCameraReset() const { return m_cameraReset; }  // The accumulation restarted only because the camera moved
 
   nvh::Bbox getRenderNodeBbox(int node) const;
-
-  bool processFrame(VkCommandBuffer cmdBuf, Settings& settings);
+  // Render primitives deformed by the animation (sorted), their bounds are not the ones of the glTF
+  const std::vector<uint32_t>& getDeformedPrimitives() const { return m_deformedPrimitives; }
+  // Meshlets of the render primitives, valid with --meshlets and mesh shader support
+  const MeshletScene& getMeshletScene() const { return m_meshletScene; }
+  // SCENE_FEATURE_* used by the materials and the lights, the renderers recreate their pipelines when it changes
+  uint32_t getShaderFeatures() const { return m_shaderFeatures; }
+
+  bool processFrame(VkCommandBuffer cmdBuf, Resources& resources, Settings& settings);
   bool onUI(Resources& resources, Settings& settings, GLFWwindow* winHandle);
 
   // Scene manipulation
@@ -95,20 +151,24 @@ public:
   void fitObjectToView() const;
   void selectRenderNode(int renderNodeIndex);
   int  getSelectedRenderNode() const { return m_selectedRenderNode; }
+  void selectVariant(int variant);
 
   // File information
   std::string getFilename() const;
 
   // Utility
   void recreateTangents(bool mikktspace);
-  void generateHdrMipmap(VkCommandBuffer cmd, Resources& res);
+
+  // HDR environment: createHdr on any thread, swapped by updateStagedLoad (or load) once prepared
+  bool createHdr(Resources& resources, const std::string& filename);
+  // File chosen with the Load button of the UI, loaded by the application on its worker thread (once)
+  std::string takeRequestedHdr() { return std::exchange(m_requestedHdr, {}); }
 
 
   std::unique_ptr<nvh::gltf::Scene>        m_gltfScene{};     // The glTF scene
-  std::unique_ptr<nvvkhl::SceneRtx>        m_gltfSceneRtx{};  // The Vulkan scene with RTX acceleration structures
-  std::unique_ptr<nvvkhl::SceneVk>         m_gltfSceneVk{};   // The Vulkan scene
-  std::unique_ptr<nvvkhl::HdrEnv>          m_hdrEnv{};        // The HDR environment
-  std::unique_ptr<nvvkhl::HdrEnvDome>      m_hdrDome{};       // The HDR environment dome (raster)
+  std::unique_ptr<SceneRtxCached>          m_gltfSceneRtx{};  // The Vulkan scene with RTX acceleration structures
+  std::unique_ptr<SceneVkStreamed>         m_gltfSceneVk{};   // The Vulkan scene
+  std::unique_ptr<HdrEnvironment>          m_hdrEnv{};        // The HDR environment, and its dome (raster)
   std::unique_ptr<nvvkhl::PhysicalSkyDome> m_sky{};           // The sky dome
 
   VkDescriptorPool      m_descriptorPool{};  // Scene descriptor pool, frame info + scene buffer address + textures
@@ -120,8 +180,11 @@ public:
 
 private:
   // Scene creation
-  void createVulkanScene(Resources& resources);
-  void createHdr(Resources& resources, const std::string& filename);
+  bool parseScene(const std::string& filename);
+  bool createVulkanScene(Resources& resources, bool deferTextures);  // False: the scene does not fit in memory
+  void commitPendingScene(Resources& resources);
+  void createPlaceholderTextures(Resources& resources);
+  void commitPendingHdr(Resources& resources);
   void postSceneCreateProcess(Resources& resources, const std::string& filename);
 
   // Frame update
@@ -130,27 +193,117 @@ private:
   // Descriptor set management
   void createDescriptorPool(VkDevice device);
   void createDescriptorSet(VkDevice device);
+  bool allocateDescriptorSet(VkDevice device);
   void destroyDescriptorSet(VkDevice device);
-  void writeDescriptorSet(Resources& resources) const;
+  void writeDescriptorSet(Resources& resources);
+  void createSceneTextures(Resources& resources);
+  void commitSceneTextures(Resources& resources);
+
+  // Partial updates of the render nodes
+  void buildNodeRenderNodes();
+  void markNodeDirty(int nodeID);
+  bool affectsSkinning(int nodeID) const;
+  void findChangedRenderNodes();
+  bool uploadRenderNodes(std::vector<uint32_t>& renderNodeIDs);
+  void findChangedDeformations();
+  void updateShaderFeatures();
 
 
   std::bitset<32>              m_dirtyFlags;               // Flags to indicate what has changed
   AnimationControl             m_animControl;              // Animation control (UI)
   std::unique_ptr<GltfModelUI> m_sceneGraph;               // Scene graph (UI)
+  std::vector<std::pair<std::string, std::string>> m_statistics;  // Counts of the scene (UI)
   std::string                  m_hdrFilename;              // Keep track of HDR filename
   int                          m_selectedRenderNode = -1;  // Selected render node
+  bool                         m_cameraReset{false};       // The last reset of the frame count was a move of the camera
+
+  // Scene being loaded, swapped with the current one by commitPendingScene()
+  std::unique_ptr<nvh::gltf::Scene> m_pendingScene{};
+  std::unique_ptr<SceneVkStreamed>  m_pendingSceneVk{};
+  std::unique_ptr<SceneRtxCached>   m_pendingSceneRtx{};
+  std::string                       m_pendingFilename;
+  std::string                       m_filename;  // File of the current scene
+
+  // Environment being prepared, swapped with the current one by commitPendingHdr()
+  std::unique_ptr<HdrEnvironment> m_pendingHdrEnv{};
+  std::string                     m_pendingHdrFilename;
+  std::atomic<bool>               m_hdrLoading{false};  // createHdr is running
+  std::atomic<bool>               m_hdrReady{false};    // m_pendingHdrEnv can be swapped
+  std::string                     m_requestedHdr;       // See takeRequestedHdr()
+
+  // Memory of the pending scene, measured by createVulkanScene, accounted at the commit
+  std::array<VkDeviceSize, MemoryBudget::eNumCategories> m_pendingMemory{};
+  VkDeviceSize m_textureBudget{0};  // From the memory plan, for the TextureStreamer of the scene
+
+  enum PlaceholderTexture
+  {
+    ePlaceholderWhite,       // Base color, metallic-roughness, occlusion, ...
+    ePlaceholderBlack,       // Emissive
+    ePlaceholderFlatNormal,  // Normal maps
+    eNumPlaceholders
+  };
+  std::array<nvvk::Texture, eNumPlaceholders> m_placeholderTextures{};  // Bound until the textures are streamed
+
+  std::unique_ptr<TextureStreamer> m_textureStreamer{};  // When the textures are streamed under a budget, main thread only
+  std::unique_ptr<TextureStreamer> m_pendingTextureStreamer{};  // Created by the loader, taken by commitSceneTextures
+  nvvk::Buffer                     m_textureFeedbackBuffer;  // Resolution needed by each material, written by the shaders
+  uint32_t*                        m_textureFeedback{nullptr};  // Mapped feedback buffer
+
+  // Per-frame updates go through the upload ring, only the changed render nodes are copied
+  struct UploadedRenderNode
+  {
+    glm::mat4 worldMatrix{0.0F};
+    int       materialID{-1};
+    int       renderPrimID{-1};
+  };
+  UploadRing                         m_uploadRing;
+  std::vector<std::vector<uint32_t>> m_nodeRenderNodes;   // Render nodes of each glTF node
+  std::vector<uint32_t>              m_dirtyRenderNodes;  // To upload, with eVulkanRenderNodes
+  std::vector<UploadedRenderNode>    m_uploadedRenderNodes;  // Content of the GPU buffer, to find what changed
+  std::vector<bool>                  m_jointNodes;           // Per glTF node, used by a skin
+
+  // Refit of the BLAS of the deformed primitives, when their joints or morph weights changed
+  std::vector<uint32_t> m_deformedPrimitives;  // Sorted render primitive IDs
+  std::vector<uint64_t> m_deformationHashes;   // Per render primitive, zero if not deformed
+  std::vector<uint32_t> m_dirtyBlas;           // To refit, with eRtxScene
+
+  AnimationEvaluator m_animationEvaluator;  // Animated scenes: sampling and world matrices on all cores
+  GpuAnimation       m_gpuAnimation;        // With --gpuAnimation, deforms the vertices instead of SceneVk
+  CompactVertices    m_compactVertices;     // With --compactVertices, encodes the vertices of the rigid primitives
+  MeshletScene       m_meshletScene;        // With --meshlets, for the mesh shader raster
+  LightSampler       m_lightSampler;        // Alias table of the lights and emissive triangles, for the path tracer
+  uint32_t           m_shaderFeatures{SCENE_FEATURE_ALL};
+
+  enum LoadStage
+  {
+    eLoadIdle,           // Nothing is loading
+    eLoadParse,          // Loader: parsing the file
+    eLoadGeometry,       // Loader: uploading materials and geometry
+    eLoadAccel,          // Loader: building the acceleration structures
+    eLoadReady,          // Main: the pending scene is ready to be swapped
+    eLoadRetiring,       // Main: waiting for the frames in flight to release the previous scene
+    eLoadTextures,       // Loader: streaming the textures of the new scene
+    eLoadTexturesReady,  // Main: the textures are ready to be bound
+  };
+  std::atomic<int>   m_loadStage{eLoadIdle};
+  std::atomic<float> m_loadProgress{0.0F};
+  std::atomic<bool>  m_cancelLoad{false};  // Set by cancelStagedLoad, the loader does not wait for the swap
+  LoadTimings        m_loadTimings;  // Written by the loader, read once the load is done
 
 
 public:
   enum DirtyFlags
   {
     eNewScene,          // When a new scene is loaded, same for multiple scenes
-    eVulkanScene,       // When the Vulkan geometry buffers need to be updated
+    eVulkanScene,       // When the Vulkan geometry buffers need to be updated (animation, variants): all is checked
+    eVulkanRenderNodes,  // When only the render nodes in m_dirtyRenderNodes need to be updated
+    eVulkanLights,       // When only the lights need to be updated
     eVulkanMaterial,    // When the Vulkan material buffers need to be updated
     eVulkanAttributes,  // When the Vulkan attributes need to be updated
     eRtxScene,          // When the RTX acceleration structures need to be updated
     eHdrEnv,            // When the HDR environment needs to be updated
     eNodeVisibility,    // When the node visibility has changed
+    eSceneDescriptorSet,  // When m_sceneDescriptorSet was replaced, the recorded commands are invalid
 
     eNumDirtyFlags  // Keep last - Number of dirty flags
   };
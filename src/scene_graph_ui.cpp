@@ -17,6 +17,9 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <algorithm>
+#include <cctype>
+
 #include <glm/glm.hpp>
 #include <imgui/imgui_icon.h>
 
@@ -44,8 +47,8 @@ static ImGuiTreeNodeFlags s_treeNodeFlags = ImGuiTreeNodeFlags_SpanAllColumns |
 
 //--------------------------------------------------------------------------------------------------
 // Entry point for rendering the scene graph
-// Loop over all scenes
-// - Loop over all nodes in the scene
+// - The search field, and the matching nodes while searching
+// - Otherwise the visible rows of the scene graph
 //Following, in the second part, is the details:
 // - Display the node details (transform)
 //   OR Display the material details
@@ -55,16 +58,113 @@ void GltfModelUI::render()
   const float TEXT_BASE_WIDTH  = ImGui::CalcTextSize("A").x;
   int         childWindowFlags = ImGuiChildFlags_ResizeY | ImGuiChildFlags_FrameStyle;
 
-  renderSceneGraph(TEXT_BASE_WIDTH, childWindowFlags);
+  ImGui::SetNextItemWidth(-FLT_MIN);
+  if(ImGui::InputTextWithHint("##Search", "Search nodes, meshes, lights, cameras", m_searchText, sizeof(m_searchText)))
+    updateSearch();
+
+  if(m_searchText[0] != '\0')
+    renderSearchResults();
+  else
+    renderSceneGraph(TEXT_BASE_WIDTH, childWindowFlags);
   ImGui::Separator();
   renderDetails(childWindowFlags);
 }
 
+//--------------------------------------------------------------------------------------------------
+// Flattening the hierarchy of the scenes, without recursion: the chains of nodes can be deep
+//
+void GltfModelUI::buildRows()
+{
+  m_rows.clear();
+  m_nodeRows.assign(m_model.nodes.size(), -1);
+
+  auto addRow = [&](RowType type, int index, int depth, int parent) {
+    m_rows.push_back({.type = type, .index = index, .depth = depth, .parent = parent});
+    m_rows.back().end = static_cast<int>(m_rows.size());
+    return static_cast<int>(m_rows.size()) - 1;
+  };
+  // The node, with its mesh, light and camera; the children are added by the caller
+  auto addNode = [&](int nodeIndex, int depth, int parent) {
+    const int             row  = addRow(eRowNode, nodeIndex, depth, parent);
+    const tinygltf::Node& node = m_model.nodes[nodeIndex];
+    if(m_nodeRows[nodeIndex] < 0)
+      m_nodeRows[nodeIndex] = row;
+    if(node.mesh >= 0)
+    {
+      const int meshRow = addRow(eRowMesh, node.mesh, depth + 1, row);
+      const int count   = static_cast<int>(m_model.meshes[node.mesh].primitives.size());
+      for(int primID = 0; primID < count; primID++)
+      {
+        const int primRow        = addRow(eRowPrimitive, primID, depth + 2, meshRow);
+        m_rows[primRow].material = m_model.meshes[node.mesh].primitives[primID].material;
+      }
+      m_rows[meshRow].end = static_cast<int>(m_rows.size());
+    }
+    if(node.light >= 0)
+      addRow(eRowLight, node.light, depth + 1, row);
+    if(node.camera >= 0)
+      addRow(eRowCamera, node.camera, depth + 1, row);
+    return row;
+  };
+
+  struct Frame
+  {
+    int    row;
+    size_t child;
+  };
+  std::vector<Frame> stack;
+  for(size_t sceneID = 0; sceneID < m_model.scenes.size(); sceneID++)
+  {
+    const int sceneRow = addRow(eRowScene, static_cast<int>(sceneID), 0, -1);
+    for(int root : m_model.scenes[sceneID].nodes)
+    {
+      stack.push_back({addNode(root, 1, sceneRow), 0});
+      while(!stack.empty())
+      {
+        const Frame           frame = stack.back();
+        const tinygltf::Node& node  = m_model.nodes[m_rows[frame.row].index];
+        if(frame.child < node.children.size())
+        {
+          stack.back().child++;
+          stack.push_back({addNode(node.children[frame.child], m_rows[frame.row].depth + 1, frame.row), 0});
+        }
+        else
+        {
+          m_rows[frame.row].end = static_cast<int>(m_rows.size());
+          stack.pop_back();
+        }
+      }
+    }
+    m_rows[sceneRow].end = static_cast<int>(m_rows.size());
+  }
+
+  // The scenes are always open
+  m_rowOpen.assign(m_rows.size(), false);
+  for(size_t i = 0; i < m_rows.size(); i++)
+    m_rowOpen[i] = (m_rows[i].type == eRowScene);
+  m_visibleDirty = true;
+}
+
+// The rows whose parents are all open, skipping the subtrees of the closed rows
+void GltfModelUI::updateVisibleRows()
+{
+  m_visibleRows.clear();
+  for(int row = 0; row < static_cast<int>(m_rows.size());)
+  {
+    m_visibleRows.push_back(row);
+    row = m_rowOpen[row] ? row + 1 : m_rows[row].end;
+  }
+  m_visibleDirty = false;
+}
+
 void GltfModelUI::renderSceneGraph(float textBaseWidth, int childWindowFlags)
 {
   static ImGuiTableFlags s_tableFlags =
       ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV;
 
+  if(m_visibleDirty)
+    updateVisibleRows();
+
   if(ImGui::BeginChild("SceneGraph", ImVec2(-FLT_MIN, 300.f), childWindowFlags))
   {
     if(ImGui::BeginTable("SceneGraphTable", 3, s_tableFlags))
@@ -75,24 +175,25 @@ void GltfModelUI::renderSceneGraph(float textBaseWidth, int childWindowFlags)
       ImGui::TableSetupColumn("-", ImGuiTableColumnFlags_NoHide | ImGuiTableColumnFlags_WidthFixed, textBaseWidth * 1.0f);
       ImGui::TableHeadersRow();
 
-      for(size_t sceneID = 0; sceneID < m_model.scenes.size(); sceneID++)
+      // Position of the selected node in the visible rows, drawn even when off screen to scroll to it
+      int scrollTo = -1;
+      if(m_doScroll && (m_selectType == eNode) && (m_selectedIndex >= 0))
       {
-        tinygltf::Scene& scene = m_model.scenes[sceneID];
-        ImGui::SetNextItemOpen(true);  // Scene is always open
-        ImGui::PushID(static_cast<int>(sceneID));
-        ImGui::TableNextRow();
-        ImGui::TableNextColumn();
-        if(ImGui::TreeNodeEx("Scene", s_treeNodeFlags, "%s", scene.name.c_str()))
-        {
-          ImGui::TableNextColumn();
-          ImGui::Text("Scene %ld", sceneID);
-          for(int node : scene.nodes)
-          {
-            renderNode(node);
-          }
-          ImGui::TreePop();
-        }
-        ImGui::PopID();
+        const int  selectedRow = m_nodeRows[m_selectedIndex];
+        const auto it          = std::lower_bound(m_visibleRows.begin(), m_visibleRows.end(), selectedRow);
+        if(it != m_visibleRows.end() && *it == selectedRow)
+          scrollTo = static_cast<int>(it - m_visibleRows.begin());
+      }
+      m_doScroll = false;
+
+      ImGuiListClipper clipper;
+      clipper.Begin(static_cast<int>(m_visibleRows.size()));
+      if(scrollTo >= 0)
+        clipper.IncludeItemByIndex(scrollTo);
+      while(clipper.Step())
+      {
+        for(int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+          renderRow(m_visibleRows[i], i == scrollTo);
       }
 
       ImGui::EndTable();
@@ -101,6 +202,76 @@ void GltfModelUI::renderSceneGraph(float textBaseWidth, int childWindowFlags)
   ImGui::EndChild();
 }
 
+// The name is indented by the depth, the indentation only applies to the first column
+void GltfModelUI::renderRow(int rowIndex, bool scrollTo)
+{
+  const Row& row = m_rows[rowIndex];
+  ImGui::TableNextRow();
+  ImGui::TableNextColumn();
+  ImGui::PushID(rowIndex);
+  const float indent = row.depth * ImGui::GetStyle().IndentSpacing;
+  if(indent > 0.0f)
+    ImGui::Indent(indent);
+  switch(row.type)
+  {
+    case eRowScene:
+      ImGui::SetNextItemOpen(true);  // Scene is always open
+      ImGui::TreeNodeEx("Scene", s_treeNodeFlags | ImGuiTreeNodeFlags_NoTreePushOnOpen, "%s",
+                        m_model.scenes[row.index].name.c_str());
+      break;
+    case eRowNode:
+      renderNode(rowIndex, scrollTo);
+      break;
+    case eRowMesh:
+      renderMesh(rowIndex);
+      break;
+    case eRowPrimitive:
+      renderPrimitive(rowIndex);
+      break;
+    case eRowLight:
+      renderLight(row.index);
+      break;
+    case eRowCamera:
+      renderCamera(row.index);
+      break;
+  }
+  if(indent > 0.0f)
+    ImGui::Unindent(indent);
+
+  ImGui::TableNextColumn();
+  switch(row.type)
+  {
+    case eRowScene:
+      ImGui::Text("Scene %d", row.index);
+      break;
+    case eRowNode:
+      ImGui::Text("Node %d", row.index);
+      break;
+    case eRowMesh:
+      ImGui::Text("Mesh %d", row.index);
+      break;
+    case eRowPrimitive:
+      ImGui::Text("Primitive");
+      break;
+    case eRowLight:
+      ImGui::Text("Light %d", row.index);
+      break;
+    case eRowCamera:
+      ImGui::Text("Camera %d", row.index);
+      break;
+  }
+
+  // Mark the nodes that aren't visible
+  ImGui::TableNextColumn();
+  if(row.type == eRowNode && !tinygltf::utils::getNodeVisibility(m_model.nodes[row.index]).visible)
+  {
+    ImGui::PushFont(ImGuiH::getIconicFont());
+    ImGui::Text("%s", ImGuiH::icon_ban);
+    ImGui::PopFont();
+  }
+  ImGui::PopID();
+}
+
 void GltfModelUI::renderDetails(int childWindowFlags)
 {
   if(ImGui::BeginChild("Details", ImVec2(-FLT_MIN, 200), childWindowFlags) && (m_selectedIndex > -1))
@@ -131,157 +302,208 @@ void GltfModelUI::selectNode(int nodeIndex)
 {
   m_selectType    = eNode;
   m_selectedIndex = nodeIndex;
-  m_openNodes.clear();
   if(nodeIndex >= 0)
-    preprocessOpenNodes();
+    openParents(nodeIndex);
   m_doScroll = true;
 }
 
+// The parents of the first row of the node: O(depth)
+void GltfModelUI::openParents(int nodeIndex)
+{
+  if(nodeIndex >= static_cast<int>(m_nodeRows.size()) || m_nodeRows[nodeIndex] < 0)
+    return;
+  for(int row = m_rows[m_nodeRows[nodeIndex]].parent; row >= 0; row = m_rows[row].parent)
+  {
+    if(!m_rowOpen[row])
+    {
+      m_rowOpen[row] = true;
+      m_visibleDirty = true;
+    }
+  }
+}
+
 //--------------------------------------------------------------------------------------------------
-// This is rendering the node and its children
-// If it has the command to open the node, it will open it,
-// when it finds the selected node, it will highlight it and will scroll to it. (done once)
+// Rendering the row of a node
+// An opened or closed node changes the visible rows, for the next frame.
+// When it is the selected node, it will highlight it and will scroll to it. (done once)
 //
-void GltfModelUI::renderNode(int nodeIndex)
+void GltfModelUI::renderNode(int rowIndex, bool scrollTo)
 {
-  ImGui::TableNextRow();
-  ImGui::TableNextColumn();
-  const tinygltf::Node& node = m_model.nodes[nodeIndex];
+  const int             nodeIndex = m_rows[rowIndex].index;
+  const tinygltf::Node& node      = m_model.nodes[nodeIndex];
 
-  ImGuiTreeNodeFlags flags = s_treeNodeFlags;
-
-  // Ensure the selected node is visible
-  if(m_openNodes.find(nodeIndex) != m_openNodes.end())
-  {
-    ImGui::SetNextItemOpen(true);
-  }
+  ImGuiTreeNodeFlags flags = s_treeNodeFlags | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+  if(m_rows[rowIndex].end == rowIndex + 1)
+    flags |= ImGuiTreeNodeFlags_Leaf;
 
   // Highlight the selected node
   if((m_selectType == eNode) && (m_selectedIndex == nodeIndex))
   {
     flags |= ImGuiTreeNodeFlags_Selected;
-    if(m_doScroll)
-    {
+    if(scrollTo)
       ImGui::SetScrollHereY();
-      m_doScroll = false;
-    }
   }
 
-  // Append "(invisible)" to the name if the node isn't visible
-  KHR_node_visibility visibility = tinygltf::utils::getNodeVisibility(node);
-
   // Handle node selection
-  bool nodeOpen = ImGui::TreeNodeEx((void*)(intptr_t)nodeIndex, flags, "%s", node.name.c_str());
+  ImGui::SetNextItemOpen(m_rowOpen[rowIndex]);
+  const bool nodeOpen = ImGui::TreeNodeEx((void*)(intptr_t)nodeIndex, flags, "%s", node.name.c_str());
+  if(nodeOpen != m_rowOpen[rowIndex])
+  {
+    m_rowOpen[rowIndex] = nodeOpen;
+    m_visibleDirty      = true;
+  }
 
   if(ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen())
   {
     m_selectedIndex = ((m_selectType == eNode) && (m_selectedIndex == nodeIndex)) ? -1 : nodeIndex;
     m_selectType    = eNode;
   }
-
-  ImGui::TableNextColumn();
-  ImGui::Text("Node %d", nodeIndex);
-
-  if(!visibility.visible)
-  {
-    ImGui::TableNextColumn();
-    ImGui::PushFont(ImGuiH::getIconicFont());
-    ImGui::Text("%s", ImGuiH::icon_ban);
-    ImGui::PopFont();
-  }
-  else
-  {
-    ImGui::TableNextColumn();
-  }
-
-  // Render the mesh, children, light, and camera if the node is open
-  if(nodeOpen)
-  {
-    if(node.mesh >= 0)
-    {
-      renderMesh(node.mesh);
-    }
-
-    if(node.light >= 0)
-    {
-      renderLight(node.light);
-    }
-
-    if(node.camera >= 0)
-    {
-      renderCamera(node.camera);
-    }
-
-    for(int child : node.children)
-    {
-      renderNode(child);
-    }
-
-    ImGui::TreePop();
-  }
 }
 
-void GltfModelUI::renderMesh(int meshIndex)
+void GltfModelUI::renderMesh(int rowIndex)
 {
-  const tinygltf::Mesh& mesh = m_model.meshes[meshIndex];
-  ImGui::TableNextRow();
-  ImGui::TableNextColumn();
-  bool meshOpen = ImGui::TreeNodeEx("Mesh", s_treeNodeFlags, "%s", mesh.name.c_str());
-  ImGui::TableNextColumn();
-  ImGui::Text("Mesh %d", meshIndex);
-  ImGui::TableNextColumn();
-
-  if(meshOpen)
+  const int             meshIndex = m_rows[rowIndex].index;
+  const tinygltf::Mesh& mesh      = m_model.meshes[meshIndex];
+  ImGui::SetNextItemOpen(m_rowOpen[rowIndex]);
+  const bool meshOpen = ImGui::TreeNodeEx("Mesh", s_treeNodeFlags | ImGuiTreeNodeFlags_NoTreePushOnOpen, "%s", mesh.name.c_str());
+  if(meshOpen != m_rowOpen[rowIndex])
   {
-    int primID{};
-    for(const auto& primitive : mesh.primitives)
-    {
-      renderPrimitive(primitive, primID++);
-    }
-    ImGui::TreePop();
+    m_rowOpen[rowIndex] = meshOpen;
+    m_visibleDirty      = true;
   }
 }
 
-void GltfModelUI::renderPrimitive(const tinygltf::Primitive& primitive, int primID)
+void GltfModelUI::renderPrimitive(int rowIndex)
 {
-  ImGui::TableNextRow();
-  ImGui::TableNextColumn();
-  const int         materialID = std::clamp(primitive.material, 0, static_cast<int>(m_model.materials.size() - 1));
-  const std::string primName   = "Prim " + std::to_string(primID);
+  const int         materialID = std::clamp(m_rows[rowIndex].material, 0, static_cast<int>(m_model.materials.size() - 1));
+  const std::string primName   = "Prim " + std::to_string(m_rows[rowIndex].index);
   if(ImGui::Selectable(primName.c_str(), (m_selectedIndex == materialID) && (m_selectType == eMaterial)))
   {
     m_selectType    = eMaterial;
     m_selectedIndex = materialID;
   }
-  ImGui::TableNextColumn();
-  ImGui::Text("Primitive");
-  ImGui::TableNextColumn();
 }
 
 void GltfModelUI::renderLight(int lightIndex)
 {
   const tinygltf::Light& light = m_model.lights[lightIndex];
-  ImGui::TableNextRow();
-  ImGui::TableNextColumn();
   if(ImGui::Selectable(light.name.c_str(), (m_selectedIndex == lightIndex) && (m_selectType == eLight)))
   {
     m_selectType    = eLight;
     m_selectedIndex = lightIndex;
   }
-  ImGui::TableNextColumn();
-  ImGui::Text("Light %d", lightIndex);
-  ImGui::TableNextColumn();
 }
 
 void GltfModelUI::renderCamera(int cameraIndex)
 {
   const tinygltf::Camera& camera = m_model.cameras[cameraIndex];
-  ImGui::TableNextRow();
-  ImGui::TableNextColumn();
   ImGui::Text("%s", camera.name.c_str());
-  ImGui::TableNextColumn();
-  ImGui::Text("Camera %d", cameraIndex);
-  ImGui::TableNextColumn();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Search of the nodes by their name and the names of their mesh, light and camera, case
+// insensitive, when the text changes
+// - The names starting with the text, from the sorted index
+// - Then the names containing it
+//
+static std::string toLower(std::string text)
+{
+  std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return text;
+}
+
+void GltfModelUI::updateSearch()
+{
+  constexpr size_t kMaxSearchResults = 1000;
+
+  if(m_searchIndex.empty())
+  {
+    auto add = [&](const std::string& name, int node, RowType type) {
+      if(!name.empty())
+        m_searchIndex.push_back({toLower(name), node, type});
+    };
+    m_searchIndex.reserve(m_model.nodes.size());
+    for(size_t i = 0; i < m_model.nodes.size(); i++)
+    {
+      const tinygltf::Node& node   = m_model.nodes[i];
+      const int             nodeID = static_cast<int>(i);
+      add(node.name, nodeID, eRowNode);
+      if(node.mesh >= 0 && node.mesh < static_cast<int>(m_model.meshes.size()))
+        add(m_model.meshes[node.mesh].name, nodeID, eRowMesh);
+      if(node.light >= 0 && node.light < static_cast<int>(m_model.lights.size()))
+        add(m_model.lights[node.light].name, nodeID, eRowLight);
+      if(node.camera >= 0 && node.camera < static_cast<int>(m_model.cameras.size()))
+        add(m_model.cameras[node.camera].name, nodeID, eRowCamera);
+    }
+    std::sort(m_searchIndex.begin(), m_searchIndex.end());
+  }
+
+  m_searchResults.clear();
+  const std::string text = toLower(m_searchText);
+  if(text.empty())
+    return;
+
+  auto it = std::lower_bound(m_searchIndex.begin(), m_searchIndex.end(), SearchEntry{text, -1, eRowScene});
+  for(; it != m_searchIndex.end() && it->name.compare(0, text.size(), text) == 0; ++it)
+  {
+    if(m_searchResults.size() == kMaxSearchResults)
+      return;
+    m_searchResults.push_back(static_cast<size_t>(it - m_searchIndex.begin()));
+  }
+  for(size_t i = 0; i < m_searchIndex.size(); i++)
+  {
+    if(m_searchResults.size() == kMaxSearchResults)
+      return;
+    const size_t pos = m_searchIndex[i].name.find(text);
+    if(pos != std::string::npos && pos > 0)
+      m_searchResults.push_back(i);
+  }
+}
+
+void GltfModelUI::renderSearchResults()
+{
+  if(ImGui::BeginChild("SearchResults", ImVec2(-FLT_MIN, 300.f), ImGuiChildFlags_ResizeY | ImGuiChildFlags_FrameStyle))
+  {
+    if(m_searchResults.empty())
+      ImGui::TextDisabled("Nothing found");
+
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(m_searchResults.size()));
+    while(clipper.Step())
+    {
+      for(int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+      {
+        const SearchEntry&    entry     = m_searchIndex[m_searchResults[i]];
+        const int             nodeIndex = entry.node;
+        const tinygltf::Node& node      = m_model.nodes[nodeIndex];
+        std::string           label;
+        switch(entry.type)
+        {
+          case eRowMesh:
+            label = m_model.meshes[node.mesh].name + "  (Mesh of Node " + std::to_string(nodeIndex) + ")";
+            break;
+          case eRowLight:
+            label = m_model.lights[node.light].name + "  (Light of Node " + std::to_string(nodeIndex) + ")";
+            break;
+          case eRowCamera:
+            label = m_model.cameras[node.camera].name + "  (Camera of Node " + std::to_string(nodeIndex) + ")";
+            break;
+          default:
+            label = node.name + "  (Node " + std::to_string(nodeIndex) + ")";
+            break;
+        }
+        ImGui::PushID(i);
+        if(ImGui::Selectable(label.c_str(), (m_selectType == eNode) && (m_selectedIndex == nodeIndex)))
+        {
+          // Back to the scene graph, at the node
+          selectNode(nodeIndex);
+          m_searchText[0] = '\0';
+        }
+        ImGui::PopID();
+      }
+    }
+  }
+  ImGui::EndChild();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -291,8 +513,6 @@ void GltfModelUI::renderCamera(int cameraIndex)
 void GltfModelUI::renderNodeDetails(int nodeIndex)
 {
   tinygltf::Node&     node = m_model.nodes[nodeIndex];
-  glm::vec3           translation, scale;
-  glm::quat           rotation;
   KHR_node_visibility visibility;
 
   bool hasVisibility = tinygltf::utils::hasElementName(node.extensions, KHR_NODE_VISIBILITY_EXTENSION_NAME);
@@ -301,26 +521,43 @@ void GltfModelUI::renderNodeDetails(int nodeIndex)
     visibility = tinygltf::utils::getNodeVisibility(node);
   }
 
-  getNodeTransform(node, translation, rotation, scale);
+  // Decomposed again only for another node, or when the animation changed it
+  NodeDetails& details = m_nodeDetails;
+  if(details.node != nodeIndex || details.srcTranslation != node.translation || details.srcRotation != node.rotation
+     || details.srcScale != node.scale || details.srcMatrix != node.matrix)
+  {
+    glm::quat rotation;
+    getNodeTransform(node, details.translation, rotation, details.scale);
+    details.euler          = glm::degrees(glm::eulerAngles(rotation));
+    details.node           = nodeIndex;
+    details.srcTranslation = node.translation;
+    details.srcRotation    = node.rotation;
+    details.srcScale       = node.scale;
+    details.srcMatrix      = node.matrix;
+  }
 
   ImGui::Text("Node: %s", node.name.c_str());
 
-  glm::vec3 euler = glm::degrees(glm::eulerAngles(rotation));
-
   PE::begin();
   {
     bool modif = false;
-    modif |= PE::DragFloat3("Translation", glm::value_ptr(translation), 0.01f * m_bbox.radius());
-    modif |= PE::DragFloat3("Rotation", glm::value_ptr(euler), 0.1f);
-    modif |= PE::DragFloat3("Scale", glm::value_ptr(scale), 0.01f);
+    modif |= PE::DragFloat3("Translation", glm::value_ptr(details.translation), 0.01f * m_bbox.radius());
+    modif |= PE::DragFloat3("Rotation", glm::value_ptr(details.euler), 0.1f);
+    modif |= PE::DragFloat3("Scale", glm::value_ptr(details.scale), 0.01f);
     if(modif)
     {
       m_changes.set(eNodeTransformDirty);
-      node.translation = {translation.x, translation.y, translation.z};
-      rotation         = glm::quat(glm::radians(euler));
-      node.rotation    = {rotation.x, rotation.y, rotation.z, rotation.w};
-      node.scale       = {scale.x, scale.y, scale.z};
+      m_changedNodes.push_back(nodeIndex);
+      const glm::quat rotation = glm::quat(glm::radians(details.euler));
+      node.translation         = {details.translation.x, details.translation.y, details.translation.z};
+      node.rotation            = {rotation.x, rotation.y, rotation.z, rotation.w};
+      node.scale               = {details.scale.x, details.scale.y, details.scale.z};
       node.matrix.clear();  // Clear the matrix, has its been converted to translation, rotation and scale
+      // The edited values are kept, the angles are not normalized by a new decomposition
+      details.srcTranslation = node.translation;
+      details.srcRotation    = node.rotation;
+      details.srcScale       = node.scale;
+      details.srcMatrix      = node.matrix;
     }
     if(hasVisibility)
     {
@@ -328,6 +565,7 @@ void GltfModelUI::renderNodeDetails(int nodeIndex)
       {
         tinygltf::utils::setNodeVisibility(node, visibility);
         m_changes.set(eNodeVisibleDirty);
+        m_changedNodes.push_back(nodeIndex);
       }
     }
     else if(ImGui::SmallButton("Add Visibility"))
@@ -830,44 +1068,6 @@ void GltfModelUI::materialEmissiveStrength(tinygltf::Material& material)
   }
 }
 
-// This function is called when a node is selected
-// It will open all the parents of the selected node
-void GltfModelUI::preprocessOpenNodes()
-{
-  m_openNodes.clear();
-  if((m_selectedIndex < 0) || (m_selectType != eNode))
-  {
-    return;
-  }
-  for(int rootIndex : m_model.scenes[0].nodes)  // Assuming sceneNodes contains root node indices
-  {
-    if(markOpenNodes(rootIndex, m_selectedIndex, m_openNodes))
-    {
-      break;
-    }
-  }
-}
-
-// Recursive function to mark all the nodes that are in the path to the target node
-bool GltfModelUI::markOpenNodes(int nodeIndex, int targetNodeIndex, std::unordered_set<int>& openNodes)
-{
-  if(nodeIndex == targetNodeIndex)
-  {
-    return true;
-  }
-
-  const tinygltf::Node& node = m_model.nodes[nodeIndex];
-  for(int child : node.children)
-  {
-    if(markOpenNodes(child, targetNodeIndex, openNodes))
-    {
-      openNodes.insert(nodeIndex);  // Mark the current node as open if any child path leads to the target
-      return true;
-    }
-  }
-  return false;
-}
-
 void GltfModelUI::renderLightDetails(int lightIndex)
 {
   tinygltf::Light& light = m_model.lights[lightIndex];
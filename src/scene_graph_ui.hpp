@@ -24,13 +24,20 @@
 This is the ImGui UI for the glTF model.
 It is used to render the scene graph and the details of the selected node, such as the transform and the materials.
 
+The hierarchy is flattened once in rows, in depth-first order, each row knowing its parent and the end of
+its subtree. Only the rows under open ones are listed, again only when a row is opened or closed, and the
+table draws the part on screen with ImGuiListClipper. Selecting a node opens its parents in O(depth).
+The search looks up the names in a sorted index, built at the first search. The details of a node are
+decomposed again only when the selection or the node changes.
+
 */
 
 
+#include <cstdint>
 #include <string>
+#include <tuple>
 #include <vector>
 #include <bitset>
-#include <unordered_set>
 
 #include <imgui.h>
 #include <tiny_gltf.h>
@@ -47,6 +54,7 @@ public:
       : m_model(model)
       , m_bbox(bbox)
   {
+    buildRows();
   }
 
   void render();
@@ -55,18 +63,29 @@ public:
   bool hasLightChanged() { return m_changes.test(eLightDirty); }
   bool hasVisibilityChanged() { return m_changes.test(eNodeVisibleDirty); }
   bool hasMaterialFlagChanges() { return m_changes.test(eMaterialFlagDirty); }
-  void resetChanges() { m_changes.reset(); }
+  void resetChanges()
+  {
+    m_changes.reset();
+    m_changedNodes.clear();
+  }
+  // Nodes whose transform or visibility changed, their children are affected too
+  const std::vector<int>& changedNodes() const { return m_changedNodes; }
   void renderDetails(int childWindowFlags);
   void selectNode(int nodeIndex);
   int  selectedNode() const { return (m_selectType == eNode) ? m_selectedIndex : -1; }
   int  selectedMaterial() const { return (m_selectType == eMaterial) ? m_selectedIndex : -1; }
 
 private:
-  void renderNode(int nodeIndex);
-  void renderMesh(int meshIndex);
-  void renderPrimitive(const tinygltf::Primitive& primitive, int primID);
+  void buildRows();
+  void updateVisibleRows();
+  void renderRow(int rowIndex, bool scrollTo);
+  void renderNode(int rowIndex, bool scrollTo);
+  void renderMesh(int rowIndex);
+  void renderPrimitive(int rowIndex);
   void renderLight(int lightIndex);
   void renderCamera(int cameraIndex);
+  void updateSearch();
+  void renderSearchResults();
   void renderMaterial(int materialIndex);
 
   void materialAnisotropy(tinygltf::Material& material);
@@ -85,11 +104,58 @@ private:
   void renderLightDetails(int lightIndex);
 
   void getNodeTransform(const tinygltf::Node& node, glm::vec3& translation, glm::quat& rotation, glm::vec3& scale);
-  void preprocessOpenNodes();
-  bool markOpenNodes(int nodeIndex, int targetNodeIndex, std::unordered_set<int>& openNodes);
+  void openParents(int nodeIndex);
   void renderSceneGraph(float textBaseWidth, int childWindowFlags);
 
-  std::unordered_set<int> m_openNodes;  // To keep track of nodes that should be open
+  // One row of the flattened scene graph
+  enum RowType : uint8_t
+  {
+    eRowScene,
+    eRowNode,
+    eRowMesh,
+    eRowPrimitive,  // 'index' is the primitive in the mesh, 'material' its material
+    eRowLight,
+    eRowCamera,
+  };
+  struct Row
+  {
+    RowType type{eRowNode};
+    int     index{-1};   // Of the scene, node, mesh, primitive, light or camera
+    int     depth{0};    // Indentation
+    int     parent{-1};  // Row
+    int     end{0};      // Row after the subtree
+    int     material{-1};
+  };
+  std::vector<Row>  m_rows;
+  std::vector<bool> m_rowOpen;
+  std::vector<int>  m_nodeRows;     // First row of each node
+  std::vector<int>  m_visibleRows;  // Rows under open rows, sorted
+  bool              m_visibleDirty = true;
+
+  // Search by name: the lowercase names of the nodes, and of the meshes, lights and cameras of the
+  // nodes, sorted by name. The results are indices in the index.
+  struct SearchEntry
+  {
+    std::string name;
+    int         node{-1};
+    RowType     type{eRowNode};  // What is named: the node, or its mesh, light or camera
+
+    bool operator<(const SearchEntry& other) const { return std::tie(name, node, type) < std::tie(other.name, other.node, other.type); }
+  };
+  std::vector<SearchEntry> m_searchIndex;
+  std::vector<size_t>      m_searchResults;
+  char                     m_searchText[128]{};
+
+  // Transform of the selected node, decomposed when the selection or the node changed
+  struct NodeDetails
+  {
+    int                 node{-1};
+    std::vector<double> srcTranslation, srcRotation, srcScale, srcMatrix;
+    glm::vec3           translation{0.0f};
+    glm::vec3           euler{0.0f};
+    glm::vec3           scale{1.0f};
+  };
+  NodeDetails m_nodeDetails;
 
   tinygltf::Model& m_model;
   enum SelectType
@@ -98,10 +164,11 @@ private:
     eMaterial,
     eLight
   };
-  SelectType      m_selectType    = eNode;
-  int             m_selectedIndex = -1;
-  std::bitset<32> m_changes;
-  nvh::Bbox       m_bbox;
+  SelectType       m_selectType    = eNode;
+  int              m_selectedIndex = -1;
+  std::bitset<32>  m_changes;
+  std::vector<int> m_changedNodes;
+  nvh::Bbox        m_bbox;
 
   enum DirtyFlags
   {
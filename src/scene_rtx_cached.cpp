@@ -0,0 +1,583 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "scene_rtx_cached.hpp"
+
+#include "nvh/nvprint.hpp"
+#include "nvh/timesampler.hpp"
+#include "nvvk/buffers_vk.hpp"
+#include "nvvk/error_vk.hpp"
+
+// Local to application
+#include "cache_utils.hpp"
+
+constexpr uint64_t     BLAS_CACHE_MAGIC     = 0x534c424652544c47ULL;  // "GLTRFBLS"
+constexpr uint32_t     BLAS_CACHE_VERSION   = 2;
+constexpr VkDeviceSize SERIALIZED_ALIGNMENT = 256;  // Required alignment of the serialization addresses
+
+// Header of the serialized acceleration structure, as defined by the Vulkan specification
+struct SerializedAccelHeader
+{
+  uint8_t  driverUUID[VK_UUID_SIZE];
+  uint8_t  compatibilityUUID[VK_UUID_SIZE];
+  uint64_t serializedSize;
+  uint64_t deserializedSize;
+  uint64_t numHandles;
+};
+
+// Followed by one uint32_t per BLAS: 1 when it is serialized in the file, 0 when it references micromaps
+struct BlasCacheHeader
+{
+  uint64_t magic   = BLAS_CACHE_MAGIC;
+  uint32_t version = BLAS_CACHE_VERSION;
+  uint32_t numBlas = 0;
+};
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Hash everything the BLAS are made of: the positions and indices of each render primitive,
+// in order, and the opacity of their material
+//
+static bool hashAccessorData(gltfr::Hasher& hasher, const tinygltf::Model& model, int accessorID)
+{
+  if(accessorID < 0)
+    return true;
+  const tinygltf::Accessor& accessor = model.accessors[accessorID];
+  if(accessor.sparse.isSparse || accessor.bufferView < 0)
+    return false;  // Not supported by the cache
+
+  const tinygltf::BufferView& view     = model.bufferViews[accessor.bufferView];
+  const tinygltf::Buffer&     buffer   = model.buffers[view.buffer];
+  const size_t                elemSize = tinygltf::GetComponentSizeInBytes(accessor.componentType)
+                          * tinygltf::GetNumComponentsInType(accessor.type);
+  const size_t stride = view.byteStride > 0 ? view.byteStride : elemSize;
+  const size_t offset = view.byteOffset + accessor.byteOffset;
+  const size_t length = accessor.count > 0 ? (accessor.count - 1) * stride + elemSize : 0;
+  if(offset + length > buffer.data.size())
+    return false;
+
+  hasher.add(accessor.componentType).add(accessor.type).add(accessor.count).add(stride);
+  hasher.add(buffer.data.data() + offset, length);
+  return true;
+}
+
+std::filesystem::path gltfr::SceneRtxCached::getBlasCachePath(const nvh::gltf::Scene&              scene,
+                                                              VkBuildAccelerationStructureFlagsKHR flags,
+                                                              VkPhysicalDevice                     physicalDevice)
+{
+  nvh::ScopedTimer st(__FUNCTION__);
+
+  const tinygltf::Model& model = scene.getModel();
+
+  Hasher hasher;
+  hasher.add(BLAS_CACHE_VERSION).add(flags).addDevice(physicalDevice);
+  hasher.add(scene.getRenderPrimitives().size());
+  for(const nvh::gltf::RenderPrimitive& renderPrim : scene.getRenderPrimitives())
+  {
+    const tinygltf::Primitive& primitive = *renderPrim.pPrimitive;
+    const auto                 position  = primitive.attributes.find("POSITION");
+    if(position == primitive.attributes.end() || !hashAccessorData(hasher, model, position->second)
+       || !hashAccessorData(hasher, model, primitive.indices))
+    {
+      return {};
+    }
+    hasher.add(primitive.mode);
+    if(primitive.material >= 0 && primitive.material < static_cast<int>(model.materials.size()))
+    {
+      hasher.add(model.materials[primitive.material].alphaMode);
+    }
+  }
+
+  return getCacheDirectory() / (hasher.toString() + ".blas");
+}
+
+//--------------------------------------------------------------------------------------------------
+// Deserialize the BLAS from the cache file
+// - The file is uploaded in a host visible buffer and each BLAS is deserialized from it
+// - The BLAS referencing micromaps are built in the same command buffer
+//
+bool gltfr::SceneRtxCached::restoreBlas(nvvk::CommandPool& cmdPool, const std::filesystem::path& path, size_t numBlas)
+{
+  if(path.empty())
+    return false;
+
+  std::vector<char> data;
+  if(!readCacheFile(path, data))
+    return false;
+
+  nvh::ScopedTimer st(__FUNCTION__);
+
+  BlasCacheHeader header;
+  if(data.size() < sizeof(header))
+    return false;
+  memcpy(&header, data.data(), sizeof(header));
+  const size_t tableEnd = sizeof(header) + numBlas * sizeof(uint32_t);
+  if(header.magic != BLAS_CACHE_MAGIC || header.version != BLAS_CACHE_VERSION || header.numBlas != numBlas
+     || data.size() < tableEnd)
+  {
+    LOGW("BLAS cache %s doesn't match the scene, rebuilding\n", path.string().c_str());
+    return false;
+  }
+
+  // The serialized BLAS must be the ones without micromaps
+  std::vector<uint32_t> serialized(numBlas);
+  memcpy(serialized.data(), data.data() + sizeof(header), numBlas * sizeof(uint32_t));
+  std::vector<uint32_t> micromapBlas;
+  for(uint32_t i = 0; i < numBlas; i++)
+  {
+    if(serialized[i] != (hasGeometryMicromap(i) ? 0U : 1U))
+    {
+      LOGW("BLAS cache %s doesn't match the micromaps of the scene, rebuilding\n", path.string().c_str());
+      return false;
+    }
+    if(serialized[i] == 0)
+      micromapBlas.push_back(i);
+  }
+
+  // Offsets of each serialized BLAS, and validation with the driver
+  std::vector<VkDeviceSize> offsets(numBlas, 0);
+  VkDeviceSize              offset = tableEnd;
+  for(size_t i = 0; i < numBlas; i++)
+  {
+    if(serialized[i] == 0)
+      continue;
+    offset     = alignUp(offset, SERIALIZED_ALIGNMENT);
+    offsets[i] = offset;
+    SerializedAccelHeader accelHeader;
+    if(offset + sizeof(accelHeader) > data.size())
+      return false;
+    memcpy(&accelHeader, data.data() + offset, sizeof(accelHeader));
+    if(offset + accelHeader.serializedSize > data.size())
+      return false;
+
+    const VkAccelerationStructureVersionInfoKHR versionInfo{
+        .sType        = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_VERSION_INFO_KHR,
+        .pVersionData = reinterpret_cast<const uint8_t*>(data.data() + offset),
+    };
+    VkAccelerationStructureCompatibilityKHR compatibility{};
+    vkGetDeviceAccelerationStructureCompatibilityKHR(m_cacheDevice, &versionInfo, &compatibility);
+    if(compatibility != VK_ACCELERATION_STRUCTURE_COMPATIBILITY_COMPATIBLE_KHR)
+    {
+      LOGW("BLAS cache %s is incompatible with the driver, rebuilding\n", path.string().c_str());
+      return false;
+    }
+    offset += accelHeader.serializedSize;
+  }
+
+  // Upload the serialized data
+  nvvk::Buffer srcBuffer = m_cacheAlloc->createBuffer(data.size(), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  memcpy(m_cacheAlloc->map(srcBuffer), data.data(), data.size());
+  m_cacheAlloc->unmap(srcBuffer);
+  const VkDeviceAddress srcAddress = nvvk::getBufferDeviceAddress(m_cacheDevice, srcBuffer.buffer);
+
+  // Create the BLAS and deserialize them
+  m_blasAccel.resize(numBlas);
+  VkCommandBuffer cmd = cmdPool.createCommandBuffer();
+  for(size_t i = 0; i < numBlas; i++)
+  {
+    if(serialized[i] == 0)
+      continue;
+    SerializedAccelHeader accelHeader;
+    memcpy(&accelHeader, data.data() + offsets[i], sizeof(accelHeader));
+
+    VkAccelerationStructureCreateInfoKHR createInfo{
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
+        .size  = accelHeader.deserializedSize,
+        .type  = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+    };
+    m_blasAccel[i] = m_cacheAlloc->createAcceleration(createInfo);
+
+    const VkCopyMemoryToAccelerationStructureInfoKHR copyInfo{
+        .sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_INFO_KHR,
+        .src   = {.deviceAddress = srcAddress + offsets[i]},
+        .dst   = m_blasAccel[i].accel,
+        .mode  = VK_COPY_ACCELERATION_STRUCTURE_MODE_DESERIALIZE_KHR,
+    };
+    vkCmdCopyMemoryToAccelerationStructureKHR(cmd, &copyInfo);
+  }
+  nvvk::Buffer scratch = cmdBuildFullSizeBlas(cmd, micromapBlas);
+  cmdPool.submitAndWait(cmd);
+  m_cacheAlloc->destroy(srcBuffer);
+  m_cacheAlloc->destroy(scratch);
+
+  LOGI("Restored %zu BLAS from %s, built %zu with micromaps\n", numBlas - micromapBlas.size(), path.string().c_str(),
+       micromapBlas.size());
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Serialize the BLAS without micromaps in a host visible buffer and write it to the cache file
+//
+bool gltfr::SceneRtxCached::saveBlas(nvvk::CommandPool& cmdPool, const std::filesystem::path& path) const
+{
+  const uint32_t numTotal = static_cast<uint32_t>(m_blasAccel.size());
+  if(path.empty() || numTotal == 0)
+    return false;
+
+  std::vector<uint32_t>                   serialized(numTotal, 0);
+  std::vector<VkAccelerationStructureKHR> handles;
+  for(uint32_t i = 0; i < numTotal; i++)
+  {
+    if(hasGeometryMicromap(i))
+      continue;
+    serialized[i] = 1;
+    handles.push_back(m_blasAccel[i].accel);
+  }
+  const uint32_t numBlas = static_cast<uint32_t>(handles.size());
+  if(numBlas == 0)
+    return false;
+
+  nvh::ScopedTimer st(__FUNCTION__);
+
+  // Query the serialized size of each BLAS
+  std::vector<VkDeviceSize> sizes(numBlas);
+  {
+    VkQueryPool                 queryPool{};
+    const VkQueryPoolCreateInfo queryInfo{.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                                          .queryType  = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR,
+                                          .queryCount = numBlas};
+    NVVK_CHECK(vkCreateQueryPool(m_cacheDevice, &queryInfo, nullptr, &queryPool));
+    VkCommandBuffer cmd = cmdPool.createCommandBuffer();
+    vkCmdResetQueryPool(cmd, queryPool, 0, numBlas);
+    vkCmdWriteAccelerationStructuresPropertiesKHR(cmd, numBlas, handles.data(),
+                                                  VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR, queryPool, 0);
+    cmdPool.submitAndWait(cmd);
+    vkGetQueryPoolResults(m_cacheDevice, queryPool, 0, numBlas, numBlas * sizeof(VkDeviceSize), sizes.data(),
+                          sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    vkDestroyQueryPool(m_cacheDevice, queryPool, nullptr);
+  }
+
+  std::vector<VkDeviceSize> offsets(numBlas);
+  VkDeviceSize              totalSize = sizeof(BlasCacheHeader) + numTotal * sizeof(uint32_t);
+  for(uint32_t i = 0; i < numBlas; i++)
+  {
+    offsets[i] = alignUp(totalSize, SERIALIZED_ALIGNMENT);
+    totalSize  = offsets[i] + sizes[i];
+  }
+
+  // Serialize the BLAS
+  nvvk::Buffer dstBuffer = m_cacheAlloc->createBuffer(totalSize, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  const VkDeviceAddress dstAddress = nvvk::getBufferDeviceAddress(m_cacheDevice, dstBuffer.buffer);
+  VkCommandBuffer       cmd        = cmdPool.createCommandBuffer();
+  for(uint32_t i = 0; i < numBlas; i++)
+  {
+    const VkCopyAccelerationStructureToMemoryInfoKHR copyInfo{
+        .sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_INFO_KHR,
+        .src   = handles[i],
+        .dst   = {.deviceAddress = dstAddress + offsets[i]},
+        .mode  = VK_COPY_ACCELERATION_STRUCTURE_MODE_SERIALIZE_KHR,
+    };
+    vkCmdCopyAccelerationStructureToMemoryKHR(cmd, &copyInfo);
+  }
+  cmdPool.submitAndWait(cmd);
+
+  char*                 mapped = static_cast<char*>(m_cacheAlloc->map(dstBuffer));
+  const BlasCacheHeader header{.numBlas = numTotal};
+  memcpy(mapped, &header, sizeof(header));
+  memcpy(mapped + sizeof(header), serialized.data(), numTotal * sizeof(uint32_t));
+  const bool result = writeCacheFile(path, mapped, totalSize);
+  m_cacheAlloc->unmap(dstBuffer);
+  m_cacheAlloc->destroy(dstBuffer);
+
+  if(result)
+    LOGI("Saved %u BLAS in %s\n", numBlas, path.string().c_str());
+  return result;
+}
+
+bool gltfr::SceneRtxCached::hasGeometryMicromap(uint32_t renderPrimID) const
+{
+  return m_micromaps && m_micromaps->getGeometryMicromap(renderPrimID) != nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Build the BLAS of the render primitives at full size, without compaction, all in one command.
+// The returned scratch buffer can be destroyed once the command buffer is executed.
+//
+nvvk::Buffer gltfr::SceneRtxCached::cmdBuildFullSizeBlas(VkCommandBuffer cmd, const std::vector<uint32_t>& renderPrimIDs)
+{
+  if(renderPrimIDs.empty())
+    return {};
+
+  VkPhysicalDeviceAccelerationStructurePropertiesKHR asProps{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR};
+  VkPhysicalDeviceProperties2 props{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &asProps};
+  vkGetPhysicalDeviceProperties2(m_cachePhysicalDevice, &props);
+  const VkDeviceSize scratchAlignment = std::max<VkDeviceSize>(asProps.minAccelerationStructureScratchOffsetAlignment, 1);
+
+  std::vector<VkDeviceSize> scratchOffsets;
+  VkDeviceSize              scratchSize = 0;
+  for(uint32_t primID : renderPrimIDs)
+  {
+    scratchOffsets.push_back(scratchSize);
+    scratchSize += alignUp(m_blasBuildData[primID].sizeInfo.buildScratchSize, scratchAlignment);
+  }
+  nvvk::Buffer scratch = m_cacheAlloc->createBuffer(scratchSize + scratchAlignment,
+                                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  const VkDeviceAddress scratchAddress = alignUp(nvvk::getBufferDeviceAddress(m_cacheDevice, scratch.buffer), scratchAlignment);
+
+  std::vector<VkAccelerationStructureBuildGeometryInfoKHR>     buildInfos;
+  std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> rangeInfos;
+  for(size_t i = 0; i < renderPrimIDs.size(); i++)
+  {
+    const uint32_t                        primID    = renderPrimIDs[i];
+    nvvk::AccelerationStructureBuildData& buildData = m_blasBuildData[primID];
+    VkAccelerationStructureCreateInfoKHR  createInfo{
+         .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
+         .size  = buildData.sizeInfo.accelerationStructureSize,
+         .type  = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+    };
+    m_blasAccel[primID] = m_cacheAlloc->createAcceleration(createInfo);
+
+    const VkAccelerationStructureDeviceAddressInfoKHR addressInfo{
+        .sType                 = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR,
+        .accelerationStructure = m_blasAccel[primID].accel,
+    };
+    m_blasAccel[primID].address = vkGetAccelerationStructureDeviceAddressKHR(m_cacheDevice, &addressInfo);
+
+    VkAccelerationStructureBuildGeometryInfoKHR buildInfo = buildData.buildInfo;
+    buildInfo.mode                      = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    buildInfo.srcAccelerationStructure  = VK_NULL_HANDLE;
+    buildInfo.dstAccelerationStructure  = m_blasAccel[primID].accel;
+    buildInfo.geometryCount             = static_cast<uint32_t>(buildData.asGeometry.size());
+    buildInfo.pGeometries               = buildData.asGeometry.data();
+    buildInfo.scratchData.deviceAddress = scratchAddress + scratchOffsets[i];
+    buildInfos.push_back(buildInfo);
+    rangeInfos.push_back(buildData.asBuildRangeInfo.data());
+  }
+  vkCmdBuildAccelerationStructuresKHR(cmd, static_cast<uint32_t>(buildInfos.size()), buildInfos.data(), rangeInfos.data());
+  return scratch;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Full size BLAS for the deformed primitives, built with the same geometry as the original ones.
+// All share one scratch buffer, with a slot large enough to build or update each of them.
+//
+void gltfr::SceneRtxCached::cmdCreateDynamicBlas(VkCommandBuffer cmd, const std::vector<uint32_t>& renderPrimIDs)
+{
+  if(renderPrimIDs.empty())
+    return;
+
+  nvh::ScopedTimer st(__FUNCTION__);
+
+  VkPhysicalDeviceAccelerationStructurePropertiesKHR asProps{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR};
+  VkPhysicalDeviceProperties2 props{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &asProps};
+  vkGetPhysicalDeviceProperties2(m_cachePhysicalDevice, &props);
+  const VkDeviceSize scratchAlignment = std::max<VkDeviceSize>(asProps.minAccelerationStructureScratchOffsetAlignment, 1);
+
+  VkDeviceSize scratchSize = 0;
+  for(uint32_t primID : renderPrimIDs)
+  {
+    const VkAccelerationStructureBuildSizesInfoKHR& sizeInfo = m_blasBuildData[primID].sizeInfo;
+    m_dynamicBlas[primID].scratchOffset                      = scratchSize;
+    scratchSize += alignUp(std::max(sizeInfo.buildScratchSize, sizeInfo.updateScratchSize), scratchAlignment);
+  }
+  m_dynamicScratchSize = scratchSize + scratchAlignment;
+  m_cacheAlloc->destroy(m_dynamicScratch);  // Of the previous scene
+  m_dynamicScratch     = m_cacheAlloc->createBuffer(m_dynamicScratchSize,
+                                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  const VkDeviceAddress scratchAddress =
+      alignUp(nvvk::getBufferDeviceAddress(m_cacheDevice, m_dynamicScratch.buffer), scratchAlignment);
+
+  std::vector<VkAccelerationStructureBuildGeometryInfoKHR>     buildInfos;
+  std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> rangeInfos;
+  for(uint32_t primID : renderPrimIDs)
+  {
+    nvvk::AccelerationStructureBuildData& buildData = m_blasBuildData[primID];
+    VkAccelerationStructureCreateInfoKHR  createInfo{
+         .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
+         .size  = buildData.sizeInfo.accelerationStructureSize,
+         .type  = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+    };
+    m_retiredBlas.push_back(m_blasAccel[primID]);
+    m_blasAccel[primID] = m_cacheAlloc->createAcceleration(createInfo);
+
+    const VkAccelerationStructureDeviceAddressInfoKHR addressInfo{
+        .sType                 = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR,
+        .accelerationStructure = m_blasAccel[primID].accel,
+    };
+    m_blasAccel[primID].address = vkGetAccelerationStructureDeviceAddressKHR(m_cacheDevice, &addressInfo);
+
+    VkAccelerationStructureBuildGeometryInfoKHR buildInfo = buildData.buildInfo;
+    buildInfo.mode                      = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    buildInfo.srcAccelerationStructure  = VK_NULL_HANDLE;
+    buildInfo.dstAccelerationStructure  = m_blasAccel[primID].accel;
+    buildInfo.geometryCount             = static_cast<uint32_t>(buildData.asGeometry.size());
+    buildInfo.pGeometries               = buildData.asGeometry.data();
+    buildInfo.scratchData.deviceAddress = scratchAddress + m_dynamicBlas[primID].scratchOffset;
+    buildInfos.push_back(buildInfo);
+    rangeInfos.push_back(buildData.asBuildRangeInfo.data());
+  }
+  vkCmdBuildAccelerationStructuresKHR(cmd, static_cast<uint32_t>(buildInfos.size()), buildInfos.data(), rangeInfos.data());
+
+  const VkMemoryBarrier2 barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                 .srcStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                                 .srcAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+                                 .dstStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                                 .dstAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR};
+  const VkDependencyInfo dependencyInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &barrier};
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+  LOGI("%zu dynamic BLAS\n", renderPrimIDs.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+// The micromaps change the size of the BLAS, the build sizes of the baked primitives are queried again
+//
+void gltfr::SceneRtxCached::attachOpacityMicromaps(std::unique_ptr<OpacityMicromaps> micromaps)
+{
+  m_micromaps = std::move(micromaps);
+  if(!m_micromaps || !m_micromaps->isValid())
+  {
+    m_micromaps.reset();
+    return;
+  }
+
+  for(uint32_t primID = 0; primID < static_cast<uint32_t>(m_blasBuildData.size()); primID++)
+  {
+    const VkAccelerationStructureTrianglesOpacityMicromapEXT* micromap  = m_micromaps->getGeometryMicromap(primID);
+    nvvk::AccelerationStructureBuildData&                     buildData = m_blasBuildData[primID];
+    if(micromap == nullptr || buildData.asGeometry.empty())
+      continue;
+    buildData.asGeometry[0].geometry.triangles.pNext = micromap;
+    buildData.finalizeGeometry(m_cacheDevice, buildData.buildInfo.flags);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// The micromaps of the primitives whose material alpha was edited would keep the baked opacity:
+// their instances ignore the micromaps, such that any-hit decides all their triangles
+//
+bool gltfr::SceneRtxCached::disableStaleMicromaps(const nvh::gltf::Scene& scene)
+{
+  if(!m_micromaps)
+    return false;
+  const std::vector<uint32_t> stale = m_micromaps->takeStalePrimitives(scene.getModel());
+  if(stale.empty())
+    return false;
+
+  std::vector<bool> disabled(m_blasAccel.size(), false);
+  for(uint32_t primID : stale)
+    disabled[primID] = true;
+
+  // One instance per render node
+  const std::vector<nvh::gltf::RenderNode>& renderNodes = scene.getRenderNodes();
+  for(size_t i = 0; i < renderNodes.size() && i < m_tlasInstances.size(); i++)
+  {
+    if(disabled[renderNodes[i].renderPrimID])
+      m_tlasInstances[i].flags |= VK_GEOMETRY_INSTANCE_DISABLE_OPACITY_MICROMAPS_EXT;
+  }
+  LOGI("Opacity micromaps of %zu primitives disabled, their material changed\n", stale.size());
+  return true;
+}
+
+void gltfr::SceneRtxCached::destroyMicromapInputs()
+{
+  if(m_micromaps)
+    m_micromaps->destroyBuildInputs();
+}
+
+void gltfr::SceneRtxCached::destroyRetiredBlas()
+{
+  for(nvvk::AccelKHR& accel : m_retiredBlas)
+    m_cacheAlloc->destroy(accel);
+  m_retiredBlas.clear();
+}
+
+void gltfr::SceneRtxCached::destroyDynamicBlas()
+{
+  destroyRetiredBlas();
+  m_cacheAlloc->destroy(m_dynamicScratch);
+  m_dynamicScratchSize = 0;
+  m_dynamicBlas.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Refit in place the dynamic BLAS of the given render primitives, all in one command.
+// A BLAS refit too many times is rebuilt instead, in the same memory: refitting keeps the
+// hierarchy of the first build, which bounds the deformed triangles less and less tightly.
+//
+void gltfr::SceneRtxCached::cmdUpdateDynamicBlas(VkCommandBuffer cmd, const std::vector<uint32_t>& renderPrimIDs)
+{
+  if(renderPrimIDs.empty() || m_dynamicScratch.buffer == VK_NULL_HANDLE)
+    return;
+
+  VkPhysicalDeviceAccelerationStructurePropertiesKHR asProps{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR};
+  VkPhysicalDeviceProperties2 props{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &asProps};
+  vkGetPhysicalDeviceProperties2(m_cachePhysicalDevice, &props);
+  const VkDeviceSize    scratchAlignment = std::max<VkDeviceSize>(asProps.minAccelerationStructureScratchOffsetAlignment, 1);
+  const VkDeviceAddress scratchAddress =
+      alignUp(nvvk::getBufferDeviceAddress(m_cacheDevice, m_dynamicScratch.buffer), scratchAlignment);
+
+  std::vector<VkAccelerationStructureBuildGeometryInfoKHR>     buildInfos;
+  std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> rangeInfos;
+  for(uint32_t primID : renderPrimIDs)
+  {
+    auto dynamic = m_dynamicBlas.find(primID);
+    if(dynamic == m_dynamicBlas.end())
+      continue;
+
+    const bool rebuild = ++dynamic->second.refitCount >= kRefitsBeforeRebuild;
+    if(rebuild)
+      dynamic->second.refitCount = 0;
+
+    nvvk::AccelerationStructureBuildData&       buildData = m_blasBuildData[primID];
+    VkAccelerationStructureBuildGeometryInfoKHR buildInfo = buildData.buildInfo;
+    buildInfo.mode = rebuild ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+    buildInfo.srcAccelerationStructure  = rebuild ? VK_NULL_HANDLE : m_blasAccel[primID].accel;
+    buildInfo.dstAccelerationStructure  = m_blasAccel[primID].accel;
+    buildInfo.geometryCount             = static_cast<uint32_t>(buildData.asGeometry.size());
+    buildInfo.pGeometries               = buildData.asGeometry.data();
+    buildInfo.scratchData.deviceAddress = scratchAddress + dynamic->second.scratchOffset;
+    buildInfos.push_back(buildInfo);
+    rangeInfos.push_back(buildData.asBuildRangeInfo.data());
+  }
+  if(buildInfos.empty())
+    return;
+
+  // The previous frames may still trace the BLAS, and the vertices were just written
+  std::array<VkMemoryBarrier2, 2> barriers{{
+      {.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+       .srcStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+       .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+       .dstStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+       .dstAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR
+                        | VK_ACCESS_2_SHADER_READ_BIT},
+      // The TLAS update and the shaders read the BLAS
+      {.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+       .srcStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+       .srcAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+       .dstStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR
+                       | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+       .dstAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR},
+  }};
+  VkDependencyInfo dependencyInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &barriers[0]};
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+  vkCmdBuildAccelerationStructuresKHR(cmd, static_cast<uint32_t>(buildInfos.size()), buildInfos.data(), rangeInfos.data());
+  dependencyInfo.pMemoryBarriers = &barriers[1];
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  RTX scene where the compacted bottom-level acceleration structures can be
+  saved to disk and restored, instead of being built and compacted again.
+
+  The cache file is named by a hash of the geometry of the scene, the build flags
+  and the GPU/driver. Restoring fails, and the BLAS must be built, when the file
+  doesn't exist, doesn't match the scene, or the driver reports the serialized
+  data as incompatible.
+
+  The BLAS of deformed primitives (skinning, morph targets) are dynamic: they are
+  re-created at full size, without compaction, such that they can be refit and
+  rebuilt in place. Only the ones whose vertices changed are refit, in a single
+  build command, and each is rebuilt after kRefitsBeforeRebuild refits, when the
+  quality of the refit hierarchy has degraded.
+
+  The BLAS of the alpha-tested primitives can reference opacity micromaps (OpacityMicromaps),
+  owned by the scene such that they outlive the BLAS. A serialized BLAS cannot reference the
+  micromap objects of another run: those are not in the cache file, they are built at full size
+  when the others are restored. Only the bake is cached.
+
+*/
+
+#include <filesystem>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// nvpro-core
+#include "nvh/gltfscene.hpp"
+#include "nvvk/commands_vk.hpp"
+#include "nvvkhl/gltf_scene_rtx.hpp"
+
+#include "opacity_micromap.hpp"
+
+namespace gltfr {
+
+class SceneRtxCached : public nvvkhl::SceneRtx
+{
+public:
+  SceneRtxCached(VkDevice device, VkPhysicalDevice physicalDevice, nvvk::ResourceAllocator* alloc, uint32_t queueFamilyIndex = 0)
+      : nvvkhl::SceneRtx(device, physicalDevice, alloc, queueFamilyIndex)
+      , m_cacheDevice(device)
+      , m_cachePhysicalDevice(physicalDevice)
+      , m_cacheAlloc(alloc)
+  {
+  }
+  ~SceneRtxCached()
+  {
+    destroyDynamicBlas();
+    destroy();  // The BLAS, before the micromaps they reference
+  }
+
+  // Path of the cache file for this scene, built with these flags, on this device
+  static std::filesystem::path getBlasCachePath(const nvh::gltf::Scene&              scene,
+                                                VkBuildAccelerationStructureFlagsKHR flags,
+                                                VkPhysicalDevice                     physicalDevice);
+
+  // Must be called after createBottomLevelAccelerationStructure() and attachOpacityMicromaps(), instead of
+  // building the BLAS. The ones referencing micromaps are built.
+  bool restoreBlas(nvvk::CommandPool& cmdPool, const std::filesystem::path& path, size_t numBlas);
+
+  // Serialize the compacted BLAS
+  bool saveBlas(nvvk::CommandPool& cmdPool, const std::filesystem::path& path) const;
+
+  // Chain the micromaps on the geometries of the baked primitives, after createBottomLevelAccelerationStructure()
+  // and before the BLAS are built. Their build inputs are released by destroyMicromapInputs(), once built.
+  void attachOpacityMicromaps(std::unique_ptr<OpacityMicromaps> micromaps);
+  void destroyMicromapInputs();
+  bool hasOpacityMicromaps() const { return m_micromaps != nullptr; }
+
+  // After a material edit: the instances of the baked primitives whose material alpha changed ignore
+  // their micromaps. Applied by the next updateTopLevelAS(), false when nothing changed.
+  bool disableStaleMicromaps(const nvh::gltf::Scene& scene);
+
+  // Replace the BLAS of the deformed render primitives by full size ones, before the TLAS is built.
+  // The replaced BLAS are destroyed by destroyRetiredBlas(), once the command buffer is executed.
+  void cmdCreateDynamicBlas(VkCommandBuffer cmd, const std::vector<uint32_t>& renderPrimIDs);
+  void destroyRetiredBlas();
+
+  // Refit the BLAS of the render primitives whose vertices changed, or rebuild them when needed
+  // Must be recorded before the TLAS update.
+  void cmdUpdateDynamicBlas(VkCommandBuffer cmd, const std::vector<uint32_t>& renderPrimIDs);
+
+  // Scratch kept for the refits and rebuilds of the deformed primitives
+  VkDeviceSize dynamicScratchSize() const { return m_dynamicScratchSize; }
+
+private:
+  static constexpr uint32_t kRefitsBeforeRebuild = 60;
+
+  struct DynamicBlas
+  {
+    VkDeviceSize scratchOffset{0};
+    uint32_t     refitCount{0};
+  };
+
+  void destroyDynamicBlas();
+  bool hasGeometryMicromap(uint32_t renderPrimID) const;
+  nvvk::Buffer cmdBuildFullSizeBlas(VkCommandBuffer cmd, const std::vector<uint32_t>& renderPrimIDs);
+
+  VkDevice                 m_cacheDevice{};
+  VkPhysicalDevice         m_cachePhysicalDevice{};
+  nvvk::ResourceAllocator* m_cacheAlloc{};
+
+  std::unordered_map<uint32_t, DynamicBlas> m_dynamicBlas;  // By render primitive
+  nvvk::Buffer                              m_dynamicScratch;
+  VkDeviceSize                              m_dynamicScratchSize{0};
+  std::vector<nvvk::AccelKHR>               m_retiredBlas;
+  std::unique_ptr<OpacityMicromaps>         m_micromaps;
+};
+
+}  // namespace gltfr
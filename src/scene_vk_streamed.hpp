@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Vulkan scene where the creation of the textures can be deferred.
+
+  When deferred, create() only uploads the materials, the geometry and the lights.
+  The textures are created later with createDeferredTextures(), typically on the
+  loader thread once the scene is already displayed with placeholder textures.
+
+*/
+
+#include <filesystem>
+
+// nvpro-core
+#include "nvvkhl/gltf_scene_vk.hpp"
+
+namespace gltfr {
+
+class SceneVkStreamed : public nvvkhl::SceneVk
+{
+public:
+  using nvvkhl::SceneVk::SceneVk;
+
+  // Must be called before create()
+  void setDeferTextures(bool defer) { m_deferTextures = defer; }
+  // Directory of the images, instead of the one of the scene filename
+  void setBaseDir(const std::filesystem::path& basedir) { m_basedir = basedir; }
+
+  const std::filesystem::path& baseDir() const { return m_basedir; }
+
+  // Buffer of the render nodes, for the partial updates of Scene
+  VkBuffer renderNodeBuffer() const { return m_bRenderNode.buffer; }
+  // Buffer of the render primitives, rewritten by CompactVertices
+  VkBuffer renderPrimitiveBuffer() const { return m_bRenderPrim.buffer; }
+  // Vertex buffers replaced by CompactVertices, destroyed with the scene
+  VertexBuffers& mutableVertexBuffers(uint32_t renderPrimID) { return m_vertexBuffers[renderPrimID]; }
+
+  // True when create() skipped the textures and they are not yet created
+  bool hasDeferredTextures() const { return m_hasDeferredTextures; }
+
+  // Create the textures which were skipped by create()
+  void createDeferredTextures(VkCommandBuffer cmd, const tinygltf::Model& model)
+  {
+    if(!m_hasDeferredTextures)
+      return;
+    nvvkhl::SceneVk::createTextureImages(cmd, model, m_basedir);
+    m_hasDeferredTextures = false;
+  }
+
+protected:
+  void createTextureImages(VkCommandBuffer cmd, const tinygltf::Model& model, const std::filesystem::path& basedir) override
+  {
+    if(m_basedir.empty())
+      m_basedir = basedir;
+    if(m_deferTextures)
+    {
+      m_hasDeferredTextures = !model.textures.empty();
+      return;
+    }
+    nvvkhl::SceneVk::createTextureImages(cmd, model, m_basedir);
+  }
+
+private:
+  bool                  m_deferTextures{false};
+  bool                  m_hasDeferredTextures{false};
+  std::filesystem::path m_basedir;
+};
+
+}  // namespace gltfr
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "screen_picker.hpp"
+
+// nvpro-core
+#include "nvh/cameramanipulator.hpp"
+#include "nvvk/error_vk.hpp"
+
+void gltfr::ScreenPicker::init(Resources& res)
+{
+  m_device         = res.ctx.device;
+  m_framesInFlight = res.framesInFlight();
+  m_picker = std::make_unique<nvvk::RayPickerKHR>(res.ctx.device, res.ctx.physicalDevice, res.m_allocator.get(),
+                                                  res.ctx.compute.familyIndex);
+  const VkEventCreateInfo eventInfo{.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO};
+  NVVK_CHECK(vkCreateEvent(m_device, &eventInfo, nullptr, &m_event));
+}
+
+void gltfr::ScreenPicker::deinit()
+{
+  if(!m_picker)
+    return;
+  m_picker->destroy();
+  m_picker.reset();
+  vkDestroyEvent(m_device, m_event, nullptr);
+  m_event = VK_NULL_HANDLE;
+  m_requests.clear();
+  m_inFlight = {};
+  m_recorded = false;
+}
+
+void gltfr::ScreenPicker::setTlas(VkAccelerationStructureKHR tlas)
+{
+  m_tlas        = tlas;
+  m_tlasChanged = true;
+  m_inFlight    = {};  // The result would be an instance of the previous scene
+  m_requests.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// The ray of the pick, from the camera and its clip planes
+//
+void gltfr::ScreenPicker::request(const glm::vec2& uv, float aspectRatio, Callback&& callback, bool hover)
+{
+  const glm::vec2& clip = CameraManip.getClipPlanes();
+  glm::mat4        proj = glm::perspectiveRH_ZO(glm::radians(CameraManip.getFov()), aspectRatio, clip.x, clip.y);
+  proj[1][1] *= -1;
+
+  Request request{.info     = {.modelViewInv   = glm::inverse(CameraManip.getMatrix()),
+                               .perspectiveInv = glm::inverse(proj),
+                               .pickX          = uv.x,
+                               .pickY          = uv.y},
+                  .callback = std::move(callback),
+                  .hover    = hover};
+  if(hover)
+    std::erase_if(m_requests, [](const Request& r) { return r.hover; });
+  m_requests.push_back(std::move(request));
+}
+
+void gltfr::ScreenPicker::cmdPick(VkCommandBuffer cmd)
+{
+  m_frame++;
+  if(m_recorded)
+  {
+    if(vkGetEventStatus(m_device, m_event) != VK_EVENT_SET)
+      return;
+    m_recorded = false;
+    if(m_inFlight)
+      m_inFlight(m_picker->getResult());
+    m_inFlight = {};
+  }
+
+  // The descriptor set of the picker is written once the command buffers of the last pick are done
+  if(m_tlasChanged)
+  {
+    if(m_recordFrame != 0 && m_frame - m_recordFrame < m_framesInFlight)
+      return;
+    m_picker->setTlas(m_tlas);
+    m_tlasChanged = false;
+  }
+  if(m_requests.empty() || m_tlas == VK_NULL_HANDLE)
+    return;
+
+  Request request = std::move(m_requests.front());
+  m_requests.pop_front();
+
+  // The TLAS can be rebuilt by the previous frames, e.g. by an animation
+  const VkMemoryBarrier2 toPick{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                .srcStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                                .srcAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+                                .dstStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                                .dstAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR};
+  const VkDependencyInfo toPickInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &toPick};
+  vkCmdPipelineBarrier2(cmd, &toPickInfo);
+
+  m_picker->run(cmd, request.info);
+
+  NVVK_CHECK(vkResetEvent(m_device, m_event));
+  const VkMemoryBarrier2 toHost{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                .srcStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                                .srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+                                .dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT,
+                                .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT};
+  const VkDependencyInfo toHostInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &toHost};
+  vkCmdSetEvent2(cmd, m_event, &toHostInfo);
+
+  m_inFlight    = std::move(request.callback);
+  m_recorded    = true;
+  m_recordFrame = m_frame;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Asynchronous screen picking
+
+  request() queues a pick under a viewport coordinate, with the camera of the
+  moment. cmdPick(), at the beginning of each frame, records the next pick in
+  the command buffer of the frame, followed by an event, and calls the
+  callback of the previous pick once its event is set: the result comes a few
+  frames later, and nothing waits for the GPU.
+
+  The ray picker has one result buffer, so one pick is in flight at a time.
+  The hover requests replace each other, the clicks are all kept. A new TLAS
+  drops the pick in flight, its instances are the ones of the previous scene.
+
+*/
+
+#include <deque>
+#include <functional>
+#include <memory>
+
+#include <glm/glm.hpp>
+
+// nvpro-core
+#include "nvvk/raypicker_vk.hpp"
+
+#include "resources.hpp"
+
+namespace gltfr {
+
+class ScreenPicker
+{
+public:
+  using Callback = std::function<void(const nvvk::RayPickerKHR::PickResult&)>;
+
+  ~ScreenPicker() { deinit(); }
+
+  void init(Resources& res);
+  void deinit();
+
+  // Applied when no pick is in flight
+  void setTlas(VkAccelerationStructureKHR tlas);
+
+  // 'uv' in [0,1] over the viewport. A hover request replaces the previous one which is not recorded yet.
+  void request(const glm::vec2& uv, float aspectRatio, Callback&& callback, bool hover = false);
+
+  // At the beginning of the frame: the result of the pick in flight, then the next pick
+  void cmdPick(VkCommandBuffer cmd);
+
+private:
+  struct Request
+  {
+    nvvk::RayPickerKHR::PickInfo info;
+    Callback                     callback;
+    bool                         hover{false};
+  };
+
+  std::unique_ptr<nvvk::RayPickerKHR> m_picker;
+  VkDevice                            m_device{VK_NULL_HANDLE};
+  VkEvent                             m_event{VK_NULL_HANDLE};
+  VkAccelerationStructureKHR          m_tlas{VK_NULL_HANDLE};
+  bool                                m_tlasChanged{false};
+  std::deque<Request>                 m_requests;
+  bool                                m_recorded{false};  // A pick is in flight, until its event is set
+  Callback                            m_inFlight;         // Its callback, empty when the result is dropped
+  uint64_t                            m_frame{0};
+  uint64_t                            m_recordFrame{0};
+  uint32_t                            m_framesInFlight{3};
+};
+
+}  // namespace gltfr
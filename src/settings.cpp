@@ -36,6 +36,7 @@ void gltfr::Settings::onUI()
     PE::begin("gltfr::Settings::onUI");
     PE::SliderInt("Max Frames", &maxFrames, 1, 1000000);
     PE::Checkbox("Show Axis", &showAxis);
+    PE::Checkbox("Hover Info", &showHoverInfo, "Name of the object under the mouse cursor, picked without waiting for the GPU");
     PE::SliderFloat("Max Luminance", &maxLuminance, 0.0f, 10000.0f);
     PE::ColorEdit3("Silhouette Color", glm::value_ptr(silhouetteColor),
                    ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoLabel | ImGuiColorEditFlags_Float);
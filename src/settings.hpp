@@ -54,6 +54,7 @@ struct Settings
 
   int          maxFrames            = 200000;       // Maximum number of frames to render (used by pathtracer)
   bool         showAxis             = true;         // Show the axis (bottom left)
+  bool         showHoverInfo        = false;        // Tooltip of the object under the mouse cursor
   EnvSystem    envSystem            = eSky;         // Environment system: Sky or HDR
   RenderSystem renderSystem         = ePathtracer;  // Renderer to use
   float        hdrEnvIntensity      = 1.0f;         // Intensity of the environment (HDR)
@@ -73,6 +74,7 @@ enum RenderMode
 {
   eRTX,
   eIndirect,
+  eWavefront,
 };
 
 struct PathtraceSettings
@@ -80,10 +82,16 @@ struct PathtraceSettings
   int              maxDepth{50};
   int              maxSamples{1};
   DH::EDebugMethod dbgMethod = DH::eDbgMethod_none;
-  RenderMode       renderMode{eIndirect};  // RTX / Indirect
+  RenderMode       renderMode{eIndirect};  // RTX / Indirect / Wavefront
+  float            adaptiveThreshold{0.0f};  // Relative error of a converged tile, 0: every pixel takes maxSamples
+  int              adaptiveMinSamples{16};   // Samples of each pixel before its tile can converge
+  bool             temporal{false};          // Reproject the accumulation when only the camera moved, biased
+  int              temporalMaxHistory{64};   // Samples kept from the previous accumulation
   float            aperture{0.0f};
   float            focalDistance{10.0f};
   bool             autoFocus{true};
+  int              shareIndex{0};  // Distributed rendering: the samples of this process, out of shareCount
+  int              shareCount{1};
 };
 
 
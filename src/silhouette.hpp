@@ -58,24 +58,16 @@ public:
     if(res.hasSlangCompiler() && g_forceExternalShaders)
     {
       // Slang version
-      std::string             filename = nvh::findFile("silhouette.comp.slang", g_applicationSearchPaths, true);
-      slang::ICompileRequest* request  = res.m_slangC->createCompileRequest(filename);
-      if(SLANG_FAILED(request->compile()))
-      {
-        LOGE("Error compiling shader %s, %s\n", filename.c_str(), request->getDiagnosticOutput());
+      if(!res.compileSlangShader("silhouette.comp.slang", spirvCode))
         return;
-      }
-      res.m_slangC->getSpirvCode(request, spirvCode);
       shaderModuleCreateInfo = {
           .codeSize = spirvCode.size() * sizeof(uint32_t),
           .pCode    = spirvCode.data(),
       };
 
       // GLSL version
-      // shaderc::SpvCompilationResult compilationResult =
-      //     res.compileGlslShader("silhouette.comp.glsl", shaderc_shader_kind::shaderc_compute_shader);
-      // VkShaderModuleCreateInfo shaderModuleCreateInfo;
-      // if(!res.createShaderModuleCreateInfo(compilationResult, shaderModuleCreateInfo))
+      // if(!res.compileGlslShader("silhouette.comp.glsl", shaderc_shader_kind::shaderc_compute_shader, spirvCode)
+      //    || !res.createShaderModuleCreateInfo(spirvCode, shaderModuleCreateInfo))
       //   return;
     }
     else
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+#include "telemetry.hpp"
+
+// nvpro-core
+#include "nvh/nvprint.hpp"
+
+namespace {
+constexpr const char* kPhaseNames[] = {"begin", "streaming", "picking", "changes", "scene", "render", "post"};
+constexpr const char* kCounterNames[] = {"uploadBytes", "stagingUploads",    "blasBuilds",         "blasRefits",
+                                         "tlasUpdates", "descriptorWrites", "textureDescriptors", "samples"};
+constexpr const char* kGaugeNames[] = {"budget", "usage", "geometry", "textures", "accel", "scratch", "gbuffers"};
+static_assert(std::size(kPhaseNames) == gltfr::Telemetry::eNumPhases);
+static_assert(std::size(kCounterNames) == gltfr::Telemetry::eNumCounters);
+static_assert(std::size(kGaugeNames) == gltfr::Telemetry::eNumGauges);
+}  // namespace
+
+bool gltfr::Telemetry::open(const std::string& filename)
+{
+  m_file.open(filename, std::ios::out | std::ios::trunc);
+  if(!m_file)
+  {
+    LOGE("Telemetry: cannot write %s\n", filename.c_str());
+    return false;
+  }
+  m_start = m_lastFrame = std::chrono::steady_clock::now();
+  m_frame               = 0;
+  LOGI("Telemetry: %s\n", filename.c_str());
+  return true;
+}
+
+void gltfr::Telemetry::close()
+{
+  if(m_file.is_open())
+    m_file.close();
+}
+
+void gltfr::Telemetry::endFrame(nvh::Profiler& profiler)
+{
+  uint64_t counters[eNumCounters];
+  for(int i = 0; i < eNumCounters; i++)
+    counters[i] = m_counters[i].exchange(0, std::memory_order_relaxed);
+  if(!isEnabled())
+    return;
+
+  const auto   now       = std::chrono::steady_clock::now();
+  const double time      = std::chrono::duration<double, std::milli>(now - m_start).count();
+  const double frameTime = std::chrono::duration<double, std::milli>(now - m_lastFrame).count();
+  m_lastFrame            = now;
+
+  // One formatted line, without allocations beside the stream
+  char   line[2048];
+  size_t length = 0;
+  auto   append = [&](const char* format, auto... args) {
+    const int n = std::snprintf(line + length, sizeof(line) - length, format, args...);
+    if(n > 0)
+      length = std::min(length + size_t(n), sizeof(line) - 1);
+  };
+
+  append("{\"frame\":%llu,\"time\":%.3f,\"frameTime\":%.3f,\"cpu\":{", static_cast<unsigned long long>(m_frame), time, frameTime);
+  for(int i = 0; i < eNumPhases; i++)
+  {
+    append("%s\"%s\":%.3f", i ? "," : "", kPhaseNames[i], m_phases[i]);
+    m_phases[i] = 0.0;
+  }
+  append("%s", "},\"gpu\":{");
+  bool first = true;
+  for(const char* section : kProfilerSections)
+  {
+    nvh::Profiler::TimerInfo info{};
+    if(!profiler.getTimerInfo(section, info))
+      continue;
+    append("%s\"%s\":%.3f", first ? "" : ",", section, info.gpu.last / 1000.0);  // The profiler is in microseconds
+    first = false;
+  }
+  append("%s", "}");
+  for(int i = 0; i < eNumCounters; i++)
+    append(",\"%s\":%llu", kCounterNames[i], static_cast<unsigned long long>(counters[i]));
+  append("%s", ",\"memory\":{");
+  for(int i = 0; i < eNumGauges; i++)
+    append("%s\"%s\":%.1f", i ? "," : "", kGaugeNames[i], m_gauges[i].load(std::memory_order_relaxed) / (1024.0 * 1024.0));
+  append("%s", "}");
+  append(",\"samplesPerSecond\":%.0f}\n", frameTime > 0.0 ? counters[eSamples] * 1000.0 / frameTime : 0.0);
+
+  m_file.write(line, std::streamsize(length));
+  if(++m_frame % kFlushFrames == 0)
+    m_file.flush();
+}
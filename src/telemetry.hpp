@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Per-frame telemetry, written as JSON lines (--telemetry)
+
+  The modules count what they do with add(), from any thread: the counters are
+  relaxed atomics, and always counted. The main thread times the phases of the
+  frame with PhaseTimer, only when the telemetry is written. At the end of each
+  frame, endFrame() writes one line and resets the counters:
+
+    {"frame":120,"time":2034.512,"frameTime":16.671,"cpu":{"begin":0.051,...},
+     "gpu":{"Raytrace":12.204,"Tonemapper":0.133},"uploadBytes":4352,...}
+
+  - time, frameTime: ms since the start, and since the previous frame
+  - cpu: ms of the phases of onRender
+  - gpu: ms of the profiler sections, the latest results (a few frames late)
+  - the counters of the frame, and samplesPerSecond from samples and frameTime
+  - memory: MB of the budget, the usage and each category of MemoryBudget
+
+  The lines are buffered and flushed every kFlushFrames frames, such that it
+  can be left on: a line is a few hundred bytes.
+
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// nvpro-core
+#include "nvh/profiler.hpp"
+
+namespace gltfr {
+
+// Sections of the renderers and of the post-processing, see the calls to timeRecurring
+inline constexpr const char* kProfilerSections[] = {"Raytrace", "Denoiser", "Raster", "Cull", "Hi-Z", "Sky", "HDR Dome", "Tonemapper"};
+
+class Telemetry
+{
+public:
+  enum Phase
+  {
+    ePhaseBegin,      // Frame graph, retired resources, readback of the saved images
+    ePhaseStreaming,  // Staged scene, streamed textures
+    ePhasePicking,    // ScreenPicker
+    ePhaseChanges,    // handleChanges
+    ePhaseScene,      // Scene::processFrame: animation, uploads, acceleration structures
+    ePhaseRender,     // The renderer
+    ePhasePost,       // Tonemapper
+    eNumPhases
+  };
+
+  enum Counter
+  {
+    eUploadBytes,         // Through the upload ring
+    eStagingUploads,      // Buffer updates through the staging of the allocator
+    eBlasBuilds,          // Built when loading (not restored from the cache)
+    eBlasRefits,          // Deformed primitives
+    eTlasUpdates,         // Builds and updates
+    eDescriptorWrites,    // vkUpdateDescriptorSets calls
+    eTextureDescriptors,  // Texture descriptors written
+    eSamples,             // Path traced samples, pixels x samples per pixel
+    eNumCounters
+  };
+
+  // Memory in bytes, kept from frame to frame (see MemoryBudget)
+  enum Gauge
+  {
+    eMemoryBudget,
+    eMemoryUsage,
+    eMemoryGeometry,  // The categories of MemoryBudget, in order
+    eMemoryTextures,
+    eMemoryAccel,
+    eMemoryScratch,
+    eMemoryGBuffers,
+    eNumGauges
+  };
+
+  Telemetry(const Telemetry&)            = delete;
+  Telemetry& operator=(const Telemetry&) = delete;
+
+  static Telemetry& getInstance()
+  {
+    static Telemetry instance;
+    return instance;
+  }
+
+  bool open(const std::string& filename);
+  void close();
+  bool isEnabled() const { return m_file.is_open(); }
+
+  void add(Counter counter, uint64_t value = 1) { m_counters[counter].fetch_add(value, std::memory_order_relaxed); }
+  void setGauge(Gauge gauge, uint64_t value) { m_gauges[gauge].store(value, std::memory_order_relaxed); }
+
+  // Adds the time of its scope to a phase of the frame
+  class PhaseTimer
+  {
+  public:
+    explicit PhaseTimer(Phase phase)
+        : m_phase(phase)
+        , m_enabled(getInstance().isEnabled())
+    {
+      if(m_enabled)
+        m_start = std::chrono::steady_clock::now();
+    }
+    ~PhaseTimer()
+    {
+      if(m_enabled)
+        getInstance().m_phases[m_phase] +=
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+  private:
+    Phase                                 m_phase;
+    bool                                  m_enabled;
+    std::chrono::steady_clock::time_point m_start;
+  };
+
+  // Writes the line of the frame, and resets its counters
+  void endFrame(nvh::Profiler& profiler);
+
+private:
+  static constexpr uint64_t kFlushFrames = 60;
+
+  Telemetry()  = default;
+  ~Telemetry() { close(); }
+
+  std::ofstream                         m_file;
+  std::atomic<uint64_t>                 m_counters[eNumCounters]{};
+  std::atomic<uint64_t>                 m_gauges[eNumGauges]{};
+  double                                m_phases[eNumPhases]{};
+  uint64_t                              m_frame{0};
+  std::chrono::steady_clock::time_point m_start;
+  std::chrono::steady_clock::time_point m_lastFrame;
+};
+
+}  // namespace gltfr
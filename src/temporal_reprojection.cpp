@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "temporal_reprojection.hpp"
+
+// nvpro-core
+#include "nvh/nvprint.hpp"
+#include "nvvk/debug_util_vk.hpp"
+#include "nvvk/error_vk.hpp"
+
+#include "_autogen/reproject.comp.glsl.h"
+
+namespace gltfr {
+extern bool g_forceExternalShaders;
+}
+
+namespace {
+void memoryBarrier(VkCommandBuffer cmd, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+  const VkMemoryBarrier2 barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                 .srcStageMask  = srcStage,
+                                 .srcAccessMask = srcAccess,
+                                 .dstStageMask  = dstStage,
+                                 .dstAccessMask = dstAccess};
+  const VkDependencyInfo dependencyInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &barrier};
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+
+constexpr VkPipelineStageFlags2 kPathtraceStages = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+}  // namespace
+
+bool gltfr::TemporalReprojection::init(Resources& res, VkDescriptorSetLayout rtxSetLayout)
+{
+  m_device = res.ctx.device;
+
+  const VkPushConstantRange        pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DH::PushConstantReproject)};
+  const VkPipelineLayoutCreateInfo layoutInfo{.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                                              .setLayoutCount         = 1,
+                                              .pSetLayouts            = &rtxSetLayout,
+                                              .pushConstantRangeCount = 1,
+                                              .pPushConstantRanges    = &pushConstantRange};
+  NVVK_CHECK(vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_layout));
+
+  if(!createPipeline(res))
+  {
+    LOGW("Temporal reprojection: the compute shader could not be created\n");
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Compute pipeline from the GLSL file, or the pre-compiled version
+//
+bool gltfr::TemporalReprojection::createPipeline(Resources& res)
+{
+  VkShaderModuleCreateInfo shaderModuleCreateInfo{.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                                                  .codeSize = sizeof(reproject_comp_glsl),
+                                                  .pCode    = &reproject_comp_glsl[0]};
+  std::vector<uint32_t>    spirvCode;
+  if(res.hasGlslCompiler() && g_forceExternalShaders)
+  {
+    if(!res.compileGlslShader("reproject.comp.glsl", shaderc_shader_kind::shaderc_compute_shader, spirvCode)
+       || !res.createShaderModuleCreateInfo(spirvCode, shaderModuleCreateInfo))
+      return false;
+  }
+
+  VkShaderModule shaderModule{};
+  NVVK_CHECK(vkCreateShaderModule(m_device, &shaderModuleCreateInfo, nullptr, &shaderModule));
+  const VkComputePipelineCreateInfo pipelineInfo{
+      .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .stage  = {.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                 .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                 .module = shaderModule,
+                 .pName  = "main"},
+      .layout = m_layout,
+  };
+  NVVK_CHECK(vkCreateComputePipelines(m_device, res.m_pipelineCache, 1, &pipelineInfo, nullptr, &m_pipeline));
+  vkDestroyShaderModule(m_device, shaderModule, nullptr);
+  nvvk::DebugUtil(m_device).setObjectName(m_pipeline, "reproject.comp.glsl");
+  return true;
+}
+
+void gltfr::TemporalReprojection::deinit()
+{
+  if(m_device == VK_NULL_HANDLE)
+    return;
+  vkDestroyPipeline(m_device, m_pipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+  m_pipeline = VK_NULL_HANDLE;
+  m_layout   = VK_NULL_HANDLE;
+  m_device   = VK_NULL_HANDLE;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The images of the previous frame are in the general layout, like all G-Buffers
+//
+void gltfr::TemporalReprojection::cmdSaveHistory(VkCommandBuffer cmd, const std::vector<HistoryCopy>& copies, const VkExtent2D& size) const
+{
+  // The previous frame wrote the accumulation, and read the history
+  memoryBarrier(cmd, kPathtraceStages | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT,
+                VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+  const VkImageCopy region{.srcSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1},
+                           .dstSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1},
+                           .extent         = {size.width, size.height, 1}};
+  for(const HistoryCopy& copy : copies)
+    vkCmdCopyImage(cmd, copy.current, VK_IMAGE_LAYOUT_GENERAL, copy.history, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+
+  // The path tracer overwrites the copied images, the reprojection reads the history
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                kPathtraceStages, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+}
+
+//--------------------------------------------------------------------------------------------------
+// One thread per pixel, before the adaptive sampling reads the statistics
+//
+void gltfr::TemporalReprojection::cmdReproject(VkCommandBuffer cmd, VkDescriptorSet rtxSet, const DH::PushConstantReproject& pushConst, const VkExtent2D& size) const
+{
+  if(m_pipeline == VK_NULL_HANDLE)
+    return;
+
+  memoryBarrier(cmd, kPathtraceStages, VK_ACCESS_2_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout, 0, 1, &rtxSet, 0, nullptr);
+  vkCmdPushConstants(cmd, m_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DH::PushConstantReproject), &pushConst);
+  vkCmdDispatch(cmd, (size.width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, (size.height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+
+  // The next passes read the merged accumulation
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, kPathtraceStages | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_READ_BIT);
+}
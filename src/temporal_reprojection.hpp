@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Temporal reprojection of the path tracer
+
+  A move of the camera restarts the accumulation. When nothing else changed,
+  the previous accumulation is kept: cmdSaveHistory() copies the color, the
+  luminance statistics and the normal-depth to the history G-Buffers before
+  the path tracer writes the first frame. The path tracer also writes the
+  motion of each pixel (see storeMotion() in rt_common.h), and cmdReproject()
+  runs reproject.comp.glsl, which merges the history of the same surface with
+  the new samples.
+
+*/
+
+#include <vector>
+
+#include "resources.hpp"
+
+#include "nvvkhl/shaders/dh_lighting.h"
+namespace DH {
+#include "shaders/device_host.h"
+}  // namespace DH
+
+namespace gltfr {
+
+class TemporalReprojection
+{
+public:
+  ~TemporalReprojection() { deinit(); }
+
+  // The layout of the ray tracing descriptor set, which has the current and history images
+  bool init(Resources& res, VkDescriptorSetLayout rtxSetLayout);
+  void deinit();
+
+  struct HistoryCopy
+  {
+    VkImage current;
+    VkImage history;
+  };
+
+  // Before the path tracer overwrites the accumulation
+  void cmdSaveHistory(VkCommandBuffer cmd, const std::vector<HistoryCopy>& copies, const VkExtent2D& size) const;
+
+  // After the path tracer wrote the first frame and the motion
+  void cmdReproject(VkCommandBuffer cmd, VkDescriptorSet rtxSet, const DH::PushConstantReproject& pushConst, const VkExtent2D& size) const;
+
+private:
+  bool createPipeline(Resources& res);
+
+  VkDevice m_device{VK_NULL_HANDLE};
+
+  VkPipelineLayout m_layout{VK_NULL_HANDLE};
+  VkPipeline       m_pipeline{VK_NULL_HANDLE};
+};
+
+}  // namespace gltfr
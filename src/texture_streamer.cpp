@@ -0,0 +1,728 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+#include "texture_streamer.hpp"
+#include "bc7_encoder.hpp"
+#include "cache_utils.hpp"
+
+// nvpro-core
+#include "nvh/parallel_work.hpp"
+#include "nvh/timesampler.hpp"
+#include "nvvk/commands_vk.hpp"
+#include "nvvk/debug_util_vk.hpp"
+#include "nvvk/error_vk.hpp"
+#include "nvvk/images_vk.hpp"
+
+#include "stb_image.h"
+
+namespace {
+constexpr uint32_t kBaseResolution = 128;  // Images start with the mips up to this resolution
+constexpr uint32_t kMaxInFlight    = 8;    // Images being streamed at the same time
+constexpr uint64_t kEvictAge       = 120;  // Updates without a request before an image can be evicted
+constexpr auto     kSwapInterval   = std::chrono::milliseconds(250);  // Minimum time between two swaps
+constexpr uint32_t kBc7CacheMagic   = 0x43374342;                      // "BC7C"
+constexpr uint32_t kBc7CacheVersion = 1;                               // Bump when the encoder changes
+
+// Header of the compressed images in the cache, followed by the size and data of each mip
+struct Bc7CacheHeader
+{
+  uint32_t magic{kBc7CacheMagic};
+  uint32_t version{kBc7CacheVersion};
+  uint32_t width{};
+  uint32_t height{};
+  uint32_t mipCount{};
+};
+
+//--------------------------------------------------------------------------------------------------
+// Reduce a RGBA8 image by two, with a box filter. Colors are averaged in linear space.
+//
+std::vector<uint8_t> downsample(const std::vector<uint8_t>& src, VkExtent2D srcSize, VkExtent2D dstSize, bool srgb)
+{
+  static const std::array<float, 256> srgbToLinear = [] {
+    std::array<float, 256> table{};
+    for(int i = 0; i < 256; i++)
+    {
+      const float c = i / 255.0F;
+      table[i]      = c <= 0.04045F ? c / 12.92F : std::pow((c + 0.055F) / 1.055F, 2.4F);
+    }
+    return table;
+  }();
+  auto linearToSrgb = [](float c) {
+    c = c <= 0.0031308F ? c * 12.92F : 1.055F * std::pow(c, 1.0F / 2.4F) - 0.055F;
+    return static_cast<uint8_t>(std::clamp(c * 255.0F + 0.5F, 0.0F, 255.0F));
+  };
+
+  std::vector<uint8_t> dst(size_t(dstSize.width) * dstSize.height * 4);
+  for(uint32_t y = 0; y < dstSize.height; y++)
+  {
+    const uint32_t y0 = std::min(y * 2, srcSize.height - 1);
+    const uint32_t y1 = std::min(y * 2 + 1, srcSize.height - 1);
+    for(uint32_t x = 0; x < dstSize.width; x++)
+    {
+      const uint32_t                      x0 = std::min(x * 2, srcSize.width - 1);
+      const uint32_t                      x1 = std::min(x * 2 + 1, srcSize.width - 1);
+      const std::array<const uint8_t*, 4> texels{&src[(size_t(y0) * srcSize.width + x0) * 4], &src[(size_t(y0) * srcSize.width + x1) * 4],
+                                                 &src[(size_t(y1) * srcSize.width + x0) * 4], &src[(size_t(y1) * srcSize.width + x1) * 4]};
+      uint8_t* out = &dst[(size_t(y) * dstSize.width + x) * 4];
+      for(int c = 0; c < 4; c++)
+      {
+        if(srgb && c < 3)
+        {
+          float sum = 0;
+          for(const uint8_t* t : texels)
+            sum += srgbToLinear[t[c]];
+          out[c] = linearToSrgb(sum * 0.25F);
+        }
+        else
+        {
+          uint32_t sum = 0;
+          for(const uint8_t* t : texels)
+            sum += t[c];
+          out[c] = static_cast<uint8_t>((sum + 2) / 4);
+        }
+      }
+    }
+  }
+  return dst;
+}
+
+VkExtent2D mipExtent(VkExtent2D extent, uint32_t level)
+{
+  return {std::max(1U, extent.width >> level), std::max(1U, extent.height >> level)};
+}
+
+VkFilter toFilter(int gltfFilter)
+{
+  return (gltfFilter == TINYGLTF_TEXTURE_FILTER_NEAREST || gltfFilter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST
+          || gltfFilter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_LINEAR) ?
+             VK_FILTER_NEAREST :
+             VK_FILTER_LINEAR;
+}
+
+VkSamplerAddressMode toAddressMode(int gltfWrap)
+{
+  switch(gltfWrap)
+  {
+    case TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE:
+      return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    case TINYGLTF_TEXTURE_WRAP_MIRRORED_REPEAT:
+      return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+    default:
+      return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  }
+}
+
+VkSamplerCreateInfo makeSamplerCreateInfo(const tinygltf::Model& model, const tinygltf::Texture& texture)
+{
+  VkSamplerCreateInfo info{
+      .sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+      .magFilter    = VK_FILTER_LINEAR,
+      .minFilter    = VK_FILTER_LINEAR,
+      .mipmapMode   = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+      .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .maxLod       = VK_LOD_CLAMP_NONE,
+  };
+  if(texture.sampler >= 0 && texture.sampler < static_cast<int>(model.samplers.size()))
+  {
+    const tinygltf::Sampler& sampler = model.samplers[texture.sampler];
+    info.magFilter                   = toFilter(sampler.magFilter);
+    info.minFilter                   = toFilter(sampler.minFilter);
+    info.mipmapMode                  = (sampler.minFilter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST
+                       || sampler.minFilter == TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_NEAREST) ?
+                                           VK_SAMPLER_MIPMAP_MODE_NEAREST :
+                                           VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    info.addressModeU = toAddressMode(sampler.wrapS);
+    info.addressModeV = toAddressMode(sampler.wrapT);
+  }
+  return info;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Textures used by a material, with the ones holding colors
+//
+void collectMaterialTextures(const tinygltf::Material& material, std::vector<std::pair<int, bool>>& textures)
+{
+  textures.emplace_back(material.pbrMetallicRoughness.baseColorTexture.index, true);
+  textures.emplace_back(material.pbrMetallicRoughness.metallicRoughnessTexture.index, false);
+  textures.emplace_back(material.normalTexture.index, false);
+  textures.emplace_back(material.occlusionTexture.index, false);
+  textures.emplace_back(material.emissiveTexture.index, true);
+
+  // Extensions: all "...Texture" objects with an index
+  std::function<void(const tinygltf::Value&)> visit = [&](const tinygltf::Value& value) {
+    if(!value.IsObject())
+      return;
+    for(const std::string& key : value.Keys())
+    {
+      const tinygltf::Value& child = value.Get(key);
+      if(child.IsObject() && key.ends_with("Texture") && child.Has("index"))
+      {
+        const bool color = key == "sheenColorTexture" || key == "specularColorTexture" || key == "diffuseTexture"
+                           || key == "specularGlossinessTexture";
+        textures.emplace_back(child.Get("index").GetNumberAsInt(), color);
+      }
+      else
+      {
+        visit(child);
+      }
+    }
+  };
+  for(const auto& extension : material.extensions)
+    visit(extension.second);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Compressed mip chain of an image, in the cache directory
+//
+bool readBc7Cache(const std::filesystem::path& path, VkExtent2D& extent, std::vector<std::vector<uint8_t>>& mips)
+{
+  std::vector<char> data;
+  if(!readCacheFile(path, data) || data.size() < sizeof(Bc7CacheHeader))
+    return false;
+  Bc7CacheHeader header;
+  std::memcpy(&header, data.data(), sizeof(header));
+  if(header.magic != kBc7CacheMagic || header.version != kBc7CacheVersion || header.mipCount == 0)
+    return false;
+
+  size_t offset = sizeof(header);
+  mips.resize(header.mipCount);
+  for(auto& mip : mips)
+  {
+    uint64_t size = 0;
+    if(offset + sizeof(size) > data.size())
+      return false;
+    std::memcpy(&size, data.data() + offset, sizeof(size));
+    offset += sizeof(size);
+    if(offset + size > data.size())
+      return false;
+    mip.assign(data.data() + offset, data.data() + offset + size);
+    offset += size;
+  }
+  extent = {header.width, header.height};
+  return true;
+}
+
+bool writeBc7Cache(const std::filesystem::path& path, VkExtent2D extent, const std::vector<std::vector<uint8_t>>& mips)
+{
+  Bc7CacheHeader header{.width = extent.width, .height = extent.height, .mipCount = static_cast<uint32_t>(mips.size())};
+  std::vector<char> data(reinterpret_cast<const char*>(&header), reinterpret_cast<const char*>(&header) + sizeof(header));
+  for(const auto& mip : mips)
+  {
+    const uint64_t size = mip.size();
+    data.insert(data.end(), reinterpret_cast<const char*>(&size), reinterpret_cast<const char*>(&size) + sizeof(size));
+    data.insert(data.end(), mip.begin(), mip.end());
+  }
+  return writeCacheFile(path, data.data(), data.size());
+}
+
+bool supportsBC7(VkPhysicalDevice physicalDevice)
+{
+  const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT
+                                      | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+  for(VkFormat format : {VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK})
+  {
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+    if((props.optimalTilingFeatures & needed) != needed)
+      return false;
+  }
+  return true;
+}
+}  // namespace
+
+
+gltfr::TextureStreamer::TextureStreamer(Resources& res, VkDeviceSize budget, bool compress)
+    : m_resources(res)
+    , m_device(res.ctx.device)
+    , m_queue(res.ctx.compute)
+    , m_alloc(std::make_unique<nvvk::ResourceAllocatorDma>(res.ctx.device, res.ctx.physicalDevice))
+    , m_budget(budget)
+    , m_compress(compress)
+{
+  if(m_compress && !supportsBC7(res.ctx.physicalDevice))
+  {
+    LOGW("BC7 is not supported by the device, textures are not compressed\n");
+    m_compress = false;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// The device must be idle
+//
+gltfr::TextureStreamer::~TextureStreamer()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  if(m_worker.joinable())
+    m_worker.join();
+
+  for(auto& retired : m_retired)
+    destroyImage(retired.first, retired.second);
+  for(auto& upload : m_completed)
+    destroyImage(upload.image, upload.view);
+  for(auto& image : m_images)
+    destroyImage(image.image, image.view);
+  for(VkSampler sampler : m_samplers)
+    m_alloc->releaseSampler(sampler);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Decode the images and generate their mip chain, in parallel, then create the images with their
+// lowest mips (all mips without budget). Returns false if one of the images cannot be decoded by
+// stb_image (KTX, DDS, ...).
+//
+bool gltfr::TextureStreamer::create(const tinygltf::Model& model, const std::filesystem::path& basedir)
+{
+  nvh::ScopedTimer st(__FUNCTION__);
+
+  if(model.textures.empty())
+    return false;
+
+  // Textures to images, and which images hold colors
+  m_images.resize(model.images.size());
+  m_imageTextures.resize(model.images.size());
+  m_textureImage.resize(model.textures.size());
+  for(size_t t = 0; t < model.textures.size(); t++)
+  {
+    const int source = model.textures[t].source;
+    if(source < 0 || source >= static_cast<int>(model.images.size()))
+      return false;  // Image given by an extension (KHR_texture_basisu, EXT_texture_webp, ...)
+    m_textureImage[t] = static_cast<uint32_t>(source);
+    m_imageTextures[source].push_back(static_cast<uint32_t>(t));
+  }
+
+  m_materialImages.resize(model.materials.size());
+  for(size_t m = 0; m < model.materials.size(); m++)
+  {
+    std::vector<std::pair<int, bool>> textures;
+    collectMaterialTextures(model.materials[m], textures);
+    for(const auto& [textureID, color] : textures)
+    {
+      if(textureID < 0 || textureID >= static_cast<int>(model.textures.size()))
+        continue;
+      const uint32_t imageID = m_textureImage[textureID];
+      m_images[imageID].srgb |= color;
+      if(std::find(m_materialImages[m].begin(), m_materialImages[m].end(), imageID) == m_materialImages[m].end())
+        m_materialImages[m].push_back(imageID);
+    }
+  }
+
+  // Decoding
+  std::vector<uint8_t> decoded(m_images.size(), 0);
+  nvh::parallel_batches<1>(
+      m_images.size(), [&](uint64_t i) { decoded[i] = decodeImage(model, model.images[i], basedir, m_images[i]) ? 1 : 0; },
+      std::max(1U, std::thread::hardware_concurrency()));
+  for(size_t i = 0; i < m_images.size(); i++)
+  {
+    if(!decoded[i])
+    {
+      LOGI("Image %zu (%s) cannot be streamed\n", i, model.images[i].uri.c_str());
+      return false;
+    }
+  }
+
+  // Creating the images with the lowest mips
+  VkDeviceSize      baseBytes = 0;
+  nvvk::CommandPool cmdPool(m_device, m_queue.familyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, m_queue.queue);
+  VkCommandBuffer   cmd = cmdPool.createCommandBuffer();
+  for(StreamedImage& image : m_images)
+  {
+    image.residentLevel = image.targetLevel = image.desiredLevel = image.baseLevel;
+    createImage(cmd, image, image.baseLevel, image.image, image.view);
+    baseBytes += levelBytes(image, image.baseLevel);
+  }
+  cmdPool.submitAndWait(cmd);
+  m_alloc->finalizeAndReleaseStaging();
+  if(m_budget > 0 && baseBytes > m_budget)
+    LOGW("Texture budget (%llu MB) smaller than the lowest mips of the images (%llu MB)\n",
+         static_cast<unsigned long long>(m_budget >> 20), static_cast<unsigned long long>(baseBytes >> 20));
+
+  // Samplers and descriptors
+  m_samplers.resize(model.textures.size());
+  m_descriptors.resize(model.textures.size());
+  for(size_t t = 0; t < model.textures.size(); t++)
+  {
+    m_samplers[t]    = m_alloc->acquireSampler(makeSamplerCreateInfo(model, model.textures[t]));
+    m_descriptors[t] = {m_samplers[t], m_images[m_textureImage[t]].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  }
+
+  m_lastSwap = std::chrono::steady_clock::now();
+  m_worker   = std::thread(&TextureStreamer::workerLoop, this);
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Decode an image to RGBA8 and generate all its mips, compressed to BC7 if enabled
+// The compressed mips are read from the cache when available, skipping the decoding.
+//
+bool gltfr::TextureStreamer::decodeImage(const tinygltf::Model&       model,
+                                         const tinygltf::Image&       gltfImage,
+                                         const std::filesystem::path& basedir,
+                                         StreamedImage&               image)
+{
+  std::vector<char> fileData;
+  const uint8_t*    encoded     = nullptr;
+  size_t            encodedSize = 0;
+  if(gltfImage.bufferView >= 0)
+  {
+    const tinygltf::BufferView& view = model.bufferViews[gltfImage.bufferView];
+    encoded                          = model.buffers[view.buffer].data.data() + view.byteOffset;
+    encodedSize                      = view.byteLength;
+  }
+  else if(!gltfImage.uri.empty() && gltfImage.uri.find("data:") != 0)
+  {
+    if(!readCacheFile(basedir / gltfImage.uri, fileData))
+      return false;
+    encoded     = reinterpret_cast<const uint8_t*>(fileData.data());
+    encodedSize = fileData.size();
+  }
+  else
+  {
+    return false;
+  }
+
+  // Compressed mips from a previous load
+  std::filesystem::path cachePath;
+  if(m_compress)
+  {
+    Hasher hasher;
+    hasher.add(encoded, encodedSize).add(image.srgb).add(kBc7CacheVersion);
+    cachePath        = getCacheDirectory() / ("bc7_" + hasher.toString() + ".bin");
+    image.compressed = readBc7Cache(cachePath, image.extent, image.mips);
+  }
+
+  if(!image.compressed)
+  {
+    int      width = 0, height = 0, channels = 0;
+    stbi_uc* pixels = stbi_load_from_memory(encoded, static_cast<int>(encodedSize), &width, &height, &channels, 4);
+    if(pixels == nullptr)
+      return false;
+
+    image.extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+    image.mips.assign(1, std::vector<uint8_t>(pixels, pixels + size_t(width) * height * 4));
+    stbi_image_free(pixels);
+
+    for(uint32_t level = 1; std::max(image.extent.width >> (level - 1), image.extent.height >> (level - 1)) > 1; level++)
+    {
+      image.mips.push_back(downsample(image.mips.back(), mipExtent(image.extent, level - 1), mipExtent(image.extent, level), image.srgb));
+    }
+
+    if(m_compress)
+    {
+      for(uint32_t level = 0; level < image.mips.size(); level++)
+      {
+        const VkExtent2D size = mipExtent(image.extent, level);
+        image.mips[level]     = compressBC7(image.mips[level].data(), size.width, size.height);
+      }
+      image.compressed = true;
+      if(!writeBc7Cache(cachePath, image.extent, image.mips))
+        LOGW("Could not write the compressed image to %s\n", cachePath.string().c_str());
+    }
+  }
+
+  // Lowest resident resolution, all mips are resident without streaming
+  while(m_budget > 0 && image.baseLevel + 1 < image.mips.size()
+        && std::max(mipExtent(image.extent, image.baseLevel).width, mipExtent(image.extent, image.baseLevel).height) > kBaseResolution)
+    image.baseLevel++;
+
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Create an image with the mips starting at 'level', and record the upload
+//
+void gltfr::TextureStreamer::createImage(VkCommandBuffer cmd, const StreamedImage& source, uint32_t level, nvvk::Image& image, VkImageView& view)
+{
+  const uint32_t    mipCount = static_cast<uint32_t>(source.mips.size()) - level;
+  const VkFormat    format   = source.compressed ? (source.srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK) :
+                                                     (source.srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM);
+  VkImageCreateInfo imageInfo =
+      nvvk::makeImage2DCreateInfo(mipExtent(source.extent, level), format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+  imageInfo.mipLevels = mipCount;
+  image               = m_alloc->createImage(imageInfo);
+
+  const VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount, 0, 1};
+  nvvk::cmdBarrierImageLayout(cmd, image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range);
+  for(uint32_t mip = 0; mip < mipCount; mip++)
+  {
+    const VkExtent2D               size = mipExtent(source.extent, level + mip);
+    const std::vector<uint8_t>&    data = source.mips[level + mip];
+    const VkImageSubresourceLayers subresource{VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1};
+    m_alloc->getStaging()->cmdToImage(cmd, image.image, {0, 0, 0}, {size.width, size.height, 1}, subresource, data.size(), data.data());
+  }
+  nvvk::cmdBarrierImageLayout(cmd, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range);
+
+  const VkImageViewCreateInfo viewInfo = nvvk::makeImageViewCreateInfo(image.image, imageInfo);
+  NVVK_CHECK(vkCreateImageView(m_device, &viewInfo, nullptr, &view));
+}
+
+void gltfr::TextureStreamer::destroyImage(nvvk::Image& image, VkImageView& view)
+{
+  vkDestroyImageView(m_device, view, nullptr);
+  m_alloc->destroy(image);
+  view = VK_NULL_HANDLE;
+}
+
+VkDeviceSize gltfr::TextureStreamer::levelBytes(const StreamedImage& image, uint32_t level) const
+{
+  VkDeviceSize bytes = 0;
+  for(size_t mip = level; mip < image.mips.size(); mip++)
+    bytes += image.mips[mip].size();
+  return bytes;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Memory used by the images, including the ones being streamed in
+//
+VkDeviceSize gltfr::TextureStreamer::residentBytes() const
+{
+  VkDeviceSize bytes = 0;
+  for(const StreamedImage& image : m_images)
+    bytes += levelBytes(image, std::min(image.residentLevel, image.targetLevel));
+  return bytes;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Per frame update
+// - Read the feedback: which resolution the images of each material need
+// - Swap the images which finished streaming, in the descriptors
+// - Request the images to stream, evicting the least recently used ones if over budget
+//
+bool gltfr::TextureStreamer::update(uint32_t* feedback, uint32_t feedbackCount, std::vector<uint32_t>& changedTextures)
+{
+  m_updateCount++;
+
+  const uint32_t numMaterials = std::min(feedbackCount, static_cast<uint32_t>(m_materialImages.size()));
+  for(uint32_t m = 0; m < numMaterials; m++)
+  {
+    const uint32_t value = feedback[m];
+    if(value == 0)
+      continue;
+    feedback[m] = 0;
+
+    const uint32_t log2Resolution = value - 1;
+    for(uint32_t imageID : m_materialImages[m])
+    {
+      StreamedImage& image   = m_images[imageID];
+      const uint32_t maxSize = std::max(image.extent.width, image.extent.height);
+      const uint32_t log2Max = static_cast<uint32_t>(std::ceil(std::log2(static_cast<float>(maxSize))));
+      const uint32_t level   = std::min(image.baseLevel, log2Max > log2Resolution ? log2Max - log2Resolution : 0U);
+
+      image.desiredLevel = image.lastUsed == m_updateCount ? std::min(image.desiredLevel, level) : level;
+      image.lastUsed     = m_updateCount;
+    }
+  }
+
+  // Swapping the streamed images: the scene writes a new descriptor set, at most every kSwapInterval
+  // or when all requests are done. The previous images are destroyed by the worker once the frames
+  // in flight, which can still sample them, are done.
+  bool                swapped = false;
+  std::vector<Upload> completed;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto                  now = std::chrono::steady_clock::now();
+    if(!m_completed.empty() && (m_completed.size() == m_numInFlight || now - m_lastSwap > kSwapInterval))
+    {
+      completed.swap(m_completed);
+      m_lastSwap = now;
+    }
+  }
+  m_cv.notify_all();
+  if(!completed.empty())
+  {
+    std::vector<std::pair<nvvk::Image, VkImageView>> retired;
+    for(Upload& upload : completed)
+    {
+      StreamedImage& image = m_images[upload.imageID];
+      retired.emplace_back(image.image, image.view);
+      image.image         = upload.image;
+      image.view          = upload.view;
+      image.residentLevel = upload.level;
+      image.targetLevel   = upload.level;
+      for(uint32_t textureID : m_imageTextures[upload.imageID])
+      {
+        m_descriptors[textureID].imageView = image.view;
+        changedTextures.push_back(textureID);
+      }
+    }
+    m_numInFlight -= static_cast<uint32_t>(completed.size());
+    // The streamer is retired after this function when the scene changes, see Scene::commitPendingScene
+    m_resources.retire([this, retired = std::move(retired)]() {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_retired.insert(m_retired.end(), retired.begin(), retired.end());
+      }
+      m_cv.notify_all();
+    });
+    swapped = true;
+  }
+
+  planRequests();
+
+  return swapped;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Choose the images to stream in, most recently used first. When the budget would be exceeded,
+// images not used for a while go back to their base level, and the request waits for their
+// memory to be released.
+//
+void gltfr::TextureStreamer::planRequests()
+{
+  if(m_numInFlight >= kMaxInFlight)
+    return;
+
+  std::vector<uint32_t> candidates;
+  for(uint32_t i = 0; i < m_images.size(); i++)
+  {
+    const StreamedImage& image = m_images[i];
+    if(image.targetLevel == image.residentLevel && image.desiredLevel < image.residentLevel)
+      candidates.push_back(i);
+  }
+  if(candidates.empty())
+    return;
+  std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+    if(m_images[a].lastUsed != m_images[b].lastUsed)
+      return m_images[a].lastUsed > m_images[b].lastUsed;
+    return m_images[a].residentLevel - m_images[a].desiredLevel > m_images[b].residentLevel - m_images[b].desiredLevel;
+  });
+
+  VkDeviceSize used = residentBytes();
+  for(uint32_t imageID : candidates)
+  {
+    if(m_numInFlight >= kMaxInFlight)
+      break;
+    StreamedImage& image = m_images[imageID];
+
+    // The highest resolution fitting the budget
+    uint32_t level = image.desiredLevel;
+    while(level < image.residentLevel && used + levelBytes(image, level) - levelBytes(image, image.residentLevel) > m_budget)
+      level++;
+
+    if(level > image.desiredLevel)
+    {
+      // Evict the least recently used image, requested again at the next update
+      uint32_t victim = ~0U;
+      for(uint32_t i = 0; i < m_images.size(); i++)
+      {
+        const StreamedImage& other = m_images[i];
+        if(other.targetLevel == other.residentLevel && other.residentLevel < other.baseLevel
+           && other.lastUsed + kEvictAge < m_updateCount && (victim == ~0U || other.lastUsed < m_images[victim].lastUsed))
+          victim = i;
+      }
+      if(victim != ~0U)
+      {
+        m_images[victim].desiredLevel = m_images[victim].baseLevel;
+        request(victim, m_images[victim].baseLevel);
+        continue;
+      }
+    }
+
+    if(level < image.residentLevel)
+    {
+      used += levelBytes(image, level) - levelBytes(image, image.residentLevel);
+      request(imageID, level);
+    }
+  }
+}
+
+void gltfr::TextureStreamer::request(uint32_t imageID, uint32_t level)
+{
+  m_images[imageID].targetLevel = level;
+  m_numInFlight++;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_requests.push_back({imageID, level});
+  }
+  m_cv.notify_all();
+}
+
+void gltfr::TextureStreamer::suspend()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_suspended = true;
+  m_cv.wait(lock, [&] { return !m_busy; });
+}
+
+void gltfr::TextureStreamer::resume()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_suspended = false;
+  }
+  m_cv.notify_all();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Worker thread: destroy the images no longer used, and create the requested ones
+//
+void gltfr::TextureStreamer::workerLoop()
+{
+  nvvk::CommandPool cmdPool(m_device, m_queue.familyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, m_queue.queue);
+
+  while(true)
+  {
+    Request                                          req;
+    bool                                             hasRequest = false;
+    std::vector<std::pair<nvvk::Image, VkImageView>> retired;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [&] { return m_stop || !m_retired.empty() || (!m_suspended && !m_requests.empty()); });
+      if(m_stop)
+        break;
+      retired.swap(m_retired);
+      if(!m_suspended && !m_requests.empty())
+      {
+        req = m_requests.front();
+        m_requests.pop_front();
+        hasRequest = true;
+        m_busy     = true;
+      }
+    }
+
+    for(auto& [image, view] : retired)
+      destroyImage(image, view);
+    if(!hasRequest)
+      continue;
+
+    Upload upload{.imageID = req.imageID, .level = req.level};
+    VkCommandBuffer cmd = cmdPool.createCommandBuffer();
+    createImage(cmd, m_images[req.imageID], req.level, upload.image, upload.view);
+    cmdPool.submitAndWait(cmd);
+    m_alloc->finalizeAndReleaseStaging();
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_completed.push_back(upload);
+      m_busy = false;
+    }
+    m_cv.notify_all();
+  }
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Streaming of the scene textures under a GPU memory budget
+
+  - The images are decoded and their mip chain generated on the CPU, only the
+    low resolution mips are created on the GPU at first.
+  - The shaders write, per material, the resolution they need (texture_feedback.h).
+    The images of the materials seen are streamed to that resolution, on a worker
+    thread using its own allocator and the compute queue.
+  - When the budget is reached, the least recently used images go back to their
+    low resolution.
+  - Streamed images replace the previous ones in the descriptor array, which the scene
+    writes in a new descriptor set: the frames in flight still sample the current one.
+    The previous images are retired (Resources::retire), the render queue is not waited for.
+
+  Only images which can be decoded to RGBA8 are streamed (PNG, JPEG, ...). For other
+  images, create() fails and the textures are created by SceneVk.
+
+  With a budget of 0, nothing is streamed: all images are created at full resolution.
+
+  With compression, the mips are compressed to BC7 (bc7_encoder.hpp) and stored in
+  the cache directory, keyed by the hash of the encoded image. Later loads read the
+  compressed mips instead of decoding the image.
+
+*/
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// nvpro-core
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "resources.hpp"
+#include "tiny_gltf.h"
+
+namespace gltfr {
+
+class TextureStreamer
+{
+public:
+  // - budget: GPU memory for the images, 0 to create them at full resolution
+  // - compress: BC7 images, ignored if the device doesn't support them
+  TextureStreamer(Resources& res, VkDeviceSize budget, bool compress);
+  ~TextureStreamer();
+
+  // Decode the images and create the low resolution textures (loader thread)
+  // Returns false if an image cannot be streamed.
+  bool create(const tinygltf::Model& model, const std::filesystem::path& basedir);
+
+  // Called by the main thread at each frame
+  // - feedback: 1 + log2 of the resolution requested by each material, cleared once read
+  // Returns true when textures were replaced, 'changedTextures' has their indices.
+  bool update(uint32_t* feedback, uint32_t feedbackCount, std::vector<uint32_t>& changedTextures);
+
+  // Wait for the current upload and stop streaming, while the compute queue is used elsewhere
+  void suspend();
+  void resume();
+
+  const std::vector<VkDescriptorImageInfo>& descriptors() const { return m_descriptors; }
+  VkDeviceSize                              residentBytes() const;
+  VkDeviceSize                              budget() const { return m_budget; }
+
+private:
+  struct StreamedImage
+  {
+    std::vector<std::vector<uint8_t>> mips;  // RGBA8 or BC7 mip chain, level 0 is the full resolution
+    VkExtent2D                        extent{};
+    bool                              srgb{false};
+    bool                              compressed{false};
+    uint32_t                          baseLevel{0};      // Always resident, the lowest resolution
+    uint32_t                          residentLevel{0};  // First mip level on the GPU
+    uint32_t                          targetLevel{0};    // Level being streamed, same as resident when idle
+    uint32_t                          desiredLevel{0};   // From the feedback
+    uint64_t                          lastUsed{0};       // Update in which the image was last requested
+    nvvk::Image                       image;
+    VkImageView                       view{VK_NULL_HANDLE};
+  };
+
+  struct Request
+  {
+    uint32_t imageID{};
+    uint32_t level{};
+  };
+
+  struct Upload
+  {
+    uint32_t    imageID{};
+    uint32_t    level{};
+    nvvk::Image image;
+    VkImageView view{VK_NULL_HANDLE};
+  };
+
+  bool         decodeImage(const tinygltf::Model& model, const tinygltf::Image& gltfImage, const std::filesystem::path& basedir, StreamedImage& image);
+  void         createImage(VkCommandBuffer cmd, const StreamedImage& source, uint32_t level, nvvk::Image& image, VkImageView& view);
+  void         destroyImage(nvvk::Image& image, VkImageView& view);
+  void         planRequests();
+  void         request(uint32_t imageID, uint32_t level);
+  VkDeviceSize levelBytes(const StreamedImage& image, uint32_t level) const;
+  void         workerLoop();
+
+  Resources&                                  m_resources;  // Retires the replaced images
+  VkDevice                                    m_device{VK_NULL_HANDLE};
+  Queue                                       m_queue;  // Uploads, compute queue
+  std::unique_ptr<nvvk::ResourceAllocatorDma> m_alloc;  // Only used by the worker, after create()
+  VkDeviceSize                                m_budget{0};
+  bool                                        m_compress{false};
+
+  std::vector<StreamedImage>         m_images;
+  std::vector<uint32_t>              m_textureImage;    // Image of each texture
+  std::vector<std::vector<uint32_t>> m_imageTextures;   // Textures using each image
+  std::vector<std::vector<uint32_t>> m_materialImages;  // Images used by each material
+  std::vector<VkSampler>             m_samplers;        // One per texture
+  std::vector<VkDescriptorImageInfo> m_descriptors;     // One per texture
+  uint64_t                           m_updateCount{0};
+  uint32_t                           m_numInFlight{0};
+
+  std::chrono::steady_clock::time_point m_lastSwap{};
+
+  // Shared with the worker
+  std::mutex                                       m_mutex;
+  std::condition_variable                          m_cv;
+  std::deque<Request>                              m_requests;
+  std::vector<Upload>                              m_completed;
+  std::vector<std::pair<nvvk::Image, VkImageView>> m_retired;  // No longer in use by the frames, destroyed by the worker
+  bool                                             m_stop{false};
+  bool                                             m_suspended{false};
+  bool                                             m_busy{false};
+  std::thread                                      m_worker;
+};
+
+}  // namespace gltfr
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "upload_ring.hpp"
+
+// nvpro-core
+#include "nvvk/debug_util_vk.hpp"
+
+namespace {
+constexpr VkDeviceSize kCopyAlignment = 16;
+}
+
+void gltfr::UploadRing::init(nvvk::ResourceAllocator* alloc, VkDeviceSize frameSize, uint32_t numFrames)
+{
+  m_alloc     = alloc;
+  m_numFrames = std::max(numFrames, 1U);
+  m_frameSize = (frameSize + kCopyAlignment - 1) & ~(kCopyAlignment - 1);
+  m_buffer    = m_alloc->createBuffer(m_frameSize * m_numFrames, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  nvvk::DebugUtil(m_alloc->getDevice()).DBG_NAME(m_buffer.buffer);
+  m_mapped = static_cast<uint8_t*>(m_alloc->map(m_buffer));
+  m_frame  = 0;
+  m_offset = 0;
+}
+
+void gltfr::UploadRing::deinit()
+{
+  if(m_alloc == nullptr)
+    return;
+  m_alloc->unmap(m_buffer);
+  m_alloc->destroy(m_buffer);
+  m_mapped = nullptr;
+  m_alloc  = nullptr;
+  m_pending.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Called once per frame, before the first copy
+//
+void gltfr::UploadRing::beginFrame()
+{
+  m_frame  = (m_frame + 1) % m_numFrames;
+  m_offset = 0;
+  m_pending.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Stage 'size' bytes for 'dst' at 'dstOffset'. Contiguous regions of the same buffer are merged.
+//
+bool gltfr::UploadRing::copy(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+  if(m_offset + size > m_frameSize)
+    return false;
+
+  const VkDeviceSize srcOffset = m_frame * m_frameSize + m_offset;
+  std::memcpy(m_mapped + srcOffset, data, size);
+  m_offset = (m_offset + size + kCopyAlignment - 1) & ~(kCopyAlignment - 1);
+  m_offset = std::min(m_offset, m_frameSize);
+
+  if(m_pending.empty() || m_pending.back().first != dst)
+    m_pending.emplace_back(dst, std::vector<VkBufferCopy>{});
+  std::vector<VkBufferCopy>& regions = m_pending.back().second;
+  if(!regions.empty() && regions.back().srcOffset + regions.back().size == srcOffset
+     && regions.back().dstOffset + regions.back().size == dstOffset)
+    regions.back().size += size;
+  else
+    regions.push_back({srcOffset, dstOffset, size});
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Record the copies of the frame, and make them visible to the shaders and AS builds
+//
+void gltfr::UploadRing::flush(VkCommandBuffer cmd)
+{
+  if(m_pending.empty())
+    return;
+
+  for(const auto& [dst, regions] : m_pending)
+    vkCmdCopyBuffer(cmd, m_buffer.buffer, dst, static_cast<uint32_t>(regions.size()), regions.data());
+  m_pending.clear();
+
+  const VkMemoryBarrier2 barrier{
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+      .srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+      .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      .dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_UNIFORM_READ_BIT,
+  };
+  const VkDependencyInfo dependencyInfo{
+      .sType              = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .memoryBarrierCount = 1,
+      .pMemoryBarriers    = &barrier,
+  };
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Persistently mapped staging ring for the small per-frame updates
+
+  - The buffer is split in one segment per frame in flight; beginFrame() moves to
+    the next segment, which the GPU is done reading.
+  - copy() writes the data to the segment and queues a copy region for the
+    destination buffer. flush() records one vkCmdCopyBuffer per destination and a
+    barrier making the data visible to the shaders.
+  - copy() returns false when the segment is full, the caller is expected to fall
+    back to a regular upload.
+
+*/
+
+#include <utility>
+#include <vector>
+
+// nvpro-core
+#include "nvvk/resourceallocator_vk.hpp"
+
+namespace gltfr {
+
+class UploadRing
+{
+public:
+  // 'numFrames': frames in flight (Resources), a segment is reused after that many frames
+  void init(nvvk::ResourceAllocator* alloc, VkDeviceSize frameSize, uint32_t numFrames);
+  void deinit();
+
+  void beginFrame();
+  bool copy(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+  void flush(VkCommandBuffer cmd);
+
+  VkDeviceSize frameSize() const { return m_frameSize; }
+  VkDeviceSize usedBytes() const { return m_offset; }
+
+private:
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  nvvk::Buffer             m_buffer;
+  uint8_t*                 m_mapped{nullptr};
+  VkDeviceSize             m_frameSize{0};
+  uint32_t                 m_numFrames{1};
+  uint32_t                 m_frame{0};
+  VkDeviceSize             m_offset{0};  // In the current segment
+
+  std::vector<std::pair<VkBuffer, std::vector<VkBufferCopy>>> m_pending;  // Regions per destination
+};
+
+}  // namespace gltfr
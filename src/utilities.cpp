@@ -20,7 +20,14 @@
 
 #include "utilities.hpp"
 #include "vulkan/vulkan_core.h"
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <glm/glm.hpp>
+#include "stb_image.h"
 #include "stb_image_write.h"
 #include "nvh/nvprint.hpp"
 #include "nvvk/images_vk.hpp"
@@ -116,28 +123,317 @@ void gltfr::saveImageToFile(VkDevice device, VkImage dstImage, VkDeviceMemory ds
     data += subResourceLayout.rowPitch;
   }
 
+  writeRgba8Image(filename, size, pixels.data(), quality);
+}
+
+
+bool gltfr::writeRgba8Image(const std::string& filename, VkExtent2D size, const uint8_t* pixels, int quality)
+{
   std::filesystem::path path      = filename;
   std::string           extension = path.extension().string();
+  int                   result    = 0;
 
   // Check the extension and perform actions accordingly
   if(extension == ".png")
   {
-    stbi_write_png(filename.c_str(), size.width, size.height, 4, pixels.data(), size.width * 4);
+    result = stbi_write_png(filename.c_str(), size.width, size.height, 4, pixels, size.width * 4);
   }
   else if(extension == ".jpg" || extension == ".jpeg")
   {
-    stbi_write_jpg(filename.c_str(), size.width, size.height, 4, pixels.data(), quality);
+    result = stbi_write_jpg(filename.c_str(), size.width, size.height, 4, pixels, quality);
   }
   else if(extension == ".bmp")
   {
-    stbi_write_bmp(filename.c_str(), size.width, size.height, 4, pixels.data());
+    result = stbi_write_bmp(filename.c_str(), size.width, size.height, 4, pixels);
   }
   else
   {
     LOGW("Screenshot: unknown file extension, saving as PNG\n");
     path += ".png";
-    stbi_write_png(path.string().c_str(), size.width, size.height, 4, pixels.data(), size.width * 4);
+    result = stbi_write_png(path.string().c_str(), size.width, size.height, 4, pixels, size.width * 4);
+  }
+
+  if(result == 0)
+  {
+    LOGE("Could not write %s\n", path.string().c_str());
+    return false;
+  }
+  LOGI("Image saved to %s\n", path.string().c_str());
+  return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Scanline OpenEXR, without compression: the header, the offsets of the lines, then each line
+// with its channels in alphabetical order (A, B, G, R). The samples of the accumulation are an
+// attribute of the header.
+//
+static bool writeExr(const std::string& filename, VkExtent2D size, const float* pixels, uint32_t samples)
+{
+  std::vector<char> data;
+  auto              put = [&](const auto& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    data.insert(data.end(), bytes, bytes + sizeof(value));
+  };
+  auto putString = [&](const char* str) { data.insert(data.end(), str, str + strlen(str) + 1); };
+  auto attribute = [&](const char* name, const char* type, int32_t bytes) {
+    putString(name);
+    putString(type);
+    put(bytes);
+  };
+
+  const int32_t maxX = int32_t(size.width) - 1;
+  const int32_t maxY = int32_t(size.height) - 1;
+
+  put(int32_t(20000630));  // Magic number
+  put(int32_t(2));         // Version 2, scanlines
+
+  const char* channels[] = {"A", "B", "G", "R"};
+  attribute("channels", "chlist", 4 * 18 + 1);
+  for(const char* channel : channels)
+  {
+    putString(channel);
+    put(int32_t(2));  // FLOAT
+    put(int32_t(0));  // pLinear, reserved
+    put(int32_t(1));  // x and y sampling
+    put(int32_t(1));
+  }
+  data.push_back(0);
+  attribute("compression", "compression", 1);
+  data.push_back(0);  // NO_COMPRESSION
+  attribute("dataWindow", "box2i", 16);
+  put(glm::ivec4(0, 0, maxX, maxY));
+  attribute("displayWindow", "box2i", 16);
+  put(glm::ivec4(0, 0, maxX, maxY));
+  attribute("lineOrder", "lineOrder", 1);
+  data.push_back(0);  // INCREASING_Y
+  attribute("pixelAspectRatio", "float", 4);
+  put(1.0F);
+  attribute("screenWindowCenter", "v2f", 8);
+  put(glm::vec2(0.0F));
+  attribute("screenWindowWidth", "float", 4);
+  put(1.0F);
+  if(samples > 0)
+  {
+    attribute("samples", "int", 4);
+    put(int32_t(samples));
+  }
+  data.push_back(0);  // End of the header
+
+  const int32_t  lineBytes  = int32_t(size.width * 4 * sizeof(float));
+  const uint64_t firstLine  = data.size() + size.height * sizeof(uint64_t);
+  const uint64_t blockBytes = 2 * sizeof(int32_t) + lineBytes;
+  for(uint64_t y = 0; y < size.height; y++)
+    put(firstLine + y * blockBytes);
+
+  data.reserve(firstLine + size.height * blockBytes);
+  for(int32_t y = 0; y <= maxY; y++)
+  {
+    put(y);
+    put(lineBytes);
+    const float* line = pixels + size_t(y) * size.width * 4;
+    for(int c = 3; c >= 0; c--)
+    {
+      for(uint32_t x = 0; x < size.width; x++)
+        put(line[x * 4 + c]);
+    }
+  }
+
+  std::ofstream file(filename, std::ios::binary);
+  file.write(data.data(), std::streamsize(data.size()));
+  return file.good();
+}
+
+
+bool gltfr::writeRgba32fImage(const std::string& filename, VkExtent2D size, const float* pixels, uint32_t samples)
+{
+  std::filesystem::path path      = filename;
+  std::string           extension = path.extension().string();
+  bool                  result    = false;
+
+  if(extension == ".hdr")
+  {
+    result = stbi_write_hdr(filename.c_str(), size.width, size.height, 4, pixels) != 0;
+  }
+  else
+  {
+    if(extension != ".exr")
+    {
+      LOGW("Screenshot: unknown file extension, saving as EXR\n");
+      path += ".exr";
+    }
+    result = writeExr(path.string(), size, pixels, samples);
+  }
+
+  if(!result)
+  {
+    LOGE("Could not write %s\n", path.string().c_str());
+    return false;
+  }
+  LOGI("Image saved to %s\n", path.string().c_str());
+  return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Scanline OpenEXR without compression, with float channels: the layout of writeExr()
+//
+static bool readExr(const std::string& filename, VkExtent2D& size, std::vector<float>& pixels, uint32_t& samples)
+{
+  std::ifstream file(filename, std::ios::binary);
+  std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  size_t            pos = 0;
+  auto              get = [&](auto& value) {
+    if(pos + sizeof(value) > data.size())
+      return false;
+    memcpy(&value, data.data() + pos, sizeof(value));
+    pos += sizeof(value);
+    return true;
+  };
+  auto getString = [&]() {
+    std::string str;
+    while(pos < data.size() && data[pos] != 0)
+      str += data[pos++];
+    pos++;
+    return str;
+  };
+
+  int32_t magic = 0, version = 0;
+  if(!get(magic) || !get(version) || magic != 20000630 || (version & 0xff) != 2 || (version & ~0xff) != 0)
+    return false;
+
+  // Channels in the order of the file, to their index in RGBA
+  std::vector<int> channels;
+  glm::ivec4       window{0, 0, -1, -1};
+  bool             supported = true;
+  for(std::string name = getString(); !name.empty() && pos < data.size(); name = getString())
+  {
+    const std::string type  = getString();
+    int32_t           bytes = 0;
+    get(bytes);
+    const size_t next = pos + bytes;
+    if(name == "channels")
+    {
+      for(std::string channel = getString(); !channel.empty() && pos < next; channel = getString())
+      {
+        int32_t pixelType = 0;
+        get(pixelType);
+        pos += 12;  // pLinear, reserved, sampling
+        const size_t rgba = std::string("RGBA").find(channel);
+        supported &= (pixelType == 2) && (rgba != std::string::npos);
+        channels.push_back(int(rgba));
+      }
+    }
+    else if(name == "compression")
+      supported &= data[pos] == 0;
+    else if(name == "dataWindow")
+      get(window);
+    else if(name == "samples" && type == "int")
+    {
+      int32_t value = 0;
+      get(value);
+      samples = uint32_t(std::max(value, 0));
+    }
+    pos = next;
+  }
+  if(!supported || channels.empty() || window.z < window.x || window.w < window.y)
+    return false;
+
+  size         = {uint32_t(window.z - window.x + 1), uint32_t(window.w - window.y + 1)};
+  const size_t lineFloats = size_t(size.width) * channels.size();
+  pixels.assign(size_t(size.width) * size.height * 4, 1.0F);  // No alpha: opaque
+  for(uint32_t y = 0; y < size.height; y++)
+  {
+    uint64_t offset = 0;
+    get(offset);
+    if(offset + 8 + lineFloats * sizeof(float) > data.size())
+      return false;
+    const char* line = data.data() + offset + 8;  // After the y and the size of the line
+    float*      dst  = pixels.data() + size_t(y) * size.width * 4;
+    for(size_t c = 0; c < channels.size(); c++)
+    {
+      for(uint32_t x = 0; x < size.width; x++)
+        memcpy(&dst[x * 4 + channels[c]], line + (c * size.width + x) * sizeof(float), sizeof(float));
+    }
+  }
+  return true;
+}
+
+
+bool gltfr::readRgba32fImage(const std::string& filename, VkExtent2D& size, std::vector<float>& pixels, uint32_t* samples)
+{
+  bool     result      = false;
+  uint32_t fileSamples = 0;
+  if(std::filesystem::path(filename).extension() == ".hdr")
+  {
+    int    width = 0, height = 0, channels = 0;
+    float* data = stbi_loadf(filename.c_str(), &width, &height, &channels, 4);
+    if(data != nullptr)
+    {
+      size = {uint32_t(width), uint32_t(height)};
+      pixels.assign(data, data + size_t(width) * height * 4);
+      stbi_image_free(data);
+      result = true;
+    }
+  }
+  else
+  {
+    result = readExr(filename, size, pixels, fileSamples);
+  }
+  if(samples != nullptr)
+    *samples = fileSamples;
+
+  if(!result)
+    LOGE("Could not read %s, expecting an uncompressed float EXR or an HDR\n", filename.c_str());
+  return result;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Each share is weighted by its samples per pixel, the shares can stop after different numbers
+// of frames. When one of them has no sample count (HDR, other writers), all are averaged.
+//
+bool gltfr::mergeRgba32fImages(const std::vector<std::string>& inputs, const std::string& output)
+{
+  VkExtent2D         size{};
+  std::vector<float> weighted;  // By the samples of each share
+  std::vector<float> sum;
+  std::vector<float> pixels;
+  uint64_t           totalSamples = 0;
+  bool               allSamples   = true;
+  for(const std::string& input : inputs)
+  {
+    VkExtent2D inputSize{};
+    uint32_t   samples = 0;
+    if(!readRgba32fImage(input, inputSize, pixels, &samples))
+      return false;
+    if(sum.empty())
+    {
+      size = inputSize;
+      sum.assign(pixels.size(), 0.0F);
+      weighted.assign(pixels.size(), 0.0F);
+    }
+    else if(inputSize.width != size.width || inputSize.height != size.height)
+    {
+      LOGE("Merge: %s is %ux%u, expecting %ux%u\n", input.c_str(), inputSize.width, inputSize.height, size.width, size.height);
+      return false;
+    }
+    allSamples &= samples > 0;
+    totalSamples += samples;
+    for(size_t i = 0; i < sum.size(); i++)
+    {
+      sum[i] += pixels[i];
+      weighted[i] += float(samples) * pixels[i];
+    }
   }
+  if(sum.empty())
+    return false;
+  if(!allSamples)
+    LOGW("Merge: some images have no sample count, the shares are averaged\n");
 
-  LOGI("Image saved to %s\n", filename.c_str());
+  std::vector<float>& result = allSamples ? weighted : sum;
+  const float         weight = allSamples ? float(1.0 / double(totalSamples)) : 1.0F / float(inputs.size());
+  for(float& value : result)
+    value *= weight;
+  return writeRgba32fImage(output, size, result.data(), allSamples ? uint32_t(totalSamples) : 0);
 }
@@ -18,7 +18,9 @@
  */
 
 #pragma once
+#include <cstdint>
 #include <string>
+#include <vector>
 #include "vulkan/vulkan_core.h"
 namespace gltfr {
 void imageToRgba8Linear(VkCommandBuffer  cmd,
@@ -31,4 +33,17 @@ void imageToRgba8Linear(VkCommandBuffer  cmd,
 
 void saveImageToFile(VkDevice device, VkImage dstImage, VkDeviceMemory dstImageMemory, VkExtent2D size, const std::string& filename, int quality = 100);
 
+// Encode tightly packed pixels, from the extension of the file
+// RGBA8: PNG, JPEG or BMP (PNG otherwise). RGBA32F: OpenEXR (uncompressed, 32-bit float) or Radiance HDR.
+bool writeRgba8Image(const std::string& filename, VkExtent2D size, const uint8_t* pixels, int quality = 100);
+// 'samples': samples per pixel of the accumulation, stored in the EXR header when not zero
+bool writeRgba32fImage(const std::string& filename, VkExtent2D size, const float* pixels, uint32_t samples = 0);
+
+// RGBA32F of an EXR written by writeRgba32fImage (uncompressed float channels), or of an HDR
+// 'samples': the samples per pixel of the header, zero when absent
+bool readRgba32fImage(const std::string& filename, VkExtent2D& size, std::vector<float>& pixels, uint32_t* samples = nullptr);
+
+// Distributed rendering: the average of the accumulations of the shares, weighted by their samples per pixel
+bool mergeRgba32fImages(const std::vector<std::string>& inputs, const std::string& output);
+
 }  // namespace gltfr
\ No newline at end of file
@@ -102,6 +102,7 @@ struct VkContextSettings
   std::vector<const char*> instanceExtensions = {};  // Instance extensions: VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
   std::vector<ExtensionFeaturePair> deviceExtensions = {};  // Device extensions: {{VK_KHR_SWAPCHAIN_EXTENSION_NAME}, {VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME, &accelFeature}, {OTHER}}
   std::vector<VkQueueFlags> queues = {VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT};  // All desired queues, first is always GTC
+  std::vector<VkQueueFlags> optionalQueues = {};  // After 'queues', their QueueInfo has a null queue when none is left
   void*       instanceCreateInfoExt = nullptr;      // Instance create info extension (ex: VkLayerSettingsCreateInfoEXT)
   const char* applicationName       = "No Engine";  // Application name
   uint32_t    apiVersion            = VK_API_VERSION_1_3;  // Vulkan API version
@@ -311,6 +312,7 @@ private:
 
     // Find the queues that we need
     m_desiredQueues = m_settings.queues;
+    m_desiredQueues.insert(m_desiredQueues.end(), m_settings.optionalQueues.begin(), m_settings.optionalQueues.end());
     if(!findQueueFamilies())
     {
       m_physicalDevice = {};
@@ -362,7 +364,10 @@ private:
       assert(!"failed to create logical device!");
 
     for(auto& queue : m_queueInfos)
-      vkGetDeviceQueue(m_device, queue.familyIndex, queue.queueIndex, &queue.queue);
+    {
+      if(queue.familyIndex != ~0U)  // Optional queues which are not available
+        vkGetDeviceQueue(m_device, queue.familyIndex, queue.queueIndex, &queue.queue);
+    }
   }
 
   void prependFeatures(VkBaseOutStructure* baseStruct, VkBaseOutStructure* prependStruct)
@@ -457,6 +462,14 @@ private:
         }
       }
 
+      if(!found && i >= m_settings.queues.size())
+      {
+        // The device is created without it, the queue of its QueueInfo stays null
+        LOGW("Optional queue %zu is not available\n", i);
+        m_queueInfos.push_back({});
+        continue;
+      }
+
       if(!found)
       {
         // If no suitable queue family is found, assert a failure
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cstddef>
+
+#include "wavefront_pathtracer.hpp"
+#include "shaders/scene_features.h"
+
+// nvpro-core
+#include "nvh/nvprint.hpp"
+#include "nvh/timesampler.hpp"
+#include "nvvk/buffers_vk.hpp"
+#include "nvvk/debug_util_vk.hpp"
+#include "nvvk/error_vk.hpp"
+#include "nvvk/specialization.hpp"
+
+namespace {
+constexpr VkBufferUsageFlags kStorageUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+constexpr const char* kStageNames[WAVEFRONT_STAGE_COUNT] = {"Generate", "Extend", "Sort",   "Scatter",
+                                                            "Shade",    "Queues", "Shadow", "Resolve"};
+
+void memoryBarrier(VkCommandBuffer cmd, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+  const VkMemoryBarrier2 barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                 .srcStageMask  = srcStage,
+                                 .srcAccessMask = srcAccess,
+                                 .dstStageMask  = dstStage,
+                                 .dstAccessMask = dstAccess};
+  const VkDependencyInfo dependencyInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &barrier};
+  vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+
+// Each kernel reads what the previous one wrote, including the dispatch sizes
+void computeBarrier(VkCommandBuffer cmd)
+{
+  memoryBarrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+                VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+}
+
+uint32_t groupCount(uint32_t count)
+{
+  return (count + WAVEFRONT_WORKGROUP_SIZE - 1) / WAVEFRONT_WORKGROUP_SIZE;
+}
+}  // namespace
+
+//--------------------------------------------------------------------------------------------------
+// One pipeline per kernel, from the same module with a different specialization
+//
+bool gltfr::WavefrontPathtracer::init(Resources&                                res,
+                                      VkShaderModule                            module,
+                                      const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                      uint32_t                                  shaderFeatures)
+{
+  nvh::ScopedTimer st(__FUNCTION__);
+
+  m_alloc  = res.m_allocator.get();
+  m_device = res.ctx.device;
+
+  const VkPushConstantRange        pushConstantRange{.stageFlags = VK_SHADER_STAGE_ALL, .offset = 0, .size = sizeof(PushConstant)};
+  const VkPipelineLayoutCreateInfo layoutInfo{.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                                              .setLayoutCount         = static_cast<uint32_t>(setLayouts.size()),
+                                              .pSetLayouts            = setLayouts.data(),
+                                              .pushConstantRangeCount = 1,
+                                              .pPushConstantRanges    = &pushConstantRange};
+  NVVK_CHECK(vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_layout));
+
+  // The specializations must outlive the create infos
+  std::vector<nvvk::Specialization>        specializations(WAVEFRONT_STAGE_COUNT);
+  std::vector<VkComputePipelineCreateInfo> pipelineInfos(WAVEFRONT_STAGE_COUNT);
+  for(uint32_t stage = 0; stage < WAVEFRONT_STAGE_COUNT; stage++)
+  {
+    specializations[stage].add(0, static_cast<int32_t>(stage));
+    specializations[stage].add(SCENE_FEATURES_CONSTANT_ID, static_cast<int32_t>(shaderFeatures));
+    pipelineInfos[stage] = {
+        .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage  = {.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                   .stage               = VK_SHADER_STAGE_COMPUTE_BIT,
+                   .module              = module,
+                   .pName               = "main",
+                   .pSpecializationInfo = specializations[stage].getSpecialization()},
+        .layout = m_layout,
+    };
+  }
+  const VkResult result = vkCreateComputePipelines(m_device, res.m_pipelineCache, WAVEFRONT_STAGE_COUNT,
+                                                   pipelineInfos.data(), nullptr, m_pipelines.data());
+  if(result != VK_SUCCESS)
+  {
+    LOGW("Wavefront path tracer: the kernels could not be created\n");
+    return false;
+  }
+
+  nvvk::DebugUtil dutil(m_device);
+  for(uint32_t stage = 0; stage < WAVEFRONT_STAGE_COUNT; stage++)
+    dutil.setObjectName(m_pipelines[stage], std::string("Wavefront ") + kStageNames[stage]);
+  return true;
+}
+
+void gltfr::WavefrontPathtracer::deinit()
+{
+  if(m_alloc == nullptr)
+    return;
+  for(nvvk::Buffer* buffer : {&m_paths, &m_hits, &m_rayQueues, &m_shadeQueue, &m_shadowRays, &m_pixels, &m_counters, &m_queues})
+    m_alloc->destroy(*buffer);
+  for(VkPipeline& pipeline : m_pipelines)
+  {
+    vkDestroyPipeline(m_device, pipeline, nullptr);
+    pipeline = VK_NULL_HANDLE;
+  }
+  vkDestroyPipelineLayout(m_device, m_layout, nullptr);
+  m_layout   = VK_NULL_HANDLE;
+  m_numPaths = 0;
+  m_alloc    = nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Queues for a tile of at most kMaxPaths pixels, the previous ones are retired
+//
+void gltfr::WavefrontPathtracer::createBuffers(Resources& res, const VkExtent2D& size)
+{
+  nvh::ScopedTimer st(__FUNCTION__);
+
+  for(nvvk::Buffer* buffer : {&m_paths, &m_hits, &m_rayQueues, &m_shadeQueue, &m_shadowRays, &m_pixels, &m_counters, &m_queues})
+    res.retire(*buffer);
+
+  m_size     = size;
+  m_numPaths = std::min(size.width * size.height, kMaxPaths);
+  if(m_numPaths == 0)
+    return;
+
+  const VkDeviceSize numPaths = m_numPaths;
+  m_paths      = m_alloc->createBuffer(numPaths * sizeof(DH::WavefrontPath), kStorageUsage);
+  m_hits       = m_alloc->createBuffer(numPaths * sizeof(DH::WavefrontHit), kStorageUsage);
+  m_rayQueues  = m_alloc->createBuffer(2 * numPaths * sizeof(uint32_t), kStorageUsage);
+  m_shadeQueue = m_alloc->createBuffer(numPaths * sizeof(uint32_t), kStorageUsage);
+  m_shadowRays = m_alloc->createBuffer(numPaths * sizeof(DH::WavefrontShadowRay), kStorageUsage);
+  m_pixels     = m_alloc->createBuffer(numPaths * sizeof(DH::WavefrontPixel), kStorageUsage);
+  m_counters   = m_alloc->createBuffer(sizeof(DH::WavefrontCounters),
+                                       kStorageUsage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+  auto address = [&](const nvvk::Buffer& buffer) { return nvvk::getBufferDeviceAddress(m_device, buffer.buffer); };
+  DH::WavefrontQueues queues{};
+  queues.paths        = address(m_paths);
+  queues.hits         = address(m_hits);
+  queues.rayQueues[0] = address(m_rayQueues);
+  queues.rayQueues[1] = queues.rayQueues[0] + numPaths * sizeof(uint32_t);
+  queues.shadeQueue   = address(m_shadeQueue);
+  queues.shadowRays   = address(m_shadowRays);
+  queues.pixels       = address(m_pixels);
+  queues.counters     = address(m_counters);
+  VkCommandBuffer cmd = res.createTempCmdBuffer();
+  m_queues            = m_alloc->createBuffer(cmd, sizeof(DH::WavefrontQueues), &queues, kStorageUsage);
+  res.submitAndWaitTempCmdBuffer(cmd);
+  m_alloc->finalizeAndReleaseStaging();
+
+  nvvk::DebugUtil dutil(m_device);
+  dutil.DBG_NAME(m_paths.buffer);
+  dutil.DBG_NAME(m_hits.buffer);
+  dutil.DBG_NAME(m_rayQueues.buffer);
+  dutil.DBG_NAME(m_shadeQueue.buffer);
+  dutil.DBG_NAME(m_shadowRays.buffer);
+  dutil.DBG_NAME(m_pixels.buffer);
+  dutil.DBG_NAME(m_counters.buffer);
+  dutil.DBG_NAME(m_queues.buffer);
+}
+
+void gltfr::WavefrontPathtracer::cmdDispatch(VkCommandBuffer cmd, uint32_t stage, const PushConstant& pushConst, uint32_t groups)
+{
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[stage]);
+  vkCmdPushConstants(cmd, m_layout, VK_SHADER_STAGE_ALL, 0, sizeof(PushConstant), &pushConst);
+  vkCmdDispatch(cmd, groups, 1, 1);
+  computeBarrier(cmd);
+}
+
+void gltfr::WavefrontPathtracer::cmdDispatchIndirect(VkCommandBuffer cmd, uint32_t stage, const PushConstant& pushConst, VkDeviceSize offset)
+{
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[stage]);
+  vkCmdPushConstants(cmd, m_layout, VK_SHADER_STAGE_ALL, 0, sizeof(PushConstant), &pushConst);
+  vkCmdDispatchIndirect(cmd, m_counters.buffer, offset);
+  computeBarrier(cmd);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Tiles, then samples, then bounces. The number of paths of a bounce is only known on the GPU,
+// the dispatches after the first one are indirect.
+//
+void gltfr::WavefrontPathtracer::cmdRender(VkCommandBuffer cmd, const std::vector<VkDescriptorSet>& sets, const DH::PushConstantPathtracer& pushConst)
+{
+  if(m_numPaths == 0 || m_pipelines[0] == VK_NULL_HANDLE)
+    return;
+
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout, 0, static_cast<uint32_t>(sets.size()),
+                          sets.data(), 0, nullptr);
+
+  constexpr VkDeviceSize kExtendCmd = offsetof(DH::WavefrontCounters, extendCmd);
+  constexpr VkDeviceSize kShadeCmd  = offsetof(DH::WavefrontCounters, shadeCmd);
+  constexpr VkDeviceSize kShadowCmd = offsetof(DH::WavefrontCounters, shadowCmd);
+
+  PushConstant push{.pathtracer = pushConst};
+  push.wavefront.queues    = nvvk::getBufferDeviceAddress(m_device, m_queues.buffer);
+  push.wavefront.imageSize = {m_size.width, m_size.height};
+
+  const uint32_t numPixels = m_size.width * m_size.height;
+  for(uint32_t firstPixel = 0; firstPixel < numPixels; firstPixel += m_numPaths)
+  {
+    push.wavefront.firstPixel = firstPixel;
+    push.wavefront.numPaths   = std::min(m_numPaths, numPixels - firstPixel);
+    const uint32_t pathGroups = groupCount(push.wavefront.numPaths);
+
+    for(int sample = 0; sample < pushConst.maxSamples; sample++)
+    {
+      push.wavefront.sample = sample;
+      push.wavefront.bounce = 0;
+
+      // The previous sample, or frame, may still use the counters
+      memoryBarrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+                    VK_ACCESS_2_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+      vkCmdFillBuffer(cmd, m_counters.buffer, 0, VK_WHOLE_SIZE, 0);
+      memoryBarrier(cmd, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+      cmdDispatch(cmd, WAVEFRONT_STAGE_GENERATE, push, pathGroups);
+      for(int bounce = 0; bounce < pushConst.maxDepth; bounce++)
+      {
+        push.wavefront.bounce = bounce;
+        cmdDispatchIndirect(cmd, WAVEFRONT_STAGE_EXTEND, push, kExtendCmd);
+        cmdDispatch(cmd, WAVEFRONT_STAGE_SORT, push, 1);
+        cmdDispatchIndirect(cmd, WAVEFRONT_STAGE_SCATTER, push, kExtendCmd);
+        cmdDispatchIndirect(cmd, WAVEFRONT_STAGE_SHADE, push, kShadeCmd);
+        cmdDispatch(cmd, WAVEFRONT_STAGE_QUEUES, push, 1);
+        cmdDispatchIndirect(cmd, WAVEFRONT_STAGE_SHADOW, push, kShadowCmd);
+      }
+      cmdDispatch(cmd, WAVEFRONT_STAGE_RESOLVE, push, pathGroups);
+    }
+  }
+}
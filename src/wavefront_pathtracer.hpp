@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2024-2025, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2024-2025, NVIDIA CORPORATION.
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+
+  Wavefront path tracing, the eWavefront render mode of RendererPathtracer
+
+  Instead of the megakernel of pathtrace.comp.glsl, each bounce runs small
+  kernels linked by GPU queues (see shaders/wavefront.h): extend (ray query
+  only), sort of the hits by material bin, shade, and shadow rays. The queue
+  of the next bounce only has the paths which continue, and the sizes of the
+  dispatches are written on the GPU (vkCmdDispatchIndirect).
+
+  The image is rendered in tiles of at most kMaxPaths pixels, to bound the
+  memory of the queues. All bounces up to maxDepth are recorded, the dispatches
+  of the empty queues are of size zero.
+
+*/
+
+#include <array>
+
+// nvpro-core
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "resources.hpp"
+
+#include "nvvkhl/shaders/dh_lighting.h"
+namespace DH {
+#include "shaders/device_host.h"
+#include "shaders/wavefront.h"
+}  // namespace DH
+
+namespace gltfr {
+
+class WavefrontPathtracer
+{
+public:
+  static constexpr uint32_t kMaxPaths = 1U << 19;  // Paths in flight, a tile of the image
+
+  ~WavefrontPathtracer() { deinit(); }
+
+  // Same descriptor sets as the indirect pipeline: RTX, scene, sky and HDR
+  // 'shaderFeatures': the specialization of the kernels, see Scene::getShaderFeatures
+  bool init(Resources& res, VkShaderModule module, const std::vector<VkDescriptorSetLayout>& setLayouts, uint32_t shaderFeatures);
+  void deinit();
+
+  // Queues for an image of 'size', the previous ones are retired
+  void createBuffers(Resources& res, const VkExtent2D& size);
+
+  // All samples and bounces of the frame, the result is in the output image of the descriptor set
+  void cmdRender(VkCommandBuffer cmd, const std::vector<VkDescriptorSet>& sets, const DH::PushConstantPathtracer& pushConst);
+
+private:
+  struct PushConstant
+  {
+    DH::PushConstantPathtracer pathtracer;
+    DH::PushConstantWavefront  wavefront;
+  };
+
+  void cmdDispatch(VkCommandBuffer cmd, uint32_t stage, const PushConstant& pushConst, uint32_t groups);
+  void cmdDispatchIndirect(VkCommandBuffer cmd, uint32_t stage, const PushConstant& pushConst, VkDeviceSize offset);
+
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  VkDevice                 m_device{VK_NULL_HANDLE};
+
+  VkPipelineLayout                                 m_layout{VK_NULL_HANDLE};
+  std::array<VkPipeline, WAVEFRONT_STAGE_COUNT>   m_pipelines{};
+
+  VkExtent2D   m_size{};
+  uint32_t     m_numPaths{0};
+  nvvk::Buffer m_paths;       // WavefrontPath
+  nvvk::Buffer m_hits;        // WavefrontHit
+  nvvk::Buffer m_rayQueues;   // Both ray queues
+  nvvk::Buffer m_shadeQueue;
+  nvvk::Buffer m_shadowRays;  // WavefrontShadowRay
+  nvvk::Buffer m_pixels;      // WavefrontPixel
+  nvvk::Buffer m_counters;    // WavefrontCounters
+  nvvk::Buffer m_queues;      // WavefrontQueues, addresses of the above
+};
+
+}  // namespace gltfr